@@ -27,6 +27,7 @@
  * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#define _GNU_SOURCE
 #include <unistd.h>
 #include <string.h>
 #include <errno.h>
@@ -39,6 +40,7 @@
 #include <murphy/common/macros.h>
 #include <murphy/common/mm.h>
 #include <murphy/common/log.h>
+#include <murphy/common/debug.h>
 #include <murphy/common/msg.h>
 #include <murphy/common/transport.h>
 
@@ -55,6 +57,24 @@
 
 
 #define DEFAULT_SIZE 1024                /* default input buffer size */
+#define MAX_BATCH      64                /* max. datagrams per sendmmsg */
+
+/*
+ * While the transport is corked outgoing datagrams are queued instead of
+ * sending them right away. The queue is sent out with as few sendmmsg(2)
+ * calls as possible when the transport gets uncorked, at latest at the
+ * end of the mainloop iteration it was corked in. Datagrams the socket
+ * does not take right away are queued, too, and sent out when the socket
+ * becomes writable again.
+ */
+
+typedef struct {
+    mrp_list_hook_t hook;                /* to output queue */
+    mrp_sockaddr_t  addr;                /* destination address */
+    socklen_t       addrlen;             /* address length, 0 for default */
+    size_t          size;                /* datagram size */
+    char            data[0];             /* the datagram itself */
+} obuf_t;
 
 typedef struct {
     MRP_TRANSPORT_PUBLIC_FIELDS;         /* common transport fields */
@@ -64,13 +84,22 @@ typedef struct {
     void           *ibuf;                /* input buffer */
     size_t          isize;               /* input buffer size */
     size_t          idata;               /* amount of input data */
+    mrp_list_hook_t oq;                  /* output queue */
+    mrp_io_watch_t *oow;                 /* output watch, while queueing */
+    int             corked;              /* whether output is corked */
+    mrp_deferred_t *uncork;              /* automatic uncorking */
 } dgrm_t;
 
 
 static void dgrm_recv_cb(mrp_io_watch_t *w, int fd, mrp_io_event_t events,
                          void *user_data);
+static void dgrm_send_cb(mrp_io_watch_t *w, int fd, mrp_io_event_t events,
+                         void *user_data);
 static int dgrm_disconnect(mrp_transport_t *mu);
 static int open_socket(dgrm_t *u, int family);
+static int flush_output(dgrm_t *u);
+static void purge_output(dgrm_t *u);
+static int cork_output(dgrm_t *u, int cork);
 
 
 /*
@@ -261,6 +290,7 @@ static int dgrm_open(mrp_transport_t *mu)
 
     u->sock   = -1;
     u->family = -1;
+    mrp_list_init(&u->oq);
 
     return TRUE;
 }
@@ -273,6 +303,7 @@ static int dgrm_createfrom(mrp_transport_t *mu, void *conn)
     mrp_io_event_t  events;
 
     u->sock = *(int *)conn;
+    mrp_list_init(&u->oq);
 
     if (u->sock >= 0) {
         if (mu->flags & MRP_TRANSPORT_REUSEADDR) {
@@ -295,6 +326,28 @@ static int dgrm_createfrom(mrp_transport_t *mu, void *conn)
 }
 
 
+static int dgrm_setopt(mrp_transport_t *mu, const char *opt, const void *val)
+{
+    dgrm_t *u = (dgrm_t *)mu;
+
+    if (!strcmp(opt, MRP_TRANSPORT_OPT_TYPEMAP)) {
+        if (u->mode != MRP_TRANSPORT_MODE_NATIVE)
+            return FALSE;
+
+        u->map = (void *)val;
+        return TRUE;
+    }
+
+    if (val == NULL)
+        return FALSE;
+
+    if (!strcmp(opt, MRP_TRANSPORT_OPT_CORK))
+        return cork_output(u, *(const bool *)val);
+
+    return FALSE;
+}
+
+
 static int dgrm_bind(mrp_transport_t *mu, mrp_sockaddr_t *addr,
                      socklen_t addrlen)
 {
@@ -326,6 +379,11 @@ static void dgrm_close(mrp_transport_t *mu)
     mrp_del_io_watch(u->iow);
     u->iow = NULL;
 
+    if (!mrp_list_empty(&u->oq))         /* try to get queued output out */
+        flush_output(u);
+
+    purge_output(u);
+
     mrp_free(u->ibuf);
     u->ibuf  = NULL;
     u->isize = 0;
@@ -492,6 +550,11 @@ static int dgrm_disconnect(mrp_transport_t *mu)
 
 
     if (u->connected) {
+        if (!mrp_list_empty(&u->oq))     /* still to the old peer */
+            flush_output(u);
+
+        purge_output(u);
+
         connect(u->sock, &none, sizeof(none));
 
         return TRUE;
@@ -501,13 +564,231 @@ static int dgrm_disconnect(mrp_transport_t *mu)
 }
 
 
+static int queue_output(dgrm_t *u, struct iovec *iov, int iovcnt,
+                        mrp_sockaddr_t *addr, socklen_t addrlen)
+{
+    obuf_t *b;
+    size_t  size;
+    char   *p;
+    int     i;
+
+    for (i = 0, size = 0; i < iovcnt; i++)
+        size += iov[i].iov_len;
+
+    if ((b = mrp_allocz(sizeof(*b) + size)) == NULL)
+        return FALSE;
+
+    mrp_list_init(&b->hook);
+    b->size = size;
+
+    if (addr != NULL) {
+        memcpy(&b->addr, addr, addrlen);
+        b->addrlen = addrlen;
+    }
+
+    for (i = 0, p = b->data; i < iovcnt; i++) {
+        memcpy(p, iov[i].iov_base, iov[i].iov_len);
+        p += iov[i].iov_len;
+    }
+
+    mrp_list_append(&u->oq, &b->hook);
+
+    return TRUE;
+}
+
+
+static void purge_output(dgrm_t *u)
+{
+    mrp_list_hook_t *p, *n;
+    obuf_t          *b;
+
+    mrp_del_io_watch(u->oow);
+    u->oow = NULL;
+
+    mrp_del_deferred(u->uncork);
+    u->uncork = NULL;
+    u->corked = FALSE;
+
+    if (!mrp_list_empty(&u->oq))
+        mrp_debug("dropping queued output of transport %p", u);
+
+    mrp_list_foreach(&u->oq, p, n) {
+        b = mrp_list_entry(p, typeof(*b), hook);
+        mrp_list_delete(&b->hook);
+        mrp_free(b);
+    }
+}
+
+
+static int watch_output(dgrm_t *u)
+{
+    mrp_io_event_t events;
+
+    if (u->oow == NULL) {
+        events = MRP_IO_EVENT_OUT;
+        u->oow = mrp_add_io_watch(u->ml, u->sock, events, dgrm_send_cb, u);
+    }
+
+    return u->oow != NULL;
+}
+
+
+static int flush_output(dgrm_t *u)
+{
+    struct mmsghdr   msgs[MAX_BATCH];
+    struct iovec     iov[MAX_BATCH];
+    mrp_list_hook_t *p, *n;
+    obuf_t          *b;
+    int              i, cnt, success;
+
+    success = TRUE;
+
+    while (!mrp_list_empty(&u->oq)) {
+        i = 0;
+
+        mrp_list_foreach(&u->oq, p, n) {
+            b = mrp_list_entry(p, typeof(*b), hook);
+
+            iov[i].iov_base = b->data;
+            iov[i].iov_len  = b->size;
+
+            mrp_clear(&msgs[i]);
+            msgs[i].msg_hdr.msg_name    = b->addrlen ? &b->addr : NULL;
+            msgs[i].msg_hdr.msg_namelen = b->addrlen;
+            msgs[i].msg_hdr.msg_iov     = iov + i;
+            msgs[i].msg_hdr.msg_iovlen  = 1;
+
+            if (++i >= MAX_BATCH)
+                break;
+        }
+
+        cnt = sendmmsg(u->sock, msgs, i, 0);
+
+        if (cnt < 0) {
+            if (errno == EINTR)
+                continue;
+
+            /* keep the rest queued until the socket becomes writable */
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                return watch_output(u) && success;
+
+            /* drop only the offending datagram, like an uncorked send */
+            mrp_log_error("%s(): dgrm-transport send failed (%d: %s)",
+                          __FUNCTION__, errno, strerror(errno));
+            success = FALSE;
+            cnt     = 1;
+        }
+
+        mrp_list_foreach(&u->oq, p, n) {
+            if (cnt-- <= 0)
+                break;
+
+            b = mrp_list_entry(p, typeof(*b), hook);
+            mrp_list_delete(&b->hook);
+            mrp_free(b);
+        }
+    }
+
+    mrp_del_io_watch(u->oow);
+    u->oow = NULL;
+
+    return success;
+}
+
+
+static void dgrm_send_cb(mrp_io_watch_t *w, int fd, mrp_io_event_t events,
+                         void *user_data)
+{
+    dgrm_t *u = (dgrm_t *)user_data;
+
+    MRP_UNUSED(w);
+    MRP_UNUSED(fd);
+
+    if (events & MRP_IO_EVENT_OUT)
+        flush_output(u);
+}
+
+
+static int uncork_output(dgrm_t *u)
+{
+    u->corked = FALSE;
+    mrp_disable_deferred(u->uncork);
+
+    return flush_output(u);
+}
+
+
+static void uncork_cb(mrp_deferred_t *d, void *user_data)
+{
+    MRP_UNUSED(d);
+
+    uncork_output((dgrm_t *)user_data);
+}
+
+
+static int cork_output(dgrm_t *u, int cork)
+{
+    if (cork) {
+        if (u->uncork == NULL) {
+            u->uncork = mrp_add_deferred(u->ml, uncork_cb, u);
+
+            if (u->uncork == NULL)
+                return FALSE;
+        }
+        else
+            mrp_enable_deferred(u->uncork);
+
+        u->corked = TRUE;
+
+        return TRUE;
+    }
+
+    if (!u->corked)
+        return TRUE;
+
+    return uncork_output(u);
+}
+
+
+static int dgrm_output(dgrm_t *u, struct iovec *iov, int iovcnt,
+                       mrp_sockaddr_t *addr, socklen_t addrlen)
+{
+    struct msghdr hdr;
+    ssize_t       size, n;
+    int           i;
+
+    if (u->corked || !mrp_list_empty(&u->oq))
+        return queue_output(u, iov, iovcnt, addr, addrlen);
+
+    for (i = 0, size = 0; i < iovcnt; i++)
+        size += iov[i].iov_len;
+
+    mrp_clear(&hdr);
+    hdr.msg_name    = addr;
+    hdr.msg_namelen = addr ? addrlen : 0;
+    hdr.msg_iov     = iov;
+    hdr.msg_iovlen  = iovcnt;
+
+    n = sendmsg(u->sock, &hdr, 0);
+
+    if (n == size)
+        return TRUE;
+
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        return queue_output(u, iov, iovcnt, addr, addrlen) && watch_output(u);
+
+    return FALSE;
+}
+
+
 static int dgrm_send(mrp_transport_t *mu, mrp_msg_t *msg)
 {
     dgrm_t       *u = (dgrm_t *)mu;
     struct iovec  iov[2];
     void         *buf;
-    ssize_t       size, n;
+    ssize_t       size;
     uint32_t      len;
+    int           success;
 
     if (u->connected) {
         size = mrp_msg_default_encode(msg, &buf);
@@ -519,18 +800,10 @@ static int dgrm_send(mrp_transport_t *mu, mrp_msg_t *msg)
             iov[1].iov_base = buf;
             iov[1].iov_len  = size;
 
-            n = writev(u->sock, iov, 2);
+            success = dgrm_output(u, iov, 2, NULL, 0);
             mrp_free(buf);
 
-            if (n == (ssize_t)(size + sizeof(len)))
-                return TRUE;
-            else {
-                if (n == -1 && errno == EAGAIN) {
-                    mrp_log_error("%s(): XXX TODO: this sucks, need to add "
-                                  "output queuing for dgrm-transport.",
-                                  __FUNCTION__);
-                }
-            }
+            return success;
         }
     }
 
@@ -544,9 +817,9 @@ static int dgrm_sendto(mrp_transport_t *mu, mrp_msg_t *msg,
     dgrm_t          *u = (dgrm_t *)mu;
     struct iovec     iov[2];
     void            *buf;
-    ssize_t          size, n;
+    ssize_t          size;
     uint32_t         len;
-    struct msghdr    hdr;
+    int              success;
 
     if (MRP_UNLIKELY(u->sock == -1)) {
         if (!open_socket(u, ((struct sockaddr *)addr)->sa_family))
@@ -562,26 +835,10 @@ static int dgrm_sendto(mrp_transport_t *mu, mrp_msg_t *msg,
         iov[1].iov_base = buf;
         iov[1].iov_len  = size;
 
-        hdr.msg_name    = addr;
-        hdr.msg_namelen = addrlen;
-        hdr.msg_iov     = iov;
-        hdr.msg_iovlen  = MRP_ARRAY_SIZE(iov);
-
-        hdr.msg_control    = NULL;
-        hdr.msg_controllen = 0;
-        hdr.msg_flags      = 0;
-
-        n = sendmsg(u->sock, &hdr, 0);
+        success = dgrm_output(u, iov, 2, addr, addrlen);
         mrp_free(buf);
 
-        if (n == (ssize_t)(size + sizeof(len)))
-            return TRUE;
-        else {
-            if (n == -1 && errno == EAGAIN) {
-                mrp_log_error("%s(): XXX TODO: dgrm-transport send failed",
-                              __FUNCTION__);
-            }
-        }
+        return success;
     }
 
     return FALSE;
@@ -590,21 +847,14 @@ static int dgrm_sendto(mrp_transport_t *mu, mrp_msg_t *msg,
 
 static int dgrm_sendraw(mrp_transport_t *mu, void *data, size_t size)
 {
-    dgrm_t  *u = (dgrm_t *)mu;
-    ssize_t  n;
+    dgrm_t       *u = (dgrm_t *)mu;
+    struct iovec  iov[1];
 
     if (u->connected) {
-        n = write(u->sock, data, size);
+        iov[0].iov_base = data;
+        iov[0].iov_len  = size;
 
-        if (n == (ssize_t)size)
-            return TRUE;
-        else {
-            if (n == -1 && errno == EAGAIN) {
-                mrp_log_error("%s(): XXX TODO: this sucks, need to add "
-                              "output queuing for dgrm-transport.",
-                              __FUNCTION__);
-            }
-        }
+        return dgrm_output(u, iov, 1, NULL, 0);
     }
 
     return FALSE;
@@ -614,26 +864,18 @@ static int dgrm_sendraw(mrp_transport_t *mu, void *data, size_t size)
 static int dgrm_sendrawto(mrp_transport_t *mu, void *data, size_t size,
                           mrp_sockaddr_t *addr, socklen_t addrlen)
 {
-    dgrm_t  *u = (dgrm_t *)mu;
-    ssize_t  n;
+    dgrm_t       *u = (dgrm_t *)mu;
+    struct iovec  iov[1];
 
     if (MRP_UNLIKELY(u->sock == -1)) {
         if (!open_socket(u, ((struct sockaddr *)addr)->sa_family))
             return FALSE;
     }
 
-    n = sendto(u->sock, data, size, 0, &addr->any, addrlen);
-
-    if (n == (ssize_t)size)
-        return TRUE;
-    else {
-        if (n == -1 && errno == EAGAIN) {
-            mrp_log_error("%s(): XXX TODO: dgrm-transport send failed",
-                          __FUNCTION__);
-        }
-    }
+    iov[0].iov_base = data;
+    iov[0].iov_len  = size;
 
-    return FALSE;
+    return dgrm_output(u, iov, 1, addr, addrlen);
 }
 
 
@@ -642,11 +884,12 @@ static int senddatato(mrp_transport_t *mu, void *data, uint16_t tag,
 {
     dgrm_t           *u = (dgrm_t *)mu;
     mrp_data_descr_t *type;
-    ssize_t           n;
+    struct iovec      iov[1];
     void             *buf;
     size_t            size, reserve, len;
     uint32_t         *lenp;
     uint16_t         *tagp;
+    int               success;
 
     if (MRP_UNLIKELY(u->sock == -1)) {
         if (!open_socket(u, ((struct sockaddr *)addr)->sa_family))
@@ -666,22 +909,17 @@ static int senddatato(mrp_transport_t *mu, void *data, uint16_t tag,
             *lenp = htobe32(len);
             *tagp = htobe16(tag);
 
+            iov[0].iov_base = buf;
+            iov[0].iov_len  = len + sizeof(*lenp);
+
             if (u->connected)
-                n = send(u->sock, buf, len + sizeof(*lenp), 0);
+                success = dgrm_output(u, iov, 1, NULL, 0);
             else
-                n = sendto(u->sock, buf, len + sizeof(*lenp), 0, &addr->any,
-                           addrlen);
+                success = dgrm_output(u, iov, 1, addr, addrlen);
 
             mrp_free(buf);
 
-            if (n == (ssize_t)(len + sizeof(*lenp)))
-                return TRUE;
-            else {
-                if (n == -1 && errno == EAGAIN) {
-                    mrp_log_error("%s(): XXX TODO: dgrm-transport send"
-                                  " needs queuing", __FUNCTION__);
-                }
-            }
+            return success;
         }
     }
 
@@ -710,10 +948,11 @@ static int sendnativeto(mrp_transport_t *mu, void *data, uint32_t type_id,
 {
     dgrm_t        *u   = (dgrm_t *)mu;
     mrp_typemap_t *map = u->map;
+    struct iovec   iov[1];
     void          *buf;
     size_t         size, reserve;
     uint32_t      *lenp;
-    ssize_t        n;
+    int            success;
 
     if (MRP_UNLIKELY(u->sock == -1)) {
         if (!open_socket(u, ((struct sockaddr *)addr)->sa_family))
@@ -722,25 +961,21 @@ static int sendnativeto(mrp_transport_t *mu, void *data, uint32_t type_id,
 
     reserve = sizeof(*lenp);
 
-    if (mrp_encode_native(data, type_id, reserve, &buf, &size, map) > 0) {
+    if (mrp_encode_native(data, type_id, reserve, &buf, &size, map) == 0) {
         lenp  = buf;
         *lenp = htobe32(size - sizeof(*lenp));
 
+        iov[0].iov_base = buf;
+        iov[0].iov_len  = size;
+
         if (u->connected)
-            n = send(u->sock, buf, size, 0);
+            success = dgrm_output(u, iov, 1, NULL, 0);
         else
-            n = sendto(u->sock, buf, size, 0, &addr->any, addrlen);
+            success = dgrm_output(u, iov, 1, addr, addrlen);
 
         mrp_free(buf);
 
-        if (n == (ssize_t)size)
-            return TRUE;
-        else {
-            if (n == -1 && errno == EAGAIN) {
-                mrp_log_error("%s(): XXX TODO: dgrm-transport send"
-                              " needs queuing", __FUNCTION__);
-            }
-        }
+        return success;
     }
 
     return FALSE;
@@ -769,7 +1004,7 @@ static int sendjsonto(mrp_transport_t *mu, mrp_json_t *msg,
     dgrm_t       *u = (dgrm_t *)mu;
     struct iovec  iov[2];
     const char   *s;
-    ssize_t       size, n;
+    ssize_t       size;
     uint32_t      len;
 
     if (MRP_UNLIKELY(u->sock == -1)) {
@@ -777,7 +1012,7 @@ static int sendjsonto(mrp_transport_t *mu, mrp_json_t *msg,
             return FALSE;
     }
 
-    if (u->connected && (s = mrp_json_object_to_string(msg)) != NULL) {
+    if ((s = mrp_json_object_to_string(msg)) != NULL) {
         size = strlen(s);
         len  = htobe32(size);
 
@@ -787,30 +1022,9 @@ static int sendjsonto(mrp_transport_t *mu, mrp_json_t *msg,
         iov[1].iov_len  = size;
 
         if (u->connected)
-            n = writev(u->sock, iov, 2);
-        else {
-            struct msghdr mh;
-
-            mh.msg_name       = &addr->any;
-            mh.msg_namelen    = addrlen;
-            mh.msg_iov        = iov;
-            mh.msg_iovlen     = MRP_ARRAY_SIZE(iov);
-            mh.msg_control    = NULL;
-            mh.msg_controllen = 0;
-            mh.msg_flags      = 0;
-
-            n = sendmsg(u->sock, &mh, 0);
-        }
-
-        if (n == (ssize_t)(size + sizeof(len)))
-            return TRUE;
-        else {
-            if (n == -1 && errno == EAGAIN) {
-                mrp_log_error("%s(): XXX TODO: this sucks, need to add "
-                              "output queuing for dgrm-transport.",
-                              __FUNCTION__);
-            }
-        }
+            return dgrm_output(u, iov, 2, NULL, 0);
+        else
+            return dgrm_output(u, iov, 2, addr, addrlen);
     }
 
     return FALSE;
@@ -834,7 +1048,7 @@ static int dgrm_sendjsonto(mrp_transport_t *mu, mrp_json_t *msg,
 
 
 MRP_REGISTER_TRANSPORT(udp4, UDP4, dgrm_t, dgrm_resolve,
-                       dgrm_open, dgrm_createfrom, dgrm_close, NULL,
+                       dgrm_open, dgrm_createfrom, dgrm_close, dgrm_setopt,
                        dgrm_bind, dgrm_listen, NULL,
                        dgrm_connect, dgrm_disconnect,
                        dgrm_send, dgrm_sendto,
@@ -845,7 +1059,7 @@ MRP_REGISTER_TRANSPORT(udp4, UDP4, dgrm_t, dgrm_resolve,
                        dgrm_sendjson, dgrm_sendjsonto);
 
 MRP_REGISTER_TRANSPORT(udp6, UDP6, dgrm_t, dgrm_resolve,
-                       dgrm_open, dgrm_createfrom, dgrm_close, NULL,
+                       dgrm_open, dgrm_createfrom, dgrm_close, dgrm_setopt,
                        dgrm_bind, dgrm_listen, NULL,
                        dgrm_connect, dgrm_disconnect,
                        dgrm_send, dgrm_sendto,
@@ -856,7 +1070,7 @@ MRP_REGISTER_TRANSPORT(udp6, UDP6, dgrm_t, dgrm_resolve,
                        dgrm_sendjson, dgrm_sendjsonto);
 
 MRP_REGISTER_TRANSPORT(unxdgrm, UNXD, dgrm_t, dgrm_resolve,
-                       dgrm_open, dgrm_createfrom, dgrm_close, NULL,
+                       dgrm_open, dgrm_createfrom, dgrm_close, dgrm_setopt,
                        dgrm_bind, dgrm_listen, NULL,
                        dgrm_connect, dgrm_disconnect,
                        dgrm_send, dgrm_sendto,
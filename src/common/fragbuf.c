@@ -34,25 +34,77 @@
 #include <murphy/common/log.h>
 #include <murphy/common/fragbuf.h>
 
+/*
+ * Notes:
+ *
+ *   Consumed frames are not removed from the buffer one by one. Instead
+ *   we keep track of the offset of the first unconsumed byte and move
+ *   any unconsumed data to the beginning of the buffer only when more
+ *   room is needed at the end. This way each byte gets moved at most
+ *   once, no matter how many frames are received in a single chunk.
+ *   Frames are always handed out in place, without any copying.
+ */
+
+#define FRAGBUF_MIN_ALLOC 1024           /* minimum buffer size */
+
 struct mrp_fragbuf_s {
     void *data;                          /* actual data buffer */
     int   size;                          /* size of the buffer */
-    int   used;                          /* amount of data in the bufer */
+    int   used;                          /* end of data in the buffer */
+    int   offs;                          /* start of unconsumed data */
     int   framed : 1;                    /* whether data is framed */
 };
 
 
+static inline uint32_t frame_size(void *ptr)
+{
+    uint32_t size;
+
+    memcpy(&size, ptr, sizeof(size));        /* might be unaligned */
+
+    return be32toh(size);
+}
+
+
+static void fragbuf_compact(mrp_fragbuf_t *buf)
+{
+    if (buf->offs > 0) {
+        if (buf->used > buf->offs)
+            memmove(buf->data, buf->data + buf->offs, buf->used - buf->offs);
+
+        buf->used -= buf->offs;
+        buf->offs  = 0;
+    }
+}
+
+
+static void fragbuf_consume(mrp_fragbuf_t *buf, int amount)
+{
+    buf->offs += amount;
+
+    if (buf->offs >= buf->used)
+        buf->offs = buf->used = 0;
+}
+
+
 static void *fragbuf_ensure(mrp_fragbuf_t *buf, size_t size)
 {
-    int more;
+    int nsize;
 
     if (buf->size - buf->used < (int)size) {
-        more = size - (buf->size - buf->used);
+        fragbuf_compact(buf);
+
+        if (buf->size - buf->used < (int)size) {
+            nsize = buf->size ? 2 * buf->size : FRAGBUF_MIN_ALLOC;
 
-        if (mrp_reallocz(buf->data, buf->size, buf->size + more) == NULL)
-            return NULL;
-        else
-            buf->size += more;
+            if (nsize < buf->used + (int)size)
+                nsize = buf->used + (int)size;
+
+            if (mrp_reallocz(buf->data, buf->size, nsize) == NULL)
+                return NULL;
+            else
+                buf->size = nsize;
+        }
     }
 
     return buf->data + buf->used;
@@ -61,29 +113,36 @@ static void *fragbuf_ensure(mrp_fragbuf_t *buf, size_t size)
 
 size_t mrp_fragbuf_used(mrp_fragbuf_t *buf)
 {
-    return buf->used;
+    return buf->used - buf->offs;
+}
+
+
+size_t mrp_fragbuf_space(mrp_fragbuf_t *buf)
+{
+    return buf->size - buf->used;
 }
 
 
 size_t mrp_fragbuf_missing(mrp_fragbuf_t *buf)
 {
-    void     *ptr;
     int       offs;
     uint32_t  size;
 
-    if (!buf->framed || !buf->used)
+    if (!buf->framed || buf->used == buf->offs)
         return 0;
 
     /* find the last frame */
-    ptr  = buf->data;
-    offs = 0;
-    while (offs < buf->used) {
-        size  = be32toh(*(uint32_t *)ptr);
+    offs = buf->offs;
+    while (offs + (int)sizeof(size) <= buf->used) {
+        size  = frame_size(buf->data + offs);
         offs += sizeof(size) + size;
     }
 
     /* get the amount of data missing */
-    return offs - buf->used;
+    if (offs < buf->used)                /* partial size */
+        return sizeof(size) - (buf->used - offs);
+    else
+        return offs - buf->used;
 }
 
 
@@ -92,6 +151,7 @@ int fragbuf_init(mrp_fragbuf_t *buf, int framed, int pre_alloc)
     buf->data   = NULL;
     buf->size   = 0;
     buf->used   = 0;
+    buf->offs   = 0;
     buf->framed = framed;
 
     if (pre_alloc <= 0 || fragbuf_ensure(buf, pre_alloc))
@@ -125,6 +185,7 @@ void mrp_fragbuf_reset(mrp_fragbuf_t *buf)
         buf->data = NULL;
         buf->size = 0;
         buf->used = 0;
+        buf->offs = 0;
     }
 }
 
@@ -189,88 +250,61 @@ int mrp_fragbuf_pull(mrp_fragbuf_t *buf, void **datap, size_t *sizep)
     void     *data;
     uint32_t  size;
 
-    if (buf == NULL || buf->used <= 0)
+    if (buf == NULL || buf->used <= buf->offs)
         return FALSE;
 
     if (MRP_UNLIKELY(*datap &&
-                     (*datap < buf->data || *datap > buf->data + buf->used))) {
+                     (*datap < buf->data + buf->offs ||
+                      *datap > buf->data + buf->used))) {
         mrp_log_warning("%s(): *** looks like we're called with an unreset "
                         "datap pointer... ***", __FUNCTION__);
     }
 
-    /* start of iteration */
-    if (*datap == NULL) {
+    /* continue iteration, consume the previous message */
+    if (*datap != NULL) {
         if (!buf->framed) {
-            *datap = buf->data;
-            *sizep = buf->used;
+            data = *datap + *sizep;
 
-            return TRUE;
+            if (data < buf->data + buf->offs || data > buf->data + buf->used)
+                return FALSE;
+
+            fragbuf_consume(buf, data - (buf->data + buf->offs));
         }
         else {
-            if (buf->used < (int)sizeof(size))
+            if (*datap != buf->data + buf->offs + sizeof(size))
                 return FALSE;
 
-            size = be32toh(*(uint32_t *)buf->data);
-
-            if (buf->used >= (int)(sizeof(size) + size)) {
-                *datap = buf->data + sizeof(size);
-                *sizep = size;
+            size = frame_size(buf->data + buf->offs);
 
-                return TRUE;
-            }
-            else
+            if ((int)(size + sizeof(size)) > buf->used - buf->offs)
                 return FALSE;
-        }
-    }
-    /* continue iteration */
-    else {
-        if (!buf->framed) {
-            data = *datap + *sizep;
-
-            if (buf->data <= data && data < buf->data + buf->used) {
-                memmove(buf->data, data, buf->used - (data - buf->data));
-                buf->used -= (data - buf->data);
 
-                *datap = buf->data;
-                *sizep = buf->used;
-
-                return TRUE;
-            }
-            else {
-                if (data == buf->data + buf->used)
-                    buf->used = 0;
-
-                return FALSE;
-            }
+            fragbuf_consume(buf, size + sizeof(size));
         }
-        else {
-            if (*datap != buf->data + sizeof(size))
-                return FALSE;
+    }
 
-            size = be32toh(*(uint32_t *)buf->data);
+    /* hand out the next message in place, if we have one */
+    if (buf->used <= buf->offs)
+        return FALSE;
 
-            if ((int)(size + sizeof(size)) <= buf->used) {
-                memmove(buf->data, buf->data + size + sizeof(size),
-                        buf->used - (size + sizeof(size)));
-                buf->used -= size + sizeof(size);
-            }
-            else
-                return FALSE;
+    if (!buf->framed) {
+        *datap = buf->data + buf->offs;
+        *sizep = buf->used - buf->offs;
 
-            if (buf->used <= (int)sizeof(size))
-                return FALSE;
+        return TRUE;
+    }
 
-            size = be32toh(*(uint32_t *)buf->data);
-            data = buf->data + sizeof(size);
+    if (buf->used - buf->offs < (int)sizeof(size))
+        return FALSE;
 
-            if (buf->used >= (int)(size + sizeof(size))) {
-                *datap = data;
-                *sizep = size;
+    size = frame_size(buf->data + buf->offs);
 
-                return TRUE;
-            }
+    if (buf->used - buf->offs >= (int)(sizeof(size) + size)) {
+        *datap = buf->data + buf->offs + sizeof(size);
+        *sizep = size;
 
-            return FALSE;
-        }
+        return TRUE;
     }
+    else
+        return FALSE;
 }
@@ -75,6 +75,9 @@ void mrp_fragbuf_destroy(mrp_fragbuf_t *buf);
 /** Return the amount of buffer space currently in used in th buffer. */
 size_t mrp_fragbuf_used(mrp_fragbuf_t *buf);
 
+/** Return the amount of free space at the end of the buffer. */
+size_t mrp_fragbuf_space(mrp_fragbuf_t *buf);
+
 /** Return the amount of bytes missing from the last message. */
 size_t mrp_fragbuf_missing(mrp_fragbuf_t *buf);
 
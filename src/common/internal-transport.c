@@ -52,8 +52,10 @@ struct internal_s {
 typedef struct {
     void *data;
     size_t size;
+    mrp_msg_t *msg; /* shared message, if not encoded */
     internal_t *u;
-    mrp_sockaddr_t *addr;
+    mrp_sockaddr_t *addr; /* NULL or &addrbuf */
+    mrp_sockaddr_t addrbuf;
     socklen_t addrlen;
     bool free_data;
     int offset;
@@ -72,24 +74,94 @@ static mrp_deferred_t *d;
 static uint32_t cid;
 
 
+static internal_message_t *queue_message(internal_t *u, mrp_sockaddr_t *addr,
+                                         socklen_t addrlen)
+{
+    internal_message_t *msg;
+
+    msg = mrp_allocz(sizeof(internal_message_t));
+
+    if (!msg)
+        return NULL;
+
+    /* the address is only valid during the send call, so take a copy */
+    if (addr) {
+        memcpy(&msg->addrbuf, addr, sizeof(msg->addrbuf));
+        msg->addr = &msg->addrbuf;
+    }
+
+    msg->addrlen = addrlen;
+    msg->u = u;
+
+    mrp_list_init(&msg->hook);
+    mrp_list_append(&msg_queue, &msg->hook);
+
+    mrp_enable_deferred(d);
+
+    return msg;
+}
+
+
+static void free_message(internal_message_t *msg)
+{
+    mrp_list_delete(&msg->hook);
+
+    if (msg->msg)
+        mrp_msg_unref(msg->msg);
+
+    if (msg->free_data) {
+        /* FIXME: should be mrp_data_free(msg->data, msg->tag); */
+        mrp_free(msg->data);
+    }
+
+    mrp_free(msg);
+}
+
+
+static void deliver_message(internal_t *endpoint, internal_message_t *msg)
+{
+    mrp_transport_t *t = (mrp_transport_t *)endpoint;
+    void *buf;
+    ssize_t size;
+
+    if (msg->msg) {
+        /* pass shared messages as such, encode only for non-msg mode */
+        if (t->recv_msg(t, msg->msg, &msg->u->address,
+                        MRP_SOCKADDR_SIZE) != -EPROTOTYPE)
+            return;
+
+        size = mrp_msg_default_encode(msg->msg, &buf);
+
+        if (size <= 0 || buf == NULL)
+            return;
+
+        t->recv_data(t, buf, size, &msg->u->address, MRP_SOCKADDR_SIZE);
+        mrp_free(buf);
+    }
+    else
+        t->recv_data(t, msg->data + msg->offset, msg->size,
+                     &msg->u->address, MRP_SOCKADDR_SIZE);
+}
+
+
 static void process_queue(mrp_deferred_t *d, void *user_data)
 {
     internal_message_t *msg;
     internal_t *endpoint;
-    mrp_list_hook_t *p, *n;
 
     MRP_UNUSED(user_data);
 
     mrp_disable_deferred(d);
 
-    mrp_list_foreach(&msg_queue, p, n) {
+    /*
+     * Notes: delivery might close transports and thus purge any number
+     * of queued messages, so always just pick the head of the queue.
+     */
 
-        msg = mrp_list_entry(p, typeof(*msg), hook);
+    while (!mrp_list_empty(&msg_queue)) {
 
-        if (!msg) {
-            mrp_log_error("no message!");
-            goto end;
-        }
+        msg = mrp_list_entry(msg_queue.next, typeof(*msg), hook);
+        mrp_list_delete(&msg->hook);
 
         if (!msg->u->connected) {
             if (!msg->addr) {
@@ -115,26 +187,10 @@ static void process_queue(mrp_deferred_t *d, void *user_data)
             goto end;
         }
 
-        /* skip the length word when sending */
-        endpoint->recv_data(
-                (mrp_transport_t *) endpoint, msg->data + msg->offset,
-                msg->size, &msg->u->address, MRP_SOCKADDR_SIZE);
+        deliver_message(endpoint, msg);
 
 end:
-        if (msg) {
-
-            if (msg->free_data) {
-                if (msg->custom) {
-                    /* FIXME: should be mrp_data_free(msg->data, msg->tag); */
-                    mrp_free(msg->data);
-                }
-                else
-                    mrp_msg_unref(msg->data);
-            }
-
-            mrp_list_delete(&msg->hook);
-            mrp_free(msg);
-        }
+        free_message(msg);
     }
 }
 
@@ -301,24 +357,15 @@ static void remove_messages(internal_t *u)
     internal_message_t *msg;
     mrp_list_hook_t *p, *n;
 
+    /* drop messages both to and from u */
+
     mrp_list_foreach(&msg_queue, p, n) {
         msg = mrp_list_entry(p, typeof(*msg), hook);
 
-        if (strcmp(msg->addr->data, u->name) == 0
-            || strcmp(msg->addr->data, u->address.data) == 0) {
-
-            if (msg->free_data) {
-                if (msg->custom) {
-                    /* FIXME: should be mrp_data_free(msg->data, msg->tag); */
-                    mrp_free(msg->data);
-                }
-                else
-                    mrp_msg_unref(msg->data);
-            }
-
-            mrp_list_delete(&msg->hook);
-            mrp_free(msg);
-        }
+        if (msg->u == u || (msg->u->connected && msg->u->endpoint == u) ||
+            (msg->addr && (strcmp(msg->addr->data, u->name) == 0
+                           || strcmp(msg->addr->data, u->address.data) == 0)))
+            free_message(msg);
     }
 }
 
@@ -399,34 +446,28 @@ static int internal_sendto(mrp_transport_t *mu, mrp_msg_t *data,
                        mrp_sockaddr_t *addr, socklen_t addrlen)
 {
     internal_t *u = (internal_t *)mu;
-    void *buf;
-    size_t size;
     internal_message_t *msg;
+    mrp_msg_t *shared;
 
-    size = mrp_msg_default_encode(data, &buf);
-
-    if (size == 0 || buf == NULL) {
-        return FALSE;
-    }
+    /*
+     * Instead of encoding the message, queue a copy-on-write reference
+     * to it. Neither the sender nor the recipient can see changes made
+     * to the message by the other one.
+     */
 
-    msg = mrp_allocz(sizeof(internal_message_t));
+    shared = mrp_msg_share(data);
 
-    if (!msg)
+    if (!shared)
         return FALSE;
 
-    msg->addr = addr;
-    msg->addrlen = addrlen;
-    msg->data = buf;
-    msg->free_data = FALSE;
-    msg->offset = 0;
-    msg->size = size;
-    msg->u = u;
-    msg->custom = FALSE;
+    msg = queue_message(u, addr, addrlen);
 
-    mrp_list_init(&msg->hook);
-    mrp_list_append(&msg_queue, &msg->hook);
+    if (!msg) {
+        mrp_msg_unref(shared);
+        return FALSE;
+    }
 
-    mrp_enable_deferred(d);
+    msg->msg = shared;
 
     return TRUE;
 }
@@ -448,25 +489,17 @@ static int internal_sendrawto(mrp_transport_t *mu, void *data, size_t size,
     internal_t *u = (internal_t *)mu;
     internal_message_t *msg;
 
-    msg = mrp_allocz(sizeof(internal_message_t));
+    msg = queue_message(u, addr, addrlen);
 
     if (!msg)
         return FALSE;
 
-    msg->addr = addr;
-    msg->addrlen = addrlen;
     msg->data = data;
     msg->free_data = FALSE;
     msg->offset = 0;
     msg->size = size;
-    msg->u = u;
     msg->custom = FALSE;
 
-    mrp_list_init(&msg->hook);
-    mrp_list_append(&msg_queue, &msg->hook);
-
-    mrp_enable_deferred(d);
-
     return TRUE;
 }
 
@@ -529,34 +562,32 @@ static int internal_senddatato(mrp_transport_t *mu, void *data, uint16_t tag,
     if (type == NULL)
         return FALSE;
 
-    msg = mrp_allocz(sizeof(internal_message_t));
-
-    if (!msg)
-        return FALSE;
+    /*
+     * Notes: custom data is owned by the caller who is free to reuse
+     * it once we return, so it still needs to be encoded here.
+     */
 
     size = encode_custom_data(data, &newdata, tag);
 
     if (!newdata) {
         mrp_log_error("custom data encoding failed");
-        mrp_free(msg);
         return FALSE;
     }
 
-    msg->addr = addr;
-    msg->addrlen = addrlen;
+    msg = queue_message(u, addr, addrlen);
+
+    if (!msg) {
+        mrp_free(newdata);
+        return FALSE;
+    }
+
     msg->data = newdata;
     msg->free_data = TRUE;
     msg->offset = 4;
     msg->size = size;
-    msg->u = u;
     msg->custom = TRUE;
     msg->tag = tag;
 
-    mrp_list_init(&msg->hook);
-    mrp_list_append(&msg_queue, &msg->hook);
-
-    mrp_enable_deferred(d);
-
     return TRUE;
 }
 
@@ -77,12 +77,13 @@ struct mrp_io_watch_s {
  */
 
 struct mrp_timer_s {
-    mrp_list_hook_t  hook;                       /* to list of timers */
+    mrp_list_hook_t  hook;                       /* unused, for deleted_t */
     mrp_list_hook_t  deleted;                    /* to list of pending delete */
     int            (*free)(void *ptr);           /* cb to free memory */
     mrp_mainloop_t  *ml;                         /* mainloop */
     unsigned int     msecs;                      /* timer interval */
     uint64_t         expire;                     /* next expiration time */
+    int              idx;                        /* index in timer heap */
     mrp_timer_cb_t   cb;                         /* user callback */
     void            *user_data;                  /* opaque user data */
 };
@@ -207,6 +208,27 @@ struct mrp_subloop_s {
 };
 
 
+/*
+ * event subscribers
+ *
+ * Every bus keeps, in addition to its list of watches, an index of the
+ * watches interested in each event id, in the order the watches were
+ * added. This way emitting an event only visits the watches for it.
+ */
+
+typedef struct {
+    mrp_event_watch_t **watches;                 /* watches for this event */
+    int                 nwatch;                  /* number of watches */
+} evsubs_t;
+
+typedef struct {
+    evsubs_t *ids;                               /* subscribers by event id */
+    int       nid;                               /* size of ids */
+    int       busy;                              /* whether emitting events */
+    int       dead;                              /* number of dead watches */
+} evindex_t;
+
+
 /*
  * event busses
  */
@@ -216,8 +238,7 @@ struct mrp_event_bus_s {
     mrp_list_hook_t  hook;                       /* to list of busses */
     mrp_mainloop_t  *ml;                         /* associated mainloop */
     mrp_list_hook_t  watches;                    /* event watches on this bus */
-    int              busy;                       /* whether pumping events */
-    int              dead;
+    evindex_t        index;                      /* watches by event id */
 };
 
 
@@ -237,10 +258,16 @@ struct mrp_event_watch_s {
 
 /*
  * pending events
+ *
+ * Pending events are queued in a per-mainloop ring buffer. If the ring
+ * fills up, further events are allocated from an object pool and queued
+ * to an overflow list until the ring has been fully drained again.
  */
 
+#define EVENT_RING_SIZE 64                       /* must be a power of 2 */
+
 typedef struct {
-    mrp_list_hook_t  hook;                       /* to event queue */
+    mrp_list_hook_t  hook;                       /* to overflow queue */
     mrp_event_bus_t *bus;                        /* bus for this event */
     uint32_t         id;                         /* event id */
     int              format;                     /* attached data format */
@@ -262,8 +289,9 @@ struct mrp_mainloop_s {
     int                  niowatch;               /* number of I/O watches */
     mrp_io_event_t       iomode;                 /* default event trigger mode */
 
-    mrp_list_hook_t      timers;                 /* list of timers */
-    mrp_timer_t         *next_timer;             /* next expiring timer */
+    mrp_timer_t        **timers;                 /* timer heap */
+    int                  ntimer;                 /* number of active timers */
+    int                  ntimer_max;             /* allocated heap size */
 
     mrp_list_hook_t      deferred;               /* list of deferred cbs */
     mrp_list_hook_t      inactive_deferred;      /* inactive defferred cbs */
@@ -291,7 +319,10 @@ struct mrp_mainloop_s {
     void                *work;                   /* superloop deferred work */
 
     mrp_list_hook_t      busses;                 /* known event busses */
-    mrp_list_hook_t      eventq;                 /* pending events */
+    pending_event_t     *evring;                 /* pending event ring */
+    uint32_t             evhead;                 /* ring head (next out) */
+    uint32_t             evtail;                 /* ring tail (next in) */
+    mrp_list_hook_t      eventq;                 /* pending event overflow */
     mrp_deferred_t      *eventd;                 /* deferred event pump cb */
 };
 
@@ -299,12 +330,15 @@ struct mrp_mainloop_s {
 static mrp_event_def_t *events;                  /* registered events */
 static int              nevent;                  /* number of events */
 static MRP_LIST_HOOK   (ewatches);               /* global, synchronous 'bus' */
+static evindex_t        eindex;                  /* index of global watches */
+static mrp_objpool_t   *evpool;                  /* pending event overflow */
 
 
 static void dump_pollfds(const char *prefix, struct pollfd *fds, int nfd);
 static void adjust_superloop_timer(mrp_mainloop_t *ml);
 static size_t poll_events(void *id, mrp_mainloop_t *ml, void **bufp);
 static void pump_events(mrp_deferred_t *d, void *user_data);
+static inline void unref_event_data(void *data, int format);
 
 /*
  * fd table manipulation
@@ -679,72 +713,162 @@ static inline int usecs_to_msecs(uint64_t usecs)
 }
 
 
-static void insert_timer(mrp_timer_t *t)
+/*
+ * Active timers are kept in a binary min-heap ordered by expiration time,
+ * so adding, rearming and deleting a timer is O(log n) and the next timer
+ * to expire is always at the top of the heap. Timers with long intervals
+ * do not need millisecond precision, so we round their expiration time
+ * up to a power-of-two boundary proportional to the interval. This lets
+ * timers with similar intervals expire together instead of waking us up
+ * one after the other.
+ */
+
+#define TIMER_COARSE_MSECS 1000                  /* coalesce timers >= this */
+#define TIMER_SLACK_SHIFT  4                     /* slack: 1/16 of interval */
+#define TIMER_SLACK_MAX    (1ULL << 18)          /* max. slack, ~262 ms */
+
+#define heap_top(ml) ((ml)->ntimer > 0 ? (ml)->timers[0] : NULL)
+
+
+static uint64_t timer_expiry(uint64_t now, unsigned int msecs)
 {
-    mrp_mainloop_t  *ml = t->ml;
-    mrp_list_hook_t *p, *n;
-    mrp_timer_t     *t1, *next;
-    int              inserted;
+    uint64_t expire, slack;
 
-    /*
-     * Notes:
-     *     If there is ever a need to run a large number of
-     *     simultaneous timers, we need to change this to a
-     *     self-balancing data structure, eg. an red-black tree.
-     */
+    expire = now + (uint64_t)msecs * USECS_PER_MSEC;
 
-    inserted = FALSE;
-    next     = NULL;
-    mrp_list_foreach(&ml->timers, p, n) {
-        t1 = mrp_list_entry(p, mrp_timer_t, hook);
+    if (msecs >= TIMER_COARSE_MSECS) {
+        slack = ((uint64_t)msecs * USECS_PER_MSEC) >> TIMER_SLACK_SHIFT;
+        slack = 1ULL << (63 - __builtin_clzll(slack));
 
-        if (!is_deleted(t1)) {
-            if (t->expire <= t1->expire) {
-                mrp_list_prepend(p->prev, &t->hook);
-                inserted = TRUE;
-                break;
-            }
-            if (next == NULL)
-                next = t1;
-        }
+        if (slack > TIMER_SLACK_MAX)
+            slack = TIMER_SLACK_MAX;
+
+        expire = (expire + slack - 1) & ~(slack - 1);
     }
 
-    if (!inserted)
-        mrp_list_append(&ml->timers, &t->hook);
+    return expire;
+}
 
-    if (next)
-        ml->next_timer = next;
-    else {
-        ml->next_timer = t;
-        adjust_superloop_timer(ml);
-    }
+
+static inline void heap_set(mrp_timer_t **heap, int i, mrp_timer_t *t)
+{
+    heap[i] = t;
+    t->idx  = i;
 }
 
 
-static inline void rearm_timer(mrp_timer_t *t)
+static void heap_up(mrp_mainloop_t *ml, int i)
 {
-    mrp_list_delete(&t->hook);
-    t->expire = time_now() + t->msecs * USECS_PER_MSEC;
-    insert_timer(t);
+    mrp_timer_t **heap = ml->timers;
+    mrp_timer_t  *t    = heap[i];
+    int           parent;
+
+    while (i > 0) {
+        parent = (i - 1) / 2;
+
+        if (heap[parent]->expire <= t->expire)
+            break;
+
+        heap_set(heap, i, heap[parent]);
+        i = parent;
+    }
+
+    heap_set(heap, i, t);
 }
 
 
-static mrp_timer_t *find_next_timer(mrp_mainloop_t *ml)
+static void heap_down(mrp_mainloop_t *ml, int i)
 {
-    mrp_list_hook_t *p, *n;
-    mrp_timer_t     *t = NULL;
+    mrp_timer_t **heap = ml->timers;
+    mrp_timer_t  *t    = heap[i];
+    int           child;
 
-    mrp_list_foreach(&ml->timers, p, n) {
-        t = mrp_list_entry(p, typeof(*t), hook);
+    while ((child = 2 * i + 1) < ml->ntimer) {
+        if (child + 1 < ml->ntimer &&
+            heap[child + 1]->expire < heap[child]->expire)
+            child++;
 
-        if (!is_deleted(t))
+        if (t->expire <= heap[child]->expire)
             break;
+
+        heap_set(heap, i, heap[child]);
+        i = child;
+    }
+
+    heap_set(heap, i, t);
+}
+
+
+static int insert_timer(mrp_timer_t *t)
+{
+    mrp_mainloop_t  *ml = t->ml;
+    mrp_timer_t    **heap;
+    int              size;
+
+    if (ml->ntimer >= ml->ntimer_max) {
+        size = ml->ntimer_max ? 2 * ml->ntimer_max : 16;
+
+        if (!mrp_reallocz(ml->timers, ml->ntimer_max, size))
+            return FALSE;
+
+        ml->ntimer_max = size;
+    }
+
+    heap = ml->timers;
+    heap_set(heap, ml->ntimer++, t);
+    heap_up(ml, t->idx);
+
+    if (heap[0] == t)
+        adjust_superloop_timer(ml);
+
+    return TRUE;
+}
+
+
+static void remove_timer(mrp_timer_t *t)
+{
+    mrp_mainloop_t  *ml   = t->ml;
+    mrp_timer_t    **heap = ml->timers;
+    int              i    = t->idx;
+    mrp_timer_t     *last;
+
+    if (i < 0)
+        return;
+
+    t->idx = -1;
+    last   = heap[--ml->ntimer];
+
+    if (last != t) {
+        heap_set(heap, i, last);
+
+        if (i > 0 && heap[(i - 1) / 2]->expire > last->expire)
+            heap_up(ml, i);
         else
-            t = NULL;
+            heap_down(ml, i);
     }
 
-    ml->next_timer = t;
-    return t;
+    if (i == 0)
+        adjust_superloop_timer(ml);
+}
+
+
+static void rearm_timer(mrp_timer_t *t, uint64_t now)
+{
+    mrp_mainloop_t *ml = t->ml;
+    mrp_timer_t    *top;
+    uint64_t        old;
+
+    old       = t->expire;
+    t->expire = timer_expiry(now, t->msecs);
+    top       = heap_top(ml);
+
+    if (t->expire < old)
+        heap_up(ml, t->idx);
+    else
+        heap_down(ml, t->idx);
+
+    if (top == t || heap_top(ml) == t)
+        adjust_superloop_timer(ml);
 }
 
 
@@ -771,13 +895,16 @@ mrp_timer_t *mrp_add_timer(mrp_mainloop_t *ml, unsigned int msecs,
         mrp_list_init(&t->hook);
         mrp_list_init(&t->deleted);
         t->ml        = ml;
-        t->expire    = time_now() + msecs * USECS_PER_MSEC;
+        t->expire    = timer_expiry(time_now(), msecs);
         t->msecs     = msecs;
         t->cb        = cb;
         t->user_data = user_data;
         t->free      = free_timer;
 
-        insert_timer(t);
+        if (!insert_timer(t)) {
+            mrp_free(t);
+            t = NULL;
+        }
     }
 
     return t;
@@ -790,7 +917,7 @@ void mrp_mod_timer(mrp_timer_t *t, unsigned int msecs)
         if (msecs != MRP_TIMER_RESTART)
             t->msecs = msecs;
 
-        rearm_timer(t);
+        rearm_timer(t, time_now());
     }
 }
 
@@ -799,23 +926,17 @@ void mrp_del_timer(mrp_timer_t *t)
 {
     /*
      * Notes: It is not safe to simply free this entry here as we might
-     *        be dispatching with this entry being the next to process.
-     *        We check for this and if it is not the case we relink this
-     *        to the list of deleted items which will be then processed
-     *        at end of the mainloop iteration. Otherwise we only mark the
-     *        this entry for deletion and the rest will be taken care of in
-     *        dispatch_timers().
+     *        be dispatching this very timer. We take it out of the heap
+     *        right away but only mark it for deletion. It will be freed
+     *        together with the rest of the deleted items at the end of
+     *        the mainloop iteration.
      */
 
     if (t != NULL && !is_deleted(t)) {
         mrp_debug("marking timer %p deleted", t);
 
         mark_deleted(t);
-
-        if (t->ml->next_timer == t) {
-            find_next_timer(t->ml);
-            adjust_superloop_timer(t->ml);
-        }
+        remove_timer(t);
     }
 }
 
@@ -1429,15 +1550,15 @@ static void purge_io_watches(mrp_mainloop_t *ml)
 
 static void purge_timers(mrp_mainloop_t *ml)
 {
-    mrp_list_hook_t *p, *n;
-    mrp_timer_t     *t;
+    int i;
 
-    mrp_list_foreach(&ml->timers, p, n) {
-        t = mrp_list_entry(p, typeof(*t), hook);
-        mrp_list_delete(&t->hook);
-        mrp_list_delete(&t->deleted);
-        mrp_free(t);
-    }
+    for (i = 0; i < ml->ntimer; i++)
+        mrp_free(ml->timers[i]);
+
+    mrp_free(ml->timers);
+    ml->timers     = NULL;
+    ml->ntimer     = 0;
+    ml->ntimer_max = 0;
 }
 
 
@@ -1514,6 +1635,28 @@ static void purge_deleted(mrp_mainloop_t *ml)
 }
 
 
+static void purge_events(mrp_mainloop_t *ml)
+{
+    mrp_list_hook_t *p, *n;
+    pending_event_t *e;
+
+    while (ml->evhead != ml->evtail) {
+        e = ml->evring + (ml->evhead++ & (EVENT_RING_SIZE - 1));
+        unref_event_data(e->data, e->format);
+    }
+
+    mrp_list_foreach(&ml->eventq, p, n) {
+        e = mrp_list_entry(p, typeof(*e), hook);
+        mrp_list_delete(&e->hook);
+        unref_event_data(e->data, e->format);
+        mrp_objpool_free(e);
+    }
+
+    mrp_free(ml->evring);
+    ml->evring = NULL;
+}
+
+
 static void purge_subloops(mrp_mainloop_t *ml)
 {
     mrp_list_hook_t *p, *n;
@@ -1539,7 +1682,6 @@ mrp_mainloop_t *mrp_mainloop_create(void)
 
         if (ml->epollfd >= 0 && ml->fdtbl != NULL) {
             mrp_list_init(&ml->iowatches);
-            mrp_list_init(&ml->timers);
             mrp_list_init(&ml->deferred);
             mrp_list_init(&ml->inactive_deferred);
             mrp_list_init(&ml->sighandlers);
@@ -1549,6 +1691,10 @@ mrp_mainloop_t *mrp_mainloop_create(void)
             mrp_list_init(&ml->busses);
             mrp_list_init(&ml->eventq);
 
+            ml->evring = mrp_allocz_array(pending_event_t, EVENT_RING_SIZE);
+            if (ml->evring == NULL)
+                goto fail;
+
             ml->eventd = mrp_add_deferred(ml, pump_events, ml);
             if (ml->eventd == NULL)
                 goto fail;
@@ -1561,6 +1707,7 @@ mrp_mainloop_t *mrp_mainloop_create(void)
         fail:
             close(ml->epollfd);
             fdtbl_destroy(ml->fdtbl);
+            mrp_free(ml->evring);
             mrp_free(ml);
             ml = NULL;
         }
@@ -1582,6 +1729,7 @@ void mrp_mainloop_destroy(mrp_mainloop_t *ml)
         purge_sighandlers(ml);
         purge_wakeups(ml);
         purge_subloops(ml);
+        purge_events(ml);
         purge_deleted(ml);
 
         close(ml->sigfd);
@@ -1763,34 +1911,23 @@ static int prepare_subloops(mrp_mainloop_t *ml)
 #if 0
 static inline void dump_timers(mrp_mainloop_t *ml)
 {
-    mrp_timer_t     *t;
-    mrp_list_hook_t *p, *n;
-    int              i;
-    mrp_timer_t     *next = NULL;
+    mrp_timer_t *t;
+    int          i;
 
     mrp_debug("timer dump:");
-    i = 0;
-    mrp_list_foreach(&ml->timers, p, n) {
-        t = mrp_list_entry(p, typeof(*t), hook);
-
-        mrp_debug("  #%d: %p, @%u, next %llu (%s)", i, t, t->msecs, t->expire,
-                  is_deleted(t) ? "DEAD" : "alive");
+    for (i = 0; i < ml->ntimer; i++) {
+        t = ml->timers[i];
 
-        if (!is_deleted(t) && next == NULL)
-            next = t;
+        mrp_debug("  #%d: %p, @%u, next %llu", i, t, t->msecs, t->expire);
 
-        i++;
+        if (i > 0 && ml->timers[(i - 1) / 2]->expire > t->expire) {
+            mrp_debug("*** BUG timer heap is corrupt !!! ***");
+            if (getenv("__MURPHY_TIMER_CHECK_ABORT") != NULL)
+                abort();
+        }
     }
 
-    mrp_debug("next timer: %p", ml->next_timer);
     mrp_debug("poll timer: %d", ml->poll_timeout);
-
-    if (next != NULL && ml->next_timer != NULL &&
-        !is_deleted(ml->next_timer) && next != ml->next_timer) {
-        mrp_debug("*** BUG ml->next_timer is not the nearest !!! ***");
-        if (getenv("__MURPHY_TIMER_CHECK_ABORT") != NULL)
-            abort();
-    }
 }
 #endif
 
@@ -1805,7 +1942,7 @@ int mrp_mainloop_prepare(mrp_mainloop_t *ml)
         timeout = 0;
     }
     else {
-        next_timer = ml->next_timer;
+        next_timer = heap_top(ml);
 
         if (next_timer == NULL)
             timeout = -1;
@@ -2022,29 +2159,25 @@ static void dispatch_deferred(mrp_mainloop_t *ml)
 
 static void dispatch_timers(mrp_mainloop_t *ml)
 {
-    mrp_list_hook_t *p, *n;
-    mrp_timer_t     *t;
-    uint64_t         now;
+    mrp_timer_t *t;
+    uint64_t     now;
 
-    now = time_now();
+    /*
+     * Notes: Timers are rearmed to expire at least a microsecond after
+     *        the time we started dispatching at, so a timer is never
+     *        dispatched twice during the same round, even with a zero
+     *        interval.
+     */
 
-    mrp_list_foreach(&ml->timers, p, n) {
-        t = mrp_list_entry(p, typeof(*t), hook);
+    now = time_now();
 
-        if (!is_deleted(t)) {
-            if (t->expire <= now) {
-                mrp_debug("dispatching expired timer %p", t);
+    while ((t = heap_top(ml)) != NULL && t->expire <= now) {
+        mrp_debug("dispatching expired timer %p", t);
 
-                t->cb(t, t->user_data);
+        t->cb(t, t->user_data);
 
-                if (!is_deleted(t))
-                    rearm_timer(t);
-            }
-            else
-                break;
-        }
-        else
-            mrp_debug("skipping deleted timer %p", t);
+        if (!is_deleted(t))
+            rearm_timer(t, MRP_MAX(time_now(), now + 1));
 
         if (ml->quit)
             break;
@@ -2376,6 +2509,73 @@ char *mrp_event_dump_mask(mrp_event_mask_t *mask, char *buf, size_t size)
 }
 
 
+static inline evindex_t *bus_index(mrp_event_bus_t *bus)
+{
+    return bus ? &bus->index : &eindex;
+}
+
+
+static void index_del(evindex_t *idx, mrp_event_watch_t *w)
+{
+    evsubs_t *subs;
+    int       id, i;
+
+    MRP_MASK_FOREACH_SET(&w->mask, id, 0) {
+        if (id >= idx->nid)
+            break;
+
+        subs = idx->ids + id;
+
+        for (i = 0; i < subs->nwatch; i++) {
+            if (subs->watches[i] != w)
+                continue;
+
+            memmove(subs->watches + i, subs->watches + i + 1,
+                    (subs->nwatch - i - 1) * sizeof(subs->watches[0]));
+            subs->nwatch--;
+            break;
+        }
+    }
+}
+
+
+static int index_add(evindex_t *idx, mrp_event_watch_t *w)
+{
+    evsubs_t *subs;
+    int       id;
+
+    MRP_MASK_FOREACH_SET(&w->mask, id, 0) {
+        if (id >= idx->nid) {
+            if (!mrp_reallocz(idx->ids, idx->nid, id + 1))
+                goto fail;
+            idx->nid = id + 1;
+        }
+
+        subs = idx->ids + id;
+
+        if (!mrp_reallocz(subs->watches, subs->nwatch, subs->nwatch + 1))
+            goto fail;
+
+        subs->watches[subs->nwatch++] = w;
+    }
+
+    return TRUE;
+
+ fail:
+    index_del(idx, w);
+    return FALSE;
+}
+
+
+static void free_watch(mrp_event_watch_t *w)
+{
+    index_del(bus_index(w->bus), w);
+    mrp_list_delete(&w->hook);
+    mrp_mask_reset(&w->mask);
+    mrp_free(w);
+}
+
+
 mrp_event_watch_t *mrp_event_add_watch(mrp_event_bus_t *bus, uint32_t id,
                                        mrp_event_watch_cb_t cb, void *user_data)
 {
@@ -2393,7 +2593,8 @@ mrp_event_watch_t *mrp_event_add_watch(mrp_event_bus_t *bus, uint32_t id,
     w->cb        = cb;
     w->user_data = user_data;
 
-    if (!mrp_mask_set(&w->mask, id)) {
+    if (!mrp_mask_set(&w->mask, id) || !index_add(bus_index(bus), w)) {
+        mrp_mask_reset(&w->mask);
         mrp_free(w);
         return NULL;
     }
@@ -2427,7 +2628,8 @@ mrp_event_watch_t *mrp_event_add_watch_mask(mrp_event_bus_t *bus,
     w->cb        = cb;
     w->user_data = user_data;
 
-    if (!mrp_mask_copy(&w->mask, mask)) {
+    if (!mrp_mask_copy(&w->mask, mask) || !index_add(bus_index(bus), w)) {
+        mrp_mask_reset(&w->mask);
         mrp_free(w);
         return NULL;
     }
@@ -2444,62 +2646,83 @@ mrp_event_watch_t *mrp_event_add_watch_mask(mrp_event_bus_t *bus,
 
 void mrp_event_del_watch(mrp_event_watch_t *w)
 {
-    if (w == NULL)
+    evindex_t *idx;
+
+    if (w == NULL || w->dead)
         return;
 
-    if (w->bus != NULL && w->bus->busy) {
+    idx = bus_index(w->bus);
+
+    if (idx->busy) {
         w->dead = TRUE;
-        w->bus->dead++;
+        idx->dead++;
         return;
     }
 
-    mrp_list_delete(&w->hook);
-    mrp_mask_reset(&w->mask);
-    mrp_free(w);
+    free_watch(w);
 }
 
 
-void bus_purge_dead(mrp_event_bus_t *bus)
+static void bus_purge_dead(mrp_event_bus_t *bus)
 {
+    mrp_list_hook_t   *watches = bus ? &bus->watches : &ewatches;
+    evindex_t         *idx     = bus_index(bus);
     mrp_event_watch_t *w;
     mrp_list_hook_t   *p, *n;
 
-    if (!bus->dead)
+    if (!idx->dead)
         return;
 
-    mrp_list_foreach(&bus->watches, p, n) {
+    mrp_list_foreach(watches, p, n) {
         w = mrp_list_entry(p, typeof(*w), hook);
 
-        if (!w->dead)
-            continue;
-
-        mrp_list_delete(&w->hook);
-        mrp_mask_reset(&w->mask);
-        mrp_free(w);
+        if (w->dead)
+            free_watch(w);
     }
 
-    bus->dead = 0;
+    idx->dead = 0;
 }
 
 
 static int queue_event(mrp_event_bus_t *bus, uint32_t id, void *data,
                        mrp_event_flag_t flags)
 {
-    pending_event_t *e;
+    mrp_mainloop_t       *ml = bus->ml;
+    pending_event_t      *e;
+    mrp_objpool_config_t  cfg;
 
-    e = mrp_allocz(sizeof(*e));
+    /*
+     * Notes: Events go to the overflow queue while it is not empty, so
+     *        that they are delivered in the order they were emitted.
+     */
 
-    if (e == NULL)
-        return -1;
+    if (ml->evtail - ml->evhead < EVENT_RING_SIZE &&
+        mrp_list_empty(&ml->eventq)) {
+        e = ml->evring + (ml->evtail++ & (EVENT_RING_SIZE - 1));
+    }
+    else {
+        if (evpool == NULL) {
+            mrp_clear(&cfg);
+            cfg.name    = "pending-events";
+            cfg.objsize = sizeof(*e);
+
+            if ((evpool = mrp_objpool_create(&cfg)) == NULL)
+                return -1;
+        }
+
+        if ((e = mrp_objpool_alloc(evpool)) == NULL)
+            return -1;
+
+        mrp_list_init(&e->hook);
+        mrp_list_append(&ml->eventq, &e->hook);
+    }
 
-    mrp_list_init(&e->hook);
     e->bus    = bus;
     e->id     = id;
     e->format = flags & MRP_EVENT_FORMAT_MASK;
     e->data   = ref_event_data(data, e->format);
-    mrp_list_append(&bus->ml->eventq, &e->hook);
 
-    mrp_enable_deferred(bus->ml->eventd);
+    mrp_enable_deferred(ml->eventd);
 
     return 0;
 }
@@ -2508,42 +2731,38 @@ static int queue_event(mrp_event_bus_t *bus, uint32_t id, void *data,
 static int emit_event(mrp_event_bus_t *bus, uint32_t id, void *data,
                       mrp_event_flag_t flags)
 {
-    mrp_list_hook_t   *watches;
+    evindex_t         *idx = bus_index(bus);
     mrp_event_watch_t *w;
-    mrp_list_hook_t   *p, *n;
+    int                i;
 
-    if (bus)
-        watches = &bus->watches;
-    else {
-        if (!(flags & MRP_EVENT_SYNCHRONOUS)) {
-            errno = EINVAL;
-            return -1;
-        }
-        watches = &ewatches;
+    if (!bus && !(flags & MRP_EVENT_SYNCHRONOUS)) {
+        errno = EINVAL;
+        return -1;
     }
 
-    if (bus)
-        bus->busy++;
+    idx->busy++;
 
     mrp_debug("emitting event 0x%x (%s) on bus <%s>", id, mrp_event_name(id),
               bus ? bus->name : MRP_GLOBAL_BUS_NAME);
 
-    mrp_list_foreach(watches, p, n) {
-        w = mrp_list_entry(p, typeof(*w), hook);
+    /*
+     * Notes: Watches might get added while we are emitting, which can
+     *        reallocate the index, so we must not cache pointers to it.
+     */
+
+    for (i = 0; (int)id < idx->nid && i < idx->ids[id].nwatch; i++) {
+        w = idx->ids[id].watches[i];
 
         if (w->dead)
             continue;
 
-        if (mrp_mask_test(&w->mask, id))
-            w->cb(w, id, flags & MRP_EVENT_FORMAT_MASK, data, w->user_data);
+        w->cb(w, id, flags & MRP_EVENT_FORMAT_MASK, data, w->user_data);
     }
 
-    if (bus) {
-        bus->busy--;
+    idx->busy--;
 
-        if (!bus->busy)
-            bus_purge_dead(bus);
-    }
+    if (!idx->busy)
+        bus_purge_dead(bus);
 
     return 0;
 }
@@ -2552,23 +2771,36 @@ static int emit_event(mrp_event_bus_t *bus, uint32_t id, void *data,
 static void pump_events(mrp_deferred_t *d, void *user_data)
 {
     mrp_mainloop_t  *ml = (mrp_mainloop_t *)user_data;
-    mrp_list_hook_t *p, *n;
-    pending_event_t *e;
+    pending_event_t *e, ev;
+    int              pooled;
 
- pump:
-    mrp_list_foreach(&ml->eventq, p, n) {
-        e = mrp_list_entry(p, typeof(*e), hook);
+    for (;;) {
+        if (ml->evhead != ml->evtail) {
+            e      = ml->evring + (ml->evhead++ & (EVENT_RING_SIZE - 1));
+            pooled = FALSE;
+        }
+        else if (!mrp_list_empty(&ml->eventq)) {
+            e      = mrp_list_entry(ml->eventq.next, typeof(*e), hook);
+            pooled = TRUE;
+            mrp_list_delete(&e->hook);
+        }
+        else
+            break;
 
-        emit_event(e->bus, e->id, e->data, e->format);
+        /*
+         * Notes: Once taken off the queue, the ring slot can get reused
+         *        by events emitted from the watch callbacks, so we need
+         *        to make a copy of the event before emitting it.
+         */
 
-        mrp_list_delete(&e->hook);
-        unref_event_data(e->data, e->format);
+        ev = *e;
 
-        mrp_free(e);
-    }
+        if (pooled)
+            mrp_objpool_free(e);
 
-    if (!mrp_list_empty(&ml->eventq))
-        goto pump;
+        emit_event(ev.bus, ev.id, ev.data, ev.format);
+        unref_event_data(ev.data, ev.format);
+    }
 
     mrp_disable_deferred(d);
 }
@@ -258,6 +258,8 @@ mrp_io_event_t mrp_get_io_event_mode(mrp_mainloop_t *ml);
  *
  * Timers can be dynamically stopped and restarted and the timer interval can
  * be dynamically changed. The timer interval resolution is 1 millisecond.
+ * Timers with an interval of a second or more are coalesced and may expire
+ * up to 1/16th of their interval (but at most about 260 ms) late.
  */
 
 /**
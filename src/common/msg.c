@@ -27,6 +27,7 @@
  * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <stdlib.h>
 #include <string.h>
 #include <errno.h>
 #include <stdarg.h>
@@ -46,151 +47,142 @@ static mrp_data_descr_t **other_types;   /* linearly searched types */
 static int                nother_type;
 
 
-static inline void destroy_field(mrp_msg_field_t *f)
+#define MSG_MIN_FIELDS  8                /* initial field array size */
+#define MSG_INDEX_MIN   8                /* fields needed for an index */
+#define MSG_INDEX_MAX   0xffff           /* max. fields we can index */
+
+static inline int borrowed(mrp_msg_t *msg, void *ptr)
 {
-    uint32_t i;
+    return msg->data != NULL &&
+        msg->data <= ptr && ptr < msg->data + msg->size;
+}
 
-    if (f != NULL) {
-        mrp_list_delete(&f->hook);
 
-        switch (f->type) {
-        case MRP_MSG_FIELD_STRING:
+static inline void destroy_field(mrp_msg_t *msg, mrp_msg_field_t *f)
+{
+    uint32_t i;
+
+    switch (f->type) {
+    case MRP_MSG_FIELD_STRING:
+        if (!borrowed(msg, f->str))
             mrp_free(f->str);
-            break;
+        break;
 
-        case MRP_MSG_FIELD_BLOB:
+    case MRP_MSG_FIELD_BLOB:
+        if (!borrowed(msg, f->blb))
             mrp_free(f->blb);
-            break;
+        break;
 
-        default:
-            if (f->type & MRP_MSG_FIELD_ARRAY) {
-                if ((f->type & ~MRP_MSG_FIELD_ARRAY) == MRP_MSG_FIELD_STRING) {
-                    for (i = 0; i < f->size[0]; i++) {
+    default:
+        if (f->type & MRP_MSG_FIELD_ARRAY) {
+            if ((f->type & ~MRP_MSG_FIELD_ARRAY) == MRP_MSG_FIELD_STRING) {
+                for (i = 0; i < f->size[0]; i++) {
+                    if (!borrowed(msg, f->astr[i]))
                         mrp_free(f->astr[i]);
-                    }
                 }
-
-                mrp_free(f->aany);
             }
-            break;
-        }
 
-        mrp_free(f);
+            mrp_free(f->aany);
+        }
+        break;
     }
 }
 
 
-static inline mrp_msg_field_t *create_field(uint16_t tag, va_list *ap)
+static inline int init_field(mrp_msg_t *msg, mrp_msg_field_t *f,
+                             uint16_t tag, va_list *ap)
 {
-    mrp_msg_field_t *f;
-    uint16_t         type, base;
-    uint32_t         size;
-    void            *blb;
+    uint16_t type, base;
+    uint32_t size;
+    void    *blb;
 
     type = va_arg(*ap, uint32_t);
 
-#define CREATE(_f, _tag, _type, _fldtype, _fld, _last, _errlbl) do {      \
-                                                                          \
-            (_f) = mrp_allocz(MRP_OFFSET(typeof(*_f), _last) +            \
-                              sizeof(_f->_last));                         \
-                                                                          \
-            if ((_f) != NULL) {                                           \
-                mrp_list_init(&(_f)->hook);                             \
-                (_f)->tag  = _tag;                                        \
-                (_f)->type = _type;                                       \
-                (_f)->_fld = va_arg(*ap, _fldtype);                       \
-            }                                                             \
-            else {                                                        \
-                goto _errlbl;                                             \
-            }                                                             \
+#define INIT(_f, _tag, _type, _fldtype, _fld) do {                        \
+            (_f)->tag  = _tag;                                            \
+            (_f)->type = _type;                                           \
+            (_f)->_fld = va_arg(*ap, _fldtype);                           \
         } while (0)
 
-#define CREATE_ARRAY(_f, _tag, _type, _fld, _fldtype, _errlbl) do {       \
+#define INIT_ARRAY(_f, _tag, _type, _fld, _fldtype, _errlbl) do {         \
             uint16_t _base;                                               \
             uint32_t _i;                                                  \
                                                                           \
-            (_f) = mrp_allocz(MRP_OFFSET(typeof(*_f), size[1]));          \
+            (_f)->tag  = _tag;                                            \
+            (_f)->type = _type | MRP_MSG_FIELD_ARRAY;                     \
+            _base      = _type & ~MRP_MSG_FIELD_ARRAY;                    \
                                                                           \
-            if ((_f) != NULL) {                                           \
-                mrp_list_init(&(_f)->hook);                               \
-                (_f)->tag  = _tag;                                        \
-                (_f)->type = _type | MRP_MSG_FIELD_ARRAY;                 \
-                _base      = _type & ~MRP_MSG_FIELD_ARRAY;                \
+            _f->size[0] = va_arg(*ap, uint32_t);                          \
+            _f->_fld    = mrp_allocz_array(typeof(*_f->_fld),             \
+                                           _f->size[0]);                  \
                                                                           \
-                _f->size[0] = va_arg(*ap, uint32_t);                      \
-                _f->_fld    = mrp_allocz_array(typeof(*_f->_fld),         \
-                                               _f->size[0]);              \
-                                                                          \
-                if (_f->_fld == NULL && _f->size[0] != 0)                 \
-                    goto _errlbl;                                         \
-                else                                                      \
-                    memcpy(_f->_fld, va_arg(*ap, typeof(_f->_fld)),       \
-                           _f->size[0] * sizeof(_f->_fld[0]));            \
+            if (_f->_fld == NULL && _f->size[0] != 0)                     \
+                goto _errlbl;                                             \
+            else                                                          \
+                memcpy(_f->_fld, va_arg(*ap, typeof(_f->_fld)),           \
+                       _f->size[0] * sizeof(_f->_fld[0]));                \
                                                                           \
-                if (_base == MRP_MSG_FIELD_STRING) {                      \
-                    for (_i = 0; _i < _f->size[0]; _i++) {                \
-                        _f->astr[_i] = mrp_strdup(_f->astr[_i]);          \
-                        if (_f->astr[_i] == NULL)                         \
-                            goto _errlbl;                                 \
+            if (_base == MRP_MSG_FIELD_STRING) {                          \
+                for (_i = 0; _i < _f->size[0]; _i++) {                    \
+                    _f->astr[_i] = mrp_strdup(_f->astr[_i]);              \
+                    if (_f->astr[_i] == NULL) {                           \
+                        _f->size[0] = _i;                                 \
+                        goto _errlbl;                                     \
                     }                                                     \
                 }                                                         \
             }                                                             \
-            else                                                          \
-                goto _errlbl;                                             \
         } while (0)
 
-    f = NULL;
+    memset(f, 0, sizeof(*f));
 
     switch (type) {
     case MRP_MSG_FIELD_STRING:
-        CREATE(f, tag, type, char *, str, str, fail);
+        INIT(f, tag, type, char *, str);
         f->str = mrp_strdup(f->str);
         if (f->str == NULL)
             goto fail;
         break;
     case MRP_MSG_FIELD_BOOL:
-        CREATE(f, tag, type, int, bln, bln, fail);
+        INIT(f, tag, type, int, bln);
         break;
     case MRP_MSG_FIELD_UINT8:
-        CREATE(f, tag, type, unsigned int, u8, u8, fail);
+        INIT(f, tag, type, unsigned int, u8);
         break;
     case MRP_MSG_FIELD_SINT8:
-        CREATE(f, tag, type, signed int, s8, s8, fail);
+        INIT(f, tag, type, signed int, s8);
         break;
     case MRP_MSG_FIELD_UINT16:
-        CREATE(f, tag, type, unsigned int, u16, u16, fail);
+        INIT(f, tag, type, unsigned int, u16);
         break;
     case MRP_MSG_FIELD_SINT16:
-        CREATE(f, tag, type, signed int, s16, s16, fail);
+        INIT(f, tag, type, signed int, s16);
         break;
     case MRP_MSG_FIELD_UINT32:
-        CREATE(f, tag, type, unsigned int, u32, u32, fail);
+        INIT(f, tag, type, unsigned int, u32);
         break;
     case MRP_MSG_FIELD_SINT32:
-        CREATE(f, tag, type, signed int, s32, s32, fail);
+        INIT(f, tag, type, signed int, s32);
         break;
     case MRP_MSG_FIELD_UINT64:
-        CREATE(f, tag, type, uint64_t, u64, u64, fail);
+        INIT(f, tag, type, uint64_t, u64);
         break;
     case MRP_MSG_FIELD_SINT64:
-        CREATE(f, tag, type, int64_t, s64, s64, fail);
+        INIT(f, tag, type, int64_t, s64);
         break;
     case MRP_MSG_FIELD_DOUBLE:
-        CREATE(f, tag, type, double, dbl, dbl, fail);
+        INIT(f, tag, type, double, dbl);
         break;
 
     case MRP_MSG_FIELD_BLOB:
         size = va_arg(*ap, uint32_t);
-        CREATE(f, tag, type, void *, blb, size[0], fail);
+        INIT(f, tag, type, void *, blb);
 
         blb        = f->blb;
         f->size[0] = size;
         f->blb     = mrp_allocz(size);
 
-        if (f->blb != NULL) {
+        if (f->blb != NULL)
             memcpy(f->blb, blb, size);
-            f->size[0] = size;
-        }
         else
             goto fail;
         break;
@@ -205,37 +197,37 @@ static inline mrp_msg_field_t *create_field(uint16_t tag, va_list *ap)
 
         switch (base) {
         case MRP_MSG_FIELD_STRING:
-            CREATE_ARRAY(f, tag, base, astr, char *, fail);
+            INIT_ARRAY(f, tag, base, astr, char *, fail);
             break;
         case MRP_MSG_FIELD_BOOL:
-            CREATE_ARRAY(f, tag, base, abln, int, fail);
+            INIT_ARRAY(f, tag, base, abln, int, fail);
             break;
         case MRP_MSG_FIELD_UINT8:
-            CREATE_ARRAY(f, tag, base, au8, unsigned int, fail);
+            INIT_ARRAY(f, tag, base, au8, unsigned int, fail);
             break;
         case MRP_MSG_FIELD_SINT8:
-            CREATE_ARRAY(f, tag, base, as8, int, fail);
+            INIT_ARRAY(f, tag, base, as8, int, fail);
             break;
         case MRP_MSG_FIELD_UINT16:
-            CREATE_ARRAY(f, tag, base, au16, unsigned int, fail);
+            INIT_ARRAY(f, tag, base, au16, unsigned int, fail);
             break;
         case MRP_MSG_FIELD_SINT16:
-            CREATE_ARRAY(f, tag, base, as16, int, fail);
+            INIT_ARRAY(f, tag, base, as16, int, fail);
             break;
         case MRP_MSG_FIELD_UINT32:
-            CREATE_ARRAY(f, tag, base, au32, unsigned int, fail);
+            INIT_ARRAY(f, tag, base, au32, unsigned int, fail);
             break;
         case MRP_MSG_FIELD_SINT32:
-            CREATE_ARRAY(f, tag, base, as32, int, fail);
+            INIT_ARRAY(f, tag, base, as32, int, fail);
             break;
         case MRP_MSG_FIELD_UINT64:
-            CREATE_ARRAY(f, tag, base, au64, unsigned long long, fail);
+            INIT_ARRAY(f, tag, base, au64, unsigned long long, fail);
             break;
         case MRP_MSG_FIELD_SINT64:
-            CREATE_ARRAY(f, tag, base, as64, long long, fail);
+            INIT_ARRAY(f, tag, base, as64, long long, fail);
             break;
         case MRP_MSG_FIELD_DOUBLE:
-            CREATE_ARRAY(f, tag, base, adbl, double, fail);
+            INIT_ARRAY(f, tag, base, adbl, double, fail);
             break;
         default:
             errno = EINVAL;
@@ -244,52 +236,231 @@ static inline mrp_msg_field_t *create_field(uint16_t tag, va_list *ap)
         break;
     }
 
-    return f;
+    return TRUE;
 
  fail:
-    destroy_field(f);
-    return NULL;
+    destroy_field(msg, f);
+    return FALSE;
 
-#undef CREATE
-#undef CREATE_ARRAY
+#undef INIT
+#undef INIT_ARRAY
 }
 
 
-static void msg_destroy(mrp_msg_t *msg)
+/*
+ * Fields are kept in a single array in message order. For messages
+ * with more than a handful of fields we also keep an index of the
+ * fields sorted by tag. This is built on demand by mrp_msg_find and
+ * thrown away whenever the set of fields changes.
+ */
+
+static inline void drop_index(mrp_msg_t *msg)
+{
+    mrp_free(msg->index);
+    msg->index = NULL;
+}
+
+
+static int index_cmp(const void *a, const void *b)
+{
+    uint32_t ka = *(const uint32_t *)a;
+    uint32_t kb = *(const uint32_t *)b;
+
+    return (ka > kb) - (ka < kb);
+}
+
+
+static uint32_t *build_index(mrp_msg_t *msg)
+{
+    size_t i;
+
+    if (msg->index != NULL)
+        return msg->index;
+
+    if (msg->nfield < MSG_INDEX_MIN || msg->nfield > MSG_INDEX_MAX)
+        return NULL;
+
+    if ((msg->index = mrp_alloc(msg->nfield * sizeof(*msg->index))) == NULL)
+        return NULL;
+
+    /* sort by tag, then by position so we find the first field by tag */
+    for (i = 0; i < msg->nfield; i++)
+        msg->index[i] = ((uint32_t)msg->fields[i].tag << 16) | i;
+
+    qsort(msg->index, msg->nfield, sizeof(*msg->index), index_cmp);
+
+    return msg->index;
+}
+
+
+static mrp_msg_field_t *insert_field(mrp_msg_t *msg, size_t idx)
+{
+    size_t nalloc;
+
+    if (msg->nfield >= msg->nalloc) {
+        nalloc = msg->nalloc ? 2 * msg->nalloc : MSG_MIN_FIELDS;
+
+        if (!mrp_reallocz(msg->fields, msg->nalloc, nalloc))
+            return NULL;
+
+        msg->nalloc = nalloc;
+    }
+
+    if (idx < msg->nfield)
+        memmove(msg->fields + idx + 1, msg->fields + idx,
+                (msg->nfield - idx) * sizeof(*msg->fields));
+
+    msg->nfield++;
+    drop_index(msg);
+
+    return msg->fields + idx;
+}
+
+
+static void remove_field(mrp_msg_t *msg, size_t idx)
+{
+    msg->nfield--;
+
+    if (idx < msg->nfield)
+        memmove(msg->fields + idx, msg->fields + idx + 1,
+                (msg->nfield - idx) * sizeof(*msg->fields));
+
+    drop_index(msg);
+}
+
+
+static int add_field(mrp_msg_t *msg, size_t idx, uint16_t tag, va_list *ap)
 {
-    mrp_list_hook_t *p, *n;
     mrp_msg_field_t *f;
 
+    if ((f = insert_field(msg, idx)) == NULL)
+        return FALSE;
+
+    if (!init_field(msg, f, tag, ap)) {
+        remove_field(msg, idx);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+
+static void msg_destroy(mrp_msg_t *msg)
+{
+    size_t i;
+
     if (msg != NULL) {
-        mrp_list_foreach(&msg->fields, p, n) {
-            f = mrp_list_entry(p, typeof(*f), hook);
-            destroy_field(f);
-        }
+        if (msg->owner != NULL)
+            mrp_msg_unref(msg->owner);
 
+        for (i = 0; i < msg->nfield; i++)
+            destroy_field(msg, msg->fields + i);
+
+        mrp_free(msg->fields);
+        mrp_free(msg->index);
+        mrp_free(msg->data);
         mrp_free(msg);
     }
 }
 
 
-mrp_msg_t *mrp_msg_createv(uint16_t tag, va_list ap)
+/*
+ * Copy-on-write message sharing. Sharing a message moves its fields to
+ * a hidden owner message which is then referenced by both the original
+ * and the new message. Neither of them has any fields of its own until
+ * it gets modified, at which point it gets a private copy of the fields
+ * and drops its reference to the owner. Writes are rare compared to
+ * sharing so the copy simply goes through the default encoder/decoder.
+ */
+
+static mrp_msg_t *msg_alloc(void)
 {
-    mrp_msg_t       *msg;
-    mrp_msg_field_t *f;
-    va_list          aq;
+    mrp_msg_t *msg;
 
-    va_copy(aq, ap);
-    if ((msg = mrp_allocz(sizeof(*msg))) != NULL) {
-        mrp_list_init(&msg->fields);
+    if ((msg = mrp_allocz(sizeof(*msg))) != NULL)
         mrp_refcnt_init(&msg->refcnt);
 
-        while (tag != MRP_MSG_FIELD_INVALID) {
-            f = create_field(tag, &aq);
+    return msg;
+}
 
-            if (f != NULL) {
-                mrp_list_append(&msg->fields, &f->hook);
-                msg->nfield++;
-            }
-            else {
+
+static void move_fields(mrp_msg_t *dst, mrp_msg_t *src)
+{
+    dst->fields = src->fields;
+    dst->nfield = src->nfield;
+    dst->nalloc = src->nalloc;
+    dst->index  = src->index;
+    dst->data   = src->data;
+    dst->size   = src->size;
+
+    src->fields = NULL;
+    src->nfield = 0;
+    src->nalloc = 0;
+    src->index  = NULL;
+    src->data   = NULL;
+    src->size   = 0;
+}
+
+
+static int msg_unshare(mrp_msg_t *msg)
+{
+    mrp_msg_t *copy;
+    void      *buf;
+    ssize_t    size;
+    uint16_t   tag;
+
+    if (msg->owner == NULL)
+        return TRUE;
+
+    size = mrp_msg_default_encode(msg->owner, &buf);
+
+    if (size < (ssize_t)sizeof(tag))
+        return FALSE;
+
+    copy = mrp_msg_default_decode(buf + sizeof(tag), size - sizeof(tag));
+    mrp_free(buf);
+
+    if (copy == NULL)
+        return FALSE;
+
+    move_fields(msg, copy);
+    mrp_msg_unref(copy);
+
+    mrp_msg_unref(msg->owner);
+    msg->owner = NULL;
+
+    return TRUE;
+}
+
+
+mrp_msg_t *mrp_msg_share(mrp_msg_t *msg)
+{
+    mrp_msg_t *owner, *cow;
+
+    if ((owner = msg->owner) == NULL) {
+        if ((owner = msg_alloc()) == NULL)
+            return NULL;
+
+        move_fields(owner, msg);
+        msg->owner = owner;
+    }
+
+    if ((cow = msg_alloc()) != NULL)
+        cow->owner = mrp_msg_ref(owner);
+
+    return cow;
+}
+
+
+mrp_msg_t *mrp_msg_createv(uint16_t tag, va_list ap)
+{
+    mrp_msg_t *msg;
+    va_list    aq;
+
+    va_copy(aq, ap);
+    if ((msg = msg_alloc()) != NULL) {
+        while (tag != MRP_MSG_FIELD_INVALID) {
+            if (!add_field(msg, msg->nfield, tag, &aq)) {
                 msg_destroy(msg);
                 msg = NULL;
                 goto out;
@@ -332,57 +503,55 @@ void mrp_msg_unref(mrp_msg_t *msg)
 
 int mrp_msg_append(mrp_msg_t *msg, uint16_t tag, ...)
 {
-    mrp_msg_field_t *f;
-    va_list          ap;
+    va_list ap;
+    int     success;
+
+    if (!msg_unshare(msg))
+        return FALSE;
 
     va_start(ap, tag);
-    f = create_field(tag, &ap);
+    success = add_field(msg, msg->nfield, tag, &ap);
     va_end(ap);
 
-    if (f != NULL) {
-        mrp_list_append(&msg->fields, &f->hook);
-        msg->nfield++;
-        return TRUE;
-    }
-    else
-        return FALSE;
+    return success;
 }
 
 
 int mrp_msg_prepend(mrp_msg_t *msg, uint16_t tag, ...)
 {
-    mrp_msg_field_t *f;
-    va_list          ap;
+    va_list ap;
+    int     success;
+
+    if (!msg_unshare(msg))
+        return FALSE;
 
     va_start(ap, tag);
-    f = create_field(tag, &ap);
+    success = add_field(msg, 0, tag, &ap);
     va_end(ap);
 
-    if (f != NULL) {
-        mrp_list_prepend(&msg->fields, &f->hook);
-        msg->nfield++;
-        return TRUE;
-    }
-    else
-        return FALSE;
+    return success;
 }
 
 
 int mrp_msg_set(mrp_msg_t *msg, uint16_t tag, ...)
 {
-    mrp_msg_field_t *of, *nf;
+    mrp_msg_field_t *of, nf;
     va_list          ap;
+    int              success;
+
+    if (!msg_unshare(msg))
+        return FALSE;
 
     of = mrp_msg_find(msg, tag);
 
     if (of != NULL) {
         va_start(ap, tag);
-        nf = create_field(tag, &ap);
+        success = init_field(msg, &nf, tag, &ap);
         va_end(ap);
 
-        if (nf != NULL) {
-            mrp_list_append(&of->hook, &nf->hook);
-            destroy_field(of);
+        if (success) {
+            destroy_field(msg, of);
+            *of = nf;
 
             return TRUE;
         }
@@ -392,19 +561,35 @@ int mrp_msg_set(mrp_msg_t *msg, uint16_t tag, ...)
 }
 
 
+int mrp_msg_remove(mrp_msg_t *msg, uint16_t tag)
+{
+    mrp_msg_field_t *f;
+
+    if (!msg_unshare(msg))
+        return FALSE;
+
+    if ((f = mrp_msg_find(msg, tag)) == NULL)
+        return FALSE;
+
+    destroy_field(msg, f);
+    remove_field(msg, f - msg->fields);
+
+    return TRUE;
+}
+
+
 int mrp_msg_iterate(mrp_msg_t *msg, void **it, uint16_t *tagp, uint16_t *typep,
                     mrp_msg_value_t *valp, size_t *sizep)
 {
-    mrp_list_hook_t *p = *(mrp_list_hook_t **)it;
+    size_t           i = (size_t)(uintptr_t)*it;
     mrp_msg_field_t *f;
 
-    if (p == NULL)
-        p = msg->fields.next;
+    msg = mrp_msg_body(msg);
 
-    if (p == &msg->fields)
+    if (i >= msg->nfield)
         return FALSE;
 
-    f = mrp_list_entry(p, typeof(*f), hook);
+    f = msg->fields + i;
 
     *tagp  = f->tag;
     *typep = f->type;
@@ -451,7 +636,7 @@ int mrp_msg_iterate(mrp_msg_t *msg, void **it, uint16_t *tagp, uint16_t *typep,
 #undef HANDLE_TYPE
     }
 
-    *it = p->next;
+    *it = (void *)(uintptr_t)(i + 1);
 
     return TRUE;
 }
@@ -459,15 +644,35 @@ int mrp_msg_iterate(mrp_msg_t *msg, void **it, uint16_t *tagp, uint16_t *typep,
 
 mrp_msg_field_t *mrp_msg_find(mrp_msg_t *msg, uint16_t tag)
 {
-    mrp_msg_field_t *f;
-    mrp_list_hook_t *p, *n;
+    uint32_t *index, key;
+    size_t    lo, hi, mid, i;
 
-    mrp_list_foreach(&msg->fields, p, n) {
-        f = mrp_list_entry(p, typeof(*f), hook);
-        if (f->tag == tag)
-            return f;
+    msg = mrp_msg_body(msg);
+
+    if ((index = build_index(msg)) != NULL) {
+        key = (uint32_t)tag << 16;
+        lo  = 0;
+        hi  = msg->nfield;
+
+        while (lo < hi) {
+            mid = (lo + hi) / 2;
+
+            if (index[mid] < key)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+
+        if (lo < msg->nfield && (index[lo] >> 16) == tag)
+            return msg->fields + (index[lo] & 0xffff);
+        else
+            return NULL;
     }
 
+    for (i = 0; i < msg->nfield; i++)
+        if (msg->fields[i].tag == tag)
+            return msg->fields + i;
+
     return NULL;
 }
 
@@ -492,39 +697,40 @@ int mrp_msg_get(mrp_msg_t *msg, ...)
     mrp_msg_field_t *f;
     mrp_msg_value_t *valp;
     uint32_t        *cntp;
-    mrp_list_hook_t *start, *p;
+    size_t           start, i, j, n;
     uint16_t         tag, type;
     int              found;
     va_list          ap;
 
+    msg = mrp_msg_body(msg);
+
     va_start(ap, msg);
 
     /*
-     * Okay... this might look a bit weird at first sight. This is
-     * mostly because we don't use the standard list iterating macros
-     * in the inner loop. There is a good reason for that: we want to
-     * minimise the number of times we scan the message which is just
-     * a linked list of fields. We do this by arranging the nested
-     * loops below in such a way that if the order of fields to fetch
-     * in the argument list matches the order of fields in the message
-     * we end up running the outer and inner loops in a 'phase lock'.
-     * So if the caller fetches the fields in the correct order we end
-     * up scanning the message at most once but only up to the last
-     * field to fetch.
+     * Okay... this might look a bit weird at first sight. We want to
+     * minimise the number of times we scan the message. We do this by
+     * treating the field array as a ring with an extra slot for its
+     * end, and arranging the nested loops below in such a way that if
+     * the order of fields to fetch in the argument list matches the
+     * order of fields in the message we end up running the outer and
+     * inner loops in a 'phase lock'. So if the caller fetches the fields
+     * in the correct order we end up scanning the message at most once
+     * but only up to the last field to fetch.
      */
 
-    start = msg->fields.next;
+    n     = msg->nfield;
+    start = 0;
     found = FALSE;
 
     while ((tag = va_arg(ap, unsigned int)) != MRP_MSG_FIELD_INVALID) {
         type  = va_arg(ap, unsigned int);
         found = FALSE;
 
-        for (p = start; p != start->prev; p = p->next) {
-            if (p == &msg->fields)
+        for (i = start, j = 0; j < n; i = (i + 1) % (n + 1), j++) {
+            if (i == n)
                 continue;
 
-            f = mrp_list_entry(p, typeof(*f), hook);
+            f = msg->fields + i;
 
             if (f->tag != tag)
                 continue;
@@ -567,7 +773,7 @@ int mrp_msg_get(mrp_msg_t *msg, ...)
                     goto out;
             }
 
-            start = p->next;
+            start = i + 1;
             found = TRUE;
             break;
         }
@@ -611,30 +817,34 @@ int mrp_msg_iterate_get(mrp_msg_t *msg, void **it, ...)
     mrp_msg_field_t *f;
     mrp_msg_value_t *valp;
     uint32_t        *cntp;
-    mrp_list_hook_t *start, *p;
+    size_t           start, i, j, n;
     uint16_t         tag, type, *typep;
     int              found;
     va_list          ap;
 
+    msg = mrp_msg_body(msg);
+
     va_start(ap, it);
 
     /*
-     * Okay... this might look a bit weird at first sight. This is
-     * mostly because we don't use the standard list iterating macros
-     * in the inner loop. There is a good reason for that: we want to
-     * minimise the number of times we scan the message which is just
-     * a linked list of fields. We do this by arranging the nested
-     * loops below in such a way that if the order of fields to fetch
-     * in the argument list matches the order of fields in the message
-     * we end up running the outer and inner loops in a 'phase lock'.
-     * So if the caller fetches the fields in the correct order we end
-     * up scanning the message at most once but only up to the last
-     * field to fetch.
+     * Okay... this might look a bit weird at first sight. We want to
+     * minimise the number of times we scan the message. We do this by
+     * treating the field array as a ring with an extra slot for its
+     * end, and arranging the nested loops below in such a way that if
+     * the order of fields to fetch in the argument list matches the
+     * order of fields in the message we end up running the outer and
+     * inner loops in a 'phase lock'. So if the caller fetches the fields
+     * in the correct order we end up scanning the message at most once
+     * but only up to the last field to fetch.
      */
 
-    start = (*it) ? (mrp_list_hook_t *)*it : msg->fields.next;
+    n     = msg->nfield;
+    start = (size_t)(uintptr_t)*it;
     found = FALSE;
 
+    if (start > n)
+        start = n;
+
     while ((tag = va_arg(ap, unsigned int)) != MRP_MSG_FIELD_INVALID) {
         type  = va_arg(ap, unsigned int);
         found = FALSE;
@@ -648,11 +858,11 @@ int mrp_msg_iterate_get(mrp_msg_t *msg, void **it, ...)
             valp  = NULL;
         }
 
-        for (p = start; p != start->prev; p = p->next) {
-            if (p == &msg->fields)
+        for (i = start, j = 0; j < n; i = (i + 1) % (n + 1), j++) {
+            if (i == n)
                 continue;
 
-            f = mrp_list_entry(p, typeof(*f), hook);
+            f = msg->fields + i;
 
             if (f->tag != tag)
                 continue;
@@ -718,7 +928,7 @@ int mrp_msg_iterate_get(mrp_msg_t *msg, void **it, ...)
             }
 
         next:
-            start = p->next;
+            start = i + 1;
             found = TRUE;
             break;
         }
@@ -731,7 +941,7 @@ int mrp_msg_iterate_get(mrp_msg_t *msg, void **it, ...)
     va_end(ap);
 
     if (found)
-        *it = start;
+        *it = (void *)(uintptr_t)start;
 
     return found;
 
@@ -797,7 +1007,6 @@ static const char *field_type_name(uint16_t type)
 int mrp_msg_dump(mrp_msg_t *msg, FILE *fp)
 {
     mrp_msg_field_t *f;
-    mrp_list_hook_t *p, *n;
     int              l;
     uint32_t         i;
     uint16_t         base;
@@ -806,10 +1015,10 @@ int mrp_msg_dump(mrp_msg_t *msg, FILE *fp)
     if (msg == NULL)
         return fprintf(fp, "{\n    <no message>\n}\n");
 
-    l = fprintf(fp, "{\n");
-    mrp_list_foreach(&msg->fields, p, n) {
-        f = mrp_list_entry(p, typeof(*f), hook);
+    msg = mrp_msg_body(msg);
 
+    l = fprintf(fp, "{\n");
+    for (f = msg->fields; f < msg->fields + msg->nfield; f++) {
         l += fprintf(fp, "    0x%x ", f->tag);
 
 #define DUMP(_indent, _fmt, _typename, _val)                              \
@@ -932,21 +1141,20 @@ int mrp_msg_dump(mrp_msg_t *msg, FILE *fp)
 ssize_t mrp_msg_default_encode(mrp_msg_t *msg, void **bufp)
 {
     mrp_msg_field_t *f;
-    mrp_list_hook_t *p, *n;
     mrp_msgbuf_t     mb;
     uint32_t         len, asize, i;
     uint16_t         type;
     size_t           size;
 
-    size = msg->nfield * (2 * sizeof(uint16_t) + sizeof(uint64_t));
+    msg  = mrp_msg_body(msg);
+    size = 2 * sizeof(uint16_t) +
+        msg->nfield * (2 * sizeof(uint16_t) + sizeof(uint64_t));
 
     if (mrp_msgbuf_write(&mb, size)) {
         MRP_MSGBUF_PUSH(&mb, htobe16(MRP_MSG_TAG_DEFAULT), 1, nomem);
         MRP_MSGBUF_PUSH(&mb, htobe16(msg->nfield), 1, nomem);
 
-        mrp_list_foreach(&msg->fields, p, n) {
-            f = mrp_list_entry(p, typeof(*f), hook);
-
+        for (f = msg->fields; f < msg->fields + msg->nfield; f++) {
             MRP_MSGBUF_PUSH(&mb, htobe16(f->tag) , 1, nomem);
             MRP_MSGBUF_PUSH(&mb, htobe16(f->type), 1, nomem);
 
@@ -1081,19 +1289,64 @@ ssize_t mrp_msg_default_encode(mrp_msg_t *msg, void **bufp)
 }
 
 
-mrp_msg_t *mrp_msg_default_decode(void *buf, size_t size)
+static int borrow_field(mrp_msg_t *msg, uint16_t tag, uint16_t type,
+                        void *ptr, uint32_t size)
+{
+    mrp_msg_field_t *f;
+
+    if ((f = insert_field(msg, msg->nfield)) == NULL)
+        return FALSE;
+
+    memset(f, 0, sizeof(*f));
+    f->tag  = tag;
+    f->type = type;
+
+    switch (type) {
+    case MRP_MSG_FIELD_STRING:
+        f->str = ptr;
+        break;
+    case MRP_MSG_FIELD_BLOB:
+        f->blb     = ptr;
+        f->size[0] = size;
+        break;
+    default:
+        f->aany    = ptr;
+        f->size[0] = size;
+        break;
+    }
+
+    return TRUE;
+}
+
+
+static mrp_msg_t *msg_decode(void *buf, size_t size, int lazy)
 {
     mrp_msg_t       *msg;
     mrp_msgbuf_t     mb;
     mrp_msg_value_t  v;
     void            *value;
+    char           **strs;
     uint16_t         nfield, tag, type, base;
     uint32_t         len, n, i, j;
+    int              empty;
 
     msg = mrp_msg_create_empty();
 
-    if (msg == NULL)
+    if (msg == NULL) {
+        if (lazy)
+            mrp_free(buf);
         return NULL;
+    }
+
+    /*
+     * In lazy mode the message takes over the buffer and non-empty
+     * strings and blobs are left in place instead of being copied.
+     */
+
+    if (lazy) {
+        msg->data = buf;
+        msg->size = size;
+    }
 
     mrp_msgbuf_read(&mb, buf, size);
 
@@ -1106,8 +1359,16 @@ mrp_msg_t *mrp_msg_default_decode(void *buf, size_t size)
         switch (type) {
         case MRP_MSG_FIELD_STRING:
             len = be32toh(MRP_MSGBUF_PULL(&mb, typeof(len), 1, nodata));
-            if (len > 0)
+            if (len > 0) {
                 value = MRP_MSGBUF_PULL_DATA(&mb, len, 1, nodata);
+                if (((char *)value)[len - 1] != '\0')
+                    goto invalid;
+                if (lazy) {
+                    if (!borrow_field(msg, tag, type, value, 0))
+                        goto fail;
+                    break;
+                }
+            }
             else
                 value = "";
             if (!mrp_msg_append(msg, tag, type, value))
@@ -1177,18 +1438,24 @@ mrp_msg_t *mrp_msg_default_decode(void *buf, size_t size)
         case MRP_MSG_FIELD_BLOB:
             len   = be32toh(MRP_MSGBUF_PULL(&mb, typeof(len), 1, nodata));
             value = MRP_MSGBUF_PULL_DATA(&mb, len, 1, nodata);
-            if (!mrp_msg_append(msg, tag, type, len, value))
+            if (lazy && len > 0) {
+                if (!borrow_field(msg, tag, type, value, len))
+                    goto fail;
+            }
+            else if (!mrp_msg_append(msg, tag, type, len, value))
                 goto fail;
             break;
 
         default:
             if (!(type & MRP_MSG_FIELD_ARRAY)) {
+            invalid:
                 errno = EINVAL;
                 goto fail;
             }
 
             base  = type & ~MRP_MSG_FIELD_ARRAY;
             n     = be32toh(MRP_MSGBUF_PULL(&mb, typeof(n), 1, nodata));
+            empty = FALSE;
             {
                 char    *astr[n];
                 bool     abln[n];
@@ -1208,10 +1475,15 @@ mrp_msg_t *mrp_msg_default_decode(void *buf, size_t size)
                     case MRP_MSG_FIELD_STRING:
                         len = be32toh(MRP_MSGBUF_PULL(&mb, typeof(len),
                                                       1, nodata));
-                        if (len > 0)
+                        if (len > 0) {
                             astr[j] = MRP_MSGBUF_PULL_DATA(&mb, len, 1, nodata);
-                        else
+                            if (astr[j][len - 1] != '\0')
+                                goto invalid;
+                        }
+                        else {
                             astr[j] = "";
+                            empty   = TRUE;
+                        }
                         break;
 
                     case MRP_MSG_FIELD_BOOL:
@@ -1268,6 +1540,17 @@ mrp_msg_t *mrp_msg_default_decode(void *buf, size_t size)
                     }
                 }
 
+                if (lazy && base == MRP_MSG_FIELD_STRING && !empty && n > 0) {
+                    if ((strs = mrp_allocz_array(char *, n)) == NULL)
+                        goto fail;
+                    memcpy(strs, astr, n * sizeof(strs[0]));
+                    if (!borrow_field(msg, tag, type, strs, n)) {
+                        mrp_free(strs);
+                        goto fail;
+                    }
+                    break;
+                }
+
 #define HANDLE_TYPE(_type, _var)                                          \
                 case _type:                                               \
                     if (!mrp_msg_append(msg, tag,                         \
@@ -1307,6 +1590,18 @@ mrp_msg_t *mrp_msg_default_decode(void *buf, size_t size)
 }
 
 
+mrp_msg_t *mrp_msg_default_decode(void *buf, size_t size)
+{
+    return msg_decode(buf, size, FALSE);
+}
+
+
+mrp_msg_t *mrp_msg_default_decode_lazy(void *buf, size_t size)
+{
+    return msg_decode(buf, size, TRUE);
+}
+
+
 static int guarded_array_size(void *data, mrp_data_member_t *array)
 {
 #define MAX_ITEMS (32 * 1024)
@@ -175,19 +175,25 @@ typedef enum {
 typedef MRP_MSG_VALUE_UNION mrp_msg_value_t;
 
 typedef struct {
-    mrp_list_hook_t hook;                /* hook to list of fields */
     uint16_t        tag;                 /* message field tag */
     uint16_t        type;                /* message field type */
     MRP_MSG_VALUE_UNION;                 /* message field value */
-    uint32_t        size[0];             /* size, if an array or a blob */
+    uint32_t        size[1];             /* size, if an array or a blob */
 } mrp_msg_field_t;
 
 
-typedef struct {
-    mrp_list_hook_t fields;              /* list of message fields */
-    size_t          nfield;              /* number of fields */
-    mrp_refcnt_t    refcnt;              /* reference count */
-} mrp_msg_t;
+typedef struct mrp_msg_s mrp_msg_t;
+
+struct mrp_msg_s {
+    mrp_msg_field_t *fields;             /* message fields, in order */
+    size_t           nfield;             /* number of fields */
+    size_t           nalloc;             /* allocated number of fields */
+    uint32_t        *index;              /* (tag, field) index, if any */
+    void            *data;               /* buffer with borrowed fields */
+    size_t           size;               /* size of borrowed buffer */
+    mrp_refcnt_t     refcnt;             /* reference count */
+    mrp_msg_t       *owner;              /* shared fields, if copy-on-write */
+};
 
 
 /** Create a new message. */
@@ -205,6 +211,21 @@ mrp_msg_t *mrp_msg_ref(mrp_msg_t *msg);
 /** Decrease the refcount, free the message if refcount drops to zero. */
 void mrp_msg_unref(mrp_msg_t *msg);
 
+/**
+ * Create a copy-on-write reference to the given message. The returned
+ * message shares the fields of msg until either of them is modified,
+ * at which point the modified one gets a private copy of the fields.
+ * This is used to pass messages around within a process without
+ * copying them.
+ */
+mrp_msg_t *mrp_msg_share(mrp_msg_t *msg);
+
+/** Get the message actually holding the fields of msg. */
+static inline mrp_msg_t *mrp_msg_body(mrp_msg_t *msg)
+{
+    return msg->owner != NULL ? msg->owner : msg;
+}
+
 /** Append a field to a message. */
 int mrp_msg_append(mrp_msg_t *msg, uint16_t tag, ...);
 
@@ -214,6 +235,9 @@ int mrp_msg_prepend(mrp_msg_t *msg, uint16_t tag, ...);
 /** Set a field in a message to the given value. */
 int mrp_msg_set(mrp_msg_t *msg, uint16_t tag, ...);
 
+/** Remove the first field with the given tag from a message. */
+int mrp_msg_remove(mrp_msg_t *msg, uint16_t tag);
+
 /** Iterate through the fields of a message. You must not any of the
     fields while iterating. */
 int mrp_msg_iterate(mrp_msg_t *msg, void **it, uint16_t *tagp,
@@ -243,6 +267,14 @@ ssize_t mrp_msg_default_encode(mrp_msg_t *msg, void **bufp);
 /** Decode the given message using the default message decoder. */
 mrp_msg_t *mrp_msg_default_decode(void *buf, size_t size);
 
+/**
+ * Decode the given message without copying strings and blobs. The
+ * message takes over buf, which must have been allocated with mrp_alloc,
+ * and string and blob fields point directly into it. buf is freed when
+ * the message is freed or if decoding fails.
+ */
+mrp_msg_t *mrp_msg_default_decode_lazy(void *buf, size_t size);
+
 
 /*
  * custom data types
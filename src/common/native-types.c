@@ -34,6 +34,8 @@
 #include <murphy/common/log.h>
 #include <murphy/common/mm.h>
 #include <murphy/common/list.h>
+#include <murphy/common/hashtbl.h>
+#include <murphy/common/utils.h>
 #include <murphy/common/tlv.h>
 #include <murphy/common/native-types.h>
 
@@ -61,6 +63,25 @@ typedef struct {
 } chunk_t;
 
 
+/*
+ * a precompiled member encoding/decoding operation
+ *
+ * Every registered type is compiled into an array of these, one for each
+ * member in encoding order, with the member type, layout and offset, the
+ * resolved struct or array element type and the encoded member header
+ * all looked up and calculated in advance.
+ */
+
+struct mrp_native_op_s {
+    uint32_t             type;           /* member type */
+    mrp_layout_t         layout;         /* member layout */
+    size_t               offs;           /* member offset */
+    uint32_t             hdr[2];         /* encoded TAG_MEMBER + index */
+    mrp_native_type_t   *mt;             /* struct/array element type */
+    mrp_native_member_t *m;              /* member descriptor */
+};
+
+
 static int encode_struct(mrp_tlv_t *tlv, void *data, mrp_native_type_t *t,
                          mrp_typemap_t *idmap);
 static int decode_struct(mrp_tlv_t *tlv, mrp_list_hook_t **chunks,
@@ -68,19 +89,21 @@ static int decode_struct(mrp_tlv_t *tlv, mrp_list_hook_t **chunks,
 static int print_struct(char **buf, size_t *size, int level,
                         void *data, mrp_native_type_t *t);
 static void free_native(mrp_native_type_t *t);
+static int precompile_type(mrp_native_type_t *t);
 
 static void *alloc_chunk(mrp_list_hook_t **chunks, size_t size);
 static void free_chunks(mrp_list_hook_t *chunks);
 
 
 /*
- * list and table of registered native types
+ * list, table and name lookup table of registered native types
  */
 
 static MRP_LIST_HOOK(types);
 static int           ntype;
 
 static mrp_native_type_t **typetbl;
+static mrp_htbl_t         *namehash;
 
 
 static mrp_native_member_t *native_member(mrp_native_type_t *t, int idx)
@@ -139,41 +162,19 @@ static int copy_member(mrp_native_type_t *t, mrp_native_member_t *m)
 
 static mrp_native_type_t *find_type(const char *type_name)
 {
-    mrp_native_type_t *t;
-    mrp_list_hook_t   *p, *n;
-
-    mrp_list_foreach(&types, p, n) {
-        t = mrp_list_entry(p, typeof(*t), hook);
-
-        if (!strcmp(t->name, type_name))
-            return t;
-    }
-
-    return NULL;
+    if (namehash != NULL)
+        return mrp_htbl_lookup(namehash, (void *)type_name);
+    else
+        return NULL;
 }
 
 
 static mrp_native_type_t *lookup_type(uint32_t id)
 {
-    mrp_native_type_t *t;
-    mrp_list_hook_t   *p, *n;
-
-    /* XXX TODO: turn this into a real lookup instead of linear search */
-
-    if (1 <= id && id <= (uint32_t)ntype)
-        if ((t = typetbl[id]) != NULL && t->id == id)
-            return t;
-
-    mrp_log_warning("Type lookup for %u failed, doing linear search...\n", id);
-
-    mrp_list_foreach(&types, p, n) {
-        t = mrp_list_entry(p, typeof(*t), hook);
-
-        if (t->id == id)
-            return t;
-    }
-
-    return NULL;
+    if (id < (uint32_t)ntype)
+        return typetbl[id];
+    else
+        return NULL;
 }
 
 
@@ -267,8 +268,20 @@ static int matching_types(mrp_native_type_t *t1, mrp_native_type_t *t2)
 }
 
 
+static int add_type_name(mrp_native_type_t *t)
+{
+    if (find_type(t->name) != NULL)
+        return 0;
+
+    return mrp_htbl_insert(namehash, t->name, t) ? 0 : -1;
+}
+
+
 static void register_default_types(void)
 {
+    mrp_htbl_config_t hcfg;
+    uint32_t          id;
+
 #define DEFAULT_NTYPE (MRP_TYPE_STRUCT + 1)
 
 #define DECLARE_TYPE(_ctype, _mtype)            \
@@ -284,9 +297,18 @@ static void register_default_types(void)
 #define REGISTER_TYPE(_type)                    \
     mrp_list_init(&(_type)->hook);              \
     mrp_list_append(&types, &(_type)->hook);    \
-    typetbl[(_type)->id] = (_type)
-
-    if (mrp_reallocz(typetbl, 0, DEFAULT_NTYPE) == NULL) {
+    typetbl[(_type)->id] = (_type);             \
+    add_type_name(_type)
+
+    mrp_clear(&hcfg);
+    hcfg.nentry  = 64;
+    hcfg.nbucket = 32;
+    hcfg.comp    = mrp_string_comp;
+    hcfg.hash    = mrp_string_hash;
+    hcfg.free    = NULL;
+
+    if ((namehash = mrp_htbl_create(&hcfg)) == NULL ||
+        mrp_reallocz(typetbl, 0, DEFAULT_NTYPE) == NULL) {
         mrp_log_error("Failed to initialize native type table.");
         abort();
     }
@@ -337,6 +359,9 @@ static void register_default_types(void)
 
     ntype = DEFAULT_NTYPE;
 
+    for (id = MRP_TYPE_INT8; id < DEFAULT_NTYPE; id++)
+        precompile_type(typetbl[id]);
+
 #undef DECLARE_TYPE
 #undef REGISTER_TYPE
 }
@@ -344,21 +369,23 @@ static void register_default_types(void)
 
 uint32_t mrp_register_native(mrp_native_type_t *type)
 {
-    mrp_native_type_t   *existing = find_type(type->name);
+    mrp_native_type_t   *existing;
     mrp_native_type_t   *t, *elemt;
     mrp_native_member_t *s, *d, *m;
     int                  idx;
 
     (void)member_type;
 
+    if (ntype == 0)
+        register_default_types();
+
+    existing = find_type(type->name);
+
     if (existing != NULL && !matching_types(existing, type)) {
         errno = EEXIST;
         return MRP_INVALID_TYPE;
     }
 
-    if (ntype == 0)
-        register_default_types();
-
     if ((t = mrp_allocz(sizeof(*t))) == NULL)
         return MRP_INVALID_TYPE;
 
@@ -503,6 +530,13 @@ uint32_t mrp_register_native(mrp_native_type_t *type)
         goto fail;
 
     t->id = ntype;
+
+    if (precompile_type(t) < 0)
+        goto fail;
+
+    if (add_type_name(t) < 0)
+        goto fail;
+
     mrp_list_append(&types, &t->hook);
     typetbl[ntype] = t;
     ntype++;
@@ -529,10 +563,136 @@ static void free_native(mrp_native_type_t *t)
     mrp_free(t->name);
     for (i = 0, m = t->members; i < t->nmember; i++, m++)
         mrp_free(m->any.name);
+    mrp_free(t->ops);
     mrp_free(t);
 }
 
 
+static size_t basic_encsize(uint32_t type)
+{
+    switch (type) {
+    case MRP_TYPE_INT8:
+    case MRP_TYPE_UINT8:   return sizeof(uint8_t);
+    case MRP_TYPE_INT16:
+    case MRP_TYPE_UINT16:  return sizeof(uint16_t);
+    case MRP_TYPE_INT64:
+    case MRP_TYPE_UINT64:  return sizeof(uint64_t);
+    case MRP_TYPE_FLOAT:   return sizeof(float);
+    case MRP_TYPE_DOUBLE:  return sizeof(double);
+    case MRP_TYPE_BOOL:    return sizeof(bool);
+
+    case MRP_TYPE_INT32:
+    case MRP_TYPE_UINT32:
+    case MRP_TYPE_INT:
+    case MRP_TYPE_UINT:
+    case MRP_TYPE_SHORT:
+    case MRP_TYPE_USHORT:
+    case MRP_TYPE_SIZET:
+    case MRP_TYPE_SSIZET:
+        return sizeof(uint32_t);
+
+    case MRP_TYPE_STRING:                /* length, string itself varies */
+        return sizeof(uint32_t);
+
+    default:
+        return 0;
+    }
+}
+
+
+static int precompile_type(mrp_native_type_t *t)
+{
+    mrp_native_member_t *m;
+    mrp_native_op_t     *op;
+    mrp_native_type_t   *mt;
+    size_t               i, tag, size;
+    bool                 fixed;
+
+    /*
+     * Notes:
+     *
+     *   We compile here each member of the type into an encoding/decoding
+     *   operation and precalculate the encoded size of the type. For types
+     *   with only fixed-size members this is the exact size of every
+     *   encoded instance, so the encoder can allocate its buffer in
+     *   a single step. For other types it is the size of the fixed
+     *   part and it is only used as a preallocation hint. Calculation
+     *   must be kept in sync with encode_{struct,array,basic}.
+     */
+
+    if (t->id < MRP_TYPE_BLOB) {
+        t->encsize = basic_encsize(t->id);
+        t->fixed   = (t->id != MRP_TYPE_STRING);
+        return 0;
+    }
+
+    if (t->id <= MRP_TYPE_STRUCT) {
+        t->encsize = 0;
+        t->fixed   = false;
+        return 0;
+    }
+
+    if (t->nmember > 0) {
+        if ((t->ops = mrp_allocz_array(mrp_native_op_t, t->nmember)) == NULL)
+            return -1;
+    }
+
+    tag   = 2 * sizeof(uint32_t);        /* tag + uint32_t value */
+    size  = tag;                         /* TAG_STRUCT + type id */
+    fixed = true;
+
+    for (i = 0, m = t->members, op = t->ops; i < t->nmember; i++, m++, op++) {
+        op->type   = m->any.type;
+        op->layout = m->any.layout;
+        op->offs   = m->any.offs;
+        op->hdr[0] = htobe32(TAG_MEMBER);
+        op->hdr[1] = htobe32((uint32_t)i);
+        op->m      = m;
+
+        size += tag;                     /* TAG_MEMBER + member index */
+
+        switch (m->any.type) {
+        case MRP_TYPE_BLOB:
+            fixed = false;
+            break;
+
+        case MRP_TYPE_ARRAY:
+            size += 2 * tag;             /* TAG_ARRAY + TAG_NELEM */
+
+            if ((mt = lookup_type(m->array.elem.id)) == NULL)
+                return -1;
+
+            if (m->array.kind == MRP_ARRAY_SIZE_FIXED && mt->fixed)
+                size += m->array.size.nelem * mt->encsize;
+            else
+                fixed = false;
+
+            op->mt = mt;
+            break;
+
+        case MRP_TYPE_STRUCT:
+            if ((mt = lookup_type(m->strct.data_type.id)) == NULL)
+                return -1;
+
+            size  += mt->encsize;
+            fixed &= mt->fixed;
+            op->mt = mt;
+            break;
+
+        default:
+            size  += basic_encsize(m->any.type);
+            fixed &= (m->any.type != MRP_TYPE_STRING);
+            break;
+        }
+    }
+
+    t->encsize = size;
+    t->fixed   = fixed;
+
+    return 0;
+}
+
+
 static int encode_basic(mrp_tlv_t *tlv, mrp_type_t type, mrp_value_t *v)
 {
     switch (type) {
@@ -753,23 +913,19 @@ static int terminate_guarded_array(void *elem, mrp_native_array_t *m,
 }
 
 
-static int encode_array(mrp_tlv_t *tlv, void *arrp, mrp_native_array_t *m,
+static int encode_array(mrp_tlv_t *tlv, void *arrp, mrp_native_type_t *t,
                         size_t nelem, size_t elem_size, mrp_typemap_t *idmap)
 {
-    mrp_native_type_t *t;
-    mrp_value_t       *v;
-    void              *elem;
-    size_t             i;
+    mrp_value_t *v;
+    void        *elem;
+    size_t       i;
 
-    if (mrp_tlv_push_uint32(tlv, TAG_ARRAY, map_type(m->elem.id, idmap)) < 0)
+    if (mrp_tlv_push_uint32(tlv, TAG_ARRAY, map_type(t->id, idmap)) < 0)
         return -1;
 
     if (mrp_tlv_push_uint32(tlv, TAG_NELEM, nelem) < 0)
         return -1;
 
-    if ((t = lookup_type(m->elem.id)) == NULL)
-        return -1;
-
     for (i = 0, elem = arrp; i < nelem; i++, elem += elem_size) {
         v = elem;
 
@@ -816,14 +972,25 @@ static int encode_array(mrp_tlv_t *tlv, void *arrp, mrp_native_array_t *m,
 }
 
 
+static inline int push_member_header(mrp_tlv_t *tlv, mrp_native_op_t *op)
+{
+    void *hdr;
+
+    if ((hdr = mrp_tlv_reserve(tlv, sizeof(op->hdr), 1)) == NULL)
+        return -1;
+
+    memcpy(hdr, op->hdr, sizeof(op->hdr));
+
+    return 0;
+}
+
+
 static int encode_struct(mrp_tlv_t *tlv, void *data, mrp_native_type_t *t,
                          mrp_typemap_t *idmap)
 {
-    mrp_native_member_t *m;
-    mrp_native_type_t   *mt;
-    mrp_value_t         *v;
-    uint32_t             idx;
-    size_t               size, nelem;
+    mrp_native_op_t *op, *end;
+    mrp_value_t     *v;
+    size_t           size, nelem;
 
     if (t == NULL)
         return -1;
@@ -831,16 +998,16 @@ static int encode_struct(mrp_tlv_t *tlv, void *data, mrp_native_type_t *t,
     if (mrp_tlv_push_uint32(tlv, TAG_STRUCT, map_type(t->id, idmap)) < 0)
         return -1;
 
-    for (idx = 0, m = t->members; idx < t->nmember; idx++, m++) {
-        if (mrp_tlv_push_uint32(tlv, TAG_MEMBER, idx) < 0)
+    for (op = t->ops, end = op + t->nmember; op < end; op++) {
+        if (push_member_header(tlv, op) < 0)
             return -1;
 
-        if (m->any.layout == MRP_LAYOUT_INDIRECT)
-            v = *(void **)(data + m->any.offs);
+        if (op->layout == MRP_LAYOUT_INDIRECT)
+            v = *(void **)(data + op->offs);
         else
-            v = data + m->any.offs;
+            v = data + op->offs;
 
-        switch (m->any.type) {
+        switch (op->type) {
         case MRP_TYPE_INT8:
         case MRP_TYPE_UINT8:
         case MRP_TYPE_INT16:
@@ -859,27 +1026,23 @@ static int encode_struct(mrp_tlv_t *tlv, void *data, mrp_native_type_t *t,
         case MRP_TYPE_USHORT:
         case MRP_TYPE_SIZET:
         case MRP_TYPE_SSIZET:
-            if (encode_basic(tlv, m->any.type, v) < 0)
+            if (encode_basic(tlv, op->type, v) < 0)
                 return -1;
             break;
 
         case MRP_TYPE_BLOB: /* XXX TODO implement blobs */
-            if (get_blob_size(data, t, &m->blob, &size) < 0)
-                return -1;
             return -1;
 
         case MRP_TYPE_ARRAY:
-            if (get_array_size(data, t, v->ptr, &m->array, &nelem, &size) < 0)
+            if (get_array_size(data, t, v->ptr, &op->m->array,
+                               &nelem, &size) < 0)
                 return -1;
-            if (encode_array(tlv, v->ptr, &m->array, nelem,
-                             size, idmap) < 0)
+            if (encode_array(tlv, v->ptr, op->mt, nelem, size, idmap) < 0)
                 return -1;
             break;
 
         case MRP_TYPE_STRUCT:
-            if ((mt = lookup_type(m->strct.data_type.id)) == NULL)
-                return -1;
-            if (encode_struct(tlv, v->ptr, mt, idmap) < 0)
+            if (encode_struct(tlv, v->ptr, op->mt, idmap) < 0)
                 return -1;
             break;
 
@@ -904,8 +1067,14 @@ int mrp_encode_native(void *data, uint32_t id, size_t reserve, void **bufp,
     if (t == NULL)
         return -1;
 
-    if (mrp_tlv_setup_write(&tlv, reserve + 4096) < 0)
-        return -1;
+    if (t->fixed) {
+        if (mrp_tlv_setup_write_exact(&tlv, reserve + t->encsize) < 0)
+            return -1;
+    }
+    else {
+        if (mrp_tlv_setup_write(&tlv, reserve + t->encsize + 4096) < 0)
+            return -1;
+    }
 
     if (reserve > 0)
         if (mrp_tlv_reserve(&tlv, reserve, 1) == NULL)
@@ -1037,10 +1206,9 @@ static int decode_basic(mrp_tlv_t *tlv, mrp_list_hook_t **chunks,
 
 static int decode_array(mrp_tlv_t *tlv, mrp_list_hook_t **chunks,
                         void **arrp, mrp_native_array_t *m,
-                        void *data, mrp_native_type_t *t,
-                        mrp_typemap_t *idmap)
+                        mrp_native_type_t *mt, void *data,
+                        mrp_native_type_t *t, mrp_typemap_t *idmap)
 {
-    mrp_native_type_t *mt;
     mrp_value_t       *v;
     void              *elem, *base;
     size_t             elem_size, i;
@@ -1050,18 +1218,15 @@ static int decode_array(mrp_tlv_t *tlv, mrp_list_hook_t **chunks,
     if (mrp_tlv_pull_uint32(tlv, TAG_ARRAY, &id) < 0)
         return -1;
 
-    if ((id = mapped_type(id, idmap)) != m->elem.id)
+    if ((id = mapped_type(id, idmap)) != mt->id)
         return -1;
 
-    if ((elem_size = type_size(id)) == 0)
+    if ((elem_size = mt->size) == 0)
         return -1;
 
     if (mrp_tlv_pull_uint32(tlv, TAG_NELEM, &nelem) < 0)
         return -1;
 
-    if ((mt = lookup_type(m->elem.id)) == NULL)
-        return -1;
-
     switch (m->kind) {
     case MRP_ARRAY_SIZE_EXPLICIT:
         if ((n = get_explicit_array_size(data, t, m)) < 0)
@@ -1149,10 +1314,10 @@ static int decode_struct(mrp_tlv_t *tlv, mrp_list_hook_t **chunks,
                          void **datap, uint32_t *idp, mrp_typemap_t *idmap)
 {
     mrp_native_type_t   *t;
-    mrp_native_member_t *m;
+    mrp_native_op_t     *op, *end;
     mrp_value_t         *v;
     char                *str, **strp;
-    size_t               max, i;
+    size_t               max;
     uint32_t             idx, id;
 
     if (datap == NULL) {
@@ -1181,18 +1346,23 @@ static int decode_struct(mrp_tlv_t *tlv, mrp_list_hook_t **chunks,
         if ((*datap = alloc_chunk(chunks, t->size)) == NULL)
             return -1;
 
-    for (i = 0, m = t->members; i < t->nmember; i++, m++) {
+    for (op = t->ops, end = op + t->nmember; op < end; op++) {
         if (mrp_tlv_pull_uint32(tlv, TAG_MEMBER, &idx) < 0)
             return -1;
 
-        v = *datap + m->any.offs;
+        if (idx != (uint32_t)(op - t->ops)) {
+            errno = EINVAL;
+            return -1;
+        }
 
-        if (m->any.layout == MRP_LAYOUT_INDIRECT) {
-            if ((v = allocate_indirect(chunks, v, m, idmap)) == NULL)
+        v = *datap + op->offs;
+
+        if (op->layout == MRP_LAYOUT_INDIRECT) {
+            if ((v = allocate_indirect(chunks, v, op->m, idmap)) == NULL)
                 return -1;
         }
 
-        switch (m->any.type) {
+        switch (op->type) {
         case MRP_TYPE_INT8:
         case MRP_TYPE_UINT8:
         case MRP_TYPE_INT16:
@@ -1210,13 +1380,13 @@ static int decode_struct(mrp_tlv_t *tlv, mrp_list_hook_t **chunks,
         case MRP_TYPE_USHORT:
         case MRP_TYPE_SIZET:
         case MRP_TYPE_SSIZET:
-            if (decode_basic(tlv, chunks, m->any.type, v) < 0)
+            if (decode_basic(tlv, chunks, op->type, v) < 0)
                 return -1;
             break;
 
         case MRP_TYPE_STRING:
-            if (m->any.layout == MRP_LAYOUT_INLINED) {
-                max  = m->str.size;
+            if (op->layout == MRP_LAYOUT_INLINED) {
+                max  = op->m->str.size;
                 str  = v->str;
                 strp = &str;
             }
@@ -1233,13 +1403,13 @@ static int decode_struct(mrp_tlv_t *tlv, mrp_list_hook_t **chunks,
             return -1;
 
         case MRP_TYPE_ARRAY:
-            if (decode_array(tlv, chunks, &v->ptr, &m->array,
+            if (decode_array(tlv, chunks, &v->ptr, &op->m->array, op->mt,
                              *datap, t, idmap) < 0)
                 return -1;
             break;
 
         case MRP_TYPE_STRUCT:
-            id = m->strct.data_type.id;
+            id = op->mt->id;
             if (decode_struct(tlv, chunks, &v->ptr, &id, idmap) < 0)
                 return -1;
             break;
@@ -1595,7 +1765,7 @@ static void *alloc_chunk(mrp_list_hook_t **chunks, size_t size)
         return NULL;
 
     if (*chunks == NULL) {
-        if ((*chunks = mrp_allocz(sizeof(*chunks))) == NULL)
+        if ((*chunks = mrp_allocz(sizeof(**chunks))) == NULL)
             return NULL;
         else
             mrp_list_init(*chunks);
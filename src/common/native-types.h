@@ -208,6 +208,8 @@ typedef union {
     mrp_native_struct_t strct;
 } mrp_native_member_t;
 
+typedef struct mrp_native_op_s mrp_native_op_t;
+
 typedef struct {
     char                *name;           /* name of this type */
     uint32_t             id;             /* assigned id for this type */
@@ -215,6 +217,9 @@ typedef struct {
     mrp_native_member_t *members;        /* members of this type if any */
     size_t               nmember;        /* number of members */
     mrp_list_hook_t      hook;           /* to list of registered types */
+    size_t               encsize;        /* (minimum) encoded size */
+    bool                 fixed;          /* whether encsize is exact */
+    mrp_native_op_t     *ops;            /* precompiled member operations */
 } mrp_native_type_t;
 
 
@@ -34,7 +34,6 @@
 #include <fcntl.h>
 #include <sys/types.h>
 #include <sys/socket.h>
-#include <sys/ioctl.h>
 #include <netinet/in.h>
 #include <sys/un.h>
 #include <sys/uio.h>
@@ -59,19 +58,71 @@
 #define UNXSL 4
 
 #define DEFAULT_SIZE 128                 /* default input buffer size */
+#define DEFAULT_BUDGET (256 * 1024)      /* default input read budget */
+#define READ_SPILL     ( 64 * 1024)      /* on-stack input spill buffer */
+#define DEFAULT_HIGHWM (256 * 1024)      /* default output high watermark */
+#define DEFAULT_LOWWM  ( 64 * 1024)      /* default output low watermark */
+#define MAX_IOV        64                /* max. buffers per writev */
+
+/*
+ * Input is read directly into the end of the fragment buffer, with any
+ * excess going to a spill buffer on the stack, so a single recvmsg(2)
+ * can read everything pending without first asking how much there is.
+ * Received frames are then processed in place. At most the read budget
+ * is read per notification to keep a busy peer from starving others.
+ *
+ * Output that the socket does not take right away is queued and written
+ * out in batches when the socket becomes writable again. Once the queue
+ * grows above the high watermark the transport is flagged congested and
+ * the user is notified so it can stop producing more output, until the
+ * queue drains below the low watermark.
+ *
+ * While the transport is corked all output is queued without trying to
+ * write it out. The queue is then flushed with as few writev(2) calls as
+ * possible when the transport gets uncorked, at latest at the end of the
+ * mainloop iteration it was corked in.
+ */
+
+typedef struct {
+    mrp_list_hook_t hook;                /* to output queue */
+    size_t          size;                /* amount of data */
+    size_t          offs;                /* amount already written */
+    char            data[0];             /* the data itself */
+} obuf_t;
 
 typedef struct {
     MRP_TRANSPORT_PUBLIC_FIELDS;         /* common transport fields */
     int             sock;                /* TCP socket */
     mrp_io_watch_t *iow;                 /* socket I/O watch */
     mrp_fragbuf_t  *buf;                 /* fragment buffer */
+    mrp_io_watch_t *oow;                 /* output watch, while queueing */
+    mrp_list_hook_t oq;                  /* output queue */
+    size_t          oqsize;              /* amount of data queued */
+    size_t          highwm;              /* output high watermark */
+    size_t          lowwm;               /* output low watermark */
+    int             congested;           /* whether above high watermark */
+    int             corked;              /* whether output is corked */
+    mrp_deferred_t *uncork;              /* automatic uncorking */
+    size_t          rdbudget;            /* input read budget */
+    int             edge;                /* whether edge-triggered */
+    int             rdmore;              /* whether input may be pending */
+    int             rdhup;               /* peer hung up, input pending */
+    mrp_deferred_t *rdd;                 /* resume reading, edge-triggered */
 } strm_t;
 
 
 static void strm_recv_cb(mrp_io_watch_t *w, int fd, mrp_io_event_t events,
                          void *user_data);
+static void strm_send_cb(mrp_io_watch_t *w, int fd, mrp_io_event_t events,
+                         void *user_data);
 static int strm_disconnect(mrp_transport_t *mt);
 static int open_socket(strm_t *t, int family);
+static void init_input(strm_t *t, int edge, size_t budget);
+static mrp_io_watch_t *watch_input(strm_t *t);
+static void init_output(strm_t *t, size_t highwm, size_t lowwm);
+static int flush_output(strm_t *t);
+static void purge_output(strm_t *t);
+static int cork_output(strm_t *t, int cork);
 
 
 
@@ -253,6 +304,62 @@ static int strm_open(mrp_transport_t *mt)
     strm_t *t = (strm_t *)mt;
 
     t->sock = -1;
+    init_input(t, FALSE, DEFAULT_BUDGET);
+    init_output(t, DEFAULT_HIGHWM, DEFAULT_LOWWM);
+
+    return TRUE;
+}
+
+
+static int strm_setopt(mrp_transport_t *mt, const char *opt, const void *val)
+{
+    strm_t *t = (strm_t *)mt;
+
+    if (!strcmp(opt, MRP_TRANSPORT_OPT_TYPEMAP)) {
+        if (t->mode != MRP_TRANSPORT_MODE_NATIVE)
+            return FALSE;
+
+        t->map = (void *)val;
+        return TRUE;
+    }
+
+    if (val == NULL)
+        return FALSE;
+
+    if (!strcmp(opt, MRP_TRANSPORT_OPT_CORK))
+        return cork_output(t, *(const bool *)val);
+
+    if (!strcmp(opt, MRP_TRANSPORT_OPT_BUDGET)) {
+        t->rdbudget = *(const size_t *)val;
+
+        if (t->rdbudget == 0)
+            t->rdbudget = (size_t)-1;
+
+        return TRUE;
+    }
+
+    if (!strcmp(opt, MRP_TRANSPORT_OPT_EDGE)) {
+        t->edge = *(const bool *)val;
+
+        if (t->iow != NULL && t->connected) {
+            mrp_del_io_watch(t->iow);
+            t->iow = watch_input(t);
+
+            return t->iow != NULL;
+        }
+
+        return TRUE;
+    }
+
+    if (!strcmp(opt, MRP_TRANSPORT_OPT_HIGHWM))
+        t->highwm = *(const size_t *)val;
+    else if (!strcmp(opt, MRP_TRANSPORT_OPT_LOWWM))
+        t->lowwm = *(const size_t *)val;
+    else
+        return FALSE;
+
+    if (t->lowwm > t->highwm)
+        t->lowwm = t->highwm;
 
     return TRUE;
 }
@@ -290,9 +397,10 @@ static int set_reuseaddr(int sock, int reuseaddr)
 static int strm_createfrom(mrp_transport_t *mt, void *conn)
 {
     strm_t           *t = (strm_t *)mt;
-    mrp_io_event_t   events;
 
     t->sock = *(int *)conn;
+    init_input(t, FALSE, DEFAULT_BUDGET);
+    init_output(t, DEFAULT_HIGHWM, DEFAULT_LOWWM);
 
     if (t->sock >= 0) {
         if (mt->flags & MRP_TRANSPORT_REUSEADDR)
@@ -306,9 +414,7 @@ static int strm_createfrom(mrp_transport_t *mt, void *conn)
         if (t->connected || t->listened) {
             if (!t->connected ||
                 (t->buf = mrp_fragbuf_create(TRUE, 0)) != NULL) {
-                events = MRP_IO_EVENT_IN | MRP_IO_EVENT_HUP;
-                t->iow = mrp_add_io_watch(t->ml, t->sock, events,
-                                          strm_recv_cb, t);
+                t->iow = watch_input(t);
 
                 if (t->iow != NULL)
                     return TRUE;
@@ -332,6 +438,13 @@ static void strm_close(mrp_transport_t *mt)
     mrp_del_io_watch(t->iow);
     t->iow = NULL;
 
+    flush_output(t);                     /* try to get queued output out */
+
+    purge_output(t);
+
+    mrp_del_deferred(t->rdd);
+    t->rdd = NULL;
+
     mrp_fragbuf_destroy(t->buf);
     t->buf = NULL;
 
@@ -384,7 +497,6 @@ static int strm_accept(mrp_transport_t *mt, mrp_transport_t *mlt)
     strm_t         *t, *lt;
     mrp_sockaddr_t  addr;
     socklen_t       addrlen;
-    mrp_io_event_t  events;
 
     t  = (strm_t *)mt;
     lt = (strm_t *)mlt;
@@ -395,6 +507,9 @@ static int strm_accept(mrp_transport_t *mt, mrp_transport_t *mlt)
         return FALSE;
     }
 
+    init_input(t, lt->edge, lt->rdbudget);
+    init_output(t, lt->highwm, lt->lowwm);
+
     addrlen = sizeof(addr);
     t->sock = accept(lt->sock, &addr.any, &addrlen);
 
@@ -412,8 +527,7 @@ static int strm_accept(mrp_transport_t *mt, mrp_transport_t *mlt)
                 goto reject;
 
         t->buf = mrp_fragbuf_create(TRUE, 0);
-        events = MRP_IO_EVENT_IN | MRP_IO_EVENT_HUP;
-        t->iow = mrp_add_io_watch(t->ml, t->sock, events, strm_recv_cb, t);
+        t->iow = watch_input(t);
 
         if (t->iow != NULL && t->buf != NULL) {
             mrp_debug("accepted connection on transport %p/%p", mlt, mt);
@@ -453,21 +567,108 @@ static int strm_accept(mrp_transport_t *mt, mrp_transport_t *mlt)
 }
 
 
+static int read_input(strm_t *t, int *eof)
+{
+    char           spill[READ_SPILL];
+    struct iovec   iov[2];
+    struct msghdr  hdr;
+    size_t         total, space;
+    ssize_t        n;
+    void          *buf;
+
+    t->rdmore = FALSE;
+    *eof      = FALSE;
+    total     = 0;
+
+    while (total < t->rdbudget) {
+        if ((space = mrp_fragbuf_space(t->buf)) < DEFAULT_SIZE)
+            space = DEFAULT_SIZE;
+
+        if ((buf = mrp_fragbuf_alloc(t->buf, space)) == NULL)
+            return ENOMEM;
+
+        iov[0].iov_base = buf;
+        iov[0].iov_len  = space;
+        iov[1].iov_base = spill;
+        iov[1].iov_len  = sizeof(spill);
+
+        mrp_clear(&hdr);
+        hdr.msg_iov    = iov;
+        hdr.msg_iovlen = 2;
+
+        n = recvmsg(t->sock, &hdr, MSG_DONTWAIT);
+
+        if (n <= 0) {
+            mrp_fragbuf_trim(t->buf, buf, space, 0);
+
+            if (n == 0) {
+                *eof = TRUE;
+                return 0;
+            }
+
+            if (errno == EINTR)
+                continue;
+
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                return 0;
+
+            return EIO;
+        }
+
+        if ((size_t)n <= space)
+            mrp_fragbuf_trim(t->buf, buf, space, n);
+        else {
+            if (!mrp_fragbuf_push(t->buf, spill, n - space))
+                return ENOMEM;
+        }
+
+        total += n;
+
+        if ((size_t)n < space + sizeof(spill))   /* socket drained */
+            return 0;
+    }
+
+    t->rdmore = TRUE;
+
+    return 0;
+}
+
+
+static inline int edge_triggered(strm_t *t)
+{
+    return t->edge || mrp_get_io_event_mode(t->ml) == MRP_IO_TRIGGER_EDGE;
+}
+
+
+static void read_cb(mrp_deferred_t *d, void *user_data)
+{
+    strm_t         *t = (strm_t *)user_data;
+    mrp_io_event_t  events;
+
+    mrp_disable_deferred(d);
+
+    events = MRP_IO_EVENT_IN | (t->rdhup ? MRP_IO_EVENT_HUP : 0);
+
+    strm_recv_cb(t->iow, t->sock, events, t);
+}
+
+
 static void strm_recv_cb(mrp_io_watch_t *w, int fd, mrp_io_event_t events,
                          void *user_data)
 {
     strm_t          *t  = (strm_t *)user_data;
     mrp_transport_t *mt = (mrp_transport_t *)t;
-    void            *data, *buf;
-    uint32_t         pending;
+    void            *data;
     size_t           size;
-    ssize_t          n;
-    int              error;
+    int              error, eof;
 
     MRP_UNUSED(w);
+    MRP_UNUSED(fd);
 
     mrp_debug("event 0x%x for transport %p", events, t);
 
+    eof = FALSE;
+
     if (events & MRP_IO_EVENT_IN) {
         if (MRP_UNLIKELY(mt->listened != 0)) {
             MRP_TRANSPORT_BUSY(mt, {
@@ -479,36 +680,19 @@ static void strm_recv_cb(mrp_io_watch_t *w, int fd, mrp_io_event_t events,
             return;
         }
 
-        while (ioctl(fd, FIONREAD, &pending) == 0 && pending > 0) {
-            buf = mrp_fragbuf_alloc(t->buf, pending);
-
-            if (buf == NULL) {
-                error = ENOMEM;
-            fatal_error:
-                mrp_debug("transport %p closed with error %d", mt, error);
-            closed:
-                strm_disconnect(mt);
+        if ((error = read_input(t, &eof)) != 0) {
+        fatal_error:
+            mrp_debug("transport %p closed with error %d", mt, error);
+        closed:
+            strm_disconnect(mt);
 
-                if (t->evt.closed != NULL)
-                    MRP_TRANSPORT_BUSY(mt, {
-                            mt->evt.closed(mt, error, mt->user_data);
-                        });
-
-                t->check_destroy(mt);
-                return;
-            }
-
-            n = read(fd, buf, pending);
-
-            if (n >= 0) {
-                if (n < (ssize_t)pending)
-                    mrp_fragbuf_trim(t->buf, buf, pending, n);
-            }
+            if (t->evt.closed != NULL)
+                MRP_TRANSPORT_BUSY(mt, {
+                        mt->evt.closed(mt, error, mt->user_data);
+                    });
 
-            if (n < 0 && errno != EAGAIN) {
-                error = EIO;
-                goto fatal_error;
-            }
+            t->check_destroy(mt);
+            return;
         }
 
         data = NULL;
@@ -533,9 +717,32 @@ static void strm_recv_cb(mrp_io_watch_t *w, int fd, mrp_io_event_t events,
             if (t->check_destroy(mt))
                 return;
         }
+
+        /*
+         * If we ran out of our read budget, there might be more input
+         * pending. In level-triggered mode we'll get notified about it
+         * again. In edge-triggered mode we won't, so we'll resume reading
+         * ourselves from a deferred callback once others had their turn.
+         */
+
+        if (t->rdmore && edge_triggered(t)) {
+            /* we won't get notified about a hangup again either */
+            if (events & MRP_IO_EVENT_HUP)
+                t->rdhup = TRUE;
+
+            if (t->rdd == NULL)
+                t->rdd = mrp_add_deferred(t->ml, read_cb, t);
+            else
+                mrp_enable_deferred(t->rdd);
+
+            if (t->rdd == NULL) {
+                error = ENOMEM;
+                goto fatal_error;
+            }
+        }
     }
 
-    if (events & MRP_IO_EVENT_HUP) {
+    if (((events & MRP_IO_EVENT_HUP) || eof) && !t->rdmore) {
         mrp_debug("transport %p closed by peer", mt);
         error = 0;
         goto closed;
@@ -581,8 +788,7 @@ static int open_socket(strm_t *t, int family)
 static int strm_connect(mrp_transport_t *mt, mrp_sockaddr_t *addr,
                         socklen_t addrlen)
 {
-    strm_t         *t    = (strm_t *)mt;
-    mrp_io_event_t  events;
+    strm_t *t = (strm_t *)mt;
 
     t->sock = socket(addr->any.sa_family, SOCK_STREAM, 0);
 
@@ -597,8 +803,7 @@ static int strm_connect(mrp_transport_t *mt, mrp_sockaddr_t *addr,
         t->buf = mrp_fragbuf_create(TRUE, 0);
 
         if (t->buf != NULL) {
-            events = MRP_IO_EVENT_IN | MRP_IO_EVENT_HUP;
-            t->iow = mrp_add_io_watch(t->ml, t->sock, events, strm_recv_cb, t);
+            t->iow = watch_input(t);
 
             if (t->iow != NULL) {
                 mrp_debug("connected transport %p", mt);
@@ -632,8 +837,15 @@ static int strm_disconnect(mrp_transport_t *mt)
         mrp_del_io_watch(t->iow);
         t->iow = NULL;
 
+        flush_output(t);                 /* try to get queued output out */
+
+        purge_output(t);
+
         shutdown(t->sock, SHUT_RDWR);
 
+        mrp_del_deferred(t->rdd);
+        t->rdd = NULL;
+
         mrp_fragbuf_destroy(t->buf);
         t->buf = NULL;
 
@@ -646,13 +858,354 @@ static int strm_disconnect(mrp_transport_t *mt)
 }
 
 
+static void init_input(strm_t *t, int edge, size_t budget)
+{
+    t->rdbudget = budget;
+    t->edge     = edge;
+    t->rdmore   = FALSE;
+    t->rdhup    = FALSE;
+    t->rdd      = NULL;
+}
+
+
+static mrp_io_watch_t *watch_input(strm_t *t)
+{
+    mrp_io_event_t events = MRP_IO_EVENT_IN | MRP_IO_EVENT_HUP;
+
+    if (t->edge && !t->listened)         /* accept one per notification */
+        events |= MRP_IO_TRIGGER_EDGE;
+
+    return mrp_add_io_watch(t->ml, t->sock, events, strm_recv_cb, t);
+}
+
+
+static void init_output(strm_t *t, size_t highwm, size_t lowwm)
+{
+    mrp_list_init(&t->oq);
+    t->oqsize    = 0;
+    t->highwm    = highwm;
+    t->lowwm     = lowwm;
+    t->congested = FALSE;
+    t->corked    = FALSE;
+    t->uncork    = NULL;
+}
+
+
+static void purge_output(strm_t *t)
+{
+    mrp_list_hook_t *p, *n;
+    obuf_t          *b;
+
+    mrp_del_io_watch(t->oow);
+    t->oow = NULL;
+
+    mrp_del_deferred(t->uncork);
+    t->uncork = NULL;
+    t->corked = FALSE;
+
+    if (t->oqsize > 0)
+        mrp_debug("dropping %zu bytes of queued output of transport %p",
+                  t->oqsize, t);
+
+    mrp_list_foreach(&t->oq, p, n) {
+        b = mrp_list_entry(p, typeof(*b), hook);
+        mrp_list_delete(&b->hook);
+        mrp_free(b);
+    }
+
+    t->oqsize    = 0;
+    t->congested = FALSE;
+}
+
+
+static void notify_congestion(strm_t *t, int congested)
+{
+    mrp_transport_t *mt = (mrp_transport_t *)t;
+
+    t->congested = congested;
+
+    mrp_debug("transport %p %s (%zu bytes queued)", t,
+              congested ? "congested" : "decongested", t->oqsize);
+
+    if (mt->evt.congested != NULL)
+        MRP_TRANSPORT_BUSY(mt, {
+                mt->evt.congested(mt, congested, mt->user_data);
+            });
+}
+
+
+static int queue_output(strm_t *t, struct iovec *iov, int iovcnt, size_t skip)
+{
+    mrp_io_event_t  events;
+    obuf_t         *b;
+    size_t          size, len;
+    char           *p;
+    int             i;
+
+    for (i = 0, size = 0; i < iovcnt; i++)
+        size += iov[i].iov_len;
+
+    size -= skip;
+
+    if ((b = mrp_allocz(sizeof(*b) + size)) == NULL)
+        return FALSE;
+
+    mrp_list_init(&b->hook);
+    b->size = size;
+
+    for (i = 0, p = b->data; i < iovcnt; i++) {
+        len = iov[i].iov_len;
+
+        if (skip >= len) {
+            skip -= len;
+            continue;
+        }
+
+        memcpy(p, iov[i].iov_base + skip, len - skip);
+        p    += len - skip;
+        skip  = 0;
+    }
+
+    if (t->oow == NULL && !t->corked) {
+        events = MRP_IO_EVENT_OUT;
+        t->oow = mrp_add_io_watch(t->ml, t->sock, events, strm_send_cb, t);
+
+        if (t->oow == NULL) {
+            mrp_free(b);
+            return FALSE;
+        }
+    }
+
+    mrp_list_append(&t->oq, &b->hook);
+    t->oqsize += size;
+
+    if (!t->congested && t->oqsize >= t->highwm)
+        notify_congestion(t, TRUE);
+
+    return TRUE;
+}
+
+
+static int strm_output(strm_t *t, struct iovec *iov, int iovcnt)
+{
+    ssize_t size, n;
+    int     i;
+
+    if (t->corked || !mrp_list_empty(&t->oq))
+        return queue_output(t, iov, iovcnt, 0);
+
+    for (i = 0, size = 0; i < iovcnt; i++)
+        size += iov[i].iov_len;
+
+    n = writev(t->sock, iov, iovcnt);
+
+    if (n == size)
+        return TRUE;
+
+    if (n < 0) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+            return FALSE;
+
+        n = 0;
+    }
+
+    return queue_output(t, iov, iovcnt, n);
+}
+
+
+static int flush_output(strm_t *t)
+{
+    struct iovec     iov[MAX_IOV];
+    mrp_list_hook_t *p, *n;
+    obuf_t          *b;
+    ssize_t          size, cnt, len;
+    int              i;
+
+    while (!mrp_list_empty(&t->oq)) {
+        i    = 0;
+        size = 0;
+
+        mrp_list_foreach(&t->oq, p, n) {
+            b = mrp_list_entry(p, typeof(*b), hook);
+
+            iov[i].iov_base = b->data + b->offs;
+            iov[i].iov_len  = b->size - b->offs;
+            size += iov[i].iov_len;
+
+            if (++i >= MAX_IOV)
+                break;
+        }
+
+        cnt = writev(t->sock, iov, i);
+
+        if (cnt < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                return 0;
+            return -1;
+        }
+
+        t->oqsize -= cnt;
+        size      -= cnt;
+
+        mrp_list_foreach(&t->oq, p, n) {
+            b   = mrp_list_entry(p, typeof(*b), hook);
+            len = b->size - b->offs;
+
+            if (cnt < len) {
+                b->offs += cnt;
+                break;
+            }
+
+            cnt -= len;
+            mrp_list_delete(&b->hook);
+            mrp_free(b);
+        }
+
+        if (size > 0)                    /* socket buffer full */
+            return 0;
+    }
+
+    return 0;
+}
+
+
+static void output_error(strm_t *t)
+{
+    mrp_transport_t *mt = (mrp_transport_t *)t;
+    int              error;
+
+    error = errno ? errno : EIO;
+    mrp_debug("transport %p closed with error %d", mt, error);
+
+    purge_output(t);                     /* don't retry the failed write */
+    strm_disconnect(mt);
+
+    if (t->evt.closed != NULL)
+        MRP_TRANSPORT_BUSY(mt, {
+                mt->evt.closed(mt, error, mt->user_data);
+            });
+
+    t->check_destroy(mt);
+}
+
+
+static void strm_send_cb(mrp_io_watch_t *w, int fd, mrp_io_event_t events,
+                         void *user_data)
+{
+    strm_t          *t  = (strm_t *)user_data;
+    mrp_transport_t *mt = (mrp_transport_t *)t;
+
+    MRP_UNUSED(w);
+    MRP_UNUSED(fd);
+
+    if (!(events & MRP_IO_EVENT_OUT))
+        return;
+
+    if (flush_output(t) < 0) {
+        output_error(t);
+        return;
+    }
+
+    if (mrp_list_empty(&t->oq)) {
+        mrp_del_io_watch(t->oow);
+        t->oow = NULL;
+    }
+
+    if (t->congested && t->oqsize <= t->lowwm) {
+        notify_congestion(t, FALSE);
+        t->check_destroy(mt);
+    }
+}
+
+
+static int uncork_output(strm_t *t)
+{
+    mrp_io_event_t events;
+
+    t->corked = FALSE;
+    mrp_disable_deferred(t->uncork);
+
+    if (flush_output(t) < 0)
+        return FALSE;
+
+    if (!mrp_list_empty(&t->oq) && t->oow == NULL) {
+        events = MRP_IO_EVENT_OUT;
+        t->oow = mrp_add_io_watch(t->ml, t->sock, events, strm_send_cb, t);
+
+        if (t->oow == NULL)
+            return FALSE;
+    }
+
+    return TRUE;
+}
+
+
+static void uncork_cb(mrp_deferred_t *d, void *user_data)
+{
+    strm_t          *t  = (strm_t *)user_data;
+    mrp_transport_t *mt = (mrp_transport_t *)t;
+
+    MRP_UNUSED(d);
+
+    if (!uncork_output(t)) {
+        output_error(t);
+        return;
+    }
+
+    if (t->congested && t->oqsize <= t->lowwm) {
+        notify_congestion(t, FALSE);
+        t->check_destroy(mt);
+    }
+}
+
+
+static int cork_output(strm_t *t, int cork)
+{
+    mrp_transport_t *mt = (mrp_transport_t *)t;
+
+    if (cork) {
+        if (!t->connected)
+            return FALSE;
+
+        if (t->uncork == NULL) {
+            t->uncork = mrp_add_deferred(t->ml, uncork_cb, t);
+
+            if (t->uncork == NULL)
+                return FALSE;
+        }
+        else
+            mrp_enable_deferred(t->uncork);
+
+        t->corked = TRUE;
+
+        return TRUE;
+    }
+
+    if (!t->corked)
+        return TRUE;
+
+    if (!uncork_output(t))
+        return FALSE;
+
+    if (t->congested && t->oqsize <= t->lowwm) {
+        notify_congestion(t, FALSE);
+        t->check_destroy(mt);
+    }
+
+    return TRUE;
+}
+
+
 static int strm_send(mrp_transport_t *mt, mrp_msg_t *msg)
 {
     strm_t        *t = (strm_t *)mt;
     struct iovec  iov[2];
     void         *buf;
-    ssize_t       size, n;
+    ssize_t       size;
     uint32_t      len;
+    int           success;
 
     if (t->connected) {
         size = mrp_msg_default_encode(msg, &buf);
@@ -664,18 +1217,10 @@ static int strm_send(mrp_transport_t *mt, mrp_msg_t *msg)
             iov[1].iov_base = buf;
             iov[1].iov_len  = size;
 
-            n = writev(t->sock, iov, 2);
+            success = strm_output(t, iov, 2);
             mrp_free(buf);
 
-            if (n == (ssize_t)(size + sizeof(len)))
-                return TRUE;
-            else {
-                if (n == -1 && errno == EAGAIN) {
-                    mrp_log_error("%s(): XXX TODO: this sucks, need to add "
-                                  "output queuing for strm-transport.",
-                                  __FUNCTION__);
-                }
-            }
+            return success;
         }
     }
 
@@ -685,21 +1230,14 @@ static int strm_send(mrp_transport_t *mt, mrp_msg_t *msg)
 
 static int strm_sendraw(mrp_transport_t *mt, void *data, size_t size)
 {
-    strm_t  *t = (strm_t *)mt;
-    ssize_t  n;
+    strm_t       *t = (strm_t *)mt;
+    struct iovec  iov[1];
 
     if (t->connected) {
-        n = write(t->sock, data, size);
+        iov[0].iov_base = data;
+        iov[0].iov_len  = size;
 
-        if (n == (ssize_t)size)
-            return TRUE;
-        else {
-            if (n == -1 && errno == EAGAIN) {
-                mrp_log_error("%s(): XXX TODO: this sucks, need to add "
-                              "output queuing for strm-transport.",
-                              __FUNCTION__);
-            }
-        }
+        return strm_output(t, iov, 1);
     }
 
     return FALSE;
@@ -710,11 +1248,12 @@ static int strm_senddata(mrp_transport_t *mt, void *data, uint16_t tag)
 {
     strm_t           *t = (strm_t *)mt;
     mrp_data_descr_t *type;
-    ssize_t           n;
+    struct iovec      iov[1];
     void             *buf;
     size_t            size, reserve, len;
     uint32_t         *lenp;
     uint16_t         *tagp;
+    int               success;
 
     if (t->connected) {
         type = mrp_msg_find_type(tag);
@@ -730,19 +1269,14 @@ static int strm_senddata(mrp_transport_t *mt, void *data, uint16_t tag)
                 *lenp = htobe32(len);
                 *tagp = htobe16(tag);
 
-                n = write(t->sock, buf, len + sizeof(*lenp));
+                iov[0].iov_base = buf;
+                iov[0].iov_len  = len + sizeof(*lenp);
+
+                success = strm_output(t, iov, 1);
 
                 mrp_free(buf);
 
-                if (n == (ssize_t)(len + sizeof(*lenp)))
-                    return TRUE;
-                else {
-                    if (n == -1 && errno == EAGAIN) {
-                        mrp_log_error("%s(): XXX TODO: this sucks, need to add"
-                                      " output queueing for strm-transport.",
-                                      __FUNCTION__);
-                    }
-                }
+                return success;
             }
         }
     }
@@ -755,10 +1289,11 @@ static int strm_sendnative(mrp_transport_t *mt, void *data, uint32_t type_id)
 {
     strm_t        *t   = (strm_t *)mt;
     mrp_typemap_t *map = t->map;
+    struct iovec   iov[1];
     void          *buf;
     size_t         size, reserve;
     uint32_t      *lenp;
-    ssize_t        n;
+    int            success;
 
     if (t->connected) {
         reserve = sizeof(*lenp);
@@ -767,19 +1302,14 @@ static int strm_sendnative(mrp_transport_t *mt, void *data, uint32_t type_id)
             lenp  = buf;
             *lenp = htobe32(size - sizeof(*lenp));
 
-            n = write(t->sock, buf, size);
+            iov[0].iov_base = buf;
+            iov[0].iov_len  = size;
+
+            success = strm_output(t, iov, 1);
 
             mrp_free(buf);
 
-            if (n == (ssize_t)size)
-                return TRUE;
-            else {
-                if (n == -1 && errno == EAGAIN) {
-                    mrp_log_error("%s(): XXX TODO: this sucks, need to add"
-                                  " output queueing for strm-transport.",
-                                  __FUNCTION__);
-                }
-            }
+            return success;
         }
     }
 
@@ -792,7 +1322,7 @@ static int strm_sendjson(mrp_transport_t *mt, mrp_json_t *msg)
     strm_t       *t = (strm_t *)mt;
     struct iovec  iov[2];
     const char   *s;
-    ssize_t       size, n;
+    ssize_t       size;
     uint32_t      len;
 
     if (t->connected && (s = mrp_json_object_to_string(msg)) != NULL) {
@@ -803,17 +1333,7 @@ static int strm_sendjson(mrp_transport_t *mt, mrp_json_t *msg)
         iov[1].iov_base = (void *)s;
         iov[1].iov_len  = size;
 
-        n = writev(t->sock, iov, 2);
-
-        if (n == (ssize_t)(size + sizeof(len)))
-            return TRUE;
-        else {
-            if (n == -1 && errno == EAGAIN) {
-                mrp_log_error("%s(): XXX TODO: this sucks, need to add "
-                              "output queuing for strm-transport.",
-                              __FUNCTION__);
-            }
-        }
+        return strm_output(t, iov, 2);
     }
 
     return FALSE;
@@ -821,7 +1341,7 @@ static int strm_sendjson(mrp_transport_t *mt, mrp_json_t *msg)
 
 
 MRP_REGISTER_TRANSPORT(tcp4, TCP4, strm_t, strm_resolve,
-                       strm_open, strm_createfrom, strm_close, NULL,
+                       strm_open, strm_createfrom, strm_close, strm_setopt,
                        strm_bind, strm_listen, strm_accept,
                        strm_connect, strm_disconnect,
                        strm_send, NULL,
@@ -832,7 +1352,7 @@ MRP_REGISTER_TRANSPORT(tcp4, TCP4, strm_t, strm_resolve,
                        strm_sendjson, NULL);
 
 MRP_REGISTER_TRANSPORT(tcp6, TCP6, strm_t, strm_resolve,
-                       strm_open, strm_createfrom, strm_close, NULL,
+                       strm_open, strm_createfrom, strm_close, strm_setopt,
                        strm_bind, strm_listen, strm_accept,
                        strm_connect, strm_disconnect,
                        strm_send, NULL,
@@ -843,7 +1363,7 @@ MRP_REGISTER_TRANSPORT(tcp6, TCP6, strm_t, strm_resolve,
                        strm_sendjson, NULL);
 
 MRP_REGISTER_TRANSPORT(unxstrm, UNXS, strm_t, strm_resolve,
-                       strm_open, strm_createfrom, strm_close, NULL,
+                       strm_open, strm_createfrom, strm_close, strm_setopt,
                        strm_bind, strm_listen, strm_accept,
                        strm_connect, strm_disconnect,
                        strm_send, NULL,
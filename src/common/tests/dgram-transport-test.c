@@ -0,0 +1,272 @@
+/*
+ * Copyright (c) 2012, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/ioctl.h>
+
+#include <murphy/common/macros.h>
+#include <murphy/common/mm.h>
+#include <murphy/common/mainloop.h>
+#include <murphy/common/msg.h>
+#include <murphy/common/transport.h>
+
+#define NCORK    8                       /* messages to send while corked */
+#define NBURST   2048                    /* messages to overflow the peer */
+#define PAYLOAD  512                     /* payload size per message */
+#define SOCKBUF  4096                    /* socket buffer size */
+#define TIMEOUT  10000                   /* test timeout in msecs */
+
+#define TAG_SEQ     1
+#define TAG_PAYLOAD 2
+
+#define fatal(fmt, args...) do {                                          \
+        fprintf(stderr, "fatal error: "fmt"\n" , ## args);                \
+        exit(1);                                                          \
+    } while (0)
+
+static mrp_mainloop_t  *ml;
+static mrp_transport_t *tx, *rx;
+static int              fds[2];
+static int              nrecv;
+
+
+static void recv_evt(mrp_transport_t *t, mrp_msg_t *msg, void *user_data)
+{
+    uint32_t seq;
+
+    MRP_UNUSED(t);
+    MRP_UNUSED(user_data);
+
+    if (!mrp_msg_get(msg, TAG_SEQ, MRP_MSG_FIELD_UINT32, &seq, MRP_MSG_END))
+        fatal("received malformed message #%d", nrecv);
+
+    if (seq != (uint32_t)nrecv)
+        fatal("received message #%u, expected #%d", seq, nrecv);
+
+    nrecv++;
+}
+
+
+static void recvfrom_evt(mrp_transport_t *t, mrp_msg_t *msg,
+                         mrp_sockaddr_t *addr, socklen_t addrlen,
+                         void *user_data)
+{
+    MRP_UNUSED(addr);
+    MRP_UNUSED(addrlen);
+
+    recv_evt(t, msg, user_data);
+}
+
+
+static void closed_evt(mrp_transport_t *t, int error, void *user_data)
+{
+    MRP_UNUSED(t);
+    MRP_UNUSED(user_data);
+
+    fatal("transport closed unexpectedly (%d: %s)", error, strerror(error));
+}
+
+
+static void timeout_cb(mrp_timer_t *t, void *user_data)
+{
+    MRP_UNUSED(t);
+    MRP_UNUSED(user_data);
+
+    fatal("timed out with %d messages received", nrecv);
+}
+
+
+static void send_seq(uint32_t seq)
+{
+    char       payload[PAYLOAD];
+    mrp_msg_t *msg;
+
+    memset(payload, 'a' + seq % 26, sizeof(payload) - 1);
+    payload[sizeof(payload) - 1] = '\0';
+
+    msg = mrp_msg_create(TAG_SEQ    , MRP_MSG_FIELD_UINT32, seq,
+                         TAG_PAYLOAD, MRP_MSG_FIELD_STRING, payload,
+                         MRP_MSG_END);
+
+    if (msg == NULL || !mrp_transport_send(tx, msg))
+        fatal("failed to send message #%u", seq);
+
+    mrp_msg_unref(msg);
+}
+
+
+static int pending_input(void)
+{
+    int n;
+
+    if (ioctl(fds[1], FIONREAD, &n) < 0)
+        fatal("failed to query pending input (%d: %s)", errno,
+              strerror(errno));
+
+    return n;
+}
+
+
+static void create_transports(void)
+{
+    mrp_transport_evt_t evt;
+    int                 size, flags, state;
+
+    if (socketpair(AF_UNIX, SOCK_DGRAM, 0, fds) < 0)
+        fatal("failed to create socket pair (%d: %s)", errno, strerror(errno));
+
+    size = SOCKBUF;
+    setsockopt(fds[0], SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+
+    mrp_clear(&evt);
+    evt.recvmsg     = recv_evt;
+    evt.recvmsgfrom = recvfrom_evt;
+    evt.closed      = closed_evt;
+
+    flags = MRP_TRANSPORT_NONBLOCK | MRP_TRANSPORT_MODE_MSG;
+    state = MRP_TRANSPORT_CONNECTED;
+    tx    = mrp_transport_create_from(ml, "unxd", &fds[0], &evt, NULL,
+                                      flags, state);
+    rx    = mrp_transport_create_from(ml, "unxd", &fds[1], &evt, NULL,
+                                      flags, state);
+
+    if (tx == NULL || rx == NULL)
+        fatal("failed to create transports");
+}
+
+
+/*
+ * Cork the sending transport and send a few messages. Nothing may be
+ * sent until the transport gets uncorked, either explicitly or at the
+ * end of the mainloop iteration. Messages sent while corked must also
+ * get sent if the transport is closed before it would be uncorked.
+ */
+
+static void test_cork(void)
+{
+    uint32_t i;
+
+    if (!mrp_transport_cork(tx))
+        fatal("failed to cork transport");
+
+    for (i = 0; i < NCORK / 2; i++)
+        send_seq(i);
+
+    if (pending_input() != 0)
+        fatal("corked transport sent a datagram");
+
+    if (!mrp_transport_uncork(tx))
+        fatal("failed to uncork transport");
+
+    if (pending_input() == 0)
+        fatal("uncorking did not send the batched datagrams");
+
+    while (nrecv < NCORK / 2)
+        mrp_mainloop_iterate(ml);
+
+    mrp_transport_cork(tx);
+
+    for (; i < NCORK - 2; i++)
+        send_seq(i);
+
+    if (pending_input() != 0)
+        fatal("corked transport sent a datagram");
+
+    while (nrecv < NCORK - 2)
+        mrp_mainloop_iterate(ml);
+
+    mrp_transport_cork(tx);
+
+    for (; i < NCORK; i++)
+        send_seq(i);
+
+    mrp_transport_destroy(tx);
+    tx = NULL;
+
+    while (nrecv < NCORK)
+        mrp_mainloop_iterate(ml);
+}
+
+
+/*
+ * Send a corked burst of more datagrams than the peer can hold. The ones
+ * that do not fit must stay queued and get sent in order once the peer
+ * has read enough to make room for them.
+ */
+
+static void test_overflow(void)
+{
+    uint32_t i;
+
+    nrecv = 0;
+
+    mrp_transport_cork(tx);
+
+    for (i = 0; i < NBURST; i++)
+        send_seq(i);
+
+    if (!mrp_transport_uncork(tx))
+        fatal("failed to uncork transport");
+
+    while (nrecv < NBURST)
+        mrp_mainloop_iterate(ml);
+}
+
+
+int main(int argc, char *argv[])
+{
+    MRP_UNUSED(argc);
+    MRP_UNUSED(argv);
+
+    if ((ml = mrp_mainloop_create()) == NULL)
+        fatal("failed to create mainloop");
+
+    if (mrp_add_timer(ml, TIMEOUT, timeout_cb, NULL) == NULL)
+        fatal("failed to create timeout timer");
+
+    create_transports();
+    test_cork();
+    mrp_transport_destroy(rx);
+
+    create_transports();
+    test_overflow();
+    mrp_transport_destroy(tx);
+    mrp_transport_destroy(rx);
+
+    mrp_mainloop_destroy(ml);
+
+    printf("datagram transport tests passed\n");
+
+    return 0;
+}
@@ -0,0 +1,276 @@
+/*
+ * Copyright (c) 2012, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <murphy/common/macros.h>
+#include <murphy/common/mm.h>
+#include <murphy/common/mask.h>
+#include <murphy/common/msg.h>
+#include <murphy/common/mainloop.h>
+
+#define NEVENT   (3 * 64 + 5)            /* enough to overflow the ring */
+#define CHAINED  10                      /* emit one more when delivered */
+#define DELETE   20                      /* delete late watch when delivered */
+#define TAG_SEQ  1
+
+#define fatal(fmt, args...) do {                                          \
+        fprintf(stderr, "fatal error: "fmt"\n" , ## args);                \
+        exit(1);                                                          \
+    } while (0)
+
+static mrp_mainloop_t    *ml;
+static mrp_event_bus_t   *bus;
+static uint32_t           ev_a, ev_b;
+static mrp_event_watch_t *w_all, *w_b, *w_late;
+static int                nall, nb, nlate, nsync;
+
+
+static uint32_t event_seq(int format, void *data)
+{
+    uint32_t seq;
+
+    if (format != MRP_EVENT_FORMAT_MSG ||
+        !mrp_msg_get((mrp_msg_t *)data,
+                     TAG_SEQ, MRP_MSG_FIELD_UINT32, &seq,
+                     MRP_MSG_END))
+        fatal("received event with malformed data");
+
+    return seq;
+}
+
+
+static uint32_t event_for(uint32_t seq)
+{
+    return (seq % 3) ? ev_a : ev_b;
+}
+
+
+static void emit_async(uint32_t seq)
+{
+    if (mrp_event_emit_msg(bus, event_for(seq), MRP_EVENT_ASYNCHRONOUS,
+                           TAG_SEQ, MRP_MSG_FIELD_UINT32, seq) < 0)
+        fatal("failed to emit event #%u", seq);
+}
+
+
+static void all_cb(mrp_event_watch_t *w, uint32_t id, int format,
+                   void *data, void *user_data)
+{
+    uint32_t seq = event_seq(format, data);
+
+    MRP_UNUSED(w);
+    MRP_UNUSED(user_data);
+
+    if (seq != (uint32_t)nall)
+        fatal("received event #%u, expected #%d", seq, nall);
+
+    if (id != event_for(seq))
+        fatal("received event #%u with wrong id %u", seq, id);
+
+    nall++;
+
+    /* emitted while pumping: must be delivered after all earlier ones */
+    if (seq == CHAINED)
+        emit_async(NEVENT);
+
+    /* the late watch comes after us, so it must not see this event */
+    if (seq == DELETE) {
+        mrp_event_del_watch(w_late);
+        w_late = NULL;
+    }
+
+    if (nall == NEVENT + 1)
+        mrp_mainloop_quit(ml, 0);
+}
+
+
+static void b_cb(mrp_event_watch_t *w, uint32_t id, int format,
+                 void *data, void *user_data)
+{
+    uint32_t seq = event_seq(format, data);
+
+    MRP_UNUSED(w);
+    MRP_UNUSED(user_data);
+
+    if (id != ev_b || seq % 3)
+        fatal("event #%u delivered to a watch not subscribed to it", seq);
+
+    nb++;
+}
+
+
+static void late_cb(mrp_event_watch_t *w, uint32_t id, int format,
+                    void *data, void *user_data)
+{
+    uint32_t seq = event_seq(format, data);
+
+    MRP_UNUSED(w);
+    MRP_UNUSED(id);
+    MRP_UNUSED(user_data);
+
+    if (seq >= DELETE)
+        fatal("event #%u delivered to a deleted watch", seq);
+
+    nlate++;
+}
+
+
+static void sync_cb(mrp_event_watch_t *w, uint32_t id, int format,
+                    void *data, void *user_data)
+{
+    MRP_UNUSED(w);
+    MRP_UNUSED(id);
+    MRP_UNUSED(user_data);
+
+    event_seq(format, data);
+    nsync++;
+}
+
+
+static void timeout_cb(mrp_timer_t *t, void *user_data)
+{
+    MRP_UNUSED(t);
+    MRP_UNUSED(user_data);
+
+    fatal("timed out with %d of %d events delivered", nall, NEVENT + 1);
+}
+
+
+/*
+ * Emit more asynchronous events than fit the pending event ring, so that
+ * some go to the overflow queue, and check that they are all delivered,
+ * in order and only to the watches subscribed to them. Also check that
+ * an event emitted while events are being pumped comes last, and that a
+ * watch deleted while an event is being emitted won't get it anymore.
+ */
+
+static void test_async_events(void)
+{
+    mrp_event_mask_t mask;
+    uint32_t         i;
+    int              expected_b, expected_late;
+
+    mrp_mask_init(&mask);
+
+    if (!mrp_mask_set(&mask, ev_a) || !mrp_mask_set(&mask, ev_b))
+        fatal("failed to set up event mask");
+
+    w_all  = mrp_event_add_watch_mask(bus, &mask, all_cb, NULL);
+    w_b    = mrp_event_add_watch(bus, ev_b, b_cb, NULL);
+    w_late = mrp_event_add_watch(bus, ev_a, late_cb, NULL);
+
+    mrp_mask_reset(&mask);
+
+    if (w_all == NULL || w_b == NULL || w_late == NULL)
+        fatal("failed to add event watches");
+
+    expected_b = expected_late = 0;
+
+    for (i = 0; i < NEVENT; i++) {
+        emit_async(i);
+
+        if (event_for(i) == ev_b)
+            expected_b++;
+        else if (i < DELETE)
+            expected_late++;
+    }
+
+    if (nall != 0)
+        fatal("asynchronous events delivered synchronously");
+
+    if (mrp_add_timer(ml, 10000, timeout_cb, NULL) == NULL)
+        fatal("failed to create timeout timer");
+
+    mrp_mainloop_run(ml);
+
+    if (nall != NEVENT + 1 || nb != expected_b || nlate != expected_late)
+        fatal("got %d/%d/%d events, expected %d/%d/%d", nall, nb, nlate,
+              NEVENT + 1, expected_b, expected_late);
+
+    mrp_event_del_watch(w_all);
+    mrp_event_del_watch(w_b);
+}
+
+
+static void test_sync_events(void)
+{
+    mrp_event_watch_t *w;
+
+    w = mrp_event_add_watch(MRP_GLOBAL_BUS, ev_a, sync_cb, NULL);
+
+    if (w == NULL)
+        fatal("failed to add global event watch");
+
+    if (mrp_event_emit_msg(MRP_GLOBAL_BUS, ev_a, MRP_EVENT_SYNCHRONOUS,
+                           TAG_SEQ, MRP_MSG_FIELD_UINT32, 1) < 0 ||
+        mrp_event_emit_msg(MRP_GLOBAL_BUS, ev_b, MRP_EVENT_SYNCHRONOUS,
+                           TAG_SEQ, MRP_MSG_FIELD_UINT32, 2) < 0)
+        fatal("failed to emit synchronous events");
+
+    if (nsync != 1)
+        fatal("got %d synchronous events instead of 1", nsync);
+
+    mrp_event_del_watch(w);
+}
+
+
+int main(int argc, char *argv[])
+{
+    int i;
+
+    MRP_UNUSED(argc);
+    MRP_UNUSED(argv);
+
+    if ((ml = mrp_mainloop_create()) == NULL)
+        fatal("failed to create mainloop");
+
+    if ((bus = mrp_event_bus_get(ml, "test")) == NULL)
+        fatal("failed to create event bus");
+
+    ev_a = mrp_event_id("test-event-a");
+    ev_b = mrp_event_id("test-event-b");
+
+    if (ev_a == MRP_EVENT_UNKNOWN || ev_b == MRP_EVENT_UNKNOWN)
+        fatal("failed to register events");
+
+    test_async_events();
+    test_sync_events();
+
+    /* events still pending get released with the mainloop */
+    for (i = 0; i < NEVENT; i++)
+        emit_async(i);
+
+    mrp_mainloop_destroy(ml);
+
+    printf("event tests passed\n");
+
+    return 0;
+}
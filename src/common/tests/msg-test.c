@@ -27,6 +27,9 @@
  * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <errno.h>
+#include <sys/socket.h>
+
 #include <murphy/common.h>
 
 #include <murphy/common/msg.h>
@@ -589,12 +592,789 @@ static void test_basic(void)
 }
 
 
+static void check_str(mrp_msg_t *msg, uint16_t tag, const char *expected,
+                      const char *which)
+{
+    char *str;
+
+    if (expected == NULL) {
+        if (mrp_msg_find(msg, tag) != NULL) {
+            mrp_log_error("%s: unexpected field 0x%x found.", which, tag);
+            exit(1);
+        }
+        return;
+    }
+
+    if (!mrp_msg_get(msg, tag, MRP_MSG_FIELD_STRING, &str, MRP_MSG_END)) {
+        mrp_log_error("%s: field 0x%x not found.", which, tag);
+        exit(1);
+    }
+
+    if (strcmp(str, expected)) {
+        mrp_log_error("%s: field 0x%x is '%s', expected '%s'.", which, tag,
+                      str, expected);
+        exit(1);
+    }
+}
+
+
+static void check_u32(mrp_msg_t *msg, uint16_t tag, uint32_t expected,
+                      const char *which)
+{
+    uint32_t u32;
+
+    if (!mrp_msg_get(msg, tag, MRP_MSG_FIELD_UINT32, &u32, MRP_MSG_END)) {
+        mrp_log_error("%s: field 0x%x not found.", which, tag);
+        exit(1);
+    }
+
+    if (u32 != expected) {
+        mrp_log_error("%s: field 0x%x is %u, expected %u.", which, tag,
+                      u32, expected);
+        exit(1);
+    }
+}
+
+
+static void check_shared(mrp_msg_t *msg, mrp_msg_t *owner, int refcnt,
+                         const char *which)
+{
+    if (mrp_msg_body(msg) != owner) {
+        mrp_log_error("%s: message does not share its fields.", which);
+        exit(1);
+    }
+
+    if (owner->refcnt != refcnt) {
+        mrp_log_error("%s: shared fields have %d references, expected %d.",
+                      which, owner->refcnt, refcnt);
+        exit(1);
+    }
+}
+
+
+static void test_share(void)
+{
+    mrp_msg_t *orig, *copy1, *copy2, *copy3, *owner;
+
+    orig = mrp_msg_create(MRP_MSG_TAG_STRING(0x1, "original"),
+                          MRP_MSG_TAG_UINT32(0x2, 2),
+                          MRP_MSG_END);
+
+    if (orig == NULL) {
+        mrp_log_error("Failed to create message.");
+        exit(1);
+    }
+
+    copy1 = mrp_msg_share(orig);
+    copy2 = mrp_msg_share(orig);
+    copy3 = mrp_msg_share(copy2);
+
+    if (copy1 == NULL || copy2 == NULL || copy3 == NULL) {
+        mrp_log_error("Failed to share message.");
+        exit(1);
+    }
+
+    owner = mrp_msg_body(orig);
+
+    if (owner == orig) {
+        mrp_log_error("Shared message still holds its own fields.");
+        exit(1);
+    }
+
+    check_shared(orig , owner, 4, "original");
+    check_shared(copy1, owner, 4, "copy #1");
+    check_shared(copy2, owner, 4, "copy #2");
+    check_shared(copy3, owner, 4, "copy #3");
+
+    /* setting a field in one copy must not be seen by the others */
+    if (!mrp_msg_set(copy1, 0x1, MRP_MSG_FIELD_STRING, "copy #1")) {
+        mrp_log_error("Failed to set field in shared message.");
+        exit(1);
+    }
+
+    check_shared(orig, owner, 3, "original after set");
+    check_str(copy1, 0x1, "copy #1" , "copy #1 after set");
+    check_str(orig , 0x1, "original", "original after set");
+    check_str(copy2, 0x1, "original", "copy #2 after set");
+
+    /* neither must appending a field to the original */
+    if (!mrp_msg_append(orig, MRP_MSG_TAG_UINT32(0x3, 3))) {
+        mrp_log_error("Failed to append field to shared message.");
+        exit(1);
+    }
+
+    check_shared(copy2, owner, 2, "copy #2 after append");
+    check_u32(orig , 0x3, 3   , "original after append");
+    check_str(orig , 0x1, "original", "original after append");
+    check_str(copy1, 0x3, NULL, "copy #1 after append");
+    check_str(copy2, 0x3, NULL, "copy #2 after append");
+
+    /* nor removing a field from a copy of a copy */
+    if (!mrp_msg_remove(copy2, 0x2)) {
+        mrp_log_error("Failed to remove field from shared message.");
+        exit(1);
+    }
+
+    check_shared(copy3, owner, 1, "copy #3 after remove");
+    check_str(copy2, 0x2, NULL, "copy #2 after remove");
+    check_str(copy2, 0x1, "original", "copy #2 after remove");
+    check_u32(copy3, 0x2, 2   , "copy #3 after remove");
+    check_u32(orig , 0x2, 2   , "original after remove");
+    check_u32(copy1, 0x2, 2   , "copy #1 after remove");
+
+    if (mrp_msg_remove(copy3, 0x9)) {
+        mrp_log_error("Removed non-existent field from shared message.");
+        exit(1);
+    }
+
+    mrp_msg_unref(orig);
+    mrp_msg_unref(copy1);
+    mrp_msg_unref(copy2);
+    mrp_msg_unref(copy3);
+
+    /* an empty message can be shared and modified, too */
+    orig  = mrp_msg_create_empty();
+    copy1 = orig ? mrp_msg_share(orig) : NULL;
+
+    if (copy1 == NULL) {
+        mrp_log_error("Failed to share empty message.");
+        exit(1);
+    }
+
+    if (!mrp_msg_append(copy1, MRP_MSG_TAG_STRING(0x1, "appended"))) {
+        mrp_log_error("Failed to append field to shared empty message.");
+        exit(1);
+    }
+
+    check_str(copy1, 0x1, "appended", "shared empty message");
+    check_str(orig , 0x1, NULL      , "empty message");
+
+    mrp_msg_unref(orig);
+    mrp_msg_unref(copy1);
+
+    mrp_log_info("Copy-on-write message modifications OK.");
+}
+
+
+static void test_share_unref(void)
+{
+    mrp_msg_t *orig, *copy1, *copy2, *owner;
+
+    /* drop the original first, then the copies */
+    orig  = mrp_msg_create(MRP_MSG_TAG_STRING(0x1, "shared"), MRP_MSG_END);
+    copy1 = orig  ? mrp_msg_share(orig)  : NULL;
+    copy2 = copy1 ? mrp_msg_share(copy1) : NULL;
+
+    if (copy2 == NULL) {
+        mrp_log_error("Failed to create shared messages.");
+        exit(1);
+    }
+
+    owner = mrp_msg_body(orig);
+
+    mrp_msg_unref(orig);
+    check_shared(copy1, owner, 2, "copy #1 after original unref");
+    check_str(copy1, 0x1, "shared", "copy #1 after original unref");
+
+    mrp_msg_unref(copy2);
+    check_shared(copy1, owner, 1, "copy #1 after copy #2 unref");
+    check_str(copy1, 0x1, "shared", "copy #1 after copy #2 unref");
+
+    /* the last reference gets a private copy even if nobody else is left */
+    if (!mrp_msg_set(copy1, 0x1, MRP_MSG_FIELD_STRING, "private")) {
+        mrp_log_error("Failed to set field in last shared message.");
+        exit(1);
+    }
+
+    check_str(copy1, 0x1, "private", "copy #1 after set");
+    mrp_msg_unref(copy1);
+
+    /* drop the copies first, then the original */
+    orig  = mrp_msg_create(MRP_MSG_TAG_STRING(0x1, "shared"), MRP_MSG_END);
+    copy1 = orig  ? mrp_msg_share(orig)  : NULL;
+    copy2 = copy1 ? mrp_msg_share(orig)  : NULL;
+
+    if (copy2 == NULL) {
+        mrp_log_error("Failed to create shared messages.");
+        exit(1);
+    }
+
+    owner = mrp_msg_body(orig);
+
+    mrp_msg_unref(copy2);
+    mrp_msg_unref(copy1);
+    check_shared(orig, owner, 1, "original after copy unrefs");
+    check_str(orig, 0x1, "shared", "original after copy unrefs");
+
+    mrp_msg_unref(orig);
+
+    mrp_log_info("Shared message unref order OK.");
+}
+
+
+/*
+ * Send the same message to several peers over the internal transport.
+ * Every peer should get a copy-on-write reference to the same fields,
+ * and neither the sender nor any of the peers may see changes made to
+ * the message by the others.
+ */
+
+#define NPEER 3
+
+typedef struct {
+    mrp_transport_t *t;
+    mrp_msg_t       *msg;
+} peer_t;
+
+
+static void peer_recvfrom(mrp_transport_t *t, mrp_msg_t *msg,
+                          mrp_sockaddr_t *addr, socklen_t addrlen,
+                          void *user_data)
+{
+    peer_t *peer = user_data;
+
+    MRP_UNUSED(t);
+    MRP_UNUSED(addr);
+    MRP_UNUSED(addrlen);
+
+    if (peer == NULL)
+        return;
+
+    if (peer->msg != NULL) {
+        mrp_log_error("Peer received the message more than once.");
+        exit(1);
+    }
+
+    peer->msg = mrp_msg_ref(msg);
+}
+
+
+static void test_shared_delivery(void)
+{
+    mrp_transport_evt_t  evt;
+    mrp_mainloop_t      *ml;
+    mrp_transport_t     *t;
+    peer_t               peers[NPEER];
+    mrp_sockaddr_t       addr[NPEER];
+    socklen_t            alen[NPEER];
+    mrp_msg_t           *msg, *body;
+    char                 name[64];
+    int                  i, n, flags;
+
+    if ((ml = mrp_mainloop_create()) == NULL) {
+        mrp_log_error("Failed to create mainloop.");
+        exit(1);
+    }
+
+    mrp_clear(&evt);
+    evt.recvmsgfrom = peer_recvfrom;
+    flags = MRP_TRANSPORT_MODE_MSG;
+
+    mrp_clear(&peers);
+
+    for (i = 0; i < NPEER; i++) {
+        snprintf(name, sizeof(name), "internal:msg-test-peer%d", i);
+
+        peers[i].t = mrp_transport_create(ml, "internal", &evt, peers + i,
+                                          flags);
+        alen[i] = mrp_transport_resolve(NULL, name, addr + i, sizeof(addr[i]),
+                                        NULL);
+
+        if (peers[i].t == NULL || alen[i] <= 0 ||
+            !mrp_transport_bind(peers[i].t, addr + i, alen[i])) {
+            mrp_log_error("Failed to set up internal peer #%d.", i);
+            exit(1);
+        }
+    }
+
+    t = mrp_transport_create(ml, "internal", &evt, NULL, flags);
+
+    if (t == NULL) {
+        mrp_log_error("Failed to create internal transport.");
+        exit(1);
+    }
+
+    msg = mrp_msg_create(MRP_MSG_TAG_STRING(0x1, "broadcast"),
+                         MRP_MSG_TAG_UINT32(0x2, 1),
+                         MRP_MSG_END);
+
+    if (msg == NULL) {
+        mrp_log_error("Failed to create message.");
+        exit(1);
+    }
+
+    for (i = 0; i < NPEER; i++) {
+        if (!mrp_transport_sendto(t, msg, addr + i, alen[i])) {
+            mrp_log_error("Failed to send message to peer #%d.", i);
+            exit(1);
+        }
+    }
+
+    body = mrp_msg_body(msg);
+
+    /* changes made after sending must not show up at the peers */
+    if (!mrp_msg_set(msg, 0x2, MRP_MSG_FIELD_UINT32, 2)) {
+        mrp_log_error("Failed to set field in sent message.");
+        exit(1);
+    }
+
+    for (n = 0; n < 100; n++) {
+        for (i = 0; i < NPEER; i++)
+            if (peers[i].msg == NULL)
+                break;
+
+        if (i == NPEER)
+            break;
+
+        mrp_mainloop_iterate(ml);
+    }
+
+    if (n == 100) {
+        mrp_log_error("Message was not delivered to peer #%d.", i);
+        exit(1);
+    }
+
+    for (i = 0; i < NPEER; i++) {
+        snprintf(name, sizeof(name), "peer #%d", i);
+        check_shared(peers[i].msg, body, NPEER, name);
+        check_u32(peers[i].msg, 0x2, 1, name);
+    }
+
+    check_u32(msg, 0x2, 2, "sender");
+
+    if (!mrp_msg_set(peers[0].msg, 0x1, MRP_MSG_FIELD_STRING, "peer #0")) {
+        mrp_log_error("Failed to set field in delivered message.");
+        exit(1);
+    }
+
+    check_str(peers[0].msg, 0x1, "peer #0", "peer #0 after set");
+
+    for (i = 1; i < NPEER; i++) {
+        snprintf(name, sizeof(name), "peer #%d after set", i);
+        check_str(peers[i].msg, 0x1, "broadcast", name);
+    }
+
+    check_str(msg, 0x1, "broadcast", "sender after set");
+
+    mrp_msg_unref(msg);
+
+    for (i = 0; i < NPEER; i++) {
+        mrp_msg_unref(peers[i].msg);
+        mrp_transport_destroy(peers[i].t);
+    }
+
+    mrp_transport_destroy(t);
+    mrp_mainloop_destroy(ml);
+
+    mrp_log_info("Shared message delivery over internal transport OK.");
+}
+
+
+/*
+ * Messages with enough fields are looked up through a (tag, position)
+ * index. Check that lookups stay correct as fields get inserted and
+ * removed, shifting the positions of the others.
+ */
+
+#define NINDEXED 12
+#define TAG_BASE 0x10
+
+static void check_found(mrp_msg_t *msg, uint16_t tag, uint32_t expected,
+                        const char *which)
+{
+    mrp_msg_field_t *f;
+
+    if ((f = mrp_msg_find(msg, tag)) == NULL) {
+        mrp_log_error("%s: field 0x%x not found.", which, tag);
+        exit(1);
+    }
+
+    if (f->tag != tag || f->type != MRP_MSG_FIELD_UINT32 ||
+        f->u32 != expected) {
+        mrp_log_error("%s: field 0x%x lookup found 0x%x (%u), expected %u.",
+                      which, tag, f->tag, f->u32, expected);
+        exit(1);
+    }
+}
+
+
+static void check_indexed(mrp_msg_t *msg, int first, int last,
+                          const char *which)
+{
+    char name[64];
+    int  i;
+
+    for (i = first; i <= last; i++) {
+        snprintf(name, sizeof(name), "%s, field #%d", which, i);
+        check_found(msg, TAG_BASE + i, TAG_BASE + i, name);
+    }
+
+    if (msg->index == NULL) {
+        mrp_log_error("%s: no index built for %zu fields.", which,
+                      msg->nfield);
+        exit(1);
+    }
+}
+
+
+static void test_index(void)
+{
+    mrp_msg_t *msg;
+    int        i;
+
+    if ((msg = mrp_msg_create_empty()) == NULL) {
+        mrp_log_error("Failed to create message.");
+        exit(1);
+    }
+
+    for (i = 0; i < NINDEXED; i++) {
+        if (!mrp_msg_append(msg, MRP_MSG_TAG_UINT32(TAG_BASE + i,
+                                                    TAG_BASE + i))) {
+            mrp_log_error("Failed to append field #%d.", i);
+            exit(1);
+        }
+    }
+
+    check_indexed(msg, 0, NINDEXED - 1, "indexed");
+
+    if (mrp_msg_find(msg, TAG_BASE - 1) != NULL ||
+        mrp_msg_find(msg, TAG_BASE + NINDEXED) != NULL) {
+        mrp_log_error("Indexed lookup found non-existent field.");
+        exit(1);
+    }
+
+    /* inserting must drop the index, lookups must see the new positions */
+    if (!mrp_msg_prepend(msg, MRP_MSG_TAG_STRING(0x1, "prepended"))) {
+        mrp_log_error("Failed to prepend field.");
+        exit(1);
+    }
+
+    if (msg->index != NULL) {
+        mrp_log_error("Index not dropped after inserting a field.");
+        exit(1);
+    }
+
+    check_str(msg, 0x1, "prepended", "after prepend");
+    check_indexed(msg, 0, NINDEXED - 1, "after prepend");
+
+    /* with duplicate tags, lookups must find the first matching field */
+    if (!mrp_msg_append(msg, MRP_MSG_TAG_UINT32(TAG_BASE + 5, 999))) {
+        mrp_log_error("Failed to append duplicate field.");
+        exit(1);
+    }
+
+    check_indexed(msg, 0, NINDEXED - 1, "after duplicate");
+
+    /* removing must drop the index, lookups must see the new positions */
+    if (!mrp_msg_remove(msg, TAG_BASE + 5)) {
+        mrp_log_error("Failed to remove field.");
+        exit(1);
+    }
+
+    if (msg->index != NULL) {
+        mrp_log_error("Index not dropped after removing a field.");
+        exit(1);
+    }
+
+    check_found(msg, TAG_BASE + 5, 999, "after removing first duplicate");
+    check_indexed(msg, 6, NINDEXED - 1, "after removing first duplicate");
+    check_indexed(msg, 0, 4, "after removing first duplicate");
+
+    if (!mrp_msg_remove(msg, 0x1) || !mrp_msg_remove(msg, TAG_BASE)) {
+        mrp_log_error("Failed to remove fields.");
+        exit(1);
+    }
+
+    check_str(msg, 0x1, NULL, "after removes");
+    check_str(msg, TAG_BASE, NULL, "after removes");
+    check_indexed(msg, 1, 4, "after removes");
+    check_indexed(msg, 6, NINDEXED - 1, "after removes");
+    check_found(msg, TAG_BASE + 5, 999, "after removes");
+
+    mrp_msg_unref(msg);
+
+    mrp_log_info("Indexed message field lookups OK.");
+}
+
+
+/*
+ * Lazily decoded messages borrow their strings, string arrays and blobs
+ * from the buffer they were decoded from. Check that such a message can
+ * be modified, shared and kept around after the transport it was
+ * received from has moved on and gone.
+ */
+
+#define TAG_LAZY_STR  0x1
+#define TAG_LAZY_BLOB 0x2
+#define TAG_LAZY_ASTR 0x3
+#define TAG_LAZY_U32  0x4
+
+static const char *lazy_strs[] = { "one", "two", "three" };
+static const char  lazy_blob[] = "binary\0blob";
+
+
+static mrp_msg_t *create_lazy_source(const char *str, uint32_t u32)
+{
+    mrp_msg_t *msg;
+
+    msg = mrp_msg_create(MRP_MSG_TAG_STRING(TAG_LAZY_STR, str),
+                         MRP_MSG_TAGGED(TAG_LAZY_BLOB, MRP_MSG_FIELD_BLOB,
+                                        sizeof(lazy_blob), lazy_blob),
+                         MRP_MSG_TAG_STRING_ARRAY(TAG_LAZY_ASTR,
+                                                  MRP_ARRAY_SIZE(lazy_strs),
+                                                  lazy_strs),
+                         MRP_MSG_TAG_UINT32(TAG_LAZY_U32, u32),
+                         MRP_MSG_END);
+
+    if (msg == NULL) {
+        mrp_log_error("Failed to create message.");
+        exit(1);
+    }
+
+    return msg;
+}
+
+
+static void check_lazy(mrp_msg_t *msg, const char *str, uint32_t u32,
+                       const char *which)
+{
+    mrp_msg_field_t *f;
+    uint32_t         i;
+
+    check_str(msg, TAG_LAZY_STR, str, which);
+    check_u32(msg, TAG_LAZY_U32, u32, which);
+
+    f = mrp_msg_find(msg, TAG_LAZY_BLOB);
+
+    if (f == NULL || f->type != MRP_MSG_FIELD_BLOB ||
+        f->size[0] != sizeof(lazy_blob) ||
+        memcmp(f->blb, lazy_blob, sizeof(lazy_blob))) {
+        mrp_log_error("%s: blob field mismatch.", which);
+        exit(1);
+    }
+
+    f = mrp_msg_find(msg, TAG_LAZY_ASTR);
+
+    if (f == NULL ||
+        f->type != (MRP_MSG_FIELD_ARRAY | MRP_MSG_FIELD_STRING) ||
+        f->size[0] != MRP_ARRAY_SIZE(lazy_strs)) {
+        mrp_log_error("%s: string array field mismatch.", which);
+        exit(1);
+    }
+
+    for (i = 0; i < f->size[0]; i++) {
+        if (strcmp(f->astr[i], lazy_strs[i])) {
+            mrp_log_error("%s: string array item #%u is '%s', expected '%s'.",
+                          which, i, f->astr[i], lazy_strs[i]);
+            exit(1);
+        }
+    }
+}
+
+
+static mrp_msg_t *decode_lazy(mrp_msg_t *src)
+{
+    mrp_msg_t *msg;
+    void      *buf, *copy;
+    ssize_t    size;
+
+    size = mrp_msg_default_encode(src, &buf);
+
+    if (size <= (ssize_t)sizeof(uint16_t)) {
+        mrp_log_error("Failed to encode message with default encoder.");
+        exit(1);
+    }
+
+    /* decode from a private copy, like transports do */
+    size -= sizeof(uint16_t);
+    copy  = mrp_datadup(buf + sizeof(uint16_t), size);
+    mrp_free(buf);
+
+    if (copy == NULL) {
+        mrp_log_error("Failed to copy encoded message.");
+        exit(1);
+    }
+
+    if ((msg = mrp_msg_default_decode_lazy(copy, size)) == NULL) {
+        mrp_log_error("Failed to lazily decode message.");
+        exit(1);
+    }
+
+    return msg;
+}
+
+
+static void test_lazy_decode(void)
+{
+    mrp_msg_t       *src, *msg, *copy;
+    mrp_msg_field_t *f;
+
+    src = create_lazy_source("lazy", 1);
+    msg = decode_lazy(src);
+    mrp_msg_unref(src);
+
+    check_lazy(msg, "lazy", 1, "lazily decoded");
+
+    f = mrp_msg_find(msg, TAG_LAZY_STR);
+
+    if (!borrowed(msg, f->str) ||
+        !borrowed(msg, mrp_msg_find(msg, TAG_LAZY_BLOB)->blb) ||
+        !borrowed(msg, mrp_msg_find(msg, TAG_LAZY_ASTR)->astr[0])) {
+        mrp_log_error("Lazily decoded fields are not borrowed.");
+        exit(1);
+    }
+
+    /* replacing a borrowed field must not try to free it */
+    if (!mrp_msg_set(msg, TAG_LAZY_STR, MRP_MSG_FIELD_STRING, "replaced")) {
+        mrp_log_error("Failed to set field in lazily decoded message.");
+        exit(1);
+    }
+
+    check_lazy(msg, "replaced", 1, "lazily decoded after set");
+
+    /* share it, then drop the original which owned the buffer */
+    if ((copy = mrp_msg_share(msg)) == NULL) {
+        mrp_log_error("Failed to share lazily decoded message.");
+        exit(1);
+    }
+
+    mrp_msg_unref(msg);
+    check_lazy(copy, "replaced", 1, "shared lazily decoded");
+
+    msg = mrp_msg_share(copy);
+
+    if (msg == NULL) {
+        mrp_log_error("Failed to share lazily decoded message.");
+        exit(1);
+    }
+
+    if (!mrp_msg_set(copy, TAG_LAZY_U32, MRP_MSG_FIELD_UINT32, 2) ||
+        !mrp_msg_remove(msg, TAG_LAZY_STR)) {
+        mrp_log_error("Failed to modify shared lazily decoded message.");
+        exit(1);
+    }
+
+    check_lazy(copy, "replaced", 2, "modified shared lazily decoded");
+    check_str(msg, TAG_LAZY_STR, NULL, "other shared lazily decoded");
+    check_u32(msg, TAG_LAZY_U32, 1, "other shared lazily decoded");
+
+    mrp_msg_unref(msg);
+    mrp_msg_unref(copy);
+
+    mrp_log_info("Lazily decoded message modification and sharing OK.");
+}
+
+
+static mrp_msg_t *lazy_recv;
+static int        lazy_nrecv;
+
+
+static void lazy_recv_evt(mrp_transport_t *t, mrp_msg_t *msg, void *user_data)
+{
+    MRP_UNUSED(t);
+    MRP_UNUSED(user_data);
+
+    if (lazy_nrecv++ == 0)
+        lazy_recv = mrp_msg_ref(msg);
+}
+
+
+static void lazy_closed_evt(mrp_transport_t *t, int error, void *user_data)
+{
+    MRP_UNUSED(t);
+    MRP_UNUSED(user_data);
+
+    mrp_log_error("Transport closed unexpectedly (%d: %s).", error,
+                  strerror(error));
+    exit(1);
+}
+
+
+static void lazy_connection_evt(mrp_transport_t *t, void *user_data)
+{
+    MRP_UNUSED(t);
+    MRP_UNUSED(user_data);
+}
+
+
+static void test_lazy_recv(void)
+{
+    mrp_transport_evt_t  evt;
+    mrp_mainloop_t      *ml;
+    mrp_transport_t     *tx, *rx;
+    mrp_msg_t           *msg;
+    int                  fds[2], flags, state, i;
+
+    if ((ml = mrp_mainloop_create()) == NULL) {
+        mrp_log_error("Failed to create mainloop.");
+        exit(1);
+    }
+
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0) {
+        mrp_log_error("Failed to create socket pair (%d: %s).", errno,
+                      strerror(errno));
+        exit(1);
+    }
+
+    mrp_clear(&evt);
+    evt.recvmsg    = lazy_recv_evt;
+    evt.closed     = lazy_closed_evt;
+    evt.connection = lazy_connection_evt;
+
+    flags = MRP_TRANSPORT_NONBLOCK | MRP_TRANSPORT_MODE_MSG;
+    state = MRP_TRANSPORT_CONNECTED;
+    tx    = mrp_transport_create_from(ml, "unxs", &fds[0], &evt, NULL,
+                                      flags, state);
+    rx    = mrp_transport_create_from(ml, "unxs", &fds[1], &evt, NULL,
+                                      flags, state);
+
+    if (tx == NULL || rx == NULL) {
+        mrp_log_error("Failed to create transports.");
+        exit(1);
+    }
+
+    /*
+     * Send a second message of the same layout so that anything still
+     * pointing into the receive buffer of the transport would see it.
+     */
+    for (i = 0; i < 2; i++) {
+        msg = create_lazy_source(i == 0 ? "first" : "other", i + 1);
+
+        if (!mrp_transport_send(tx, msg)) {
+            mrp_log_error("Failed to send message #%d.", i);
+            exit(1);
+        }
+
+        mrp_msg_unref(msg);
+
+        while (lazy_nrecv <= i)
+            mrp_mainloop_iterate(ml);
+    }
+
+    mrp_transport_destroy(tx);
+    mrp_transport_destroy(rx);
+    mrp_mainloop_destroy(ml);
+
+    check_lazy(lazy_recv, "first", 1, "received");
+
+    mrp_msg_unref(lazy_recv);
+
+    mrp_log_info("Lazily decoded message outlives its transport OK.");
+}
+
+
 int main(int argc, char *argv[])
 {
     mrp_log_set_mask(MRP_LOG_UPTO(MRP_LOG_DEBUG));
     mrp_log_set_target(MRP_LOG_TO_STDOUT);
 
     test_basic();
+    test_share();
+    test_share_unref();
+    test_shared_delivery();
+    test_index();
+    test_lazy_decode();
+    test_lazy_recv();
 
     test_default_encode_decode(argc, argv);
     test_custom_encode_decode();
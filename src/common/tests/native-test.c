@@ -8,6 +8,7 @@
 #include <murphy/common/debug.h>
 #include <murphy/common/log.h>
 #include <murphy/common/native-types.h>
+#include <murphy/common/native-types.c>
 
 
 typedef enum {
@@ -202,6 +203,169 @@ person_t tom_dick_and_harry[] = {
 family_t family = { &pap, &mom, &tom_dick_and_harry[0] };
 
 
+#define CHECK(cond, fmt, args...) do {                                  \
+        if (!(cond)) {                                                  \
+            mrp_log_error("check '%s' failed: "fmt, #cond , ## args);   \
+            exit(1);                                                    \
+        }                                                               \
+    } while (0)
+
+
+static void check_person(person_t *d, person_t *o)
+{
+    size_t i;
+
+    CHECK(!strcmp(d->name, o->name), "%s", d->name);
+    CHECK(d->gender == o->gender && d->age == o->age, "%s", o->name);
+    CHECK(d->height == o->height && d->weight == o->weight, "%s", o->name);
+    CHECK(!strcmp(d->nationality, o->nationality), "%s", o->name);
+    CHECK(d->hand == o->hand && d->glasses == o->glasses, "%s", o->name);
+
+    for (i = 0; o->languages[i] != NULL; i++)
+        CHECK(d->languages[i] && !strcmp(d->languages[i], o->languages[i]),
+              "%s, language #%zu", o->name, i);
+    CHECK(d->languages[i] == NULL, "%s", o->name);
+
+    CHECK(d->nfavourite == o->nfavourite, "%s", o->name);
+
+    for (i = 0; i < o->nfavourite; i++) {
+        CHECK(d->favourites[i].type == o->favourites[i].type &&
+              d->favourites[i].year == o->favourites[i].year &&
+              d->favourites[i].price == o->favourites[i].price &&
+              !strcmp(d->favourites[i].title, o->favourites[i].title),
+              "%s, favourite #%zu", o->name, i);
+    }
+}
+
+
+static void check_family(family_t *d, family_t *o)
+{
+    int i;
+
+    check_person(d->father, o->father);
+    check_person(d->mother, o->mother);
+
+    for (i = 0; o->children[i].name != NULL; i++)
+        check_person(d->children + i, o->children + i);
+
+    CHECK(d->children[i].name == NULL, "child #%d", i);
+
+    mrp_log_info("Decoded test data matches the original.");
+}
+
+
+/*
+ * A type with only fixed-size members, directly or in nested structs,
+ * has an exact precalculated encoded size and gets encoded into a buffer
+ * allocated for exactly that size.
+ */
+
+typedef struct {
+    uint8_t r, g, b, a;
+} color_t;
+
+
+typedef struct {
+    int32_t   x, y;
+    uint16_t  layer;
+    double    scale;
+    bool      visible;
+    color_t  *color;
+} sprite_t;
+
+
+#define TLV_HDR (2 * sizeof(uint32_t))   /* tag + uint32_t */
+
+static void test_fixed_size(uint32_t art_type_id)
+{
+    MRP_NATIVE_TYPE(color_type, color_t,
+                    MRP_UINT8(color_t, r, DEFAULT),
+                    MRP_UINT8(color_t, g, DEFAULT),
+                    MRP_UINT8(color_t, b, DEFAULT),
+                    MRP_UINT8(color_t, a, DEFAULT));
+    MRP_NATIVE_TYPE(sprite_type, sprite_t,
+                    MRP_INT32 (sprite_t, x      , DEFAULT),
+                    MRP_INT32 (sprite_t, y      , DEFAULT),
+                    MRP_UINT16(sprite_t, layer  , DEFAULT),
+                    MRP_DOUBLE(sprite_t, scale  , DEFAULT),
+                    MRP_BOOL  (sprite_t, visible, DEFAULT),
+                    MRP_STRUCT(sprite_t, color  , DEFAULT, color_t));
+
+    color_t            color  = { 0x12, 0x34, 0x56, 0x78 };
+    sprite_t           sprite = { -5, 7, 3, 1.5, true, &color };
+    sprite_t          *decoded;
+    mrp_native_type_t *t, *ct, *at;
+    mrp_tlv_t          tlv;
+    size_t             color_size, sprite_size, art_size, esize, reserve;
+    uint32_t           color_id, sprite_id;
+    void              *ebuf, *dbuf, *p;
+
+    color_id  = mrp_register_native(&color_type);
+    sprite_id = mrp_register_native(&sprite_type);
+
+    CHECK(color_id != MRP_INVALID_TYPE && sprite_id != MRP_INVALID_TYPE,
+          "failed to register fixed-size types");
+
+    ct = lookup_type(color_id);
+    t  = lookup_type(sprite_id);
+    at = lookup_type(art_type_id);
+
+    /* struct header, then member header and value for each member */
+    color_size  = TLV_HDR + 4 * (TLV_HDR + sizeof(uint8_t));
+    sprite_size = TLV_HDR + 6 * TLV_HDR +
+        2 * sizeof(int32_t) + sizeof(uint16_t) + sizeof(double) +
+        sizeof(bool) + color_size;
+    art_size    = TLV_HDR + 6 * TLV_HDR +
+        sizeof(uint32_t) + 3 * sizeof(uint32_t) + sizeof(uint16_t) +
+        sizeof(double);
+
+    CHECK(ct->fixed && ct->encsize == color_size, "%zu", ct->encsize);
+    CHECK(t->fixed && t->encsize == sprite_size, "%zu", t->encsize);
+    CHECK(!at->fixed && at->encsize == art_size, "%zu", at->encsize);
+
+    CHECK(t->ops[2].type == MRP_TYPE_UINT16 &&
+          t->ops[2].offs == MRP_OFFSET(sprite_t, layer), "layer op");
+    CHECK(t->ops[5].type == MRP_TYPE_STRUCT && t->ops[5].mt == ct &&
+          t->ops[5].offs == MRP_OFFSET(sprite_t, color), "color op");
+
+    reserve = 16;
+
+    CHECK(mrp_encode_native(&sprite, sprite_id, reserve, &ebuf, &esize,
+                            NULL) == 0, "failed to encode sprite");
+    CHECK(esize == reserve + sprite_size, "%zu", esize);
+
+    p      = ebuf + reserve;
+    esize -= reserve;
+    dbuf   = NULL;
+
+    CHECK(mrp_decode_native(&p, &esize, &dbuf, &sprite_id, NULL) == 0,
+          "failed to decode sprite");
+    CHECK(esize == 0, "%zu bytes left after decoding", esize);
+
+    decoded = dbuf;
+
+    CHECK(decoded->x == sprite.x && decoded->y == sprite.y &&
+          decoded->layer == sprite.layer && decoded->scale == sprite.scale &&
+          decoded->visible == sprite.visible, "sprite mismatch");
+    CHECK(!memcmp(decoded->color, &color, sizeof(color)), "color mismatch");
+
+    mrp_free_native(dbuf, sprite_id);
+    mrp_free(ebuf);
+
+    /* an exactly sized buffer must only grow when it is overflown */
+    CHECK(mrp_tlv_setup_write_exact(&tlv, TLV_HDR) == 0, "TLV setup");
+    CHECK(mrp_tlv_push_uint32(&tlv, 1, 0xcafe) == 0, "TLV push");
+    CHECK(tlv.size == TLV_HDR && mrp_tlv_offset(&tlv) == TLV_HDR,
+          "%zu", tlv.size);
+    CHECK(mrp_tlv_push_uint32(&tlv, 2, 0xbabe) == 0, "TLV push");
+    CHECK(tlv.size > TLV_HDR && mrp_tlv_offset(&tlv) == 2 * TLV_HDR,
+          "%zu", tlv.size);
+    mrp_tlv_cleanup(&tlv);
+
+    mrp_log_info("Fixed-size type encoding OK.");
+}
+
+
 int main(int argc, char *argv[])
 {
     MRP_NATIVE_TYPE(art_type, art_t,
@@ -296,6 +460,8 @@ int main(int argc, char *argv[])
 
     decoded = dbuf;
 
+    check_family(decoded, &family);
+
     if (mrp_print_native(dump, sizeof(dump), decoded, family_type_id) >= 0)
         mrp_log_info("dump of decoded data: %s", dump);
     else
@@ -303,5 +469,7 @@ int main(int argc, char *argv[])
 
     mrp_free_native(dbuf, family_type_id);
 
+    test_fixed_size(art_type_id);
+
     return 0;
 }
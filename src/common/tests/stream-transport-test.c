@@ -0,0 +1,626 @@
+/*
+ * Copyright (c) 2012, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/ioctl.h>
+
+#include <murphy/common/macros.h>
+#include <murphy/common/mm.h>
+#include <murphy/common/mainloop.h>
+#include <murphy/common/msg.h>
+#include <murphy/common/transport.h>
+
+#define NMSG     256                     /* messages to send */
+#define PAYLOAD  1024                    /* payload size per message */
+#define BIGLOAD  (48 * 1024)             /* ...for every BIGNTH message */
+#define BIGNTH   16
+#define SOCKBUF  4096                    /* socket buffer size */
+#define HIGHWM   (32 * 1024)             /* output high watermark */
+#define LOWWM    ( 8 * 1024)             /* output low watermark */
+#define TIMEOUT  10000                   /* test timeout in msecs */
+#define NCORK    8                       /* messages to send while corked */
+#define NBUDGET  200                     /* messages to exceed read budget */
+#define BIGBUF   (1024 * 1024)           /* ...socket buffer size for them */
+#define NQUEUE   64                      /* messages to queue before close */
+
+#define TAG_SEQ     1
+#define TAG_PAYLOAD 2
+
+#define fatal(fmt, args...) do {                                          \
+        fprintf(stderr, "fatal error: "fmt"\n" , ## args);                \
+        exit(1);                                                          \
+    } while (0)
+
+static mrp_mainloop_t  *ml;
+static mrp_transport_t *tx, *rx;
+static int              nrecv, ncongested, ndecongested;
+static int              ncork, npeerclosed;
+static int              nbudget;
+static int              nqueue;
+
+
+static void fill_payload(char *buf, uint32_t seq)
+{
+    int size, i;
+
+    size = (seq % BIGNTH) ? PAYLOAD : BIGLOAD;
+
+    for (i = 0; i < size - 1; i++)
+        buf[i] = 'a' + (seq + i) % 26;
+    buf[i] = '\0';
+}
+
+
+static void check_done(void)
+{
+    if (nrecv == NMSG && ndecongested > 0)
+        mrp_mainloop_quit(ml, 0);
+}
+
+
+static void recv_evt(mrp_transport_t *t, mrp_msg_t *msg, void *user_data)
+{
+    char      expected[BIGLOAD], *payload;
+    uint32_t  seq;
+
+    MRP_UNUSED(t);
+    MRP_UNUSED(user_data);
+
+    if (!mrp_msg_get(msg,
+                     TAG_SEQ    , MRP_MSG_FIELD_UINT32, &seq,
+                     TAG_PAYLOAD, MRP_MSG_FIELD_STRING, &payload,
+                     MRP_MSG_END))
+        fatal("received malformed message #%d", nrecv);
+
+    if (seq != (uint32_t)nrecv)
+        fatal("received message #%u, expected #%d", seq, nrecv);
+
+    fill_payload(expected, seq);
+
+    if (strcmp(payload, expected))
+        fatal("payload of message #%u corrupted", seq);
+
+    nrecv++;
+    check_done();
+}
+
+
+static void congested_evt(mrp_transport_t *t, int congested, void *user_data)
+{
+    MRP_UNUSED(t);
+    MRP_UNUSED(user_data);
+
+    if (congested)
+        ncongested++;
+    else {
+        ndecongested++;
+        check_done();
+    }
+}
+
+
+static void closed_evt(mrp_transport_t *t, int error, void *user_data)
+{
+    MRP_UNUSED(t);
+    MRP_UNUSED(user_data);
+
+    fatal("transport closed unexpectedly (%d: %s)", error, strerror(error));
+}
+
+
+static void connection_evt(mrp_transport_t *t, void *user_data)
+{
+    MRP_UNUSED(t);
+    MRP_UNUSED(user_data);
+
+    fatal("unexpected connection event");
+}
+
+
+static void timeout_cb(mrp_timer_t *t, void *user_data)
+{
+    MRP_UNUSED(t);
+    MRP_UNUSED(user_data);
+
+    fatal("timed out with %d of %d messages received", nrecv, NMSG);
+}
+
+
+static void send_msg(uint32_t seq)
+{
+    char       payload[BIGLOAD];
+    mrp_msg_t *msg;
+
+    fill_payload(payload, seq);
+
+    msg = mrp_msg_create(TAG_SEQ    , MRP_MSG_FIELD_UINT32, seq,
+                         TAG_PAYLOAD, MRP_MSG_FIELD_STRING, payload,
+                         MRP_MSG_END);
+
+    if (msg == NULL)
+        fatal("failed to create message #%u", seq);
+
+    if (!mrp_transport_send(tx, msg))
+        fatal("failed to send message #%u", seq);
+
+    mrp_msg_unref(msg);
+}
+
+
+/*
+ * Send a lot more than the socket buffers can hold before the receiving
+ * end is set up. The writes that don't fit must end up in the output
+ * queue, with the tail of partially written (big) messages queued, and
+ * the transport must get congested. Once the receiver starts reading, the
+ * queue must drain in order and the transport must decongest.
+ */
+
+static void test_output_queue(void)
+{
+    mrp_transport_evt_t evt;
+    size_t              highwm, lowwm;
+    int                 fds[2], size, flags, state;
+    uint32_t            i;
+
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0)
+        fatal("failed to create socket pair (%d: %s)", errno, strerror(errno));
+
+    size = SOCKBUF;
+    setsockopt(fds[0], SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+    setsockopt(fds[1], SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+
+    mrp_clear(&evt);
+    evt.recvmsg    = recv_evt;
+    evt.congested  = congested_evt;
+    evt.closed     = closed_evt;
+    evt.connection = connection_evt;
+
+    flags = MRP_TRANSPORT_NONBLOCK | MRP_TRANSPORT_MODE_MSG;
+    state = MRP_TRANSPORT_CONNECTED;
+    tx    = mrp_transport_create_from(ml, "unxs", &fds[0], &evt, NULL,
+                                      flags, state);
+
+    if (tx == NULL)
+        fatal("failed to create sending transport");
+
+    highwm = HIGHWM;
+    lowwm  = LOWWM;
+
+    if (!mrp_transport_setopt(tx, MRP_TRANSPORT_OPT_HIGHWM, &highwm) ||
+        !mrp_transport_setopt(tx, MRP_TRANSPORT_OPT_LOWWM, &lowwm))
+        fatal("failed to set output watermarks");
+
+    for (i = 0; i < NMSG; i++)
+        send_msg(i);
+
+    if (ncongested != 1 || ndecongested != 0)
+        fatal("got %d/%d congestion events after sending, expected 1/0",
+              ncongested, ndecongested);
+
+    rx = mrp_transport_create_from(ml, "unxs", &fds[1], &evt, NULL,
+                                   flags, state);
+
+    if (rx == NULL)
+        fatal("failed to create receiving transport");
+
+    mrp_mainloop_run(ml);
+
+    if (nrecv != NMSG)
+        fatal("received %d messages instead of %d", nrecv, NMSG);
+
+    if (ncongested != 1 || ndecongested != 1)
+        fatal("got %d/%d congestion events after draining, expected 1/1",
+              ncongested, ndecongested);
+
+    mrp_transport_destroy(tx);
+    mrp_transport_destroy(rx);
+    tx = rx = NULL;
+}
+
+
+static void cork_recv_evt(mrp_transport_t *t, mrp_msg_t *msg, void *user_data)
+{
+    uint32_t seq;
+
+    MRP_UNUSED(t);
+    MRP_UNUSED(user_data);
+
+    if (!mrp_msg_get(msg, TAG_SEQ, MRP_MSG_FIELD_UINT32, &seq, MRP_MSG_END))
+        fatal("received malformed corked message #%d", ncork);
+
+    if (seq != (uint32_t)ncork)
+        fatal("received corked message #%u, expected #%d", seq, ncork);
+
+    ncork++;
+}
+
+
+static void cork_closed_evt(mrp_transport_t *t, int error, void *user_data)
+{
+    MRP_UNUSED(t);
+    MRP_UNUSED(error);
+    MRP_UNUSED(user_data);
+
+    if (ncork != NCORK)
+        fatal("peer closed with %d of %d corked messages received",
+              ncork, NCORK);
+
+    npeerclosed++;
+}
+
+
+static void send_seq(mrp_transport_t *t, uint32_t seq)
+{
+    mrp_msg_t *msg;
+
+    msg = mrp_msg_create(TAG_SEQ, MRP_MSG_FIELD_UINT32, seq, MRP_MSG_END);
+
+    if (msg == NULL || !mrp_transport_send(t, msg))
+        fatal("failed to send corked message #%u", seq);
+
+    mrp_msg_unref(msg);
+}
+
+
+static int pending_input(int fd)
+{
+    int n;
+
+    if (ioctl(fd, FIONREAD, &n) < 0)
+        fatal("failed to query pending input (%d: %s)", errno,
+              strerror(errno));
+
+    return n;
+}
+
+
+/*
+ * Cork the sending transport and send a few messages. Nothing may be
+ * written to the socket until the transport gets uncorked, either
+ * explicitly or automatically at the end of the mainloop iteration.
+ * Messages sent while corked must also make it to the peer if the
+ * transport is closed before it would have been uncorked.
+ */
+
+static void test_cork(void)
+{
+    mrp_transport_evt_t evt;
+    int                 fds[2], flags, state;
+    uint32_t            i;
+
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0)
+        fatal("failed to create socket pair (%d: %s)", errno, strerror(errno));
+
+    mrp_clear(&evt);
+    evt.recvmsg    = cork_recv_evt;
+    evt.closed     = cork_closed_evt;
+    evt.connection = connection_evt;
+
+    flags = MRP_TRANSPORT_NONBLOCK | MRP_TRANSPORT_MODE_MSG;
+    state = MRP_TRANSPORT_CONNECTED;
+    tx    = mrp_transport_create_from(ml, "unxs", &fds[0], &evt, NULL,
+                                      flags, state);
+    rx    = mrp_transport_create_from(ml, "unxs", &fds[1], &evt, NULL,
+                                      flags, state);
+
+    if (tx == NULL || rx == NULL)
+        fatal("failed to create transports for cork test");
+
+    /* explicit uncork */
+    if (!mrp_transport_cork(tx))
+        fatal("failed to cork transport");
+
+    for (i = 0; i < NCORK / 2; i++)
+        send_seq(tx, i);
+
+    if (pending_input(fds[1]) != 0)
+        fatal("corked transport wrote to the socket");
+
+    if (!mrp_transport_uncork(tx))
+        fatal("failed to uncork transport");
+
+    if (pending_input(fds[1]) == 0)
+        fatal("uncorking did not write the batched output");
+
+    while (ncork < NCORK / 2)
+        mrp_mainloop_iterate(ml);
+
+    /* automatic uncork at the end of the iteration */
+    mrp_transport_cork(tx);
+
+    for (; i < NCORK - 2; i++)
+        send_seq(tx, i);
+
+    if (pending_input(fds[1]) != 0)
+        fatal("corked transport wrote to the socket");
+
+    while (ncork < NCORK - 2)
+        mrp_mainloop_iterate(ml);
+
+    /* close while corked */
+    mrp_transport_cork(tx);
+
+    for (; i < NCORK; i++)
+        send_seq(tx, i);
+
+    mrp_transport_destroy(tx);
+    tx = NULL;
+
+    while (!npeerclosed)
+        mrp_mainloop_iterate(ml);
+
+    mrp_transport_destroy(rx);
+    rx = NULL;
+}
+
+
+static void budget_recv_evt(mrp_transport_t *t, mrp_msg_t *msg,
+                            void *user_data)
+{
+    uint32_t seq;
+
+    MRP_UNUSED(t);
+    MRP_UNUSED(user_data);
+
+    if (!mrp_msg_get(msg, TAG_SEQ, MRP_MSG_FIELD_UINT32, &seq, MRP_MSG_END))
+        fatal("received malformed message #%d", nbudget);
+
+    if (seq != (uint32_t)nbudget)
+        fatal("received message #%u, expected #%d", seq, nbudget);
+
+    nbudget++;
+}
+
+
+static void budget_closed_evt(mrp_transport_t *t, int error, void *user_data)
+{
+    MRP_UNUSED(t);
+    MRP_UNUSED(error);
+    MRP_UNUSED(user_data);
+
+    if (nbudget != 2 * NBUDGET)
+        fatal("peer close reported with %d of %d messages received",
+              nbudget, 2 * NBUDGET);
+
+    npeerclosed++;
+}
+
+
+static void send_budget(uint32_t first, uint32_t cnt)
+{
+    char       payload[PAYLOAD];
+    mrp_msg_t *msg;
+    uint32_t   seq;
+
+    memset(payload, 'x', sizeof(payload) - 1);
+    payload[sizeof(payload) - 1] = '\0';
+
+    for (seq = first; seq < first + cnt; seq++) {
+        msg = mrp_msg_create(TAG_SEQ    , MRP_MSG_FIELD_UINT32, seq,
+                             TAG_PAYLOAD, MRP_MSG_FIELD_STRING, payload,
+                             MRP_MSG_END);
+
+        if (msg == NULL || !mrp_transport_send(tx, msg))
+            fatal("failed to send message #%u", seq);
+
+        mrp_msg_unref(msg);
+    }
+}
+
+
+/*
+ * Put a lot more input in the socket than the receiver may read per
+ * notification, with the receiver in edge-triggered mode. Since no new
+ * input arrives, there won't be any more notifications, so the rest of
+ * the input must be picked up by the deferred resume. Then do the same
+ * but close the sending end right away. The peer close must only be
+ * reported once all the input preceding it has been delivered.
+ */
+
+static void test_read_budget(void)
+{
+    mrp_transport_evt_t evt;
+    size_t              budget;
+    bool                edge;
+    int                 fds[2], size, flags, state;
+
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0)
+        fatal("failed to create socket pair (%d: %s)", errno, strerror(errno));
+
+    size = BIGBUF;
+    setsockopt(fds[0], SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+    setsockopt(fds[1], SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+
+    mrp_clear(&evt);
+    evt.recvmsg    = budget_recv_evt;
+    evt.closed     = budget_closed_evt;
+    evt.connection = connection_evt;
+
+    flags = MRP_TRANSPORT_NONBLOCK | MRP_TRANSPORT_MODE_MSG;
+    state = MRP_TRANSPORT_CONNECTED;
+    tx    = mrp_transport_create_from(ml, "unxs", &fds[0], &evt, NULL,
+                                      flags, state);
+    rx    = mrp_transport_create_from(ml, "unxs", &fds[1], &evt, NULL,
+                                      flags, state);
+
+    if (tx == NULL || rx == NULL)
+        fatal("failed to create transports for read budget test");
+
+    budget = 1;                          /* a single read per round */
+    edge   = TRUE;
+
+    if (!mrp_transport_setopt(rx, MRP_TRANSPORT_OPT_BUDGET, &budget) ||
+        !mrp_transport_setopt(rx, MRP_TRANSPORT_OPT_EDGE, &edge))
+        fatal("failed to set read budget or edge-triggered mode");
+
+    npeerclosed = 0;
+    send_budget(0, NBUDGET);
+
+    if (pending_input(fds[1]) < NBUDGET * PAYLOAD)
+        fatal("sent input did not fit into the socket buffers");
+
+    mrp_mainloop_iterate(ml);
+
+    if (nbudget == 0 || nbudget >= NBUDGET)
+        fatal("read %d of %d messages in one round, budget not honored",
+              nbudget, NBUDGET);
+
+    while (nbudget < NBUDGET)
+        mrp_mainloop_iterate(ml);
+
+    send_budget(NBUDGET, NBUDGET);
+    mrp_transport_destroy(tx);
+    tx = NULL;
+
+    while (!npeerclosed)
+        mrp_mainloop_iterate(ml);
+
+    mrp_transport_destroy(rx);
+    rx = NULL;
+}
+
+
+static void queue_recv_evt(mrp_transport_t *t, mrp_msg_t *msg,
+                           void *user_data)
+{
+    uint32_t seq;
+
+    MRP_UNUSED(t);
+    MRP_UNUSED(user_data);
+
+    if (!mrp_msg_get(msg, TAG_SEQ, MRP_MSG_FIELD_UINT32, &seq, MRP_MSG_END))
+        fatal("received malformed queued message #%d", nqueue);
+
+    if (seq != (uint32_t)nqueue)
+        fatal("received queued message #%u, expected #%d", seq, nqueue);
+
+    nqueue++;
+}
+
+
+static void queue_closed_evt(mrp_transport_t *t, int error, void *user_data)
+{
+    MRP_UNUSED(t);
+    MRP_UNUSED(error);
+    MRP_UNUSED(user_data);
+
+    if (nqueue != NQUEUE)
+        fatal("peer closed with %d of %d queued messages received",
+              nqueue, NQUEUE);
+
+    npeerclosed++;
+}
+
+
+/*
+ * Fill the socket buffer of an uncorked transport so that the rest of
+ * the output ends up in the output queue, then make room for it and
+ * close the transport without giving the mainloop a chance to drain the
+ * queue. The final flush on close must get the queued output out even
+ * though the transport was never corked.
+ */
+
+static void test_close_queued(void)
+{
+    mrp_transport_evt_t evt;
+    int                 fds[2], size, flags, state;
+
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0)
+        fatal("failed to create socket pair (%d: %s)", errno, strerror(errno));
+
+    size = SOCKBUF;
+    setsockopt(fds[0], SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+    setsockopt(fds[1], SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+
+    mrp_clear(&evt);
+    evt.recvmsg    = queue_recv_evt;
+    evt.closed     = queue_closed_evt;
+    evt.connection = connection_evt;
+
+    flags = MRP_TRANSPORT_NONBLOCK | MRP_TRANSPORT_MODE_MSG;
+    state = MRP_TRANSPORT_CONNECTED;
+    tx    = mrp_transport_create_from(ml, "unxs", &fds[0], &evt, NULL,
+                                      flags, state);
+
+    if (tx == NULL)
+        fatal("failed to create sending transport");
+
+    npeerclosed = 0;
+    send_budget(0, NQUEUE);
+
+    if (pending_input(fds[1]) >= NQUEUE * PAYLOAD)
+        fatal("sent output fit into the socket buffers, nothing queued");
+
+    size = BIGBUF;
+    setsockopt(fds[0], SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+
+    mrp_transport_destroy(tx);
+    tx = NULL;
+
+    rx = mrp_transport_create_from(ml, "unxs", &fds[1], &evt, NULL,
+                                   flags, state);
+
+    if (rx == NULL)
+        fatal("failed to create receiving transport");
+
+    while (!npeerclosed)
+        mrp_mainloop_iterate(ml);
+
+    mrp_transport_destroy(rx);
+    rx = NULL;
+}
+
+
+int main(int argc, char *argv[])
+{
+    MRP_UNUSED(argc);
+    MRP_UNUSED(argv);
+
+    if ((ml = mrp_mainloop_create()) == NULL)
+        fatal("failed to create mainloop");
+
+    if (mrp_add_timer(ml, TIMEOUT, timeout_cb, NULL) == NULL)
+        fatal("failed to create timeout timer");
+
+    test_cork();
+    test_read_budget();
+    test_close_queued();
+    test_output_queue();
+
+    mrp_mainloop_destroy(ml);
+
+    printf("stream transport tests passed\n");
+
+    return 0;
+}
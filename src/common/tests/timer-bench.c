@@ -0,0 +1,173 @@
+/*
+ * Copyright (c) 2012, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Microbenchmark for mainloop timers.
+ *
+ * Measures the throughput of adding, rearming, expiring and deleting a
+ * large number of simultaneously active timers. By default the benchmark
+ * is run with 10000 and 100000 timers.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <libgen.h>
+
+#include <murphy/common/macros.h>
+#include <murphy/common/mm.h>
+#include <murphy/common/mainloop.h>
+
+#define MAX_MSECS 100                    /* max. timer interval */
+
+static int nexpired;
+
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + ts.tv_nsec / 1000000000.0;
+}
+
+
+static void report(const char *op, int n, double t)
+{
+    printf("%-8s %10d timers %8.3f s %12.0f ops/s\n", op, n, t,
+           t > 0 ? n / t : 0.0);
+}
+
+
+static void expire_cb(mrp_timer_t *t, void *user_data)
+{
+    mrp_timer_t **tp = (mrp_timer_t **)user_data;
+
+    mrp_del_timer(t);
+    *tp = NULL;
+    nexpired++;
+}
+
+
+static void idle_cb(mrp_timer_t *t, void *user_data)
+{
+    MRP_UNUSED(t);
+    MRP_UNUSED(user_data);
+}
+
+
+static int run(int n)
+{
+    mrp_mainloop_t  *ml;
+    mrp_timer_t    **timers;
+    double           t;
+    int              i;
+
+    if ((ml = mrp_mainloop_create()) == NULL ||
+        (timers = mrp_allocz_array(mrp_timer_t *, n)) == NULL) {
+        printf("failed to create mainloop or timer table\n");
+        return -1;
+    }
+
+    srand(n);
+
+    t = now();
+    for (i = 0; i < n; i++) {
+        timers[i] = mrp_add_timer(ml, 1 + rand() % MAX_MSECS, expire_cb,
+                                  timers + i);
+
+        if (timers[i] == NULL) {
+            printf("failed to add timer #%d\n", i);
+            return -1;
+        }
+    }
+    report("add", n, now() - t);
+
+    t = now();
+    for (i = 0; i < n; i++)
+        mrp_mod_timer(timers[i], 1 + rand() % MAX_MSECS);
+    report("rearm", n, now() - t);
+
+    /*
+     * Let all timers expire before entering the mainloop, so we only
+     * measure dispatching and not the time spent waiting in poll.
+     */
+    usleep((MAX_MSECS + 10) * 1000);
+
+    nexpired = 0;
+    t = now();
+    while (nexpired < n)
+        mrp_mainloop_iterate(ml);
+    report("expire", n, now() - t);
+
+    for (i = 0; i < n; i++)
+        timers[i] = mrp_add_timer(ml, 1000 + rand() % (60 * 1000), idle_cb,
+                                  NULL);
+
+    t = now();
+    for (i = 0; i < n; i++)
+        mrp_del_timer(timers[i]);
+    report("delete", n, now() - t);
+
+    mrp_mainloop_destroy(ml);
+    mrp_free(timers);
+
+    return 0;
+}
+
+
+int main(int argc, char *argv[])
+{
+    int n, i;
+
+    n = 0;
+
+    for (i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-n") && i < argc - 1)
+            n = atoi(argv[++i]);
+        else {
+            printf("Usage: %s [-h] [-n <timers>]\n"
+                   "  -h     prints this message\n"
+                   "  -n     number of timers (default 10000 and 100000)\n",
+                   basename(argv[0]));
+            exit(strcmp(argv[i], "-h") ? 1 : 0);
+        }
+    }
+
+    if (n > 0)
+        return run(n) < 0 ? 1 : 0;
+
+    if (run(10000) < 0 || run(100000) < 0)
+        return 1;
+
+    return 0;
+}
@@ -0,0 +1,132 @@
+/*
+ * Copyright (c) 2012, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+
+#include <murphy/common/macros.h>
+#include <murphy/common/mm.h>
+#include <murphy/common/mainloop.h>
+#include <murphy/common/worker.h>
+
+#define NJOB 10000
+
+#define fatal(fmt, args...) do {                                          \
+        fprintf(stderr, "fatal error: "fmt"\n" , ## args);                \
+        exit(1);                                                          \
+    } while (0)
+
+typedef struct {
+    int      id;
+    int      ran;
+    uint64_t sum;
+} job_t;
+
+static mrp_mainloop_t    *ml;
+static mrp_worker_pool_t *pool;
+static int                ndone, ncancel;
+
+
+static void work_cb(void *user_data)
+{
+    job_t    *j = (job_t *)user_data;
+    uint64_t  i;
+
+    for (i = 0, j->sum = 0; i < 1000; i++)
+        j->sum += i * j->id;
+
+    j->ran = TRUE;
+}
+
+
+static void done_cb(int status, void *user_data)
+{
+    job_t *j = (job_t *)user_data;
+
+    if (status == ECANCELED) {
+        ncancel++;
+        return;
+    }
+
+    if (status != 0 || !j->ran || j->sum != 499500ULL * j->id)
+        fatal("job #%d completed incorrectly", j->id);
+
+    if (++ndone == NJOB)
+        mrp_mainloop_quit(ml, 0);
+}
+
+
+int main(int argc, char *argv[])
+{
+    job_t *jobs;
+    int    i;
+
+    MRP_UNUSED(argc);
+    MRP_UNUSED(argv);
+
+    if ((ml = mrp_mainloop_create()) == NULL)
+        fatal("failed to create mainloop");
+
+    if ((pool = mrp_worker_pool_create(ml, 4)) == NULL)
+        fatal("failed to create worker pool");
+
+    if ((jobs = mrp_allocz_array(job_t, NJOB)) == NULL)
+        fatal("failed to allocate jobs");
+
+    for (i = 0; i < NJOB; i++) {
+        jobs[i].id = i;
+
+        if (!mrp_worker_submit(pool, work_cb, done_cb, jobs + i))
+            fatal("failed to submit job #%d", i);
+    }
+
+    mrp_mainloop_run(ml);
+
+    /* jobs still pending at destruction time should get cancelled */
+    for (i = 0; i < NJOB; i++) {
+        jobs[i].ran = FALSE;
+        mrp_worker_submit(pool, work_cb, done_cb, jobs + i);
+    }
+
+    ndone = 0;
+    mrp_worker_pool_destroy(pool);
+
+    if (ndone + ncancel != NJOB)
+        fatal("%d jobs completed, %d cancelled, expected %d in total",
+              ndone, ncancel, NJOB);
+
+    printf("%d jobs completed, %d jobs cancelled on destroy\n", ndone,
+           ncancel);
+
+    mrp_free(jobs);
+    mrp_mainloop_destroy(ml);
+
+    return 0;
+}
@@ -44,10 +44,16 @@ int mrp_tlv_setup_write(mrp_tlv_t *tlv, size_t prealloc)
     if (prealloc < TLV_MIN_PREALLOC)
         prealloc = TLV_MIN_PREALLOC;
 
-    if ((tlv->buf = mrp_allocz(prealloc)) == NULL)
+    return mrp_tlv_setup_write_exact(tlv, prealloc);
+}
+
+
+int mrp_tlv_setup_write_exact(mrp_tlv_t *tlv, size_t size)
+{
+    if ((tlv->buf = mrp_allocz(size)) == NULL)
         return -1;
 
-    tlv->size  = prealloc;
+    tlv->size  = size;
     tlv->p     = tlv->buf;
     tlv->write = 1;
 
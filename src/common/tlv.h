@@ -59,6 +59,9 @@ typedef struct {
 /** Set up the given TLV buffer for encoding. */
 int mrp_tlv_setup_write(mrp_tlv_t *tlv, size_t prealloc);
 
+/** Set up the given TLV buffer for encoding exactly the given amount. */
+int mrp_tlv_setup_write_exact(mrp_tlv_t *tlv, size_t size);
+
 /** Set up the given TLV buffer for decoding. */
 int mrp_tlv_setup_read(mrp_tlv_t *tlv, void *buf, size_t size);
 
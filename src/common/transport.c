@@ -39,6 +39,8 @@
 static int check_destroy(mrp_transport_t *t);
 static int recv_data(mrp_transport_t *t, void *data, size_t size,
                      mrp_sockaddr_t *addr, socklen_t addrlen);
+static int recv_msg(mrp_transport_t *t, mrp_msg_t *msg,
+                    mrp_sockaddr_t *addr, socklen_t addrlen);
 static inline int purge_destroyed(mrp_transport_t *t);
 
 
@@ -165,6 +167,7 @@ mrp_transport_t *mrp_transport_create(mrp_mainloop_t *ml, const char *type,
 
             t->check_destroy = check_destroy;
             t->recv_data     = recv_data;
+            t->recv_msg      = recv_msg;
             t->flags         = flags & ~MRP_TRANSPORT_MODE_MASK;
             t->mode          = flags &  MRP_TRANSPORT_MODE_MASK;
 
@@ -206,6 +209,7 @@ mrp_transport_t *mrp_transport_create_from(mrp_mainloop_t *ml, const char *type,
 
             t->check_destroy = check_destroy;
             t->recv_data     = recv_data;
+            t->recv_msg      = recv_msg;
             t->flags         = flags & ~MRP_TRANSPORT_MODE_MASK;
             t->mode          = flags &  MRP_TRANSPORT_MODE_MASK;
 
@@ -249,6 +253,22 @@ int mrp_transport_setopt(mrp_transport_t *t, const char *opt, const void *val)
 }
 
 
+int mrp_transport_cork(mrp_transport_t *t)
+{
+    bool cork = TRUE;
+
+    return mrp_transport_setopt(t, MRP_TRANSPORT_OPT_CORK, &cork);
+}
+
+
+int mrp_transport_uncork(mrp_transport_t *t)
+{
+    bool cork = FALSE;
+
+    return mrp_transport_setopt(t, MRP_TRANSPORT_OPT_CORK, &cork);
+}
+
+
 static inline int type_matches(const char *type, const char *addr)
 {
     while (*type == *addr)
@@ -330,6 +350,7 @@ mrp_transport_t *mrp_transport_accept(mrp_transport_t *lt,
 
         t->check_destroy = check_destroy;
         t->recv_data     = recv_data;
+        t->recv_msg      = recv_msg;
         t->flags         = (lt->flags & MRP_TRANSPORT_INHERIT) | flags;
         t->flags         = t->flags & ~MRP_TRANSPORT_MODE_MASK;
         t->mode          = lt->mode;
@@ -668,6 +689,44 @@ int mrp_transport_sendjsonto(mrp_transport_t *t, mrp_json_t *msg,
 }
 
 
+static int recv_msg(mrp_transport_t *t, mrp_msg_t *msg,
+                    mrp_sockaddr_t *addr, socklen_t addrlen)
+{
+    /*
+     * Deliver an already constructed message. This is used both for
+     * messages decoded from the wire and by transports which can pass
+     * messages around without encoding them (eg. internal transports).
+     * The caller keeps its reference to msg.
+     */
+
+    if (t->mode != MRP_TRANSPORT_MODE_MSG)
+        return -EPROTOTYPE;
+
+    if (t->connected) {
+        MRP_TRANSPORT_BUSY(t, {
+                t->evt.recvmsg(t, msg, t->user_data);
+            });
+    }
+    else {
+        MRP_TRANSPORT_BUSY(t, {
+                t->evt.recvmsgfrom(t, msg, addr, addrlen, t->user_data);
+            });
+    }
+
+    return 0;
+}
+
+
+static inline uint16_t frame_tag(void *data)
+{
+    uint16_t tag;
+
+    memcpy(&tag, data, sizeof(tag));         /* might be unaligned */
+
+    return be16toh(tag);
+}
+
+
 static int recv_data(mrp_transport_t *t, void *data, size_t size,
                      mrp_sockaddr_t *addr, socklen_t addrlen)
 {
@@ -675,11 +734,11 @@ static int recv_data(mrp_transport_t *t, void *data, size_t size,
     uint16_t          tag;
     mrp_msg_t        *msg;
     uint32_t          type_id;
-    void             *decoded;
+    void             *decoded, *copy;
 
     switch (t->mode) {
     case MRP_TRANSPORT_MODE_DATA:
-        tag   = be16toh(*(uint16_t *)data);
+        tag   = frame_tag(data);
         data += sizeof(tag);
         size -= sizeof(tag);
         type  = mrp_msg_find_type(tag);
@@ -732,27 +791,22 @@ static int recv_data(mrp_transport_t *t, void *data, size_t size,
         return 0;
 
     case MRP_TRANSPORT_MODE_MSG:
-        tag   = be16toh(*(uint16_t *)data);
+        tag   = frame_tag(data);
         data += sizeof(tag);
         size -= sizeof(tag);
 
-        if (tag != MRP_MSG_TAG_DEFAULT ||
-            (msg = mrp_msg_default_decode(data, size)) == NULL) {
+        if (tag != MRP_MSG_TAG_DEFAULT)
+            return -EPROTO;
+
+        /* decode from a private copy to borrow strings and blobs from */
+        if ((copy = mrp_datadup(data, size)) == NULL)
+            return -ENOMEM;
+
+        if ((msg = mrp_msg_default_decode_lazy(copy, size)) == NULL) {
             return -EPROTO;
         }
         else {
-            if (t->connected) {
-                MRP_TRANSPORT_BUSY(t, {
-                        t->evt.recvmsg(t, msg, t->user_data);
-                    });
-            }
-            else {
-                MRP_TRANSPORT_BUSY(t, {
-                        t->evt.recvmsgfrom(t, msg, addr, addrlen,
-                                           t->user_data);
-                    });
-            }
-
+            recv_msg(t, msg, addr, addrlen);
             mrp_msg_unref(msg);
 
             return 0;
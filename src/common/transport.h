@@ -122,6 +122,11 @@ typedef enum {
 
 
 #define MRP_TRANSPORT_OPT_TYPEMAP "type-map"
+#define MRP_TRANSPORT_OPT_HIGHWM  "output-high-watermark" /* size_t */
+#define MRP_TRANSPORT_OPT_LOWWM   "output-low-watermark"  /* size_t */
+#define MRP_TRANSPORT_OPT_CORK    "cork"                  /* bool */
+#define MRP_TRANSPORT_OPT_BUDGET  "input-read-budget"     /* size_t */
+#define MRP_TRANSPORT_OPT_EDGE    "edge-triggered"        /* bool */
 
 /*
  * transport requests
@@ -249,6 +254,8 @@ typedef struct {
     void (*closed)(mrp_transport_t *t, int error, void *user_data);
     /** Connection attempt on a socket being listened on. */
     void (*connection)(mrp_transport_t *t, void *user_data);
+    /** Output queue went above the high or below the low watermark. */
+    void (*congested)(mrp_transport_t *t, int congested, void *user_data);
 } mrp_transport_evt_t;
 
 
@@ -279,6 +286,9 @@ typedef struct {
                                         size_t size,                      \
                                         mrp_sockaddr_t *addr,             \
                                         socklen_t addrlen);               \
+    int                    (*recv_msg)(mrp_transport_t *t, mrp_msg_t *msg, \
+                                       mrp_sockaddr_t *addr,              \
+                                       socklen_t addrlen);                \
     void                    *user_data;                                   \
     mrp_typemap_t           *map;                                         \
     int                      flags;                                       \
@@ -487,6 +497,15 @@ mrp_transport_t *mrp_transport_create_from(mrp_mainloop_t *ml, const char *type,
 /** Set a (possibly type-specific) transport option. */
 int mrp_transport_setopt(mrp_transport_t *t, const char *opt, const void *val);
 
+/**
+ * Cork a transport. Output is batched up until the transport is uncorked,
+ * which happens automatically at the end of the current mainloop iteration.
+ */
+int mrp_transport_cork(mrp_transport_t *t);
+
+/** Uncork a transport, flushing any batched up output. */
+int mrp_transport_uncork(mrp_transport_t *t);
+
 /** Resolve an address string to a transport-specific address. */
 socklen_t mrp_transport_resolve(mrp_transport_t *t, const char *str,
                                 mrp_sockaddr_t *addr, socklen_t addrlen,
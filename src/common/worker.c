@@ -0,0 +1,374 @@
+/*
+ * Copyright (c) 2012, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <unistd.h>
+#include <errno.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
+
+#include <murphy/common/macros.h>
+#include <murphy/common/mm.h>
+#include <murphy/common/log.h>
+#include <murphy/common/debug.h>
+#include <murphy/common/list.h>
+#include <murphy/common/mainloop.h>
+#include <murphy/common/worker.h>
+
+/*
+ * A job.
+ *
+ * Jobs are allocated and freed in the mainloop thread. While a job is
+ * pending it sits on the pool's job list which is protected by the pool
+ * lock. Once the work function has been run, the worker pushes the job
+ * to the completion queue, which is a lock-free, intrusive multiple-
+ * producer single-consumer queue (Vyukov's algorithm) consumed by the
+ * mainloop thread.
+ */
+
+typedef struct job_s job_t;
+
+struct job_s {
+    mrp_list_hook_t       hook;          /* to list of pending jobs */
+    job_t                *next;          /* to completion queue */
+    mrp_worker_work_cb_t  work;          /* work function */
+    mrp_worker_done_cb_t  done;          /* completion callback */
+    void                 *user_data;     /* opaque user data */
+};
+
+typedef struct {
+    job_t  *head;                        /* producers push here */
+    job_t  *tail;                        /* consumer pops here */
+    job_t   stub;                        /* dummy node */
+} mpscq_t;
+
+struct mrp_worker_pool_s {
+    mrp_mainloop_t  *ml;                 /* mainloop we dispatch in */
+    pthread_t       *threads;            /* worker threads */
+    int              nthread;            /* number of worker threads */
+    pthread_mutex_t  lock;               /* protects jobs and stop */
+    pthread_cond_t   cond;               /* signalled when jobs are added */
+    mrp_list_hook_t  jobs;               /* pending jobs */
+    int              stop;               /* workers should exit */
+    mpscq_t          doneq;              /* completed jobs */
+    int              efd;                /* eventfd for waking up */
+    int              signalled;          /* whether efd has been kicked */
+    mrp_io_watch_t  *w;                  /* I/O watch for efd */
+    mrp_deferred_t  *d;                  /* completion dispatcher */
+    int              busy;               /* dispatching completions */
+    int              dead;               /* destroyed while busy */
+};
+
+
+static void mpscq_init(mpscq_t *q)
+{
+    q->stub.next = NULL;
+    q->head      = &q->stub;
+    q->tail      = &q->stub;
+}
+
+
+static void mpscq_push(mpscq_t *q, job_t *j)
+{
+    job_t *prev;
+
+    __atomic_store_n(&j->next, NULL, __ATOMIC_RELAXED);
+    prev = __atomic_exchange_n(&q->head, j, __ATOMIC_ACQ_REL);
+    __atomic_store_n(&prev->next, j, __ATOMIC_RELEASE);
+}
+
+
+static job_t *mpscq_pop(mpscq_t *q)
+{
+    job_t *tail, *next, *head;
+
+    tail = q->tail;
+    next = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
+
+    if (tail == &q->stub) {
+        if (next == NULL)
+            return NULL;
+
+        q->tail = tail = next;
+        next    = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
+    }
+
+    if (next != NULL) {
+        q->tail = next;
+        return tail;
+    }
+
+    head = __atomic_load_n(&q->head, __ATOMIC_ACQUIRE);
+
+    /*
+     * If a producer is half-way through pushing, tail is not the last
+     * job yet. The producer will wake us up once it has finished.
+     */
+    if (tail != head)
+        return NULL;
+
+    mpscq_push(q, &q->stub);
+    next = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
+
+    if (next != NULL) {
+        q->tail = next;
+        return tail;
+    }
+
+    return NULL;
+}
+
+
+static void *worker_thread(void *ptr)
+{
+    mrp_worker_pool_t *pool = (mrp_worker_pool_t *)ptr;
+    job_t             *j;
+    uint64_t           one = 1;
+
+    for (;;) {
+        pthread_mutex_lock(&pool->lock);
+
+        while (!pool->stop && mrp_list_empty(&pool->jobs))
+            pthread_cond_wait(&pool->cond, &pool->lock);
+
+        if (pool->stop) {
+            pthread_mutex_unlock(&pool->lock);
+            break;
+        }
+
+        j = mrp_list_entry(pool->jobs.next, typeof(*j), hook);
+        mrp_list_delete(&j->hook);
+
+        pthread_mutex_unlock(&pool->lock);
+
+        j->work(j->user_data);
+
+        mpscq_push(&pool->doneq, j);
+
+        if (!__atomic_exchange_n(&pool->signalled, 1, __ATOMIC_SEQ_CST))
+            while (write(pool->efd, &one, sizeof(one)) < 0 && errno == EINTR)
+                ;
+    }
+
+    return NULL;
+}
+
+
+static void dispatch_done(mrp_worker_pool_t *pool)
+{
+    job_t *j;
+
+    __atomic_store_n(&pool->signalled, 0, __ATOMIC_SEQ_CST);
+
+    pool->busy++;
+
+    while ((j = mpscq_pop(&pool->doneq)) != NULL) {
+        if (j->done != NULL)
+            j->done(0, j->user_data);
+
+        mrp_free(j);
+    }
+
+    pool->busy--;
+}
+
+
+static void free_pool(mrp_worker_pool_t *pool)
+{
+    mrp_del_io_watch(pool->w);
+    mrp_del_deferred(pool->d);
+
+    if (pool->efd >= 0)
+        close(pool->efd);
+
+    pthread_cond_destroy(&pool->cond);
+    pthread_mutex_destroy(&pool->lock);
+
+    mrp_free(pool->threads);
+    mrp_free(pool);
+}
+
+
+static void done_cb(mrp_deferred_t *d, void *user_data)
+{
+    mrp_worker_pool_t *pool = (mrp_worker_pool_t *)user_data;
+
+    mrp_disable_deferred(d);
+    dispatch_done(pool);
+
+    if (pool->dead && !pool->busy)
+        free_pool(pool);
+}
+
+
+static void wakeup_cb(mrp_io_watch_t *w, int fd, mrp_io_event_t events,
+                      void *user_data)
+{
+    mrp_worker_pool_t *pool = (mrp_worker_pool_t *)user_data;
+    uint64_t           cnt;
+
+    MRP_UNUSED(w);
+
+    if (events & MRP_IO_EVENT_IN) {
+        if (read(fd, &cnt, sizeof(cnt)) == sizeof(cnt))
+            mrp_enable_deferred(pool->d);
+    }
+}
+
+
+static void stop_workers(mrp_worker_pool_t *pool)
+{
+    int i;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->stop = TRUE;
+    pthread_cond_broadcast(&pool->cond);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (i = 0; i < pool->nthread; i++)
+        pthread_join(pool->threads[i], NULL);
+
+    pool->nthread = 0;
+}
+
+
+mrp_worker_pool_t *mrp_worker_pool_create(mrp_mainloop_t *ml, int nthread)
+{
+    mrp_worker_pool_t *pool;
+    mrp_io_event_t     events;
+    int                i;
+
+    if (nthread <= 0)
+        nthread = MRP_MAX(sysconf(_SC_NPROCESSORS_ONLN), 1);
+
+    if ((pool = mrp_allocz(sizeof(*pool))) == NULL)
+        return NULL;
+
+    pool->ml  = ml;
+    pool->efd = -1;
+    mrp_list_init(&pool->jobs);
+    mpscq_init(&pool->doneq);
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->cond, NULL);
+
+    pool->efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+    if (pool->efd < 0)
+        goto fail;
+
+    events  = MRP_IO_EVENT_IN;
+    pool->w = mrp_add_io_watch(ml, pool->efd, events, wakeup_cb, pool);
+    pool->d = mrp_add_deferred(ml, done_cb, pool);
+
+    if (pool->w == NULL || pool->d == NULL)
+        goto fail;
+
+    mrp_disable_deferred(pool->d);
+
+    if ((pool->threads = mrp_allocz_array(pthread_t, nthread)) == NULL)
+        goto fail;
+
+    for (i = 0; i < nthread; i++) {
+        if (pthread_create(pool->threads + i, NULL, worker_thread, pool) != 0)
+            goto fail;
+
+        pool->nthread++;
+    }
+
+    mrp_debug("created worker pool %p with %d threads", pool, nthread);
+
+    return pool;
+
+ fail:
+    stop_workers(pool);
+    free_pool(pool);
+
+    return NULL;
+}
+
+
+void mrp_worker_pool_destroy(mrp_worker_pool_t *pool)
+{
+    mrp_list_hook_t *p, *n;
+    job_t           *j;
+
+    if (pool == NULL || pool->dead)
+        return;
+
+    mrp_debug("destroying worker pool %p", pool);
+
+    pool->dead = TRUE;
+    stop_workers(pool);
+
+    pool->busy++;
+
+    dispatch_done(pool);
+
+    mrp_list_foreach(&pool->jobs, p, n) {
+        j = mrp_list_entry(p, typeof(*j), hook);
+        mrp_list_delete(&j->hook);
+
+        if (j->done != NULL)
+            j->done(ECANCELED, j->user_data);
+
+        mrp_free(j);
+    }
+
+    pool->busy--;
+
+    if (!pool->busy)
+        free_pool(pool);
+}
+
+
+int mrp_worker_submit(mrp_worker_pool_t *pool, mrp_worker_work_cb_t work,
+                      mrp_worker_done_cb_t done, void *user_data)
+{
+    job_t *j;
+
+    if (pool == NULL || pool->dead || work == NULL) {
+        errno = EINVAL;
+        return FALSE;
+    }
+
+    if ((j = mrp_allocz(sizeof(*j))) == NULL)
+        return FALSE;
+
+    mrp_list_init(&j->hook);
+    j->work      = work;
+    j->done      = done;
+    j->user_data = user_data;
+
+    pthread_mutex_lock(&pool->lock);
+    mrp_list_append(&pool->jobs, &j->hook);
+    pthread_cond_signal(&pool->cond);
+    pthread_mutex_unlock(&pool->lock);
+
+    return TRUE;
+}
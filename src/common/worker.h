@@ -0,0 +1,134 @@
+/*
+ * Copyright (c) 2012, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __MURPHY_WORKER_H__
+#define __MURPHY_WORKER_H__
+
+#include <murphy/common/macros.h>
+#include <murphy/common/mainloop.h>
+
+MRP_CDECL_BEGIN
+
+/**
+ * \addtogroup MurphyCommonInfra
+ * @{
+ *
+ * @file worker.h
+ *
+ * @brief Murphy mainloop worker pools.
+ *
+ * A worker pool is a set of threads attached to a mainloop which can be
+ * used to execute CPU-heavy jobs, such as decoding large messages or
+ * formatting query results, off the mainloop thread. Every job consists
+ * of a work function, which is run in one of the worker threads, and of
+ * an optional completion callback, which is called from the mainloop once
+ * the work function has finished.
+ *
+ * Work functions run concurrently with the mainloop and with each other.
+ * They must not touch the mainloop or any other non-thread-safe Murphy
+ * object, and they must not use the Murphy memory allocator, which is
+ * not thread-safe in debug mode. Anything they need should be prepared
+ * before submitting the job and anything they produce should be consumed
+ * in the completion callback.
+ *
+ * Jobs are handed to the workers through a shared queue and completions
+ * are handed back through a lock-free queue. The mainloop is woken up via
+ * an eventfd and the completion callbacks are dispatched from a deferred
+ * callback.
+ */
+
+/**
+ * @brief Opaque Murphy worker pool type.
+ */
+typedef struct mrp_worker_pool_s mrp_worker_pool_t;
+
+/**
+ * @brief Work function, called in a worker thread.
+ *
+ * @param [in] user_data  opaque user data passed to @mrp_worker_submit
+ */
+typedef void (*mrp_worker_work_cb_t)(void *user_data);
+
+/**
+ * @brief Completion callback, called in the mainloop thread.
+ *
+ * @param [in] status     0 if the work function has been run, or
+ *                        ECANCELED if the pool was destroyed before the
+ *                        job got to run
+ * @param [in] user_data  opaque user data passed to @mrp_worker_submit
+ */
+typedef void (*mrp_worker_done_cb_t)(int status, void *user_data);
+
+/**
+ * @brief Create a new worker pool for the given mainloop.
+ *
+ * @param [in] ml        mainloop to dispatch completions in
+ * @param [in] nthread   number of worker threads, or 0 to start one
+ *                       per online CPU
+ *
+ * @return Returns the newly created pool, or @NULL upon failure.
+ */
+mrp_worker_pool_t *mrp_worker_pool_create(mrp_mainloop_t *ml, int nthread);
+
+/**
+ * @brief Destroy the given worker pool.
+ *
+ * Stops and joins all worker threads. Jobs being run are finished first
+ * and their completion callbacks are called with a status of 0. Jobs
+ * that have not been started are cancelled and their completion callbacks
+ * are called with a status of ECANCELED. Safe to be called from a
+ * completion callback.
+ *
+ * @param [in] pool  worker pool to destroy
+ */
+void mrp_worker_pool_destroy(mrp_worker_pool_t *pool);
+
+/**
+ * @brief Submit a job to the given worker pool.
+ *
+ * Must be called from the mainloop thread.
+ *
+ * @param [in] pool       worker pool to submit the job to
+ * @param [in] work       work function to call in a worker thread
+ * @param [in] done       callback to call in the mainloop once done, or
+ *                        @NULL
+ * @param [in] user_data  opaque user data to pass to the callbacks
+ *
+ * @return Returns @TRUE if the job was queued, @FALSE otherwise.
+ */
+int mrp_worker_submit(mrp_worker_pool_t *pool, mrp_worker_work_cb_t work,
+                      mrp_worker_done_cb_t done, void *user_data);
+
+/**
+ * @}
+ */
+
+MRP_CDECL_END
+
+#endif /* __MURPHY_WORKER_H__ */
@@ -0,0 +1,106 @@
+/*
+ * Copyright (c) 2012, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __MDB_BTREE_H__
+#define __MDB_BTREE_H__
+
+#include <murphy-db/mqi-types.h>
+
+
+#define MDB_BTREE_TABLE_CREATE(type, flags)                 \
+    mdb_btree_table_create(flags,                           \
+                           mqi_data_compare_##type,         \
+                           mqi_data_print_##type)
+
+#define MDB_BTREE_FOR_EACH(bt, data, cursor)                \
+    for (cursor = NULL;  (data = mdb_btree_iterate(bt, &cursor)); )
+
+#define MDB_BTREE_FOR_EACH_SAFE(bt, data, cursor)           \
+    MDB_BTREE_FOR_EACH(bt, data, cursor)
+
+#define MDB_BTREE_RANGE_FOR_EACH(rng, data)                 \
+    while ((data = mdb_btree_range_next(rng)))
+
+
+/*
+ * Allow several entries with equal keys. The keys of such entries are
+ * ordered by their addresses, so each key pointer may be added only
+ * once. Lookups by key are not possible, only range scans.
+ */
+#define MDB_BTREE_DUPLICATES  (1 << 0)
+
+typedef struct mdb_btree_s mdb_btree_t;
+
+typedef int  (*mdb_btree_compare_t)(int, void *, void *);
+typedef int  (*mdb_btree_print_t)(void *, char *, int);
+
+/*
+ * In-place range scan over the leaves. Unlike mdb_btree_iterate() this
+ * does not take a snapshot, so the tree must not be modified while
+ * the range is being walked.
+ */
+typedef struct {
+    mdb_btree_t *btree;
+    void        *leaf;          /* current leaf */
+    int          pos;           /* next entry within the leaf */
+    int          klen;          /* key length for comparison */
+    void        *hi;            /* upper bound or NULL if unbounded */
+    int          hi_incl;       /* whether the upper bound is included */
+} mdb_btree_range_t;
+
+
+mdb_btree_t *mdb_btree_table_create(int, mdb_btree_compare_t,
+                                    mdb_btree_print_t);
+int mdb_btree_table_destroy(mdb_btree_t *);
+int mdb_btree_table_get_size(mdb_btree_t *);
+int mdb_btree_table_reset(mdb_btree_t *);
+int mdb_btree_table_print(mdb_btree_t *, char *, int);
+
+int mdb_btree_add(mdb_btree_t *, int, void *, void *);
+int mdb_btree_bulk_add(mdb_btree_t *, int, int, void **, void **);
+void *mdb_btree_delete(mdb_btree_t *, int, void *);
+void *mdb_btree_get_data(mdb_btree_t *, int, void *);
+int mdb_btree_compare(mdb_btree_t *, int, void *, void *);
+void *mdb_btree_iterate(mdb_btree_t *, void **);
+void mdb_btree_cursor_destroy(mdb_btree_t *, void **);
+
+int mdb_btree_range_init(mdb_btree_t *, mdb_btree_range_t *, int,
+                         void *, int, void *, int);
+void *mdb_btree_range_next(mdb_btree_range_t *);
+
+
+#endif /* __MDB_BTREE_H__ */
+
+/*
+ * Local Variables:
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ *
+ */
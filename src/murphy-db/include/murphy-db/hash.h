@@ -56,7 +56,7 @@
 
 typedef struct mdb_hash_s mdb_hash_t;
 
-typedef int  (*mdb_hash_function_t)(int, int, int, void *);
+typedef uint32_t (*mdb_hash_function_t)(int, void *);
 typedef int  (*mdb_hash_compare_t)(int, void *, void *);
 typedef int  (*mdb_hash_print_t)(void *, char *, int);
 
@@ -72,12 +72,12 @@ int mdb_hash_add(mdb_hash_t *, int, void *, void *);
 void *mdb_hash_delete(mdb_hash_t *, int, void *);
 void *mdb_hash_get_data(mdb_hash_t *, int, void *);
 
-int mdb_hash_function_integer(int, int, int, void *);
-int mdb_hash_function_unsignd(int, int, int, void *);
-int mdb_hash_function_string(int, int, int, void *);
-int mdb_hash_function_pointer(int, int, int, void *);
-int mdb_hash_function_varchar(int, int, int, void *);
-int mdb_hash_function_blob(int, int, int, void *);
+uint32_t mdb_hash_function_integer(int, void *);
+uint32_t mdb_hash_function_unsignd(int, void *);
+uint32_t mdb_hash_function_string(int, void *);
+uint32_t mdb_hash_function_pointer(int, void *);
+uint32_t mdb_hash_function_varchar(int, void *);
+uint32_t mdb_hash_function_blob(int, void *);
 
 
 #endif /* __MDB_HASH_H__ */
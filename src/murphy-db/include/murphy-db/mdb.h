@@ -33,6 +33,7 @@
 #include <murphy-db/mqi-types.h>
 
 typedef struct mdb_table_s mdb_table_t;
+typedef struct mdb_select_cursor_s mdb_select_cursor_t;
 
 
 int mdb_trigger_add_column_callback(mdb_table_t *, int, mqi_trigger_cb_t,
@@ -42,6 +43,10 @@ int mdb_trigger_delete_column_callback(mdb_table_t *, int,
 int mdb_trigger_add_row_callback(mdb_table_t *, mqi_trigger_cb_t, void *,
                                mqi_column_desc_t *);
 int mdb_trigger_delete_row_callback(mdb_table_t *, mqi_trigger_cb_t, void *);
+int mdb_trigger_add_changeset_callback(mdb_table_t *, mqi_trigger_cb_t,
+                                       void *, mqi_column_desc_t *);
+int mdb_trigger_delete_changeset_callback(mdb_table_t *, mqi_trigger_cb_t,
+                                          void *);
 int mdb_trigger_add_table_callback(mqi_trigger_cb_t, void *);
 int mdb_trigger_delete_table_callback(mqi_trigger_cb_t, void *);
 int mdb_trigger_add_transaction_callback(mqi_trigger_cb_t, void *);
@@ -57,12 +62,23 @@ mdb_table_t *mdb_table_create(char *, char **, mqi_column_def_t *);
 int mdb_table_register_handle(mdb_table_t *, mqi_handle_t);
 int mdb_table_drop(mdb_table_t *);
 int mdb_table_create_index(mdb_table_t *, char **);
+int mdb_table_create_secondary_index(mdb_table_t *, char *, char **);
+int mdb_table_drop_secondary_index(mdb_table_t *, char *);
 int mdb_table_describe(mdb_table_t *, mqi_column_def_t *, int);
 int mdb_table_insert(mdb_table_t *, int, mqi_column_desc_t *, void **);
+int mdb_table_bulk_insert(mdb_table_t *, mqi_column_desc_t *, void **);
 int mdb_table_select(mdb_table_t *, mqi_cond_entry_t *,
                      mqi_column_desc_t *, void *, int, int);
 int mdb_table_select_by_index(mdb_table_t *, mqi_variable_t *,
                               mqi_column_desc_t *, void *);
+mdb_select_cursor_t *mdb_table_select_cursor_open(mdb_table_t *,
+                                                  mqi_cond_entry_t *,
+                                                  mqi_column_desc_t *);
+int mdb_table_select_cursor_next(mdb_table_t *, mdb_select_cursor_t *,
+                                 void *, int, int);
+int mdb_table_select_cursor_next_ref(mdb_table_t *, mdb_select_cursor_t *,
+                                     const void **, int);
+void mdb_table_select_cursor_close(mdb_select_cursor_t *);
 int mdb_table_update(mdb_table_t *, mqi_cond_entry_t *,
                      mqi_column_desc_t *, void *);
 int mdb_table_delete(mdb_table_t *, mqi_cond_entry_t *);
@@ -74,8 +90,17 @@ int mdb_table_get_size(mdb_table_t *);
 char *mdb_table_get_column_name(mdb_table_t *, int);
 mqi_data_type_t mdb_table_get_column_type(mdb_table_t *, int);
 int mdb_table_get_column_size(mdb_table_t *, int);
+int mdb_table_get_column_offset(mdb_table_t *, int);
 uint32_t mdb_table_get_stamp(mdb_table_t *);
 int mdb_table_print_rows(mdb_table_t *, char *, int);
+int mdb_table_save_snapshot(mdb_table_t *, const char *);
+int mdb_table_load_snapshot(mdb_table_t *, const char *);
+
+int mdb_wal_open(const char *, int);
+int mdb_wal_close(void);
+int mdb_wal_attach(mdb_table_t *);
+int mdb_wal_sync(void);
+int mdb_wal_compact(void);
 
 
 #endif /* __MDB_MDB_H__ */
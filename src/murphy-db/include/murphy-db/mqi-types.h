@@ -118,7 +118,8 @@ enum mqi_event_type_e {
     mqi_table_created,
     mqi_table_dropped,
     mqi_transaction_start,
-    mqi_transaction_end
+    mqi_transaction_end,
+    mqi_table_changed
 };
 
 
@@ -134,6 +135,7 @@ typedef enum mqi_operator_e          mqi_operator_t;
 typedef struct mqi_variable_s        mqi_variable_t;
 typedef enum mqi_cond_entry_type_e   mqi_cond_entry_type_t;
 typedef struct mqi_cond_entry_s      mqi_cond_entry_t;
+typedef struct mqi_select_cursor_s   mqi_select_cursor_t;
 
 typedef enum mqi_event_type_e        mqi_event_type_t;
 typedef union mqi_event_u            mqi_event_t;
@@ -143,11 +145,13 @@ typedef struct mqi_change_select_s   mqi_change_select_t;
 typedef struct mqi_change_coldsc_s   mqi_change_coldsc_t;
 typedef union mqi_change_data_u      mqi_change_data_t;
 typedef struct mqi_change_value_s    mqi_change_value_t;
+typedef struct mqi_row_change_s      mqi_row_change_t;
 
 typedef struct mqi_column_event_s    mqi_column_event_t;
 typedef struct mqi_row_event_s       mqi_row_event_t;
 typedef struct mqi_table_event_s     mqi_table_event_t;
 typedef struct mqi_transact_event_s  mqi_transact_event_t;
+typedef struct mqi_changeset_event_s mqi_changeset_event_t;
 
 typedef void (*mqi_trigger_cb_t)(mqi_event_t *, void *);
 
@@ -219,6 +223,14 @@ struct mqi_change_value_s {
     mqi_change_data_t new_;
 };
 
+struct mqi_row_change_s {
+    mqi_event_type_t  event;    /* mqi_row_inserted, _deleted or
+                                   mqi_column_changed for updates */
+    mqi_bitfld_t      colmask;  /* changed columns */
+    void             *before;   /* selected columns, NULL for inserts */
+    void             *after;    /* selected columns, NULL for deletes */
+};
+
 
 struct mqi_column_event_s {
     mqi_event_type_t    event;
@@ -244,13 +256,24 @@ struct mqi_transact_event_s {
     uint32_t          depth;
 };
 
+struct mqi_changeset_event_s {
+    mqi_event_type_t    event;
+    mqi_change_table_t  table;
+    int                 ninsert;
+    int                 ndelete;
+    int                 nupdate;
+    int                 nchange;
+    mqi_row_change_t   *changes;
+};
+
 
 union mqi_event_u {
-    mqi_event_type_t     event;
-    mqi_column_event_t   column;
-    mqi_row_event_t      row;
-    mqi_table_event_t    table;
-    mqi_transact_event_t transact;
+    mqi_event_type_t      event;
+    mqi_column_event_t    column;
+    mqi_row_event_t       row;
+    mqi_table_event_t     table;
+    mqi_transact_event_t  transact;
+    mqi_changeset_event_t changeset;
 };
 
 
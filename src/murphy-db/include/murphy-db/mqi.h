@@ -140,10 +140,17 @@
 #define MQI_REPLACE(table, column_descs, data)                  \
     mqi_insert_into(table, 1, column_descs, (void **)data)
 
+#define MQI_BULK_INSERT(table, column_descs, data)              \
+    mqi_bulk_insert(table, column_descs, (void **)data)
+
 #define MQI_SELECT(columns, table, where, result)               \
     mqi_select(table, where, columns, result,                   \
                sizeof(result[0]), MQI_DIMENSION(result))
 
+#define MQI_SELECT_CURSOR_NEXT(cursor, result)                  \
+    mqi_select_cursor_next(cursor, result, sizeof(result[0]),   \
+                           MQI_DIMENSION(result))
+
 #define MQI_SELECT_BY_INDEX(columns, table, idxvars, result)    \
     mqi_select_by_index(table, idxvars, columns, result)
 
@@ -166,10 +173,13 @@ int mqi_create_row_trigger(mqi_handle_t, mqi_trigger_cb_t, void *,
                            mqi_column_desc_t *);
 int mqi_create_column_trigger(mqi_handle_t, int, mqi_trigger_cb_t, void *,
                               mqi_column_desc_t *);
+int mqi_create_changeset_trigger(mqi_handle_t, mqi_trigger_cb_t, void *,
+                                 mqi_column_desc_t *);
 int mqi_drop_transaction_trigger(mqi_trigger_cb_t, void *);
 int mqi_drop_table_trigger(mqi_trigger_cb_t, void *);
 int mqi_drop_row_trigger(mqi_handle_t, mqi_trigger_cb_t,void *);
 int mqi_drop_column_trigger(mqi_handle_t, int, mqi_trigger_cb_t, void *);
+int mqi_drop_changeset_trigger(mqi_handle_t, mqi_trigger_cb_t, void *);
 mqi_handle_t mqi_begin_transaction(void);
 int mqi_commit_transaction(mqi_handle_t);
 int mqi_rollback_transaction(mqi_handle_t);
@@ -177,15 +187,23 @@ mqi_handle_t mqi_get_transaction_handle(void);
 uint32_t mqi_get_transaction_depth(void);
 mqi_handle_t mqi_create_table(char *, uint32_t, char **, mqi_column_def_t *);
 int mqi_create_index(mqi_handle_t, char **);
+int mqi_create_secondary_index(mqi_handle_t, char *, char **);
+int mqi_drop_secondary_index(mqi_handle_t, char *);
 int mqi_drop_table(mqi_handle_t);
 int mqi_describe(mqi_handle_t, mqi_column_def_t *, int);
 int mqi_insert_into(mqi_handle_t, int, mqi_column_desc_t *, void **);
+int mqi_bulk_insert(mqi_handle_t, mqi_column_desc_t *, void **);
 int mqi_delete_from(mqi_handle_t, mqi_cond_entry_t *);
 int mqi_update(mqi_handle_t, mqi_cond_entry_t *, mqi_column_desc_t *, void *);
 int mqi_select(mqi_handle_t, mqi_cond_entry_t *, mqi_column_desc_t *,
                void *, int, int);
 int mqi_select_by_index(mqi_handle_t, mqi_variable_t *,
                         mqi_column_desc_t *, void *);
+mqi_select_cursor_t *mqi_select_cursor_open(mqi_handle_t, mqi_cond_entry_t *,
+                                            mqi_column_desc_t *);
+int mqi_select_cursor_next(mqi_select_cursor_t *, void *, int, int);
+int mqi_select_cursor_next_ref(mqi_select_cursor_t *, const void **, int);
+int mqi_select_cursor_close(mqi_select_cursor_t *);
 
 mqi_handle_t mqi_get_table_handle(char *);
 int mqi_get_column_index(mqi_handle_t, char *);
@@ -193,8 +211,11 @@ int mqi_get_table_size(mqi_handle_t);
 char *mqi_get_column_name(mqi_handle_t, int);
 mqi_data_type_t mqi_get_column_type(mqi_handle_t, int);
 int mqi_get_column_size(mqi_handle_t, int);
+int mqi_get_column_offset(mqi_handle_t, int);
 uint32_t mqi_get_table_stamp(mqi_handle_t);
 int mqi_print_rows(mqi_handle_t, char *, int);
+int mqi_save_snapshot(mqi_handle_t, const char *);
+int mqi_load_snapshot(mqi_handle_t, const char *);
 
 
 #endif /* __MQI_MQI_H__ */
@@ -43,6 +43,7 @@ enum mql_result_type_e {
     mql_result_rows,       /**< select'ed rows */
     mql_result_string,     /**< zero terminated ASCII string  */
     mql_result_list,       /**< array of basic types, (integer, string, etc) */
+    mql_result_cursor,     /**< select'ed rows, fetched in batches */
 };
 
 typedef enum mql_result_type_e  mql_result_type_t;
@@ -88,6 +89,14 @@ int32_t          mql_result_rows_get_integer(mql_result_t *, int,int);
 uint32_t         mql_result_rows_get_unsigned(mql_result_t *, int,int);
 double           mql_result_rows_get_floating(mql_result_t *, int,int);
 
+int              mql_result_cursor_next(mql_result_t *);
+int              mql_result_cursor_get_column_count(mql_result_t *);
+mqi_data_type_t  mql_result_cursor_get_column_type(mql_result_t *, int);
+const char      *mql_result_cursor_get_string(mql_result_t *, int, char *,int);
+int32_t          mql_result_cursor_get_integer(mql_result_t *, int);
+uint32_t         mql_result_cursor_get_unsigned(mql_result_t *, int);
+double           mql_result_cursor_get_floating(mql_result_t *, int);
+
 const char      *mql_result_string_get(mql_result_t *);
 
 int              mql_result_list_get_length(mql_result_t *);
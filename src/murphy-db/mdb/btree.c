@@ -0,0 +1,971 @@
+/*
+ * Copyright (c) 2012, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#define _GNU_SOURCE
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <errno.h>
+#include <string.h>
+
+#include <murphy-db/macros.h>
+#include <murphy-db/btree.h>
+
+/*
+ * B+tree keeping all entries in its leaves, with the leaves chained in
+ * key order for range scans. A node is 248 bytes on LP64 and is cache
+ * line aligned, so it spans four cache lines. Like with the hash and
+ * sequence tables keys are not copied: they point into the indexed data,
+ * and every key in an inner node is the key of some live leaf entry.
+ */
+
+#define BTREE_CACHELINE  64
+#define BTREE_ORDER      14                   /* max. keys per node */
+#define BTREE_MIN        (BTREE_ORDER / 2)    /* min. keys per non-root */
+
+typedef struct btree_node_s btree_node_t;
+
+struct btree_node_s {
+    uint16_t          leaf;
+    uint16_t          nkey;
+    btree_node_t     *next;       /* next leaf, or next spare node */
+    void             *keys[BTREE_ORDER];
+    union {
+        void         *data[BTREE_ORDER + 1];
+        btree_node_t *child[BTREE_ORDER + 1];
+    };
+};
+
+struct mdb_btree_s {
+    int                  flags;
+    mdb_btree_compare_t  scomp;
+    mdb_btree_print_t    sprint;
+    btree_node_t        *root;
+    int                  depth;   /* 0: empty tree, 1: root is a leaf */
+    int                  nentry;
+    btree_node_t        *spare;   /* nodes reserved for splitting */
+    int                  nspare;
+};
+
+typedef struct {
+    int   index;
+    int   nentry;
+    void *entries[];
+} btree_cursor_t;
+
+typedef struct {
+    void *key;
+    void *data;
+} btree_entry_t;
+
+typedef struct {
+    mdb_btree_t *bt;
+    int          klen;
+} btree_sort_t;                   /* context for compare_entries() */
+
+
+static int reserve_nodes(mdb_btree_t *, int);
+static btree_node_t *alloc_node(mdb_btree_t *, int);
+static void destroy_node(btree_node_t *);
+static btree_node_t *first_leaf(mdb_btree_t *);
+static inline int compare(mdb_btree_t *, int, void *, int, void *);
+static int node_find(mdb_btree_t *, btree_node_t *, int, void *, int, int *);
+static int insert_node(mdb_btree_t *, btree_node_t *, int, void *, void *,
+                       void **, btree_node_t **);
+static int insert_leaf(mdb_btree_t *, btree_node_t *, int, void *, void *,
+                       void **, btree_node_t **);
+static int insert_inner(mdb_btree_t *, btree_node_t *, int, void *,
+                        btree_node_t *, void **, btree_node_t **);
+static void *delete_node(mdb_btree_t *, btree_node_t *, int, void *, void **);
+static void rebalance(btree_node_t *, int);
+static void borrow_left(btree_node_t *, int);
+static void borrow_right(btree_node_t *, int);
+static void merge(btree_node_t *, int);
+static int compare_entries(const void *, const void *, void *);
+static void build_tree(mdb_btree_t *, int, btree_entry_t *);
+
+static btree_cursor_t empty_cursor;
+
+
+mdb_btree_t *mdb_btree_table_create(int                 flags,
+                                    mdb_btree_compare_t scomp,
+                                    mdb_btree_print_t   sprint)
+{
+    mdb_btree_t *bt;
+
+    MDB_CHECKARG(scomp && sprint, NULL);
+
+    if (!(bt = calloc(1, sizeof(mdb_btree_t)))) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    bt->flags  = flags;
+    bt->scomp  = scomp;
+    bt->sprint = sprint;
+
+    return bt;
+}
+
+int mdb_btree_table_destroy(mdb_btree_t *bt)
+{
+    MDB_CHECKARG(bt, -1);
+
+    mdb_btree_table_reset(bt);
+    free(bt);
+
+    return 0;
+}
+
+int mdb_btree_table_get_size(mdb_btree_t *bt)
+{
+    MDB_CHECKARG(bt, -1);
+
+    return bt->nentry;
+}
+
+int mdb_btree_table_reset(mdb_btree_t *bt)
+{
+    btree_node_t *node;
+
+    MDB_CHECKARG(bt, -1);
+
+    if (bt->root)
+        destroy_node(bt->root);
+
+    while ((node = bt->spare)) {
+        bt->spare = node->next;
+        free(node);
+    }
+
+    bt->root   = NULL;
+    bt->depth  = 0;
+    bt->nentry = 0;
+    bt->nspare = 0;
+
+    return 0;
+}
+
+int mdb_btree_table_print(mdb_btree_t *bt, char *buf, int len)
+{
+    btree_node_t *leaf;
+    char         *p, *e;
+    int           i, j;
+    char          key[256];
+
+    MDB_CHECKARG(bt && buf && len > 0, 0);
+
+    e = (p = buf) + len;
+    *buf = '\0';
+
+    for (leaf = first_leaf(bt), i = 0;  leaf && p < e;  leaf = leaf->next) {
+        for (j = 0;  j < leaf->nkey && p < e;  j++, i++) {
+            bt->sprint(leaf->keys[j], key, sizeof(key));
+            p += snprintf(p, e-p, "   %05d: '%s' / %p\n",
+                          i, key, leaf->data[j]);
+        }
+    }
+
+    return p - buf;
+}
+
+int mdb_btree_add(mdb_btree_t *bt, int klen, void *key, void *data)
+{
+    btree_node_t *root, *upnode;
+    void         *upkey;
+    int           split;
+
+    MDB_CHECKARG(bt && key && data, -1);
+
+    /* make sure a split can never fail half way through */
+    if (reserve_nodes(bt, bt->depth + 1) < 0)
+        return -1;
+
+    if (!bt->root) {
+        bt->root  = alloc_node(bt, 1);
+        bt->depth = 1;
+    }
+
+    split = insert_node(bt, bt->root, klen,key, data, &upkey, &upnode);
+
+    if (split < 0)
+        return -1;
+
+    if (split) {
+        root = alloc_node(bt, 0);
+
+        root->nkey     = 1;
+        root->keys[0]  = upkey;
+        root->child[0] = bt->root;
+        root->child[1] = upnode;
+
+        bt->root = root;
+        bt->depth++;
+    }
+
+    bt->nentry++;
+
+    return 0;
+}
+
+/*
+ * Add a batch of entries at once. If the tree is empty the entries
+ * are sorted and the tree is built bottom up with full leaves, which is
+ * much cheaper than adding them one by one. Duplicate keys (unless the
+ * tree allows them) make the whole batch fail with EEXIST.
+ */
+int mdb_btree_bulk_add(mdb_btree_t *bt, int klen, int n, void **keys,
+                       void **data)
+{
+    btree_entry_t *entries;
+    btree_sort_t   ctx;
+    int            i;
+
+    MDB_CHECKARG(bt && n >= 0 && (!n || (keys && data)), -1);
+
+    if (bt->root) {
+        for (i = 0;  i < n;  i++) {
+            if (mdb_btree_add(bt, klen, keys[i], data[i]) < 0)
+                return -1;
+        }
+
+        return 0;
+    }
+
+    if (!n)
+        return 0;
+
+    if (!(entries = malloc(sizeof(btree_entry_t) * n))) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    for (i = 0;  i < n;  i++) {
+        entries[i].key  = keys[i];
+        entries[i].data = data[i];
+    }
+
+    ctx.bt   = bt;
+    ctx.klen = klen;
+
+    qsort_r(entries, n, sizeof(btree_entry_t), compare_entries, &ctx);
+
+    for (i = 1;  i < n;  i++) {
+        if (!compare(bt, klen, entries[i-1].key, 0, entries[i].key)) {
+            free(entries);
+            errno = EEXIST;
+            return -1;
+        }
+    }
+
+    build_tree(bt, n, entries);
+    free(entries);
+
+    if (!bt->root) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    return 0;
+}
+
+void *mdb_btree_delete(mdb_btree_t *bt, int klen, void *key)
+{
+    btree_node_t *root;
+    void         *data;
+    void         *dkey;
+
+    MDB_CHECKARG(bt && key, NULL);
+
+    if (!(root = bt->root)) {
+        errno = ENOENT;
+        return NULL;
+    }
+
+    if (!(data = delete_node(bt, root, klen,key, &dkey)))
+        return NULL;
+
+    bt->nentry--;
+
+    if (!root->nkey) {
+        if (root->leaf) {
+            bt->root  = NULL;
+            bt->depth = 0;
+        }
+        else {
+            bt->root = root->child[0];
+            bt->depth--;
+        }
+
+        free(root);
+    }
+
+    return data;
+}
+
+void *mdb_btree_get_data(mdb_btree_t *bt, int klen, void *key)
+{
+    btree_node_t *node;
+    int           found;
+    int           i;
+
+    MDB_CHECKARG(bt && key, NULL);
+
+    for (node = bt->root;  node;  node = node->child[i]) {
+        i = node_find(bt, node, klen,key, 0, &found);
+
+        if (node->leaf)
+            return found ? node->data[i] : NULL;
+
+        if (found)
+            i++;
+    }
+
+    return NULL;
+}
+
+int mdb_btree_compare(mdb_btree_t *bt, int klen, void *key1, void *key2)
+{
+    MDB_CHECKARG(bt && key1 && key2, 0);
+
+    return bt->scomp(klen, key1, key2);
+}
+
+void *mdb_btree_iterate(mdb_btree_t *bt, void **cursor_ptr)
+{
+    btree_cursor_t *cursor;
+    btree_node_t   *leaf;
+    size_t          length;
+    int             i, j;
+
+    MDB_CHECKARG(bt && cursor_ptr, NULL);
+
+    if (!(cursor = *cursor_ptr)) {
+        length = sizeof(btree_cursor_t) + sizeof(void *) * bt->nentry;
+
+        if (!(cursor = malloc(length)))
+            return NULL;
+
+        cursor->index  = 0;
+        cursor->nentry = bt->nentry;
+
+        for (leaf = first_leaf(bt), i = 0;  leaf;  leaf = leaf->next) {
+            for (j = 0;  j < leaf->nkey;  j++)
+                cursor->entries[i++] = leaf->data[j];
+        }
+
+        *cursor_ptr = cursor;
+    }
+
+    if (cursor->index >= cursor->nentry) {
+        if (cursor != &empty_cursor) {
+            *cursor_ptr = &empty_cursor;
+            free(cursor);
+        }
+        return NULL;
+    }
+
+    return cursor->entries[cursor->index++];
+}
+
+void mdb_btree_cursor_destroy(mdb_btree_t *bt, void **cursor)
+{
+    (void)bt;
+
+    if (cursor && *cursor != &empty_cursor)
+        free(*cursor);
+}
+
+int mdb_btree_range_init(mdb_btree_t       *bt,
+                         mdb_btree_range_t *rng,
+                         int                klen,
+                         void              *lo,
+                         int                lo_incl,
+                         void              *hi,
+                         int                hi_incl)
+{
+    btree_node_t *node;
+    int           found;
+    int           i;
+
+    MDB_CHECKARG(bt && rng, -1);
+
+    rng->btree   = bt;
+    rng->klen    = klen;
+    rng->hi      = hi;
+    rng->hi_incl = hi_incl;
+
+    if (!lo) {
+        rng->leaf = first_leaf(bt);
+        rng->pos  = 0;
+        return 0;
+    }
+
+    /* a tie puts lo before or after all the entries with an equal key */
+    for (node = bt->root, i = 0;  node;  node = node->child[i]) {
+        i = node_find(bt, node, klen,lo, lo_incl ? -1 : 1, &found);
+
+        if (node->leaf)
+            break;
+    }
+
+    rng->leaf = node;
+    rng->pos  = i;
+
+    return 0;
+}
+
+void *mdb_btree_range_next(mdb_btree_range_t *rng)
+{
+    btree_node_t *leaf;
+    void         *key;
+    int           cmp;
+
+    MDB_CHECKARG(rng, NULL);
+
+    for (leaf = rng->leaf;  leaf && rng->pos >= leaf->nkey;  leaf = leaf->next)
+        rng->pos = 0;
+
+    if (!(rng->leaf = leaf))
+        return NULL;
+
+    key = leaf->keys[rng->pos];
+
+    if (rng->hi) {
+        cmp = rng->btree->scomp(rng->klen, key, rng->hi);
+
+        if (cmp > 0 || (!cmp && !rng->hi_incl)) {
+            rng->leaf = NULL;
+            return NULL;
+        }
+    }
+
+    return leaf->data[rng->pos++];
+}
+
+
+static int reserve_nodes(mdb_btree_t *bt, int n)
+{
+    btree_node_t *node;
+    void         *mem;
+
+    while (bt->nspare < n) {
+        if (posix_memalign(&mem, BTREE_CACHELINE, sizeof(btree_node_t))) {
+            errno = ENOMEM;
+            return -1;
+        }
+
+        node = mem;
+        node->next = bt->spare;
+
+        bt->spare = node;
+        bt->nspare++;
+    }
+
+    return 0;
+}
+
+static btree_node_t *alloc_node(mdb_btree_t *bt, int leaf)
+{
+    btree_node_t *node = bt->spare;
+
+    bt->spare = node->next;
+    bt->nspare--;
+
+    memset(node, 0, sizeof(*node));
+    node->leaf = leaf;
+
+    return node;
+}
+
+static void destroy_node(btree_node_t *node)
+{
+    int i;
+
+    if (!node->leaf) {
+        for (i = 0;  i <= node->nkey;  i++)
+            destroy_node(node->child[i]);
+    }
+
+    free(node);
+}
+
+static btree_node_t *first_leaf(mdb_btree_t *bt)
+{
+    btree_node_t *node;
+
+    for (node = bt->root;  node && !node->leaf;  node = node->child[0])
+        ;
+
+    return node;
+}
+
+static inline int compare(mdb_btree_t *bt,
+                          int          klen,
+                          void        *key,
+                          int          tie,
+                          void        *nkey)
+{
+    int cmp;
+
+    if ((cmp = bt->scomp(klen, key, nkey)))
+        return cmp;
+
+    if (tie)
+        return tie;
+
+    if (!(bt->flags & MDB_BTREE_DUPLICATES))
+        return 0;
+
+    if ((char *)key == (char *)nkey)
+        return 0;
+
+    return (char *)key < (char *)nkey ? -1 : 1;
+}
+
+static int node_find(mdb_btree_t  *bt,
+                     btree_node_t *node,
+                     int           klen,
+                     void         *key,
+                     int           tie,
+                     int          *found)
+{
+    int min, max, i, cmp;
+
+    *found = 0;
+
+    for (min = 0, max = node->nkey;  min < max;  ) {
+        i = (min + max) / 2;
+
+        if ((cmp = compare(bt, klen, key, tie, node->keys[i])) > 0)
+            min = i + 1;
+        else {
+            if (!cmp)
+                *found = 1;
+            max = i;
+        }
+    }
+
+    return min;
+}
+
+static int insert_node(mdb_btree_t   *bt,
+                       btree_node_t  *node,
+                       int            klen,
+                       void          *key,
+                       void          *data,
+                       void         **upkey,
+                       btree_node_t **upnode)
+{
+    btree_node_t *child;
+    void         *ckey;
+    int           found;
+    int           split;
+    int           i;
+
+    i = node_find(bt, node, klen,key, 0, &found);
+
+    if (node->leaf) {
+        if (found) {
+            errno = EEXIST;
+            return -1;
+        }
+
+        return insert_leaf(bt, node, i, key, data, upkey, upnode);
+    }
+
+    if (found)
+        i++;
+
+    split = insert_node(bt, node->child[i], klen,key, data, &ckey, &child);
+
+    if (split <= 0)
+        return split;
+
+    return insert_inner(bt, node, i, ckey, child, upkey, upnode);
+}
+
+static int insert_leaf(mdb_btree_t   *bt,
+                       btree_node_t  *node,
+                       int            pos,
+                       void          *key,
+                       void          *data,
+                       void         **upkey,
+                       btree_node_t **upnode)
+{
+    btree_node_t *right;
+    void         *keys[BTREE_ORDER + 1];
+    void         *ptrs[BTREE_ORDER + 1];
+    int           n = node->nkey;
+    int           m;
+
+    if (n < BTREE_ORDER) {
+        memmove(node->keys + pos+1, node->keys + pos, sizeof(void *)*(n-pos));
+        memmove(node->data + pos+1, node->data + pos, sizeof(void *)*(n-pos));
+
+        node->keys[pos] = key;
+        node->data[pos] = data;
+        node->nkey++;
+
+        return 0;
+    }
+
+    memcpy(keys, node->keys, sizeof(void *) * pos);
+    memcpy(ptrs, node->data, sizeof(void *) * pos);
+    keys[pos] = key;
+    ptrs[pos] = data;
+    memcpy(keys + pos+1, node->keys + pos, sizeof(void *) * (n-pos));
+    memcpy(ptrs + pos+1, node->data + pos, sizeof(void *) * (n-pos));
+
+    right = alloc_node(bt, 1);
+    m     = (BTREE_ORDER + 1) / 2;
+
+    node->nkey  = m;
+    right->nkey = n+1 - m;
+
+    memcpy(node->keys, keys, sizeof(void *) * m);
+    memcpy(node->data, ptrs, sizeof(void *) * m);
+    memcpy(right->keys, keys + m, sizeof(void *) * (n+1 - m));
+    memcpy(right->data, ptrs + m, sizeof(void *) * (n+1 - m));
+
+    right->next = node->next;
+    node->next  = right;
+
+    *upkey  = right->keys[0];
+    *upnode = right;
+
+    return 1;
+}
+
+static int insert_inner(mdb_btree_t   *bt,
+                        btree_node_t  *node,
+                        int            pos,
+                        void          *key,
+                        btree_node_t  *child,
+                        void         **upkey,
+                        btree_node_t **upnode)
+{
+    btree_node_t *right;
+    void         *keys[BTREE_ORDER + 1];
+    btree_node_t *ptrs[BTREE_ORDER + 2];
+    int           n = node->nkey;
+    int           m;
+
+    if (n < BTREE_ORDER) {
+        memmove(node->keys  + pos+1, node->keys  + pos,
+                sizeof(void *) * (n-pos));
+        memmove(node->child + pos+2, node->child + pos+1,
+                sizeof(void *) * (n-pos));
+
+        node->keys[pos]    = key;
+        node->child[pos+1] = child;
+        node->nkey++;
+
+        return 0;
+    }
+
+    memcpy(keys, node->keys,  sizeof(void *) * pos);
+    memcpy(ptrs, node->child, sizeof(void *) * (pos+1));
+    keys[pos]   = key;
+    ptrs[pos+1] = child;
+    memcpy(keys + pos+1, node->keys  + pos,   sizeof(void *) * (n-pos));
+    memcpy(ptrs + pos+2, node->child + pos+1, sizeof(void *) * (n-pos));
+
+    /* keys[m] moves up, the two halves keep m and n-m keys */
+    right = alloc_node(bt, 0);
+    m     = (BTREE_ORDER + 1) / 2;
+
+    node->nkey  = m;
+    right->nkey = n - m;
+
+    memcpy(node->keys,   keys,         sizeof(void *) * m);
+    memcpy(node->child,  ptrs,         sizeof(void *) * (m+1));
+    memcpy(right->keys,  keys + m+1,   sizeof(void *) * (n - m));
+    memcpy(right->child, ptrs + m+1,   sizeof(void *) * (n - m + 1));
+
+    *upkey  = keys[m];
+    *upnode = right;
+
+    return 1;
+}
+
+static void *delete_node(mdb_btree_t   *bt,
+                         btree_node_t  *node,
+                         int            klen,
+                         void          *key,
+                         void         **dkey)
+{
+    btree_node_t *child;
+    void         *data;
+    int           found;
+    int           i, n;
+
+    i = node_find(bt, node, klen,key, 0, &found);
+
+    if (node->leaf) {
+        if (!found) {
+            errno = ENOENT;
+            return NULL;
+        }
+
+        n     = --node->nkey;
+        data  = node->data[i];
+        *dkey = node->keys[i];
+
+        memmove(node->keys + i, node->keys + i+1, sizeof(void *) * (n-i));
+        memmove(node->data + i, node->data + i+1, sizeof(void *) * (n-i));
+
+        return data;
+    }
+
+    if (found)
+        i++;
+
+    child = node->child[i];
+
+    if (!(data = delete_node(bt, child, klen,key, dkey)))
+        return NULL;
+
+    /*
+     * the key we separate on might have been the deleted one, which
+     * points into data that is about to go away: replace it with the
+     * new smallest key of the right subtree
+     */
+    if (i > 0 && node->keys[i-1] == *dkey) {
+        while (!child->leaf)
+            child = child->child[0];
+
+        node->keys[i-1] = child->keys[0];
+    }
+
+    if (node->child[i]->nkey < BTREE_MIN)
+        rebalance(node, i);
+
+    return data;
+}
+
+static int compare_entries(const void *e1, const void *e2, void *data)
+{
+    const btree_entry_t *a   = e1;
+    const btree_entry_t *b   = e2;
+    btree_sort_t        *ctx = data;
+
+    return compare(ctx->bt, ctx->klen, a->key, 0, b->key);
+}
+
+/*
+ * Build the tree from sorted entries one level at a time. The entries
+ * of a level are spread evenly over the fewest possible nodes, which
+ * keeps every node at least half full.
+ */
+static void build_tree(mdb_btree_t *bt, int n, btree_entry_t *entries)
+{
+    btree_node_t **nodes;
+    void         **mins;
+    btree_node_t  *node, *prev;
+    int            nnode, total, nchild;
+    int            i, j, k, cnt;
+
+    nnode = (n + BTREE_ORDER - 1) / BTREE_ORDER;
+
+    for (total = nnode, k = nnode;  k > 1;  total += k)
+        k = (k + BTREE_ORDER) / (BTREE_ORDER + 1);
+
+    nodes = malloc(sizeof(nodes[0]) * nnode);
+    mins  = malloc(sizeof(mins[0]) * nnode);
+
+    if (!nodes || !mins || reserve_nodes(bt, total) < 0) {
+        free(nodes);
+        free(mins);
+        return;
+    }
+
+    for (i = k = 0, prev = NULL;  i < nnode;  i++) {
+        cnt  = n / nnode + (i < n % nnode ? 1 : 0);
+        node = alloc_node(bt, 1);
+
+        for (j = 0;  j < cnt;  j++, k++) {
+            node->keys[j] = entries[k].key;
+            node->data[j] = entries[k].data;
+        }
+
+        node->nkey = cnt;
+
+        if (prev)
+            prev->next = node;
+
+        nodes[i] = prev = node;
+        mins[i]  = node->keys[0];
+    }
+
+    bt->depth = 1;
+
+    for (nchild = nnode;  nchild > 1;  nchild = nnode) {
+        nnode = (nchild + BTREE_ORDER) / (BTREE_ORDER + 1);
+
+        for (i = k = 0;  i < nnode;  i++) {
+            cnt  = nchild / nnode + (i < nchild % nnode ? 1 : 0);
+            node = alloc_node(bt, 0);
+
+            for (j = 0;  j < cnt;  j++, k++) {
+                node->child[j] = nodes[k];
+                if (j > 0)
+                    node->keys[j-1] = mins[k];
+            }
+
+            node->nkey = cnt - 1;
+            mins[i]    = mins[k - cnt];
+            nodes[i]   = node;
+        }
+
+        bt->depth++;
+    }
+
+    bt->root   = nodes[0];
+    bt->nentry = n;
+
+    free(nodes);
+    free(mins);
+}
+
+static void rebalance(btree_node_t *parent, int i)
+{
+    btree_node_t *left  = i > 0 ? parent->child[i-1] : NULL;
+    btree_node_t *right = i < parent->nkey ? parent->child[i+1] : NULL;
+
+    if (left && left->nkey > BTREE_MIN)
+        borrow_left(parent, i);
+    else if (right && right->nkey > BTREE_MIN)
+        borrow_right(parent, i);
+    else if (left)
+        merge(parent, i-1);
+    else
+        merge(parent, i);
+}
+
+static void borrow_left(btree_node_t *parent, int i)
+{
+    btree_node_t *node = parent->child[i];
+    btree_node_t *left = parent->child[i-1];
+    int           n    = node->nkey;
+    int           l    = left->nkey;
+
+    memmove(node->keys + 1, node->keys, sizeof(void *) * n);
+
+    if (node->leaf) {
+        memmove(node->data + 1, node->data, sizeof(void *) * n);
+
+        node->keys[0] = left->keys[l-1];
+        node->data[0] = left->data[l-1];
+
+        parent->keys[i-1] = node->keys[0];
+    }
+    else {
+        memmove(node->child + 1, node->child, sizeof(void *) * (n+1));
+
+        node->keys[0]  = parent->keys[i-1];
+        node->child[0] = left->child[l];
+
+        parent->keys[i-1] = left->keys[l-1];
+    }
+
+    left->nkey--;
+    node->nkey++;
+}
+
+static void borrow_right(btree_node_t *parent, int i)
+{
+    btree_node_t *node  = parent->child[i];
+    btree_node_t *right = parent->child[i+1];
+    int           n     = node->nkey;
+    int           r     = right->nkey;
+
+    if (node->leaf) {
+        node->keys[n] = right->keys[0];
+        node->data[n] = right->data[0];
+
+        memmove(right->keys, right->keys + 1, sizeof(void *) * (r-1));
+        memmove(right->data, right->data + 1, sizeof(void *) * (r-1));
+
+        parent->keys[i] = right->keys[0];
+    }
+    else {
+        node->keys[n]    = parent->keys[i];
+        node->child[n+1] = right->child[0];
+
+        parent->keys[i] = right->keys[0];
+
+        memmove(right->keys,  right->keys  + 1, sizeof(void *) * (r-1));
+        memmove(right->child, right->child + 1, sizeof(void *) * r);
+    }
+
+    right->nkey--;
+    node->nkey++;
+}
+
+static void merge(btree_node_t *parent, int i)
+{
+    btree_node_t *left  = parent->child[i];
+    btree_node_t *right = parent->child[i+1];
+    int           l     = left->nkey;
+    int           r     = right->nkey;
+    int           n     = parent->nkey;
+
+    if (left->leaf) {
+        memcpy(left->keys + l, right->keys, sizeof(void *) * r);
+        memcpy(left->data + l, right->data, sizeof(void *) * r);
+
+        left->nkey += r;
+        left->next  = right->next;
+    }
+    else {
+        left->keys[l] = parent->keys[i];
+
+        memcpy(left->keys  + l+1, right->keys,  sizeof(void *) * r);
+        memcpy(left->child + l+1, right->child, sizeof(void *) * (r+1));
+
+        left->nkey += r + 1;
+    }
+
+    memmove(parent->keys  + i,   parent->keys  + i+1, sizeof(void *)*(n-i-1));
+    memmove(parent->child + i+1, parent->child + i+2, sizeof(void *)*(n-i-1));
+
+    parent->nkey--;
+
+    free(right);
+}
+
+
+/*
+ * Local Variables:
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ *
+ */
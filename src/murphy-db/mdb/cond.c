@@ -59,6 +59,88 @@ typedef struct {
     } v;
 } cond_data_t;
 
+/*
+ * compiled conditions
+ *
+ * A condition is compiled into a flat list of instructions for a small
+ * stack machine. Operand types are resolved while compiling, so every
+ * comparison is specialized for its type and every operation the
+ * interpreter would evaluate to 0 for a type mismatch is folded away.
+ * Variables are read once while compiling and anything that does not
+ * depend on the row data is evaluated at compile time.
+ */
+typedef enum {
+    op_const = 0,          /* push a constant */
+    op_column_integer,     /* push a column value */
+    op_column_unsignd,
+    op_column_varchar,
+    op_compare_integer,    /* pop two operands, push the relop result */
+    op_compare_unsignd,
+    op_compare_varchar,
+    op_colcmp_integer,     /* push relop(column, constant) */
+    op_colcmp_unsignd,
+    op_colcmp_varchar,
+    op_not,                /* logical not of an integer or unsignd */
+    op_not_varchar,        /* 1 for an empty string, 0 otherwise */
+    op_bool,               /* normalize to 0 or 1 */
+    op_jump_if_false,      /* short-circuit and */
+    op_jump_if_true,       /* short-circuit or */
+    op_return
+} cond_opcode_t;
+
+typedef union {
+    const char *varchar;
+    int32_t     integer;
+    uint32_t    unsignd;
+} cond_value_t;
+
+typedef struct {
+    uint16_t      code;
+    uint16_t      relop;    /* row in relop_truth */
+    uint32_t      arg;      /* column offset or jump target */
+    cond_value_t  v;
+} cond_insn_t;
+
+struct mdb_cond_s {
+    cond_value_t *stack;
+    cond_insn_t   insns[0];
+};
+
+typedef enum {
+    node_const = 0,
+    node_column,
+    node_relop,
+    node_logic,
+    node_not,
+    node_bool
+} cond_node_kind_t;
+
+typedef struct cond_node_s cond_node_t;
+
+struct cond_node_s {
+    cond_node_kind_t  kind;
+    mqi_data_type_t   type;     /* type of the value of the node */
+    mqi_operator_t    op;
+    int               offset;   /* column offset within row data */
+    cond_value_t      v;        /* value of a constant */
+    cond_node_t      *left;
+    cond_node_t      *right;
+};
+
+#define COND_NODE_MAX  (MQI_COND_MAX * 2)
+#define COND_INSN_MAX  (COND_NODE_MAX * 2 + 1)
+
+typedef struct {
+    mdb_table_t      *tbl;
+    mqi_cond_entry_t *ce;       /* next entry to parse */
+    int               nnode;
+    int               ninsn;
+    int               depth;
+    int               maxdepth;
+    cond_node_t       nodes[COND_NODE_MAX];
+    cond_insn_t       insns[COND_INSN_MAX];
+} cond_compiler_t;
+
 #define PRECEDENCE_DATA 256
 
 typedef struct {
@@ -76,6 +158,16 @@ static int cond_binary_logicop(mqi_operator_t, cond_stack_t *,
                                cond_stack_t *);
 static int cond_unary_logicop(mqi_operator_t, cond_stack_t *);
 
+static cond_node_t *cond_parse_expression(cond_compiler_t *, int);
+static cond_node_t *cond_parse_operand(cond_compiler_t *);
+static cond_node_t *cond_fold_relop(cond_compiler_t *, mqi_operator_t,
+                                    cond_node_t *, cond_node_t *);
+static cond_node_t *cond_fold_logicop(cond_compiler_t *, mqi_operator_t,
+                                      cond_node_t *, cond_node_t *);
+static cond_node_t *cond_fold_not(cond_compiler_t *, cond_node_t *);
+static cond_node_t *cond_fold_bool(cond_compiler_t *, cond_node_t *);
+static int cond_emit(cond_compiler_t *, cond_node_t *);
+
 int mdb_cond_evaluate(mdb_table_t *tbl, mqi_cond_entry_t **cond_ptr,void *data)
 {
     static int precedence[mqi_operator_max] = {
@@ -107,15 +199,17 @@ int mdb_cond_evaluate(mdb_table_t *tbl, mqi_cond_entry_t **cond_ptr,void *data)
         switch (cond->type) {
 
         case mqi_operator:
-            pr  = precedence[cond->u.operator_];
-            sp += cond_eval(sp, lastop, pr);
+            pr = precedence[cond->u.operator_];
+
+            /* begin is an operand: there is nothing to reduce before it */
+            if (cond->u.operator_ != mqi_begin)
+                sp += cond_eval(sp, lastop, pr);
 
             switch (cond->u.operator_) {
 
             case mqi_begin:
                 cond++;
                 result = mdb_cond_evaluate(tbl, &cond, data);
-                cond++;
 
                 sp->data.v.integer = result >= 0 ? result : 0;
                 sp->precedence   = PRECEDENCE_DATA;
@@ -168,6 +262,92 @@ int mdb_cond_evaluate(mdb_table_t *tbl, mqi_cond_entry_t **cond_ptr,void *data)
     } /* for ;; */
 }
 
+/*
+ * Make a self-contained copy of cond, ie. one that has its own copy of
+ * the values of the variables, including strings. The copy is a single
+ * block of memory to be released with free().
+ */
+mqi_cond_entry_t *mdb_cond_duplicate(mqi_cond_entry_t *cond)
+{
+    typedef union {
+        char     *varchar;
+        int32_t   integer;
+        uint32_t  unsignd;
+        double    floating;
+        void     *blob;
+    } value_t;
+
+    mqi_cond_entry_t *ce, *copy;
+    mqi_variable_t   *var;
+    value_t          *values;
+    char             *strings, *s;
+    size_t            size;
+    int               n, nvar, depth;
+
+    MDB_CHECKARG(cond, NULL);
+
+    size = 0;
+
+    for (ce = cond, n = nvar = depth = 0;  ;  ce++, n++) {
+        if (ce->type == mqi_operator) {
+            if (ce->u.operator_ == mqi_begin)
+                depth++;
+            else if (ce->u.operator_ == mqi_end && depth-- == 0)
+                break;
+        }
+        else if (ce->type == mqi_variable) {
+            var = &ce->u.variable;
+            nvar++;
+
+            if (var->type == mqi_varchar && var->v.varchar && *var->v.varchar)
+                size += strlen(*var->v.varchar) + 1;
+        }
+    }
+
+    n++;
+    size += sizeof(*ce) * n + sizeof(value_t) * nvar;
+
+    if (!(copy = malloc(size))) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    memcpy(copy, cond, sizeof(*ce) * n);
+
+    values  = (value_t *)(copy + n);
+    strings = (char *)(values + nvar);
+
+    for (ce = copy;  ce < copy + n;  ce++) {
+        if (ce->type != mqi_variable)
+            continue;
+
+        var = &ce->u.variable;
+
+        if (!var->v.generic)
+            continue;
+
+        switch (var->type) {
+        case mqi_varchar:
+            if (!(s = *var->v.varchar))
+                values->varchar = NULL;
+            else {
+                values->varchar = strcpy(strings, s);
+                strings += strlen(s) + 1;
+            }
+            break;
+        case mqi_integer:  values->integer  = *var->v.integer;   break;
+        case mqi_unsignd:  values->unsignd  = *var->v.unsignd;   break;
+        case mqi_floating: values->floating = *var->v.floating;  break;
+        case mqi_blob:     values->blob     = *var->v.blob;      break;
+        default:                                                 break;
+        }
+
+        var->v.generic = values++;
+    }
+
+    return copy;
+}
+
 static int cond_get_data(cond_stack_t     *sp,
                          mqi_cond_entry_t *cond,
                          mdb_column_t     *columns,
@@ -393,6 +573,606 @@ static int cond_unary_logicop(mqi_operator_t op, cond_stack_t *v)
     return 0;
 }
 
+
+mdb_cond_t *mdb_cond_compile(mdb_table_t *tbl, mqi_cond_entry_t *cond)
+{
+    cond_compiler_t *c;
+    cond_node_t     *root;
+    mdb_cond_t      *cc;
+    size_t           size;
+
+    MDB_CHECKARG(tbl && cond, NULL);
+
+    if (!(c = malloc(sizeof(*c))))
+        return NULL;
+
+    c->tbl      = tbl;
+    c->ce       = cond;
+    c->nnode    = 0;
+    c->ninsn    = 0;
+    c->depth    = 0;
+    c->maxdepth = 0;
+
+    /*
+     * Anything we can not prove to evaluate exactly like the interpreter
+     * (malformed conditions, unsupported variables, etc) is rejected and
+     * left for mdb_cond_evaluate() to deal with.
+     */
+    cc = NULL;
+
+    if (!(root = cond_parse_expression(c, 0))    ||
+        c->ce->type != mqi_operator              ||
+        c->ce->u.operator_ != mqi_end            ||
+        !(root = cond_fold_bool(c, root))        ||
+        cond_emit(c, root) < 0                   ||
+        c->ninsn >= COND_INSN_MAX)
+    {
+        errno = EINVAL;
+        goto out;
+    }
+
+    c->insns[c->ninsn++].code = op_return;
+
+    size = sizeof(*cc) + sizeof(cond_insn_t) * c->ninsn +
+        sizeof(cond_value_t) * c->maxdepth;
+
+    if ((cc = malloc(size)) != NULL) {
+        cc->stack = (cond_value_t *)(cc->insns + c->ninsn);
+        memcpy(cc->insns, c->insns, sizeof(cond_insn_t) * c->ninsn);
+    }
+
+ out:
+    free(c);
+    return cc;
+}
+
+int mdb_cond_match(mdb_cond_t *cc, void *data)
+{
+    static const uint8_t relop_truth[][3] = {
+        /*            <  =  > */
+        [mqi_less] = {1, 0, 0},
+        [mqi_leq ] = {1, 1, 0},
+        [mqi_eq  ] = {0, 1, 0},
+        [mqi_neq ] = {1, 0, 1},
+        [mqi_geq ] = {0, 1, 1},
+        [mqi_gt  ] = {0, 0, 1},
+    };
+
+    cond_insn_t  *pc = cc->insns;
+    cond_value_t *sp = cc->stack;
+    uint8_t      *row = data;
+    const char   *s1, *s2;
+    int           cmp;
+
+    for (;;) {
+        switch (pc->code) {
+
+        case op_const:
+            *sp++ = pc->v;
+            break;
+
+        case op_column_integer:
+            (sp++)->integer = *(int32_t *)(row + pc->arg);
+            break;
+
+        case op_column_unsignd:
+            (sp++)->unsignd = *(uint32_t *)(row + pc->arg);
+            break;
+
+        case op_column_varchar:
+            (sp++)->varchar = (const char *)(row + pc->arg);
+            break;
+
+        case op_compare_integer:
+            sp--;
+            cmp = (sp[-1].integer > sp[0].integer) -
+                  (sp[-1].integer < sp[0].integer);
+            sp[-1].integer = relop_truth[pc->relop][cmp + 1];
+            break;
+
+        case op_compare_unsignd:
+            sp--;
+            cmp = (sp[-1].unsignd > sp[0].unsignd) -
+                  (sp[-1].unsignd < sp[0].unsignd);
+            sp[-1].integer = relop_truth[pc->relop][cmp + 1];
+            break;
+
+        case op_compare_varchar:
+            sp--;
+            s1 = sp[-1].varchar;
+            s2 = sp[0].varchar;
+            goto compare_varchar;
+
+        case op_colcmp_integer:
+            cmp = (*(int32_t *)(row + pc->arg) > pc->v.integer) -
+                  (*(int32_t *)(row + pc->arg) < pc->v.integer);
+            (sp++)->integer = relop_truth[pc->relop][cmp + 1];
+            break;
+
+        case op_colcmp_unsignd:
+            cmp = (*(uint32_t *)(row + pc->arg) > pc->v.unsignd) -
+                  (*(uint32_t *)(row + pc->arg) < pc->v.unsignd);
+            (sp++)->integer = relop_truth[pc->relop][cmp + 1];
+            break;
+
+        case op_colcmp_varchar:
+            s1 = (const char *)(row + pc->arg);
+            s2 = pc->v.varchar;
+            sp++;
+        compare_varchar:
+            if (!s1 || !s2)
+                cmp = (s1 != NULL) - (s2 != NULL);
+            else {
+                cmp = strcmp(s1, s2);
+                cmp = (cmp > 0) - (cmp < 0);
+            }
+            sp[-1].integer = relop_truth[pc->relop][cmp + 1];
+            break;
+
+        case op_not:
+            sp[-1].integer = !sp[-1].unsignd;
+            break;
+
+        case op_not_varchar:
+            s1 = sp[-1].varchar;
+            sp[-1].integer = !(s1 && s1[0]);
+            break;
+
+        case op_bool:
+            sp[-1].integer = !!sp[-1].unsignd;
+            break;
+
+        case op_jump_if_false:
+            if (!sp[-1].unsignd) {
+                pc = cc->insns + pc->arg;
+                continue;
+            }
+            sp--;
+            break;
+
+        case op_jump_if_true:
+            if (sp[-1].unsignd) {
+                sp[-1].integer = 1;
+                pc = cc->insns + pc->arg;
+                continue;
+            }
+            sp--;
+            break;
+
+        case op_return:
+            return sp[-1].unsignd ? 1 : 0;
+
+        default:
+            return 0;
+        }
+
+        pc++;
+    }
+}
+
+void mdb_cond_free(mdb_cond_t *cc)
+{
+    free(cc);
+}
+
+
+static int cond_binary_precedence(mqi_operator_t op)
+{
+    switch (op) {
+    case mqi_and:   return 2;
+    case mqi_or:    return 3;
+    case mqi_less:
+    case mqi_leq:
+    case mqi_eq:
+    case mqi_neq:
+    case mqi_geq:
+    case mqi_gt:    return 4;
+    default:        return 0;
+    }
+}
+
+static cond_node_t *cond_node(cond_compiler_t  *c,
+                              cond_node_kind_t  kind,
+                              mqi_data_type_t   type)
+{
+    cond_node_t *node;
+
+    if (c->nnode >= COND_NODE_MAX)
+        return NULL;
+
+    node = c->nodes + c->nnode++;
+
+    memset(node, 0, sizeof(*node));
+    node->kind = kind;
+    node->type = type;
+
+    return node;
+}
+
+static cond_node_t *cond_constant(cond_compiler_t *c, int32_t value)
+{
+    cond_node_t *node;
+
+    if ((node = cond_node(c, node_const, mqi_integer)) != NULL)
+        node->v.integer = value;
+
+    return node;
+}
+
+static int cond_is_boolean(cond_node_t *node)
+{
+    switch (node->kind) {
+    case node_relop:
+    case node_logic:
+    case node_not:
+    case node_bool:
+        return 1;
+    case node_const:
+        return node->type == mqi_integer &&
+            (node->v.integer == 0 || node->v.integer == 1);
+    default:
+        return 0;
+    }
+}
+
+/*
+ * Operator precedence parsing mirroring the interpreter: operators of
+ * equal precedence group to the right and a parenthesized subexpression
+ * evaluates to 0 or 1, just like the condition as a whole.
+ */
+static cond_node_t *cond_parse_expression(cond_compiler_t *c, int min)
+{
+    cond_node_t    *left, *right;
+    mqi_operator_t  op;
+    int             pr;
+
+    if (!(left = cond_parse_operand(c)))
+        return NULL;
+
+    for (;;) {
+        if (c->ce->type != mqi_operator)
+            return NULL;
+
+        op = c->ce->u.operator_;
+        pr = cond_binary_precedence(op);
+
+        if (!pr || pr < min)
+            return left;
+
+        c->ce++;
+
+        if (!(right = cond_parse_expression(c, pr)))
+            return NULL;
+
+        if (op == mqi_and || op == mqi_or)
+            left = cond_fold_logicop(c, op, left, right);
+        else
+            left = cond_fold_relop(c, op, left, right);
+
+        if (!left)
+            return NULL;
+    }
+}
+
+static cond_node_t *cond_parse_operand(cond_compiler_t *c)
+{
+    mqi_cond_entry_t *ce = c->ce++;
+    mqi_variable_t   *var;
+    mdb_column_t     *col;
+    cond_node_t      *node;
+
+    switch (ce->type) {
+
+    case mqi_column:
+        if (ce->u.column < 0 || ce->u.column >= c->tbl->ncolumn)
+            return NULL;
+
+        col = c->tbl->columns + ce->u.column;
+
+        if ((node = cond_node(c, node_column, col->type)) != NULL)
+            node->offset = col->offset;
+
+        return node;
+
+    case mqi_variable:
+        var = &ce->u.variable;
+
+        if (!var->v.generic || !(node = cond_node(c, node_const, var->type)))
+            return NULL;
+
+        switch (var->type) {
+        case mqi_varchar:  node->v.varchar = *var->v.varchar;  break;
+        case mqi_integer:  node->v.integer = *var->v.integer;  break;
+        case mqi_unsignd:  node->v.unsignd = *var->v.unsignd;  break;
+        case mqi_blob:     /* no operator takes blobs */       break;
+        default:           return NULL;
+        }
+
+        return node;
+
+    case mqi_operator:
+        switch (ce->u.operator_) {
+
+        case mqi_not:
+            if (!(node = cond_parse_operand(c)))
+                return NULL;
+            return cond_fold_not(c, node);
+
+        case mqi_begin:
+            if (!(node = cond_parse_expression(c, 0)))
+                return NULL;
+            if (c->ce->type != mqi_operator || c->ce->u.operator_ != mqi_end)
+                return NULL;
+            c->ce++;
+            return cond_fold_bool(c, node);
+
+        default:
+            return NULL;
+        }
+
+    default:
+        return NULL;
+    }
+}
+
+static cond_node_t *cond_fold_relop(cond_compiler_t *c,
+                                    mqi_operator_t   op,
+                                    cond_node_t     *left,
+                                    cond_node_t     *right)
+{
+    static mqi_operator_t mirror[mqi_operator_max] = {
+        [mqi_less] = mqi_gt,
+        [mqi_leq ] = mqi_geq,
+        [mqi_eq  ] = mqi_eq,
+        [mqi_neq ] = mqi_neq,
+        [mqi_geq ] = mqi_leq,
+        [mqi_gt  ] = mqi_less,
+    };
+
+    cond_stack_t  v1, v2;
+    cond_node_t  *node, *tmp;
+
+    if (left->type != right->type)
+        return cond_constant(c, 0);
+
+    switch (left->type) {
+    case mqi_varchar:
+    case mqi_integer:
+    case mqi_unsignd:
+        break;
+    default:
+        return cond_constant(c, 0);
+    }
+
+    if (left->kind == node_const && right->kind == node_const) {
+        v1.precedence = v2.precedence = PRECEDENCE_DATA;
+        v1.data.type  = v2.data.type  = left->type;
+
+        switch (left->type) {
+        case mqi_varchar:
+            v1.data.v.varchar = (char *)left->v.varchar;
+            v2.data.v.varchar = (char *)right->v.varchar;
+            break;
+        case mqi_integer:
+            v1.data.v.integer = left->v.integer;
+            v2.data.v.integer = right->v.integer;
+            break;
+        default:
+            v1.data.v.unsignd = left->v.unsignd;
+            v2.data.v.unsignd = right->v.unsignd;
+            break;
+        }
+
+        return cond_constant(c, cond_relop(op, &v1, &v2));
+    }
+
+    /* keep columns on the left so they can be compared to constants */
+    if (left->kind == node_const && right->kind == node_column) {
+        tmp   = left;
+        left  = right;
+        right = tmp;
+        op    = mirror[op];
+    }
+
+    if ((node = cond_node(c, node_relop, mqi_integer)) != NULL) {
+        node->op    = op;
+        node->left  = left;
+        node->right = right;
+    }
+
+    return node;
+}
+
+static cond_node_t *cond_fold_logicop(cond_compiler_t *c,
+                                      mqi_operator_t   op,
+                                      cond_node_t     *left,
+                                      cond_node_t     *right)
+{
+    cond_node_t *node, *k;
+    int          absorbing;
+
+    if (left->type != right->type ||
+        (left->type != mqi_integer && left->type != mqi_unsignd))
+        return cond_constant(c, 0);
+
+    /* the constant that decides the outcome of the operator alone */
+    absorbing = (op == mqi_or);
+
+    if (left->kind == node_const) {
+        k    = left;
+        node = right;
+    }
+    else if (right->kind == node_const) {
+        k    = right;
+        node = left;
+    }
+    else
+        k = node = NULL;
+
+    if (k != NULL) {
+        if (!!k->v.unsignd == absorbing)
+            return cond_constant(c, absorbing);
+        else
+            return cond_fold_bool(c, node);
+    }
+
+    if ((node = cond_node(c, node_logic, mqi_integer)) != NULL) {
+        node->op    = op;
+        node->left  = left;
+        node->right = right;
+    }
+
+    return node;
+}
+
+static cond_node_t *cond_fold_not(cond_compiler_t *c, cond_node_t *operand)
+{
+    cond_node_t *node;
+
+    switch (operand->type) {
+    case mqi_varchar:
+        if (operand->kind == node_const) {
+            return cond_constant(c, !(operand->v.varchar &&
+                                      operand->v.varchar[0]));
+        }
+        break;
+    case mqi_integer:
+    case mqi_unsignd:
+        if (operand->kind == node_const)
+            return cond_constant(c, !operand->v.unsignd);
+        break;
+    default:
+        return cond_constant(c, 0);
+    }
+
+    if ((node = cond_node(c, node_not, mqi_integer)) != NULL)
+        node->left = operand;
+
+    return node;
+}
+
+static cond_node_t *cond_fold_bool(cond_compiler_t *c, cond_node_t *operand)
+{
+    cond_node_t *node;
+
+    /*
+     * The interpreter takes the 32-bit integer view of whatever the
+     * value is. We only bother replicating that for integer values.
+     */
+    if (operand->type != mqi_integer && operand->type != mqi_unsignd)
+        return NULL;
+
+    if (cond_is_boolean(operand))
+        return operand;
+
+    if (operand->kind == node_const)
+        return cond_constant(c, !!operand->v.unsignd);
+
+    if ((node = cond_node(c, node_bool, mqi_integer)) != NULL)
+        node->left = operand;
+
+    return node;
+}
+
+static cond_insn_t *cond_insn(cond_compiler_t *c, int code, int push)
+{
+    cond_insn_t *insn;
+
+    if (c->ninsn >= COND_INSN_MAX)
+        return NULL;
+
+    insn = c->insns + c->ninsn++;
+
+    memset(insn, 0, sizeof(*insn));
+    insn->code = code;
+
+    if ((c->depth += push) > c->maxdepth)
+        c->maxdepth = c->depth;
+
+    return insn;
+}
+
+static int cond_typed(int code, mqi_data_type_t type)
+{
+    switch (type) {
+    case mqi_integer:  return code;
+    case mqi_unsignd:  return code + 1;
+    case mqi_varchar:  return code + 2;
+    default:           return -1;
+    }
+}
+
+static int cond_emit(cond_compiler_t *c, cond_node_t *node)
+{
+    cond_node_t *l = node->left;
+    cond_node_t *r = node->right;
+    cond_insn_t *insn;
+    int          code;
+
+    switch (node->kind) {
+
+    case node_const:
+        if (!(insn = cond_insn(c, op_const, +1)))
+            return -1;
+        insn->v = node->v;
+        return 0;
+
+    case node_column:
+        if ((code = cond_typed(op_column_integer, node->type)) < 0 ||
+            !(insn = cond_insn(c, code, +1)))
+            return -1;
+        insn->arg = node->offset;
+        return 0;
+
+    case node_relop:
+        if (l->kind == node_column && r->kind == node_const) {
+            if ((code = cond_typed(op_colcmp_integer, l->type)) < 0 ||
+                !(insn = cond_insn(c, code, +1)))
+                return -1;
+            insn->arg = l->offset;
+            insn->v   = r->v;
+        }
+        else {
+            if (cond_emit(c, l) < 0 || cond_emit(c, r) < 0 ||
+                (code = cond_typed(op_compare_integer, l->type)) < 0 ||
+                !(insn = cond_insn(c, code, -1)))
+                return -1;
+        }
+        insn->relop = node->op;
+        return 0;
+
+    case node_logic:
+        code = node->op == mqi_and ? op_jump_if_false : op_jump_if_true;
+
+        if (cond_emit(c, l) < 0 || !(insn = cond_insn(c, code, -1)))
+            return -1;
+
+        if (cond_emit(c, r) < 0)
+            return -1;
+
+        if (!cond_is_boolean(r) && !cond_insn(c, op_bool, 0))
+            return -1;
+
+        insn->arg = c->ninsn;
+        return 0;
+
+    case node_not:
+        code = l->type == mqi_varchar ? op_not_varchar : op_not;
+
+        if (cond_emit(c, l) < 0 || !cond_insn(c, code, 0))
+            return -1;
+        return 0;
+
+    case node_bool:
+        if (cond_emit(c, l) < 0 || !cond_insn(c, op_bool, 0))
+            return -1;
+        return 0;
+
+    default:
+        return -1;
+    }
+}
+
 /*
  * Local Variables:
  * c-basic-offset: 4
@@ -33,8 +33,19 @@
 #include <murphy-db/mqi-types.h>
 #include <murphy-db/mdb.h>
 
+/*
+ * A condition compiled against a table. Variables are bound by value
+ * when compiling, so a compiled condition is meant to live only for
+ * the duration of a single select/update/delete.
+ */
+typedef struct mdb_cond_s mdb_cond_t;
 
 int mdb_cond_evaluate(mdb_table_t *, mqi_cond_entry_t **, void *);
+mqi_cond_entry_t *mdb_cond_duplicate(mqi_cond_entry_t *);
+
+mdb_cond_t *mdb_cond_compile(mdb_table_t *, mqi_cond_entry_t *);
+int mdb_cond_match(mdb_cond_t *, void *);
+void mdb_cond_free(mdb_cond_t *);
 
 
 #endif /* __MDB_COND_H__ */
@@ -44,105 +44,75 @@
 #define HASH_STATISTICS
 #endif
 
-typedef struct mdb_hash_entry_s {
-    mdb_dlist_t  clink;         /* hash link, ie. chaining */
-    mdb_dlist_t  elink;         /* entry link, ie. linking all entries */
+/*
+ * Open addressing with linear probing. Entries live directly in the slot
+ * array, so there is no per-entry allocation, and each slot caches the
+ * full hash value of its key, so probing only calls the key comparison
+ * function on real hash matches and rehashing never calls hfunc.
+ *
+ * Deleted slots are turned into tombstones, which keeps probe sequences
+ * intact and makes it safe to delete entries while iterating over the
+ * table.
+ *
+ * When the table fills up, a new slot array is allocated and the entries
+ * are migrated from the old array incrementally, a few slots at a time on
+ * every insertion, so that no single insertion needs to pay for a full
+ * rehash. While a migration is in progress lookups check both arrays.
+ */
+
+#define HASH_SIZE_MIN       8          /* smallest slot array we use */
+#define HASH_LOAD_MAX(n)    (((n) / 4) * 3)  /* grow when 75% is in use */
+#define HASH_MIGRATE_STEP   8          /* slots to migrate per insertion */
+
+#define SLOT_FREE(s)        ((s)->key == NULL)
+#define SLOT_DELETED(s)     ((s)->key == (void *)&tombstone)
+#define SLOT_LIVE(s)        (!SLOT_FREE(s) && !SLOT_DELETED(s))
+
+typedef struct {
+    uint32_t     hash;          /* cached hash value of key */
     void        *key;
     void        *data;
-} hash_entry_t;
+} hash_slot_t;
 
 typedef struct {
-    mdb_dlist_t  head;
-#ifdef HASH_STATISTICS
-    struct {
-        int curr;
-        int max;
-    }            entries;
-#endif
-} hash_chain_t;
-
+    uint32_t     size;          /* number of slots, a power of two */
+    uint32_t     mask;          /* size - 1 */
+    uint32_t     nlive;         /* number of live entries */
+    uint32_t     nused;         /* number of live entries and tombstones */
+    hash_slot_t *slots;
+} hash_array_t;
 
 struct mdb_hash_s {
-    int                  bits;
     mdb_hash_function_t  hfunc;
     mdb_hash_compare_t   hcomp;
     mdb_hash_print_t     hprint;
-    struct {
-        mdb_dlist_t head;
+    uint32_t             initial;   /* initial/minimum size of the table */
+    hash_array_t         curr;      /* array we insert to */
+    hash_array_t         old;       /* array being migrated, if any */
+    uint32_t             migrate;   /* next slot of old to migrate */
 #ifdef HASH_STATISTICS
-        int         curr;
-        int         max;
-#endif
+    struct {
+        int curr;
+        int max;
+        int resize;
     }                    entries;
-    int                  nchain;
-    hash_chain_t         chains[0];
+#endif
 };
 
 
-typedef struct {
-    int  nchain;
-    int  bits;
-} table_size_t;
-
-static table_size_t  sizes[]          = {
-    {    2,  2}, {    3,  2}, {    5,  3}, {    7,  3}, {   11,  4},
-    {   13,  4}, {   17,  5}, {   19,  5}, {   23,  5}, {   29,  5},
-    {   31,  5}, {   37,  6}, {   41,  6}, {   43,  6}, {   47,  6},
-    {   53,  6}, {   59,  6}, {   61,  6}, {   67,  7}, {   71,  7},
-    {   73,  7}, {   79,  7}, {   83,  7}, {   89,  7}, {   97,  7},
-    {  101,  7}, {  103,  7}, {  107,  7}, {  109,  7}, {  113,  7},
-    {  127,  7}, {  131,  8}, {  137,  8}, {  139,  8}, {  149,  8},
-    {  151,  8}, {  157,  8}, {  163,  8}, {  167,  8}, {  173,  8},
-    {  179,  8}, {  181,  8}, {  191,  8}, {  193,  8}, {  197,  8},
-    {  199,  8}, {  211,  8}, {  223,  8}, {  227,  8}, {  229,  8},
-    {  233,  8}, {  239,  8}, {  241,  8}, {  251,  8}, {  257,  9},
-    {  263,  9}, {  269,  9}, {  271,  9}, {  277,  9}, {  281,  9},
-    {  283,  9}, {  293,  9}, {  307,  9}, {  311,  9}, {  313,  9},
-    {  317,  9}, {  331,  9}, {  337,  9}, {  347,  9}, {  349,  9},
-    {  353,  9}, {  359,  9}, {  367,  9}, {  373,  9}, {  379,  9},
-    {  383,  9}, {  389,  9}, {  397,  9}, {  401,  9}, {  409,  9},
-    {  419,  9}, {  421,  9}, {  431,  9}, {  433,  9}, {  439,  9},
-    {  443,  9}, {  449,  9}, {  457,  9}, {  461,  9}, {  463,  9},
-    {  467,  9}, {  479,  9}, {  487,  9}, {  491,  9}, {  499,  9},
-    {  503,  9}, {  509,  9}, {  521, 10}, {  523, 10}, {  541, 10},
-    {  547, 10}, {  557, 10}, {  563, 10}, {  569, 10}, {  571, 10},
-    {  577, 10}, {  587, 10}, {  593, 10}, {  599, 10}, {  601, 10},
-    {  607, 10}, {  613, 10}, {  617, 10}, {  619, 10}, {  631, 10},
-    {  641, 10}, {  643, 10}, {  647, 10}, {  653, 10}, {  659, 10},
-    {  661, 10}, {  673, 10}, {  677, 10}, {  683, 10}, {  691, 10},
-    {  701, 10}, {  709, 10}, {  719, 10}, {  727, 10}, {  733, 10},
-    {  739, 10}, {  743, 10}, {  751, 10}, {  757, 10}, {  761, 10},
-    {  769, 10}, {  773, 10}, {  787, 10}, {  797, 10}, {  809, 10},
-    {  811, 10}, {  821, 10}, {  823, 10}, {  827, 10}, {  829, 10},
-    {  839, 10}, {  853, 10}, {  857, 10}, {  859, 10}, {  863, 10},
-    {  877, 10}, {  881, 10}, {  883, 10}, {  887, 10}, {  907, 10},
-    {  911, 10}, {  919, 10}, {  929, 10}, {  937, 10}, {  941, 10},
-    {  947, 10}, {  953, 10}, {  967, 10}, {  971, 10}, {  977, 10},
-    {  983, 10}, {  991, 10}, {  997, 10}, {65535, 16}
-};
-static uint32_t  charmap[256] = {
-    /*        00  01  02  03  04  05  06  07  08  09  0a  0b  0c  0d  0e  0f */
-    /* 00 */   0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
-    /* 10 */   0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
-    /* 20 */   0,  0,  0,  0,  0,  0,  0,  0, 52, 53, 54, 55, 56, 37, 40, 50,
-    /* 30 */   1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 41,  0, 42, 43, 44, 45,
-    /* 40 */  46, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25,
-    /* 50 */  26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 47, 48, 49, 51, 38,
-    /* 60 */   0, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25,
-    /* 70 */  26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 57, 58, 59, 60,  0,
-    /* 80 */   0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
-    /* 90 */   0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
-    /* a0 */   0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
-    /* b0 */   0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
-    /* c0 */   0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
-    /* d0 */   0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
-    /* e0 */   0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
-    /* f0 */   0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0
-};
+static char tombstone;
 
-static void htable_reset(mdb_hash_t *, int);
-static table_size_t *get_table_size(int);
-static int print_chain(mdb_hash_t *, int, char *, int);
+static int array_create(hash_array_t *, uint32_t);
+static void array_destroy(hash_array_t *);
+static hash_slot_t *array_lookup(mdb_hash_t *, hash_array_t *, uint32_t,
+                                 int, void *);
+static void array_insert(hash_array_t *, uint32_t, void *, void *);
+static void array_remove(hash_array_t *, hash_slot_t *);
+static void migrate_step(mdb_hash_t *, uint32_t);
+static int  start_resize(mdb_hash_t *);
+static hash_slot_t *iterate_slot(mdb_hash_t *, uintptr_t);
+static uint32_t get_table_size(uint32_t);
+static uint32_t mix_bits(uint32_t);
 
 
 mdb_hash_t *mdb_hash_table_create(int                  max_entries,
@@ -150,37 +120,30 @@ mdb_hash_t *mdb_hash_table_create(int                  max_entries,
                                   mdb_hash_compare_t   hcomp,
                                   mdb_hash_print_t     hprint)
 {
-    mdb_hash_t   *htbl;
-    table_size_t *ts;
-    size_t        size;
-    int           i;
+    mdb_hash_t *htbl;
+    uint32_t    size;
 
-    MDB_CHECKARG(hfunc && hcomp && hprint &&
-                 max_entries > 1 && max_entries < 65536, NULL);
+    MDB_CHECKARG(hfunc && hcomp && hprint && max_entries > 1, NULL);
 
-    if ((ts = get_table_size(max_entries)) == NULL) {
+    if (!(size = get_table_size(max_entries))) {
         errno = EOVERFLOW;
         return NULL;
     }
 
-    size = sizeof(mdb_hash_t) + sizeof(hash_chain_t) * ts->nchain;
-    htbl = calloc(1, size);
-
-    if (!htbl) {
+    if (!(htbl = calloc(1, sizeof(mdb_hash_t)))) {
         errno = ENOMEM;
         return NULL;
     }
 
-    htbl->bits   = ts->bits;
-    htbl->nchain = ts->nchain;
-    htbl->hfunc  = hfunc;
-    htbl->hcomp  = hcomp;
-    htbl->hprint = hprint;
-
-    MDB_DLIST_INIT(htbl->entries.head);
+    if (array_create(&htbl->curr, size) < 0) {
+        free(htbl);
+        return NULL;
+    }
 
-    for (i = 0; i < htbl->nchain; i++)
-        MDB_DLIST_INIT(htbl->chains[i].head);
+    htbl->initial = size;
+    htbl->hfunc   = hfunc;
+    htbl->hcomp   = hcomp;
+    htbl->hprint  = hprint;
 
     return htbl;
 }
@@ -189,7 +152,8 @@ int mdb_hash_table_destroy(mdb_hash_t *htbl)
 {
     MDB_CHECKARG(htbl, -1);
 
-    htable_reset(htbl, 0);
+    array_destroy(&htbl->curr);
+    array_destroy(&htbl->old);
     free(htbl);
 
     return 0;
@@ -197,55 +161,103 @@ int mdb_hash_table_destroy(mdb_hash_t *htbl)
 
 int mdb_hash_table_reset(mdb_hash_t *htbl)
 {
+    hash_array_t empty;
+
     MDB_CHECKARG(htbl, -1);
 
-    htable_reset(htbl, 1);
+    array_destroy(&htbl->old);
+    htbl->migrate = 0;
+
+    if (htbl->curr.size > htbl->initial &&
+        array_create(&empty, htbl->initial) == 0)
+    {
+        array_destroy(&htbl->curr);
+        htbl->curr = empty;
+    }
+    else {
+        memset(htbl->curr.slots, 0, sizeof(hash_slot_t) * htbl->curr.size);
+        htbl->curr.nlive = 0;
+        htbl->curr.nused = 0;
+    }
+
+#ifdef HASH_STATISTICS
+    htbl->entries.curr = 0;
+#endif
 
     return 0;
 }
 
 void *mdb_hash_table_iterate(mdb_hash_t *htbl,void **key_ret,void **cursor_ptr)
 {
-    mdb_dlist_t  *head, *link;
-    hash_entry_t *entry;
+    hash_slot_t *slot;
+    uintptr_t    pos;
 
     MDB_CHECKARG(htbl && cursor_ptr, NULL);
 
-    head = &htbl->entries.head;
+    /*
+     * The cursor is the position of the next slot to check, offset by
+     * one to keep it distinct from the initial NULL. Positions first run
+     * through the array being migrated, then through the current one.
+     */
 
-    if (!(link = *cursor_ptr))
-        *cursor_ptr = link = head->next;
+    pos = (uintptr_t)*cursor_ptr;
 
-    if (link == head)
-        return NULL;
+    if (pos > 0)
+        pos--;
 
-    *cursor_ptr = link->next;
+    while ((slot = iterate_slot(htbl, pos++)) != NULL) {
+        if (SLOT_LIVE(slot)) {
+            *cursor_ptr = (void *)(pos + 1);
 
-    entry = MDB_LIST_RELOCATE(hash_entry_t, elink, link);
+            if (key_ret)
+                *key_ret = slot->key;
 
-    if (key_ret)
-        *key_ret = entry->key;
+            return slot->data;
+        }
+    }
 
-    return entry->data;
+    *cursor_ptr = (void *)(pos + 1);
+
+    return NULL;
 }
 
 int mdb_hash_table_print(mdb_hash_t *htbl, char *buf, int len)
 {
-    char *p, *e;
-    int   i;
+    hash_array_t *arr;
+    hash_slot_t  *slot;
+    char         *p, *e;
+    char          key[256];
+    uint32_t      i, home, dist;
+    int           a;
 
     MDB_CHECKARG(htbl && buf && len > 0, 0);
 
     e = (p = buf) + len;
     *buf = '\0';
 
-    for (i = 0;  i < htbl->nchain;  i++) {
-        if (!MDB_DLIST_EMPTY(htbl->chains[i].head)
 #ifdef HASH_STATISTICS
-            || htbl->chains[i].entries.max > 0
+    p += snprintf(p, e-p, "   entries: %d/%d, resized %d times\n",
+                  htbl->entries.curr, htbl->entries.max,
+                  htbl->entries.resize);
 #endif
-            )
-            p += print_chain(htbl, i, p, e-p);
+
+    for (a = 0;  a < 2 && p < e;  a++) {
+        arr = a ? &htbl->curr : &htbl->old;
+
+        for (i = 0;  i < arr->size && p < e;  i++) {
+            slot = arr->slots + i;
+
+            if (!SLOT_LIVE(slot))
+                continue;
+
+            home = slot->hash & arr->mask;
+            dist = (i - home) & arr->mask;
+
+            htbl->hprint(slot->key, key, sizeof(key));
+
+            p += snprintf(p, e-p, "   %05u%s: '%s' / %p (+%u)\n",
+                          i, a ? "" : "*", key, slot->data, dist);
+        }
     }
 
     return p - buf;
@@ -253,40 +265,45 @@ int mdb_hash_table_print(mdb_hash_t *htbl, char *buf, int len)
 
 int mdb_hash_add(mdb_hash_t *htbl, int klen, void *key, void *data)
 {
-    hash_entry_t *entry;
-    hash_chain_t *chain;
-    int           index;
+    hash_slot_t *slot;
+    uint32_t     hash;
 
     MDB_CHECKARG(htbl && key && klen >= 0 && data, -1);
 
-    index = htbl->hfunc(htbl->bits, htbl->nchain, klen, key);
-    chain = htbl->chains + index;
-
-    MDB_DLIST_FOR_EACH(hash_entry_t, clink, entry, &chain->head) {
-        if (htbl->hcomp(klen, key, entry->key) == 0) {
-            if (data == entry->data)
-                return 0;
-            else {
-                errno = EEXIST;
-                return -1;
-            }
+    hash = htbl->hfunc(klen, key);
+
+    if ((slot = array_lookup(htbl, &htbl->curr, hash, klen, key)) ||
+        (slot = array_lookup(htbl, &htbl->old , hash, klen, key))  )
+    {
+        if (data == slot->data)
+            return 0;
+        else {
+            errno = EEXIST;
+            return -1;
         }
     }
 
-    if (!(entry = calloc(1, sizeof(hash_entry_t)))) {
-        errno = ENOMEM;
-        return -1;
+    if (htbl->old.slots)
+        migrate_step(htbl, HASH_MIGRATE_STEP);
+
+    if (htbl->curr.nused + 1 > HASH_LOAD_MAX(htbl->curr.size)) {
+        /*
+         * If we fail to allocate a bigger array we can still go on as
+         * long as there is at least one free slot left to end probing.
+         */
+        if (start_resize(htbl) < 0 &&
+            htbl->curr.nused + 1 >= htbl->curr.size)
+        {
+            errno = ENOMEM;
+            return -1;
+        }
+
+        migrate_step(htbl, HASH_MIGRATE_STEP);
     }
-    entry->key  = key;
-    entry->data = data;
 
-    MDB_DLIST_APPEND(hash_entry_t, clink, entry, &chain->head);
-    MDB_DLIST_APPEND(hash_entry_t, elink, entry, &htbl->entries.head);
+    array_insert(&htbl->curr, hash, key, data);
 
 #ifdef HASH_STATISTICS
-    if (++chain->entries.curr > chain->entries.max)
-        chain->entries.max = chain->entries.curr;
-
     if (++htbl->entries.curr > htbl->entries.max)
         htbl->entries.max = htbl->entries.curr;
 #endif
@@ -296,35 +313,27 @@ int mdb_hash_add(mdb_hash_t *htbl, int klen, void *key, void *data)
 
 void *mdb_hash_delete(mdb_hash_t *htbl, int klen, void *key)
 {
-    hash_entry_t *entry;
-    hash_entry_t *n;
-    hash_chain_t *chain;
-    int           index;
+    hash_array_t *arr;
+    hash_slot_t  *slot;
+    uint32_t      hash;
     void         *data;
 
     MDB_CHECKARG(htbl && klen >= 0 && key, NULL);
 
-    index = htbl->hfunc(htbl->bits, htbl->nchain, klen, key);
-    chain = htbl->chains + index;
+    hash = htbl->hfunc(klen, key);
 
-    MDB_DLIST_FOR_EACH_SAFE(hash_entry_t, clink, entry,n, &chain->head) {
-        if (htbl->hcomp(klen, key, entry->key) == 0) {
-            if (!(data = entry->data))
-                break;
+    if ((slot = array_lookup(htbl, (arr = &htbl->curr), hash, klen, key)) ||
+        (slot = array_lookup(htbl, (arr = &htbl->old ), hash, klen, key))  )
+    {
+        data = slot->data;
 
-            MDB_DLIST_UNLINK(hash_entry_t, clink, entry);
-            MDB_DLIST_UNLINK(hash_entry_t, elink, entry);
-            free(entry);
+        array_remove(arr, slot);
 
 #ifdef HASH_STATISTICS
-            if (--chain->entries.curr < 0)
-                chain->entries.curr = 0;
-
-            if (--htbl->entries.curr < 0)
-                htbl->entries.curr = 0;
+        if (--htbl->entries.curr < 0)
+            htbl->entries.curr = 0;
 #endif
-            return data;
-        }
+        return data;
     }
 
     errno = ENOENT;
@@ -333,236 +342,292 @@ void *mdb_hash_delete(mdb_hash_t *htbl, int klen, void *key)
 
 void *mdb_hash_get_data(mdb_hash_t *htbl, int klen, void *key)
 {
-    hash_entry_t *entry;
-    hash_chain_t *chain;
-    int           index;
+    hash_slot_t *slot;
+    uint32_t     hash;
 
     MDB_CHECKARG(htbl && klen >= 0 && key, NULL);
 
-    index = htbl->hfunc(htbl->bits, htbl->nchain, klen, key);
-    chain = htbl->chains + index;
+    hash = htbl->hfunc(klen, key);
 
-    MDB_DLIST_FOR_EACH(hash_entry_t, clink, entry, &chain->head) {
-        if (htbl->hcomp(klen, key, entry->key) == 0)
-            return entry->data;
-    }
+    if ((slot = array_lookup(htbl, &htbl->curr, hash, klen, key)) ||
+        (slot = array_lookup(htbl, &htbl->old , hash, klen, key))  )
+        return slot->data;
 
     errno = ENOENT;
     return NULL;
 }
 
 
-int mdb_hash_function_integer(int bits, int nchain, int klen, void *key)
+uint32_t mdb_hash_function_integer(int klen, void *key)
 {
-    return mdb_hash_function_unsignd(bits, nchain, klen, key);
+    return mdb_hash_function_unsignd(klen, key);
 }
 
 
-int mdb_hash_function_unsignd(int bits, int nchain, int klen, void *key)
+uint32_t mdb_hash_function_unsignd(int klen, void *key)
 {
-    uint32_t unsignd;
-
-    if (klen != sizeof(unsignd) || !key ||
-        bits < 1 || bits > 16 ||
-        nchain < (1 << (bits-1)) || nchain >= (1 << bits))
+    if (klen != sizeof(uint32_t) || !key)
         return 0;
 
-    unsignd = *(uint32_t *)key;
-
-    return (int)(unsignd % nchain);
+    return mix_bits(*(uint32_t *)key);
 }
 
 
-int mdb_hash_function_string(int bits, int nchain, int klen, void *key)
+uint32_t mdb_hash_function_string(int klen, void *key)
 {
-    typedef union {
-        uint64_t wide;
-        uint8_t  narrow[8];
-    } hash_t;
+    uint8_t  *varchar = (uint8_t *)key;
+    uint64_t  h;
+    uint8_t   s;
 
     (void)klen;
 
-    uint8_t *varchar = (uint8_t *)key;
-    int      hashval = 0;
-    hash_t   h;
-    int      shift;
+    if (!varchar)
+        return 0;
 
-    if (varchar && bits >= 1 && bits <= 16 &&
-        nchain > (1 << (bits-1)) && nchain < (1 << bits))
-    {
-        uint8_t s;
-        int     i;
+    for (h = 5381;  (s = *varchar);  varchar++)
+        h = 33ULL * h + (uint64_t)s;
 
-        for (h.wide = 0; (s = *varchar); varchar++)
-            h.wide = 33ULL * h.wide + (uint64_t)charmap[s];
+    return mix_bits((uint32_t)(h ^ (h >> 32)));
+}
 
-        if (bits <= 8) {
-            hashval = h.narrow[0] ^ h.narrow[1] ^ h.narrow[2] ^ h.narrow[3] ^
-                      h.narrow[4] ^ h.narrow[5] ^ h.narrow[6] ^ h.narrow[7];
-        }
-        else {
-            shift = (nchain + 7) / 8;
-            for (hashval = h.narrow[0], i = 1;   i < 8;  i++)
-                hashval ^= h.narrow[i] << (i * shift);
-        }
+uint32_t mdb_hash_function_pointer(int klen, void *key)
+{
+    uint64_t p = (uint64_t)(uintptr_t)key >> 2;
 
-        hashval %= nchain;
-    }
+    MQI_UNUSED(klen);
 
-    return hashval;
+    return mix_bits((uint32_t)(p ^ (p >> 32)));
 }
 
-int mdb_hash_function_pointer(int bits, int nchain, int klen, void *key)
+uint32_t mdb_hash_function_varchar(int klen, void *key)
 {
-#define MASK(t)  ((((uint##t##_t)1) << (sizeof(int) * 8 - 3)) - 1)
-    int hash;
+    return mdb_hash_function_string(klen, key);
+}
 
-    MQI_UNUSED(bits);
-    MQI_UNUSED(klen);
+uint32_t mdb_hash_function_blob(int klen, void *key)
+{
+    uint8_t  *data = (uint8_t *)key;
+    uint64_t  h;
+    int       i;
 
-#if __SIZEOF_POINTER__ == 8
-    hash = (int)(((uint64_t)key >> 2) & MASK(64)) % nchain;
-#else
-    hash = ((int)key >> 2) & MASK(32) % nchain;
-#endif
+    if (klen <= 0 || !data)
+        return 0;
 
-    return hash;
-#undef MASK
+    for (i = 0, h = 5381;   i < klen;   i++)
+        h = 33ULL * h + (uint64_t)data[i];
+
+    return mix_bits((uint32_t)(h ^ (h >> 32)));
 }
 
-int mdb_hash_function_varchar(int bits, int nchain, int klen, void *key)
+
+
+static int array_create(hash_array_t *arr, uint32_t size)
 {
-    return mdb_hash_function_string(bits, nchain, klen, key);
+    memset(arr, 0, sizeof(*arr));
+
+    if (!(arr->slots = calloc(size, sizeof(hash_slot_t)))) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    arr->size = size;
+    arr->mask = size - 1;
+
+    return 0;
 }
 
-int mdb_hash_function_blob(int bits, int nchain, int klen, void *key)
+static void array_destroy(hash_array_t *arr)
 {
-    typedef union {
-        uint64_t wide;
-        uint8_t  narrow[8];
-    } hash_t;
-
-    uint8_t *data  = (uint8_t *)key;
-    int      hashval = 0;
-    hash_t   h;
-    int      shift;
-    int      i;
-
-    if (klen > 0 && data && bits >= 1 && bits <= 16 &&
-        nchain > (1 << (bits-1)) && nchain < (1 << bits))
-    {
-        for (i = 0, h.wide = 0;   i < klen;   i++)
-            h.wide = 33ULL * h.wide + (uint64_t)data[i];
+    free(arr->slots);
+    memset(arr, 0, sizeof(*arr));
+}
 
-        if (bits <= 8) {
-            hashval = h.narrow[0] ^ h.narrow[1] ^ h.narrow[2] ^ h.narrow[3] ^
-                      h.narrow[4] ^ h.narrow[5] ^ h.narrow[6] ^ h.narrow[7];
-        }
-        else {
-            shift = (nchain + 7) / 8;
-            for (hashval = h.narrow[0], i = 1;   i < 8;  i++)
-                hashval ^= h.narrow[i] << (i * shift);
+static hash_slot_t *array_lookup(mdb_hash_t   *htbl,
+                                 hash_array_t *arr,
+                                 uint32_t      hash,
+                                 int           klen,
+                                 void         *key)
+{
+    hash_slot_t *slot;
+    uint32_t     i;
+
+    if (!arr->nlive)
+        return NULL;
+
+    for (i = hash & arr->mask;  ;  i = (i + 1) & arr->mask) {
+        slot = arr->slots + i;
+
+        if (SLOT_FREE(slot))
+            return NULL;
+
+        if (slot->hash == hash && !SLOT_DELETED(slot) &&
+            htbl->hcomp(klen, key, slot->key) == 0)
+            return slot;
+    }
+}
+
+static void array_insert(hash_array_t *arr, uint32_t hash,
+                         void *key, void *data)
+{
+    hash_slot_t *slot;
+    uint32_t     i;
+
+    for (i = hash & arr->mask;  ;  i = (i + 1) & arr->mask) {
+        slot = arr->slots + i;
+
+        if (SLOT_FREE(slot)) {
+            arr->nused++;
+            break;
         }
 
-        hashval %= nchain;
+        if (SLOT_DELETED(slot))
+            break;
     }
 
-    return hashval;
+    slot->hash = hash;
+    slot->key  = key;
+    slot->data = data;
+
+    arr->nlive++;
 }
 
+static void array_remove(hash_array_t *arr, hash_slot_t *slot)
+{
+    hash_slot_t *next;
 
+    /*
+     * If the next slot is free nothing can probe past this one, so it
+     * can be freed instead of turned into a tombstone.
+     */
+    next = arr->slots + (((slot - arr->slots) + 1) & arr->mask);
 
-static void htable_reset(mdb_hash_t *htbl, int do_chain_statistics)
-{
-    hash_entry_t *entry;
-    hash_entry_t *n;
-#ifdef HASH_STATISTICS
-    int i;
-#else
-    (void)do_statistics;
-#endif
+    if (SLOT_FREE(next)) {
+        slot->key = NULL;
+        arr->nused--;
+    }
+    else
+        slot->key = (void *)&tombstone;
 
-    MDB_DLIST_FOR_EACH_SAFE(hash_entry_t, elink, entry,n, &htbl->entries.head){
-        MDB_DLIST_UNLINK(hash_entry_t, clink, entry);
-        MDB_DLIST_UNLINK(hash_entry_t, elink, entry);
-        free(entry);
+    slot->data = NULL;
+    arr->nlive--;
+
+    if (!arr->nlive && arr->nused) {
+        memset(arr->slots, 0, sizeof(hash_slot_t) * arr->size);
+        arr->nused = 0;
     }
+}
 
-#ifdef HASH_STATISTICS
-    if (do_chain_statistics) {
-        for (i = 0;   i < htbl->nchain;   i++) {
-            htbl->chains[i].entries.curr = 0;
+static void migrate_step(mdb_hash_t *htbl, uint32_t nslot)
+{
+    hash_array_t *old = &htbl->old;
+    hash_slot_t  *slot;
+
+    while (nslot-- > 0 && htbl->migrate < old->size && old->nlive > 0) {
+        slot = old->slots + htbl->migrate++;
+
+        if (SLOT_LIVE(slot)) {
+            array_insert(&htbl->curr, slot->hash, slot->key, slot->data);
+            slot->key = (void *)&tombstone;
+            old->nlive--;
         }
     }
 
-    htbl->entries.curr = 0;
-#endif
+    if (!old->nlive) {
+        array_destroy(old);
+        htbl->migrate = 0;
+    }
 }
 
-static table_size_t *get_table_size(int max_entries)
+static int start_resize(mdb_hash_t *htbl)
 {
-    int dim = sizeof(sizes)/sizeof(sizes[0]);
-    int min = 0;
-    int max = dim - 1;
-    int idx;
-#ifdef DEBUG
-    int iterations = 0;
-#endif
-
-    for (;;) {
-#ifdef DEBUG
-        iterations++;
-#endif
-        idx = (min + max) / 2;
+    hash_array_t *old = &htbl->old;
+    hash_slot_t  *slot;
+    hash_array_t  arr;
+    uint32_t      nlive, size, i;
+
+    /*
+     * Size the new array so that all live entries fill at most 3/8
+     * of it, leaving enough headroom for insertions to complete the
+     * migration before the new array needs to grow again. Arrays full
+     * of tombstones get cleaned up by migrating to a same-sized one.
+     */
+    nlive = htbl->curr.nlive + old->nlive;
+
+    for (size = htbl->initial;  size / 8 * 3 < nlive + 1;  size *= 2) {
+        if (size >= (UINT32_C(1) << 31)) {
+            errno = EOVERFLOW;
+            return -1;
+        }
+    }
 
-        if (max_entries == sizes[idx].nchain)
-            break;
+    if (array_create(&arr, size) < 0)
+        return -1;
 
-        if (idx == min) {
-            idx = max;
-            break;
+    /*
+     * If we are still migrating, insertions did not leave us enough
+     * time to finish (only possible when shrinking). Move the rest of
+     * the old entries straight to the new array.
+     */
+    if (old->slots) {
+        for (i = htbl->migrate;  i < old->size;  i++) {
+            slot = old->slots + i;
+
+            if (SLOT_LIVE(slot))
+                array_insert(&arr, slot->hash, slot->key, slot->data);
         }
 
-        if (max_entries < sizes[idx].nchain)
-            max = idx;
-        else
-            min = idx;
+        array_destroy(old);
     }
 
-#ifdef DEBUG
-    printf("%s(%d) => {%d,%d} @ %d\n", __FUNCTION__, max_entries,
-           sizes[idx].nchain, sizes[idx].bits, iterations);
+    htbl->old     = htbl->curr;
+    htbl->curr    = arr;
+    htbl->migrate = 0;
+
+#ifdef HASH_STATISTICS
+    htbl->entries.resize++;
 #endif
 
-    return sizes + idx;
+    if (!htbl->old.nlive)
+        array_destroy(&htbl->old);
+
+    return 0;
 }
 
-static int print_chain(mdb_hash_t *htbl, int index, char *buf, int len)
+static hash_slot_t *iterate_slot(mdb_hash_t *htbl, uintptr_t pos)
 {
-    hash_chain_t *chain = htbl->chains + index;
-    hash_entry_t *entry;
-    char *p, *e;
-    char key[256];
+    if (pos < htbl->old.size)
+        return htbl->old.slots + pos;
 
-    e = (p = buf) + len;
+    pos -= htbl->old.size;
 
-#ifdef HASH_STATISTICS
-    p += snprintf(p, e-p, "   %05d: %d/%d\n",
-                  index, chain->entries.curr, chain->entries.max);
-#else
-    p += snprintf(p, e-p, "   %05d\n", index);
-#endif
+    if (pos < htbl->curr.size)
+        return htbl->curr.slots + pos;
 
-    MDB_DLIST_FOR_EACH(hash_entry_t, clink, entry, &chain->head) {
-        if (p >= e)
-            break;
+    return NULL;
+}
 
-        htbl->hprint(entry->key, key, sizeof(key));
+static uint32_t get_table_size(uint32_t max_entries)
+{
+    uint32_t size;
 
-        p += snprintf(p, e-p, "      '%s' / %p\n", key, entry->data);
+    for (size = HASH_SIZE_MIN;  size < max_entries;  size *= 2) {
+        if (size >= (UINT32_C(1) << 30))
+            return 0;
     }
 
-    return p - buf;
+    return size;
+}
+
+static uint32_t mix_bits(uint32_t h)
+{
+    /* finalizer of MurmurHash3, spreads entropy to the low bits we mask */
+    h ^= h >> 16;
+    h *= 0x85ebca6b;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35;
+    h ^= h >> 16;
+
+    return h;
 }
 
 /*
@@ -46,141 +46,139 @@
 #include "transaction.h"
 
 #define INDEX_HASH_CREATE(t)        MDB_HASH_TABLE_CREATE(t,100)
-#define INDEX_SEQUENCE_CREATE(t)    MDB_SEQUENCE_TABLE_CREATE(t,16)
+#define INDEX_BTREE_CREATE(t,f)     MDB_BTREE_TABLE_CREATE(t,f)
 
 #define INDEX_HASH_DROP(ix)         mdb_hash_table_destroy(ix->hash)
-#define INDEX_SEQUENCE_DROP(ix)     mdb_sequence_table_destroy(ix->sequence)
+#define INDEX_BTREE_DROP(ix)        mdb_btree_table_destroy(ix->btree)
 
 #define INDEX_HASH_RESET(ix)        mdb_hash_table_reset(ix->hash)
-#define INDEX_SEQUENCE_RESET(ix)    mdb_sequence_table_reset(ix->sequence)
+#define INDEX_BTREE_RESET(ix)       mdb_btree_table_reset(ix->btree)
 
+#define INDEX_KEY(ix, row)          ((void *)(row)->data + (ix)->offset)
+
+static int index_setup(mdb_table_t *, mdb_index_t *, char **, int);
+static void index_free(mdb_index_t *);
+static void primary_delete(mdb_table_t *, mdb_row_t *);
+static int secondary_insert(mdb_table_t *, mdb_row_t *);
+static int secondary_delete(mdb_table_t *, mdb_row_t *);
+static mqi_operator_t index_bound(mdb_index_t *, mqi_cond_entry_t *, void **);
 
 
 int mdb_index_create(mdb_table_t *tbl, char **index_columns)
 {
-    mdb_index_t     *ix;
-    mdb_column_t    *col;
-    mqi_data_type_t  type;
-    int              beg, end;
-    int             *idxcols;
-    int              i,j, idx;
-
     MDB_CHECKARG(tbl && index_columns && index_columns[0], -1);
 
-    ix = &tbl->index;
+    return index_setup(tbl, &tbl->index, index_columns, 1);
+}
 
-    beg = end = 0;
-    type = mqi_unknown;
-    idxcols = NULL;
+int mdb_index_create_secondary(mdb_table_t *tbl,
+                               char        *name,
+                               char       **index_columns)
+{
+    mdb_index_t *sindexes;
+    mdb_index_t *ix;
+    mdb_row_t   *row;
+    int          i;
 
-    for (i = 0;    index_columns[i];    i++) {
-        if (!(idx = mdb_hash_get_data(tbl->chash,0,index_columns[i]) - NULL)) {
-            errno = ENOENT;
-            return -1;
-        }
+    MDB_CHECKARG(tbl && name && name[0] &&
+                 index_columns && index_columns[0], -1);
 
-        col = tbl->columns + --idx;
-        col->flags |= MQI_COLUMN_KEY;
+    if (index_columns[1]) {
+        errno = EINVAL;         /* only single column secondary indices */
+        return -1;
+    }
 
-        if (i == 0) {
-            type = col->type;
-            beg  = col->offset;
-            end  = beg + col->length;
+    for (i = 0;  i < tbl->nsindex;  i++) {
+        if (!strcmp(name, tbl->sindexes[i].name)) {
+            errno = EEXIST;
+            return -1;
         }
-        else {
-            type = mqi_blob;
+    }
 
-            if (col->offset == end)
-                end += col->length;
-            else if (col->offset == beg - col->length)
-                beg = col->offset;
-            else {
-                type = mqi_unknown;
-                break; /* not an adjacent column */
-            }
-        }
+    sindexes = realloc(tbl->sindexes, sizeof(mdb_index_t) * (tbl->nsindex+1));
 
-        if (!(idxcols = realloc(idxcols, sizeof(int) * (i+1)))) {
-            errno = ENOMEM;
-            return -1;
-        }
+    if (!sindexes) {
+        errno = ENOMEM;
+        return -1;
+    }
 
-        for (j = 0;  j < i;  j++) {
-            if (idx == idxcols[j])
-                break;
+    tbl->sindexes = sindexes;
+    ix = sindexes + tbl->nsindex;
 
-            if (idx < idxcols[j]) {
-                memmove(idxcols + j+1, idxcols + j, sizeof(*idxcols) * (i-j));
-                break;
-            }
-        }
+    memset(ix, 0, sizeof(*ix));
 
-        idxcols[j] = idx;
-    }
+    if (index_setup(tbl, ix, index_columns, 0) < 0)
+        return -1;
 
-    if (type == mqi_unknown || beg < 0 || end <= beg ||
-        end - beg > MDB_INDEX_LENGTH_MAX)
-    {
-        free(idxcols);
-        errno = EIO;
+    if (!MDB_INDEX_DEFINED(ix)) {
+        errno = EINVAL;
         return -1;
     }
 
-    ix->type    = type;
-    ix->length  = end - beg;
-    ix->offset  = beg;
-    ix->ncolumn = i;
-    ix->columns = idxcols;
+    if (!(ix->name = strdup(name))) {
+        index_free(ix);
+        errno = ENOMEM;
+        return -1;
+    }
 
-    switch (type) {
-    case mqi_varchar:
-        ix->hash = INDEX_HASH_CREATE(varchar);
-        ix->sequence = INDEX_SEQUENCE_CREATE(varchar);
-        break;
-    case mqi_integer:
-        ix->hash = INDEX_HASH_CREATE(integer);
-        ix->sequence = INDEX_SEQUENCE_CREATE(integer);
-        break;
-    case mqi_unsignd:
-        ix->hash = INDEX_HASH_CREATE(unsignd);
-        ix->sequence = INDEX_SEQUENCE_CREATE(unsignd);
-        break;
-    case mqi_blob:
-        ix->hash = INDEX_HASH_CREATE(blob);
-        ix->sequence = INDEX_SEQUENCE_CREATE(blob);
-        break;
-    default:
-        free(idxcols);
-        memset(ix, 0, sizeof(*ix));
-        break;
+    MDB_DLIST_FOR_EACH(mdb_row_t, link, row, &tbl->rows) {
+        if (mdb_btree_add(ix->btree, ix->length,INDEX_KEY(ix,row), row) < 0) {
+            index_free(ix);
+            return -1;
+        }
     }
 
+    tbl->nsindex++;
+
     return 0;
 }
 
-void mdb_index_drop(mdb_table_t *tbl)
+int mdb_index_drop_secondary(mdb_table_t *tbl, char *name)
 {
     mdb_index_t *ix;
+    int          i;
 
-    MDB_CHECKARG(tbl,);
-
-    ix = &tbl->index;
+    MDB_CHECKARG(tbl && name, -1);
 
-    if (MDB_INDEX_DEFINED(ix)) {
-        INDEX_HASH_DROP(ix);
-        INDEX_SEQUENCE_DROP(ix);
+    for (i = 0;  i < tbl->nsindex;  i++) {
+        ix = tbl->sindexes + i;
 
-        free(ix->columns);
+        if (!strcmp(name, ix->name)) {
+            index_free(ix);
+            tbl->generation++;
 
-        memset(ix, 0, sizeof(*ix));
+            memmove(ix, ix + 1, sizeof(*ix) * (tbl->nsindex - (i+1)));
+            tbl->nsindex--;
 
-        ix->type = mqi_unknown;
+            return 0;
+        }
     }
+
+    errno = ENOENT;
+    return -1;
+}
+
+void mdb_index_drop(mdb_table_t *tbl)
+{
+    int i;
+
+    MDB_CHECKARG(tbl,);
+
+    index_free(&tbl->index);
+
+    for (i = 0;  i < tbl->nsindex;  i++)
+        index_free(tbl->sindexes + i);
+
+    free(tbl->sindexes);
+
+    tbl->nsindex  = 0;
+    tbl->sindexes = NULL;
 }
 
 void mdb_index_reset(mdb_table_t *tbl)
 {
     mdb_index_t *ix;
+    int          i;
 
     MDB_CHECKARG(tbl,);
 
@@ -188,7 +186,12 @@ void mdb_index_reset(mdb_table_t *tbl)
 
     if (MDB_INDEX_DEFINED(ix)) {
         INDEX_HASH_RESET(ix);
-        INDEX_SEQUENCE_RESET(ix);
+        INDEX_BTREE_RESET(ix);
+    }
+
+    for (i = 0;  i < tbl->nsindex;  i++) {
+        ix = tbl->sindexes + i;
+        INDEX_BTREE_RESET(ix);
     }
 }
 
@@ -202,7 +205,7 @@ int mdb_index_insert(mdb_table_t   *tbl,
     int             lgh;
     void           *key;
     mdb_hash_t     *hash;
-    mdb_sequence_t *seq;
+    mdb_btree_t    *bt;
     mdb_row_t      *old;
     uint32_t        txdepth;
 
@@ -210,16 +213,25 @@ int mdb_index_insert(mdb_table_t   *tbl,
 
     ix = &tbl->index;
 
-    if (!MDB_INDEX_DEFINED(ix))
+    if (!MDB_INDEX_DEFINED(ix)) {
+        if (secondary_insert(tbl, row) < 0)
+            return -1;
         return 1;               /* fake a sucessful insertion */
+    }
 
     hash = ix->hash;
-    seq  = ix->sequence;
+    bt   = ix->btree;
     lgh  = ix->length;
-    key  = (void *)row->data + ix->offset;
+    key  = INDEX_KEY(ix, row);
 
     if (mdb_hash_add(hash, lgh,key, row) == 0) {
-        mdb_sequence_add(seq, lgh,key, row);
+        mdb_btree_add(bt, lgh,key, row);
+
+        if (secondary_insert(tbl, row) < 0) {
+            primary_delete(tbl, row);
+            return -1;
+        }
+
         return 1;
     }
 
@@ -237,14 +249,15 @@ int mdb_index_insert(mdb_table_t   *tbl,
         }
 
         if (!(old = mdb_hash_delete(hash, lgh,key)) ||
-            (old != mdb_sequence_delete(seq, lgh,key)))
+            (old != mdb_btree_delete(bt, lgh,key)))
         {
             /* something is really broken: get out quickly */
             errno = EIO;
             return -1;
         }
         else {
-            if (mdb_row_delete(tbl, old, 0,0) < 0 ||
+            if (secondary_delete(tbl, old) < 0 ||
+                mdb_row_delete(tbl, old, 0,0) < 0 ||
                 mdb_log_change(tbl, txdepth, mdb_log_update,cmask,old,row) < 0)
             {
                 /* errno is either EEXIST or ENOMEM set by mdb_hash_add */
@@ -252,7 +265,12 @@ int mdb_index_insert(mdb_table_t   *tbl,
             }
 
             mdb_hash_add(hash, lgh,key, row);
-            mdb_sequence_add(seq, lgh,key, row);
+            mdb_btree_add(bt, lgh,key, row);
+
+            if (secondary_insert(tbl, row) < 0) {
+                primary_delete(tbl, row);
+                return -1;
+            }
         }
     }
     else { /* duplicate insertion is an error. keep the original row */
@@ -264,34 +282,109 @@ int mdb_index_insert(mdb_table_t   *tbl,
     return 0;
 }
 
+/*
+ * Index a batch of new rows in one go, building the trees in a single
+ * pass. Rows with a duplicate primary key are deleted like with
+ * mdb_index_insert() and are dropped from rows. Returns the number of
+ * rows left in rows.
+ */
+int mdb_index_bulk_insert(mdb_table_t *tbl, mdb_row_t **rows, int nrow)
+{
+    mdb_index_t  *ix;
+    mdb_row_t    *row;
+    void        **keys;
+    int           i, j, n;
+
+    MDB_CHECKARG(tbl && rows && nrow >= 0, -1);
+
+    if (!(keys = malloc(sizeof(void *) * (nrow > 0 ? nrow : 1)))) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    ix = &tbl->index;
+
+    if (MDB_INDEX_DEFINED(ix)) {
+        for (i = n = 0;  i < nrow;  i++) {
+            row = rows[i];
+
+            if (mdb_hash_add(ix->hash, ix->length,INDEX_KEY(ix,row), row) < 0)
+                mdb_row_delete(tbl, row, 0, 1);
+            else {
+                keys[n]   = INDEX_KEY(ix, row);
+                rows[n++] = row;
+            }
+        }
+
+        nrow = n;
+
+        if (mdb_btree_bulk_add(ix->btree, ix->length, nrow,
+                               keys, (void **)rows) < 0)
+            goto failed;
+    }
+
+    for (i = 0;  i < tbl->nsindex;  i++) {
+        ix = tbl->sindexes + i;
+
+        for (j = 0;  j < nrow;  j++)
+            keys[j] = INDEX_KEY(ix, rows[j]);
+
+        if (mdb_btree_bulk_add(ix->btree, ix->length, nrow,
+                               keys, (void **)rows) < 0)
+            goto failed;
+    }
+
+    free(keys);
+
+    return nrow;
+
+ failed:
+    free(keys);
+    return -1;
+}
+
 int mdb_index_delete(mdb_table_t *tbl, mdb_row_t *row)
 {
     mdb_index_t    *ix;
     int             lgh;
     void           *key;
     mdb_hash_t     *hash;
-    mdb_sequence_t *seq;
+    mdb_btree_t    *bt;
 
     MDB_CHECKARG(tbl && row, -1);
 
     ix = &tbl->index;
 
-    if (!MDB_INDEX_DEFINED(ix))
-        return 0;
-
-    hash = ix->hash;
-    seq  = ix->sequence;
-    lgh  = ix->length;
-    key  = (void *)row->data + ix->offset;
+    if (MDB_INDEX_DEFINED(ix)) {
+        hash = ix->hash;
+        bt   = ix->btree;
+        lgh  = ix->length;
+        key  = INDEX_KEY(ix, row);
 
-    if (mdb_hash_delete(hash, lgh,key)    != row ||
-        mdb_sequence_delete(seq, lgh,key) != row)
-    {
-        errno = EIO;
-        return -1;
+        if (mdb_hash_delete(hash, lgh,key) != row ||
+            mdb_btree_delete(bt, lgh,key)  != row)
+        {
+            errno = EIO;
+            return -1;
+        }
     }
 
-    return 0;
+    return secondary_delete(tbl, row);
+}
+
+mqi_bitfld_t mdb_index_columns(mdb_table_t *tbl)
+{
+    mqi_bitfld_t cmask;
+    int          i;
+
+    MDB_CHECKARG(tbl, 0);
+
+    cmask = tbl->index.cmask;
+
+    for (i = 0;  i < tbl->nsindex;  i++)
+        cmask |= tbl->sindexes[i].cmask;
+
+    return cmask;
 }
 
 mdb_row_t *mdb_index_get_row(mdb_table_t *tbl, int idxlen, void *idxval)
@@ -305,6 +398,98 @@ mdb_row_t *mdb_index_get_row(mdb_table_t *tbl, int idxlen, void *idxval)
     return mdb_hash_get_data(ix->hash, idxlen, idxval);
 }
 
+/*
+ * Turn the top-level conjuncts of cond that compare the index column
+ * against a variable into a key range on the index. Returns 0 if cond
+ * does not bound the column, or the index is not a single-column one.
+ * Otherwise sets up rng and returns how selective the range is: 1 for
+ * a one-sided range, 2 for a two-sided one and 3 for a single key. The
+ * range only narrows down the candidate rows: cond still needs to be
+ * evaluated on each of them.
+ */
+int mdb_index_range(mdb_index_t       *ix,
+                    mqi_cond_entry_t  *cond,
+                    mdb_btree_range_t *rng)
+{
+    mdb_btree_t      *bt;
+    mqi_cond_entry_t *ce;
+    mqi_operator_t    op;
+    void             *key;
+    void             *lo, *hi;
+    int               lo_incl, hi_incl;
+    int               cmp;
+
+    MDB_CHECKARG(ix && cond && rng, -1);
+
+    if (!MDB_INDEX_DEFINED(ix) || ix->ncolumn != 1)
+        return 0;
+
+    if (ix->type != mqi_varchar &&
+        ix->type != mqi_integer &&
+        ix->type != mqi_unsignd)
+        return 0;
+
+    bt = ix->btree;
+    lo = hi = NULL;
+    lo_incl = hi_incl = 0;
+
+    for (ce = cond;   ;   ce++) {
+        /* ce is at the beginning of a top-level conjunct */
+        if ((op = index_bound(ix, ce, &key)) != mqi_done) {
+            switch (op) {
+            case mqi_eq:
+            case mqi_geq:
+            case mqi_gt:
+                cmp = lo ? mdb_btree_compare(bt, ix->length, key,lo) : 1;
+
+                if (cmp > 0 || (!cmp && op == mqi_gt)) {
+                    lo = key;
+                    lo_incl = (op != mqi_gt);
+                }
+                if (op != mqi_eq)
+                    break;
+                MDB_FALLTHROUGH;
+            case mqi_less:
+            case mqi_leq:
+                cmp = hi ? mdb_btree_compare(bt, ix->length, key,hi) : -1;
+
+                if (cmp < 0 || (!cmp && op == mqi_less)) {
+                    hi = key;
+                    hi_incl = (op != mqi_less);
+                }
+                break;
+            default:
+                break;
+            }
+        }
+
+        /*
+         * skip to the next conjunct; and binds the loosest, so anything
+         * after a top-level and is a new conjunct. Stop at the first
+         * subexpression, the bounds collected so far are still valid.
+         */
+        while (ce->type != mqi_operator ||
+               (ce->u.operator_ != mqi_and   &&
+                ce->u.operator_ != mqi_end   &&
+                ce->u.operator_ != mqi_begin))
+            ce++;
+
+        if (ce->u.operator_ != mqi_and)
+            break;
+    }
+
+    if (!lo && !hi)
+        return 0;
+
+    if (mdb_btree_range_init(bt, rng, ix->length, lo,lo_incl, hi,hi_incl) < 0)
+        return 0;
+
+    if (lo == hi)
+        return 3;
+    else
+        return (lo && hi) ? 2 : 1;
+}
+
 int mdb_index_print(mdb_table_t *tbl, char *buf, int len)
 {
 #define PRINT(args...)  if (e > p) p += snprintf(p, e-p, args)
@@ -335,6 +520,278 @@ int mdb_index_print(mdb_table_t *tbl, char *buf, int len)
 #undef PRINT
 }
 
+static int index_setup(mdb_table_t  *tbl,
+                       mdb_index_t  *ix,
+                       char        **index_columns,
+                       int           primary)
+{
+    mdb_column_t    *col;
+    mqi_data_type_t  type;
+    mqi_bitfld_t     cmask;
+    int              flags;
+    int              beg, end;
+    int             *idxcols;
+    int              i,j, idx;
+
+    beg = end = 0;
+    type = mqi_unknown;
+    cmask = 0;
+    idxcols = NULL;
+
+    for (i = 0;    index_columns[i];    i++) {
+        if (!(idx = mdb_hash_get_data(tbl->chash,0,index_columns[i]) - NULL)) {
+            free(idxcols);
+            errno = ENOENT;
+            return -1;
+        }
+
+        col = tbl->columns + --idx;
+
+        if (primary)
+            col->flags |= MQI_COLUMN_KEY;
+
+        if (i == 0) {
+            type = col->type;
+            beg  = col->offset;
+            end  = beg + col->length;
+        }
+        else {
+            type = mqi_blob;
+
+            if (col->offset == end)
+                end += col->length;
+            else if (col->offset == beg - col->length)
+                beg = col->offset;
+            else {
+                type = mqi_unknown;
+                break; /* not an adjacent column */
+            }
+        }
+
+        if (!(idxcols = realloc(idxcols, sizeof(int) * (i+1)))) {
+            errno = ENOMEM;
+            return -1;
+        }
+
+        for (j = 0;  j < i;  j++) {
+            if (idx == idxcols[j])
+                break;
+
+            if (idx < idxcols[j]) {
+                memmove(idxcols + j+1, idxcols + j, sizeof(*idxcols) * (i-j));
+                break;
+            }
+        }
+
+        idxcols[j] = idx;
+        cmask |= (((mqi_bitfld_t)1) << idx);
+    }
+
+    if (type == mqi_unknown || beg < 0 || end <= beg ||
+        end - beg > MDB_INDEX_LENGTH_MAX)
+    {
+        free(idxcols);
+        errno = EIO;
+        return -1;
+    }
+
+    ix->type    = type;
+    ix->length  = end - beg;
+    ix->offset  = beg;
+    ix->ncolumn = i;
+    ix->columns = idxcols;
+    ix->cmask   = cmask;
+
+    flags = primary ? 0 : MDB_BTREE_DUPLICATES;
+
+    switch (type) {
+    case mqi_varchar:
+        ix->hash  = primary ? INDEX_HASH_CREATE(varchar) : NULL;
+        ix->btree = INDEX_BTREE_CREATE(varchar, flags);
+        break;
+    case mqi_integer:
+        ix->hash  = primary ? INDEX_HASH_CREATE(integer) : NULL;
+        ix->btree = INDEX_BTREE_CREATE(integer, flags);
+        break;
+    case mqi_unsignd:
+        ix->hash  = primary ? INDEX_HASH_CREATE(unsignd) : NULL;
+        ix->btree = INDEX_BTREE_CREATE(unsignd, flags);
+        break;
+    case mqi_blob:
+        ix->hash  = primary ? INDEX_HASH_CREATE(blob) : NULL;
+        ix->btree = INDEX_BTREE_CREATE(blob, flags);
+        break;
+    default:
+        free(idxcols);
+        memset(ix, 0, sizeof(*ix));
+        break;
+    }
+
+    return 0;
+}
+
+static void index_free(mdb_index_t *ix)
+{
+    if (MDB_INDEX_DEFINED(ix)) {
+        if (ix->hash)
+            INDEX_HASH_DROP(ix);
+
+        INDEX_BTREE_DROP(ix);
+
+        free(ix->columns);
+        free(ix->name);
+
+        memset(ix, 0, sizeof(*ix));
+
+        ix->type = mqi_unknown;
+    }
+}
+
+/*
+ * Undo the primary index insertion of row, keeping errno intact. Used
+ * when the secondary indices could not take the row, so that the table
+ * never has a row in some of its indices only.
+ */
+static void primary_delete(mdb_table_t *tbl, mdb_row_t *row)
+{
+    mdb_index_t *ix = &tbl->index;
+    void        *key;
+    int          error;
+
+    error = errno;
+    key   = INDEX_KEY(ix, row);
+
+    mdb_hash_delete(ix->hash, ix->length,key);
+    mdb_btree_delete(ix->btree, ix->length,key);
+
+    errno = error;
+}
+
+static int secondary_insert(mdb_table_t *tbl, mdb_row_t *row)
+{
+    mdb_index_t *ix;
+    int          error;
+    int          i;
+
+    for (i = 0;  i < tbl->nsindex;  i++) {
+        ix = tbl->sindexes + i;
+
+        if (mdb_btree_add(ix->btree, ix->length,INDEX_KEY(ix,row), row) < 0) {
+            error = errno;
+
+            while (--i >= 0) {
+                ix = tbl->sindexes + i;
+                mdb_btree_delete(ix->btree, ix->length,INDEX_KEY(ix,row));
+            }
+
+            errno = error;
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static int secondary_delete(mdb_table_t *tbl, mdb_row_t *row)
+{
+    mdb_index_t *ix;
+    int          sts;
+    int          i;
+
+    for (i = 0, sts = 0;  i < tbl->nsindex;  i++) {
+        ix = tbl->sindexes + i;
+
+        if (mdb_btree_delete(ix->btree, ix->length,INDEX_KEY(ix,row)) != row){
+            errno = EIO;
+            sts = -1;
+        }
+    }
+
+    return sts;
+}
+
+/*
+ * Check whether cond starts with a complete conjunct of the form
+ * 'column relop variable' or 'variable relop column' on the index
+ * column. Returns the operator normalized to 'column relop variable'
+ * and the key to compare against, or mqi_done if there is no such
+ * conjunct.
+ */
+static mqi_operator_t index_bound(mdb_index_t      *ix,
+                                  mqi_cond_entry_t *cond,
+                                  void            **key)
+{
+    mqi_cond_entry_t *var;
+    mqi_variable_t   *v;
+    mqi_operator_t    op;
+    int               cindex = ix->columns[0];
+    int               flip;
+
+    if (cond[0].type == mqi_column && cond[0].u.column == cindex)
+        flip = 0;
+    else if (cond[0].type == mqi_variable)
+        flip = 1;
+    else
+        return mqi_done;
+
+    if (cond[1].type != mqi_operator)
+        return mqi_done;
+
+    switch ((op = cond[1].u.operator_)) {
+    case mqi_less: case mqi_leq: case mqi_eq: case mqi_geq: case mqi_gt:
+        break;
+    default:
+        return mqi_done;
+    }
+
+    if (flip) {
+        if (cond[2].type != mqi_column || cond[2].u.column != cindex)
+            return mqi_done;
+
+        var = cond + 0;
+
+        switch (op) {
+        case mqi_less:  op = mqi_gt;    break;
+        case mqi_leq:   op = mqi_geq;   break;
+        case mqi_geq:   op = mqi_leq;   break;
+        case mqi_gt:    op = mqi_less;  break;
+        default:                        break;
+        }
+    }
+    else {
+        if (cond[2].type != mqi_variable)
+            return mqi_done;
+
+        var = cond + 2;
+    }
+
+    if (cond[3].type != mqi_operator ||
+        (cond[3].u.operator_ != mqi_and && cond[3].u.operator_ != mqi_end))
+        return mqi_done;
+
+    v = &var->u.variable;
+
+    if (v->type != ix->type || !v->v.generic)
+        return mqi_done;
+
+    switch (v->type) {
+    case mqi_varchar:
+        if (!(*key = *v->v.varchar))
+            return mqi_done;
+        break;
+    case mqi_integer:
+        *key = v->v.integer;
+        break;
+    case mqi_unsignd:
+        *key = v->v.unsignd;
+        break;
+    default:
+        return mqi_done;
+    }
+
+    return op;
+}
+
 
 /*
  * Local Variables:
@@ -33,7 +33,7 @@
 
 #include <murphy-db/mqi-types.h>
 #include <murphy-db/hash.h>
-#include <murphy-db/sequence.h>
+#include <murphy-db/btree.h>
 #include <murphy-db/mdb.h>
 
 #include "row.h"
@@ -43,22 +43,29 @@
 #define MDB_INDEX_DEFINED(ix) ((ix)->type != mqi_unknown)
 
 typedef struct {
+    char            *name;      /* NULL for the primary index */
     mqi_data_type_t  type;
     int              length;
     int              offset;
-    mdb_hash_t      *hash;
-    mdb_sequence_t  *sequence;
+    mdb_hash_t      *hash;      /* only for the (unique) primary index */
+    mdb_btree_t     *btree;
     int              ncolumn;
     int             *columns;   /* sorted */
+    mqi_bitfld_t     cmask;     /* columns as a bitmask */
 } mdb_index_t;
 
 
 int mdb_index_create(mdb_table_t *, char **);
+int mdb_index_create_secondary(mdb_table_t *, char *, char **);
+int mdb_index_drop_secondary(mdb_table_t *, char *);
 void mdb_index_drop(mdb_table_t *);
 void mdb_index_reset(mdb_table_t *);
 int mdb_index_insert(mdb_table_t *, mdb_row_t *, mqi_bitfld_t, int);
+int mdb_index_bulk_insert(mdb_table_t *, mdb_row_t **, int);
 int mdb_index_delete(mdb_table_t *, mdb_row_t *);
+mqi_bitfld_t mdb_index_columns(mdb_table_t *);
 mdb_row_t *mdb_index_get_row(mdb_table_t *, int, void *);
+int mdb_index_range(mdb_index_t *, mqi_cond_entry_t *, mdb_btree_range_t *);
 int mdb_index_print(mdb_table_t *, char *, int);
 
 
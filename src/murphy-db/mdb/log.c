@@ -42,6 +42,7 @@
 #include "log.h"
 #include "row.h"
 #include "table.h"
+#include "wal.h"
 
 #ifndef LOG_STATISTICS
 #define LOG_STATISTICS
@@ -56,14 +57,28 @@ typedef struct {
     LOG_COMMON_FIELDS;
 } log_t;
 
+#define ARENA_CHUNK_SIZE  4096  /* default size of an arena chunk */
+#define ARENA_SPARE_MAX   4     /* max. number of chunks kept for reuse */
+
+typedef struct arena_chunk_s arena_chunk_t;
+
+struct arena_chunk_s {
+    arena_chunk_t *next;
+    size_t         size;        /* usable size of the chunk */
+    size_t         used;        /* bytes handed out from the chunk */
+    uint64_t       data[0];
+};
+
 typedef struct {
     LOG_COMMON_FIELDS;
+    arena_chunk_t *arena;       /* memory of the table logs and changes */
 } tx_log_t;
 
 typedef struct {
     LOG_COMMON_FIELDS;
     mdb_table_t *table;
     mdb_dlist_t  changes;
+    mdb_opcnt_t  cnt;           /* table counters at the start */
 } tbl_log_t;
 
 typedef struct {
@@ -80,14 +95,21 @@ typedef struct {
 
 
 static inline log_t *new_log(mdb_dlist_t *, mdb_dlist_t *, uint32_t, int);
+static inline log_t *init_log(log_t *, mdb_dlist_t *, mdb_dlist_t *,
+                              uint32_t);
 static inline void delete_log(log_t *);
+static inline void unlink_log(log_t *);
+static void *arena_alloc(tx_log_t *, size_t);
+static void arena_release(tx_log_t *);
 static inline log_t *get_last_vlog(mdb_dlist_t *);
 static tx_log_t *get_tx_log(uint32_t);
-static tbl_log_t *get_tbl_log(mdb_dlist_t *, mdb_dlist_t *, uint32_t,
+static tbl_log_t *get_tbl_log(mdb_dlist_t *, tx_log_t *, uint32_t,
                               mdb_table_t *);
 static void delete_tx_log(uint32_t);
 
 static MDB_DLIST_HEAD(tx_head);
+static arena_chunk_t *spare_chunks;
+static int            nspare_chunk;
 
 int mdb_log_create(mdb_table_t *tbl)
 {
@@ -112,19 +134,20 @@ int mdb_log_change(mdb_table_t    *tbl,
 
     MDB_CHECKARG(tbl, -1);
 
-    if (!depth)
+    if (!depth) {
+        if (tbl->persistent)
+            return mdb_wal_change(tbl, type, colmask, before, after);
         return 0;
+    }
 
     if (!(txlog = get_tx_log(depth)) ||
-        !(tblog = get_tbl_log(&tbl->logs, &txlog->hlink, depth, tbl)))
+        !(tblog = get_tbl_log(&tbl->logs, txlog, depth, tbl)))
     {
         return -1;
     }
 
-    if (!(change = calloc(1, sizeof(change_t)))) {
-        errno = ENOMEM;
+    if (!(change = arena_alloc(txlog, sizeof(change_t))))
         return -1;
-    }
 
     change->type    = type;
     change->colmask = colmask;
@@ -189,7 +212,7 @@ mdb_log_entry_t *mdb_log_transaction_iterate(uint32_t   depth,
 
         if (MDB_DLIST_EMPTY(*hhead)) {
             if (delete)
-                delete_log((log_t *)txlog);
+                delete_tx_log(txlog->depth);
             return NULL;
         }
 
@@ -219,7 +242,7 @@ mdb_log_entry_t *mdb_log_transaction_iterate(uint32_t   depth,
         if (cursor->clink == cursor->chead) {
             if (delete) {
                 tblog = MDB_LIST_RELOCATE(tbl_log_t, changes, cursor->chead);
-                delete_log((log_t *)tblog);
+                unlink_log((log_t *)tblog);
             }
         }
         else {
@@ -232,10 +255,8 @@ mdb_log_entry_t *mdb_log_transaction_iterate(uint32_t   depth,
             entry->before  = change->before;
             entry->after   = change->after;
 
-            if (delete) {
+            if (delete)
                 MDB_DLIST_UNLINK(change_t, link, change);
-                free(change);
-            }
 
             return entry;
         }
@@ -321,7 +342,7 @@ mdb_log_entry_t *mdb_log_table_iterate(mdb_table_t  *tbl,
         if (cursor->clink == cursor->chead) {
             if (delete) {
                 tblog = MDB_LIST_RELOCATE(tbl_log_t, changes, cursor->chead);
-                delete_log((log_t *)tblog);
+                unlink_log((log_t *)tblog);
             }
         }
         else {
@@ -334,10 +355,8 @@ mdb_log_entry_t *mdb_log_table_iterate(mdb_table_t  *tbl,
             entry->before  = change->before;
             entry->after   = change->after;
 
-            if (delete) {
+            if (delete)
                 MDB_DLIST_UNLINK(change_t, link, change);
-                free(change);
-            }
 
             return entry;
         }
@@ -372,26 +391,39 @@ static inline log_t *new_log(mdb_dlist_t *vhead,
 {
     log_t *log;
 
-    if ((log = calloc(1, size))) {
-        MDB_DLIST_APPEND(mdb_log_t, vlink, log, vhead);
+    if ((log = calloc(1, size)))
+        init_log(log, vhead, hhead, depth);
 
-        if (hhead)
-            MDB_DLIST_APPEND(mdb_log_t, hlink, log, hhead);
-        else
-            MDB_DLIST_INIT(log->hlink);
+    return log;
+}
 
-        log->depth = depth;
-    }
+static inline log_t *init_log(log_t       *log,
+                              mdb_dlist_t *vhead,
+                              mdb_dlist_t *hhead,
+                              uint32_t     depth)
+{
+    MDB_DLIST_APPEND(mdb_log_t, vlink, log, vhead);
+
+    if (hhead)
+        MDB_DLIST_APPEND(mdb_log_t, hlink, log, hhead);
+    else
+        MDB_DLIST_INIT(log->hlink);
+
+    log->depth = depth;
 
     return log;
 }
 
 static inline void delete_log(log_t *log)
+{
+    unlink_log(log);
+    free(log);
+}
+
+static inline void unlink_log(log_t *log)
 {
     MDB_DLIST_UNLINK(log_t, vlink, log);
     MDB_DLIST_UNLINK(log_t, hlink, log);
-
-    free(log);
 }
 
 
@@ -421,7 +453,7 @@ static tx_log_t *get_tx_log(uint32_t depth)
 }
 
 static tbl_log_t *get_tbl_log(mdb_dlist_t *vhead,
-                              mdb_dlist_t *hhead,
+                              tx_log_t    *txlog,
                               uint32_t     depth,
                               mdb_table_t *tbl)
 {
@@ -429,27 +461,23 @@ static tbl_log_t *get_tbl_log(mdb_dlist_t *vhead,
     change_t  *change;
 
     if (!(log = (tbl_log_t *)get_last_vlog(vhead)) || depth > log->depth) {
-        if ((log = (tbl_log_t *)new_log(vhead, hhead, depth, sizeof(*log)))) {
-            log->table = tbl;
-            MDB_DLIST_INIT(log->changes);
+        if (!(log = arena_alloc(txlog, sizeof(*log))) ||
+            !(change = arena_alloc(txlog, sizeof(change_t))))
+        {
+            return NULL;
+        }
 
-            if (!(change = calloc(1, sizeof(change_t)))) {
-                errno = ENOMEM;
-                return NULL;
-            }
+        init_log((log_t *)log, vhead, &txlog->hlink, depth);
 
-            if (!(change->cnt = calloc(1, sizeof(*change->cnt)))) {
-                free(change);
-                errno = ENOMEM;
-                return NULL;
-            }
+        log->table = tbl;
+        log->cnt   = tbl->cnt;
+        MDB_DLIST_INIT(log->changes);
 
-            change->type = mdb_log_start;
-            *change->cnt = tbl->cnt;
-            tbl->cnt.stamp++;
+        change->type = mdb_log_start;
+        change->cnt  = &log->cnt;
+        tbl->cnt.stamp++;
 
-            MDB_DLIST_PREPEND(change_t, link, change, &log->changes);
-        }
+        MDB_DLIST_PREPEND(change_t, link, change, &log->changes);
     }
 
     if (!log) {
@@ -474,8 +502,78 @@ static void delete_tx_log(uint32_t depth)
 {
     log_t *log;
 
-    if ((log = get_last_vlog(&tx_head)) && depth == log->depth)
+    if ((log = get_last_vlog(&tx_head)) && depth == log->depth) {
+        arena_release((tx_log_t *)log);
         delete_log(log);
+    }
+}
+
+
+/*
+ * The table logs and changes of a transaction are allocated from an
+ * arena owned by its transaction log. They are unlinked one by one as
+ * the log is processed, but their memory is released all at once when
+ * the transaction log itself goes away. A few chunks are kept around
+ * to serve the next transactions without touching malloc.
+ */
+static void *arena_alloc(tx_log_t *txlog, size_t size)
+{
+    arena_chunk_t *chunk;
+    size_t         csiz;
+    void          *ptr;
+
+    size  = (size + 7) & ~7;
+    chunk = txlog->arena;
+
+    if (!chunk || chunk->used + size > chunk->size) {
+        if (spare_chunks && size <= spare_chunks->size) {
+            chunk = spare_chunks;
+            spare_chunks = chunk->next;
+            nspare_chunk--;
+        }
+        else {
+            csiz = size > ARENA_CHUNK_SIZE ? size : ARENA_CHUNK_SIZE;
+
+            if (!(chunk = malloc(sizeof(*chunk) + csiz))) {
+                errno = ENOMEM;
+                return NULL;
+            }
+
+            chunk->size = csiz;
+        }
+
+        chunk->used  = 0;
+        chunk->next  = txlog->arena;
+        txlog->arena = chunk;
+    }
+
+    ptr = (uint8_t *)chunk->data + chunk->used;
+    chunk->used += size;
+
+    memset(ptr, 0, size);
+
+    return ptr;
+}
+
+static void arena_release(tx_log_t *txlog)
+{
+    arena_chunk_t *chunk, *next;
+
+    for (chunk = txlog->arena;  chunk;  chunk = next) {
+        next = chunk->next;
+
+        if (nspare_chunk < ARENA_SPARE_MAX &&
+            chunk->size == ARENA_CHUNK_SIZE)
+        {
+            chunk->next  = spare_chunks;
+            spare_chunks = chunk;
+            nspare_chunk++;
+        }
+        else
+            free(chunk);
+    }
+
+    txlog->arena = NULL;
 }
 
 
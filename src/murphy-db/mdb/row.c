@@ -43,7 +43,62 @@
 #include "index.h"
 #include "column.h"
 
+#define ROW_SLAB_SIZE   4096    /* preferred size of a row slab */
+#define ROW_SLAB_MIN    8       /* minimum number of rows in a slab */
+#define ROW_EMPTY_MAX   1       /* max. number of empty slabs kept */
 
+struct mdb_row_slab_s {
+    mdb_dlist_t     link;       /* to the slabs of the pool */
+    mdb_row_t      *free;       /* released rows, chained via link.next */
+    int             nused;      /* number of rows in use */
+    uint64_t        rows[0];    /* aligned for the row data */
+};
+
+#define ROW_SLAB(pool, row) \
+    ((mdb_row_slab_t *)((uintptr_t)(row) & ~((uintptr_t)(pool)->slabsize-1)))
+
+
+static mdb_row_t *row_alloc(mdb_row_pool_t *);
+static void row_free(mdb_row_pool_t *, mdb_row_t *);
+
+
+/*
+ * Rows are carved out of per-table slabs and recycled through per-slab
+ * free lists, instead of having every insert, update and delete hit
+ * malloc. Slabs are aligned to their size, so the slab of a row can be
+ * found from the row address. Slabs with free rows are kept at the head
+ * of the list, full ones at its tail. A slab is released as soon as its
+ * last row is, except for one spare empty slab kept to avoid thrashing
+ * when a table keeps growing and shrinking around a slab boundary.
+ */
+void mdb_row_pool_init(mdb_row_pool_t *pool, int dlgh)
+{
+    int size;
+
+    MDB_DLIST_INIT(pool->slabs);
+
+    pool->rowsize = (sizeof(mdb_row_t) + dlgh + 7) & ~7;
+    pool->nempty  = 0;
+
+    size = sizeof(mdb_row_slab_t) + ROW_SLAB_MIN * pool->rowsize;
+
+    for (pool->slabsize = ROW_SLAB_SIZE;  pool->slabsize < size; )
+        pool->slabsize *= 2;
+
+    pool->nrow = (pool->slabsize - sizeof(mdb_row_slab_t)) / pool->rowsize;
+}
+
+void mdb_row_pool_destroy(mdb_row_pool_t *pool)
+{
+    mdb_row_slab_t *slab, *n;
+
+    MDB_DLIST_FOR_EACH_SAFE(mdb_row_slab_t, link, slab,n, &pool->slabs) {
+        MDB_DLIST_UNLINK(mdb_row_slab_t, link, slab);
+        free(slab);
+    }
+
+    pool->nempty = 0;
+}
 
 mdb_row_t *mdb_row_create(mdb_table_t *tbl)
 {
@@ -51,12 +106,11 @@ mdb_row_t *mdb_row_create(mdb_table_t *tbl)
 
     MDB_CHECKARG(tbl, NULL);
 
-    if (!(row = calloc(1, sizeof(mdb_row_t) + tbl->dlgh))) {
-        errno = ENOMEM;
+    if (!(row = row_alloc(&tbl->rpool)))
         return NULL;
-    }
 
     MDB_DLIST_APPEND(mdb_row_t, link, row, &tbl->rows);
+    tbl->generation++;
 
     return row;
 }
@@ -67,10 +121,8 @@ mdb_row_t *mdb_row_duplicate(mdb_table_t *tbl, mdb_row_t *row)
 
     MDB_CHECKARG(tbl && row, NULL);
 
-    if (!(dup = calloc(1, sizeof(mdb_row_t) + tbl->dlgh))) {
-        errno = ENOMEM;
+    if (!(dup = row_alloc(&tbl->rpool)))
         return NULL;
-    }
 
     MDB_DLIST_INIT(dup->link);
     memcpy(dup->data, row->data, tbl->dlgh);
@@ -85,18 +137,18 @@ int mdb_row_delete(mdb_table_t *tbl,
 {
     int sts = 0;
 
-    (void)tbl;
-
     MDB_CHECKARG(row, -1);
 
     if (index_update && mdb_index_delete(tbl, row) < 0)
         sts = -1;
 
-    if (!MDB_DLIST_EMPTY(row->link))
+    if (!MDB_DLIST_EMPTY(row->link)) {
         MDB_DLIST_UNLINK(mdb_row_t, link, row);
+        tbl->generation++;
+    }
 
     if (free_it)
-        free(row);
+        row_free(&tbl->rpool, row);
     else
         MDB_DLIST_INIT(row->link);
 
@@ -119,6 +171,7 @@ int mdb_row_update(mdb_table_t       *tbl,
     MDB_CHECKARG(tbl && row && cds && data, -1);
 
     columns = tbl->columns;
+    tbl->generation++;
 
     if (index_update)
         mdb_index_delete(tbl, row);
@@ -150,6 +203,8 @@ int mdb_row_copy_over(mdb_table_t *tbl, mdb_row_t *dst, mdb_row_t *src)
 {
     MDB_CHECKARG(tbl && dst && src, -1);
 
+    tbl->generation++;
+
     if (mdb_index_delete(tbl, dst) < 0)
         return -1;
 
@@ -162,6 +217,75 @@ int mdb_row_copy_over(mdb_table_t *tbl, mdb_row_t *dst, mdb_row_t *src)
 }
 
 
+static mdb_row_t *row_alloc(mdb_row_pool_t *pool)
+{
+    mdb_row_slab_t *slab;
+    mdb_row_t      *row;
+    uint8_t        *p;
+    void           *ptr;
+    int             i;
+
+    slab = MDB_LIST_RELOCATE(mdb_row_slab_t, link, pool->slabs.next);
+
+    if (MDB_DLIST_EMPTY(pool->slabs) || !slab->free) {
+        if (posix_memalign(&ptr, pool->slabsize, pool->slabsize) != 0) {
+            errno = ENOMEM;
+            return NULL;
+        }
+
+        slab = ptr;
+        slab->free  = NULL;
+        slab->nused = 0;
+
+        for (i = pool->nrow, p = (uint8_t *)slab->rows;  i > 0;  i--) {
+            row = (mdb_row_t *)(p + pool->rowsize * (i - 1));
+            row->link.next = (mdb_dlist_t *)slab->free;
+            slab->free = row;
+        }
+
+        MDB_DLIST_PREPEND(mdb_row_slab_t, link, slab, &pool->slabs);
+        pool->nempty++;
+    }
+
+    row = slab->free;
+    slab->free = (mdb_row_t *)row->link.next;
+
+    if (slab->nused++ == 0)
+        pool->nempty--;
+
+    if (!slab->free) {           /* full, move it behind the free ones */
+        MDB_DLIST_UNLINK(mdb_row_slab_t, link, slab);
+        MDB_DLIST_APPEND(mdb_row_slab_t, link, slab, &pool->slabs);
+    }
+
+    memset(row, 0, pool->rowsize);
+
+    return row;
+}
+
+static void row_free(mdb_row_pool_t *pool, mdb_row_t *row)
+{
+    mdb_row_slab_t *slab = ROW_SLAB(pool, row);
+
+    if (!slab->free) {          /* was full, move it to the free ones */
+        MDB_DLIST_UNLINK(mdb_row_slab_t, link, slab);
+        MDB_DLIST_PREPEND(mdb_row_slab_t, link, slab, &pool->slabs);
+    }
+
+    row->link.next = (mdb_dlist_t *)slab->free;
+    slab->free = row;
+
+    if (--slab->nused == 0) {
+        if (pool->nempty >= ROW_EMPTY_MAX) {
+            MDB_DLIST_UNLINK(mdb_row_slab_t, link, slab);
+            free(slab);
+        }
+        else
+            pool->nempty++;
+    }
+}
+
+
 /*
  * Local Variables:
  * c-basic-offset: 4
@@ -34,13 +34,25 @@
 #include <murphy-db/list.h>
 #include <murphy-db/mdb.h>
 
-typedef struct mdb_row_s mdb_row_t;
+typedef struct mdb_row_s      mdb_row_t;
+typedef struct mdb_row_slab_s mdb_row_slab_t;
 
 struct mdb_row_s {
     mdb_dlist_t  link;
     uint8_t      data[0];
 };
 
+typedef struct {
+    mdb_dlist_t     slabs;      /* row slabs, ones with free rows first */
+    int             slabsize;   /* size (and alignment) of a slab */
+    int             rowsize;    /* aligned size of a row incl. its data */
+    int             nrow;       /* number of rows per slab */
+    int             nempty;     /* number of slabs without used rows */
+} mdb_row_pool_t;
+
+void mdb_row_pool_init(mdb_row_pool_t *, int);
+void mdb_row_pool_destroy(mdb_row_pool_t *);
+
 mdb_row_t *mdb_row_create(mdb_table_t *);
 mdb_row_t *mdb_row_duplicate(mdb_table_t *, mdb_row_t *);
 int mdb_row_delete(mdb_table_t *, mdb_row_t *, int, int);
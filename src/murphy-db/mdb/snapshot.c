@@ -0,0 +1,375 @@
+/*
+ * Copyright (c) 2012, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <limits.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include <murphy-db/macros.h>
+#include "row.h"
+#include "table.h"
+#include "column.h"
+
+/*
+ * A table snapshot is a header, followed by a column directory and the
+ * column names, followed by one array per column. Each array holds the
+ * column of all the rows in their in-row format (ie. varchars are fixed
+ * length and nul padded), starting at an 8 byte aligned file offset.
+ * Snapshots are in the native byte order and are meant to be mmap'd.
+ */
+
+#define SNAPSHOT_MAGIC      "MDBSNAP"
+#define SNAPSHOT_VERSION    1
+#define SNAPSHOT_BYTEORDER  0x01020304
+#define SNAPSHOT_ALIGN(o)   (((o) + 7) & ~((uint64_t)7))
+
+typedef struct {
+    char     magic[8];
+    uint32_t version;
+    uint32_t byteorder;
+    uint32_t ncolumn;
+    uint32_t nrow;
+} snapshot_header_t;
+
+typedef struct {
+    uint32_t type;
+    uint32_t length;            /* length of a column entry */
+    uint32_t name;              /* file offset of the column name */
+    uint32_t unused;
+    uint64_t data;              /* file offset of the column array */
+} snapshot_column_t;
+
+
+static int write_data(FILE *, const void *, size_t);
+static int write_padding(FILE *, uint64_t, uint64_t);
+static int map_columns(mdb_table_t *, void *, size_t, int *, mqi_bitfld_t *);
+
+
+int mdb_table_save_snapshot(mdb_table_t *tbl, const char *path)
+{
+    snapshot_header_t  hdr;
+    snapshot_column_t  scol;
+    mdb_column_t      *col;
+    mdb_row_t         *row;
+    FILE              *fp;
+    char               tmp[PATH_MAX];
+    uint64_t           names, offs, data;
+    uint32_t           nrow;
+    int                i, error;
+
+    MDB_CHECKARG(tbl && path, -1);
+
+    if (snprintf(tmp, sizeof(tmp), "%s.tmp", path) >= (int)sizeof(tmp)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+
+    if (!(fp = fopen(tmp, "w")))
+        return -1;
+
+    nrow = 0;
+    MDB_DLIST_FOR_EACH(mdb_row_t, link, row, &tbl->rows)
+        nrow++;
+
+    memset(&hdr, 0, sizeof(hdr));
+    strcpy(hdr.magic, SNAPSHOT_MAGIC);
+    hdr.version   = SNAPSHOT_VERSION;
+    hdr.byteorder = SNAPSHOT_BYTEORDER;
+    hdr.ncolumn   = tbl->ncolumn;
+    hdr.nrow      = nrow;
+
+    if (write_data(fp, &hdr, sizeof(hdr)) < 0)
+        goto failed;
+
+    names = sizeof(hdr) + sizeof(scol) * tbl->ncolumn;
+
+    for (i = 0, offs = names;  i < tbl->ncolumn;  i++)
+        offs += strlen(tbl->columns[i].name) + 1;
+
+    for (i = 0, data = SNAPSHOT_ALIGN(offs);  i < tbl->ncolumn;  i++) {
+        col = tbl->columns + i;
+
+        memset(&scol, 0, sizeof(scol));
+        scol.type   = col->type;
+        scol.length = col->length;
+        scol.name   = names;
+        scol.data   = data;
+
+        names += strlen(col->name) + 1;
+        data   = SNAPSHOT_ALIGN(data + (uint64_t)col->length * nrow);
+
+        if (write_data(fp, &scol, sizeof(scol)) < 0)
+            goto failed;
+    }
+
+    for (i = 0;  i < tbl->ncolumn;  i++) {
+        col = tbl->columns + i;
+
+        if (write_data(fp, col->name, strlen(col->name) + 1) < 0)
+            goto failed;
+    }
+
+    for (i = 0;  i < tbl->ncolumn;  i++) {
+        col = tbl->columns + i;
+
+        if (write_padding(fp, offs, SNAPSHOT_ALIGN(offs)) < 0)
+            goto failed;
+
+        offs = SNAPSHOT_ALIGN(offs);
+
+        MDB_DLIST_FOR_EACH(mdb_row_t, link, row, &tbl->rows) {
+            if (write_data(fp, row->data + col->offset, col->length) < 0)
+                goto failed;
+        }
+
+        offs += (uint64_t)col->length * nrow;
+    }
+
+    if (fflush(fp) != 0 || fsync(fileno(fp)) < 0)
+        goto failed;
+
+    if (fclose(fp) != 0) {
+        fp = NULL;
+        goto failed;
+    }
+
+    if (rename(tmp, path) < 0) {
+        error = errno;
+        unlink(tmp);
+        errno = error;
+        return -1;
+    }
+
+    return nrow;
+
+ failed:
+    error = errno;
+    if (fp)
+        fclose(fp);
+    unlink(tmp);
+    errno = error;
+    return -1;
+}
+
+
+int mdb_table_load_snapshot(mdb_table_t *tbl, const char *path)
+{
+    snapshot_header_t *hdr;
+    snapshot_column_t *scol;
+    mdb_column_t      *col;
+    mdb_row_t        **rows;
+    struct stat        st;
+    void              *map;
+    size_t             size;
+    int                cidx[MQI_COLUMN_MAX];
+    mqi_bitfld_t       cmask;
+    uint8_t           *src;
+    uint32_t           nrow, r;
+    int                fd, i, n, error;
+
+    MDB_CHECKARG(tbl && path, -1);
+
+    if ((fd = open(path, O_RDONLY)) < 0)
+        return -1;
+
+    if (fstat(fd, &st) < 0) {
+        error = errno;
+        close(fd);
+        errno = error;
+        return -1;
+    }
+
+    if ((size = st.st_size) < sizeof(snapshot_header_t)) {
+        close(fd);
+        errno = EINVAL;
+        return -1;
+    }
+
+    map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    error = errno;
+    close(fd);
+
+    if (map == MAP_FAILED) {
+        errno = error;
+        return -1;
+    }
+
+    hdr  = map;
+    scol = (snapshot_column_t *)(hdr + 1);
+    nrow = hdr->nrow;
+    rows = NULL;
+
+    if (map_columns(tbl, map, size, cidx, &cmask) < 0)
+        goto failed;
+
+    if (!nrow) {
+        munmap(map, size);
+        return 0;
+    }
+
+    if (!(rows = malloc(sizeof(rows[0]) * nrow))) {
+        errno = ENOMEM;
+        goto failed;
+    }
+
+    for (r = 0;  r < nrow;  r++) {
+        if (!(rows[r] = mdb_row_create(tbl))) {
+            while (r-- > 0)
+                mdb_row_delete(tbl, rows[r], 0, 1);
+            errno = ENOMEM;
+            goto failed;
+        }
+    }
+
+    for (i = 0;  i < (int)hdr->ncolumn;  i++) {
+        col = tbl->columns + cidx[i];
+        src = (uint8_t *)map + scol[i].data;
+
+        for (r = 0;  r < nrow;  r++, src += col->length) {
+            memcpy(rows[r]->data + col->offset, src, col->length);
+
+            if (col->type == mqi_varchar)
+                rows[r]->data[col->offset + col->length - 1] = '\0';
+        }
+    }
+
+    munmap(map, size);
+
+    n = mdb_table_insert_rows(tbl, rows, nrow, cmask);
+
+    free(rows);
+
+    return n;
+
+ failed:
+    error = errno;
+    free(rows);
+    munmap(map, size);
+    errno = error;
+    return -1;
+}
+
+
+static int write_data(FILE *fp, const void *data, size_t size)
+{
+    if (size > 0 && fwrite(data, size, 1, fp) != 1) {
+        if (!errno)
+            errno = EIO;
+        return -1;
+    }
+
+    return 0;
+}
+
+static int write_padding(FILE *fp, uint64_t offs, uint64_t aligned)
+{
+    static const uint8_t zeros[8];
+
+    return write_data(fp, zeros, aligned - offs);
+}
+
+/*
+ * Check the snapshot header and directory against the table, and map
+ * every snapshot column to the table column of the same name, type and
+ * length. Table columns missing from the snapshot are left zeroed.
+ */
+static int map_columns(mdb_table_t  *tbl,
+                       void         *map,
+                       size_t        size,
+                       int          *cidx,
+                       mqi_bitfld_t *cmask)
+{
+    snapshot_header_t *hdr  = map;
+    snapshot_column_t *scol = (snapshot_column_t *)(hdr + 1);
+    mdb_column_t      *col;
+    char              *name;
+    uint64_t           end;
+    int                i;
+
+    if (memcmp(hdr->magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) ||
+        hdr->version   != SNAPSHOT_VERSION                          ||
+        hdr->byteorder != SNAPSHOT_BYTEORDER                        ||
+        hdr->ncolumn   <  1                                         ||
+        hdr->ncolumn   >  (uint32_t)MQI_COLUMN_MAX                  ||
+        sizeof(*hdr) + sizeof(*scol) * hdr->ncolumn > size           )
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    for (i = 0, *cmask = 0;  i < (int)hdr->ncolumn;  i++) {
+        if (scol[i].name >= size ||
+            !memchr((char *)map + scol[i].name, '\0', size - scol[i].name))
+        {
+            errno = EINVAL;
+            return -1;
+        }
+
+        name = (char *)map + scol[i].name;
+        end  = scol[i].data + (uint64_t)scol[i].length * hdr->nrow;
+
+        if ((cidx[i] = mdb_table_get_column_index(tbl, name)) < 0 ||
+            (*cmask & (((mqi_bitfld_t)1) << cidx[i]))              ||
+            end < scol[i].data || end > size                        )
+        {
+            errno = EINVAL;
+            return -1;
+        }
+
+        col = tbl->columns + cidx[i];
+
+        if (scol[i].type != (uint32_t)col->type ||
+            scol[i].length != (uint32_t)col->length)
+        {
+            errno = EINVAL;
+            return -1;
+        }
+
+        *cmask |= ((mqi_bitfld_t)1) << cidx[i];
+    }
+
+    return 0;
+}
+
+
+/*
+ * Local Variables:
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ *
+ */
@@ -37,12 +37,13 @@
 
 #include <murphy-db/macros.h>
 #include <murphy-db/handle.h>
-#include <murphy-db/sequence.h>
+#include <murphy-db/btree.h>
 #include "table.h"
 #include "row.h"
 #include "table.h"
 #include "cond.h"
 #include "transaction.h"
+#include "wal.h"
 
 #define TABLE_STATISTICS
 
@@ -52,6 +53,17 @@ typedef struct {
     void        *cursor;
 } table_iterator_t;
 
+struct mdb_select_cursor_s {
+    mdb_table_t       *tbl;
+    uint32_t           generation;  /* of tbl when the cursor was opened */
+    mqi_cond_entry_t  *cond;        /* private copy, NULL for all rows */
+    mdb_cond_t        *cc;
+    int                ranged;
+    mdb_btree_range_t  range;
+    table_iterator_t   it;
+    mqi_column_desc_t  cds[0];
+};
+
 
 static mdb_hash_t *table_hash;
 static int         table_count;
@@ -61,6 +73,7 @@ static mdb_row_t *table_iterator(mdb_table_t *, table_iterator_t *);
 #if 0
 static int table_print_info(mdb_table_t *, char *, int);
 #endif
+static int select_plan(mdb_table_t *, mqi_cond_entry_t *,mdb_btree_range_t *);
 static int select_conditional(mdb_table_t *, mqi_cond_entry_t *,
                               mqi_column_desc_t *,void *, int, int);
 static int select_all(mdb_table_t *, mqi_column_desc_t  *, void *, int, int);
@@ -73,6 +86,8 @@ static int update_single_row(mdb_table_t *, mdb_row_t *, mqi_column_desc_t *,
 static int delete_conditional(mdb_table_t *, mqi_cond_entry_t *);
 static int delete_all(mdb_table_t *);
 static int delete_single_row(mdb_table_t *, mdb_row_t *, int);
+static int cursor_check(mdb_table_t *, mdb_select_cursor_t *);
+static mdb_row_t *cursor_next_row(mdb_select_cursor_t *);
 
 
 mdb_table_t *mdb_table_create(char *name,
@@ -178,6 +193,7 @@ mdb_table_t *mdb_table_create(char *name,
     tbl->dlgh      = dlgh;
 
     MDB_DLIST_INIT(tbl->rows);
+    mdb_row_pool_init(&tbl->rpool, dlgh);
     mdb_log_create(tbl);
     mdb_trigger_init(&tbl->trigger, ncolumn);
 
@@ -214,6 +230,7 @@ int mdb_table_drop(mdb_table_t *tbl)
     mdb_trigger_reset(&tbl->trigger, tbl->ncolumn);
 
     mdb_transaction_drop_table(tbl);
+    mdb_wal_detach(tbl);
 
     mdb_hash_delete(table_hash, 0,tbl->name);
 
@@ -260,6 +277,22 @@ int mdb_table_create_index(mdb_table_t *tbl, char **index_columns)
     return 0;
 }
 
+int mdb_table_create_secondary_index(mdb_table_t *tbl,
+                                     char        *name,
+                                     char       **index_columns)
+{
+    MDB_CHECKARG(tbl && name && index_columns && index_columns[0], -1);
+
+    return mdb_index_create_secondary(tbl, name, index_columns);
+}
+
+int mdb_table_drop_secondary_index(mdb_table_t *tbl, char *name)
+{
+    MDB_CHECKARG(tbl && name, -1);
+
+    return mdb_index_drop_secondary(tbl, name);
+}
+
 
 int mdb_table_describe(mdb_table_t *tbl, mqi_column_def_t *defs, int len)
 {
@@ -333,6 +366,81 @@ int mdb_table_insert(mdb_table_t        *tbl,
     return ninsert;
 }
 
+/*
+ * Insert rows in bulk. Unlike with mdb_table_insert() the indices are
+ * built only once all the rows are in place. Rows with a duplicate key
+ * are dropped, and the insertion fails with EEXIST after having added
+ * all the others.
+ */
+int mdb_table_bulk_insert(mdb_table_t        *tbl,
+                          mqi_column_desc_t  *cds,
+                          void              **data)
+{
+    mdb_row_t   **rows;
+    mqi_bitfld_t  cmask;
+    int           nrow;
+    int           n, i;
+
+    MDB_CHECKARG(tbl && cds && data && data[0], -1);
+
+    for (nrow = 0;  data[nrow];  nrow++)
+        ;
+
+    if (!(rows = malloc(sizeof(rows[0]) * nrow))) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    for (i = 0, cmask = 0;  i < nrow;  i++) {
+        if (!(rows[i] = mdb_row_create(tbl))) {
+            while (--i >= 0)
+                mdb_row_delete(tbl, rows[i], 0, 1);
+            free(rows);
+            errno = ENOMEM;
+            return -1;
+        }
+
+        mdb_row_update(tbl, rows[i], cds, data[i], 0, &cmask);
+    }
+
+    n = mdb_table_insert_rows(tbl, rows, nrow, cmask);
+
+    free(rows);
+
+    return n;
+}
+
+/*
+ * Index and log freshly created and filled in rows. This is the common
+ * tail of bulk inserts and snapshot loading.
+ */
+int mdb_table_insert_rows(mdb_table_t   *tbl,
+                          mdb_row_t    **rows,
+                          int            nrow,
+                          mqi_bitfld_t   cmask)
+{
+    uint32_t txdepth = mdb_transaction_get_depth();
+    int      ninsert;
+    int      i;
+
+    if ((ninsert = mdb_index_bulk_insert(tbl, rows, nrow)) < 0)
+        return -1;
+
+    tbl->nrow += ninsert;
+
+    for (i = 0;  i < ninsert;  i++) {
+        if (mdb_log_change(tbl,txdepth,mdb_log_insert,cmask,NULL,rows[i]) < 0)
+            return -1;
+    }
+
+    if (ninsert < nrow) {
+        errno = EEXIST;
+        return -1;
+    }
+
+    return ninsert;
+}
+
 int mdb_table_select(mdb_table_t       *tbl,
                      mqi_cond_entry_t  *cond,
                      mqi_column_desc_t *cds,
@@ -355,6 +463,113 @@ int mdb_table_select(mdb_table_t       *tbl,
     return ndata;
 }
 
+/*
+ * Select cursors stream the result of a select instead of copying all
+ * of it in one go. A cursor works on a private copy of the condition
+ * with the variables bound at open time. Any change to the rows or the
+ * indices of the table invalidates the cursor: the next call to fetch
+ * rows fails with ESTALE. Until then row references returned by
+ * mdb_table_select_cursor_next_ref() point directly to the row data.
+ */
+mdb_select_cursor_t *mdb_table_select_cursor_open(mdb_table_t       *tbl,
+                                                  mqi_cond_entry_t  *cond,
+                                                  mqi_column_desc_t *cds)
+{
+    mdb_select_cursor_t *cur;
+    int                  ncd;
+
+    MDB_CHECKARG(tbl, NULL);
+
+    for (ncd = 0;  cds && cds[ncd].cindex >= 0;  ncd++)
+        ;
+
+    if (!(cur = calloc(1, sizeof(*cur) + sizeof(cds[0]) * (ncd + 1)))) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    if (ncd > 0)
+        memcpy(cur->cds, cds, sizeof(cds[0]) * ncd);
+
+    cur->cds[ncd].cindex = -1;
+    cur->cds[ncd].offset = -1;
+
+    if (cond) {
+        if (!(cur->cond = mdb_cond_duplicate(cond))) {
+            free(cur);
+            return NULL;
+        }
+
+        cur->cc     = mdb_cond_compile(tbl, cur->cond);
+        cur->ranged = select_plan(tbl, cur->cond, &cur->range);
+    }
+
+    cur->tbl        = tbl;
+    cur->generation = tbl->generation;
+
+    return cur;
+}
+
+int mdb_table_select_cursor_next(mdb_table_t         *tbl,
+                                 mdb_select_cursor_t *cur,
+                                 void                *results,
+                                 int                  size,
+                                 int                  dim)
+{
+    mdb_column_t      *columns;
+    mdb_row_t         *row;
+    mqi_column_desc_t *cd;
+    void              *result;
+    int                nresult;
+
+    MDB_CHECKARG(cur && results && size > 0 && dim > 0, -1);
+
+    if (cursor_check(tbl, cur) < 0)
+        return -1;
+
+    columns = tbl->columns;
+
+    for (nresult = 0;  nresult < dim && (row = cursor_next_row(cur)); ) {
+        result = results + (size * nresult++);
+
+        for (cd = cur->cds;  cd->cindex >= 0;  cd++)
+            mdb_column_read(cd, result, columns + cd->cindex, row->data);
+    }
+
+    return nresult;
+}
+
+int mdb_table_select_cursor_next_ref(mdb_table_t          *tbl,
+                                     mdb_select_cursor_t  *cur,
+                                     const void          **refs,
+                                     int                   dim)
+{
+    mdb_row_t *row;
+    int        nref;
+
+    MDB_CHECKARG(cur && refs && dim > 0, -1);
+
+    if (cursor_check(tbl, cur) < 0)
+        return -1;
+
+    for (nref = 0;  nref < dim && (row = cursor_next_row(cur));  nref++)
+        refs[nref] = row->data;
+
+    return nref;
+}
+
+void mdb_table_select_cursor_close(mdb_select_cursor_t *cur)
+{
+    if (cur) {
+        if (!cur->ranged && cur->it.indexed)
+            mdb_btree_cursor_destroy(NULL, &cur->it.cursor);
+
+        mdb_cond_free(cur->cc);
+        free(cur->cond);
+        free(cur);
+    }
+}
+
 int mdb_table_select_by_index(mdb_table_t *tbl,
                               mqi_variable_t *idxvars,
                               mqi_column_desc_t *cds,
@@ -398,7 +613,7 @@ int mdb_table_update(mdb_table_t       *tbl,
                      void              *data)
 {
     int           index_update = 0;
-    mdb_column_t *col;
+    mqi_bitfld_t  icols;
     int           cindex;
     int           nupdate;
     int           i;
@@ -406,10 +621,9 @@ int mdb_table_update(mdb_table_t       *tbl,
     MDB_CHECKARG(tbl, -1);
 
 
-    if (MDB_TABLE_HAS_INDEX(tbl)) {
+    if ((icols = mdb_index_columns(tbl))) {
         for (i = 0;   (cindex = cds[i].cindex) >= 0;    i++) {
-            col = tbl->columns + cindex;
-            if ((col->flags & MQI_COLUMN_KEY)) {
+            if ((icols & (((mqi_bitfld_t)1) << cindex))) {
                 index_update = 1;
                 break;
             }
@@ -482,6 +696,13 @@ int mdb_table_get_column_size(mdb_table_t *tbl, int colidx)
     return tbl->columns[colidx].length;
 }
 
+int mdb_table_get_column_offset(mdb_table_t *tbl, int colidx)
+{
+    MDB_CHECKARG(tbl && colidx >= 0 && colidx < tbl->ncolumn, -1);
+
+    return tbl->columns[colidx].offset;
+}
+
 uint32_t mdb_table_get_stamp(mdb_table_t *tbl)
 {
     return tbl->cnt.stamp;
@@ -526,7 +747,6 @@ int mdb_table_print_rows(mdb_table_t *tbl, char *buf, int len)
 
 static void destroy_table(mdb_table_t *tbl)
 {
-    mdb_row_t    *row, *n;
     mdb_column_t *cols;
     int           i;
 
@@ -534,8 +754,7 @@ static void destroy_table(mdb_table_t *tbl)
 
     mdb_hash_table_destroy(tbl->chash);
 
-    MDB_DLIST_FOR_EACH_SAFE(mdb_row_t, link, row,n, &tbl->rows)
-        mdb_row_delete(tbl, row, 0, 1);
+    mdb_row_pool_destroy(&tbl->rpool);
 
     for (i = 0, cols = tbl->columns;   i < tbl->ncolumn;    i++)
         free(cols[i].name);
@@ -556,7 +775,7 @@ static mdb_row_t *table_iterator(mdb_table_t *tbl, table_iterator_t *it)
         it->indexed = MDB_TABLE_HAS_INDEX(tbl);
 
     if (it->indexed)
-        row = mdb_sequence_iterate(tbl->index.sequence, &it->cursor);
+        row = mdb_btree_iterate(tbl->index.btree, &it->cursor);
     else {
         head = &tbl->rows;
         next = it->cursor ? (mdb_dlist_t *)it->cursor : head->next;
@@ -611,6 +830,44 @@ static int table_print_info(mdb_table_t *tbl, char *buf, int len)
 #endif
 
 
+/*
+ * Pick the index that narrows down the rows to look at the most for
+ * cond. On a tie the primary index wins, then the one created first.
+ */
+static int select_plan(mdb_table_t       *tbl,
+                       mqi_cond_entry_t  *cond,
+                       mdb_btree_range_t *range)
+{
+    mdb_btree_range_t  r;
+    int                best, score;
+    int                i;
+
+    best = mdb_index_range(&tbl->index, cond, range);
+
+    for (i = 0;  i < tbl->nsindex;  i++) {
+        if ((score = mdb_index_range(tbl->sindexes + i, cond, &r)) > best) {
+            best   = score;
+            *range = r;
+        }
+    }
+
+    return best > 0;
+}
+
+/*
+ * Evaluate cond for a row, using the compiled condition cc if we have one.
+ */
+static inline int cond_match(mdb_table_t      *tbl,
+                             mdb_cond_t       *cc,
+                             mqi_cond_entry_t *cond,
+                             void             *data)
+{
+    if (cc)
+        return mdb_cond_match(cc, data);
+    else
+        return mdb_cond_evaluate(tbl, &cond, data);
+}
+
 static int select_conditional(mdb_table_t       *tbl,
                               mqi_cond_entry_t  *cond,
                               mqi_column_desc_t *cds,
@@ -620,18 +877,29 @@ static int select_conditional(mdb_table_t       *tbl,
 {
     mdb_column_t      *columns = tbl->columns;
     mdb_row_t         *row;
-    mqi_cond_entry_t  *ce;
+    mdb_cond_t        *cc;
     table_iterator_t   it;
+    mdb_btree_range_t  range;
+    int                ranged;
     int                nresult;
     void              *result;
     mqi_column_desc_t *result_dsc;
     int                cindex;
     int                i;
 
-    for (it.cursor = NULL, nresult = 0;  (row = table_iterator(tbl, &it)); ) {
-        ce = cond;
-        if (mdb_cond_evaluate(tbl, &ce, row->data)) {
+    /* if cond bounds an index column scan only the rows within bounds */
+    ranged = select_plan(tbl, cond, &range);
+    cc     = mdb_cond_compile(tbl, cond);
+
+    for (it.cursor = NULL, nresult = 0;
+         (row = ranged ? mdb_btree_range_next(&range):table_iterator(tbl,&it));
+         )
+    {
+        if (cond_match(tbl, cc, cond, row->data)) {
             if (nresult >= dim) {
+                if (!ranged && it.indexed)
+                    mdb_btree_cursor_destroy(tbl->index.btree, &it.cursor);
+                mdb_cond_free(cc);
                 errno = EOVERFLOW;
                 return -1;
             }
@@ -643,9 +911,38 @@ static int select_conditional(mdb_table_t       *tbl,
         }
     }
 
+    mdb_cond_free(cc);
+
     return nresult;
 }
 
+static int cursor_check(mdb_table_t *tbl, mdb_select_cursor_t *cur)
+{
+    if (tbl != cur->tbl || tbl->generation != cur->generation) {
+        errno = ESTALE;
+        return -1;
+    }
+
+    return 0;
+}
+
+static mdb_row_t *cursor_next_row(mdb_select_cursor_t *cur)
+{
+    mdb_table_t *tbl = cur->tbl;
+    mdb_row_t   *row;
+
+    for (;;) {
+        if (cur->ranged)
+            row = mdb_btree_range_next(&cur->range);
+        else
+            row = table_iterator(tbl, &cur->it);
+
+        if (!row || !cur->cond || cond_match(tbl, cur->cc, cur->cond,
+                                              row->data))
+            return row;
+    }
+}
+
 static int select_all(mdb_table_t       *tbl,
                       mqi_column_desc_t *cds,
                       void              *results,
@@ -705,13 +1002,14 @@ static int update_conditional(mdb_table_t       *tbl,
                               int                index_update)
 {
     mdb_row_t        *row;
-    mqi_cond_entry_t *ce;
+    mdb_cond_t       *cc;
     table_iterator_t  it;
     int               nupdate, changed;
 
+    cc = mdb_cond_compile(tbl, cond);
+
     for (it.cursor = NULL, nupdate = 0;  (row = table_iterator(tbl, &it)); ) {
-        ce = cond;
-        if (mdb_cond_evaluate(tbl, &ce, row->data)) {
+        if (cond_match(tbl, cc, cond, row->data)) {
             changed = update_single_row(tbl, row, cds, data, index_update);
 
             if (changed < 0)
@@ -721,6 +1019,8 @@ static int update_conditional(mdb_table_t       *tbl,
         }
     }
 
+    mdb_cond_free(cc);
+
     return nupdate;
 }
 
@@ -760,7 +1060,8 @@ static int update_single_row(mdb_table_t       *tbl,
     mqi_bitfld_t cmask;
     int          changed;
 
-    if (txdepth > 0 && !(before = mdb_row_duplicate(tbl, row)))
+    if ((txdepth > 0 || tbl->persistent) &&
+        !(before = mdb_row_duplicate(tbl, row)))
         return -1;
 
     changed = mdb_row_update(tbl, row, cds, data, index_update, &cmask);
@@ -771,22 +1072,26 @@ static int update_single_row(mdb_table_t       *tbl,
     }
 
     if (mdb_log_change(tbl, txdepth, mdb_log_update, cmask, before, row) < 0)
-        return -1;
+        changed = -1;
 
-    return 1;
+    if (!txdepth && before)
+        mdb_row_delete(tbl, before, 0, 1);
+
+    return changed < 0 ? -1 : 1;
 }
 
 static int delete_conditional(mdb_table_t *tbl, mqi_cond_entry_t *cond)
 {
     table_iterator_t  it;
     mdb_row_t        *row;
-    mqi_cond_entry_t *ce;
+    mdb_cond_t       *cc;
     int               ndelete;
 
+    cc = mdb_cond_compile(tbl, cond);
+
     for (it.cursor = NULL, ndelete = 0; (row = table_iterator(tbl, &it)); )
     {
-        ce = cond;
-        if (mdb_cond_evaluate(tbl, &ce, row->data)) {
+        if (cond_match(tbl, cc, cond, row->data)) {
             if (delete_single_row(tbl, row, 1) < 0)
                 ndelete = -1;
             else
@@ -794,6 +1099,8 @@ static int delete_conditional(mdb_table_t *tbl, mqi_cond_entry_t *cond)
         }
     }
 
+    mdb_cond_free(cc);
+
     return ndelete;
 }
 
@@ -819,6 +1126,9 @@ static int delete_single_row(mdb_table_t *tbl, mdb_row_t *row,int index_update)
 {
     uint32_t txdepth = mdb_transaction_get_depth();
 
+    if (!txdepth && tbl->persistent)
+        mdb_log_change(tbl, txdepth, mdb_log_delete, 0, row, NULL);
+
     mdb_row_delete(tbl, row, index_update, !txdepth);
 
     if (txdepth)
@@ -44,17 +44,24 @@ struct mdb_table_s {
     mqi_handle_t  handle;
     char         *name;
     mdb_index_t   index;
+    int           nsindex;      /* number of secondary indices */
+    mdb_index_t  *sindexes;     /* secondary, non-unique indices */
     mdb_hash_t   *chash;         /* hash table for column names */
     int           ncolumn;
     mdb_column_t *columns;
     int           dlgh;          /* length of row data */
     int           nrow;
     mdb_dlist_t   rows;
+    mdb_row_pool_t rpool;       /* row slabs */
+    uint32_t      generation;   /* bumped whenever rows or indices change */
     mdb_dlist_t   logs;         /* transaction logs */
     mdb_opcnt_t   cnt;
+    bool          persistent;   /* changes go to the write-ahead log */
     mdb_trigger_t trigger;      /* must be the last: it has a array[0] @end  */
 };
 
+int mdb_table_insert_rows(mdb_table_t *, mdb_row_t **, int, mqi_bitfld_t);
+
 
 #endif /* __MDB_TABLE_H__ */
 
@@ -40,6 +40,7 @@
 #include "log.h"
 #include "index.h"
 #include "table.h"
+#include "wal.h"
 
 #define TRANSACTION_STATISTICS
 
@@ -85,6 +86,12 @@ int mdb_transaction_commit(uint32_t depth)
 
     MDB_CHECKARG(depth > 0 && depth == txdepth, -1);
 
+    if (mdb_wal_commit(depth) < 0)
+        sts = -1;
+
+    if (mdb_trigger_changesets(depth, &start_triggered) < 0)
+        sts = -1;
+
     MDB_TRANSACTION_LOG_FOR_EACH_DELETE(depth, en, MDB_BACKWARD, cursor) {
 
         if (!(before = en->before))
@@ -116,7 +123,6 @@ int mdb_transaction_commit(uint32_t depth)
 
         case mdb_log_start:
             check_stamp(en);
-            free(en->cnt);
             s = 0;
             break;
 
@@ -229,6 +235,7 @@ static int add_row(mdb_table_t *tbl, mdb_row_t *row)
     MDB_DLIST_APPEND(mdb_row_t, link, row, &tbl->rows);
 
     tbl->cnt.deletes--;
+    tbl->generation++;
 
     return mdb_index_insert(tbl, row, 0, 0);
 }
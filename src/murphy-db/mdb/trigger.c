@@ -52,6 +52,8 @@ typedef struct column_trigger_s   column_trigger_t;
 typedef struct row_trigger_s      row_trigger_t;
 typedef struct table_trigger_s    table_trigger_t;
 typedef struct transact_trigger_s transact_trigger_t;
+typedef struct changeset_trigger_s changeset_trigger_t;
+typedef struct pending_s          pending_t;
 
 struct callback_s {
     mqi_trigger_cb_t  function;
@@ -86,6 +88,23 @@ struct transact_trigger_s {
     callback_t   callback;
 };
 
+struct changeset_trigger_s {
+    mdb_dlist_t link;
+    callback_t  callback;
+    select_t    select;
+};
+
+struct pending_s {
+    mdb_table_t      *table;    /* the table the change is about */
+    int               group;    /* order of the first change of table */
+    int               seq;      /* order of the change in the log */
+    mdb_row_t        *row;      /* the row the change is about */
+    mdb_row_t        *before;
+    mdb_row_t        *after;
+    mqi_event_type_t  event;    /* mqi_event_unknown if cancelled out */
+    mqi_bitfld_t      colmask;
+};
+
 
 static int8_t lowest_bit_in[256] = {
     /*         0   1   2   3   4   5   6   7   8   9   A   B   C   D   E   F */
@@ -116,6 +135,10 @@ static int get_select_params(mdb_table_t *, mqi_column_desc_t *, int *, int *);
 static void row_change(mqi_event_type_t, mdb_table_t *, mdb_row_t *);
 static void table_change(mqi_event_type_t, mdb_table_t *);
 static void transaction_change(mqi_event_type_t, uint32_t);
+static int changeset_add(pending_t **, int *, int *, mdb_log_entry_t *,
+                         int);
+static int changeset_cmp(const void *, const void *);
+static int changeset_flush(mdb_table_t *, pending_t *, int);
 
 
 void mdb_trigger_init(mdb_trigger_t *trigger, int ncol)
@@ -126,6 +149,7 @@ void mdb_trigger_init(mdb_trigger_t *trigger, int ncol)
         return;
 
     MDB_DLIST_INIT(trigger->row_change);
+    MDB_DLIST_INIT(trigger->changeset);
 
     for (i = 0;  i < ncol;  i++)
         MDB_DLIST_INIT(trigger->column_change[i]);
@@ -135,6 +159,7 @@ void mdb_trigger_reset(mdb_trigger_t *trigger, int ncol)
 {
     row_trigger_t *rt, *n;
     column_trigger_t *ct, *m;
+    changeset_trigger_t *st, *o;
     mdb_dlist_t *head;
     int i;
 
@@ -146,6 +171,13 @@ void mdb_trigger_reset(mdb_trigger_t *trigger, int ncol)
         free(rt);
     }
 
+    head = &trigger->changeset;
+
+    MDB_DLIST_FOR_EACH_SAFE(changeset_trigger_t, link, st,o, head) {
+        MDB_DLIST_UNLINK(changeset_trigger_t, link, st);
+        free(st);
+    }
+
     for (i = 0;  i < ncol;  i++) {
         head = trigger-> column_change + i;
 
@@ -322,6 +354,90 @@ int mdb_trigger_delete_row_callback(mdb_table_t      *tbl,
 }
 
 
+int mdb_trigger_add_changeset_callback(mdb_table_t       *tbl,
+                                       mqi_trigger_cb_t   cb_function,
+                                       void              *cb_data,
+                                       mqi_column_desc_t *cds)
+{
+    changeset_trigger_t *tr;
+    size_t cdsiz;
+    int length, ncd;
+    mdb_dlist_t *head;
+
+    MDB_CHECKARG(tbl && cb_function, -1);
+
+    if (!cds)
+        ncd = length = 0;
+    else {
+        if (get_select_params(tbl, cds, &ncd, &length) < 0) {
+            errno = EINVAL;
+            return -1;
+        }
+    }
+
+    cdsiz = sizeof(mqi_column_desc_t) * ncd;
+    head  = &tbl->trigger.changeset;
+
+    MDB_DLIST_FOR_EACH(changeset_trigger_t, link, tr, head) {
+        if (cb_function == tr->callback.function &&
+            cb_data == tr->callback.user_data)
+        {
+            if (cdsiz == tr->select.cdsiz) {
+                if (!cdsiz || !memcmp(cds, tr->select.column, cdsiz))
+                    return 0; /* silently ignore multiple registrations */
+            }
+
+            errno = EEXIST;
+            return -1;
+        }
+    }
+
+    if (!(tr = calloc(1, sizeof(changeset_trigger_t) + cdsiz))) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    MDB_DLIST_APPEND(changeset_trigger_t, link, tr, head);
+
+    tr->callback.function = cb_function;
+    tr->callback.user_data = cb_data;
+
+    tr->select.length = length;
+    tr->select.cdsiz = cdsiz;
+
+    if (ncd > 0)
+        memcpy(tr->select.column, cds, cdsiz);
+
+    return 0;
+}
+
+
+int mdb_trigger_delete_changeset_callback(mdb_table_t      *tbl,
+                                          mqi_trigger_cb_t  cb_function,
+                                          void             *cb_data)
+{
+    changeset_trigger_t *tr, *n;
+    mdb_dlist_t *head;
+
+    MDB_CHECKARG(tbl && cb_function, -1);
+
+    head = &tbl->trigger.changeset;
+
+    MDB_DLIST_FOR_EACH_SAFE(changeset_trigger_t, link, tr,n, head) {
+        if (cb_function == tr->callback.function &&
+            cb_data == tr->callback.user_data)
+        {
+            MDB_DLIST_UNLINK(changeset_trigger_t, link, tr);
+            free(tr);
+            return 0;
+        }
+    }
+
+    errno = ENOENT;
+    return -1;
+}
+
+
 int mdb_trigger_add_table_callback(mqi_trigger_cb_t  cb_function,
                                    void             *cb_data)
 {
@@ -524,6 +640,99 @@ void mdb_trigger_transaction_end(uint32_t depth)
     transaction_change(mqi_transaction_end, depth);
 }
 
+/*
+ * Deliver a single changeset per table to the changeset triggers of
+ * the tables touched by the transaction being committed. Changes of
+ * the same row are coalesced: an insert followed by updates shows up
+ * as an insert of the final row, repeated updates as one update with
+ * the original before image and the union of the column masks, and
+ * an insert followed by a delete not at all. The log keeps the changes
+ * of a transaction per table, but should they ever come interleaved
+ * they are grouped by table first, so that each table still gets a
+ * single changeset, in the order the tables were first touched. Must
+ * be called before the log entries of the transaction are consumed.
+ */
+int mdb_trigger_changesets(uint32_t depth, bool *start_triggered)
+{
+    mdb_log_entry_t  *en;
+    mdb_table_t     **tables, **t, *tbl;
+    pending_t        *pending;
+    void             *cursor;
+    int               npending, size, ntable, group, first, i, sts;
+    bool              interleaved;
+
+    tables   = NULL;
+    pending  = NULL;
+    npending = size = ntable = 0;
+    group    = -1;
+    tbl      = NULL;
+    sts      = 0;
+
+    interleaved = false;
+
+    /* run the iteration to the end even on failure to free the cursor */
+    MDB_TRANSACTION_LOG_FOR_EACH(depth, en, MDB_BACKWARD, cursor) {
+        if (sts < 0 || en->change == mdb_log_start ||
+            MDB_DLIST_EMPTY(en->table->trigger.changeset))
+            continue;
+
+        if (en->table != tbl) {
+            tbl = en->table;
+
+            for (group = 0;  group < ntable;  group++) {
+                if (tables[group] == tbl)
+                    break;
+            }
+
+            if (group < ntable)
+                interleaved = true;
+            else {
+                if (!(t = realloc(tables, sizeof(t[0]) * (ntable + 1)))) {
+                    sts = -1;
+                    continue;
+                }
+
+                tables = t;
+                tables[ntable++] = tbl;
+            }
+        }
+
+        if (changeset_add(&pending, &npending, &size, en, group) < 0)
+            sts = -1;
+    }
+
+    free(tables);
+
+    if (sts < 0) {
+        free(pending);
+        errno = ENOMEM;
+        return -1;
+    }
+
+    if (interleaved)
+        qsort(pending, npending, sizeof(pending[0]), changeset_cmp);
+
+    for (first = 0;  first < npending;  first = i) {
+        for (i = first + 1;  i < npending;  i++) {
+            if (pending[i].table != pending[first].table)
+                break;
+        }
+
+        if (!*start_triggered) {
+            *start_triggered = true;
+            mdb_trigger_transaction_start(depth);
+        }
+
+        if (changeset_flush(pending[first].table, pending + first,
+                            i - first) < 0)
+            sts = -1;
+    }
+
+    free(pending);
+
+    return sts;
+}
+
 static int get_select_params(mdb_table_t       *tbl,
                              mqi_column_desc_t *cds,
                              int               *ncd_ret,
@@ -583,6 +792,179 @@ static void row_change(mqi_event_type_t  event,
     }
 }
 
+static int changeset_add(pending_t       **pendingp,
+                         int              *npendingp,
+                         int              *sizep,
+                         mdb_log_entry_t  *en,
+                         int               group)
+{
+    pending_t *pending = *pendingp;
+    pending_t *p;
+    int        size;
+
+    if (*npendingp >= *sizep) {
+        size = *sizep ? *sizep * 2 : 64;
+
+        if (!(pending = realloc(pending, sizeof(pending_t) * size)))
+            return -1;
+
+        *pendingp = pending;
+        *sizep    = size;
+    }
+
+    p = pending + *npendingp;
+
+    p->table   = en->table;
+    p->group   = group;
+    p->seq     = (*npendingp)++;
+    p->row     = en->change == mdb_log_delete ? en->before : en->after;
+    p->before  = en->change == mdb_log_insert ? NULL : en->before;
+    p->after   = en->change == mdb_log_delete ? NULL : en->after;
+    p->colmask = en->colmask;
+
+    switch (en->change) {
+    case mdb_log_insert:  p->event = mqi_row_inserted;    break;
+    case mdb_log_delete:  p->event = mqi_row_deleted;     break;
+    default:              p->event = mqi_column_changed;  break;
+    }
+
+    return 0;
+}
+
+static int changeset_cmp(const void *a, const void *b)
+{
+    const pending_t *p = a, *q = b;
+
+    if (p->group != q->group)
+        return p->group - q->group;
+
+    return p->seq - q->seq;
+}
+
+static int changeset_flush(mdb_table_t *tbl, pending_t *pending, int n)
+{
+    mqi_event_t            evt;
+    mqi_changeset_event_t *ce;
+    mqi_row_change_t      *changes, *c;
+    changeset_trigger_t   *tr;
+    pending_t             *p, *q, **hash;
+    uint8_t               *data;
+    size_t                 hsize, h;
+    int                    nchange, length, i, k, sx;
+
+    for (hsize = 16;  hsize < (size_t)n * 2;  hsize <<= 1)
+        ;
+
+    if (!(hash = calloc(hsize, sizeof(hash[0]))))
+        goto nomem;
+
+    memset(&evt, 0, sizeof(evt));
+    ce = &evt.changeset;
+
+    ce->event = mqi_table_changed;
+
+    ce->table.handle = tbl->handle;
+    ce->table.name   = tbl->name;
+
+    /* coalesce changes of the same row into its first change */
+    for (i = 0;  i < n;  i++) {
+        p = pending + i;
+        h = ((size_t)p->row >> 4) & (hsize - 1);
+
+        while ((q = hash[h]) && q->row != p->row)
+            h = (h + 1) & (hsize - 1);
+
+        if (!q) {
+            hash[h] = p;
+            continue;
+        }
+
+        if (p->event == mqi_row_deleted) {
+            if (q->event == mqi_row_inserted)
+                q->event = mqi_event_unknown;
+            else {
+                q->event = mqi_row_deleted;
+                q->after = NULL;
+            }
+        }
+        else
+            q->colmask |= p->colmask;
+
+        p->event = mqi_event_unknown;
+    }
+
+    free(hash);
+
+    for (i = 0, nchange = 0;  i < n;  i++) {
+        switch (pending[i].event) {
+        case mqi_row_inserted:    ce->ninsert++;  break;
+        case mqi_row_deleted:     ce->ndelete++;  break;
+        case mqi_column_changed:  ce->nupdate++;  break;
+        default:                                  continue;
+        }
+        nchange++;
+    }
+
+    if (!nchange)
+        return 0;
+
+    if (!(changes = calloc(nchange, sizeof(changes[0]))))
+        goto nomem;
+
+    ce->nchange = nchange;
+    ce->changes = changes;
+
+    MDB_DLIST_FOR_EACH(changeset_trigger_t, link, tr, &tbl->trigger.changeset){
+        length = (tr->select.length + 7) & ~7; /* keep the rows aligned */
+        data   = NULL;
+
+        if (length > 0 && !(data = calloc(nchange * 2, length))) {
+            free(changes);
+            goto nomem;
+        }
+
+        for (i = 0, c = changes;  i < n;  i++) {
+            if ((p = pending + i)->event == mqi_event_unknown)
+                continue;
+
+            c->event   = p->event;
+            c->colmask = p->colmask;
+            c->before  = NULL;
+            c->after   = NULL;
+
+            if (data) {
+                if (p->before)
+                    c->before = data + (c - changes) * 2 * length;
+                if (p->after)
+                    c->after  = data + ((c - changes) * 2 + 1) * length;
+
+                for (k = 0;  (sx = tr->select.column[k].cindex) >= 0;  k++) {
+                    if (c->before)
+                        mdb_column_read(tr->select.column + k, c->before,
+                                        tbl->columns + sx, p->before->data);
+                    if (c->after)
+                        mdb_column_read(tr->select.column + k, c->after,
+                                        tbl->columns + sx, p->after->data);
+                }
+            }
+
+            c++;
+        }
+
+        tr->callback.function(&evt, tr->callback.user_data);
+
+        free(data);
+    }
+
+    free(changes);
+
+    return 0;
+
+ nomem:
+    errno = ENOMEM;
+    return -1;
+}
+
 static void table_change(mqi_event_type_t event, mdb_table_t *tbl)
 {
     mqi_event_t        evt;
@@ -37,6 +37,7 @@
 
 typedef struct {
     mdb_dlist_t   row_change;
+    mdb_dlist_t   changeset;
     mdb_dlist_t   column_change[0];
 } mdb_trigger_t;
 
@@ -55,6 +56,8 @@ void mdb_trigger_table_drop(mdb_table_t *);
 void mdb_trigger_transaction_start(uint32_t);
 void mdb_trigger_transaction_end(uint32_t);
 
+int mdb_trigger_changesets(uint32_t, bool *);
+
 #endif /* __MDB_TRIGGER_H__ */
 
 /*
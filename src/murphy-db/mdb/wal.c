@@ -0,0 +1,772 @@
+/*
+ * Copyright (c) 2012, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <limits.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <string.h>
+#include <stdbool.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include <murphy-db/macros.h>
+#include "wal.h"
+#include "row.h"
+#include "index.h"
+#include "table.h"
+#include "log.h"
+
+/*
+ * The write-ahead log is a header followed by checksummed records, one
+ * per committed transaction (or per change done outside transactions)
+ * touching persistent tables. Every entry of a record carries the name
+ * of the table and the before and/or after image of the changed row as
+ * it was at commit time. Replay is idempotent enough to cope with that:
+ * an update or delete whose before image can't be found is skipped, as
+ * a later image of the same row has then already been applied.
+ *
+ * Records are written at commit but fdatasync()'d only every sync_batch
+ * commits or on mdb_wal_sync(), so a crash loses at most the commits of
+ * the last unsynced batch. A torn record at the end of the log is cut
+ * off when the log is opened.
+ *
+ * A record that fails to get written is cut off right away, so that the
+ * records of later commits don't end up behind a torn one, where the
+ * next open would throw them away. The changes of the failed commit are
+ * lost from the log. If the log can't be cut back, it is marked failed
+ * and refuses any further records until it is compacted or reopened.
+ *
+ * Compaction saves a snapshot of every persistent table and starts a
+ * new, empty log with the next epoch. Snapshots are named after the log
+ * and the epoch they belong to, so a crash half way through compaction
+ * leaves the previous, consistent log and snapshots in place.
+ */
+
+#define WAL_MAGIC         "MDBWAL"
+#define WAL_VERSION       1
+#define WAL_BYTEORDER     0x01020304
+#define WAL_RECORD_MAGIC  0x5752444d        /* 'MDRW' */
+#define WAL_RECORD_MAX    (64 * 1024 * 1024)
+#define WAL_ALIGN(n)      (((n) + 3) & ~3)
+
+typedef struct {
+    char     magic[8];
+    uint32_t version;
+    uint32_t byteorder;
+    uint64_t epoch;
+} wal_header_t;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t length;            /* length of the payload */
+    uint32_t crc;               /* crc32 of the payload */
+    uint32_t nentry;
+} wal_record_t;
+
+typedef struct {
+    uint16_t     type;          /* mdb_log_type_t */
+    uint16_t     nlen;          /* length of the table name incl. '\0' */
+    uint32_t     dlgh;          /* length of the row images */
+    mqi_bitfld_t colmask;
+    uint32_t     size;          /* size of the entry incl. this header */
+} wal_entry_t;
+
+typedef struct {
+    int           fd;
+    char         *path;
+    uint64_t      epoch;
+    int           sync_batch;   /* commits per fdatasync(), 0: explicit */
+    int           pending;      /* commits since the last fdatasync() */
+    bool          failed;       /* torn record we could not cut off */
+    uint8_t      *buf;          /* record being built */
+    size_t        size;
+    size_t        used;
+    uint32_t      nentry;
+    mdb_table_t **tables;       /* persistent tables */
+    int           ntable;
+} wal_t;
+
+
+static int record_add(mdb_table_t *, mdb_log_type_t, mqi_bitfld_t,
+                      mdb_row_t *, mdb_row_t *);
+static int record_write(void);
+static off_t record_read(int, off_t, uint8_t **, size_t *, uint32_t *);
+static int replay(mdb_table_t *);
+static int replay_entry(mdb_table_t *, wal_entry_t *);
+static mdb_row_t *find_row(mdb_table_t *, uint8_t *);
+static int write_header(int, uint64_t);
+static int write_all(int, const void *, size_t);
+static int sync_dir(const char *);
+static void snapshot_path(char *, size_t, mdb_table_t *, uint64_t);
+static uint32_t crc32(const uint8_t *, size_t);
+
+static wal_t wal = { .fd = -1 };
+
+
+int mdb_wal_open(const char *path, int sync_batch)
+{
+    wal_header_t hdr;
+    struct stat  st;
+    uint8_t     *buf;
+    size_t       size;
+    off_t        offs, next;
+    int          fd, error;
+
+    MDB_CHECKARG(path && sync_batch >= 0, -1);
+    MDB_PREREQUISITE(wal.fd < 0, -1);
+
+    if ((fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644)) < 0)
+        return -1;
+
+    if (fstat(fd, &st) < 0)
+        goto failed;
+
+    if (st.st_size == 0) {
+        if (write_header(fd, 1) < 0 || fdatasync(fd) < 0)
+            goto failed;
+
+        hdr.epoch = 1;
+        offs      = sizeof(hdr);
+    }
+    else {
+        if (pread(fd, &hdr, sizeof(hdr), 0) != sizeof(hdr) ||
+            memcmp(hdr.magic, WAL_MAGIC, sizeof(WAL_MAGIC))  ||
+            hdr.version   != WAL_VERSION                     ||
+            hdr.byteorder != WAL_BYTEORDER                    )
+        {
+            errno = EINVAL;
+            goto failed;
+        }
+
+        buf  = NULL;
+        size = 0;
+
+        for (offs = sizeof(hdr);  ;  offs = next) {
+            if ((next = record_read(fd, offs, &buf, &size, NULL)) <= 0)
+                break;
+        }
+
+        free(buf);
+
+        /* cut off whatever is left of a torn record */
+        if (offs < st.st_size && ftruncate(fd, offs) < 0)
+            goto failed;
+    }
+
+    if (lseek(fd, offs, SEEK_SET) < 0 || !(wal.path = strdup(path)))
+        goto failed;
+
+    wal.fd         = fd;
+    wal.epoch      = hdr.epoch;
+    wal.sync_batch = sync_batch;
+    wal.pending    = 0;
+
+    return 0;
+
+ failed:
+    error = errno;
+    close(fd);
+    errno = error;
+    return -1;
+}
+
+int mdb_wal_close(void)
+{
+    int i, sts;
+
+    if (wal.fd < 0)
+        return 0;
+
+    sts = mdb_wal_sync();
+
+    for (i = 0;  i < wal.ntable;  i++)
+        wal.tables[i]->persistent = false;
+
+    close(wal.fd);
+    free(wal.path);
+    free(wal.buf);
+    free(wal.tables);
+
+    memset(&wal, 0, sizeof(wal));
+    wal.fd = -1;
+
+    return sts;
+}
+
+int mdb_wal_attach(mdb_table_t *tbl)
+{
+    mdb_table_t **tables;
+    char          path[PATH_MAX];
+
+    MDB_CHECKARG(tbl, -1);
+    MDB_PREREQUISITE(wal.fd >= 0 && !mdb_transaction_get_depth(), -1);
+
+    if (tbl->persistent)
+        return 0;
+
+    tables = realloc(wal.tables, sizeof(tables[0]) * (wal.ntable + 1));
+
+    if (!tables) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    wal.tables = tables;
+
+    snapshot_path(path, sizeof(path), tbl, wal.epoch);
+
+    if (mdb_table_load_snapshot(tbl, path) < 0 && errno != ENOENT)
+        return -1;
+
+    if (replay(tbl) < 0)
+        return -1;
+
+    wal.tables[wal.ntable++] = tbl;
+    tbl->persistent = true;
+
+    return 0;
+}
+
+void mdb_wal_detach(mdb_table_t *tbl)
+{
+    int i;
+
+    if (!tbl || !tbl->persistent)
+        return;
+
+    for (i = 0;  i < wal.ntable;  i++) {
+        if (wal.tables[i] == tbl) {
+            memmove(wal.tables + i, wal.tables + i + 1,
+                    sizeof(wal.tables[0]) * (wal.ntable - i - 1));
+            wal.ntable--;
+            break;
+        }
+    }
+
+    tbl->persistent = false;
+}
+
+int mdb_wal_sync(void)
+{
+    if (wal.fd < 0 || !wal.pending)
+        return 0;
+
+    if (fdatasync(wal.fd) < 0)
+        return -1;
+
+    wal.pending = 0;
+
+    return 0;
+}
+
+int mdb_wal_compact(void)
+{
+    char     path[PATH_MAX];
+    char     tmp[PATH_MAX];
+    uint64_t epoch;
+    int      fd, i, error, synced;
+
+    MDB_PREREQUISITE(wal.fd >= 0 && !mdb_transaction_get_depth(), -1);
+
+    epoch = wal.epoch + 1;
+
+    for (i = 0;  i < wal.ntable;  i++) {
+        snapshot_path(path, sizeof(path), wal.tables[i], epoch);
+
+        if (mdb_table_save_snapshot(wal.tables[i], path) < 0)
+            goto failed;
+    }
+
+    snprintf(tmp, sizeof(tmp), "%s.tmp", wal.path);
+
+    if ((fd = open(tmp, O_RDWR|O_CREAT|O_TRUNC|O_CLOEXEC, 0644)) < 0)
+        goto failed;
+
+    if (write_header(fd, epoch) < 0 || fdatasync(fd) < 0 ||
+        rename(tmp, wal.path) < 0)
+    {
+        error = errno;
+        close(fd);
+        unlink(tmp);
+        errno = error;
+        goto failed;
+    }
+
+    /*
+     * The new log is in place now, so we have to switch to it even if
+     * we fail to make the rename durable. In that case we keep the old
+     * snapshots around, as a crash might still bring the old log back.
+     */
+
+    synced = (sync_dir(wal.path) == 0);
+    error  = errno;
+
+    close(wal.fd);
+
+    wal.fd      = fd;
+    wal.pending = 0;
+    wal.failed  = false;
+
+    if (synced) {
+        for (i = 0;  i < wal.ntable;  i++) {
+            snapshot_path(path, sizeof(path), wal.tables[i], wal.epoch);
+            unlink(path);
+        }
+    }
+
+    wal.epoch = epoch;
+
+    if (!synced) {
+        errno = error;
+        return -1;
+    }
+
+    return 0;
+
+ failed:
+    error = errno;
+    while (--i >= 0) {
+        snapshot_path(path, sizeof(path), wal.tables[i], epoch);
+        unlink(path);
+    }
+    errno = error;
+    return -1;
+}
+
+
+int mdb_wal_commit(uint32_t depth)
+{
+    mdb_log_entry_t *en;
+    void            *cursor;
+    int              sts;
+
+    if (wal.fd < 0 || !wal.ntable)
+        return 0;
+
+    sts = 0;
+
+    MDB_TRANSACTION_LOG_FOR_EACH(depth, en, MDB_BACKWARD, cursor) {
+        if (en->change == mdb_log_start || !en->table->persistent)
+            continue;
+
+        if (record_add(en->table, en->change, en->colmask,
+                       en->before, en->after) < 0)
+            sts = -1;
+    }
+
+    if (record_write() < 0)
+        sts = -1;
+
+    return sts;
+}
+
+int mdb_wal_change(mdb_table_t    *tbl,
+                   mdb_log_type_t  type,
+                   mqi_bitfld_t    colmask,
+                   mdb_row_t      *before,
+                   mdb_row_t      *after)
+{
+    if (wal.fd < 0 || !tbl->persistent)
+        return 0;
+
+    if (record_add(tbl, type, colmask, before, after) < 0)
+        return -1;
+
+    return record_write();
+}
+
+
+static int record_add(mdb_table_t    *tbl,
+                      mdb_log_type_t  type,
+                      mqi_bitfld_t    colmask,
+                      mdb_row_t      *before,
+                      mdb_row_t      *after)
+{
+    wal_entry_t *en;
+    uint8_t     *buf, *p;
+    size_t       nlen, dlgh, size, need;
+
+    if (!wal.used)
+        wal.used = sizeof(wal_record_t);
+
+    nlen = strlen(tbl->name) + 1;
+    dlgh = tbl->dlgh;
+    size = sizeof(*en) + WAL_ALIGN(nlen) +
+        (before ? WAL_ALIGN(dlgh) : 0) + (after ? WAL_ALIGN(dlgh) : 0);
+
+    if ((need = wal.used + size) > wal.size) {
+        if (!(buf = realloc(wal.buf, need * 2))) {
+            errno = ENOMEM;
+            return -1;
+        }
+
+        wal.buf  = buf;
+        wal.size = need * 2;
+    }
+
+    p  = wal.buf + wal.used;
+    en = (wal_entry_t *)p;
+
+    memset(p, 0, size);
+
+    en->type    = type;
+    en->nlen    = nlen;
+    en->dlgh    = dlgh;
+    en->colmask = colmask;
+    en->size    = size;
+
+    p = (uint8_t *)(en + 1);
+    memcpy(p, tbl->name, nlen);
+    p += WAL_ALIGN(nlen);
+
+    if (type != mdb_log_insert) {
+        memcpy(p, before->data, dlgh);
+        p += WAL_ALIGN(dlgh);
+    }
+
+    if (type != mdb_log_delete)
+        memcpy(p, after->data, dlgh);
+
+    wal.used += size;
+    wal.nentry++;
+
+    return 0;
+}
+
+static int record_write(void)
+{
+    wal_record_t *rec;
+    off_t         offs;
+    int           sts, error;
+
+    if (!wal.nentry) {
+        wal.used = 0;
+        return 0;
+    }
+
+    if (wal.failed) {
+        errno = EIO;
+        goto dropped;
+    }
+
+    if ((offs = lseek(wal.fd, 0, SEEK_CUR)) < 0)
+        goto dropped;
+
+    rec = (wal_record_t *)wal.buf;
+
+    rec->magic  = WAL_RECORD_MAGIC;
+    rec->length = wal.used - sizeof(*rec);
+    rec->nentry = wal.nentry;
+    rec->crc    = crc32((uint8_t *)(rec + 1), rec->length);
+
+    sts = write_all(wal.fd, wal.buf, wal.used);
+
+    wal.used   = 0;
+    wal.nentry = 0;
+
+    if (sts < 0) {
+        /* cut off the partially written record */
+        error = errno;
+
+        if (ftruncate(wal.fd, offs) < 0 || lseek(wal.fd, offs, SEEK_SET) < 0)
+            wal.failed = true;
+
+        errno = error;
+        return -1;
+    }
+
+    if (++wal.pending >= wal.sync_batch && wal.sync_batch > 0)
+        return mdb_wal_sync();
+
+    return 0;
+
+ dropped:
+    wal.used   = 0;
+    wal.nentry = 0;
+    return -1;
+}
+
+/*
+ * Read and verify the record at offs. Returns the offset of the next
+ * record, or 0 if there is no (intact) record at offs.
+ */
+static off_t record_read(int        fd,
+                         off_t      offs,
+                         uint8_t  **bufp,
+                         size_t    *sizep,
+                         uint32_t  *nentry)
+{
+    wal_record_t  rec;
+    uint8_t      *buf;
+
+    if (pread(fd, &rec, sizeof(rec), offs) != sizeof(rec))
+        return 0;
+
+    if (rec.magic != WAL_RECORD_MAGIC || rec.length > WAL_RECORD_MAX)
+        return 0;
+
+    if (rec.length > *sizep) {
+        if (!(buf = realloc(*bufp, rec.length)))
+            return 0;
+
+        *bufp  = buf;
+        *sizep = rec.length;
+    }
+
+    if (pread(fd, *bufp, rec.length, offs + sizeof(rec)) != rec.length ||
+        crc32(*bufp, rec.length) != rec.crc)
+        return 0;
+
+    if (nentry)
+        *nentry = rec.nentry;
+
+    return offs + sizeof(rec) + rec.length;
+}
+
+static int replay(mdb_table_t *tbl)
+{
+    wal_entry_t *en;
+    uint8_t     *buf, *p, *e;
+    size_t       size;
+    uint32_t     nentry, i;
+    off_t        offs, next;
+    int          sts;
+
+    buf = NULL;
+    size = 0;
+    sts = 0;
+
+    for (offs = sizeof(wal_header_t);  sts == 0;  offs = next) {
+        if ((next = record_read(wal.fd, offs, &buf, &size, &nentry)) <= 0)
+            break;
+
+        p = buf;
+        e = buf + (next - offs - sizeof(wal_record_t));
+
+        for (i = 0;  i < nentry;  i++, p += en->size) {
+            en = (wal_entry_t *)p;
+
+            if (p + sizeof(*en) > e || en->size < sizeof(*en) ||
+                p + en->size > e)
+            {
+                errno = EINVAL;
+                sts = -1;
+                break;
+            }
+
+            if (!strncmp((char *)(en + 1), tbl->name, en->nlen)) {
+                if (replay_entry(tbl, en) < 0) {
+                    sts = -1;
+                    break;
+                }
+            }
+        }
+    }
+
+    free(buf);
+
+    return sts;
+}
+
+static int replay_entry(mdb_table_t *tbl, wal_entry_t *en)
+{
+    mdb_row_t *row, *tmp;
+    uint8_t   *before, *after;
+
+    if (en->dlgh != (uint32_t)tbl->dlgh) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    before = (uint8_t *)(en + 1) + WAL_ALIGN(en->nlen);
+    after  = before;
+
+    if (en->type == mdb_log_update)
+        after = before + WAL_ALIGN(en->dlgh);
+
+    switch (en->type) {
+    case mdb_log_insert:
+        if (!(row = mdb_row_create(tbl)))
+            return -1;
+
+        memcpy(row->data, after, tbl->dlgh);
+
+        if (mdb_index_insert(tbl, row, 0, 0) > 0)
+            tbl->nrow++;
+        return 0;
+
+    case mdb_log_delete:
+        if ((row = find_row(tbl, before)))
+            return mdb_row_delete(tbl, row, 1, 1);
+        return 0;
+
+    case mdb_log_update:
+        if (!(row = find_row(tbl, before)))
+            return 0;
+
+        if (!(tmp = mdb_row_duplicate(tbl, row)))
+            return -1;
+
+        memcpy(tmp->data, after, tbl->dlgh);
+
+        if (mdb_row_copy_over(tbl, row, tmp) < 0) {
+            mdb_row_delete(tbl, tmp, 0, 1);
+            return -1;
+        }
+
+        return mdb_row_delete(tbl, tmp, 0, 1);
+
+    default:
+        errno = EINVAL;
+        return -1;
+    }
+}
+
+static mdb_row_t *find_row(mdb_table_t *tbl, uint8_t *image)
+{
+    mdb_index_t *ix = &tbl->index;
+    mdb_row_t   *row;
+
+    if (MDB_TABLE_HAS_INDEX(tbl)) {
+        row = mdb_index_get_row(tbl, ix->length, image + ix->offset);
+
+        if (row && !memcmp(row->data, image, tbl->dlgh))
+            return row;
+
+        return NULL;
+    }
+
+    MDB_DLIST_FOR_EACH(mdb_row_t, link, row, &tbl->rows) {
+        if (!memcmp(row->data, image, tbl->dlgh))
+            return row;
+    }
+
+    return NULL;
+}
+
+static int write_header(int fd, uint64_t epoch)
+{
+    wal_header_t hdr;
+
+    memset(&hdr, 0, sizeof(hdr));
+    strcpy(hdr.magic, WAL_MAGIC);
+    hdr.version   = WAL_VERSION;
+    hdr.byteorder = WAL_BYTEORDER;
+    hdr.epoch     = epoch;
+
+    return write_all(fd, &hdr, sizeof(hdr));
+}
+
+static int write_all(int fd, const void *data, size_t size)
+{
+    const uint8_t *p = data;
+    ssize_t        n;
+
+    while (size > 0) {
+        if ((n = write(fd, p, size)) < 0) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+
+        p    += n;
+        size -= n;
+    }
+
+    return 0;
+}
+
+static int sync_dir(const char *path)
+{
+    char  dir[PATH_MAX];
+    char *slash;
+    int   fd, sts, error;
+
+    if (snprintf(dir, sizeof(dir), "%s", path) >= (int)sizeof(dir)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+
+    if (!(slash = strrchr(dir, '/')))
+        strcpy(dir, ".");
+    else if (slash == dir)
+        dir[1] = '\0';
+    else
+        *slash = '\0';
+
+    if ((fd = open(dir, O_RDONLY|O_DIRECTORY|O_CLOEXEC)) < 0)
+        return -1;
+
+    sts   = fsync(fd);
+    error = errno;
+    close(fd);
+    errno = error;
+
+    return sts;
+}
+
+static void snapshot_path(char *buf, size_t size, mdb_table_t *tbl,
+                          uint64_t epoch)
+{
+    snprintf(buf, size, "%s.%s.%llu", wal.path, tbl->name,
+             (unsigned long long)epoch);
+}
+
+static uint32_t crc32(const uint8_t *data, size_t size)
+{
+    static uint32_t table[256];
+    uint32_t        crc, c;
+    int             i, j;
+
+    if (!table[1]) {
+        for (i = 0;  i < 256;  i++) {
+            for (c = i, j = 0;  j < 8;  j++)
+                c = (c & 1) ? 0xedb88320 ^ (c >> 1) : c >> 1;
+            table[i] = c;
+        }
+    }
+
+    for (crc = 0xffffffff;  size > 0;  size--)
+        crc = table[(crc ^ *data++) & 0xff] ^ (crc >> 8);
+
+    return crc ^ 0xffffffff;
+}
+
+
+/*
+ * Local Variables:
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ *
+ */
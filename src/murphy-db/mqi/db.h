@@ -37,10 +37,13 @@ typedef struct {
                               mqi_column_desc_t *);
     int (*create_column_trigger)(void *, int, mqi_trigger_cb_t, void *,
                                  mqi_column_desc_t *);
+    int (*create_changeset_trigger)(void *, mqi_trigger_cb_t, void *,
+                                    mqi_column_desc_t *);
     int (*drop_transaction_trigger)(mqi_trigger_cb_t, void *);
     int (*drop_table_trigger)(mqi_trigger_cb_t, void *);
     int (*drop_row_trigger)(void *, mqi_trigger_cb_t, void *);
     int (*drop_column_trigger)(void *, int, mqi_trigger_cb_t, void *);
+    int (*drop_changeset_trigger)(void *, mqi_trigger_cb_t, void *);
     uint32_t (*begin_transaction)(void);
     int (*commit_transaction)(uint32_t);
     int (*rollback_transaction)(uint32_t);
@@ -48,13 +51,21 @@ typedef struct {
     void *(*create_table)(char *, char **, mqi_column_def_t *);
     int (*register_table_handle)(void *, mqi_handle_t);
     int (*create_index)(void *, char **);
+    int (*create_secondary_index)(void *, char *, char **);
+    int (*drop_secondary_index)(void *, char *);
     int (*drop_table)(void *);
     int (*describe)(void *, mqi_column_def_t *, int);
     int (*insert_into)(void *, int, mqi_column_desc_t *, void **);
+    int (*bulk_insert)(void *, mqi_column_desc_t *, void **);
     int (*select)(void *, mqi_cond_entry_t *, mqi_column_desc_t *,
                   void *, int, int);
     int (*select_by_index)(void *, mqi_variable_t *,
                            mqi_column_desc_t *, void *);
+    void *(*select_cursor_open)(void *, mqi_cond_entry_t *,
+                                mqi_column_desc_t *);
+    int (*select_cursor_next)(void *, void *, void *, int, int);
+    int (*select_cursor_next_ref)(void *, void *, const void **, int);
+    void (*select_cursor_close)(void *);
     int (*update)(void *, mqi_cond_entry_t *, mqi_column_desc_t *,void*);
     int (*delete_from)(void *, mqi_cond_entry_t *);
     void *(*find_table)(char *);
@@ -64,7 +75,11 @@ typedef struct {
     char *(*get_column_name)(void *, int);
     mqi_data_type_t (*get_column_type)(void *, int);
     int (*get_column_size)(void *, int);
+    int (*get_column_offset)(void *, int);
     int (*print_rows)(void *, char *, int);
+    int (*save_snapshot)(void *, const char *);
+    int (*load_snapshot)(void *, const char *);
+    int (*persist_table)(void *);
 } mqi_db_functbl_t;
 
 
@@ -48,10 +48,13 @@ static int      create_row_trigger(void *, mqi_trigger_cb_t, void *,
                                    mqi_column_desc_t *);
 static int      create_column_trigger(void *, int, mqi_trigger_cb_t, void *,
                                       mqi_column_desc_t *);
+static int      create_changeset_trigger(void *, mqi_trigger_cb_t, void *,
+                                         mqi_column_desc_t *);
 static int      drop_transaction_trigger(mqi_trigger_cb_t, void *);
 static int      drop_table_trigger(mqi_trigger_cb_t, void *);
 static int      drop_row_trigger(void *, mqi_trigger_cb_t, void *);
 static int      drop_column_trigger(void*, int, mqi_trigger_cb_t, void *);
+static int      drop_changeset_trigger(void *, mqi_trigger_cb_t, void *);
 static uint32_t begin_transaction(void);
 static int      commit_transaction(uint32_t);
 static int      rollback_transaction(uint32_t);
@@ -59,13 +62,21 @@ static uint32_t get_transaction_id(void);
 static void *   create_table(char *, char **, mqi_column_def_t *);
 static int      register_table_handle(void *, mqi_handle_t);
 static int      create_index(void *, char **);
+static int      create_secondary_index(void *, char *, char **);
+static int      drop_secondary_index(void *, char *);
 static int      drop_table(void *);
 static int      describe(void *, mqi_column_def_t *, int);
 static int      insert_into(void *, int, mqi_column_desc_t *, void **);
+static int      bulk_insert(void *, mqi_column_desc_t *, void **);
 static int      select_general(void *, mqi_cond_entry_t *, mqi_column_desc_t *,
                                void *, int, int);
 static int      select_by_index(void *, mqi_variable_t *, mqi_column_desc_t *,
                                  void *);
+static void *   select_cursor_open(void *, mqi_cond_entry_t *,
+                                   mqi_column_desc_t *);
+static int      select_cursor_next(void *, void *, void *, int, int);
+static int      select_cursor_next_ref(void *, void *, const void **, int);
+static void     select_cursor_close(void *);
 static int      update(void *, mqi_cond_entry_t *, mqi_column_desc_t*,void*);
 static int      delete_from(void *, mqi_cond_entry_t *);
 static void *   find_table(char *);
@@ -75,17 +86,23 @@ static uint32_t get_table_stamp(void *);
 static char *   get_column_name(void *, int);
 static mqi_data_type_t get_column_type(void *, int);
 static int      get_column_size(void *, int);
+static int      get_column_offset(void *, int);
 static int      print_rows(void *, char *, int);
+static int      save_snapshot(void *, const char *);
+static int      load_snapshot(void *, const char *);
+static int      persist_table(void *);
 
 static mqi_db_functbl_t functbl = {
     create_transaction_trigger,
     create_table_trigger,
     create_row_trigger,
     create_column_trigger,
+    create_changeset_trigger,
     drop_transaction_trigger,
     drop_table_trigger,
     drop_row_trigger,
     drop_column_trigger,
+    drop_changeset_trigger,
     begin_transaction,
     commit_transaction,
     rollback_transaction,
@@ -93,11 +110,18 @@ static mqi_db_functbl_t functbl = {
     create_table,
     register_table_handle,
     create_index,
+    create_secondary_index,
+    drop_secondary_index,
     drop_table,
     describe,
     insert_into,
+    bulk_insert,
     select_general,
     select_by_index,
+    select_cursor_open,
+    select_cursor_next,
+    select_cursor_next_ref,
+    select_cursor_close,
     update,
     delete_from,
     find_table,
@@ -107,7 +131,11 @@ static mqi_db_functbl_t functbl = {
     get_column_name,
     get_column_type,
     get_column_size,
-    print_rows
+    get_column_offset,
+    print_rows,
+    save_snapshot,
+    load_snapshot,
+    persist_table
 };
 
 
@@ -145,6 +173,14 @@ static int create_column_trigger(void *t,
                                          cb, data, cds);
 }
 
+static int create_changeset_trigger(void *t,
+                                    mqi_trigger_cb_t cb,
+                                    void *data,
+                                    mqi_column_desc_t *cds)
+{
+    return mdb_trigger_add_changeset_callback((mdb_table_t *)t, cb, data,cds);
+}
+
 static int drop_transaction_trigger(mqi_trigger_cb_t cb, void *data)
 {
     return mdb_trigger_delete_transaction_callback(cb, data);
@@ -168,6 +204,11 @@ static int drop_column_trigger(void *t,
     return mdb_trigger_delete_column_callback((mdb_table_t *)t,colidx,cb,data);
 }
 
+static int drop_changeset_trigger(void *t, mqi_trigger_cb_t cb, void *data)
+{
+    return mdb_trigger_delete_changeset_callback((mdb_table_t *)t, cb, data);
+}
+
 static uint32_t begin_transaction(void)
 {
     uint32_t depth = mdb_transaction_begin();
@@ -212,6 +253,17 @@ static int create_index(void *t, char **index_columns)
     return mdb_table_create_index((mdb_table_t *)t, index_columns);
 }
 
+static int create_secondary_index(void *t, char *name, char **index_columns)
+{
+    return mdb_table_create_secondary_index((mdb_table_t *)t, name,
+                                            index_columns);
+}
+
+static int drop_secondary_index(void *t, char *name)
+{
+    return mdb_table_drop_secondary_index((mdb_table_t *)t, name);
+}
+
 static int drop_table(void *t)
 {
     return mdb_table_drop((mdb_table_t *)t);
@@ -230,6 +282,13 @@ static int insert_into(void               *t,
     return mdb_table_insert((mdb_table_t *)t, ignore, cds, data);
 }
 
+static int bulk_insert(void               *t,
+                       mqi_column_desc_t  *cds,
+                       void              **data)
+{
+    return mdb_table_bulk_insert((mdb_table_t *)t, cds, data);
+}
+
 static int select_general(void              *t,
                           mqi_cond_entry_t  *cond,
                           mqi_column_desc_t *cds,
@@ -248,6 +307,36 @@ static int select_by_index(void              *t,
     return mdb_table_select_by_index((mdb_table_t *)t, idxvars, cds, result);
 }
 
+static void *select_cursor_open(void              *t,
+                                mqi_cond_entry_t  *cond,
+                                mqi_column_desc_t *cds)
+{
+    return mdb_table_select_cursor_open((mdb_table_t *)t, cond, cds);
+}
+
+static int select_cursor_next(void *t,
+                              void *c,
+                              void *results,
+                              int   size,
+                              int   dim)
+{
+    return mdb_table_select_cursor_next((mdb_table_t *)t,
+                                        (mdb_select_cursor_t *)c,
+                                        results, size, dim);
+}
+
+static int select_cursor_next_ref(void *t, void *c, const void **refs, int dim)
+{
+    return mdb_table_select_cursor_next_ref((mdb_table_t *)t,
+                                            (mdb_select_cursor_t *)c,
+                                            refs, dim);
+}
+
+static void select_cursor_close(void *c)
+{
+    mdb_table_select_cursor_close((mdb_select_cursor_t *)c);
+}
+
 
 static int update(void              *t,
                   mqi_cond_entry_t  *cond,
@@ -299,11 +388,31 @@ static int get_column_size(void *t, int colidx)
     return  mdb_table_get_column_size((mdb_table_t *)t, colidx);
 }
 
+static int get_column_offset(void *t, int colidx)
+{
+    return  mdb_table_get_column_offset((mdb_table_t *)t, colidx);
+}
+
 static int print_rows(void *t, char *buf, int len)
 {
     return mdb_table_print_rows((mdb_table_t *)t, buf, len);
 }
 
+static int save_snapshot(void *t, const char *path)
+{
+    return mdb_table_save_snapshot((mdb_table_t *)t, path);
+}
+
+static int load_snapshot(void *t, const char *path)
+{
+    return mdb_table_load_snapshot((mdb_table_t *)t, path);
+}
+
+static int persist_table(void *t)
+{
+    return mdb_wal_attach((mdb_table_t *)t);
+}
+
 
 /*
  * Local Variables:
@@ -98,6 +98,12 @@ typedef struct {
     uint32_t txid[MAX_DB];
 } mqi_transaction_t;
 
+struct mqi_select_cursor_s {
+    mqi_handle_t      table;
+    mqi_db_functbl_t *ftb;
+    void             *cursor;
+};
+
 
 static int db_register(const char *, uint32_t, mqi_db_functbl_t *);
 
@@ -124,7 +130,7 @@ int mqi_open(void)
 
         transact_handle = MDB_HANDLE_MAP_CREATE();
 
-        if (db_register("MurphyDB", MQI_TEMPORARY, mdb_backend_init()) < 0) {
+        if (db_register("MurphyDB", MQI_ANY, mdb_backend_init()) < 0) {
             errno = EIO;
             return -1;
         }
@@ -297,6 +303,23 @@ int mqi_create_column_trigger(mqi_handle_t h,
 }
 
 
+int mqi_create_changeset_trigger(mqi_handle_t h,
+                                 mqi_trigger_cb_t callback,
+                                 void *user_data,
+                                 mqi_column_desc_t *cds)
+{
+    mqi_db_functbl_t *ftb;
+    void             *tbl;
+
+    MDB_CHECKARG(h != MDB_HANDLE_INVALID && callback, -1);
+    MDB_PREREQUISITE(dbs && ndb > 0, -1);
+
+    GET_TABLE(tbl, ftb, h, -1);
+
+    return ftb->create_changeset_trigger(tbl, callback, user_data, cds);
+}
+
+
 int mqi_drop_transaction_trigger(mqi_trigger_cb_t callback, void *user_data)
 {
     mqi_db_t         *db;
@@ -374,6 +397,22 @@ int mqi_drop_column_trigger(mqi_handle_t h,
 }
 
 
+int mqi_drop_changeset_trigger(mqi_handle_t h,
+                               mqi_trigger_cb_t callback,
+                               void *user_data)
+{
+    mqi_db_functbl_t *ftb;
+    void             *tbl;
+
+    MDB_CHECKARG(h != MDB_HANDLE_INVALID && callback, -1);
+    MDB_PREREQUISITE(dbs && ndb > 0, -1);
+
+    GET_TABLE(tbl, ftb, h, -1);
+
+    return ftb->drop_changeset_trigger(tbl, callback, user_data);
+}
+
+
 mqi_handle_t mqi_begin_transaction(void)
 {
     mqi_transaction_t *tx;
@@ -521,6 +560,9 @@ mqi_handle_t mqi_create_table(char *name,
     if (!(tbl->handle = ftb->create_table(name, index_columns, cdefs)))
         goto cleanup;
 
+    if ((flags & MQI_PERSISTENT) && ftb->persist_table(tbl->handle) < 0)
+        goto cleanup;
+
     if ((h = mdb_handle_add(table_handle, tbl)) == MQI_HANDLE_INVALID)
         goto cleanup;
 
@@ -561,6 +603,34 @@ int mqi_create_index(mqi_handle_t h, char **index_columns)
     return ftb->create_index(tbl, index_columns);
 }
 
+int mqi_create_secondary_index(mqi_handle_t h,
+                               char        *name,
+                               char       **index_columns)
+{
+    mqi_db_functbl_t *ftb;
+    void             *tbl;
+
+    MDB_CHECKARG(h != MDB_HANDLE_INVALID && name && index_columns, -1);
+    MDB_PREREQUISITE(dbs && ndb > 0, -1);
+
+    GET_TABLE(tbl, ftb, h, -1);
+
+    return ftb->create_secondary_index(tbl, name, index_columns);
+}
+
+int mqi_drop_secondary_index(mqi_handle_t h, char *name)
+{
+    mqi_db_functbl_t *ftb;
+    void             *tbl;
+
+    MDB_CHECKARG(h != MDB_HANDLE_INVALID && name, -1);
+    MDB_PREREQUISITE(dbs && ndb > 0, -1);
+
+    GET_TABLE(tbl, ftb, h, -1);
+
+    return ftb->drop_secondary_index(tbl, name);
+}
+
 int mqi_drop_table(mqi_handle_t h)
 {
     mqi_table_t      *tbl;
@@ -620,6 +690,21 @@ int mqi_insert_into(mqi_handle_t         h,
     return ftb->insert_into(tbl, ignore, cds, data);
 }
 
+int mqi_bulk_insert(mqi_handle_t        h,
+                    mqi_column_desc_t  *cds,
+                    void              **data)
+{
+    mqi_db_functbl_t *ftb;
+    void             *tbl;
+
+    MDB_CHECKARG(h != MDB_HANDLE_INVALID && cds && data && data[0], -1);
+    MDB_PREREQUISITE(dbs && ndb > 0, -1);
+
+    GET_TABLE(tbl, ftb, h, -1);
+
+    return ftb->bulk_insert(tbl, cds, data);
+}
+
 int mqi_select(mqi_handle_t       h,
                mqi_cond_entry_t  *cond,
                mqi_column_desc_t *cds,
@@ -655,6 +740,84 @@ int mqi_select_by_index(mqi_handle_t       h,
     return ftb->select_by_index(tbl, idxvars, cds, result);
 }
 
+/*
+ * Select cursors stream the rows matching cond in batches. The condition
+ * is copied, ie. its variables are bound, when the cursor is opened. If
+ * the table changes while the cursor is open fetching more rows fails
+ * with ESTALE. References from mqi_select_cursor_next_ref() point to the
+ * row data within the table and are valid until the table changes. Use
+ * mqi_get_column_offset() to locate the columns within a row.
+ */
+mqi_select_cursor_t *mqi_select_cursor_open(mqi_handle_t       h,
+                                            mqi_cond_entry_t  *cond,
+                                            mqi_column_desc_t *cds)
+{
+    mqi_select_cursor_t *cur;
+    mqi_db_functbl_t    *ftb;
+    void                *tbl;
+
+    MDB_CHECKARG(h != MDB_HANDLE_INVALID, NULL);
+    MDB_PREREQUISITE(dbs && ndb > 0, NULL);
+
+    GET_TABLE(tbl, ftb, h, NULL);
+
+    if (!(cur = calloc(1, sizeof(*cur)))) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    if (!(cur->cursor = ftb->select_cursor_open(tbl, cond, cds))) {
+        free(cur);
+        return NULL;
+    }
+
+    cur->table = h;
+    cur->ftb   = ftb;
+
+    return cur;
+}
+
+int mqi_select_cursor_next(mqi_select_cursor_t *cur,
+                           void                *rows,
+                           int                  rowsize,
+                           int                  dim)
+{
+    mqi_db_functbl_t *ftb;
+    void             *tbl;
+
+    MDB_CHECKARG(cur && rows && rowsize > 0 && dim > 0, -1);
+    MDB_PREREQUISITE(dbs && ndb > 0, -1);
+
+    GET_TABLE(tbl, ftb, cur->table, -1);
+
+    return ftb->select_cursor_next(tbl, cur->cursor, rows, rowsize, dim);
+}
+
+int mqi_select_cursor_next_ref(mqi_select_cursor_t  *cur,
+                               const void          **refs,
+                               int                   dim)
+{
+    mqi_db_functbl_t *ftb;
+    void             *tbl;
+
+    MDB_CHECKARG(cur && refs && dim > 0, -1);
+    MDB_PREREQUISITE(dbs && ndb > 0, -1);
+
+    GET_TABLE(tbl, ftb, cur->table, -1);
+
+    return ftb->select_cursor_next_ref(tbl, cur->cursor, refs, dim);
+}
+
+int mqi_select_cursor_close(mqi_select_cursor_t *cur)
+{
+    MDB_CHECKARG(cur, -1);
+
+    cur->ftb->select_cursor_close(cur->cursor);
+    free(cur);
+
+    return 0;
+}
+
 int mqi_update(mqi_handle_t       h,
                mqi_cond_entry_t  *cond,
                mqi_column_desc_t *cds,
@@ -778,6 +941,19 @@ int mqi_get_column_size(mqi_handle_t h, int colidx)
     return  ftb->get_column_size(tbl, colidx);
 }
 
+int mqi_get_column_offset(mqi_handle_t h, int colidx)
+{
+    mqi_db_functbl_t *ftb;
+    void             *tbl;
+
+    MDB_CHECKARG(h != MDB_HANDLE_INVALID && colidx >= 0, -1);
+    MDB_PREREQUISITE(dbs && ndb > 0, -1);
+
+    GET_TABLE(tbl, ftb, h, -1);
+
+    return  ftb->get_column_offset(tbl, colidx);
+}
+
 int mqi_print_rows(mqi_handle_t h, char *buf, int len)
 {
     mqi_db_functbl_t *ftb;
@@ -791,6 +967,32 @@ int mqi_print_rows(mqi_handle_t h, char *buf, int len)
     return ftb->print_rows(tbl, buf, len);
 }
 
+int mqi_save_snapshot(mqi_handle_t h, const char *path)
+{
+    mqi_db_functbl_t *ftb;
+    void             *tbl;
+
+    MDB_CHECKARG(h != MDB_HANDLE_INVALID && path, -1);
+    MDB_PREREQUISITE(dbs && ndb > 0, -1);
+
+    GET_TABLE(tbl, ftb, h, -1);
+
+    return ftb->save_snapshot(tbl, path);
+}
+
+int mqi_load_snapshot(mqi_handle_t h, const char *path)
+{
+    mqi_db_functbl_t *ftb;
+    void             *tbl;
+
+    MDB_CHECKARG(h != MDB_HANDLE_INVALID && path, -1);
+    MDB_PREREQUISITE(dbs && ndb > 0, -1);
+
+    GET_TABLE(tbl, ftb, h, -1);
+
+    return ftb->load_snapshot(tbl, path);
+}
+
 
 
 static int db_register(const char       *engine,
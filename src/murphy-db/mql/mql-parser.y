@@ -8,7 +8,6 @@
 #include <unistd.h>
 #include <string.h>
 #include <ctype.h>
-#include <alloca.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <libgen.h>
@@ -255,6 +254,9 @@ static FILE        *mqlout;
     mql_result_t *mql_result_columns_create(int, mqi_column_def_t *);
     mql_result_t *mql_result_rows_create(int, mqi_column_desc_t*,
                                          mqi_data_type_t*,int*,int,int,void*);
+    mql_result_t *mql_result_cursor_create(mqi_select_cursor_t *, int,
+                                           mqi_column_desc_t *,
+                                           mqi_data_type_t *, int);
     mql_result_t *mql_result_string_create_table_list(int, char **);
     mql_result_t *mql_result_string_create_column_change(const char *,
                                                          const char *,
@@ -462,7 +464,14 @@ create_index: TKN_INDEX {
     ncolnam = 0;
 };
 
-index_definition: TKN_ON table_name TKN_LEFT_PAREN column_list TKN_RIGHT_PAREN
+/*#toplevel#*/
+index_definition:
+  primary_index_definition
+| secondary_index_definition
+;
+
+primary_index_definition:
+  TKN_ON table_name TKN_LEFT_PAREN column_list TKN_RIGHT_PAREN
 {
     colnams[ncolnam] = NULL;
 
@@ -472,6 +481,18 @@ index_definition: TKN_ON table_name TKN_LEFT_PAREN column_list TKN_RIGHT_PAREN
         MQL_SUCCESS;
 };
 
+secondary_index_definition:
+  TKN_IDENTIFIER TKN_ON table_name TKN_LEFT_PAREN column_list TKN_RIGHT_PAREN
+{
+    colnams[ncolnam] = NULL;
+
+    if (mqi_create_secondary_index(table, $1, colnams) < 0)
+        MQL_ERROR(errno, "failed to create index '%s': %s", $1,
+                  strerror(errno));
+    else
+        MQL_SUCCESS;
+};
+
 
 /* create trigger */
 
@@ -629,8 +650,16 @@ drop_table_statement: TKN_DROP TKN_TABLE  table_name {
 /* drop index */
 
 /*#toplevel#*/
-drop_index_statement: TKN_DROP TKN_INDEX table_name {
-};
+drop_index_statement:
+  TKN_DROP TKN_INDEX table_name {
+  }
+| TKN_DROP TKN_INDEX TKN_IDENTIFIER TKN_ON table_name {
+    if (mqi_drop_secondary_index(table, $3) < 0)
+        MQL_ERROR(errno, "failed to drop index '%s': %s", $3, strerror(errno));
+    else
+        MQL_SUCCESS;
+  }
+;
 
 
 /***********************************
@@ -955,9 +984,9 @@ select_statement: select columns TKN_FROM table_name where_clause {
     int colsizes[MQI_COLUMN_MAX + 1];
     mqi_data_type_t coltypes[MQI_COLUMN_MAX + 1];
     mqi_cond_entry_t *where;
+    mqi_select_cursor_t *cursor;
     int rowsize;
     int tsiz;
-    size_t rsiz;
     void *rows;
     char errbuf[256];
     int sts;
@@ -973,25 +1002,42 @@ select_statement: select columns TKN_FROM table_name where_clause {
     if (sts < 0)
         MQL_ERROR(errno, "%s", errbuf);
 
+    where = (cond == conds) ? NULL : conds;
+
+    if (mode == mql_mode_exec && rtype == mql_result_cursor) {
+        if (!(cursor = mqi_select_cursor_open(table, where, coldescs)))
+            MQL_ERROR(errno, "select failed: %s", strerror(errno));
 
-    if (mode != mql_mode_precompile && mode != mql_mode_exec && !tsiz) {
+        result = mql_result_cursor_create(cursor, ncolnam, coldescs, coltypes,
+                                          rowsize);
+        if (!result) {
+            mqi_select_cursor_close(cursor);
+            MQL_ERROR(ENOMEM, "select failed: can't create cursor");
+        }
+    }
+    else if (mode != mql_mode_precompile && mode != mql_mode_exec && !tsiz) {
         if (mode == mql_mode_parser)
             fprintf(mqlout, "no rows\n");
     }
+    else if (mode == mql_mode_precompile) {
+        statement = mql_make_select_statement(table, rowsize,
+                                              cond - conds, where,
+                                              ncolnam, colnams, coltypes,
+                                              colsizes, coldescs); 
+    }
     else {
-        rsiz  = tsiz * rowsize;
-        rows  = alloca(rsiz);
-        where = (cond == conds) ? NULL : conds;
-
-        if (mode != mql_mode_precompile) {
-            if (tsiz != 0) {
-                if ((n = mqi_select(table, where,
-                                    coldescs, rows, rowsize, tsiz)) < 0)
-                    MQL_ERROR(errno, "select failed: %s", strerror(errno));
+        if (!(rows = malloc((tsiz ? tsiz : 1) * rowsize)))
+            MQL_ERROR(ENOMEM, "select failed: %s", strerror(ENOMEM));
+
+        if (tsiz != 0) {
+            if ((n = mqi_select(table, where,
+                                coldescs, rows, rowsize, tsiz)) < 0) {
+                free(rows);
+                MQL_ERROR(errno, "select failed: %s", strerror(errno));
             }
-            else
-                n = 0;
         }
+        else
+            n = 0;
 
         switch (mode) {
         case mql_mode_parser:
@@ -1010,13 +1056,11 @@ select_statement: select columns TKN_FROM table_name where_clause {
                                                            n, rowsize, rows);
             }
             break;
-        case mql_mode_precompile:
-            statement = mql_make_select_statement(table, rowsize,
-                                                  cond - conds, where,
-                                                  ncolnam, colnams, coltypes,
-                                                  colsizes, coldescs); 
+        default:
             break;
         }
+
+        free(rows);
     }
 };
 
@@ -1372,6 +1416,7 @@ mql_result_t *mql_exec_string(mql_result_type_t result_type, const char *str)
     MDB_CHECKARG((result_type == mql_result_event ||
                   result_type == mql_result_columns  ||
                   result_type == mql_result_rows ||
+                  result_type == mql_result_cursor ||
                   result_type == mql_result_string  ) && 
                  str, NULL);
 
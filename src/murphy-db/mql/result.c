@@ -49,6 +49,7 @@ typedef struct result_event_table_s    result_event_table_t;
 typedef struct result_event_transact_s result_event_transact_t;
 typedef struct result_columns_s        result_columns_t;
 typedef struct result_rows_s           result_rows_t;
+typedef struct result_cursor_s         result_cursor_t;
 typedef struct result_string_s         result_string_t;
 typedef struct result_list_s           result_list_t;
 
@@ -117,6 +118,17 @@ struct result_rows_s {
     column_desc_t         cols[0];
 };
 
+struct result_cursor_s {
+    mql_result_type_t     type;
+    mqi_select_cursor_t  *cursor;
+    int                   rowsize;
+    int                   ncol;
+    int                   nrow;     /* number of rows in the current batch */
+    int                   rowidx;   /* current row within the batch */
+    void                 *data;     /* current batch of rows */
+    column_desc_t         cols[0];
+};
+
 struct result_string_s {
     mql_result_type_t     type;
     int                   length;
@@ -138,8 +150,16 @@ struct result_list_s {
     }                     value;
 };
 
+#define CURSOR_BATCH  64        /* rows fetched at a time by a cursor */
+
 static inline mqi_data_type_t get_column_type(result_rows_t *, int);
 static inline void *get_column_address(result_rows_t *, int, int);
+static void set_column_descs(column_desc_t *, int, mqi_column_desc_t *,
+                             mqi_data_type_t *);
+static const char *column_to_string(mqi_data_type_t, void *, char *, int);
+static int32_t column_to_integer(mqi_data_type_t, void *);
+static uint32_t column_to_unsigned(mqi_data_type_t, void *);
+static double column_to_floating(mqi_data_type_t, void *);
 
 
 int mql_result_is_success(mql_result_t *r)
@@ -479,12 +499,9 @@ mql_result_t *mql_result_rows_create(int                ncol,
                                      void              *rows)
 {
     result_rows_t     *rslt;
-    column_desc_t     *col;
-    mqi_column_desc_t *cd;
     int                offs;
     size_t             size;
     size_t             dlgh;
-    int                i;
 
     MDB_CHECKARG(ncol >  0 && coldescs && coltypes && colsizes &&
                  nrow >= 0 && rowsize > 0 && rows, NULL);
@@ -505,14 +522,7 @@ mql_result_t *mql_result_rows_create(int                ncol,
     rslt->nrow    = nrow;
     rslt->data    = rslt->cols + ncol;
 
-    for (i = 0;   i < ncol;  i++) {
-        col = rslt->cols + i;
-        cd  = coldescs + i;
-
-        col->cindex = cd->cindex;
-        col->type   = coltypes[i];
-        col->offset = cd->offset;
-    }
+    set_column_descs(rslt->cols, ncol, coldescs, coltypes);
 
     if (dlgh > 0)
         memcpy(rslt->data, rows, dlgh);
@@ -563,125 +573,187 @@ const char *mql_result_rows_get_string(mql_result_t *r, int colidx, int rowidx,
                                        char *buf, int len)
 {
     result_rows_t *rslt = (result_rows_t *)r;
-    void *addr;
-    char *v = NULL;
 
     MDB_CHECKARG(rslt && rslt->type == mql_result_rows &&
                  colidx >= 0 && colidx < rslt->ncol &&
                  rowidx >= 0 && rowidx < rslt->nrow &&
                  (!buf || (buf && len > 0)), NULL);
 
-    if ((v = buf))
-        *v = '\0';
-
-    if ((addr = get_column_address(rslt, colidx, rowidx))) {
-        switch (get_column_type(rslt, colidx)) {
-        case mqi_varchar:
-            if (!v)
-                v = *(char **)addr;
-            else {
-                strncpy(v, *(char **)addr, len);
-                v[len-1] = '\0';
-            }
-            break;
-
-        case mqi_integer:
-            if (!v)
-                v = "";
-            else
-                snprintf(v, len, "%d", *(int32_t *)addr);
-            break;
-
-        case mqi_unsignd:
-            if (!v)
-                v = "";
-            else
-                snprintf(v, len, "%u", *(uint32_t *)addr);
-            break;
-
-        case mqi_floating:
-            if (!v)
-                v = "";
-            else
-                snprintf(v, len, "%lf", *(double *)addr);
-            break;
-
-        default:
-            v = "";
-            break;
-        }
-    }
-
-    return v;
+    return column_to_string(get_column_type(rslt, colidx),
+                            get_column_address(rslt, colidx, rowidx),
+                            buf, len);
 }
 
 int32_t mql_result_rows_get_integer(mql_result_t *r, int colidx, int rowidx)
 {
     result_rows_t *rslt = (result_rows_t *)r;
-    void *addr;
-    int32_t v = 0;
 
     MDB_CHECKARG(rslt && rslt->type == mql_result_rows &&
                  colidx >= 0 && colidx < rslt->ncol &&
                  rowidx >= 0 && rowidx < rslt->nrow, 0);
 
-    if ((addr = get_column_address(rslt, colidx, rowidx))) {
-        switch (get_column_type(rslt, colidx)) {
-        case mqi_varchar:    v = strtol(*(char **)addr, NULL, 10);   break;
-        case mqi_integer:    v = *(int32_t *)addr;                   break;
-        case mqi_unsignd:    v = *(uint32_t *)addr;                  break;
-        case mqi_floating:   v = *(double *)addr;                    break;
-        default:             v = 0;                                  break;
-        }
-    }
-
-    return v;
+    return column_to_integer(get_column_type(rslt, colidx),
+                             get_column_address(rslt, colidx, rowidx));
 }
 
 uint32_t mql_result_rows_get_unsigned(mql_result_t *r, int colidx, int rowidx)
 {
     result_rows_t *rslt = (result_rows_t *)r;
-    void *addr;
-    uint32_t v = 0;
 
     MDB_CHECKARG(rslt && rslt->type == mql_result_rows &&
                  colidx >= 0 && colidx < rslt->ncol &&
                  rowidx >= 0 && rowidx < rslt->nrow, 0);
 
-    if ((addr = get_column_address(rslt, colidx, rowidx))) {
-        switch (get_column_type(rslt, colidx)) {
-        case mqi_varchar:    v = strtoul(*(char **)addr, NULL, 10);  break;
-        case mqi_integer:    v = *(int32_t *)addr;                   break;
-        case mqi_unsignd:    v = *(uint32_t *)addr;                  break;
-        case mqi_floating:   v = *(double *)addr;                    break;
-        default:             v = 0;                                  break;
-        }
-    }
-
-    return v;
+    return column_to_unsigned(get_column_type(rslt, colidx),
+                              get_column_address(rslt, colidx, rowidx));
 }
 
 double mql_result_rows_get_floating(mql_result_t *r, int colidx, int rowidx)
 {
     result_rows_t *rslt = (result_rows_t *)r;
-    void *addr;
-    double v = 0;
 
     MDB_CHECKARG(rslt && rslt->type == mql_result_rows &&
                  colidx >= 0 && colidx < rslt->ncol &&
                  rowidx >= 0 && rowidx < rslt->nrow, 0.0);
 
-    if ((addr = get_column_address(rslt, colidx, rowidx))) {
-        switch (get_column_type(rslt, colidx)) {
-        case mqi_varchar:    v = strtod(*(char **)addr, NULL);    break;
-        case mqi_integer:    v = *(int32_t *)addr;                break;
-        case mqi_unsignd:    v = *(uint32_t *)addr;               break;
-        case mqi_floating:   v = *(double *)addr;                 break;
-        default:             v = 0;                               break;
-        }
+    return column_to_floating(get_column_type(rslt, colidx),
+                              get_column_address(rslt, colidx, rowidx));
+}
+
+
+/*
+ * A cursor result streams the selected rows in batches of CURSOR_BATCH
+ * rows instead of holding all of them. It takes over the ownership of
+ * the mqi cursor.
+ */
+mql_result_t *mql_result_cursor_create(mqi_select_cursor_t *cursor,
+                                       int                  ncol,
+                                       mqi_column_desc_t   *coldescs,
+                                       mqi_data_type_t     *coltypes,
+                                       int                  rowsize)
+{
+    result_cursor_t *rslt;
+    size_t           size;
+
+    MDB_CHECKARG(cursor && ncol > 0 && coldescs && coltypes &&
+                 rowsize > 0, NULL);
+
+    size = sizeof(result_cursor_t) + sizeof(column_desc_t) * ncol +
+        rowsize * CURSOR_BATCH;
+
+    if (!(rslt = calloc(1, size))) {
+        errno = ENOMEM;
+        return NULL;
     }
 
-    return v;
+    rslt->type    = mql_result_cursor;
+    rslt->cursor  = cursor;
+    rslt->rowsize = rowsize;
+    rslt->ncol    = ncol;
+    rslt->nrow    = 0;
+    rslt->rowidx  = -1;
+    rslt->data    = rslt->cols + ncol;
+
+    set_column_descs(rslt->cols, ncol, coldescs, coltypes);
+
+    return (mql_result_t *)rslt;
+}
+
+int mql_result_cursor_next(mql_result_t *r)
+{
+    result_cursor_t *rslt = (result_cursor_t *)r;
+    int              n;
+
+    MDB_CHECKARG(rslt && rslt->type == mql_result_cursor, -1);
+
+    if (rslt->rowidx + 1 < rslt->nrow) {
+        rslt->rowidx++;
+        return 1;
+    }
+
+    n = mqi_select_cursor_next(rslt->cursor, rslt->data, rslt->rowsize,
+                               CURSOR_BATCH);
+
+    if (n <= 0) {
+        rslt->nrow   = 0;
+        rslt->rowidx = -1;
+        return n;
+    }
+
+    rslt->nrow   = n;
+    rslt->rowidx = 0;
+
+    return 1;
+}
+
+int mql_result_cursor_get_column_count(mql_result_t *r)
+{
+    result_cursor_t *rslt = (result_cursor_t *)r;
+
+    MDB_CHECKARG(rslt && rslt->type == mql_result_cursor, -1);
+
+    return rslt->ncol;
+}
+
+mqi_data_type_t mql_result_cursor_get_column_type(mql_result_t *r, int colidx)
+{
+    result_cursor_t *rslt = (result_cursor_t *)r;
+
+    MDB_CHECKARG(rslt && rslt->type == mql_result_cursor &&
+                 colidx >= 0 && colidx < rslt->ncol, -1);
+
+    return rslt->cols[colidx].type;
+}
+
+#define CURSOR_COLUMN_ADDRESS(rslt, cx)                                   \
+    ((rslt)->data + ((rslt)->rowsize * (rslt)->rowidx +                   \
+                     (rslt)->cols[cx].offset))
+
+#define CURSOR_HAS_COLUMN(rslt, cx)                                       \
+    ((rslt) && (rslt)->type == mql_result_cursor &&                       \
+     (cx) >= 0 && (cx) < (rslt)->ncol &&                                  \
+     (rslt)->rowidx >= 0 && (rslt)->rowidx < (rslt)->nrow)
+
+const char *mql_result_cursor_get_string(mql_result_t *r, int colidx,
+                                         char *buf, int len)
+{
+    result_cursor_t *rslt = (result_cursor_t *)r;
+
+    MDB_CHECKARG(CURSOR_HAS_COLUMN(rslt, colidx) &&
+                 (!buf || (buf && len > 0)), NULL);
+
+    return column_to_string(rslt->cols[colidx].type,
+                            CURSOR_COLUMN_ADDRESS(rslt, colidx), buf, len);
+}
+
+int32_t mql_result_cursor_get_integer(mql_result_t *r, int colidx)
+{
+    result_cursor_t *rslt = (result_cursor_t *)r;
+
+    MDB_CHECKARG(CURSOR_HAS_COLUMN(rslt, colidx), 0);
+
+    return column_to_integer(rslt->cols[colidx].type,
+                             CURSOR_COLUMN_ADDRESS(rslt, colidx));
+}
+
+uint32_t mql_result_cursor_get_unsigned(mql_result_t *r, int colidx)
+{
+    result_cursor_t *rslt = (result_cursor_t *)r;
+
+    MDB_CHECKARG(CURSOR_HAS_COLUMN(rslt, colidx), 0);
+
+    return column_to_unsigned(rslt->cols[colidx].type,
+                              CURSOR_COLUMN_ADDRESS(rslt, colidx));
+}
+
+double mql_result_cursor_get_floating(mql_result_t *r, int colidx)
+{
+    result_cursor_t *rslt = (result_cursor_t *)r;
+
+    MDB_CHECKARG(CURSOR_HAS_COLUMN(rslt, colidx), 0.0);
+
+    return column_to_floating(rslt->cols[colidx].type,
+                              CURSOR_COLUMN_ADDRESS(rslt, colidx));
 }
 
 
@@ -1455,6 +1527,8 @@ void mql_result_free(mql_result_t *r)
                     mql_result_free(colchg->select);
             }
         }
+        else if (r->type == mql_result_cursor)
+            mqi_select_cursor_close(((result_cursor_t *)r)->cursor);
 
         free(r);
     }
@@ -1471,6 +1545,102 @@ static void *get_column_address(result_rows_t *rslt, int cx, int rx)
     return rslt->data + (rslt->rowsize * rx + rslt->cols[cx].offset);
 }
 
+static void set_column_descs(column_desc_t     *cols,
+                             int                ncol,
+                             mqi_column_desc_t *coldescs,
+                             mqi_data_type_t   *coltypes)
+{
+    int i;
+
+    for (i = 0;   i < ncol;  i++) {
+        cols[i].cindex = coldescs[i].cindex;
+        cols[i].type   = coltypes[i];
+        cols[i].offset = coldescs[i].offset;
+    }
+}
+
+static const char *column_to_string(mqi_data_type_t  type,
+                                    void            *addr,
+                                    char            *buf,
+                                    int              len)
+{
+    char *v;
+
+    if ((v = buf))
+        *v = '\0';
+
+    switch (type) {
+    case mqi_varchar:
+        if (!v)
+            v = *(char **)addr;
+        else {
+            strncpy(v, *(char **)addr, len);
+            v[len-1] = '\0';
+        }
+        break;
+
+    case mqi_integer:
+        if (!v)
+            v = "";
+        else
+            snprintf(v, len, "%d", *(int32_t *)addr);
+        break;
+
+    case mqi_unsignd:
+        if (!v)
+            v = "";
+        else
+            snprintf(v, len, "%u", *(uint32_t *)addr);
+        break;
+
+    case mqi_floating:
+        if (!v)
+            v = "";
+        else
+            snprintf(v, len, "%lf", *(double *)addr);
+        break;
+
+    default:
+        v = "";
+        break;
+    }
+
+    return v;
+}
+
+static int32_t column_to_integer(mqi_data_type_t type, void *addr)
+{
+    switch (type) {
+    case mqi_varchar:    return strtol(*(char **)addr, NULL, 10);
+    case mqi_integer:    return *(int32_t *)addr;
+    case mqi_unsignd:    return *(uint32_t *)addr;
+    case mqi_floating:   return *(double *)addr;
+    default:             return 0;
+    }
+}
+
+static uint32_t column_to_unsigned(mqi_data_type_t type, void *addr)
+{
+    switch (type) {
+    case mqi_varchar:    return strtoul(*(char **)addr, NULL, 10);
+    case mqi_integer:    return *(int32_t *)addr;
+    case mqi_unsignd:    return *(uint32_t *)addr;
+    case mqi_floating:   return *(double *)addr;
+    default:             return 0;
+    }
+}
+
+static double column_to_floating(mqi_data_type_t type, void *addr)
+{
+    switch (type) {
+    case mqi_varchar:    return strtod(*(char **)addr, NULL);
+    case mqi_integer:    return *(int32_t *)addr;
+    case mqi_unsignd:    return *(uint32_t *)addr;
+    case mqi_floating:   return *(double *)addr;
+    default:             return 0;
+    }
+}
+
 /*
  * Local Variables:
  * c-basic-offset: 4
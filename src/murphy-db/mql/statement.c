@@ -31,7 +31,6 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdarg.h>
-#include <alloca.h>
 #include <errno.h>
 
 #include <murphy-db/macros.h>
@@ -913,20 +912,39 @@ static mql_result_t *exec_delete(delete_statement_t *d)
 
 static mql_result_t *exec_select(mql_result_type_t type, select_statement_t *s)
 {
-    mql_result_t *rslt;
-    int           maxrow;
-    int           nrow;
-    void         *rows;
+    mql_result_t        *rslt;
+    mqi_select_cursor_t *cursor;
+    int                  maxrow;
+    int                  nrow;
+    void                *rows;
+
+    if (type == mql_result_cursor) {
+        if (!(cursor = mqi_select_cursor_open(s->table, s->cond, s->columns)))
+            rslt = mql_result_error_create(errno, "select error: %s",
+                                           strerror(errno));
+        else {
+            rslt = mql_result_cursor_create(cursor, s->ncolumn, s->columns,
+                                            s->coltypes, s->rowsize);
+            if (!rslt) {
+                mqi_select_cursor_close(cursor);
+                rslt = mql_result_error_create(ENOMEM, "select failed: "
+                                               "can't create cursor");
+            }
+        }
+
+        return rslt;
+    }
 
     if ((maxrow = mqi_get_table_size(s->table)) < 0)
         rslt = mql_result_error_create(ENOENT, "can't access table");
     else {
-        if (!maxrow) {
-            rows = alloca(s->rowsize);
+        if (!(rows = malloc((maxrow ? maxrow : 1) * s->rowsize)))
+            return mql_result_error_create(ENOMEM, "select failed: %s",
+                                           strerror(ENOMEM));
+
+        if (!maxrow)
             nrow = 0;
-        }
         else {
-            rows = alloca(maxrow * s->rowsize);
             nrow = mqi_select(s->table, s->cond, s->columns,
                               rows, s->rowsize, maxrow);
         }
@@ -954,6 +972,8 @@ static mql_result_t *exec_select(mql_result_type_t type, select_statement_t *s)
                 break;
             }
         }
+
+        free(rows);
     }
 
     return rslt;
@@ -29,6 +29,12 @@
 
 #include <check.h>
 
+#include <murphy-db/mqi.h>
+
+/* the allocators are tested through their internals */
+#include "../mdb/row.c"
+#include "../mdb/log.c"
+
 #ifndef LOGFILE
 #define LOGFILE  "check_libmdb.log"
 #endif
@@ -40,8 +46,31 @@
         suite_add_tcase(s, tc);                 \
     } while (0)
 
+typedef struct {
+    uint32_t    id;
+    const char *name;
+} record_t;
+
+
+MQI_COLUMN_DEFINITION_LIST(record_coldefs,
+    MQI_COLUMN_DEFINITION( "id"  , MQI_UNSIGNED    ),
+    MQI_COLUMN_DEFINITION( "name", MQI_VARCHAR(16) )
+);
+
+MQI_COLUMN_SELECTION_LIST(record_columns,
+    MQI_COLUMN_SELECTOR( 0, record_t, id   ),
+    MQI_COLUMN_SELECTOR( 1, record_t, name )
+);
+
+static char *record_index[] = { "id", NULL };
+
 
 static Suite *libmdb_suite(void);
+static mdb_table_t *new_table(char *);
+static void insert_rows(mdb_table_t *, uint32_t, int);
+static int delete_rows_below(mdb_table_t *, uint32_t);
+static int pool_nslab(mdb_row_pool_t *);
+static int pool_nused(mdb_row_pool_t *);
 
 
 int main()
@@ -69,16 +98,244 @@ START_TEST(create_table)
 END_TEST
 
 
+START_TEST(row_recycling)
+{
+    mdb_table_t    *tbl  = new_table("recycled");
+    mdb_row_pool_t *pool = &tbl->rpool;
+    int             n    = 3 * pool->nrow;
+
+    insert_rows(tbl, 0, n);
+
+    fail_unless(pool_nslab(pool) == 3 && pool->nempty == 0,
+                "%d rows took %d slabs instead of 3", n, pool_nslab(pool));
+
+    /* a released row is handed out again before any new slab */
+    fail_unless(delete_rows_below(tbl, 1) == 1, "errno (%s)",
+                strerror(errno));
+    insert_rows(tbl, n, 1);
+
+    fail_unless(pool_nslab(pool) == 3, "recycling a row took a new slab");
+    fail_unless(pool_nused(pool) == n, "%d rows in use instead of %d",
+                pool_nused(pool), n);
+
+    /* empty slabs are released, except for a single spare one */
+    fail_unless(mdb_table_delete(tbl, MQI_ALL) == n, "errno (%s)",
+                strerror(errno));
+
+    fail_unless(pool_nslab(pool) == 1 && pool->nempty == 1,
+                "%d slabs (%d empty) left instead of 1 spare",
+                pool_nslab(pool), pool->nempty);
+
+    insert_rows(tbl, 0, pool->nrow);
+
+    fail_unless(pool_nslab(pool) == 1 && pool->nempty == 0,
+                "filling the spare slab took a new one");
+
+    fail_unless(mdb_table_drop(tbl) == 0, "errno (%s)", strerror(errno));
+}
+END_TEST
+
+
+START_TEST(arena_chunk_reuse)
+{
+    mdb_table_t   *tbl = new_table("arena");
+    arena_chunk_t *spare;
+    tx_log_t      *txlog;
+    uint32_t       tx;
+
+    /* a transaction big enough to leave the maximum of spare chunks */
+    tx = mdb_transaction_begin();
+    insert_rows(tbl, 0, 1024);
+
+    txlog = (tx_log_t *)get_last_vlog(&tx_head);
+
+    fail_unless(txlog->arena && txlog->arena->next &&
+                txlog->arena->next->next, "1024 changes fit in 2 chunks");
+    fail_if(mdb_transaction_commit(tx) < 0, "errno (%s)",
+                strerror(errno));
+
+    fail_unless(nspare_chunk == ARENA_SPARE_MAX, "kept %d chunks instead "
+                "of %d", nspare_chunk, ARENA_SPARE_MAX);
+
+    /* the next transaction is served from a spare chunk */
+    spare = spare_chunks;
+
+    tx = mdb_transaction_begin();
+    insert_rows(tbl, 1024, 1);
+
+    txlog = (tx_log_t *)get_last_vlog(&tx_head);
+
+    fail_unless(txlog->arena == spare && !txlog->arena->next,
+                "spare chunk was not reused");
+    fail_unless(nspare_chunk == ARENA_SPARE_MAX - 1, "%d spare chunks "
+                "instead of %d", nspare_chunk, ARENA_SPARE_MAX - 1);
+
+    fail_if(mdb_transaction_rollback(tx) < 0, "errno (%s)",
+                strerror(errno));
+
+    fail_unless(nspare_chunk == ARENA_SPARE_MAX && spare_chunks == spare,
+                "chunk was not returned to the spares");
+
+    fail_unless(mdb_table_drop(tbl) == 0, "errno (%s)", strerror(errno));
+}
+END_TEST
+
+
+START_TEST(rollback_releases_rows)
+{
+    mdb_table_t    *tbl  = new_table("rolled_back");
+    mdb_row_pool_t *pool = &tbl->rpool;
+    mdb_row_t      *row;
+    int             n    = 2 * pool->nrow;
+    int             nslab;
+    uint32_t        tx, sum;
+
+    insert_rows(tbl, 0, n);
+    nslab = pool_nslab(pool);
+
+    tx = mdb_transaction_begin();
+
+    fail_unless(delete_rows_below(tbl, n / 2) == n / 2, "errno (%s)",
+                strerror(errno));
+    insert_rows(tbl, n, n);
+
+    fail_if(mdb_transaction_rollback(tx) < 0, "errno (%s)",
+                strerror(errno));
+
+    /* inserted rows and deleted ones kept for the rollback are gone */
+    fail_unless(pool_nused(pool) == n, "%d rows in use after rollback "
+                "instead of %d", pool_nused(pool), n);
+    fail_unless(pool_nslab(pool) <= nslab + ROW_EMPTY_MAX,
+                "%d slabs left after rollback instead of %d",
+                pool_nslab(pool), nslab);
+
+    sum = 0;
+    MDB_DLIST_FOR_EACH(mdb_row_t, link, row, &tbl->rows)
+        sum += *(uint32_t *)(row->data + tbl->columns[0].offset);
+
+    fail_unless(sum == (uint32_t)n * (n - 1) / 2,
+                "rows were not restored by the rollback");
+
+    fail_unless(mdb_table_drop(tbl) == 0, "errno (%s)", strerror(errno));
+}
+END_TEST
+
+
+START_TEST(table_drop_in_transaction)
+{
+    mdb_table_t *dropped = new_table("dropped");
+    mdb_table_t *kept    = new_table("kept");
+    uint32_t     tx;
+
+    insert_rows(dropped, 0, 64);
+    insert_rows(kept, 0, 64);
+
+    tx = mdb_transaction_begin();
+
+    fail_unless(mdb_table_delete(dropped, MQI_ALL) == 64, "errno (%s)",
+                strerror(errno));
+    insert_rows(dropped, 64, 64);
+    insert_rows(kept, 64, 64);
+
+    /* the log of the dropped table must go with it */
+    fail_unless(mdb_table_drop(dropped) == 0, "errno (%s)",
+                strerror(errno));
+    fail_if(mdb_transaction_rollback(tx) < 0, "errno (%s)",
+                strerror(errno));
+
+    fail_unless(pool_nused(&kept->rpool) == 64, "%d rows in use after "
+                "rollback instead of 64", pool_nused(&kept->rpool));
+    fail_unless(nspare_chunk <= ARENA_SPARE_MAX, "%d spare chunks",
+                nspare_chunk);
+
+    fail_unless(mdb_table_drop(kept) == 0, "errno (%s)", strerror(errno));
+}
+END_TEST
+
+
 static Suite *libmdb_suite(void)
 {
     Suite *s = suite_create("Memory Database - libmdb");
 
     ADD_TEST_CASE(s, create_table);
+    ADD_TEST_CASE(s, row_recycling);
+    ADD_TEST_CASE(s, arena_chunk_reuse);
+    ADD_TEST_CASE(s, rollback_releases_rows);
+    ADD_TEST_CASE(s, table_drop_in_transaction);
 
     return s;
 }
 
 
+static mdb_table_t *new_table(char *name)
+{
+    mdb_table_t *tbl;
+
+    tbl = mdb_table_create(name, record_index, record_coldefs);
+
+    fail_unless(tbl != NULL, "failed to create table %s: errno (%s)",
+                name, strerror(errno));
+
+    return tbl;
+}
+
+
+static void insert_rows(mdb_table_t *tbl, uint32_t first, int n)
+{
+    record_t  records[n];
+    void     *data[n + 1];
+    int       i;
+
+    for (i = 0;  i < n;  i++) {
+        records[i].id   = first + i;
+        records[i].name = "row";
+        data[i] = records + i;
+    }
+    data[n] = NULL;
+
+    fail_unless(mdb_table_insert(tbl, 0, record_columns, data) == n,
+                "failed to insert %d rows: errno (%s)", n, strerror(errno));
+}
+
+
+static int delete_rows_below(mdb_table_t *tbl, uint32_t limit)
+{
+    static uint32_t below;
+
+    MQI_WHERE_CLAUSE(where,
+        MQI_LESS( MQI_COLUMN(0), MQI_UNSIGNED_VAR(below) )
+    );
+
+    below = limit;
+
+    return mdb_table_delete(tbl, where);
+}
+
+
+static int pool_nslab(mdb_row_pool_t *pool)
+{
+    mdb_row_slab_t *slab;
+    int             n = 0;
+
+    MDB_DLIST_FOR_EACH(mdb_row_slab_t, link, slab, &pool->slabs)
+        n++;
+
+    return n;
+}
+
+
+static int pool_nused(mdb_row_pool_t *pool)
+{
+    mdb_row_slab_t *slab;
+    int             n = 0;
+
+    MDB_DLIST_FOR_EACH(mdb_row_slab_t, link, slab, &pool->slabs)
+        n += slab->nused;
+
+    return n;
+}
+
+
 /*
  * Local Variables:
  * c-basic-offset: 4
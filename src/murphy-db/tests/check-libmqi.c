@@ -31,11 +31,16 @@
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <unistd.h>
 #include <libgen.h>
+#include <signal.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
 
 #include <check.h>
 
 #include <murphy-db/mqi.h>
+#include <murphy-db/mdb.h>
 
 #ifndef LOGFILE
 #define LOGFILE  "check_libmqi.log"
@@ -48,6 +53,8 @@
 #define TABLE_TRIGGER_DATA    TRIGGER_DATA(2)
 #define ROW_TRIGGER_DATA      TRIGGER_DATA(3)
 #define COLUMN_TRIGGER_DATA   TRIGGER_DATA(4)
+#define CHANGESET_TRIGGER_DATA TRIGGER_DATA(5)
+#define OTHER_CHANGESET_DATA  TRIGGER_DATA(6)
 
 typedef struct {
     mqi_event_type_t  event;
@@ -81,6 +88,19 @@ typedef struct {
     const char    *first_name;
 } query_t;
 
+typedef struct {
+    int              ncallback;
+    int              ninsert;
+    int              ndelete;
+    int              nupdate;
+    int              nchange;
+    struct {
+        mqi_event_type_t event;
+        uint32_t         before;
+        uint32_t         after;
+    }                change[16];
+} changeset_t;
+
 
 MQI_COLUMN_DEFINITION_LIST(persons_coldefs,
     MQI_COLUMN_DEFINITION( "sex"        , MQI_VARCHAR(6)  ),
@@ -95,6 +115,10 @@ MQI_INDEX_DEFINITION(persons_indexdef,
     MQI_INDEX_COLUMN("family_name")
 );
 
+MQI_INDEX_DEFINITION(ids_indexdef,
+    MQI_INDEX_COLUMN("id")
+);
+
 MQI_COLUMN_SELECTION_LIST(persons_insert_columns,
     MQI_COLUMN_SELECTOR( 0, record_t, sex         ),
     MQI_COLUMN_SELECTOR( 2, record_t, first_name  ),
@@ -126,9 +150,12 @@ static int          txdepth;
 static mqi_handle_t persons = MQI_HANDLE_INVALID;
 static int          columns_no_in_persons = -1;
 static int          rows_no_in_persons = -1;
+static mqi_handle_t ids = MQI_HANDLE_INVALID;
 
 static int          ntrigger;
 static trigger_t    triggers[256];
+static changeset_t  changeset;
+static changeset_t  other_changeset;
 static int          nseq = 32;
 static int          nnest = MQI_TXDEPTH_MAX - 1;
 
@@ -141,6 +168,7 @@ static void   transaction_event_cb(mqi_event_t *, void *);
 static void   table_event_cb(mqi_event_t *, void *);
 static void   row_event_cb(mqi_event_t *, void *);
 static void   column_event_cb(mqi_event_t *, void *);
+static void   changeset_event_cb(mqi_event_t *, void *);
 
 
 int main(int argc, char **argv)
@@ -431,6 +459,60 @@ END_TEST
 
 
 
+START_TEST(cursor_select_from_persons)
+{
+    static record_t  gary = {"male", "Gary","Cooper", 200, "gary@att.com"};
+    static record_t *duplicate[] = {&gary, NULL};
+
+    mqi_select_cursor_t *cursor;
+    const void *refs[4];
+    query_t rows[4];
+    int i, n, total;
+
+    PREREQUISITE(replace_in_persons);
+
+    cursor = mqi_select_cursor_open(persons, MQI_ALL, persons_select_columns);
+
+    fail_if(!cursor, "errno (%s)", strerror(errno));
+
+    for (total = 0;  (n = MQI_SELECT_CURSOR_NEXT(cursor, rows)) > 0;
+         total += n) {
+        if (verbose) {
+            for (i = 0;  i < n;  i++) {
+                printf("%5d %-15s %-15s\n", rows[i].id,
+                       rows[i].first_name, rows[i].family_name);
+            }
+        }
+    }
+
+    fail_if(n < 0, "error (%s)", strerror(errno));
+    fail_if(total != 6, "cursor returned %d rows but the right number "
+            "would be 6", total);
+
+    mqi_select_cursor_close(cursor);
+
+    cursor = mqi_select_cursor_open(persons, MQI_ALL, persons_select_columns);
+
+    fail_if(!cursor, "errno (%s)", strerror(errno));
+
+    n = mqi_select_cursor_next_ref(cursor, refs, MQI_DIMENSION(refs));
+
+    fail_if(n != MQI_DIMENSION(refs), "fetched %d row references instead "
+            "of %d", n, MQI_DIMENSION(refs));
+
+    n = MQI_REPLACE(persons, persons_insert_columns, duplicate);
+
+    fail_if(n < 0, "error (%s)", strerror(errno));
+
+    n = mqi_select_cursor_next_ref(cursor, refs, MQI_DIMENSION(refs));
+
+    fail_if(n >= 0 || errno != ESTALE, "cursor was not invalidated by "
+            "a table change");
+
+    mqi_select_cursor_close(cursor);
+}
+END_TEST
+
 START_TEST(select_from_persons_by_index)
 {
     MQI_INDEX_VALUE(index,
@@ -462,6 +544,159 @@ END_TEST
 
 
 
+START_TEST(range_select_from_ids)
+{
+    static uint32_t lo = 500;
+    static uint32_t hi = 1100;
+
+    MQI_WHERE_CLAUSE(where,
+        MQI_GREATER_OR_EQUAL( MQI_COLUMN(3), MQI_UNSIGNED_VAR(lo) ) MQI_AND
+        MQI_GREATER( MQI_UNSIGNED_VAR(hi), MQI_COLUMN(3) )
+    );
+
+    query_t rows[32];
+    int i, n;
+
+    PREREQUISITE(open_db);
+
+    ids = MQI_CREATE_TABLE("ids", MQI_TEMPORARY, persons_coldefs,ids_indexdef);
+
+    fail_if(ids == MQI_HANDLE_INVALID, "errno (%s)", strerror(errno));
+
+    n = MQI_INSERT_INTO(ids, persons_insert_columns, artists);
+
+    fail_if(n != MQI_DIMENSION(artists)-1, "some insertion failed. "
+            "Attempted %d succeeded %d", MQI_DIMENSION(artists)-1, n);
+
+    n = MQI_SELECT(persons_select_columns, ids, where, rows);
+
+    fail_if(n < 0, "error (%s)", strerror(errno));
+
+    if (verbose)
+        print_rows(n, rows);
+
+    fail_if(n != 3, "selected %d rows but the right number would be 3", n);
+
+    for (i = 1;  i < n;  i++) {
+        fail_if(rows[i-1].id >= rows[i].id, "rows are not in index order "
+                "(%u before %u)", rows[i-1].id, rows[i].id);
+    }
+}
+END_TEST
+
+
+
+START_TEST(secondary_index_on_ids)
+{
+    static char *initial = "H";
+
+    MQI_INDEX_DEFINITION(family_name_indexdef,
+        MQI_INDEX_COLUMN("family_name")
+    );
+
+    MQI_WHERE_CLAUSE(where,
+        MQI_GREATER_OR_EQUAL( MQI_COLUMN(1), MQI_STRING_VAR(initial) )
+    );
+
+    query_t rows[32];
+    int sts, n;
+
+    PREREQUISITE(range_select_from_ids);
+
+    sts = mqi_create_secondary_index(ids, "family_name",family_name_indexdef);
+
+    fail_if(sts < 0, "errno (%s)", strerror(errno));
+
+    sts = mqi_create_secondary_index(ids, "family_name",family_name_indexdef);
+
+    fail_if(sts == 0, "managed to create a duplicate index");
+
+    n = MQI_SELECT(persons_select_columns, ids, where, rows);
+
+    fail_if(n < 0, "error (%s)", strerror(errno));
+
+    if (verbose)
+        print_rows(n, rows);
+
+    fail_if(n != 3, "selected %d rows but the right number would be 3", n);
+
+    sts = mqi_drop_secondary_index(ids, "family_name");
+
+    fail_if(sts < 0, "errno (%s)", strerror(errno));
+}
+END_TEST
+
+
+
+START_TEST(bulk_insert_and_snapshot)
+{
+    static uint32_t lo = 500;
+    static uint32_t hi = 1100;
+
+    MQI_WHERE_CLAUSE(where,
+        MQI_GREATER_OR_EQUAL( MQI_COLUMN(3), MQI_UNSIGNED_VAR(lo) ) MQI_AND
+        MQI_GREATER( MQI_UNSIGNED_VAR(hi), MQI_COLUMN(3) )
+    );
+
+    mqi_handle_t bulk, restored;
+    query_t rows[32];
+    char path[256];
+    int i, n;
+
+    PREREQUISITE(open_db);
+
+    snprintf(path, sizeof(path), "/tmp/check-libmqi-%u.snapshot", getpid());
+
+    bulk = MQI_CREATE_TABLE("bulk", MQI_TEMPORARY, persons_coldefs,
+                            ids_indexdef);
+
+    fail_if(bulk == MQI_HANDLE_INVALID, "errno (%s)", strerror(errno));
+
+    n = MQI_BULK_INSERT(bulk, persons_insert_columns, artists);
+
+    fail_if(n != MQI_DIMENSION(artists)-1, "some insertion failed. "
+            "Attempted %d succeeded %d", MQI_DIMENSION(artists)-1, n);
+
+    n = mqi_save_snapshot(bulk, path);
+
+    fail_if(n != MQI_DIMENSION(artists)-1, "saved %d rows instead of %d "
+            "(%s)", n, MQI_DIMENSION(artists)-1, strerror(errno));
+
+    restored = MQI_CREATE_TABLE("restored", MQI_TEMPORARY, persons_coldefs,
+                                ids_indexdef);
+
+    fail_if(restored == MQI_HANDLE_INVALID, "errno (%s)", strerror(errno));
+
+    n = mqi_load_snapshot(restored, path);
+
+    fail_if(n != MQI_DIMENSION(artists)-1, "loaded %d rows instead of %d "
+            "(%s)", n, MQI_DIMENSION(artists)-1, strerror(errno));
+
+    n = mqi_load_snapshot(restored, path);
+
+    fail_if(n >= 0 || errno != EEXIST, "duplicate rows were loaded");
+
+    unlink(path);
+
+    n = MQI_SELECT(persons_select_columns, restored, where, rows);
+
+    fail_if(n < 0, "error (%s)", strerror(errno));
+
+    if (verbose)
+        print_rows(n, rows);
+
+    fail_if(n != 3, "selected %d rows but the right number would be 3", n);
+
+    for (i = 1;  i < n;  i++) {
+        fail_if(rows[i-1].id >= rows[i].id, "rows are not in index order "
+                "(%u before %u)", rows[i-1].id, rows[i].id);
+    }
+
+    fail_if(mqi_drop_table(bulk) < 0, "errno (%s)", strerror(errno));
+    fail_if(mqi_drop_table(restored) < 0, "errno (%s)", strerror(errno));
+}
+END_TEST
+
 START_TEST(update_in_persons)
 {
     MQI_WHERE_CLAUSE(where,
@@ -788,6 +1023,201 @@ START_TEST(column_trigger)
 }
 END_TEST
 
+START_TEST(changeset_trigger)
+{
+    static query_t kalle = {1, "Korhonen", "Kalle"};
+    static query_t ville = {2, "Korhonen", "Ville"};
+    static record_t temp = {"male", "Temp", "Orary", 3000, "tmp@foo.com"};
+    static record_t *temps[] = {&temp, NULL};
+
+    MQI_WHERE_CLAUSE(garys,
+        MQI_EQUAL( MQI_COLUMN(3), MQI_UNSIGNED_VAR(gary.id) )
+    );
+    MQI_WHERE_CLAUSE(kalles,
+        MQI_EQUAL( MQI_COLUMN(3), MQI_UNSIGNED_VAR(kalle.id) )
+    );
+    MQI_WHERE_CLAUSE(toms,
+        MQI_EQUAL( MQI_COLUMN(3), MQI_UNSIGNED_VAR(tom.id) )
+    );
+    MQI_WHERE_CLAUSE(temps_,
+        MQI_EQUAL( MQI_COLUMN(3), MQI_UNSIGNED_VAR(temp.id) )
+    );
+
+    mqi_handle_t changes, trh;
+    int i, n, sts;
+
+    PREREQUISITE(open_db);
+
+    changes = MQI_CREATE_TABLE("changes", MQI_TEMPORARY, persons_coldefs,
+                               ids_indexdef);
+
+    fail_if(changes == MQI_HANDLE_INVALID, "errno (%s)", strerror(errno));
+
+    sts = mqi_create_changeset_trigger(changes, changeset_event_cb,
+                                       CHANGESET_TRIGGER_DATA,
+                                       persons_select_columns);
+
+    fail_if(sts < 0, "create changeset trigger failed: errno (%s)",
+            strerror(errno));
+
+    memset(&changeset, 0, sizeof(changeset));
+
+    trh = MQI_BEGIN;
+    n   = MQI_INSERT_INTO(changes, persons_insert_columns, artists);
+
+    fail_if(n != MQI_DIMENSION(artists)-1, "insertion failed (%s)",
+            strerror(errno));
+    fail_if(MQI_COMMIT(trh) < 0, "errno (%s)", strerror(errno));
+
+    fail_unless(changeset.ncallback == 1 &&
+                changeset.ninsert == MQI_DIMENSION(artists)-1 &&
+                changeset.nchange == changeset.ninsert,
+                "got %d callbacks with %d inserts instead of 1 with %d",
+                changeset.ncallback, changeset.ninsert,
+                MQI_DIMENSION(artists)-1);
+
+    memset(&changeset, 0, sizeof(changeset));
+
+    trh = MQI_BEGIN;
+
+    n = MQI_UPDATE(changes, persons_select_columns, &kalle, garys);
+    fail_if(n != 1, "updated %d rows instead of 1", n);
+
+    n = MQI_UPDATE(changes, persons_select_columns, &ville, kalles);
+    fail_if(n != 1, "updated %d rows instead of 1", n);
+
+    n = MQI_DELETE(changes, toms);
+    fail_if(n != 1, "deleted %d rows instead of 1", n);
+
+    n = MQI_INSERT_INTO(changes, persons_insert_columns, temps);
+    fail_if(n != 1, "inserted %d rows instead of 1", n);
+
+    n = MQI_DELETE(changes, temps_);
+    fail_if(n != 1, "deleted %d rows instead of 1", n);
+
+    fail_if(MQI_COMMIT(trh) < 0, "errno (%s)", strerror(errno));
+
+    fail_unless(changeset.ncallback == 1, "got %d callbacks instead of 1",
+                changeset.ncallback);
+    fail_unless(changeset.ninsert == 0 && changeset.nupdate == 1 &&
+                changeset.ndelete == 1 && changeset.nchange == 2,
+                "got %d inserts, %d updates and %d deletes instead of "
+                "0, 1 and 1", changeset.ninsert, changeset.nupdate,
+                changeset.ndelete);
+
+    for (i = 0;  i < changeset.nchange;  i++) {
+        if (changeset.change[i].event == mqi_column_changed) {
+            fail_unless(changeset.change[i].before == gary.id &&
+                        changeset.change[i].after == ville.id,
+                        "coalesced update changed id %u to %u instead of "
+                        "%u to %u", changeset.change[i].before,
+                        changeset.change[i].after, gary.id, ville.id);
+        }
+        else {
+            fail_unless(changeset.change[i].event == mqi_row_deleted &&
+                        changeset.change[i].before == tom.id,
+                        "unexpected change %d of id %u",
+                        changeset.change[i].event,
+                        changeset.change[i].before);
+        }
+    }
+
+    fail_if(mqi_drop_changeset_trigger(changes, changeset_event_cb,
+                                       CHANGESET_TRIGGER_DATA) < 0,
+            "errno (%s)", strerror(errno));
+    fail_if(mqi_drop_table(changes) < 0, "errno (%s)", strerror(errno));
+}
+END_TEST
+
+START_TEST(interleaved_changeset_trigger)
+{
+    static query_t kalle = {1, "Korhonen", "Kalle"};
+    static query_t ville = {2, "Korhonen", "Ville"};
+
+    MQI_WHERE_CLAUSE(garys,
+        MQI_EQUAL( MQI_COLUMN(3), MQI_UNSIGNED_VAR(gary.id) )
+    );
+    MQI_WHERE_CLAUSE(kalles,
+        MQI_EQUAL( MQI_COLUMN(3), MQI_UNSIGNED_VAR(kalle.id) )
+    );
+    MQI_WHERE_CLAUSE(toms,
+        MQI_EQUAL( MQI_COLUMN(3), MQI_UNSIGNED_VAR(tom.id) )
+    );
+
+    mqi_handle_t first, second, trh;
+    int n, sts;
+
+    PREREQUISITE(open_db);
+
+    first  = MQI_CREATE_TABLE("first", MQI_TEMPORARY, persons_coldefs,
+                              ids_indexdef);
+    second = MQI_CREATE_TABLE("second", MQI_TEMPORARY, persons_coldefs,
+                              ids_indexdef);
+
+    fail_if(first == MQI_HANDLE_INVALID || second == MQI_HANDLE_INVALID,
+            "errno (%s)", strerror(errno));
+
+    n = MQI_INSERT_INTO(first, persons_insert_columns, artists);
+    fail_if(n != MQI_DIMENSION(artists)-1, "insertion failed (%s)",
+            strerror(errno));
+    n = MQI_INSERT_INTO(second, persons_insert_columns, artists);
+    fail_if(n != MQI_DIMENSION(artists)-1, "insertion failed (%s)",
+            strerror(errno));
+
+    sts = mqi_create_changeset_trigger(first, changeset_event_cb,
+                                       CHANGESET_TRIGGER_DATA,
+                                       persons_select_columns);
+    fail_if(sts < 0, "create changeset trigger failed: errno (%s)",
+            strerror(errno));
+
+    sts = mqi_create_changeset_trigger(second, changeset_event_cb,
+                                       OTHER_CHANGESET_DATA,
+                                       persons_select_columns);
+    fail_if(sts < 0, "create changeset trigger failed: errno (%s)",
+            strerror(errno));
+
+    memset(&changeset, 0, sizeof(changeset));
+    memset(&other_changeset, 0, sizeof(other_changeset));
+
+    /* first, second, first: must still give one changeset per table */
+    trh = MQI_BEGIN;
+
+    n = MQI_UPDATE(first, persons_select_columns, &kalle, garys);
+    fail_if(n != 1, "updated %d rows instead of 1", n);
+
+    n = MQI_DELETE(second, toms);
+    fail_if(n != 1, "deleted %d rows instead of 1", n);
+
+    n = MQI_UPDATE(first, persons_select_columns, &ville, kalles);
+    fail_if(n != 1, "updated %d rows instead of 1", n);
+
+    fail_if(MQI_COMMIT(trh) < 0, "errno (%s)", strerror(errno));
+
+    fail_unless(changeset.ncallback == 1 && other_changeset.ncallback == 1,
+                "got %d and %d callbacks instead of 1 and 1",
+                changeset.ncallback, other_changeset.ncallback);
+    fail_unless(changeset.nchange == 1 && changeset.nupdate == 1 &&
+                changeset.change[0].before == gary.id &&
+                changeset.change[0].after == ville.id,
+                "got %d changes instead of an update of id %u to %u",
+                changeset.nchange, gary.id, ville.id);
+    fail_unless(other_changeset.nchange == 1 &&
+                other_changeset.ndelete == 1 &&
+                other_changeset.change[0].before == tom.id,
+                "got %d changes instead of a delete of id %u",
+                other_changeset.nchange, tom.id);
+
+    fail_if(mqi_drop_changeset_trigger(first, changeset_event_cb,
+                                       CHANGESET_TRIGGER_DATA) < 0,
+            "errno (%s)", strerror(errno));
+    fail_if(mqi_drop_changeset_trigger(second, changeset_event_cb,
+                                       OTHER_CHANGESET_DATA) < 0,
+            "errno (%s)", strerror(errno));
+    fail_if(mqi_drop_table(first) < 0, "errno (%s)", strerror(errno));
+    fail_if(mqi_drop_table(second) < 0, "errno (%s)", strerror(errno));
+}
+END_TEST
+
 START_TEST(sequential_transactions)
 {
     mqi_handle_t  trh;
@@ -869,6 +1299,211 @@ START_TEST(nested_transactions)
 }
 END_TEST
 
+START_TEST(persistent_table_replay)
+{
+    static uint32_t idlimit = 600;
+    static query_t  kalle = {1, "Korhonen", "Kalle"};
+
+    MQI_WHERE_CLAUSE(where,
+        MQI_LESS( MQI_COLUMN(3), MQI_UNSIGNED_VAR(idlimit) )
+    );
+
+    MQI_WHERE_CLAUSE(chucks,
+        MQI_EQUAL( MQI_COLUMN(3), MQI_UNSIGNED_VAR(chuck.id) )
+    );
+
+    mqi_handle_t journal, tx;
+    query_t rows[32], replayed[32];
+    char names[32][16], wal[256], snapshot[280];
+    int pass, i, n, nrow;
+
+    PREREQUISITE(open_db);
+
+    snprintf(wal, sizeof(wal), "/tmp/check-libmqi-%u.wal", getpid());
+    unlink(wal);
+
+    fail_if(mdb_wal_open(wal, 4) < 0, "errno (%s)", strerror(errno));
+
+    journal = MQI_CREATE_TABLE("journal", MQI_PERSISTENT, persons_coldefs,
+                               ids_indexdef);
+
+    fail_if(journal == MQI_HANDLE_INVALID, "errno (%s)", strerror(errno));
+
+    tx = MQI_BEGIN;
+    n  = MQI_INSERT_INTO(journal, persons_insert_columns, artists);
+
+    fail_if(n != MQI_DIMENSION(artists)-1, "insertion failed (%s)",
+            strerror(errno));
+    fail_if(MQI_COMMIT(tx) < 0, "errno (%s)", strerror(errno));
+
+    n = MQI_DELETE(journal, where);
+
+    fail_if(n != 2, "deleted %d rows instead of 2", n);
+
+    tx = MQI_BEGIN;
+    n  = MQI_UPDATE(journal, persons_select_columns, &kalle, chucks);
+
+    fail_if(n != 1, "updated %d rows instead of 1", n);
+    fail_if(MQI_COMMIT(tx) < 0, "errno (%s)", strerror(errno));
+
+    tx = MQI_BEGIN;
+    n  = MQI_DELETE(journal, MQI_ALL);
+
+    fail_if(n <= 0, "delete failed (%s)", strerror(errno));
+    fail_if(MQI_ROLLBACK(tx) < 0, "errno (%s)", strerror(errno));
+
+    nrow = MQI_SELECT(persons_select_columns, journal, MQI_ALL, rows);
+
+    fail_if(nrow != MQI_DIMENSION(artists)-3, "selected %d rows instead "
+            "of %d", nrow, MQI_DIMENSION(artists)-3);
+
+    /* selected strings point to the rows, which go away with the table */
+    for (i = 0;  i < nrow;  i++)
+        snprintf(names[i], sizeof(names[i]), "%s", rows[i].first_name);
+
+    /*
+     * first restore by replaying the log, then from the snapshot
+     * written by compacting the log
+     */
+    for (pass = 0;  pass < 2;  pass++) {
+        fail_if(mqi_drop_table(journal) < 0, "errno (%s)", strerror(errno));
+
+        if (pass == 0) {
+            fail_if(mdb_wal_close() < 0, "errno (%s)", strerror(errno));
+            fail_if(mdb_wal_open(wal, 4) < 0, "errno (%s)", strerror(errno));
+        }
+
+        journal = MQI_CREATE_TABLE("journal", MQI_PERSISTENT,
+                                   persons_coldefs, ids_indexdef);
+
+        fail_if(journal == MQI_HANDLE_INVALID, "errno (%s)",strerror(errno));
+
+        n = MQI_SELECT(persons_select_columns, journal, MQI_ALL, replayed);
+
+        fail_if(n != nrow, "restored %d rows instead of %d", n, nrow);
+
+        for (i = 0;  i < n;  i++) {
+            fail_if(rows[i].id != replayed[i].id ||
+                    strcmp(names[i], replayed[i].first_name),
+                    "restored row %d (%s, id %u) differs from the original "
+                    "(%s, id %u)", i, replayed[i].first_name,
+                    replayed[i].id, names[i], rows[i].id);
+        }
+
+        if (pass == 0) {
+            /* compacting would snapshot uncommitted changes */
+            tx = MQI_BEGIN;
+            fail_if(mdb_wal_compact() == 0, "compacted inside transaction");
+            fail_if(MQI_ROLLBACK(tx) < 0, "errno (%s)", strerror(errno));
+
+            fail_if(mdb_wal_compact() < 0, "errno (%s)", strerror(errno));
+        }
+    }
+
+    fail_if(mqi_drop_table(journal) < 0, "errno (%s)", strerror(errno));
+    fail_if(mdb_wal_close() < 0, "errno (%s)", strerror(errno));
+
+    snprintf(snapshot, sizeof(snapshot), "%s.journal.2", wal);
+    unlink(snapshot);
+    unlink(wal);
+}
+END_TEST
+
+START_TEST(persistent_table_failed_write)
+{
+    static record_t *before[] = {&chuck, &gary, NULL};
+    static record_t *failed[] = {&elvis, NULL};
+    static record_t *after[]  = {&tom, &greta, NULL};
+    static uint32_t  order[]  = {500, 700, 1100, 2000};
+
+    mqi_handle_t  torn, tx;
+    query_t       rows[32];
+    struct stat   st;
+    struct rlimit rl, saved;
+    off_t         size;
+    char          wal[256];
+    int           i, n, sts;
+
+    PREREQUISITE(open_db);
+
+    snprintf(wal, sizeof(wal), "/tmp/check-libmqi-torn-%u.wal", getpid());
+    unlink(wal);
+
+    fail_if(mdb_wal_open(wal, 1) < 0, "errno (%s)", strerror(errno));
+
+    torn = MQI_CREATE_TABLE("torn", MQI_PERSISTENT, persons_coldefs,
+                            ids_indexdef);
+
+    fail_if(torn == MQI_HANDLE_INVALID, "errno (%s)", strerror(errno));
+
+    tx = MQI_BEGIN;
+    n  = MQI_INSERT_INTO(torn, persons_insert_columns, before);
+
+    fail_if(n != 2, "insertion failed (%s)", strerror(errno));
+    fail_if(MQI_COMMIT(tx) < 0, "errno (%s)", strerror(errno));
+
+    /*
+     * let the next record get only partially written, then fail with
+     * EFBIG instead of getting killed by SIGXFSZ
+     */
+    fail_if(stat(wal, &st) < 0, "errno (%s)", strerror(errno));
+    fail_if(getrlimit(RLIMIT_FSIZE, &saved) < 0, "errno (%s)",
+            strerror(errno));
+
+    size = st.st_size;
+
+    signal(SIGXFSZ, SIG_IGN);
+    rl.rlim_cur = size + 8;
+    rl.rlim_max = saved.rlim_max;
+
+    fail_if(setrlimit(RLIMIT_FSIZE, &rl) < 0, "errno (%s)", strerror(errno));
+
+    tx  = MQI_BEGIN;
+    n   = MQI_INSERT_INTO(torn, persons_insert_columns, failed);
+    sts = MQI_COMMIT(tx);
+
+    setrlimit(RLIMIT_FSIZE, &saved);
+    signal(SIGXFSZ, SIG_DFL);
+
+    fail_if(n != 1, "insertion failed (%s)", strerror(errno));
+    fail_if(sts == 0, "commit succeeded despite the failed log write");
+
+    fail_if(stat(wal, &st) < 0, "errno (%s)", strerror(errno));
+    fail_if(st.st_size != size, "torn record was left in the log");
+
+    /* commits after the failed one must survive reopening the log */
+    tx = MQI_BEGIN;
+    n  = MQI_INSERT_INTO(torn, persons_insert_columns, after);
+
+    fail_if(n != 2, "insertion failed (%s)", strerror(errno));
+    fail_if(MQI_COMMIT(tx) < 0, "errno (%s)", strerror(errno));
+
+    fail_if(mqi_drop_table(torn) < 0, "errno (%s)", strerror(errno));
+    fail_if(mdb_wal_close() < 0, "errno (%s)", strerror(errno));
+    fail_if(mdb_wal_open(wal, 1) < 0, "errno (%s)", strerror(errno));
+
+    torn = MQI_CREATE_TABLE("torn", MQI_PERSISTENT, persons_coldefs,
+                            ids_indexdef);
+
+    fail_if(torn == MQI_HANDLE_INVALID, "errno (%s)", strerror(errno));
+
+    n = MQI_SELECT(persons_select_columns, torn, MQI_ALL, rows);
+
+    fail_if(n != MQI_DIMENSION(order), "restored %d rows instead of %d",
+            n, MQI_DIMENSION(order));
+
+    for (i = 0;  i < n;  i++) {
+        fail_if(rows[i].id != order[i], "restored row %d has id %u instead "
+                "of %u", i, rows[i].id, order[i]);
+    }
+
+    fail_if(mqi_drop_table(torn) < 0, "errno (%s)", strerror(errno));
+    fail_if(mdb_wal_close() < 0, "errno (%s)", strerror(errno));
+
+    unlink(wal);
+}
+END_TEST
+
 
 
 static Suite *libmqi_suite(void)
@@ -895,15 +1530,23 @@ static TCase *basic_tests(void)
     tcase_add_test(tc, replace_in_persons);
     tcase_add_test(tc, filtered_select_from_persons);
     tcase_add_test(tc, full_select_from_persons);
+    tcase_add_test(tc, cursor_select_from_persons);
     tcase_add_test(tc, select_from_persons_by_index);
+    tcase_add_test(tc, range_select_from_ids);
+    tcase_add_test(tc, secondary_index_on_ids);
+    tcase_add_test(tc, bulk_insert_and_snapshot);
     tcase_add_test(tc, update_in_persons);
     tcase_add_test(tc, delete_from_persons);
     tcase_add_test(tc, transaction_rollback);
     tcase_add_test(tc, table_trigger);
     tcase_add_test(tc, row_trigger);
     tcase_add_test(tc, column_trigger);
+    tcase_add_test(tc, changeset_trigger);
+    tcase_add_test(tc, interleaved_changeset_trigger);
     tcase_add_test(tc, sequential_transactions);
     tcase_add_test(tc, nested_transactions);
+    tcase_add_test(tc, persistent_table_replay);
+    tcase_add_test(tc, persistent_table_failed_write);
 
     return tc;
 }
@@ -1172,6 +1815,48 @@ static void column_event_cb(mqi_event_t *evt, void *user_data)
 #undef PRINT_VALUE
 }
 
+static void changeset_event_cb(mqi_event_t *evt, void *user_data)
+{
+    mqi_changeset_event_t *ce = &evt->changeset;
+    mqi_row_change_t      *c;
+    changeset_t           *cs;
+    query_t               *row;
+    int                    i;
+
+    if (user_data == CHANGESET_TRIGGER_DATA)
+        cs = &changeset;
+    else if (user_data == OTHER_CHANGESET_DATA)
+        cs = &other_changeset;
+    else
+        cs = NULL;
+
+    if (evt->event != mqi_table_changed || !cs) {
+        if (verbose)
+            printf("invalid event %d for changeset trigger\n", evt->event);
+        return;
+    }
+
+    cs->ncallback++;
+    cs->ninsert = ce->ninsert;
+    cs->ndelete = ce->ndelete;
+    cs->nupdate = ce->nupdate;
+    cs->nchange = ce->nchange;
+
+    for (i = 0;  i < ce->nchange;  i++) {
+        if (i >= (int)MQI_DIMENSION(cs->change))
+            break;
+
+        c = ce->changes + i;
+
+        cs->change[i].event = c->event;
+
+        if ((row = (query_t *)c->before))
+            cs->change[i].before = row->id;
+        if ((row = (query_t *)c->after))
+            cs->change[i].after = row->id;
+    }
+}
+
 /*
  * Local Variables:
  * c-basic-offset: 4
@@ -0,0 +1,268 @@
+/*
+ * Copyright (c) 2012, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Microbenchmark for evaluating conditions in murphy-db.
+ *
+ * Scans a table row by row with a few compound predicates, the way a
+ * conditional select, update or delete does, and compares the rows/s
+ * of the condition interpreter to that of compiled conditions.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <libgen.h>
+
+#include <murphy-db/mqi.h>
+#include "mdb/row.h"
+#include "mdb/table.h"
+#include "mdb/cond.h"
+
+
+typedef struct {
+    uint32_t    id;
+    int32_t     value;
+    uint32_t    klass;
+    const char *name;
+} record_t;
+
+static mqi_column_def_t defs[] = {
+    { "id"   , mqi_unsignd, 0 , 0 },
+    { "value", mqi_integer, 0 , 0 },
+    { "class", mqi_unsignd, 0 , 0 },
+    { "name" , mqi_varchar, 16, 0 },
+    {  NULL  , 0          , 0 , 0 }
+};
+
+static mqi_column_desc_t cds[] = {
+    { 0, MQI_OFFSET(record_t, id   ) },
+    { 1, MQI_OFFSET(record_t, value) },
+    { 2, MQI_OFFSET(record_t, klass) },
+    { 3, MQI_OFFSET(record_t, name ) },
+    {-1, -1                          }
+};
+
+static const char *names[] = {
+    "audio", "video", "phone", "navigator", "player", "camera", "radio"
+};
+
+static int32_t     lo = -250, hi = 250;
+static uint32_t    one = 1, three = 3, five = 5, idmax = 1000;
+static const char *audio = "audio", *phone = "phone", *radio = "radio";
+
+/* value >= lo and value < hi and class = 3 */
+MQI_WHERE_CLAUSE(range_and,
+    MQI_GREATER_OR_EQUAL( MQI_COLUMN(1), MQI_INTEGER_VAR(lo)   ) MQI_AND
+    MQI_LESS            ( MQI_COLUMN(1), MQI_INTEGER_VAR(hi)   ) MQI_AND
+    MQI_EQUAL           ( MQI_COLUMN(2), MQI_UNSIGNED_VAR(three) )
+);
+
+/* (class = 1 or class = 3 or class = 5) and value > lo */
+MQI_WHERE_CLAUSE(or_and,
+    MQI_OPERATOR(begin),
+        MQI_EQUAL( MQI_COLUMN(2), MQI_UNSIGNED_VAR(one)   ) MQI_OR
+        MQI_EQUAL( MQI_COLUMN(2), MQI_UNSIGNED_VAR(three) ) MQI_OR
+        MQI_EQUAL( MQI_COLUMN(2), MQI_UNSIGNED_VAR(five)  )
+    MQI_OPERATOR(end), MQI_AND
+    MQI_GREATER( MQI_COLUMN(1), MQI_INTEGER_VAR(lo) )
+);
+
+/* name = 'audio' or name = 'phone' or name = 'radio' and id < 1000 */
+MQI_WHERE_CLAUSE(strings,
+    MQI_EQUAL( MQI_COLUMN(3), MQI_STRING_VAR(audio) ) MQI_OR
+    MQI_EQUAL( MQI_COLUMN(3), MQI_STRING_VAR(phone) ) MQI_OR
+    MQI_EQUAL( MQI_COLUMN(3), MQI_STRING_VAR(radio) ) MQI_AND
+    MQI_LESS ( MQI_COLUMN(0), MQI_UNSIGNED_VAR(idmax) )
+);
+
+/* not (value < lo) and (class = 1 or name = 'radio') */
+MQI_WHERE_CLAUSE(nested,
+    MQI_OPERATOR(not), MQI_OPERATOR(begin),
+        MQI_LESS( MQI_COLUMN(1), MQI_INTEGER_VAR(lo) )
+    MQI_OPERATOR(end), MQI_AND
+    MQI_OPERATOR(begin),
+        MQI_EQUAL( MQI_COLUMN(2), MQI_UNSIGNED_VAR(one)   ) MQI_OR
+        MQI_EQUAL( MQI_COLUMN(3), MQI_STRING_VAR(radio) )
+    MQI_OPERATOR(end),
+);
+
+static struct {
+    const char       *name;
+    mqi_cond_entry_t *cond;
+} predicates[] = {
+    { "range-and", range_and },
+    { "or-and"   , or_and    },
+    { "strings"  , strings   },
+    { "nested"   , nested    },
+};
+
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + ts.tv_nsec / 1000000000.0;
+}
+
+static void report(const char *pred, const char *engine, int nrow, int nmatch,
+                   double t)
+{
+    printf("%-10s %-12s %10d rows %8d matches %8.3f s %12.0f rows/s\n",
+           pred, engine, nrow, nmatch, t, t > 0 ? nrow / t : 0.0);
+}
+
+static int interpret(mdb_table_t *tbl, mqi_cond_entry_t *cond)
+{
+    mqi_cond_entry_t *ce;
+    mdb_row_t        *row;
+    int               nmatch = 0;
+
+    MDB_DLIST_FOR_EACH(mdb_row_t, link, row, &tbl->rows) {
+        ce = cond;
+        if (mdb_cond_evaluate(tbl, &ce, row->data))
+            nmatch++;
+    }
+
+    return nmatch;
+}
+
+static int compiled(mdb_table_t *tbl, mqi_cond_entry_t *cond)
+{
+    mdb_cond_t *cc;
+    mdb_row_t  *row;
+    int         nmatch = 0;
+
+    if (!(cc = mdb_cond_compile(tbl, cond)))
+        return -1;
+
+    MDB_DLIST_FOR_EACH(mdb_row_t, link, row, &tbl->rows) {
+        if (mdb_cond_match(cc, row->data))
+            nmatch++;
+    }
+
+    mdb_cond_free(cc);
+
+    return nmatch;
+}
+
+static int run(mdb_table_t *tbl, int j, int nrow, int npass)
+{
+    mqi_cond_entry_t *cond = predicates[j].cond;
+    double            t;
+    int               i, n1, n2;
+
+    t = now();
+    for (i = 0, n1 = 0;  i < npass;  i++)
+        n1 = interpret(tbl, cond);
+    report(predicates[j].name, "interpreted", nrow * npass, n1, now() - t);
+
+    t = now();
+    for (i = 0, n2 = 0;  i < npass;  i++)
+        n2 = compiled(tbl, cond);
+    report(predicates[j].name, "compiled", nrow * npass, n2, now() - t);
+
+    if (n1 != n2) {
+        printf("%s: interpreted and compiled matches differ (%d vs. %d)\n",
+               predicates[j].name, n1, n2);
+        return -1;
+    }
+
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    mdb_table_t *tbl;
+    record_t     rec;
+    void        *data[2] = { &rec, NULL };
+    int          nrow, npass, i, j;
+
+    nrow  = 100000;
+    npass = 10;
+
+    for (i = 1;  i < argc;  i++) {
+        if (!strcmp(argv[i], "-n") && i < argc - 1)
+            nrow = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-p") && i < argc - 1)
+            npass = atoi(argv[++i]);
+        else {
+            printf("Usage: %s [-h] [-n <rows>] [-p <passes>]\n"
+                   "  -h     prints this message\n"
+                   "  -n     number of rows in the table (default 100000)\n"
+                   "  -p     number of scans per predicate (default 10)\n",
+                   basename(argv[0]));
+            exit(strcmp(argv[i], "-h") ? 1 : 0);
+        }
+    }
+
+    if (nrow < 1 || npass < 1) {
+        printf("invalid number of rows or passes\n");
+        exit(1);
+    }
+
+    if (!(tbl = mdb_table_create("bench", NULL, defs))) {
+        printf("failed to create table (%s)\n", strerror(errno));
+        exit(1);
+    }
+
+    for (i = 0;  i < nrow;  i++) {
+        rec.id    = i;
+        rec.value = (int32_t)(((uint32_t)i * 2654435761U) % 2001) - 1000;
+        rec.klass = i % 7;
+        rec.name  = names[(i / 7) % MQI_DIMENSION(names)];
+
+        if (mdb_table_insert(tbl, 0, cds, data) < 0) {
+            printf("failed to insert row #%d (%s)\n", i, strerror(errno));
+            exit(1);
+        }
+    }
+
+    for (j = 0;  j < (int)MQI_DIMENSION(predicates);  j++) {
+        if (run(tbl, j, nrow, npass) < 0)
+            exit(1);
+    }
+
+    mdb_table_drop(tbl);
+
+    return 0;
+}
+
+/*
+ * Local Variables:
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ *
+ */
@@ -0,0 +1,352 @@
+/*
+ * Copyright (c) 2012, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Microbenchmark for the murphy-db hash tables.
+ *
+ * Measures insert, lookup (hit and miss) and delete throughput of the
+ * mdb_hash_* tables against a reference implementation of the chained
+ * hash table murphy-db used to have: a fixed, prime number of chains
+ * (101 for table indices, at most 65535), one allocation per entry and
+ * keys hashed and compared through function pointers.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <libgen.h>
+
+#include <murphy-db/list.h>
+#include <murphy-db/hash.h>
+
+
+/*
+ * reference chained hash table
+ */
+
+typedef struct {
+    mdb_dlist_t  clink;
+    mdb_dlist_t  elink;
+    void        *key;
+    void        *data;
+} chained_entry_t;
+
+typedef struct {
+    mdb_dlist_t  entries;
+    int        (*hfunc)(int, int, void *);
+    int        (*hcomp)(int, void *, void *);
+    int          nchain;
+    mdb_dlist_t  chains[0];
+} chained_t;
+
+static int chained_hash_unsignd(int nchain, int klen, void *key)
+{
+    if (klen != sizeof(uint32_t) || !key)
+        return 0;
+
+    return (int)(*(uint32_t *)key % nchain);
+}
+
+static chained_t *chained_create(int nchain)
+{
+    chained_t *ch;
+    int        i;
+
+    if (!(ch = calloc(1, sizeof(*ch) + sizeof(mdb_dlist_t) * nchain)))
+        return NULL;
+
+    ch->nchain = nchain;
+    ch->hfunc  = chained_hash_unsignd;
+    ch->hcomp  = mqi_data_compare_unsignd;
+    MDB_DLIST_INIT(ch->entries);
+
+    for (i = 0;  i < nchain;  i++)
+        MDB_DLIST_INIT(ch->chains[i]);
+
+    return ch;
+}
+
+static void chained_destroy(chained_t *ch)
+{
+    chained_entry_t *e, *n;
+
+    MDB_DLIST_FOR_EACH_SAFE(chained_entry_t, elink, e,n, &ch->entries) {
+        MDB_DLIST_UNLINK(chained_entry_t, elink, e);
+        free(e);
+    }
+
+    free(ch);
+}
+
+static inline mdb_dlist_t *chained_chain(chained_t *ch, uint32_t key)
+{
+    return ch->chains + ch->hfunc(ch->nchain, sizeof(key), &key);
+}
+
+static int chained_add(chained_t *ch, uint32_t *key, void *data)
+{
+    mdb_dlist_t     *head = chained_chain(ch, *key);
+    chained_entry_t *e;
+
+    MDB_DLIST_FOR_EACH(chained_entry_t, clink, e, head) {
+        if (!ch->hcomp(sizeof(*key), key, e->key)) {
+            errno = EEXIST;
+            return -1;
+        }
+    }
+
+    if (!(e = calloc(1, sizeof(*e))))
+        return -1;
+
+    e->key  = key;
+    e->data = data;
+
+    MDB_DLIST_APPEND(chained_entry_t, clink, e, head);
+    MDB_DLIST_APPEND(chained_entry_t, elink, e, &ch->entries);
+
+    return 0;
+}
+
+static void *chained_get(chained_t *ch, uint32_t *key)
+{
+    mdb_dlist_t     *head = chained_chain(ch, *key);
+    chained_entry_t *e;
+
+    MDB_DLIST_FOR_EACH(chained_entry_t, clink, e, head) {
+        if (!ch->hcomp(sizeof(*key), key, e->key))
+            return e->data;
+    }
+
+    return NULL;
+}
+
+static void *chained_delete(chained_t *ch, uint32_t *key)
+{
+    mdb_dlist_t     *head = chained_chain(ch, *key);
+    chained_entry_t *e;
+    void            *data;
+
+    MDB_DLIST_FOR_EACH(chained_entry_t, clink, e, head) {
+        if (!ch->hcomp(sizeof(*key), key, e->key)) {
+            data = e->data;
+            MDB_DLIST_UNLINK(chained_entry_t, clink, e);
+            MDB_DLIST_UNLINK(chained_entry_t, elink, e);
+            free(e);
+            return data;
+        }
+    }
+
+    return NULL;
+}
+
+
+/*
+ * benchmark driver
+ */
+
+typedef struct {
+    const char *name;
+    void *(*create)(void);
+    void  (*destroy)(void *);
+    int   (*add)(void *, uint32_t *, void *);
+    void *(*get)(void *, uint32_t *);
+    void *(*del)(void *, uint32_t *);
+} engine_t;
+
+static void *mdb_create(void)
+{
+    return MDB_HASH_TABLE_CREATE(unsignd, 100);
+}
+
+static void mdb_destroy(void *h)
+{
+    mdb_hash_table_destroy(h);
+}
+
+static int mdb_add(void *h, uint32_t *key, void *data)
+{
+    return mdb_hash_add(h, sizeof(*key), key, data);
+}
+
+static void *mdb_get(void *h, uint32_t *key)
+{
+    return mdb_hash_get_data(h, sizeof(*key), key);
+}
+
+static void *mdb_del(void *h, uint32_t *key)
+{
+    return mdb_hash_delete(h, sizeof(*key), key);
+}
+
+static int nchain = 101;
+
+static void *ref_create(void)
+{
+    return chained_create(nchain);
+}
+
+static void ref_destroy(void *h)
+{
+    chained_destroy(h);
+}
+
+static int ref_add(void *h, uint32_t *key, void *data)
+{
+    return chained_add(h, key, data);
+}
+
+static void *ref_get(void *h, uint32_t *key)
+{
+    return chained_get(h, key);
+}
+
+static void *ref_del(void *h, uint32_t *key)
+{
+    return chained_delete(h, key);
+}
+
+static engine_t engines[] = {
+    { "chained" , ref_create, ref_destroy, ref_add, ref_get, ref_del },
+    { "openaddr", mdb_create, mdb_destroy, mdb_add, mdb_get, mdb_del },
+};
+
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + ts.tv_nsec / 1000000000.0;
+}
+
+static void report(const char *engine, const char *op, int n, double t)
+{
+    printf("%-10s %-12s %10d ops %8.3f s %12.0f ops/s\n", engine, op, n, t,
+           t > 0 ? n / t : 0.0);
+}
+
+static int run(engine_t *e, uint32_t *keys, uint32_t *misses, int n)
+{
+    void   *h;
+    double  t;
+    int     i, nfound;
+
+    if (!(h = e->create())) {
+        printf("failed to create %s hash table\n", e->name);
+        return -1;
+    }
+
+    t = now();
+    for (i = 0;  i < n;  i++) {
+        if (e->add(h, keys + i, keys + i) < 0) {
+            printf("%s: insertion failed (%s)\n", e->name, strerror(errno));
+            return -1;
+        }
+    }
+    report(e->name, "insert", n, now() - t);
+
+    t = now();
+    for (i = 0, nfound = 0;  i < n;  i++)
+        nfound += (e->get(h, keys + i) == keys + i);
+    report(e->name, "lookup-hit", n, now() - t);
+
+    if (nfound != n) {
+        printf("%s: found only %d of %d entries\n", e->name, nfound, n);
+        return -1;
+    }
+
+    t = now();
+    for (i = 0, nfound = 0;  i < n;  i++)
+        nfound += (e->get(h, misses + i) != NULL);
+    report(e->name, "lookup-miss", n, now() - t);
+
+    t = now();
+    for (i = 0;  i < n;  i++)
+        e->del(h, keys + i);
+    report(e->name, "delete", n, now() - t);
+
+    e->destroy(h);
+
+    return nfound ? -1 : 0;
+}
+
+int main(int argc, char *argv[])
+{
+    uint32_t *keys, *misses;
+    int       n, i, j;
+
+    n = 100000;
+
+    for (i = 1;  i < argc;  i++) {
+        if (!strcmp(argv[i], "-n") && i < argc - 1)
+            n = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-c") && i < argc - 1)
+            nchain = atoi(argv[++i]);
+        else {
+            printf("Usage: %s [-h] [-n <entries>] [-c <chains>]\n"
+                   "  -h     prints this message\n"
+                   "  -n     number of entries to insert (default 100000)\n"
+                   "  -c     number of chains in the reference table "
+                   "(default 101)\n", basename(argv[0]));
+            exit(strcmp(argv[i], "-h") ? 1 : 0);
+        }
+    }
+
+    if (n < 1 || nchain < 1 ||
+        !(keys = malloc(sizeof(*keys) * n)) ||
+        !(misses = malloc(sizeof(*misses) * n)))
+    {
+        printf("invalid number of entries or out of memory\n");
+        exit(1);
+    }
+
+    /*
+     * Multiplying by an odd constant permutes 32-bit integers and keeps
+     * their parity, so this gives us n distinct, scattered keys that are
+     * present in the table (odd) and another n that are not (even).
+     */
+    for (i = 0;  i < n;  i++) {
+        keys[i]   = (2 * (uint32_t)i + 1) * 2654435761U;
+        misses[i] = (2 * (uint32_t)i + 2) * 2654435761U;
+    }
+
+    for (j = 0;  j < (int)MQI_DIMENSION(engines);  j++) {
+        if (run(engines + j, keys, misses, n) < 0)
+            exit(1);
+    }
+
+    free(keys);
+    free(misses);
+
+    return 0;
+}
@@ -118,10 +118,12 @@ mrp_domctl_t *mrp_domctl_create(const char *name, mrp_mainloop_t *ml,
         dc->name    = mrp_strdup(name);
         dc->tables  = mrp_allocz_array(typeof(*dc->tables) , ntable);
         dc->watches = mrp_allocz_array(typeof(*dc->watches), nwatch);
+        dc->cache   = mrp_allocz_array(typeof(*dc->cache)  , nwatch);
 
         if (dc->name != NULL &&
             (dc->tables  != NULL || ntable == 0) &&
-            (dc->watches != NULL || nwatch == 0)) {
+            (dc->watches != NULL || nwatch == 0) &&
+            (dc->cache   != NULL || nwatch == 0)) {
             for (i = 0; i < ntable; i++) {
                 st = tables + i;
                 dt = dc->tables + i;
@@ -168,12 +170,20 @@ mrp_domctl_t *mrp_domctl_create(const char *name, mrp_mainloop_t *ml,
 }
 
 
+static void purge_cache(domctl_cache_t *c);
+
 static void destroy_domctl(mrp_domctl_t *dc)
 {
     int i;
 
     purge_pending(dc);
 
+    if (dc->cache != NULL) {
+        for (i = 0; i < dc->nwatch; i++)
+            purge_cache(dc->cache + i);
+        mrp_free(dc->cache);
+    }
+
     for (i = 0; i < dc->ntable; i++) {
         mrp_free((char *)dc->tables[i].table);
         mrp_free((char *)dc->tables[i].mql_columns);
@@ -247,6 +257,7 @@ static int domctl_register(mrp_domctl_t *dc)
     reg.ntable  = dc->ntable;
     reg.watches = dc->watches;
     reg.nwatch  = dc->nwatch;
+    reg.caps    = MSG_CAP_DELTA;
 
     msg = msg_encode_message((msg_t *)&reg);
 
@@ -500,9 +511,384 @@ static void process_nak(mrp_domctl_t *dc, nak_msg_t *nak)
 }
 
 
+/*
+ * The server sends a full snapshot of a watched table the first time
+ * and only the row changes after that. We keep a copy of the rows of
+ * each watched table, apply the changes to it and pass the copy to the
+ * watch callback. Rows are matched for deletes and updates by value.
+ */
+
+static mrp_domctl_value_t *copy_row(mrp_domctl_value_t *src, int ncol)
+{
+    mrp_domctl_value_t *row;
+    int                 i;
+
+    row = mrp_allocz_array(typeof(*row), ncol);
+
+    if (row == NULL)
+        return NULL;
+
+    for (i = 0; i < ncol; i++) {
+        row[i] = src[i];
+
+        if (src[i].type == MRP_DOMCTL_STRING) {
+            row[i].str = mrp_strdup(src[i].str);
+
+            if (row[i].str == NULL) {
+                while (--i >= 0)
+                    if (row[i].type == MRP_DOMCTL_STRING)
+                        mrp_free((char *)row[i].str);
+                mrp_free(row);
+
+                return NULL;
+            }
+        }
+    }
+
+    return row;
+}
+
+
+static void free_row(mrp_domctl_value_t *row, int ncol)
+{
+    int i;
+
+    if (row == NULL)
+        return;
+
+    for (i = 0; i < ncol; i++)
+        if (row[i].type == MRP_DOMCTL_STRING)
+            mrp_free((char *)row[i].str);
+
+    mrp_free(row);
+}
+
+
+static int same_row(mrp_domctl_value_t *r1, mrp_domctl_value_t *r2, int ncol)
+{
+    int i;
+
+    for (i = 0; i < ncol; i++) {
+        if (r1[i].type != r2[i].type)
+            return FALSE;
+
+        switch (r1[i].type) {
+        case MRP_DOMCTL_STRING:
+            if (strcmp(r1[i].str, r2[i].str))
+                return FALSE;
+            break;
+        case MRP_DOMCTL_INTEGER:
+            if (r1[i].s32 != r2[i].s32)
+                return FALSE;
+            break;
+        case MRP_DOMCTL_UNSIGNED:
+            if (r1[i].u32 != r2[i].u32)
+                return FALSE;
+            break;
+        case MRP_DOMCTL_DOUBLE:
+            if (r1[i].dbl != r2[i].dbl)
+                return FALSE;
+            break;
+        default:
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+
+static uint32_t hash_bytes(uint32_t h, const void *data, size_t size)
+{
+    const uint8_t *p = data;
+
+    while (size-- > 0)
+        h = (h ^ *p++) * 16777619U;
+
+    return h;
+}
+
+
+static uint32_t hash_row(mrp_domctl_value_t *row, int ncol)
+{
+    uint32_t h;
+    double   dbl;
+    int      i;
+
+    for (i = 0, h = 2166136261U; i < ncol; i++) {
+        h = hash_bytes(h, &row[i].type, sizeof(row[i].type));
+
+        switch (row[i].type) {
+        case MRP_DOMCTL_STRING:
+            h = hash_bytes(h, row[i].str, strlen(row[i].str));
+            break;
+        case MRP_DOMCTL_INTEGER:
+            h = hash_bytes(h, &row[i].s32, sizeof(row[i].s32));
+            break;
+        case MRP_DOMCTL_UNSIGNED:
+            h = hash_bytes(h, &row[i].u32, sizeof(row[i].u32));
+            break;
+        case MRP_DOMCTL_DOUBLE:
+            /* 0.0 and -0.0 are the same row for same_row */
+            dbl = row[i].dbl != 0 ? row[i].dbl : 0;
+            h   = hash_bytes(h, &dbl, sizeof(dbl));
+            break;
+        default:
+            break;
+        }
+    }
+
+    return h;
+}
+
+
+/*
+ * The cached rows are indexed by a hash of their content, so looking up
+ * the rows to delete or update does not need to scan the whole cache.
+ * Each bucket is a chain of row indices linked through next, with as
+ * many buckets as there are row slots.
+ */
+
+static inline int *cache_bucket(domctl_cache_t *c, uint32_t hash)
+{
+    return c->buckets + (hash & (c->nalloc - 1));
+}
+
+
+static void cache_link(domctl_cache_t *c, int idx)
+{
+    int *b = cache_bucket(c, c->hash[idx]);
+
+    c->next[idx] = *b;
+    *b           = idx;
+}
+
+
+static void cache_unlink(domctl_cache_t *c, int idx)
+{
+    int *p = cache_bucket(c, c->hash[idx]);
+
+    while (*p != idx)
+        p = c->next + *p;
+
+    *p = c->next[idx];
+}
+
+
+static void purge_cache(domctl_cache_t *c)
+{
+    int i;
+
+    for (i = 0; i < c->nrow; i++)
+        free_row(c->rows[i], c->ncolumn);
+
+    mrp_free(c->rows);
+    mrp_free(c->hash);
+    mrp_free(c->next);
+    mrp_free(c->buckets);
+
+    c->rows    = NULL;
+    c->hash    = NULL;
+    c->next    = NULL;
+    c->buckets = NULL;
+    c->nrow    = 0;
+    c->nalloc  = 0;
+}
+
+
+static int cache_grow(domctl_cache_t *c)
+{
+    int *buckets, n, i;
+
+    n = c->nalloc ? 2 * c->nalloc : 16;
+
+    if (!mrp_reallocz(c->rows, c->nalloc, n) ||
+        !mrp_reallocz(c->hash, c->nalloc, n) ||
+        !mrp_reallocz(c->next, c->nalloc, n))
+        return FALSE;
+
+    if ((buckets = mrp_allocz_array(typeof(*buckets), n)) == NULL)
+        return FALSE;
+
+    mrp_free(c->buckets);
+    c->buckets = buckets;
+    c->nalloc  = n;
+
+    for (i = 0; i < n; i++)
+        c->buckets[i] = -1;
+
+    for (i = 0; i < c->nrow; i++)
+        cache_link(c, i);
+
+    return TRUE;
+}
+
+
+static int cache_insert(domctl_cache_t *c, mrp_domctl_value_t *src)
+{
+    mrp_domctl_value_t *row;
+    int                 idx;
+
+    if (c->nrow >= c->nalloc && !cache_grow(c))
+        return FALSE;
+
+    if ((row = copy_row(src, c->ncolumn)) == NULL)
+        return FALSE;
+
+    idx = c->nrow++;
+
+    c->rows[idx] = row;
+    c->hash[idx] = hash_row(row, c->ncolumn);
+    cache_link(c, idx);
+
+    return TRUE;
+}
+
+
+static int cache_lookup(domctl_cache_t *c, mrp_domctl_value_t *row)
+{
+    uint32_t h;
+    int      i;
+
+    if (c->nrow == 0)
+        return -1;
+
+    h = hash_row(row, c->ncolumn);
+
+    for (i = *cache_bucket(c, h); i >= 0; i = c->next[i])
+        if (c->hash[i] == h && same_row(c->rows[i], row, c->ncolumn))
+            return i;
+
+    return -1;
+}
+
+
+static void cache_delete(domctl_cache_t *c, int idx)
+{
+    int last = c->nrow - 1;
+
+    cache_unlink(c, idx);
+    free_row(c->rows[idx], c->ncolumn);
+
+    if (idx != last) {
+        cache_unlink(c, last);
+        c->rows[idx] = c->rows[last];
+        c->hash[idx] = c->hash[last];
+        cache_link(c, idx);
+    }
+
+    c->rows[last] = NULL;
+    c->nrow--;
+}
+
+
+static int cache_update(domctl_cache_t *c, int idx, mrp_domctl_value_t *src)
+{
+    mrp_domctl_value_t *row;
+
+    if ((row = copy_row(src, c->ncolumn)) == NULL)
+        return FALSE;
+
+    cache_unlink(c, idx);
+    free_row(c->rows[idx], c->ncolumn);
+
+    c->rows[idx] = row;
+    c->hash[idx] = hash_row(row, c->ncolumn);
+    cache_link(c, idx);
+
+    return TRUE;
+}
+
+
+static int cache_snapshot(domctl_cache_t *c, mrp_domctl_data_t *d)
+{
+    int i;
+
+    purge_cache(c);
+    c->ncolumn = d->ncolumn;
+
+    for (i = 0; i < d->nrow; i++)
+        if (!cache_insert(c, d->rows[i]))
+            return FALSE;
+
+    return TRUE;
+}
+
+
+static int cache_delta(domctl_cache_t *c, mrp_domctl_data_t *d,
+                       notify_delta_t *delta)
+{
+    notify_change_t *ch;
+    int              i, idx;
+
+    if (c->nrow == 0)
+        c->ncolumn = d->ncolumn;
+    else if (d->ncolumn != c->ncolumn)
+        return FALSE;
+
+    for (i = 0, ch = delta->changes; i < delta->nchange; i++, ch++) {
+        switch (ch->op) {
+        case NOTIFY_ROW_INSERT:
+            if (!cache_insert(c, ch->after))
+                return FALSE;
+            break;
+
+        case NOTIFY_ROW_DELETE:
+            if ((idx = cache_lookup(c, ch->before)) < 0)
+                return FALSE;
+            cache_delete(c, idx);
+            break;
+
+        case NOTIFY_ROW_UPDATE:
+            if ((idx = cache_lookup(c, ch->before)) < 0)
+                return FALSE;
+            if (!cache_update(c, idx, ch->after))
+                return FALSE;
+            break;
+
+        default:
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+
 static void process_notify(mrp_domctl_t *dc, notify_msg_t *notify)
 {
-    dc->watch_cb(dc, notify->tables, notify->ntable, dc->user_data);
+    mrp_domctl_data_t *tables, *d;
+    domctl_cache_t    *c;
+    int                i, ok;
+
+    tables = alloca(sizeof(*tables) * (notify->ntable + 1));
+
+    for (i = 0; i < notify->ntable; i++) {
+        d = notify->tables + i;
+
+        if (d->id < 0 || d->id >= dc->nwatch)
+            ok = FALSE;
+        else {
+            c = dc->cache + d->id;
+
+            if (notify->deltas[i].delta)
+                ok = cache_delta(c, d, notify->deltas + i);
+            else
+                ok = cache_snapshot(c, d);
+        }
+
+        if (!ok) {
+            mrp_domctl_disconnect(dc);
+            notify_disconnect(dc, EINVAL, "failed to update watched tables");
+            return;
+        }
+
+        tables[i]      = *d;
+        tables[i].rows = c->rows;
+        tables[i].nrow = c->nrow;
+    }
+
+    dc->watch_cb(dc, tables, notify->ntable, dc->user_data);
 }
 
 
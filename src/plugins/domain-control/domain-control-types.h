@@ -38,6 +38,7 @@
 #include <murphy/common/hashtbl.h>
 #include <murphy/core/context.h>
 #include <murphy-db/mql.h>
+#include <murphy-db/mql-statement.h>
 
 #include "client.h"
 
@@ -47,6 +48,21 @@ typedef struct pep_watch_s pep_watch_t;
 typedef struct pdp_s       pdp_t;
 typedef union  msg_u       msg_t;
 
+
+/*
+ * cached data of a watched table (on the client side)
+ */
+
+typedef struct {
+    mrp_domctl_value_t **rows;           /* cached rows */
+    uint32_t            *hash;           /* hash of each cached row */
+    int                 *next;           /* next row in the same bucket */
+    int                 *buckets;        /* first row in each bucket */
+    int                  nrow;           /* number of rows */
+    int                  nalloc;         /* allocated row/bucket slots */
+    int                  ncolumn;        /* columns per row */
+} domctl_cache_t;
+
 /*
  * a domain controller (on the client side)
  */
@@ -73,9 +89,21 @@ struct mrp_domctl_s {
     uint32_t                 seqno;      /* request sequence number */
     mrp_list_hook_t          pending;    /* queue of outstanding requests */
     mrp_list_hook_t          methods;    /* registered proxied methods */
+    domctl_cache_t          *cache;      /* cached watched table data */
 };
 
 
+/*
+ * a row change recorded for delta notifications
+ */
+
+typedef struct {
+    mqi_event_type_t    event;           /* row insert, delete or update */
+    mrp_domctl_value_t *before;          /* row before change, or NULL */
+    mrp_domctl_value_t *after;           /* row after change, or NULL */
+} pep_change_t;
+
+
 /*
  * a table associated with or tracked by an enforcement point
  */
@@ -92,6 +120,9 @@ struct pep_table_s {
     int                 idx_col;         /* column index of index column */
     mrp_list_hook_t     watches;         /* watches for this table */
     bool                changed;         /* whether has unsynced changes */
+    pep_change_t       *changes;         /* changes since last notification */
+    int                 nchange;         /* number of recorded changes */
+    bool                snapshot;        /* changes lost, need full resync */
 };
 
 
@@ -104,11 +135,15 @@ struct pep_watch_s {
     char            *mql_columns;        /* column list to select */
     char            *mql_where;          /* where clause for select */
     int              max_rows;           /* max number of rows to select */
+    mql_statement_t *select;             /* precompiled select statement */
+    int             *columns;            /* selected column indices */
+    int              ncolumn;            /* number of selected columns */
     pep_proxy_t     *proxy;              /* enforcement point */
     int              id;                 /* table id within proxy */
     mrp_list_hook_t  tbl_hook;           /* hook to table watch list */
     mrp_list_hook_t  pep_hook;           /* hook to proxy watch list */
     bool             notify;             /* whether to notify this watch */
+    bool             synced;             /* whether client has the data */
 };
 
 
@@ -121,6 +156,7 @@ typedef struct {
     void (*unref)(void *data);
     int  (*create_notify)(pep_proxy_t *proxy);
     int  (*update_notify)(pep_proxy_t *proxy, int tblid, mql_result_t *r);
+    int  (*update_delta)(pep_proxy_t *proxy, pep_watch_t *w);
     int  (*send_notify)(pep_proxy_t *proxy);
     void (*free_notify)(pep_proxy_t *proxy);
 } proxy_ops_t;
@@ -136,6 +172,7 @@ struct pep_proxy_s {
     int                ntable;           /* number of tables */
     mrp_list_hook_t    watches;          /* tables watched by this */
     proxy_ops_t       *ops;              /* transport/messaging operations */
+    uint32_t           caps;             /* client capabilities */
     uint32_t           seqno;            /* request sequence number */
     mrp_list_hook_t    pending;          /* pending method invocations */
     void              *notify_msg;       /* notification being built */
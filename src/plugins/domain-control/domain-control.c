@@ -254,6 +254,8 @@ static void process_register(pep_proxy_t *proxy, register_msg_t *reg)
     int         error;
     const char *errmsg;
 
+    proxy->caps = reg->caps;
+
     if (register_proxy(proxy, reg->name, reg->tables, reg->ntable,
                        reg->watches, reg->nwatch, &error, &errmsg)) {
         msg_send_ack(proxy, reg->seq);
@@ -455,6 +457,23 @@ static int msg_op_update_notify(pep_proxy_t *proxy, int tblid, mql_result_t *r)
 }
 
 
+static int msg_op_update_delta(pep_proxy_t *proxy, pep_watch_t *w)
+{
+    int n;
+
+    n = msg_update_delta((mrp_msg_t *)proxy->notify_msg, w->id,
+                         w->table->changes, w->table->nchange,
+                         w->columns, w->ncolumn);
+
+    if (n >= 0) {
+        proxy->notify_ncolumn += n;
+        proxy->notify_ntable++;
+    }
+
+    return n;
+}
+
+
 static int msg_op_send_notify(pep_proxy_t *proxy)
 {
     mrp_msg_t *msg     = proxy->notify_msg;
@@ -482,6 +501,7 @@ static void msg_connect_cb(mrp_transport_t *t, void *user_data)
         .unref         = msg_op_unref_msg,
         .create_notify = msg_op_create_notify,
         .update_notify = msg_op_update_notify,
+        .update_delta  = msg_op_update_delta,
         .send_notify   = msg_op_send_notify,
         .free_notify   = msg_op_free_notify,
     };
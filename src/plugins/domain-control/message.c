@@ -92,6 +92,9 @@ mrp_msg_t *msg_encode_register(register_msg_t *reg)
         mrp_msg_append(msg, MSG_UINT16(MAXROWS, w->max_rows));
     }
 
+    if (reg->caps != MSG_CAP_NONE)
+        mrp_msg_append(msg, MSG_UINT32(CAPS, reg->caps));
+
     return msg;
 }
 
@@ -104,7 +107,7 @@ msg_t *msg_decode_register(mrp_msg_t *msg)
     mrp_domctl_watch_t *w;
     char               *name, *table, *columns, *index, *where;
     uint16_t            ntable, nwatch, max_rows;
-    uint32_t            seqno;
+    uint32_t            seqno, caps;
     int                 i;
 
     it = NULL;
@@ -165,6 +168,12 @@ msg_t *msg_decode_register(mrp_msg_t *msg)
 
     reg->nwatch = nwatch;
 
+    /* capabilities are optional, older clients do not send them */
+    if (mrp_msg_iterate_get(msg, &it, MSG_UINT32(CAPS, &caps), MSG_END))
+        reg->caps = caps;
+    else
+        reg->caps = MSG_CAP_NONE;
+
     reg->wire       = mrp_msg_ref(msg);
     reg->unref_wire = msg_unref_wire;
 
@@ -536,21 +545,19 @@ msg_t *msg_decode_set(mrp_msg_t *msg)
 void msg_free_notify(msg_t *msg)
 {
     notify_msg_t *notify = (notify_msg_t *)msg;
-    int           values_freed, i;
+    int           i;
 
     if (notify != NULL) {
-        values_freed = FALSE;
         for (i = 0; i < notify->ntable; i++) {
-            if (notify->tables[i].rows != NULL) {
-                if (!values_freed && notify->tables[i].rows[0] != NULL) {
-                    mrp_free(notify->tables[i].rows[0]);
-                    values_freed = TRUE;
-                }
-                mrp_free(notify->tables[i].rows);
-            }
+            mrp_free(notify->tables[i].rows);
+
+            if (notify->deltas != NULL)
+                mrp_free(notify->deltas[i].changes);
         }
 
         mrp_free(notify->tables);
+        mrp_free(notify->deltas);
+        mrp_free(notify->values);
         unref_wire((msg_t *)notify);
         mrp_free(notify);
     }
@@ -687,19 +694,179 @@ int msg_update_notify(mrp_msg_t *msg, int tblid, mql_result_t *r)
 }
 
 
+static int append_value(mrp_msg_t *msg, mrp_domctl_value_t *v)
+{
+    switch (v->type) {
+    case MRP_DOMCTL_STRING:
+        return mrp_msg_append(msg, MSG_STRING(DATA, v->str));
+    case MRP_DOMCTL_INTEGER:
+        return mrp_msg_append(msg, MSG_SINT32(DATA, v->s32));
+    case MRP_DOMCTL_UNSIGNED:
+        return mrp_msg_append(msg, MSG_UINT32(DATA, v->u32));
+    case MRP_DOMCTL_DOUBLE:
+        return mrp_msg_append(msg, MSG_DOUBLE(DATA, v->dbl));
+    default:
+        return FALSE;
+    }
+}
+
+
+static int append_row(mrp_msg_t *msg, mrp_domctl_value_t *row,
+                      int *columns, int ncolumn)
+{
+    int i;
+
+    for (i = 0; i < ncolumn; i++)
+        if (!append_value(msg, row + columns[i]))
+            return FALSE;
+
+    return TRUE;
+}
+
+
+static int same_value(mrp_domctl_value_t *v1, mrp_domctl_value_t *v2)
+{
+    if (v1->type != v2->type)
+        return FALSE;
+
+    switch (v1->type) {
+    case MRP_DOMCTL_STRING:   return !strcmp(v1->str, v2->str);
+    case MRP_DOMCTL_INTEGER:  return v1->s32 == v2->s32;
+    case MRP_DOMCTL_UNSIGNED: return v1->u32 == v2->u32;
+    case MRP_DOMCTL_DOUBLE:   return v1->dbl == v2->dbl;
+    default:                  return FALSE;
+    }
+}
+
+
+static int selection_changed(pep_change_t *c, int *columns, int ncolumn)
+{
+    int i;
+
+    for (i = 0; i < ncolumn; i++)
+        if (!same_value(c->before + columns[i], c->after + columns[i]))
+            return TRUE;
+
+    return FALSE;
+}
+
+
+int msg_update_delta(mrp_msg_t *msg, int tblid, pep_change_t *changes,
+                     int nchange, int *columns, int ncolumn)
+{
+    pep_change_t *c;
+    uint16_t      tid, ndelta, ncol;
+    uint8_t       op;
+    int           i, n;
+
+    /* updates not touching any of the selected columns are omitted */
+    for (i = 0, n = 0, c = changes; i < nchange; i++, c++) {
+        if (c->event != mqi_column_changed ||
+            selection_changed(c, columns, ncolumn))
+            n++;
+    }
+
+    /* the change log is capped, but never send a truncated count */
+    if (n > UINT16_MAX)
+        return -1;
+
+    tid    = tblid;
+    ndelta = n;
+    ncol   = ncolumn;
+    if (!mrp_msg_append(msg, MSG_UINT16(TBLID , tid))    ||
+        !mrp_msg_append(msg, MSG_UINT16(NDELTA, ndelta)) ||
+        !mrp_msg_append(msg, MSG_UINT16(NCOL  , ncol)))
+        return -1;
+
+    for (i = 0, n = 0, c = changes; i < nchange; i++, c++) {
+        switch (c->event) {
+        case mqi_row_inserted:
+            op = NOTIFY_ROW_INSERT;
+            break;
+        case mqi_row_deleted:
+            op = NOTIFY_ROW_DELETE;
+            break;
+        default:
+            if (!selection_changed(c, columns, ncolumn))
+                continue;
+            op = NOTIFY_ROW_UPDATE;
+            break;
+        }
+
+        if (!mrp_msg_append(msg, MSG_UINT8(ROWOP, op)))
+            return -1;
+
+        if (op != NOTIFY_ROW_INSERT) {
+            if (!append_row(msg, c->before, columns, ncolumn))
+                return -1;
+            n += ncolumn;
+        }
+
+        if (op != NOTIFY_ROW_DELETE) {
+            if (!append_row(msg, c->after, columns, ncolumn))
+                return -1;
+            n += ncolumn;
+        }
+    }
+
+    return n;
+}
+
+
+static int decode_row(mrp_msg_t *msg, void **it, mrp_domctl_value_t *v,
+                      int ncol)
+{
+    uint16_t        type;
+    mrp_msg_value_t value;
+    int             c;
+
+    for (c = 0; c < ncol; c++, v++) {
+        if (!mrp_msg_iterate_get(msg, it,
+                                 MSG_ANY(DATA, &type, &value),
+                                 MSG_END))
+            return FALSE;
+
+        switch (type) {
+        case MRP_MSG_FIELD_STRING:
+            v->type = MRP_DOMCTL_STRING;
+            v->str  = value.str;
+            break;
+        case MRP_MSG_FIELD_SINT32:
+            v->type = MRP_DOMCTL_INTEGER;
+            v->s32  = value.s32;
+            break;
+        case MRP_MSG_FIELD_UINT32:
+            v->type = MRP_DOMCTL_UNSIGNED;
+            v->u32  = value.u32;
+            break;
+        case MRP_MSG_FIELD_DOUBLE:
+            v->type = MRP_DOMCTL_DOUBLE;
+            v->dbl  = value.dbl;
+            break;
+        default:
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+
 msg_t *msg_decode_notify(mrp_msg_t *msg)
 {
     notify_msg_t       *notify;
     mrp_domctl_data_t  *d;
-    mrp_domctl_value_t *values, *v;
+    notify_delta_t     *delta;
+    notify_change_t    *ch;
+    mrp_domctl_value_t *v;
     void               *it;
-    uint64_t            columns_so_far;
+    uint64_t            columns_so_far, nvalue;
     uint32_t            seqno;
     uint16_t            ntable, ntotal, nrow, ncol;
-    uint16_t            tblid;
-    int                 t, r, c;
-    uint16_t            type;
+    uint16_t            tblid, tag, type;
+    uint8_t             op;
     mrp_msg_value_t     value;
+    int                 t, r;
 
     it = NULL;
     columns_so_far = 0;
@@ -716,34 +883,87 @@ msg_t *msg_decode_notify(mrp_msg_t *msg)
     if (notify == NULL)
         return NULL;
 
-    values         = NULL;
     notify->type   = MSG_TYPE_NOTIFY;
     notify->seq    = seqno;
     notify->tables = mrp_allocz(sizeof(*notify->tables) * ntable);
+    notify->deltas = mrp_allocz(sizeof(*notify->deltas) * ntable);
 
-    if (notify->tables == NULL && ntable != 0)
+    if ((notify->tables == NULL || notify->deltas == NULL) && ntable != 0)
         goto fail;
 
-    values = ntotal ? mrp_allocz(sizeof(*values) * ntotal) : NULL;
+    notify->ntable = ntable;
+    notify->values = ntotal ? mrp_allocz(sizeof(*v) * ntotal) : NULL;
 
-    if (values == NULL && ntotal != 0)
+    if (notify->values == NULL && ntotal != 0)
         goto fail;
 
-    d = notify->tables;
-    v = values;
+    v = notify->values;
 
     for (t = 0; t < ntable; t++) {
+        d     = notify->tables + t;
+        delta = notify->deltas + t;
+
+        /* a table is followed either by NROW (snapshot) or NDELTA */
         if (!mrp_msg_iterate_get(msg, &it,
                                  MSG_UINT16(TBLID, &tblid),
-                                 MSG_UINT16(NROW , &nrow ),
+                                 MSG_END) ||
+            !mrp_msg_iterate(msg, &it, &tag, &type, &value, NULL) ||
+            type != MRP_MSG_FIELD_UINT16 ||
+            (tag != MSGTAG_NROW && tag != MSGTAG_NDELTA) ||
+            !mrp_msg_iterate_get(msg, &it,
                                  MSG_UINT16(NCOL , &ncol ),
                                  MSG_END))
             goto fail;
 
+        nrow = value.u16;
+
         d->id      = tblid;
         d->ncolumn = ncol;
-        d->nrow    = nrow;
-        d->rows    = nrow ? mrp_allocz(sizeof(*d->rows) * nrow) : NULL;
+
+        if (tag == MSGTAG_NDELTA) {
+            delta->delta   = TRUE;
+            delta->changes = nrow ? mrp_allocz(sizeof(*ch) * nrow) : NULL;
+
+            if (delta->changes == NULL && nrow != 0)
+                goto fail;
+
+            delta->nchange = nrow;
+
+            for (r = 0, ch = delta->changes; r < nrow; r++, ch++) {
+                if (!mrp_msg_iterate_get(msg, &it,
+                                         MSG_UINT8(ROWOP, &op),
+                                         MSG_END) ||
+                    op > NOTIFY_ROW_UPDATE)
+                    goto fail;
+
+                nvalue = (op == NOTIFY_ROW_UPDATE ? 2 : 1) * ncol;
+
+                if (columns_so_far + nvalue > ntotal)
+                    goto fail;
+
+                columns_so_far += nvalue;
+                ch->op = op;
+
+                if (op != NOTIFY_ROW_INSERT) {
+                    ch->before = v;
+                    if (!decode_row(msg, &it, v, ncol))
+                        goto fail;
+                    v += ncol;
+                }
+
+                if (op != NOTIFY_ROW_DELETE) {
+                    ch->after = v;
+                    if (!decode_row(msg, &it, v, ncol))
+                        goto fail;
+                    v += ncol;
+                }
+            }
+
+            continue;
+        }
+
+        d->nrow = nrow;
+        d->rows = nrow ? mrp_allocz(sizeof(*d->rows) * nrow) : NULL;
 
         if (d->rows == NULL && nrow != 0)
             goto fail;
@@ -758,42 +978,13 @@ msg_t *msg_decode_notify(mrp_msg_t *msg)
         for (r = 0; r < nrow; r++) {
             d->rows[r] = v;
 
-            for (c = 0; c < ncol; c++) {
-                if (!mrp_msg_iterate_get(msg, &it,
-                                         MSG_ANY(DATA, &type, &value),
-                                         MSG_END))
-                    goto fail;
-
-                switch (type) {
-                case MRP_MSG_FIELD_STRING:
-                    v->type = MRP_DOMCTL_STRING;
-                    v->str  = value.str;
-                    break;
-                case MRP_MSG_FIELD_SINT32:
-                    v->type = MRP_DOMCTL_INTEGER;
-                    v->s32  = value.s32;
-                    break;
-                case MRP_MSG_FIELD_UINT32:
-                    v->type = MRP_DOMCTL_UNSIGNED;
-                    v->u32  = value.u32;
-                    break;
-                case MRP_MSG_FIELD_DOUBLE:
-                    v->type = MRP_DOMCTL_DOUBLE;
-                    v->dbl  = value.dbl;
-                    break;
-                default:
-                    goto fail;
-                }
+            if (!decode_row(msg, &it, v, ncol))
+                goto fail;
 
-                v++;
-            }
+            v += ncol;
         }
-
-        d++;
     }
 
-    notify->ntable = ntable;
-
     notify->wire       = mrp_msg_ref(msg);
     notify->unref_wire = msg_unref_wire;
 
@@ -801,7 +992,6 @@ msg_t *msg_decode_notify(mrp_msg_t *msg)
 
  fail:
     msg_free_notify((msg_t *)notify);
-    mrp_free(values);
 
     return NULL;
 }
@@ -62,6 +62,7 @@ typedef enum {
     MSGTAG_INDEX    = 0x9,           /* index definition */
     MSGTAG_WHERE    = 0xa,           /* where clause for select */
     MSGTAG_MAXROWS  = 0xb,           /* max number of rows to select */
+    MSGTAG_CAPS     = 0xc,           /* client capabilities */
 
     /* fixed tags in NAKs */
     MSGTAG_ERRCODE  = 0x3,           /* error code */
@@ -74,6 +75,8 @@ typedef enum {
     MSGTAG_NROW    = 0x6,            /* number of table rows */
     MSGTAG_NCOL    = 0x7,            /* number of columns in a row */
     MSGTAG_DATA    = 0x8,            /* a data column */
+    MSGTAG_NDELTA  = 0x9,            /* number of row changes */
+    MSGTAG_ROWOP   = 0xa,            /* type of a row change */
 
     /* fixed tags in invoke and return messages */
     MSGTAG_METHOD  = 0x3,            /* method name */
@@ -85,6 +88,49 @@ typedef enum {
 } msgtag_t;
 
 
+/*
+ * client capabilities
+ *
+ * Clients announce what they can handle in an optional trailing CAPS
+ * field of their registration message. Servers only use features the
+ * client announced, so older clients keep getting full snapshots.
+ */
+
+typedef enum {
+    MSG_CAP_NONE  = 0x0,             /* no optional capabilities */
+    MSG_CAP_DELTA = 0x1,             /* can apply delta notifications */
+} msg_cap_t;
+
+
+/*
+ * row changes in delta notifications
+ *
+ * A table in a notification carries either a full snapshot (NROW, NCOL,
+ * followed by NROW * NCOL DATA fields) or the row changes since the last
+ * notification (NDELTA, NCOL, followed by NDELTA changes). Each change is
+ * a ROWOP followed by the NCOL DATA fields of the inserted or deleted row,
+ * or the NCOL fields of the row before and NCOL fields after an update.
+ */
+
+typedef enum {
+    NOTIFY_ROW_INSERT = 0,           /* row inserted */
+    NOTIFY_ROW_DELETE,               /* row deleted */
+    NOTIFY_ROW_UPDATE,               /* row updated */
+} notify_rowop_t;
+
+typedef struct {
+    notify_rowop_t      op;              /* type of change */
+    mrp_domctl_value_t *before;          /* row before change, or NULL */
+    mrp_domctl_value_t *after;           /* row after change, or NULL */
+} notify_change_t;
+
+typedef struct {
+    notify_change_t *changes;            /* row changes, or NULL */
+    int              nchange;            /* number of changes */
+    int              delta;              /* whether a delta or a snapshot */
+} notify_delta_t;
+
+
 #define MSG_UINT8(tag, val) MRP_MSG_TAG_UINT8(MSGTAG_##tag, val)
 #define MSG_SINT8(tag, val) MRP_MSG_TAG_SINT8(MSGTAG_##tag, val)
 #define MSG_UINT16(tag, val) MRP_MSG_TAG_UINT16(MSGTAG_##tag, val)
@@ -117,6 +163,7 @@ typedef struct {
     int                 ntable;          /* number of tables */
     mrp_domctl_watch_t *watches;         /* watched tables */
     int                 nwatch;          /* number of watches */
+    uint32_t            caps;            /* client capabilities */
 } register_msg_t;
 
 
@@ -135,7 +182,9 @@ typedef struct {
 typedef struct {
     COMMON_MSG_FIELDS;
     mrp_domctl_data_t *tables;           /* data in changed tables */
+    notify_delta_t    *deltas;           /* row changes in changed tables */
     int                ntable;           /* number of changed tables */
+    mrp_domctl_value_t *values;          /* storage for all values */
 } notify_msg_t;
 
 
@@ -195,6 +244,8 @@ void msg_free_message(msg_t *msg);
 
 mrp_msg_t *msg_create_notify(void);
 int msg_update_notify(mrp_msg_t *msg, int tblid, mql_result_t *r);
+int msg_update_delta(mrp_msg_t *msg, int tblid, pep_change_t *changes,
+                     int nchange, int *columns, int ncolumn);
 
 mrp_json_t *json_create_notify(void);
 int json_update_notify(mrp_json_t *msg, int tblid, mql_result_t *r);
@@ -46,38 +46,61 @@ static void prepare_proxy_notification(pep_proxy_t *proxy)
 }
 
 
+static inline bool proxy_deltas(pep_proxy_t *proxy)
+{
+    return (proxy->ops->update_delta != NULL &&
+            (proxy->caps & MSG_CAP_DELTA));
+}
+
+
 static int collect_watch_notification(pep_watch_t *w)
 {
     pep_proxy_t  *proxy = w->proxy;
+    pep_table_t  *t     = w->table;
     mql_result_t *r     = NULL;
     int           n;
 
-    mrp_debug("updating %s watch for %s", w->table->name, proxy->name);
+    /*
+     * Clients that announced they can apply deltas only get notified
+     * about tables that actually changed. Their synced watches get the
+     * recorded row changes if the table has a usable change log. Other
+     * watches and clients get a full snapshot of the selected rows.
+     */
+
+    if (proxy_deltas(proxy) && w->synced && !t->changed)
+        return TRUE;
+
+    mrp_debug("updating %s watch for %s", t->name, proxy->name);
 
     if (proxy->notify_msg == NULL) {
         if (!proxy->ops->create_notify(proxy))
             goto fail;
     }
 
-    if (w->table->h != MQI_HANDLE_INVALID) {
-        if (!exec_mql(mql_result_rows, &r, "select %s from %s%s%s",
-                      w->mql_columns, w->table->name,
-                      w->mql_where[0] ? " where " : "", w->mql_where)) {
+    if (proxy_deltas(proxy) && w->synced && !t->snapshot &&
+        w->columns != NULL) {
+        mrp_debug("sending %d changes of table %s", t->nchange, t->name);
+
+        n = proxy->ops->update_delta(proxy, w);
+    }
+    else {
+        if (!select_watch(w, &r)) {
             mrp_debug("select from table %s (select %s from %s%s%s) failed",
-                      w->table->name,
-                      w->mql_columns, w->table->name,
+                      t->name, w->mql_columns, t->name,
                       w->mql_where[0] ? " where " : "", w->mql_where);
             goto fail;
         }
-    }
 
-    n = proxy->ops->update_notify(proxy, w->id, r);
+        n = proxy->ops->update_notify(proxy, w->id, r);
 
-    if (r != NULL)
-        mql_result_free(r);
+        if (r != NULL)
+            mql_result_free(r);
+    }
 
-    if (n >= 0)
+    if (n >= 0) {
+        w->synced = (t->h != MQI_HANDLE_INVALID);
         return TRUE;
+    }
     else {
     fail:
         proxy->ops->free_notify(proxy);
@@ -88,6 +111,18 @@ static int collect_watch_notification(pep_watch_t *w)
 }
 
 
+static void unsync_proxy_watches(pep_proxy_t *proxy)
+{
+    mrp_list_hook_t *p, *n;
+    pep_watch_t     *w;
+
+    mrp_list_foreach(&proxy->watches, p, n) {
+        w = mrp_list_entry(p, typeof(*w), pep_hook);
+        w->synced = false;
+    }
+}
+
+
 static int send_proxy_notification(pep_proxy_t *proxy)
 {
     if (proxy->notify_msg == NULL)
@@ -96,12 +131,16 @@ static int send_proxy_notification(pep_proxy_t *proxy)
     if (!proxy->notify_fail) {
         mrp_debug("notifying client %s", proxy->name);
 
-        proxy->ops->send_notify(proxy);
+        if (!proxy->ops->send_notify(proxy))
+            unsync_proxy_watches(proxy);
+
         proxy->ops->free_notify(proxy);
     }
-    else
+    else {
         mrp_log_error("Failed to generate/send notification to %s.",
                       proxy->name);
+        unsync_proxy_watches(proxy);
+    }
 
     proxy->notify_msg     = NULL;
     proxy->notify_ntable  = 0;
@@ -163,5 +202,6 @@ void notify_table_changes(pdp_t *pdp)
     mrp_list_foreach(&pdp->tables, p, n) {
         t = mrp_list_entry(p, typeof(*t), hook);
         t->changed = false;
+        reset_table_changes(t);
     }
 }
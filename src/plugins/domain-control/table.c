@@ -29,6 +29,7 @@
 
 #include <errno.h>
 #include <stdarg.h>
+#include <string.h>
 
 #include <murphy/common/debug.h>
 #include <murphy/common/mm.h>
@@ -49,38 +50,164 @@
     } while (0)
 
 static pep_table_t *lookup_watch_table(pdp_t *pdp, const char *name);
+static int get_table_description(pep_table_t *t);
+static void free_table_description(pep_table_t *t);
+static void free_watch(pep_watch_t *w);
 
 /*
  * proxied and tracked tables
  */
 
 
-static void table_change_cb(mqi_event_t *e, void *tptr)
+/*
+ * Row changes of watched tables are recorded in a per-table change log
+ * and sent to clients as deltas. If a table collects more changes than
+ * it has rows (or CHANGE_MIN, whichever is bigger) before clients get
+ * notified, the log is discarded and clients get a full snapshot. The
+ * log never grows beyond CHANGE_MAX, the most changes a delta can carry.
+ */
+
+#define CHANGE_MIN 64
+#define CHANGE_MAX UINT16_MAX
+
+static mrp_domctl_value_t *copy_row(pep_table_t *t, mrp_domctl_value_t *src)
+{
+    mrp_domctl_value_t *row;
+    int                 i;
+
+    if (src == NULL)
+        return NULL;
+
+    row = mrp_allocz_array(typeof(*row), t->ncolumn);
+
+    if (row == NULL)
+        return NULL;
+
+    for (i = 0; i < t->ncolumn; i++) {
+        switch (t->columns[i].type) {
+        case mqi_string:
+            row[i].type = MRP_DOMCTL_STRING;
+            row[i].str  = mrp_strdup(src[i].str ? src[i].str : "");
+            if (row[i].str == NULL)
+                goto fail;
+            break;
+        case mqi_integer:
+            row[i].type = MRP_DOMCTL_INTEGER;
+            row[i].s32  = src[i].s32;
+            break;
+        case mqi_unsignd:
+            row[i].type = MRP_DOMCTL_UNSIGNED;
+            row[i].u32  = src[i].u32;
+            break;
+        case mqi_floating:
+            row[i].type = MRP_DOMCTL_DOUBLE;
+            row[i].dbl  = src[i].dbl;
+            break;
+        default:
+            goto fail;
+        }
+    }
+
+    return row;
+
+ fail:
+    while (--i >= 0)
+        if (row[i].type == MRP_DOMCTL_STRING)
+            mrp_free((char *)row[i].str);
+    mrp_free(row);
+
+    return NULL;
+}
+
+
+static void free_row(pep_table_t *t, mrp_domctl_value_t *row)
 {
-    static const char *events[] = {
-        "unknown (?)",
-        "column change",
-        "row insert",
-        "row delete",
-        "table create",
-        "table drop",
-        "transaction start (?)",
-        "transaction end (?)",
-    };
-    pep_table_t *t = (pep_table_t *)tptr;
+    int i;
+
+    if (row == NULL)
+        return;
+
+    for (i = 0; i < t->ncolumn; i++)
+        if (row[i].type == MRP_DOMCTL_STRING)
+            mrp_free((char *)row[i].str);
+
+    mrp_free(row);
+}
+
+
+void reset_table_changes(pep_table_t *t)
+{
+    int i;
+
+    for (i = 0; i < t->nchange; i++) {
+        free_row(t, t->changes[i].before);
+        free_row(t, t->changes[i].after);
+    }
+
+    mrp_free(t->changes);
+    t->changes  = NULL;
+    t->nchange  = 0;
+    t->snapshot = false;
+}
+
+
+static void table_changeset_cb(mqi_event_t *e, void *tptr)
+{
+    mqi_changeset_event_t *ce = &e->changeset;
+    pep_table_t           *t  = (pep_table_t *)tptr;
+    mqi_row_change_t      *rc;
+    pep_change_t          *c;
+    int                    max, i;
 
     if (!t->changed) {
         t->changed = true;
-        mrp_debug("table '%s' changed by %s event", t->name, events[e->event]);
+        mrp_debug("table '%s' changed (%d inserts, %d deletes, %d updates)",
+                  t->name, ce->ninsert, ce->ndelete, ce->nupdate);
+    }
+
+    if (t->snapshot)
+        return;
+
+    max = mqi_get_table_size(t->h);
+
+    if (max < CHANGE_MIN)
+        max = CHANGE_MIN;
+    else if (max > CHANGE_MAX)
+        max = CHANGE_MAX;
+
+    if (t->nchange + ce->nchange > max)
+        goto overflow;
+
+    if (!mrp_reallocz(t->changes, t->nchange, t->nchange + ce->nchange))
+        goto overflow;
+
+    for (i = 0, rc = ce->changes; i < ce->nchange; i++, rc++) {
+        c = t->changes + t->nchange;
+
+        c->event  = rc->event;
+        c->before = copy_row(t, rc->before);
+        c->after  = copy_row(t, rc->after);
+
+        t->nchange++;
+
+        if ((rc->before != NULL && c->before == NULL) ||
+            (rc->after  != NULL && c->after  == NULL))
+            goto overflow;
     }
+
+    return;
+
+ overflow:
+    mrp_debug("table '%s' change log overflow, falling back to snapshot",
+              t->name);
+    reset_table_changes(t);
+    t->snapshot = true;
 }
 
 
 static int add_table_triggers(pep_table_t *t)
 {
-    mdb_table_t      *tbl;
-    mqi_column_def_t  cols[256];
-    int               ncol, i;
+    mdb_table_t *tbl;
 
     if (t->h == MQI_HANDLE_INVALID) {
         errno = EAGAIN;
@@ -92,34 +219,24 @@ static int add_table_triggers(pep_table_t *t)
         return -1;
     }
 
-    if ((ncol = mdb_table_describe(tbl, &cols[0], sizeof(cols))) <= 0) {
+    if (t->coldesc == NULL && !get_table_description(t)) {
         errno = EINVAL;
         return -1;
     }
 
-    if (mdb_trigger_add_row_callback(tbl, table_change_cb, t, NULL)) {
+    if (mdb_trigger_add_changeset_callback(tbl, table_changeset_cb,
+                                           t, t->coldesc) < 0) {
         errno = EINVAL;
         return -1;
     }
 
-    for (i = 0; i < ncol; i++) {
-        if (mdb_trigger_add_column_callback(tbl, i, table_change_cb,
-                                            t, NULL) < 0) {
-            mdb_trigger_delete_row_callback(tbl, table_change_cb, t);
-            errno = EINVAL;
-            return -1;
-        }
-    }
-
     return 0;
 }
 
 
 static void del_table_triggers(pep_table_t *t)
 {
-    mdb_table_t      *tbl;
-    mqi_column_def_t  cols[256];
-    int               ncol, i;
+    mdb_table_t *tbl;
 
     if (t->h == MQI_HANDLE_INVALID)
         return;
@@ -127,12 +244,19 @@ static void del_table_triggers(pep_table_t *t)
     if ((tbl = mdb_table_find(t->name)) == NULL)
         return;
 
-    ncol = mdb_table_describe(tbl, &cols[0], sizeof(cols));
+    mdb_trigger_delete_changeset_callback(tbl, table_changeset_cb, t);
+}
+
 
-    mdb_trigger_delete_row_callback(tbl, table_change_cb, t);
+static void reset_table_watches(pep_table_t *t)
+{
+    mrp_list_hook_t *p, *n;
+    pep_watch_t     *w;
 
-    for (i = 0; i < ncol; i++)
-        mdb_trigger_delete_column_callback(tbl, i, table_change_cb, t);
+    mrp_list_foreach(&t->watches, p, n) {
+        w = mrp_list_entry(p, typeof(*w), tbl_hook);
+        reset_watch(w);
+    }
 }
 
 
@@ -161,13 +285,18 @@ static void table_event_cb(mqi_event_t *e, void *user_data)
     if (t != NULL) {
         t->changed = true;
 
+        reset_table_changes(t);
+        reset_table_watches(t);
+        t->snapshot = true;
+
         if (e->event == mqi_table_created) {
             t->h = h;
             add_table_triggers(t);
         }
         else {
-            t->h = MQI_HANDLE_INVALID;
             del_table_triggers(t);
+            t->h = MQI_HANDLE_INVALID;
+            free_table_description(t);
         }
     }
 
@@ -341,6 +470,17 @@ static int get_table_description(pep_table_t *t)
 }
 
 
+static void free_table_description(pep_table_t *t)
+{
+    mrp_free(t->columns);
+    mrp_free(t->coldesc);
+
+    t->columns = NULL;
+    t->coldesc = NULL;
+    t->ncolumn = 0;
+}
+
+
 int create_proxy_table(pep_table_t *t, int *errcode, const char **errmsg)
 {
     mrp_list_init(&t->hook);
@@ -454,14 +594,10 @@ static void destroy_table_watches(pep_table_t *t)
 
         mrp_list_foreach(&t->watches, p, n) {
             w = mrp_list_entry(p, typeof(*w), tbl_hook);
-
-            mrp_list_delete(&w->tbl_hook);
-            mrp_list_delete(&w->pep_hook);
-
-            mrp_free(w->mql_columns);
-            mrp_free(w->mql_where);
-            mrp_free(w);
+            free_watch(w);
         }
+
+        reset_table_changes(t);
     }
 }
 
@@ -494,6 +630,155 @@ static void purge_watch_table_cb(void *key, void *entry)
 }
 
 
+static int resolve_watch_columns(pep_watch_t *w)
+{
+    pep_table_t *t = w->table;
+    char         name[256], *s, *e;
+    int          n, idx;
+
+    w->columns = mrp_allocz_array(typeof(*w->columns), t->ncolumn);
+
+    if (w->columns == NULL)
+        return FALSE;
+
+    s = w->mql_columns;
+
+    while (*s == ' ' || *s == '\t')
+        s++;
+
+    if (!strcmp(s, "*")) {
+        for (idx = 0; idx < t->ncolumn; idx++)
+            w->columns[idx] = idx;
+        w->ncolumn = t->ncolumn;
+
+        return TRUE;
+    }
+
+    while (*s) {
+        while (*s == ' ' || *s == '\t' || *s == ',')
+            s++;
+
+        if (!*s)
+            break;
+
+        for (e = s; *e && *e != ',' && *e != ' ' && *e != '\t'; e++)
+            ;
+
+        n = e - s;
+
+        if (n >= (int)sizeof(name) || w->ncolumn >= t->ncolumn)
+            goto fail;
+
+        strncpy(name, s, n);
+        name[n] = '\0';
+
+        if ((idx = mqi_get_column_index(t->h, name)) < 0)
+            goto fail;
+
+        w->columns[w->ncolumn++] = idx;
+        s = e;
+    }
+
+    if (w->ncolumn > 0)
+        return TRUE;
+
+ fail:
+    mrp_free(w->columns);
+    w->columns = NULL;
+    w->ncolumn = 0;
+
+    return FALSE;
+}
+
+
+int prepare_watch(pep_watch_t *w)
+{
+    pep_table_t *t = w->table;
+    char         query[4096];
+    int          n;
+
+    if (w->select != NULL)
+        return TRUE;
+
+    if (t->h == MQI_HANDLE_INVALID || t->coldesc == NULL)
+        return FALSE;
+
+    n = snprintf(query, sizeof(query), "select %s from %s%s%s",
+                 w->mql_columns, t->name,
+                 w->mql_where[0] ? " where " : "", w->mql_where);
+
+    if (n >= (int)sizeof(query)) {
+        errno = EOVERFLOW;
+        return FALSE;
+    }
+
+    w->select = mql_precompile(query);
+
+    if (w->select == NULL) {
+        mrp_debug("failed to precompile '%s'", query);
+        return FALSE;
+    }
+
+    /*
+     * Deltas are only sent for watches without a where clause: the
+     * change log has no way to tell whether a row image matches it.
+     */
+    if (!w->mql_where[0])
+        resolve_watch_columns(w);
+
+    return TRUE;
+}
+
+
+void reset_watch(pep_watch_t *w)
+{
+    if (w->select != NULL)
+        mql_statement_free(w->select);
+
+    mrp_free(w->columns);
+
+    w->select  = NULL;
+    w->columns = NULL;
+    w->ncolumn = 0;
+    w->synced  = false;
+}
+
+
+int select_watch(pep_watch_t *w, mql_result_t **resultp)
+{
+    mql_result_t *r;
+
+    *resultp = NULL;
+
+    if (!prepare_watch(w))
+        return w->table->h == MQI_HANDLE_INVALID;
+
+    r = mql_exec_statement(mql_result_rows, w->select);
+
+    if (r != NULL && !mql_result_is_success(r)) {
+        mql_result_free(r);
+        return FALSE;
+    }
+
+    *resultp = r;
+
+    return TRUE;
+}
+
+
+static void free_watch(pep_watch_t *w)
+{
+    mrp_list_delete(&w->tbl_hook);
+    mrp_list_delete(&w->pep_hook);
+
+    reset_watch(w);
+
+    mrp_free(w->mql_columns);
+    mrp_free(w->mql_where);
+    mrp_free(w);
+}
+
+
 int create_proxy_watch(pep_proxy_t *proxy, int id,
                        const char *table, const char *mql_columns,
                        const char *mql_where, int max_rows,
@@ -560,11 +845,7 @@ void destroy_proxy_watches(pep_proxy_t *proxy)
     if (proxy != NULL) {
         mrp_list_foreach(&proxy->watches, p, n) {
             w = mrp_list_entry(p, typeof(*w), pep_hook);
-
-            mrp_list_delete(&w->tbl_hook);
-            mrp_list_delete(&w->pep_hook);
-
-            mrp_free(w);
+            free_watch(w);
         }
     }
 }
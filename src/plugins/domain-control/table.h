@@ -52,6 +52,12 @@ void destroy_proxy_tables(pep_proxy_t *proxy);
 
 void destroy_proxy_watches(pep_proxy_t *proxy);
 
+int prepare_watch(pep_watch_t *w);
+void reset_watch(pep_watch_t *w);
+int select_watch(pep_watch_t *w, mql_result_t **resultp);
+
+void reset_table_changes(pep_table_t *t);
+
 int set_proxy_tables(pep_proxy_t *proxy, mrp_domctl_data_t *tables, int ntable,
                      int *error, const char **errmsg);
 
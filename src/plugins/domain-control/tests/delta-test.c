@@ -0,0 +1,693 @@
+/*
+ * Copyright (c) 2012, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Test for delta notifications of watched tables.
+ *
+ * Two clients watch the same table: one announces it can apply deltas,
+ * the other one does not. Row changes are made to the table in
+ * transactions, then the notifications for both clients are generated,
+ * put on the wire, decoded and applied to the client side caches the
+ * same way the domain controller library does it. The change log of
+ * the table, the fallback to snapshots if the log overflows and the
+ * resulting client caches are checked after every round.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+#include <murphy/common/macros.h>
+#include <murphy/common/mm.h>
+#include <murphy/common/msg.h>
+
+#include <murphy-db/mqi.h>
+
+#include "../client.c"
+#include "../notify.h"
+
+#define TABLE    "delta_test"
+#define NSMALL   8                       /* rows in the small table */
+#define NMEDIUM  4096                    /* rows in the medium table */
+#define NLARGE   (UINT16_MAX + 16)       /* rows to overflow a delta */
+#define NDELETE  1024                    /* rows to delete and update */
+#define NOVERFLOW 65                     /* changes to overflow the log */
+
+#define CHECK(cond, ...) do {                                   \
+        if (!(cond)) {                                          \
+            printf("FAIL: " __VA_ARGS__);                       \
+            printf("\n");                                       \
+            nfail++;                                            \
+        }                                                       \
+    } while (0)
+
+#define fatal(fmt, args...) do {                                \
+        printf("fatal error: "fmt"\n" , ## args);               \
+        exit(1);                                                \
+    } while (0)
+
+typedef struct {
+    uint32_t  key;
+    char     *name;
+    int32_t   value;
+} row_t;
+
+typedef struct {
+    pep_proxy_t   proxy;                 /* server side of the client */
+    mrp_domctl_t  dc;                    /* client side */
+    int           ndelta;                /* deltas in last notification */
+    int           nsnapshot;             /* snapshots in last notification */
+} client_t;
+
+static pdp_t         pdp;
+static client_t      clients[2];
+static mqi_handle_t  table = MQI_HANDLE_INVALID;
+static row_t        *model;              /* expected table contents */
+static bool         *present;            /* whether a row is in the table */
+static char        (*names)[16];         /* storage for row names */
+static uint32_t      where_key;
+static int           nfail;
+
+MQI_COLUMN_SELECTION_LIST(all_columns,
+    MQI_COLUMN_SELECTOR(0, row_t, key  ),
+    MQI_COLUMN_SELECTOR(1, row_t, name ),
+    MQI_COLUMN_SELECTOR(2, row_t, value)
+);
+
+MQI_COLUMN_SELECTION_LIST(value_column,
+    MQI_COLUMN_SELECTOR(2, row_t, value)
+);
+
+MQI_WHERE_CLAUSE(by_key,
+    MQI_EQUAL(MQI_COLUMN(0), MQI_UNSIGNED_VAR(where_key))
+);
+
+MQI_WHERE_CLAUSE(from_key,
+    MQI_GREATER_OR_EQUAL(MQI_COLUMN(0), MQI_UNSIGNED_VAR(where_key))
+);
+
+
+/*
+ * the server side does not run a mainloop, notifications are triggered
+ * explicitly by the test
+ */
+
+void schedule_notification(pdp_t *pdp)
+{
+    MRP_UNUSED(pdp);
+}
+
+
+static void connect_cb(mrp_domctl_t *dc, int connected, int errcode,
+                       const char *errmsg, void *user_data)
+{
+    MRP_UNUSED(dc);
+    MRP_UNUSED(user_data);
+
+    if (!connected)
+        fatal("client failed to apply notification (%d: %s)", errcode,
+              errmsg ? errmsg : "<unknown>");
+}
+
+
+static void watch_cb(mrp_domctl_t *dc, mrp_domctl_data_t *tables, int ntable,
+                     void *user_data)
+{
+    MRP_UNUSED(dc);
+    MRP_UNUSED(tables);
+    MRP_UNUSED(ntable);
+    MRP_UNUSED(user_data);
+}
+
+
+static int op_create_notify(pep_proxy_t *proxy)
+{
+    proxy->notify_msg = msg_create_notify();
+
+    return proxy->notify_msg != NULL;
+}
+
+
+static int op_update_notify(pep_proxy_t *proxy, int tblid, mql_result_t *r)
+{
+    int n;
+
+    n = msg_update_notify((mrp_msg_t *)proxy->notify_msg, tblid, r);
+
+    if (n >= 0) {
+        proxy->notify_ncolumn += n;
+        proxy->notify_ntable++;
+    }
+
+    return n;
+}
+
+
+static int op_update_delta(pep_proxy_t *proxy, pep_watch_t *w)
+{
+    int n;
+
+    n = msg_update_delta((mrp_msg_t *)proxy->notify_msg, w->id,
+                         w->table->changes, w->table->nchange,
+                         w->columns, w->ncolumn);
+
+    if (n >= 0) {
+        proxy->notify_ncolumn += n;
+        proxy->notify_ntable++;
+    }
+
+    return n;
+}
+
+
+static int op_send_notify(pep_proxy_t *proxy)
+{
+    client_t  *c       = (client_t *)proxy;
+    mrp_msg_t *msg     = proxy->notify_msg, *wire;
+    uint16_t   nchange = proxy->notify_ntable;
+    uint16_t   ntotal  = proxy->notify_ncolumn;
+    msg_t     *notify;
+    void      *buf;
+    ssize_t    size;
+    int        i;
+
+    mrp_msg_set(msg, MSG_UINT16(NCHANGE, nchange));
+    mrp_msg_set(msg, MSG_UINT16(NTOTAL , ntotal));
+
+    if ((size = mrp_msg_default_encode(msg, &buf)) <= 0)
+        fatal("failed to encode notification for %s", proxy->name);
+
+    /* skip the default encoder tag, like transports do */
+    wire = mrp_msg_default_decode((char *)buf + sizeof(uint16_t),
+                                  size - sizeof(uint16_t));
+    mrp_free(buf);
+
+    if (wire == NULL || (notify = msg_decode_message(wire)) == NULL)
+        fatal("failed to decode notification for %s", proxy->name);
+
+    mrp_msg_unref(wire);
+
+    for (i = 0; i < notify->notify.ntable; i++) {
+        if (notify->notify.deltas[i].delta)
+            c->ndelta++;
+        else
+            c->nsnapshot++;
+    }
+
+    process_notify(&c->dc, &notify->notify);
+    msg_free_message(notify);
+
+    return TRUE;
+}
+
+
+static void op_free_notify(pep_proxy_t *proxy)
+{
+    mrp_msg_unref((mrp_msg_t *)proxy->notify_msg);
+    proxy->notify_msg = NULL;
+}
+
+
+static void setup_client(client_t *c, const char *name, uint32_t caps)
+{
+    static proxy_ops_t ops = {
+        .create_notify = op_create_notify,
+        .update_notify = op_update_notify,
+        .update_delta  = op_update_delta,
+        .send_notify   = op_send_notify,
+        .free_notify   = op_free_notify,
+    };
+
+    pep_proxy_t *proxy = &c->proxy;
+    int          error;
+    const char  *errmsg;
+
+    mrp_list_init(&proxy->hook);
+    mrp_list_init(&proxy->watches);
+    mrp_list_init(&proxy->pending);
+
+    proxy->name   = (char *)name;
+    proxy->pdp    = &pdp;
+    proxy->ops    = &ops;
+    proxy->caps   = caps;
+    proxy->notify = true;
+
+    mrp_list_append(&pdp.proxies, &proxy->hook);
+
+    if (!create_proxy_watch(proxy, 0, TABLE, "*", NULL, 0, &error, &errmsg))
+        fatal("failed to create watch for %s (%d: %s)", name, error, errmsg);
+
+    c->dc.name     = (char *)name;
+    c->dc.nwatch   = 1;
+    c->dc.cache    = mrp_allocz_array(domctl_cache_t, 1);
+    c->dc.watch_cb = watch_cb;
+
+    c->dc.connect_cb = connect_cb;
+    c->dc.connected  = TRUE;
+
+    if (c->dc.cache == NULL)
+        fatal("failed to allocate cache for %s", name);
+}
+
+
+static void setup(void)
+{
+    MQI_COLUMN_DEFINITION_LIST(columns,
+        MQI_COLUMN_DEFINITION("key"  , MQI_UNSIGNED  ),
+        MQI_COLUMN_DEFINITION("name" , MQI_VARCHAR(16)),
+        MQI_COLUMN_DEFINITION("value", MQI_INTEGER   )
+    );
+    MQI_INDEX_DEFINITION(index, MQI_INDEX_COLUMN("key"));
+
+    model   = mrp_allocz_array(row_t, NLARGE);
+    present = mrp_allocz_array(bool, NLARGE);
+    names   = mrp_allocz(sizeof(*names) * NLARGE);
+
+    if (model == NULL || present == NULL || names == NULL)
+        fatal("failed to allocate table model");
+
+    mrp_list_init(&pdp.proxies);
+
+    if (!init_tables(&pdp))
+        fatal("failed to initialize database");
+
+    table = mqi_create_table(TABLE, MQI_TEMPORARY, index, columns);
+
+    if (table == MQI_HANDLE_INVALID)
+        fatal("failed to create table %s", TABLE);
+
+    setup_client(clients + 0, "delta-client" , MSG_CAP_DELTA);
+    setup_client(clients + 1, "legacy-client", MSG_CAP_NONE);
+}
+
+
+static pep_table_t *watched_table(void)
+{
+    pep_watch_t *w;
+
+    w = mrp_list_entry(clients[0].proxy.watches.next, typeof(*w), pep_hook);
+
+    return w->table;
+}
+
+
+static mqi_handle_t begin(void)
+{
+    mqi_handle_t tx = mqi_begin_transaction();
+
+    if (tx == MQI_HANDLE_INVALID)
+        fatal("failed to begin transaction");
+
+    return tx;
+}
+
+
+static void commit(mqi_handle_t tx)
+{
+    if (mqi_commit_transaction(tx) < 0)
+        fatal("failed to commit transaction");
+}
+
+
+static void insert_row(uint32_t key, int32_t value)
+{
+    row_t *r = model + key;
+    void  *data[2];
+
+    snprintf(names[key], sizeof(names[key]), "row-%u", key);
+
+    r->key   = key;
+    r->name  = names[key];
+    r->value = value;
+
+    data[0] = r;
+    data[1] = NULL;
+
+    if (mqi_insert_into(table, 0, all_columns, data) != 1)
+        fatal("failed to insert row %u", key);
+
+    present[key] = true;
+}
+
+
+static void update_row(uint32_t key, int32_t value)
+{
+    model[key].value = value;
+    where_key        = key;
+
+    if (mqi_update(table, by_key, value_column, model + key) != 1)
+        fatal("failed to update row %u", key);
+}
+
+
+static void delete_row(uint32_t key)
+{
+    where_key = key;
+
+    if (mqi_delete_from(table, by_key) != 1)
+        fatal("failed to delete row %u", key);
+
+    present[key] = false;
+}
+
+
+static void delete_rows_from(uint32_t first)
+{
+    uint32_t key;
+    int      n;
+
+    for (key = first, n = 0; key < NLARGE; key++) {
+        if (present[key]) {
+            present[key] = false;
+            n++;
+        }
+    }
+
+    where_key = first;
+
+    if (mqi_delete_from(table, from_key) != n)
+        fatal("failed to delete rows from %u", first);
+}
+
+
+static void notify(void)
+{
+    int i;
+
+    for (i = 0; i < (int)MRP_ARRAY_SIZE(clients); i++)
+        clients[i].ndelta = clients[i].nsnapshot = 0;
+
+    notify_table_changes(&pdp);
+}
+
+
+static void check_changes(int ninsert, int ndelete, int nupdate)
+{
+    pep_table_t *t = watched_table();
+    int          i, n[3] = { 0, 0, 0 };
+
+    CHECK(!t->snapshot, "change log overflowed unexpectedly");
+    CHECK(t->nchange == ninsert + ndelete + nupdate,
+          "%d changes logged, expected %d", t->nchange,
+          ninsert + ndelete + nupdate);
+
+    for (i = 0; i < t->nchange; i++) {
+        switch (t->changes[i].event) {
+        case mqi_row_inserted:
+            n[0]++;
+            CHECK(t->changes[i].before == NULL && t->changes[i].after,
+                  "logged insert #%d has wrong row images", i);
+            break;
+        case mqi_row_deleted:
+            n[1]++;
+            CHECK(t->changes[i].before && t->changes[i].after == NULL,
+                  "logged delete #%d has wrong row images", i);
+            break;
+        default:
+            n[2]++;
+            CHECK(t->changes[i].before && t->changes[i].after,
+                  "logged update #%d has wrong row images", i);
+            break;
+        }
+    }
+
+    CHECK(n[0] == ninsert && n[1] == ndelete && n[2] == nupdate,
+          "logged %d inserts, %d deletes, %d updates, expected %d, %d, %d",
+          n[0], n[1], n[2], ninsert, ndelete, nupdate);
+}
+
+
+static void check_overflow(void)
+{
+    pep_table_t *t = watched_table();
+
+    CHECK(t->snapshot, "change log did not overflow");
+    CHECK(t->nchange == 0 && t->changes == NULL,
+          "overflowed change log still has %d changes", t->nchange);
+}
+
+
+static void check_cache(client_t *c)
+{
+    domctl_cache_t     *cache = c->dc.cache;
+    mrp_domctl_value_t  row[3];
+    bool               *seen;
+    int                 nrow, idx;
+    uint32_t            key;
+
+    seen = mrp_allocz_array(bool, cache->nrow + 1);
+
+    if (seen == NULL)
+        fatal("failed to allocate cache check");
+
+    for (key = 0, nrow = 0; key < NLARGE; key++) {
+        if (!present[key])
+            continue;
+
+        nrow++;
+
+        row[0].type = MRP_DOMCTL_UNSIGNED;
+        row[0].u32  = key;
+        row[1].type = MRP_DOMCTL_STRING;
+        row[1].str  = model[key].name;
+        row[2].type = MRP_DOMCTL_INTEGER;
+        row[2].s32  = model[key].value;
+
+        idx = cache_lookup(cache, row);
+
+        if (idx < 0 || seen[idx]) {
+            CHECK(false, "row %u (%d) not in the cache of %s", key,
+                  model[key].value, c->proxy.name);
+            break;
+        }
+
+        seen[idx] = true;
+    }
+
+    CHECK(cache->nrow == nrow, "%s has %d rows cached, expected %d",
+          c->proxy.name, cache->nrow, nrow);
+
+    mrp_free(seen);
+}
+
+
+static void check_notify(int ndelta, int nsnapshot)
+{
+    client_t *delta = clients + 0, *legacy = clients + 1;
+
+    CHECK(delta->ndelta == ndelta && delta->nsnapshot == nsnapshot,
+          "delta client got %d deltas and %d snapshots, expected %d and %d",
+          delta->ndelta, delta->nsnapshot, ndelta, nsnapshot);
+    CHECK(legacy->ndelta == 0 && legacy->nsnapshot == ndelta + nsnapshot,
+          "legacy client got %d deltas and %d snapshots, expected 0 and %d",
+          legacy->ndelta, legacy->nsnapshot, ndelta + nsnapshot);
+
+    check_cache(delta);
+    check_cache(legacy);
+}
+
+
+/*
+ * Clients announce delta support in their registration. Messages from
+ * clients that do not know about it must decode without capabilities.
+ */
+
+static void test_register_caps(void)
+{
+    register_msg_t  reg;
+    mrp_msg_t      *msg;
+    msg_t          *dec;
+    uint32_t        caps[] = { MSG_CAP_DELTA, MSG_CAP_NONE };
+    size_t          i;
+
+    for (i = 0; i < MRP_ARRAY_SIZE(caps); i++) {
+        mrp_clear(&reg);
+        reg.type = MSG_TYPE_REGISTER;
+        reg.name = "caps-client";
+        reg.caps = caps[i];
+
+        if ((msg = msg_encode_message((msg_t *)&reg)) == NULL)
+            fatal("failed to encode registration");
+
+        dec = msg_decode_message(msg);
+
+        CHECK(dec != NULL && dec->reg.caps == caps[i],
+              "registration decoded with capabilities 0x%x, expected 0x%x",
+              dec ? dec->reg.caps : 0, caps[i]);
+
+        msg_free_message(dec);
+        mrp_msg_unref(msg);
+    }
+}
+
+
+static void test_initial_snapshot(void)
+{
+    notify();
+    check_notify(0, 1);
+}
+
+
+static void test_delta(void)
+{
+    mqi_handle_t tx;
+    uint32_t     key;
+
+    tx = begin();
+    for (key = 0; key < NSMALL; key++)
+        insert_row(key, key);
+    commit(tx);
+
+    check_changes(NSMALL, 0, 0);
+    notify();
+    check_notify(1, 0);
+
+    tx = begin();
+    update_row(1, 100);
+    update_row(2, 200);
+    delete_row(0);
+    delete_row(5);
+    insert_row(NSMALL, 0);
+    commit(tx);
+
+    check_changes(1, 2, 2);
+    notify();
+    check_notify(1, 0);
+
+    /* nothing changed, nothing to notify about for delta clients */
+    notify();
+    CHECK(clients[0].ndelta == 0 && clients[0].nsnapshot == 0,
+          "delta client notified about an unchanged table");
+}
+
+
+/*
+ * More changes than there are rows in the table overflow the change
+ * log. Clients then get a snapshot and deltas again after that. The
+ * changes of a row within a transaction are coalesced, so the changes
+ * are made in separate transactions.
+ */
+
+static void test_overflow(void)
+{
+    mqi_handle_t tx;
+    int          i;
+
+    for (i = 0; i < NOVERFLOW; i++) {
+        tx = begin();
+        update_row(1, 1000 + i);
+        commit(tx);
+    }
+
+    check_overflow();
+    notify();
+    check_notify(0, 1);
+
+    tx = begin();
+    update_row(3, 300);
+    commit(tx);
+
+    check_changes(0, 0, 1);
+    notify();
+    check_notify(1, 0);
+}
+
+
+/*
+ * A delta carries at most UINT16_MAX changes. Bigger change sets must
+ * overflow the change log even if the table has enough rows to keep
+ * them. The table is then shrunk to a size a snapshot can carry and
+ * deltas are applied to the bigger client caches.
+ */
+
+static void test_large(void)
+{
+    mqi_handle_t tx;
+    uint32_t     key;
+
+    tx = begin();
+    for (key = NSMALL + 1; key < NLARGE; key++)
+        insert_row(key, -(int32_t)key);
+    commit(tx);
+
+    CHECK(mqi_get_table_size(table) > UINT16_MAX,
+          "table has only %d rows", mqi_get_table_size(table));
+    check_overflow();
+
+    tx = begin();
+    delete_rows_from(NMEDIUM);
+    commit(tx);
+
+    check_overflow();
+    notify();
+    check_notify(0, 1);
+
+    tx = begin();
+    for (key = NMEDIUM - NDELETE; key < NMEDIUM; key++)
+        delete_row(key);
+    for (key = NSMALL + 1; key < NSMALL + 1 + NDELETE; key++)
+        update_row(key, key);
+    commit(tx);
+
+    check_changes(0, NDELETE, NDELETE);
+    notify();
+    check_notify(1, 0);
+}
+
+
+int main(int argc, char *argv[])
+{
+    MRP_UNUSED(argc);
+    MRP_UNUSED(argv);
+
+    setup();
+
+    test_register_caps();
+    test_initial_snapshot();
+    test_delta();
+    test_overflow();
+    test_large();
+
+    if (nfail) {
+        printf("%d delta notification checks failed\n", nfail);
+        return 1;
+    }
+
+    printf("delta notification tests passed\n");
+
+    return 0;
+}
+
+/*
+ * Local Variables:
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ *
+ */
@@ -70,6 +70,8 @@ enum {
 
 enum {
     ARG_ADDRESS,
+    ARG_BATCH,
+    ARG_BATCH_WINDOW,
 };
 
 
@@ -921,6 +923,8 @@ static void resource_event_handler(uint32_t reqid, mrp_resource_set_t *rset,
     mrp_resource_mask_t advice;
     mrp_resource_mask_t mask;
     mrp_resource_mask_t all;
+    uint32_t            gmask;
+    uint32_t            amask;
     mrp_msg_t          *msg;
     mrp_resource_t     *res;
     uint32_t            id;
@@ -938,6 +942,9 @@ static void resource_event_handler(uint32_t reqid, mrp_resource_set_t *rset,
     grant  = mrp_get_resource_set_grant(rset);
     advice = mrp_get_resource_set_advice(rset);
 
+    gmask  = mrp_resource_mask_lo32(&grant);
+    amask  = mrp_resource_mask_lo32(&advice);
+
     if (mrp_get_resource_set_state(rset) == mrp_resource_acquire)
         state = RESPROTO_ACQUIRE;
     else
@@ -947,20 +954,20 @@ static void resource_event_handler(uint32_t reqid, mrp_resource_set_t *rset,
                          FIELD( REQUEST_TYPE   , UINT16, reqtyp ),
                          FIELD( RESOURCE_SET_ID, UINT32, id     ),
                          FIELD( RESOURCE_STATE , UINT16, state  ),
-                         FIELD( RESOURCE_GRANT , UINT32, grant  ),
-                         FIELD( RESOURCE_ADVICE, UINT32, advice ),
+                         FIELD( RESOURCE_GRANT , UINT32, gmask  ),
+                         FIELD( RESOURCE_ADVICE, UINT32, amask  ),
                          RESPROTO_MESSAGE_END                   );
 
     if (!msg)
         goto failed;
 
-    all = grant | advice;
+    mrp_resource_mask_or(&all, &grant, &advice);
     curs = NULL;
 
     while ((res = mrp_resource_set_iterate_resources(rset, &curs))) {
         mask = mrp_resource_get_mask(res);
 
-        if (!(all & mask))
+        if (!mrp_resource_mask_overlap(&all, &mask))
             continue;
 
         id = mrp_resource_get_id(res);
@@ -977,6 +984,14 @@ static void resource_event_handler(uint32_t reqid, mrp_resource_set_t *rset,
                  goto failed;
     }
 
+    /*
+     * An arbitration usually sends events to many resource sets, often
+     * several of them to the same client. Cork the transport so that all
+     * the events a client gets in this mainloop iteration are written out
+     * together when the transport uncorks itself at the end of it.
+     */
+    mrp_transport_cork(client->transp);
+
     if (!mrp_transport_send(client->transp, msg))
         goto failed;
 
@@ -1157,13 +1172,18 @@ static void register_events(mrp_plugin_t *plugin)
 
 static int resource_init(mrp_plugin_t *plugin)
 {
-#if 0
     mrp_plugin_arg_t *args = plugin->args;
-#endif
     resource_data_t  *data;
 
     mrp_debug("initialising instance '%s'...", plugin->instance);
 
+    /* the protocol carries 32-bit grant and advice masks */
+    if (mrp_resource_definition_limit(MRP_RESOURCE_MAX32) < 0) {
+        mrp_log_error("Resource plugin instance %s supports at most %d "
+                      "resources.", plugin->instance, MRP_RESOURCE_MAX32);
+        return FALSE;
+    }
+
     if (!(data = mrp_allocz(sizeof(*data)))) {
         mrp_log_error("Failed to allocate private data for resource plugin "
                       "instance %s.", plugin->instance);
@@ -1179,6 +1199,10 @@ static int resource_init(mrp_plugin_t *plugin)
     subscribe_events(plugin);
     initiate_lua_configuration(plugin);
 
+    if (args[ARG_BATCH].bln)
+        mrp_resource_set_batch_requests(plugin->ctx->ml,
+                                        args[ARG_BATCH_WINDOW].u32);
+
     return TRUE;
 }
 
@@ -1187,6 +1211,7 @@ static void resource_exit(mrp_plugin_t *plugin)
 {
     mrp_debug("cleaning up instance '%s'...", plugin->instance);
 
+    mrp_resource_set_batch_requests(NULL, 0);
     unsubscribe_events(plugin);
 }
 
@@ -1198,9 +1223,14 @@ static void resource_exit(mrp_plugin_t *plugin)
 
 #define DEF_CONFIG_FILE      "/etc/murphy/resource.conf"
 #define DEF_ADDRESS          NULL
+#define DEF_BATCH            FALSE
+#define DEF_BATCH_WINDOW     0
 
 static mrp_plugin_arg_t args[] = {
-    MRP_PLUGIN_ARGIDX( ARG_ADDRESS, STRING, "address", DEF_ADDRESS ),
+    MRP_PLUGIN_ARGIDX( ARG_ADDRESS     , STRING, "address"     , DEF_ADDRESS ),
+    MRP_PLUGIN_ARGIDX( ARG_BATCH       , BOOL  , "batch"       , DEF_BATCH   ),
+    MRP_PLUGIN_ARGIDX( ARG_BATCH_WINDOW, UINT32, "batch_window",
+                       DEF_BATCH_WINDOW ),
 };
 
 
@@ -605,7 +605,8 @@ static void emit_resource_set_event(wrt_client_t *c, uint32_t reqid,
     mrp_json_t     *msg, *rarr, *r;
     int             rsid;
     const char     *state;
-    int             grant, advice, all, mask;
+    int             grant, advice;
+    mrp_resource_mask_t gmask, amask, all, mask;
     errbuf_t        e;
     mrp_resource_t *res;
     void           *it;
@@ -625,8 +626,10 @@ static void emit_resource_set_event(wrt_client_t *c, uint32_t reqid,
         state = RESWRT_STATE_RELEASE;
 
     rsid   = (int)mrp_get_resource_set_id(rset);
-    grant  = (int)mrp_get_resource_set_grant(rset);
-    advice = (int)mrp_get_resource_set_advice(rset);
+    gmask  = mrp_get_resource_set_grant(rset);
+    amask  = mrp_get_resource_set_advice(rset);
+    grant  = (int)mrp_resource_mask_lo32(&gmask);
+    advice = (int)mrp_resource_mask_lo32(&amask);
 
     msg = alloc_reply(type, seq);
 
@@ -640,13 +643,13 @@ static void emit_resource_set_event(wrt_client_t *c, uint32_t reqid,
         mrp_json_add_integer(msg, "grant" , grant) &&
         mrp_json_add_integer(msg, "advice", advice)) {
 
-        all = grant | advice;
+        mrp_resource_mask_or(&all, &gmask, &amask);
         it  = NULL;
 
         while ((res = mrp_resource_set_iterate_resources(rset, &it)) != NULL) {
             mask = mrp_resource_get_mask(res);
 
-            if (!(mask & all) && !force_all)
+            if (!mrp_resource_mask_overlap(&mask, &all) && !force_all)
                 continue;
 
             name = mrp_resource_get_name(res);
@@ -1170,6 +1173,13 @@ static int plugin_init(mrp_plugin_t *plugin)
 {
     wrt_data_t *data;
 
+    /* the protocol carries 32-bit grant and advice masks */
+    if (mrp_resource_definition_limit(MRP_RESOURCE_MAX32) < 0) {
+        mrp_log_error("resource-wrt: at most %d resources are supported.",
+                      MRP_RESOURCE_MAX32);
+        return FALSE;
+    }
+
     data = mrp_allocz(sizeof(*data));
 
     if (data != NULL) {
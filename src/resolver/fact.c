@@ -29,6 +29,7 @@
 
 #include <murphy/common/mm.h>
 #include <murphy/common/log.h>
+#include <murphy/common/utils.h>
 #include <murphy-db/mqi.h>
 
 #include "resolver-types.h"
@@ -38,31 +39,50 @@
 
 static int subscribe_db_events(mrp_resolver_t *r);
 static void unsubscribe_db_events(mrp_resolver_t *r);
+static void mark_dependents_dirty(mrp_resolver_t *r, fact_t *f);
+static fact_t *lookup_fact_table(mrp_resolver_t *r, const char *name);
 
 int create_fact(mrp_resolver_t *r, char *fact)
 {
-    int     i;
-    fact_t *f;
+    mrp_htbl_config_t  hcfg;
+    fact_t            *f;
 
     subscribe_db_events(r);
 
-    for (i = 0; i < r->nfact; i++) {
-        if (!strcmp(r->facts[i].name, fact))
-            return TRUE;
+    if (lookup_fact(r, fact) != NULL)
+        return TRUE;
+
+    if (r->fact_tbl == NULL) {
+        mrp_clear(&hcfg);
+        hcfg.comp   = mrp_string_comp;
+        hcfg.hash   = mrp_string_hash;
+        hcfg.nentry = 32;
+
+        if ((r->fact_tbl = mrp_htbl_create(&hcfg)) == NULL)
+            return FALSE;
     }
 
-    if (!mrp_reallocz(r->facts, r->nfact * sizeof(*r->facts),
-                      (r->nfact + 1) * sizeof(*r->facts)))
+    if (!mrp_reallocz(r->facts, r->nfact, r->nfact + 1))
         return FALSE;
 
-    f = r->facts + r->nfact++;
-    f->name  = mrp_strdup(fact);
-    f->table = mqi_get_table_handle(f->name + 1);
+    f = r->facts + r->nfact;
+    f->name = mrp_strdup(fact);
 
-    if (f->name != NULL)
-        return TRUE;
-    else
+    if (f->name == NULL)
         return FALSE;
+
+    /* facts are hashed by their table name, ie. without the leading '$' */
+    if (!mrp_htbl_insert(r->fact_tbl, f->name + 1,
+                         NAME_TABLE_ENTRY(r->nfact))) {
+        mrp_free(f->name);
+        f->name = NULL;
+        return FALSE;
+    }
+
+    f->table = mqi_get_table_handle(f->name + 1);
+    r->nfact++;
+
+    return TRUE;
 }
 
 
@@ -73,8 +93,15 @@ void destroy_facts(mrp_resolver_t *r)
 
     unsubscribe_db_events(r);
 
-    for (i = 0, f = r->facts; i < r->nfact; i++, f++)
+    if (r->fact_tbl != NULL) {
+        mrp_htbl_destroy(r->fact_tbl, FALSE);
+        r->fact_tbl = NULL;
+    }
+
+    for (i = 0, f = r->facts; i < r->nfact; i++, f++) {
         mrp_free(f->name);
+        mrp_free(f->dependents);
+    }
 
     mrp_free(r->facts);
 }
@@ -104,41 +131,110 @@ const char *fact_name(mrp_resolver_t *r, int id)
 
 fact_t *lookup_fact(mrp_resolver_t *r, const char *name)
 {
-    fact_t *f;
-    int     i;
+    if (name[0] != '$')
+        return NULL;
+
+    return lookup_fact_table(r, name + 1);
+}
 
-    for (i = 0, f = r->facts; i < r->nfact; i++, f++)
-        if (!strcmp(f->name, name))
-            return f;
 
-    return NULL;
+static fact_t *lookup_fact_table(mrp_resolver_t *r, const char *name)
+{
+    void *entry;
+
+    if (r->fact_tbl == NULL)
+        return NULL;
+
+    if ((entry = mrp_htbl_lookup(r->fact_tbl, (void *)name)) == NULL)
+        return NULL;
+
+    return r->facts + NAME_TABLE_INDEX(entry);
 }
 
 
-static void update_fact_table(mrp_resolver_t *r, const char *name,
-                              mqi_handle_t tbl)
+int check_facts(mrp_resolver_t *r)
 {
-    fact_t *f;
-    int     i;
+    fact_t   *f;
+    uint32_t  stamp;
+    int       i, nchanged;
+
+    /*
+     * Compare the current stamps of the fact tables to the ones we saw
+     * the last time around and mark the targets directly depending on
+     * the changed facts dirty. Dirtiness is propagated further along
+     * the dependency graph only as the dirty targets get updated.
+     */
+
+    nchanged = 0;
 
     for (i = 0, f = r->facts; i < r->nfact; i++, f++) {
-        if (!strcmp(f->name + 1, name)) {
-            f->table = tbl;
-            return;
+        stamp = fact_stamp(r, i);
+
+        if (stamp != f->stamp) {
+            mrp_debug("Fact table '%s' changed (stamp: %u -> %u).",
+                      f->name, f->stamp, stamp);
+            f->stamp = stamp;
+            mark_dependents_dirty(r, f);
+            nchanged++;
+        }
+    }
+
+    return nchanged;
+}
+
+
+int check_target_facts(mrp_resolver_t *r, target_t *t)
+{
+    fact_t   *f;
+    uint32_t  stamp;
+    int       i, id, nchanged;
+
+    /*
+     * Same as check_facts() but only for the direct fact dependencies
+     * of a single target. Used during target updates to pick up facts
+     * changed by the update scripts without rescanning all facts.
+     */
+
+    nchanged = 0;
+
+    for (i = 0; i < t->ndirect; i++) {
+        if ((id = t->directs[i]) < 0 || id >= r->nfact)
+            continue;
+
+        f     = r->facts + id;
+        stamp = fact_stamp(r, id);
+
+        if (stamp != f->stamp) {
+            mrp_debug("Fact table '%s' changed (stamp: %u -> %u).",
+                      f->name, f->stamp, stamp);
+            f->stamp = stamp;
+            mark_dependents_dirty(r, f);
+            nchanged++;
         }
     }
+
+    return nchanged;
 }
 
 
-static void check_fact_tables(mrp_resolver_t *r)
+static void mark_dependents_dirty(mrp_resolver_t *r, fact_t *f)
+{
+    int i;
+
+    for (i = 0; i < f->ndependent; i++)
+        mark_target_dirty(r, f->dependents[i]);
+}
+
+
+static void update_fact_table(mrp_resolver_t *r, const char *name,
+                              mqi_handle_t tbl)
 {
     fact_t *f;
-    int     i;
 
-    for (i = 0, f = r->facts; i < r->nfact; i++, f++) {
-        if (f->table != MQI_HANDLE_INVALID)
-            mrp_debug("Fact table '%s' stamp: %u.",
-                      f->name, mqi_get_table_stamp(f->table));
+    if ((f = lookup_fact_table(r, name)) != NULL) {
+        f->table = tbl;
+        f->stamp = fact_stamp(r, f - r->facts);
+        mark_dependents_dirty(r, f);
     }
 }
 
@@ -178,15 +274,17 @@ static void transaction_event(mqi_event_t *e, void *user_data)
 {
     mrp_resolver_t *r = (mrp_resolver_t *)user_data;
 
-    MRP_UNUSED(r);
-
     switch (e->event) {
     case mqi_transaction_end:
         mrp_debug("DB transaction ended.");
-        check_fact_tables(r);
         if (mqi_get_transaction_depth() == 1) {
-            mrp_debug("was not nested, scheduling update");
-            schedule_target_autoupdate(r);
+            check_facts(r);
+            if (r->ndirty > 0 || !r->sorted) {
+                mrp_debug("was not nested, scheduling update");
+                schedule_target_autoupdate(r);
+            }
+            else
+                mrp_debug("was not nested, no dirty targets");
         }
         else
             mrp_debug("was nested");
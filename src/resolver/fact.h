@@ -37,6 +37,8 @@ int create_fact(mrp_resolver_t *r, char *name);
 void destroy_facts(mrp_resolver_t *r);
 
 int fact_changed(mrp_resolver_t *r, int id);
+int check_facts(mrp_resolver_t *r);
+int check_target_facts(mrp_resolver_t *r, target_t *t);
 uint32_t fact_stamp(mrp_resolver_t *r, int id);
 const char *fact_name(mrp_resolver_t *r, int id);
 
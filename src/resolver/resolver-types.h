@@ -31,6 +31,7 @@
 #define __MURPHY_RESOLVER_TYPES_H__
 
 #include <stdint.h>
+#include <stddef.h>
 
 #include <murphy/common/mainloop.h>
 #include <murphy/common/hashtbl.h>
@@ -52,12 +53,18 @@ struct target_s {
     int              ndepend;            /* number of dependencies */
     int             *update_facts;       /* facts to check when updating */
     int             *update_targets;     /* targets to check when updating */
+    int              nupdate;            /* number of targets to check */
     int             *directs;            /* direct dependencies */
     int              ndirect;            /* number of direct dependencies */
     uint32_t        *fact_stamps;        /* stamps of facts at last update */
+    int             *dependents;         /* targets directly depending on us */
+    int              ndependent;         /* number of dependent targets */
+    char            *saved_dirty;        /* update path dirty flags on entry */
     mrp_scriptlet_t *script;             /* update script if any, or NULL */
     int              prepared : 1;       /* ready for resolution */
     int              precompiled : 1;
+    int              dirty : 1;          /* needs to be updated */
+    int              autoupdate : 1;     /* on the autoupdate update path */
 };
 
 
@@ -67,7 +74,9 @@ struct target_s {
 struct fact_s {
     char         *name;                  /* fact name */
     mqi_handle_t  table;                 /* associated DB table */
-    uint32_t      stamp;                 /* touch-stamp */
+    uint32_t      stamp;                 /* table stamp last seen */
+    int          *dependents;            /* targets directly depending on us */
+    int           ndependent;            /* number of dependent targets */
 };
 
 
@@ -76,14 +85,26 @@ struct mrp_resolver_s {
     mrp_event_bus_t   *bus;              /* bus for resolver events */
     target_t          *targets;          /* targets defined in the ruleset */
     int                ntarget;          /* number of targets */
+    mrp_htbl_t        *target_tbl;       /* target name to index + 1 */
     fact_t            *facts;            /* facts tracked as dependencies */
     int                nfact;            /* number of tracked facts */
+    mrp_htbl_t        *fact_tbl;         /* fact table name to index + 1 */
+    int                sorted;           /* whether update orders are valid */
     target_t          *auto_update;      /* target to resolve on fact changes */
     mrp_deferred_t    *auto_scheduled;   /* scheduled auto_update */
     uint32_t           stamp;            /* update stamp */
     mrp_context_tbl_t *ctbl;             /* context variable table */
     int                level;            /* target update nesting level */
+    int                ndirty;           /* dirty targets to autoupdate */
 };
 
 
+/*
+ * name table entries are array indices, biased by one to keep them non-NULL
+ */
+
+#define NAME_TABLE_ENTRY(idx) ((void *)(ptrdiff_t)((idx) + 1))
+#define NAME_TABLE_INDEX(ptr) ((int)(ptrdiff_t)(ptr) - 1)
+
+
 #endif /* __MURPHY_RESOLVER_TYPES_H__ */
@@ -43,12 +43,24 @@
 
 /*
  * dependency graph used to determine target update orders
+ *
+ * Nodes are facts followed by targets, ie. the node id of target #i is
+ * nfact + i. Edges are stored as adjacency lists in both directions.
  */
 
+typedef struct {
+    int *deps;                           /* nodes we depend on */
+    int  ndep;                           /* number of dependencies */
+    int *users;                          /* nodes depending on us */
+    int  nuser;                          /* number of users */
+} node_t;
+
 typedef struct {
     mrp_resolver_t *r;                   /* resolver context */
-    int            *edges;               /* edges between nodes */
+    node_t         *nodes;               /* graph nodes */
     int             nnode;               /* number of graph nodes */
+    char           *present;             /* nodes in the current subgraph */
+    int            *nedge;               /* remaining incoming edges */
 } graph_t;
 
 
@@ -56,6 +68,7 @@ static graph_t *build_graph(mrp_resolver_t *r);
 static int sort_graph(graph_t *g, int target_idx);
 static void free_graph(graph_t *g);
 static void dump_graph(graph_t *g, FILE *fp);
+static int link_dependents(mrp_resolver_t *r);
 
 
 int sort_targets(mrp_resolver_t *r)
@@ -77,10 +90,25 @@ int sort_targets(mrp_resolver_t *r)
             mrp_free(t->update_facts);
             mrp_free(t->fact_stamps);
             mrp_free(t->directs);
+            mrp_free(t->dependents);
+            mrp_free(t->saved_dirty);
             t->update_targets = NULL;
             t->update_facts   = NULL;
             t->fact_stamps    = NULL;
+            t->nupdate        = 0;
+            t->directs        = NULL;
             t->ndirect        = 0;
+            t->dependents     = NULL;
+            t->ndependent     = 0;
+            t->saved_dirty    = NULL;
+        }
+
+        for (i = 0; i < r->nfact; i++) {
+            fact_t *f = r->facts + i;
+
+            mrp_free(f->dependents);
+            f->dependents = NULL;
+            f->ndependent = 0;
         }
 
         for (i = 0; i < r->ntarget; i++) {
@@ -96,36 +124,33 @@ int sort_targets(mrp_resolver_t *r)
             }
         }
 
+        if (status == 0 && link_dependents(r) < 0)
+            status = -1;
+
         free_graph(g);
     }
     else
         status = -1;
 
+    r->sorted = (status == 0);
+
     return status;
 }
 
 
 static inline int fact_id(graph_t *g, char *fact)
 {
-    int i;
-
-    for (i = 0; i < g->r->nfact; i++)
-        if (!strcmp(fact, g->r->facts[i].name))
-            return i;
+    fact_t *f = lookup_fact(g->r, fact);
 
-    return -1;
+    return f != NULL ? f - g->r->facts : -1;
 }
 
 
 static inline int target_id(graph_t *g, char *target)
 {
-    int i;
+    target_t *t = lookup_target(g->r, target);
 
-    for (i = 0; i < g->r->ntarget; i++)
-        if (!strcmp(target, g->r->targets[i].name))
-            return g->r->nfact + i;
-
-    return -1;
+    return t != NULL ? g->r->nfact + (t - g->r->targets) : -1;
 }
 
 
@@ -147,32 +172,20 @@ static inline int node_id(graph_t *g, char *name)
 }
 
 
-static inline int *edge_markp(graph_t *g, int n1, int n2)
-{
-    static int invalid = 0;
-
-    if (n1 >= 0 && n2 >= 0)
-        return g->edges + (n1 * g->nnode) + n2;
-    else
-        return &invalid;
-}
-
-
-static inline void mark_node(graph_t *g, int node)
+static int add_edge(graph_t *g, int from, int to)
 {
-    *edge_markp(g, node, node) = 1;
-}
+    node_t *src = g->nodes + from;
+    node_t *dst = g->nodes + to;
 
+    if (!mrp_reallocz(src->users, src->nuser, src->nuser + 1))
+        return FALSE;
+    src->users[src->nuser++] = to;
 
-static inline void unmark_node(graph_t *g, int node)
-{
-    *edge_markp(g, node, node) = 0;
-}
-
+    if (!mrp_reallocz(dst->deps, dst->ndep, dst->ndep + 1))
+        return FALSE;
+    dst->deps[dst->ndep++] = from;
 
-static inline int node_present(graph_t *g, int node)
-{
-    return *edge_markp(g, node, node) == 1;
+    return TRUE;
 }
 
 
@@ -185,11 +198,13 @@ static graph_t *build_graph(mrp_resolver_t *r)
     g = mrp_allocz(sizeof(*g));
 
     if (g != NULL) {
-        g->r     = r;
-        g->nnode = r->nfact + r->ntarget;
-        g->edges = mrp_allocz(g->nnode * g->nnode * sizeof(*g->edges));
+        g->r       = r;
+        g->nnode   = r->nfact + r->ntarget;
+        g->nodes   = mrp_allocz_array(node_t, g->nnode);
+        g->present = mrp_allocz_array(char, g->nnode);
+        g->nedge   = mrp_allocz_array(int, g->nnode);
 
-        if (g->edges == NULL)
+        if (g->nodes == NULL || g->present == NULL || g->nedge == NULL)
             goto fail;
 
         for (i = 0; i < r->ntarget; i++) {
@@ -200,10 +215,8 @@ static graph_t *build_graph(mrp_resolver_t *r)
                 mrp_debug("adding edge: %s <- %s", t->depends[j], t->name);
                 did = node_id(g, t->depends[j]);
 
-                if (did < 0)
+                if (did < 0 || !add_edge(g, did, tid))
                     goto fail;
-
-                *edge_markp(g, did, tid) = 1;
             }
         }
     }
@@ -211,45 +224,11 @@ static graph_t *build_graph(mrp_resolver_t *r)
     return g;
 
  fail:
-    if (g != NULL) {
-        mrp_free(g->edges);
-        mrp_free(g);
-    }
+    free_graph(g);
     return NULL;
 }
 
 
-static int mark_present_nodes(graph_t *g, int target_idx)
-{
-    int       tid, did, i;
-    target_t *t;
-
-    tid = g->r->nfact + target_idx;
-    t   = g->r->targets + target_idx;
-
-    if (node_present(g, tid))
-        return TRUE;
-
-    mark_node(g, tid);
-
-    for (i = 0; i < t->ndepend; i++) {
-        did = node_id(g, t->depends[i]);
-
-        if (did < 0)
-            return FALSE;
-
-        if (*t->depends[i] == '$')
-            mark_node(g, did);
-        else {
-            if (!mark_present_nodes(g, did - g->r->nfact))
-                return FALSE;
-        }
-    }
-
-    return TRUE;
-}
-
-
 /*
  * queues we use for topological sorting
  */
@@ -312,6 +291,22 @@ static int que_pop(que_t *q, int *itemp)
 }
 
 
+static void mark_present_nodes(graph_t *g, int node, que_t *P)
+{
+    node_t *n = g->nodes + node;
+    int     i;
+
+    if (g->present[node])
+        return;
+
+    g->present[node] = TRUE;
+    que_push(P, node);
+
+    for (i = 0; i < n->ndep; i++)
+        mark_present_nodes(g, n->deps[i], P);
+}
+
+
 static int sort_graph(graph_t *g, int target_idx)
 {
     /*
@@ -321,9 +316,8 @@ static int sort_graph(graph_t *g, int target_idx)
      *   for our target with the given idx. We include only nodes
      *   for facts and targets which are relevant for our target.
      *   These are the ones which our target directly or indirectly
-     *   depends on. We use the otherwise unused diagonal (no target
-     *   can depend on itself) of our edge matrix to mark which nodes
-     *   are present in the graph. Then we use the following algorithm
+     *   depends on. We first collect these nodes in P and mark them
+     *   present in the graph. Then we use the following algorithm
      *   to sort the subgraph of relevant nodes:
      *
      *       initialize que L to be empty
@@ -331,56 +325,57 @@ static int sort_graph(graph_t *g, int target_idx)
      *       while Q is not empty
      *           pop a node <n> from Q
      *           push <n> to L
-     *           remove all edges that start from <n>
-     *           for all nodes <m> where we removed an incoming node
+     *           for all nodes <m> with an edge from <n>
+     *               remove the edge from <n> to <m>
      *               if <m> has no more incoming edges
      *                   push <m> to Q
      *
-     *       if there are any remaining edges
+     *       if L does not contain all the nodes
      *           return an error about cyclic dependency
      *       else
      *           L is the sorted subgraph (our target is the last item in L)
      *
-     *   The resulted sort order of our target is then used as the
-     *   dependency check/update order when the resolver is asked to
-     *   update that target.
+     *   Since all the dependencies of a present node are also present,
+     *   the number of incoming edges of a node in the subgraph is the
+     *   number of its dependencies. The resulted sort order of our
+     *   target is then used as the dependency check/update order when
+     *   the resolver is asked to update that target.
      */
 
     target_t *target;
-    int       edges[g->nnode * g->nnode];
-    que_t     L = EMPTY_QUE, Q = EMPTY_QUE;
-    int       i, j, m, id, node, nedge, nfact, ntarget;
+    node_t   *n;
+    que_t     P = EMPTY_QUE, L = EMPTY_QUE, Q = EMPTY_QUE;
+    int       i, m, id, node, nnode, nfact, ntarget;
 
     target = g->r->targets + target_idx;
 
-    /* save full graph */
-    memcpy(edges, g->edges, sizeof(edges));
-
-    if (!que_init(&L, g->nnode + 1) || !que_init(&Q, g->nnode))
+    if (!que_init(&P, g->nnode + 1))
         goto fail;
 
     /* find and mark relevant nodes in the graph */
-    mark_present_nodes(g, target_idx);
+    mark_present_nodes(g, g->r->nfact + target_idx, &P);
+    nnode = P.tail;
+
+    if (!que_init(&L, nnode + 1) || !que_init(&Q, nnode + 1))
+        goto fail;
 
     mrp_debug("-- target %s --", target->name);
-    /*dump_graph(g, stdout);*/
 
     /* push all relevant facts, they do not depend on anything */
-    for (i = 0; i < g->r->nfact; i++) {
-        id = i;
-        if (node_present(g, id)) {
+    for (i = 0; i < nnode; i++) {
+        id = P.items[i];
+        g->nedge[id] = g->nodes[id].ndep;
+
+        if (id < g->r->nfact)
             que_push(&Q, id);
-            unmark_node(g, id);
-        }
     }
 
     /* push all relevant targets that have no dependencies */
-    for (i = 0; i < g->r->ntarget; i++) {
-        id = g->r->nfact + i;
-        if (g->r->targets[i].depends == NULL && node_present(g, id)) {
+    for (i = 0; i < nnode; i++) {
+        id = P.items[i];
+
+        if (id >= g->r->nfact && g->nedge[id] == 0)
             que_push(&Q, id);
-            unmark_node(g, id);
-        }
     }
 
     /* try sorting the marked subgraph */
@@ -389,40 +384,27 @@ static int sort_graph(graph_t *g, int target_idx)
 
         mrp_debug("popped node %s", node_name(g, node));
 
-        for (m = 0; m < g->nnode; m++) {
-            if (m == node || !node_present(g, m))
+        n = g->nodes + node;
+
+        for (i = 0; i < n->nuser; i++) {
+            m = n->users[i];
+
+            if (!g->present[m])
                 continue;
-            *edge_markp(g, node, m) = 0;
-            nedge = 0;
-            for (j = 0; j < g->nnode; j++) {
-                if (j == m)
-                    continue;
-                if (node_present(g, j) && *edge_markp(g, j, m))
-                    nedge++;
-            }
-            if (nedge == 0) {
+
+            if (--g->nedge[m] == 0) {
                 mrp_debug("node %s empty, pushing it", node_name(g, m));
                 que_push(&Q, m);
-                unmark_node(g, m);
             }
             else
                 mrp_debug("node %s not empty yet", node_name(g, m));
         }
     }
 
-    /* check if the subgraph has any remaining edges */
-    nedge = 0;
-    for (node = 0; node < g->nnode; node++) {
-        if (!node_present(g, node))
-            continue;
-        for (m = 0; m < g->nnode; m++) {
-            if (m == node || !node_present(g, m))
-                continue;
-            if (*edge_markp(g, node, m) == 1) {
-                errno = ELOOP;
-                goto fail;
-            }
-        }
+    /* check if the subgraph had any nodes left on a cycle */
+    if (L.tail != nnode) {
+        errno = ELOOP;
+        goto fail;
     }
 
     mrp_debug("----- %s: graph sorted successfully -----", target->name);
@@ -458,10 +440,13 @@ static int sort_graph(graph_t *g, int target_idx)
 
         if (ntarget > 0) {
             target->update_targets = mrp_alloc_array(int, ntarget + 1);
-            if (target->update_targets != NULL) {
+            target->saved_dirty    = mrp_allocz_array(char, ntarget);
+            if (target->update_targets != NULL &&
+                target->saved_dirty != NULL) {
                 for (i = 0; i < ntarget; i++)
                     target->update_targets[i] = L.items[nfact+i] - g->r->nfact;
                 target->update_targets[i] = -1;
+                target->nupdate = ntarget;
             }
             else
                 goto fail;
@@ -503,28 +488,114 @@ static int sort_graph(graph_t *g, int target_idx)
             goto fail;
     }
 
+    for (i = 0; i < P.tail; i++)
+        g->present[P.items[i]] = FALSE;
+
+    que_cleanup(&P);
     que_cleanup(&L);
     que_cleanup(&Q);
 
-    /* restore the original full graph */
-    memcpy(g->edges, edges, sizeof(edges));
-
     return 0;
 
  fail:
+    if (P.items != NULL)
+        for (i = 0; i < P.tail; i++)
+            g->present[P.items[i]] = FALSE;
+
+    que_cleanup(&P);
     que_cleanup(&L);
     que_cleanup(&Q);
 
-    memcpy(g->edges, edges, sizeof(edges));
-
     return -1;
 }
 
 
+static int add_dependent(int **dependents, int *ndependent, int id)
+{
+    if (!mrp_reallocz(*dependents, *ndependent, *ndependent + 1))
+        return FALSE;
+
+    (*dependents)[(*ndependent)++] = id;
+
+    return TRUE;
+}
+
+
+static int link_dependents(mrp_resolver_t *r)
+{
+    target_t *t, *dep;
+    fact_t   *f;
+    int       i, j, id;
+
+    /*
+     * Collect the reverse of the direct dependency edges, ie. the
+     * targets directly depending on each fact and target. These are
+     * used to propagate dirtiness when facts change or targets get
+     * updated. We also mark dirty any target that has not been updated
+     * yet and has a direct fact dependency that has been modified.
+     *
+     * Also flag the targets on the update path of the autoupdate
+     * target and recount the dirty ones among them. Only these can
+     * be brought up to date by scheduling an autoupdate.
+     */
+
+    r->ndirty = 0;
+
+    for (i = 0, t = r->targets; i < r->ntarget; i++, t++)
+        t->autoupdate = FALSE;
+
+    if (r->auto_update != NULL && r->auto_update->update_targets != NULL) {
+        for (i = 0; (id = r->auto_update->update_targets[i]) >= 0; i++) {
+            t = r->targets + id;
+            t->autoupdate = TRUE;
+
+            if (t->dirty)
+                r->ndirty++;
+        }
+    }
+
+    for (i = 0, t = r->targets; i < r->ntarget; i++, t++) {
+        for (j = 0; j < t->ndirect; j++) {
+            if ((id = t->directs[j]) < 0)
+                continue;
+
+            if (id < r->nfact) {
+                f = r->facts + id;
+
+                if (!add_dependent(&f->dependents, &f->ndependent, i))
+                    return -1;
+
+                if (t->stamp == 0 && fact_stamp(r, id) > 0)
+                    mark_target_dirty(r, i);
+            }
+            else {
+                dep = r->targets + (id - r->nfact);
+
+                if (!add_dependent(&dep->dependents, &dep->ndependent, i))
+                    return -1;
+            }
+        }
+    }
+
+    return 0;
+}
+
+
 static void free_graph(graph_t *g)
 {
+    int i;
+
     if (g != NULL) {
-        mrp_free(g->edges);
+        if (g->nodes != NULL) {
+            for (i = 0; i < g->nnode; i++) {
+                mrp_free(g->nodes[i].deps);
+                mrp_free(g->nodes[i].users);
+            }
+        }
+
+        mrp_free(g->nodes);
+        mrp_free(g->present);
+        mrp_free(g->nedge);
         mrp_free(g);
     }
 }
@@ -532,19 +603,17 @@ static void free_graph(graph_t *g)
 
 static void dump_graph(graph_t *g, FILE *fp)
 {
-    int i, j;
+    node_t *n;
+    int     i, j;
 
     fprintf(fp, "Graph edges:\n");
 
-    fprintf(fp, "  %20.20s ", "");
-    for (i = 0; i < g->nnode; i++)
-        fprintf(fp, " %d", i % 10);
-    fprintf(fp, "\n");
-
     for (i = 0; i < g->nnode; i++) {
-        fprintf(fp, "  %20.20s: ", node_name(g, i));
-        for (j = 0; j < g->nnode; j++)
-            fprintf(fp, "%d ", *edge_markp(g, i, j));
+        n = g->nodes + i;
+
+        fprintf(fp, "  %20.20s:", node_name(g, i));
+        for (j = 0; j < n->nuser; j++)
+            fprintf(fp, " %s", node_name(g, n->users[j]));
         fprintf(fp, "\n");
     }
 }
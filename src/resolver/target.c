@@ -34,6 +34,7 @@
 #include <murphy/common/log.h>
 #include <murphy/common/mm.h>
 #include <murphy/common/list.h>
+#include <murphy/common/utils.h>
 
 #include <murphy/core/scripting.h>
 
@@ -92,6 +93,8 @@ static void purge_target(target_t *t)
     mrp_free(t->update_targets);
     mrp_free(t->fact_stamps);
     mrp_free(t->directs);
+    mrp_free(t->dependents);
+    mrp_free(t->saved_dirty);
 
     for (i = 0; i < t->ndepend; i++)
         mrp_free(t->depends[i]);
@@ -106,6 +109,11 @@ void destroy_targets(mrp_resolver_t *r)
     target_t *t;
     int       i;
 
+    if (r->target_tbl != NULL) {
+        mrp_htbl_destroy(r->target_tbl, FALSE);
+        r->target_tbl = NULL;
+    }
+
     for (i = 0, t = r->targets; i < r->ntarget; i++, t++)
         purge_target(t);
 
@@ -122,30 +130,52 @@ target_t *create_target(mrp_resolver_t *r, const char *target,
                         const char **depends, int ndepend,
                         const char *script_type, const char *script_source)
 {
-    target_t *t;
-    size_t    old_size, new_size;
-    int       i, j, found, nduplicate;
+    mrp_htbl_config_t  hcfg;
+    target_t          *t;
+    size_t             old_size, new_size;
+    int                i, j, found, nduplicate, auto_update;
 
-    for (i = 0, t = r->targets; i < r->ntarget; i++, t++) {
-        if (!strcmp(t->name, target)) {
-            errno = EEXIST;
+    if (lookup_target(r, target) != NULL) {
+        errno = EEXIST;
+        return NULL;
+    }
+
+    if (r->target_tbl == NULL) {
+        mrp_clear(&hcfg);
+        hcfg.comp   = mrp_string_comp;
+        hcfg.hash   = mrp_string_hash;
+        hcfg.nentry = 64;
+
+        if ((r->target_tbl = mrp_htbl_create(&hcfg)) == NULL)
             return NULL;
-        }
     }
 
     old_size = sizeof(*r->targets) *  r->ntarget;
     new_size = sizeof(*r->targets) * (r->ntarget + 1);
 
+    /* the target array may move, keep the autoupdate target valid */
+    auto_update = r->auto_update ? r->auto_update - r->targets : -1;
+
     if (!mrp_reallocz(r->targets, old_size, new_size))
         return NULL;
 
+    if (auto_update >= 0)
+        r->auto_update = r->targets + auto_update;
+
     t       = r->targets + r->ntarget++;
     t->name = mrp_strdup(target);
 
     if (t->name == NULL)
         goto undo_and_fail;
 
-    if (depends != NULL) {
+    if (!mrp_htbl_insert(r->target_tbl, t->name,
+                         NAME_TABLE_ENTRY(r->ntarget - 1)))
+        goto undo_and_fail;
+
+    /* the update orders need to be recalculated */
+    r->sorted = FALSE;
+
+    if (depends != NULL && ndepend > 0) {
         t->depends = mrp_allocz_array(char *, ndepend);
 
         if (t->depends != NULL) {
@@ -158,7 +188,7 @@ target_t *create_target(mrp_resolver_t *r, const char *target,
                 if (!found) {
                     t->depends[i - nduplicate] = mrp_strdup(depends[i]);
 
-                    if (t->depends[i] == NULL)
+                    if (t->depends[i - nduplicate] == NULL)
                         goto undo_and_fail;
                 }
                 else
@@ -203,10 +233,15 @@ target_t *create_target(mrp_resolver_t *r, const char *target,
 
 
  undo_and_fail:
+    if (t->name != NULL)
+        mrp_htbl_remove(r->target_tbl, t->name, FALSE);
     purge_target(t);
     mrp_realloc(r->targets, old_size);
     r->ntarget--;
 
+    if (auto_update >= 0)
+        r->auto_update = r->targets + auto_update;
+
     return NULL;
 }
 
@@ -299,114 +334,69 @@ int prepare_target_scripts(mrp_resolver_t *r)
 }
 
 
-static int older_than_facts(mrp_resolver_t *r, target_t *t)
+void mark_target_dirty(mrp_resolver_t *r, int id)
 {
-    int i, id;
+    target_t *t = r->targets + id;
 
     /*
-     * If a target does not depend directly or indirectly on any
-     * facts, it always needs to be updated and is considered to
-     * be older than its (nonexistent) fact dependencies even if
-     * this seems a bit unintuitive at first. If there are fact
-     * dependencies the target is considered older if any of the
-     * facts have a newer stamp than the target.
+     * Only dirty targets on the autoupdate path are counted, since
+     * only those get updated by a scheduled autoupdate. The rest are
+     * updated only when something triggers them explicitly.
      */
 
-    if (t->update_facts == NULL)
-        return TRUE;
-    else {
-#ifdef CHECK_TRANSITIVE_CLOSURE_OF_FACTS
-        for (i = 0; (id = t->update_facts[i]) >= 0; i++) {
-            if (fact_stamp(r, id) > t->fact_stamps[i])
-                return TRUE;
-        }
-#else
-        for (i = 0; i < t->ndirect; i++) {
-            id = t->directs[i];
-
-            if (id < r->nfact) {
-                if (fact_stamp(r, id) > t->fact_stamps[i])
-                    return TRUE;
-            }
-        }
-#endif
+    if (!t->dirty) {
+        t->dirty = TRUE;
+        if (t->autoupdate)
+            r->ndirty++;
     }
-
-    return FALSE;
 }
 
 
-static int older_than_targets(mrp_resolver_t *r, target_t *t)
+static void clear_target_dirty(mrp_resolver_t *r, target_t *t)
 {
-    int       i, id;
-    target_t *dep;
-
-    /*
-     * Although the target itself is always the last item in its own
-     * sorted target dependencies (as the list is the topologically
-     * sorted dependency graph) we don't special case this out here as
-     * a target cannot be newer than itself by definition.
-     */
-
-    for (i = 0; (id = t->update_targets[i]) >= 0; i++) {
-        dep = r->targets + id;
-
-        if (dep->stamp > t->stamp)
-            return TRUE;
+    if (t->dirty) {
+        t->dirty = FALSE;
+        if (t->autoupdate)
+            r->ndirty--;
     }
-
-    return FALSE;
 }
 
 
-static void save_fact_stamps(mrp_resolver_t *r, target_t *t, uint32_t *buf)
+static int needs_update(target_t *t)
 {
-    int id, idx, i;
-
-    if (t->update_facts != NULL) {
-        id  = t - r->targets;
-        idx = id * r->nfact;
+    /*
+     * If a target does not depend directly or indirectly on any
+     * facts, it always needs to be updated. Otherwise it needs to
+     * be updated only if it has been marked dirty, ie. if any of
+     * its direct fact dependencies have changed or any of its direct
+     * target dependencies have been updated since its last update.
+     */
 
-        for (i = 0; (id = t->update_facts[i]) >= 0; i++, idx++)
-            buf[idx] = t->fact_stamps[i];
-    }
+    return t->update_facts == NULL || t->dirty;
 }
 
 
-static void restore_fact_stamps(mrp_resolver_t *r, target_t *t, uint32_t *buf)
+static void save_dirty_flags(mrp_resolver_t *r, target_t *t)
 {
-    int id, idx, i;
-
-    if (t->update_facts != NULL) {
-        id  = t - r->targets;
-        idx = id * r->nfact;
+    int i, id;
 
-        for (i = 0; (id = t->update_facts[i]) >= 0; i++, idx++)
-            t->fact_stamps[i] = buf[idx];
-    }
+    for (i = 0; (id = t->update_targets[i]) >= 0; i++)
+        t->saved_dirty[i] = r->targets[id].dirty ? 1 : 0;
 }
 
 
-static void save_target_stamps(mrp_resolver_t *r, target_t *t, uint32_t *buf)
+static void restore_dirty_flags(mrp_resolver_t *r, target_t *t)
 {
     target_t *dep;
     int       i, id;
 
     for (i = 0; (id = t->update_targets[i]) >= 0; i++) {
         dep = r->targets + id;
-        save_fact_stamps(r, dep, buf);
-    }
-}
-
-
-static void restore_target_stamps(mrp_resolver_t *r, target_t *t, uint32_t *buf)
-{
-    target_t *dep;
-    int       i, id;
 
-    for (i = 0; (id = t->update_targets[i]) >= 0; i++) {
-        dep = r->targets + id;
-        restore_fact_stamps(r, dep, buf);
+        if (t->saved_dirty[i])
+            mark_target_dirty(r, id);
+        else
+            clear_target_dirty(r, dep);
     }
 }
 
@@ -423,12 +413,33 @@ static void update_target_stamps(mrp_resolver_t *r, target_t *t)
 }
 
 
+static void target_updated(mrp_resolver_t *r, target_t *t)
+{
+    int i;
+
+    /*
+     * Pick up any changes the update script made to our own facts
+     * before clearing the target, so that a target updating its own
+     * facts does not end up marked dirty again.
+     */
+
+    check_target_facts(r, t);
+    clear_target_dirty(r, t);
+    update_target_stamps(r, t);
+
+    for (i = 0; i < t->ndependent; i++)
+        mark_target_dirty(r, t->dependents[i]);
+}
+
+
 static int update_target(mrp_resolver_t *r, target_t *t)
 {
     mqi_handle_t  tx;
     target_t     *dep;
-    uint32_t      stamps[r->ntarget * r->nfact];
-    int           i, id, status, needs_update, level;
+    int           i, id, status, update, level;
+
+    if (!r->sorted && sort_targets(r) != 0)
+        return -EINVAL;
 
     tx = start_transaction(r);
 
@@ -444,10 +455,19 @@ static int update_target(mrp_resolver_t *r, target_t *t)
     level = r->level++;
     emit_resolver_event(r, RESOLVER_UPDATE_STARTED, t->name, level);
 
-    save_target_stamps(r, t, stamps);
+    /*
+     * Catch changes to facts not made in a transaction. Facts are
+     * rescanned only once per update round. Changes made by the update
+     * scripts are picked up from the direct fact dependencies of each
+     * target on the update path as we go.
+     */
+    if (level == 0)
+        check_facts(r);
+
+    save_dirty_flags(r, t);
 
-    status       = TRUE;
-    needs_update = older_than_facts(r, t);
+    status = TRUE;
+    update = FALSE;
 
     for (i = 0; (id = t->update_targets[i]) >= 0; i++) {
         dep = r->targets + id;
@@ -455,33 +475,36 @@ static int update_target(mrp_resolver_t *r, target_t *t)
         if (dep == t)
             break;
 
-        /*                              hmm... is this really needed? */
-        if (older_than_facts(r, dep) || older_than_targets(r, dep)) {
-            needs_update = TRUE;
-            status       = mrp_execute_script(dep->script, r->ctbl);
+        check_target_facts(r, dep);
+
+        if (needs_update(dep)) {
+            update = TRUE;
+            status = mrp_execute_script(dep->script, r->ctbl);
 
             if (status <= 0)
                 break;
             else
-                update_target_stamps(r, dep);
+                target_updated(r, dep);
         }
     }
 
-    if (needs_update && status > 0) {
+    check_target_facts(r, t);
+
+    if ((update || needs_update(t)) && status > 0) {
         status = mrp_execute_script(t->script, r->ctbl);
 
         if (status > 0)
-            update_target_stamps(r, t);
+            target_updated(r, t);
     }
 
     if (status <= 0) {
         rollback_transaction(r, tx);
-        restore_target_stamps(r, t, stamps);
+        restore_dirty_flags(r, t);
         emit_resolver_event(r, RESOLVER_UPDATE_FAILED, t->name, level);
     }
     else {
         if (!commit_transaction(r, tx)) {
-            restore_target_stamps(r, t, stamps);
+            restore_dirty_flags(r, t);
             if (errno != 0)
                 status = -errno;
             else
@@ -502,15 +525,15 @@ static int update_target(mrp_resolver_t *r, target_t *t)
 
 target_t *lookup_target(mrp_resolver_t *r, const char *name)
 {
-   target_t *t;
-    int       i;
+    void *entry;
 
-    for (i = 0, t = r->targets; i < r->ntarget; i++, t++) {
-        if (!strcmp(t->name, name))
-            return t;
-    }
+    if (r->target_tbl == NULL)
+        return NULL;
 
-    return NULL;
+    if ((entry = mrp_htbl_lookup(r->target_tbl, (void *)name)) == NULL)
+        return NULL;
+
+    return r->targets + NAME_TABLE_INDEX(entry);
 }
 
 
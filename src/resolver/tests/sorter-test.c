@@ -0,0 +1,312 @@
+/*
+ * Copyright (c) 2012, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Test for sorting resolver targets into update order.
+ *
+ * A random acyclic dependency graph is added to the resolver in a
+ * shuffled order, in two batches. The update scripts of the targets
+ * log their ids. Since none of the targets depend on facts, updating
+ * a target runs the scripts of its full dependency closure, so the log
+ * gives the computed update order. The order must contain exactly the
+ * closure, with every target after all of its dependencies, both before
+ * and after the second batch of targets has been added. Resolvers with
+ * cyclic or unknown dependencies must fail to update.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include <murphy/common.h>
+#include <murphy/core/context.h>
+#include <murphy/resolver/resolver.h>
+#include <murphy-db/mqi.h>
+
+#define NTARGET 48                       /* targets in the graph */
+#define NFIRST  32                       /* targets in the first batch */
+#define MAXDEP  3                        /* max. dependencies per target */
+
+#define CHECK(cond, ...) do {                                   \
+        if (!(cond)) {                                          \
+            printf("FAIL: " __VA_ARGS__);                       \
+            printf("\n");                                       \
+            nfail++;                                            \
+        }                                                       \
+    } while (0)
+
+#define fatal(fmt, args...) do {                                \
+        printf("fatal error: "fmt"\n" , ## args);               \
+        exit(1);                                                \
+    } while (0)
+
+typedef struct {
+    int         id;                      /* target index */
+    char        name[8];                 /* target name */
+    const char *depends[MAXDEP];         /* dependency names */
+    int         deps[MAXDEP];            /* dependency indices */
+    int         ndep;                    /* number of dependencies */
+} test_target_t;
+
+static mrp_context_t *ctx;
+static test_target_t  targets[NTARGET];
+static int            order[NTARGET];    /* update order logged */
+static int            norder;
+static int            nfail;
+
+
+static int execute_cb(mrp_scriptlet_t *script, mrp_context_tbl_t *ctbl)
+{
+    test_target_t *t = script->data;
+
+    MRP_UNUSED(ctbl);
+
+    if (norder < NTARGET)
+        order[norder] = t->id;
+    norder++;
+
+    return TRUE;
+}
+
+
+static mrp_interpreter_t interpreter = {
+    .name    = "sorter-test",
+    .execute = execute_cb,
+};
+
+
+static void create_graph(void)
+{
+    test_target_t *t;
+    int            i, j, dep;
+
+    /*
+     * Target i only depends on targets < i, so the graph is acyclic.
+     * Dependencies may be listed more than once.
+     */
+    for (i = 0; i < NTARGET; i++) {
+        t = targets + i;
+        t->id = i;
+        snprintf(t->name, sizeof(t->name), "t%02d", i);
+
+        if (i == 0)
+            continue;
+
+        t->ndep = rand() % (MAXDEP + 1);
+
+        for (j = 0; j < t->ndep; j++) {
+            dep = rand() % i;
+
+            t->deps[j]    = dep;
+            t->depends[j] = targets[dep].name;
+        }
+    }
+}
+
+
+static void add_target(mrp_resolver_t *r, test_target_t *t)
+{
+    if (!mrp_resolver_add_prepared_target(r, t->name, t->depends, t->ndep,
+                                          &interpreter, NULL, t))
+        fatal("failed to add target %s", t->name);
+}
+
+
+static void add_targets(mrp_resolver_t *r, int first, int last)
+{
+    int perm[NTARGET], i, j, tmp;
+
+    for (i = first; i < last; i++)
+        perm[i] = i;
+
+    for (i = last - 1; i > first; i--) {
+        j = first + rand() % (i - first + 1);
+        tmp = perm[i]; perm[i] = perm[j]; perm[j] = tmp;
+    }
+
+    for (i = first; i < last; i++)
+        add_target(r, targets + perm[i]);
+}
+
+
+static void mark_closure(int id, bool *closure)
+{
+    int i;
+
+    if (closure[id])
+        return;
+
+    closure[id] = true;
+
+    for (i = 0; i < targets[id].ndep; i++)
+        mark_closure(targets[id].deps[i], closure);
+}
+
+
+static void check_order(mrp_resolver_t *r, int id)
+{
+    bool closure[NTARGET], seen[NTARGET];
+    int  i, j, n, tid;
+
+    memset(closure, 0, sizeof(closure));
+    memset(seen, 0, sizeof(seen));
+    mark_closure(id, closure);
+
+    norder = 0;
+
+    CHECK(mrp_resolver_update_targetl(r, targets[id].name, NULL) > 0,
+          "updating %s failed", targets[id].name);
+
+    for (i = n = 0; i < NTARGET; i++)
+        if (closure[i])
+            n++;
+
+    CHECK(norder == n, "%s: %d targets updated, expected %d",
+          targets[id].name, norder, n);
+
+    if (norder > NTARGET)
+        return;
+
+    for (i = 0; i < norder; i++) {
+        tid = order[i];
+
+        CHECK(closure[tid], "%s: %s is not a dependency",
+              targets[id].name, targets[tid].name);
+        CHECK(!seen[tid], "%s: %s updated twice",
+              targets[id].name, targets[tid].name);
+
+        for (j = 0; j < targets[tid].ndep; j++)
+            CHECK(seen[targets[tid].deps[j]],
+                  "%s: %s updated before its dependency %s",
+                  targets[id].name, targets[tid].name,
+                  targets[targets[tid].deps[j]].name);
+
+        seen[tid] = true;
+    }
+
+    CHECK(norder > 0 && order[norder - 1] == id,
+          "%s: not updated last", targets[id].name);
+}
+
+
+static void test_update_order(void)
+{
+    mrp_resolver_t *r;
+    int             i;
+
+    if ((r = mrp_resolver_create(ctx)) == NULL)
+        fatal("failed to create resolver");
+
+    add_targets(r, 0, NFIRST);
+
+    for (i = 0; i < NFIRST; i++)
+        check_order(r, i);
+
+    /* adding targets must get the update orders recalculated */
+    add_targets(r, NFIRST, NTARGET);
+
+    for (i = 0; i < NTARGET; i++)
+        check_order(r, i);
+
+    mrp_resolver_destroy(r);
+}
+
+
+static void check_failure(const char *what, const char **names,
+                          const char **depends, int ntarget)
+{
+    mrp_resolver_t *r;
+    int             i;
+
+    if ((r = mrp_resolver_create(ctx)) == NULL)
+        fatal("failed to create resolver");
+
+    for (i = 0; i < ntarget; i++)
+        if (!mrp_resolver_add_target(r, names[i], depends + i,
+                                     depends[i] ? 1 : 0, NULL, NULL))
+            fatal("failed to add target %s", names[i]);
+
+    for (i = 0; i < ntarget; i++)
+        CHECK(mrp_resolver_update_targetl(r, names[i], NULL) <= 0,
+              "%s: updating %s did not fail", what, names[i]);
+
+    mrp_resolver_destroy(r);
+}
+
+
+static void test_failures(void)
+{
+    const char *names[]     = { "a" , "b", "c", "d", "e"  };
+    const char *cycle[]     = { "c" , "a", "b", "a", NULL };
+    const char *self[]      = { NULL, "b", NULL };
+    const char *missing[]   = { NULL, "x", "b"  };
+
+    check_failure("cycle"     , names, cycle  , 5);
+    check_failure("self-cycle", names, self   , 3);
+    check_failure("missing"   , names, missing, 3);
+}
+
+
+int main(int argc, char *argv[])
+{
+    MRP_UNUSED(argc);
+    MRP_UNUSED(argv);
+
+    if ((ctx = mrp_context_create()) == NULL)
+        fatal("failed to create context");
+
+    /* target updates run in database transactions */
+    if (mqi_open() < 0)
+        fatal("failed to open database");
+
+    srand(7);
+
+    create_graph();
+
+    test_update_order();
+    test_failures();
+
+    if (nfail) {
+        printf("%d resolver target sorting checks failed\n", nfail);
+        return 1;
+    }
+
+    printf("resolver target sorting tests passed\n");
+
+    return 0;
+}
+
+/*
+ * Local Variables:
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ *
+ */
@@ -0,0 +1,338 @@
+/*
+ * Copyright (c) 2012, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Test for resolver target updates.
+ *
+ * The targets are prepared with an interpreter that only logs which
+ * targets got updated. Facts are murphy-db tables touched by inserting
+ * rows into them. After each fact change we check that exactly the
+ * targets affected by the change are updated, and in dependency order.
+ * We also check that dirty targets which are not on the update path of
+ * the autoupdate target do not keep the autoupdate scheduled.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <murphy/common.h>
+#include <murphy/core/context.h>
+#include <murphy/resolver/resolver.h>
+#include <murphy-db/mqi.h>
+
+#define CHECK(cond, ...) do {                                   \
+        if (!(cond)) {                                          \
+            printf("FAIL: " __VA_ARGS__);                       \
+            printf("\n");                                       \
+            nfail++;                                            \
+        }                                                       \
+    } while (0)
+
+#define fatal(fmt, args...) do {                                \
+        printf("fatal error: "fmt"\n" , ## args);               \
+        exit(1);                                                \
+    } while (0)
+
+typedef struct {
+    const char *name;                    /* target name */
+    const char *depends[2];              /* target dependencies */
+    int         ndepend;                 /* number of dependencies */
+    const char *touch;                   /* fact the update script touches */
+} test_target_t;
+
+typedef struct {
+    uint32_t value;
+} row_t;
+
+static const char *facts[] = { "fa", "fb", "fx", "fy" };
+
+/*
+ * Targets u, t and v end up on the autoupdate path. t depends directly
+ * only on $fb but has $fa among its indirect facts, and v updates one
+ * of its own facts. w is added after the autoupdate target.
+ */
+static test_target_t targets[] = {
+    { "u", { "$fa"         }, 1, NULL },
+    { "t", { "$fb", "u"    }, 2, NULL },
+    { "v", { "t"  , "$fy"  }, 2, "fy" },
+    { "w", { "$fx"         }, 1, NULL },
+};
+
+static mrp_context_t  *ctx;
+static mrp_resolver_t *r;
+static mqi_handle_t    tables[MRP_ARRAY_SIZE(facts)];
+static char            updated[64];
+static int             nautoupdate;
+static uint32_t        nrow;
+static int             nfail;
+
+MQI_COLUMN_SELECTION_LIST(columns,
+    MQI_COLUMN_SELECTOR(0, row_t, value)
+);
+
+
+static void touch_fact(const char *name)
+{
+    mqi_handle_t  tx;
+    uint32_t      i;
+    row_t         row;
+    void         *data[2];
+
+    for (i = 0; i < MRP_ARRAY_SIZE(facts); i++)
+        if (!strcmp(facts[i], name))
+            break;
+
+    if (i >= MRP_ARRAY_SIZE(facts))
+        fatal("unknown fact %s", name);
+
+    row.value = nrow++;
+    data[0]   = &row;
+    data[1]   = NULL;
+
+    if ((tx = mqi_begin_transaction()) == MQI_HANDLE_INVALID)
+        fatal("failed to begin transaction");
+
+    if (mqi_insert_into(tables[i], 0, columns, data) != 1)
+        fatal("failed to insert into %s", name);
+
+    if (mqi_commit_transaction(tx) < 0)
+        fatal("failed to commit transaction");
+}
+
+
+static int execute_cb(mrp_scriptlet_t *script, mrp_context_tbl_t *ctbl)
+{
+    test_target_t *t = script->data;
+
+    MRP_UNUSED(ctbl);
+
+    if (*updated)
+        strcat(updated, " ");
+    strcat(updated, t->name);
+
+    if (t->touch != NULL)
+        touch_fact(t->touch);
+
+    return TRUE;
+}
+
+
+static mrp_interpreter_t interpreter = {
+    .name    = "update-test",
+    .execute = execute_cb,
+};
+
+
+static void event_cb(mrp_event_watch_t *w, uint32_t id, int format,
+                     void *data, void *user_data)
+{
+    mrp_msg_field_t *f;
+
+    MRP_UNUSED(w);
+    MRP_UNUSED(id);
+    MRP_UNUSED(user_data);
+
+    if (format != MRP_EVENT_FORMAT_MSG)
+        return;
+
+    f = mrp_msg_find(data, MRP_RESOLVER_TAG_TARGET);
+
+    if (f != NULL && !strcmp(f->str, "autoupdate"))
+        nautoupdate++;
+}
+
+
+static void tick_cb(mrp_timer_t *t, void *user_data)
+{
+    MRP_UNUSED(t);
+    MRP_UNUSED(user_data);
+}
+
+
+static void add_target(test_target_t *t)
+{
+    if (!mrp_resolver_add_prepared_target(r, t->name, t->depends, t->ndepend,
+                                          &interpreter, NULL, t))
+        fatal("failed to add target %s", t->name);
+}
+
+
+static void setup(void)
+{
+    MQI_COLUMN_DEFINITION_LIST(coldefs,
+        MQI_COLUMN_DEFINITION("value", MQI_UNSIGNED)
+    );
+    mrp_event_bus_t *bus;
+    uint32_t         i;
+
+    if ((ctx = mrp_context_create()) == NULL)
+        fatal("failed to create context");
+
+    if (mqi_open() < 0)
+        fatal("failed to open database");
+
+    for (i = 0; i < MRP_ARRAY_SIZE(facts); i++) {
+        tables[i] = mqi_create_table((char *)facts[i], MQI_TEMPORARY, NULL,
+                                     coldefs);
+
+        if (tables[i] == MQI_HANDLE_INVALID)
+            fatal("failed to create table %s", facts[i]);
+    }
+
+    if ((r = mrp_resolver_create(ctx)) == NULL)
+        fatal("failed to create resolver");
+
+    for (i = 0; i < 3; i++)
+        add_target(targets + i);
+
+    if (!mrp_resolver_enable_autoupdate(r, "autoupdate"))
+        fatal("failed to enable autoupdate");
+
+    bus = mrp_event_bus_get(ctx->ml, MRP_RESOLVER_BUS);
+
+    if (bus == NULL ||
+        !mrp_event_add_watch(bus, mrp_event_id(MRP_RESOLVER_EVENT_STARTED),
+                             event_cb, NULL))
+        fatal("failed to watch resolver events");
+
+    /* keep the mainloop from blocking when nothing else is pending */
+    if (mrp_add_timer(ctx->ml, 1, tick_cb, NULL) == NULL)
+        fatal("failed to create timer");
+}
+
+
+static void update(const char *target, const char *expected)
+{
+    *updated = '\0';
+
+    CHECK(mrp_resolver_update_targetl(r, target, NULL) > 0,
+          "updating %s failed", target);
+    CHECK(!strcmp(updated, expected),
+          "updating %s updated '%s', expected '%s'", target, updated,
+          expected);
+}
+
+
+static void run_mainloop(void)
+{
+    int i;
+
+    for (i = 0; i < 5; i++)
+        mrp_mainloop_iterate(ctx->ml);
+}
+
+
+static void test_update_order(void)
+{
+    /* initially every target with facts is out of date */
+    update("autoupdate", "u t v");
+    update("autoupdate", "");
+
+    /* a direct fact of t, which is not the first fact in its closure */
+    touch_fact("fb");
+    update("t", "t");
+    update("autoupdate", "v");
+
+    touch_fact("fa");
+    update("autoupdate", "u t v");
+
+    /* v updating its own fact does not leave it out of date */
+    touch_fact("fy");
+    update("v", "v");
+    update("v", "");
+
+    run_mainloop();
+}
+
+
+static void test_offpath_target(void)
+{
+    add_target(targets + 3);
+
+    /* the first update after adding w sorts the targets again */
+    touch_fact("fx");
+    run_mainloop();
+
+    update("w", "w");
+    update("w", "");
+
+    /* w is not on the autoupdate path, it must not trigger autoupdates */
+    nautoupdate = 0;
+    *updated    = '\0';
+
+    touch_fact("fx");
+    run_mainloop();
+
+    CHECK(nautoupdate == 0, "%d autoupdates for an off-path target",
+          nautoupdate);
+    CHECK(!*updated, "autoupdate updated '%s'", updated);
+
+    update("w", "w");
+
+    /* while a change on the path is still autoupdated once */
+    *updated = '\0';
+
+    touch_fact("fa");
+    run_mainloop();
+
+    CHECK(nautoupdate == 1, "%d autoupdates for a fact change", nautoupdate);
+    CHECK(!strcmp(updated, "u t v"), "autoupdate updated '%s'", updated);
+}
+
+
+int main(int argc, char *argv[])
+{
+    MRP_UNUSED(argc);
+    MRP_UNUSED(argv);
+
+    setup();
+
+    test_update_order();
+    test_offpath_target();
+
+    mrp_resolver_destroy(r);
+
+    if (nfail) {
+        printf("%d resolver update checks failed\n", nfail);
+        return 1;
+    }
+
+    printf("resolver update tests passed\n");
+
+    return 0;
+}
+
+/*
+ * Local Variables:
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ *
+ */
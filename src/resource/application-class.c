@@ -93,6 +93,7 @@ typedef struct {
 
 static MRP_LIST_HOOK(class_list);
 static mrp_htbl_t *name_hash;
+static uint32_t index_seq;
 
 static void init_name_hash(void);
 static int  add_to_name_hash(mrp_application_class_t *);
@@ -103,6 +104,15 @@ static void remove_from_name_hash(mrp_application_class_t *);
 static mqi_handle_t get_database_table(void);
 static void insert_into_application_class_table(const char *, uint32_t);
 
+static uint32_t index_level(void);
+static mrp_resource_set_t *index_find(mrp_application_class_index_t *,
+                                      uint32_t, uint32_t,
+                                      mrp_resource_set_t ***);
+static mrp_resource_set_t *index_insert(mrp_application_class_index_t *,
+                                        mrp_resource_set_t *);
+static void index_remove(mrp_application_class_index_t *,
+                         mrp_resource_set_t *);
+
 
 mrp_application_class_t *mrp_application_class_create(const char *name,
                                                     uint32_t pri,
@@ -309,31 +319,44 @@ int mrp_application_class_add_resource_set(const char *class_name,
 void mrp_application_class_move_resource_set(mrp_resource_set_t *rset)
 {
     mrp_application_class_t *class;
-    mrp_list_hook_t *list, *lentry, *n, *insert_before;
-    mrp_resource_set_t *rentry;
-    uint32_t key;
+    mrp_application_class_index_t *idx;
+    mrp_list_hook_t *insert_before;
+    mrp_resource_set_t *prev;
     uint32_t zone;
 
     MRP_ASSERT(rset, "invalid argument");
 
-    mrp_list_delete(&rset->class.list);
+    mrp_application_class_remove_resource_set(rset);
 
     class = rset->class.ptr;
     zone  = rset->zone;
+    idx   = class->index + zone;
 
-    list = insert_before = class->resource_sets + zone;
-    key  = mrp_application_class_get_sorting_key(rset);
+    /*
+     * Sets with equal keys are kept in the order they were (re)inserted,
+     * so the latest one goes after all the others with the same key.
+     */
+    rset->class.key = mrp_application_class_get_sorting_key(rset);
+    rset->class.seq = ++index_seq;
 
-    mrp_list_foreach_back(list, lentry, n) {
-        rentry = mrp_list_entry(lentry, mrp_resource_set_t, class.list);
+    if ((prev = index_insert(idx, rset)) != NULL)
+        insert_before = prev->class.list.next;
+    else
+        insert_before = class->resource_sets[zone].next;
 
-         if (key >= mrp_application_class_get_sorting_key(rentry))
-             break;
+    mrp_list_append(insert_before, &rset->class.list);
+}
 
-         insert_before = lentry;
-    }
+void mrp_application_class_remove_resource_set(mrp_resource_set_t *rset)
+{
+    mrp_application_class_t *class;
 
-    mrp_list_append(insert_before, &rset->class.list);
+    MRP_ASSERT(rset, "invalid argument");
+
+    if ((class = rset->class.ptr) && rset->class.nlevel)
+        index_remove(class->index + rset->zone, rset);
+
+    mrp_list_delete(&rset->class.list);
 }
 
 uint32_t mrp_application_class_get_sorting_key(mrp_resource_set_t *rset)
@@ -449,6 +472,103 @@ int mrp_application_class_print(char *buf, int len, bool with_rsets)
 }
 
 
+/*
+ * The resource sets of a class are kept in a doubly linked list per zone
+ * in ascending sorting key order. To find the place of a set in the list
+ * without walking through it, the sets are also kept in a skip list
+ * ordered by the cached key and insertion sequence number.
+ */
+
+static uint32_t index_level(void)
+{
+    static uint32_t state = 0x9e3779b9;
+    uint32_t level;
+
+    /* xorshift32 */
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+
+    /* every 4th node is promoted to the next level */
+    for (level = 1;  level < MRP_CLASS_INDEX_LEVELS;  level++) {
+        if ((state >> (2 * level)) & 3)
+            break;
+    }
+
+    return level;
+}
+
+static inline bool index_before(mrp_resource_set_t *rset,
+                                uint32_t key,
+                                uint32_t seq)
+{
+    if (rset->class.key != key)
+        return rset->class.key < key;
+    else
+        return rset->class.seq < seq;
+}
+
+static mrp_resource_set_t *index_find(mrp_application_class_index_t *idx,
+                                      uint32_t key,
+                                      uint32_t seq,
+                                      mrp_resource_set_t ***links)
+{
+    mrp_resource_set_t **next, *prev;
+    int level;
+
+    next = idx->next;
+    prev = NULL;
+
+    for (level = MRP_CLASS_INDEX_LEVELS - 1;  level >= 0;  level--) {
+        while (next[level] && index_before(next[level], key, seq)) {
+            prev = next[level];
+            next = prev->class.next;
+        }
+
+        links[level] = next + level;
+    }
+
+    return prev;
+}
+
+static mrp_resource_set_t *index_insert(mrp_application_class_index_t *idx,
+                                        mrp_resource_set_t *rset)
+{
+    mrp_resource_set_t **links[MRP_CLASS_INDEX_LEVELS];
+    mrp_resource_set_t *prev;
+    uint32_t level;
+
+    prev = index_find(idx, rset->class.key, rset->class.seq, links);
+
+    rset->class.nlevel = index_level();
+
+    for (level = 0;  level < rset->class.nlevel;  level++) {
+        rset->class.next[level] = *links[level];
+        *links[level] = rset;
+    }
+
+    return prev;
+}
+
+static void index_remove(mrp_application_class_index_t *idx,
+                         mrp_resource_set_t *rset)
+{
+    mrp_resource_set_t **links[MRP_CLASS_INDEX_LEVELS];
+    uint32_t level;
+
+    index_find(idx, rset->class.key, rset->class.seq, links);
+
+    for (level = 0;  level < rset->class.nlevel;  level++) {
+        MRP_ASSERT(*links[level] == rset, "corrupted resource set index");
+
+        *links[level] = rset->class.next[level];
+        rset->class.next[level] = NULL;
+    }
+
+    rset->class.nlevel = 0;
+}
+
+
 static void init_name_hash(void)
 {
     mrp_htbl_config_t  cfg;
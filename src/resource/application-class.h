@@ -34,6 +34,11 @@
 
 #include "data-types.h"
 
+#define MRP_CLASS_INDEX_LEVELS  12  /* skip list levels of the set index */
+
+typedef struct {
+    mrp_resource_set_t   *next[MRP_CLASS_INDEX_LEVELS];
+} mrp_application_class_index_t;
 
 
 struct mrp_application_class_s {
@@ -44,6 +49,7 @@ struct mrp_application_class_s {
     bool                  modal;
     mrp_resource_order_t  order;
     mrp_list_hook_t       resource_sets[MRP_ZONE_MAX];
+    mrp_application_class_index_t index[MRP_ZONE_MAX];
 };
 
 mrp_application_class_t *mrp_application_class_find(const char *);
@@ -52,6 +58,7 @@ mrp_resource_set_t *
 mrp_application_class_iterate_rsets(mrp_application_class_t*,uint32_t,void**);
 
 void mrp_application_class_move_resource_set(mrp_resource_set_t *);
+void mrp_application_class_remove_resource_set(mrp_resource_set_t *);
 
 uint32_t mrp_application_class_get_sorting_key(mrp_resource_set_t *);
 
@@ -117,6 +117,14 @@ mrp_resource_set_iterate_resources(mrp_resource_set_t *resource_set,void **it);
 uint32_t mrp_resource_get_id(mrp_resource_t *resource);
 const char *mrp_resource_get_name(mrp_resource_t *resource);
 mrp_resource_mask_t mrp_resource_get_mask(mrp_resource_t *resource);
+int mrp_resource_mask_print(const mrp_resource_mask_t *mask,char *buf,int len);
+
+/*
+ * Refuse to define more than max resources. Protocols that carry 32-bit
+ * resource masks lower the limit to MRP_RESOURCE_MAX32. Fails if more
+ * resources are already defined. The limit can only be lowered.
+ */
+int mrp_resource_definition_limit(uint32_t max);
 bool mrp_resource_is_shared(mrp_resource_t *resource);
 
 /* Find a resource set given the resource set id. */
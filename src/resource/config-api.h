@@ -30,6 +30,7 @@
 #ifndef __MURPHY_RESOURCE_CONFIG_API_H__
 #define __MURPHY_RESOURCE_CONFIG_API_H__
 
+#include <murphy/common/mainloop.h>
 #include <murphy/resource/data-types.h>
 
 void mrp_resource_configuration_init(void);
@@ -47,6 +48,10 @@ int mrp_application_class_print(char *buf, int len, bool with_resource_sets);
 
 int mrp_resource_owner_print(char *buf, int len);
 
+void mrp_resource_owner_set_incremental(bool incremental);
+
+int mrp_resource_set_batch_requests(mrp_mainloop_t *ml, uint32_t window);
+
 
 #endif  /* __MURPHY_RESOURCE_CONFIG_API_H__ */
 
@@ -1158,7 +1158,7 @@ static int resource_getfield(lua_State *L)
     field_t fld = field_check(L, 2, &name);
     mrp_resource_set_t *s;
     mrp_resource_t *r;
-    mrp_resource_mask_t m;
+    mrp_resource_mask_t *m;
 
     MRP_LUA_ENTER;
 
@@ -1180,16 +1180,16 @@ static int resource_getfield(lua_State *L)
         if (!(s = mrp_resource_set_find_by_id(res->rsetid))) {
             lua_pushnil(L);
             break;
-        } else {
-            m = ((mrp_resource_mask_t)1) << res->resid;
         }
 
         switch (fld) {
         case MANDATORY:
-            lua_pushboolean(L, s->resource.mask.mandatory & m ? true : false);
+            m = &s->resource.mask.mandatory;
+            lua_pushboolean(L, mrp_resource_mask_test(m, res->resid));
             break;
         case GRANT:
-            lua_pushboolean(L, s->resource.mask.grant & m ? true : false);
+            m = &s->resource.mask.grant;
+            lua_pushboolean(L, mrp_resource_mask_test(m, res->resid));
             break;
         default:
             lua_pushnil(L);
@@ -1333,6 +1333,10 @@ static int resmethod_setfield(lua_State *L)
     if (method) {
         switch (fld) {
         case VETO:
+            /* the veto gets the grant as a 32-bit integer */
+            if (mrp_resource_definition_limit(MRP_RESOURCE_MAX32) < 0)
+                luaL_error(L, "veto supports at most %d resources",
+                           MRP_RESOURCE_MAX32);
             lua_pushstring(L, name);
             lua_pushvalue(L, 3);
             method->veto = mrp_funcarray_check(L, -1);
@@ -36,11 +36,18 @@
 #include <murphy-db/mqi-types.h>
 
 /*
- * Remember: this should be smaller than
+ * Remember: this should not be bigger than
  * sizeof(mrp_zone_mask_t) * 8
  */
-#define MRP_ZONE_MAX            8
-#define MRP_ZONE_MASK           (((mrp_zone_mask_t)1 << MRP_ZONE_MAX) - 1)
+#define MRP_ZONE_MAX            64
+#define MRP_ZONE_MASK           (~(mrp_zone_mask_t)0)
+
+/*
+ * Remember: this should be a multiple of 64
+ */
+#define MRP_RESOURCE_MAX        256
+#define MRP_RESOURCE_MASK_WORDS (MRP_RESOURCE_MAX / 64)
+#define MRP_RESOURCE_MAX32      32    /* limit for 32-bit masks */
 
 #define MRP_KEY_STAMP_BITS      27
 #define MRP_KEY_STATE_BITS      1
@@ -51,7 +58,6 @@
 #define MRP_RESOURCE_ID_INVALID    (~(uint32_t)0)
 #define MRP_RESOURCE_REQNO_INVALID (~(uint32_t)0)
 
-#define MRP_RESOURCE_MAX  (sizeof(mrp_resource_mask_t) * 8)
 #define MRP_ATTRIBUTE_MAX (sizeof(mrp_attribute_mask_t) * 8)
 
 typedef enum   mrp_resource_state_e     mrp_resource_state_t;
@@ -76,9 +82,17 @@ typedef struct mrp_resource_mgr_s       mrp_resource_mgr_t;
 typedef struct mrp_resource_ownersref_s mrp_resource_ownersref_t;
 typedef struct mrp_resource_setref_s    mrp_resource_setref_t;
 
-typedef uint32_t                        mrp_resource_mask_t;
+typedef struct mrp_resource_mask_s      mrp_resource_mask_t;
 typedef uint32_t                        mrp_attribute_mask_t;
-typedef uint32_t                        mrp_zone_mask_t;
+typedef uint64_t                        mrp_zone_mask_t;
+
+/*
+ * a set of resources, bit n corresponding to resource definition #n.
+ * Use the mrp_resource_mask_...() functions below to manipulate them.
+ */
+struct mrp_resource_mask_s {
+    uint64_t bits[MRP_RESOURCE_MASK_WORDS];
+};
 
 
 enum mrp_resource_state_e {
@@ -151,6 +165,147 @@ struct mrp_resource_mgr_ftbl_s  {
 };
 
 
+/*
+ * resource mask operations. The masks are of fixed size and all the loops
+ * below have a constant trip count, so the compiler can unroll and
+ * vectorize them.
+ */
+
+#define MRP_RESOURCE_MASK_WORD(id)  ((id) >> 6)
+#define MRP_RESOURCE_MASK_BIT(id)   ((uint64_t)1 << ((id) & 63))
+
+static inline void mrp_resource_mask_zero(mrp_resource_mask_t *m)
+{
+    int i;
+
+    for (i = 0;  i < MRP_RESOURCE_MASK_WORDS;  i++)
+        m->bits[i] = 0;
+}
+
+static inline mrp_resource_mask_t mrp_resource_mask_bit(uint32_t id)
+{
+    mrp_resource_mask_t m;
+
+    mrp_resource_mask_zero(&m);
+
+    if (id < MRP_RESOURCE_MAX)
+        m.bits[MRP_RESOURCE_MASK_WORD(id)] = MRP_RESOURCE_MASK_BIT(id);
+
+    return m;
+}
+
+static inline void mrp_resource_mask_set(mrp_resource_mask_t *m, uint32_t id)
+{
+    m->bits[MRP_RESOURCE_MASK_WORD(id)] |= MRP_RESOURCE_MASK_BIT(id);
+}
+
+static inline void mrp_resource_mask_clear(mrp_resource_mask_t *m,
+                                           uint32_t id)
+{
+    m->bits[MRP_RESOURCE_MASK_WORD(id)] &= ~MRP_RESOURCE_MASK_BIT(id);
+}
+
+static inline bool mrp_resource_mask_test(const mrp_resource_mask_t *m,
+                                          uint32_t id)
+{
+    if (id >= MRP_RESOURCE_MAX)
+        return false;
+
+    return (m->bits[MRP_RESOURCE_MASK_WORD(id)] & MRP_RESOURCE_MASK_BIT(id));
+}
+
+static inline void mrp_resource_mask_or(mrp_resource_mask_t *dst,
+                                        const mrp_resource_mask_t *a,
+                                        const mrp_resource_mask_t *b)
+{
+    int i;
+
+    for (i = 0;  i < MRP_RESOURCE_MASK_WORDS;  i++)
+        dst->bits[i] = a->bits[i] | b->bits[i];
+}
+
+static inline void mrp_resource_mask_and(mrp_resource_mask_t *dst,
+                                         const mrp_resource_mask_t *a,
+                                         const mrp_resource_mask_t *b)
+{
+    int i;
+
+    for (i = 0;  i < MRP_RESOURCE_MASK_WORDS;  i++)
+        dst->bits[i] = a->bits[i] & b->bits[i];
+}
+
+static inline bool mrp_resource_mask_empty(const mrp_resource_mask_t *m)
+{
+    uint64_t any = 0;
+    int i;
+
+    for (i = 0;  i < MRP_RESOURCE_MASK_WORDS;  i++)
+        any |= m->bits[i];
+
+    return !any;
+}
+
+static inline bool mrp_resource_mask_equal(const mrp_resource_mask_t *a,
+                                           const mrp_resource_mask_t *b)
+{
+    uint64_t diff = 0;
+    int i;
+
+    for (i = 0;  i < MRP_RESOURCE_MASK_WORDS;  i++)
+        diff |= a->bits[i] ^ b->bits[i];
+
+    return !diff;
+}
+
+/* whether a and b have any resources in common */
+static inline bool mrp_resource_mask_overlap(const mrp_resource_mask_t *a,
+                                             const mrp_resource_mask_t *b)
+{
+    uint64_t common = 0;
+    int i;
+
+    for (i = 0;  i < MRP_RESOURCE_MASK_WORDS;  i++)
+        common |= a->bits[i] & b->bits[i];
+
+    return !!common;
+}
+
+/* whether all resources in b are also in a */
+static inline bool mrp_resource_mask_contains(const mrp_resource_mask_t *a,
+                                              const mrp_resource_mask_t *b)
+{
+    uint64_t missing = 0;
+    int i;
+
+    for (i = 0;  i < MRP_RESOURCE_MASK_WORDS;  i++)
+        missing |= b->bits[i] & ~a->bits[i];
+
+    return !missing;
+}
+
+/* whether the mask only has resources below #32 */
+static inline bool mrp_resource_mask_fits32(const mrp_resource_mask_t *m)
+{
+    uint64_t high = m->bits[0] >> 32;
+    int i;
+
+    for (i = 1;  i < MRP_RESOURCE_MASK_WORDS;  i++)
+        high |= m->bits[i];
+
+    return !high;
+}
+
+/*
+ * the first 32 resources of the mask, for the protocols with 32-bit masks.
+ * These limit the number of resource definitions to MRP_RESOURCE_MAX32
+ * (see mrp_resource_definition_limit()), so the result is never truncated.
+ */
+static inline uint32_t mrp_resource_mask_lo32(const mrp_resource_mask_t *m)
+{
+    return (uint32_t)(m->bits[0] & 0xffffffff);
+}
+
+
 
 #endif  /* __MURPHY_DATA_TYPES_H__ */
 
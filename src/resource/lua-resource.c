@@ -455,8 +455,8 @@ void event_cb(uint32_t request_id, mrp_resource_set_t *resource_set, void *user_
     advice = mrp_get_resource_set_advice(rset->resource_set);
 
     /* update resource set */
-    rset->acquired = !!grant;
-    rset->available = !!advice;
+    rset->acquired = !mrp_resource_mask_empty(&grant);
+    rset->available = !mrp_resource_mask_empty(&advice);
 
     if (mrp_lua_object_deref_value(rset, rset->L, rset->callback, false)) {
         mrp_lua_push_object(rset->L, rset);
@@ -634,8 +634,8 @@ static int resource_set_get_resources(void *data, lua_State *L, int member, mrp_
 
         /* mrp_lua_object_ref_value(res, L, 0); */
 
-        res->acquired = !!(mask & grant);
-        res->available = !!(mask & advice);
+        res->acquired = mrp_resource_mask_overlap(&mask, &grant);
+        res->available = mrp_resource_mask_overlap(&mask, &advice);
 
         /* TODO: update attributes */
 
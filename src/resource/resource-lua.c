@@ -169,6 +169,14 @@ void mrp_resource_lua_init(lua_State *L)
     }
 }
 
+bool mrp_resource_lua_has_veto(void)
+{
+    lua_State *L = mrp_lua_get_lua_state();
+    mrp_lua_resmethod_t *methods = mrp_lua_get_resource_methods();
+
+    return L && methods && methods->veto;
+}
+
 bool mrp_resource_lua_veto(mrp_zone_t *zone,
                            mrp_resource_set_t *rset,
                            mrp_resource_owner_t *owners,
@@ -200,7 +208,7 @@ bool mrp_resource_lua_veto(mrp_zone_t *zone,
         if ((veto = methods->veto)) {
             args[i=0].string  = zone->name;
             args[++i].pointer = sref;
-            args[++i].integer = grant;
+            args[++i].integer = mrp_resource_mask_lo32(&grant);
             args[++i].pointer = oref;
             args[++i].pointer = rref;
 
@@ -351,7 +359,8 @@ static int owners_getfield(lua_State *L)
         resid = lua_tointeger(L, 2) - 1;
 
     create_reference:
-        if (resid >= MRP_RESOURCE_MAX || !ref->owners[resid].class)
+        if (resid >= mrp_resource_definition_count() ||
+            !ref->owners[resid].class)
             lua_pushnil(L);
         else
             ownerref_create(L, ref->zoneid, resid);
@@ -548,10 +557,12 @@ static int setref_setfield(lua_State *L)
 
         case DONT_WAIT:
             rset->dont_wait.current = lua_toboolean(L, 3);
+            mrp_resource_owner_invalidate(rset->zone);
             break;
 
         case AUTO_RELEASE:
             rset->auto_release.current = lua_toboolean(L, 3);
+            mrp_resource_owner_invalidate(rset->zone);
             break;
 
         default:
@@ -52,6 +52,7 @@ bool mrp_resource_lua_veto(mrp_zone_t *, mrp_resource_set_t *,
                            mrp_resource_owner_t *, mrp_resource_mask_t,
                            mrp_resource_set_t *);
 void mrp_resource_lua_set_owners(mrp_zone_t *, mrp_resource_owner_t *);
+bool mrp_resource_lua_has_veto(void);
 
 void mrp_resource_lua_register_resource_set(mrp_resource_set_t *);
 void mrp_resource_lua_unregister_resource_set(mrp_resource_set_t *);
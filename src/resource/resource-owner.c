@@ -49,6 +49,7 @@
 #include "zone.h"
 #include "resource-lua.h"
 
+#define OWNER_BUF_SIZE       32
 #define NAME_LENGTH          24
 
 #define ZONE_ID_IDX          0
@@ -65,11 +66,28 @@ typedef struct {
     mrp_attr_value_t  attrs[MQI_COLUMN_MAX];
 } owner_row_t;
 
-static mrp_resource_owner_t  resource_owners[MRP_ZONE_MAX * MRP_RESOURCE_MAX];
+typedef struct {
+    uint32_t replyid;
+    mrp_resource_set_t *rset;
+    bool move;
+} event_t;
+
+typedef struct {
+    event_t *events;
+    uint32_t nevent;
+    uint32_t size;
+} event_buf_t;
+
+static mrp_resource_owner_t *resource_owners[MRP_ZONE_MAX];
+static uint32_t              owner_count;  /* size of the per-zone tables */
 static mqi_handle_t          owner_tables[MRP_RESOURCE_MAX];
+static bool                  incremental;
+static bool                  settled[MRP_ZONE_MAX];
 
+static int grow_owners(uint32_t);
+static mrp_resource_owner_t *get_owners(uint32_t);
 static mrp_resource_owner_t *get_owner(uint32_t, uint32_t);
-static void reset_owners(uint32_t, mrp_resource_owner_t *);
+static void reset_owners(uint32_t, mrp_resource_owner_t *, uint32_t);
 static bool grant_ownership(mrp_resource_owner_t *, mrp_zone_t *,
                             mrp_application_class_t *, mrp_resource_set_t *,
                             mrp_resource_t *);
@@ -77,6 +95,17 @@ static bool advice_ownership(mrp_resource_owner_t *, mrp_zone_t *,
                              mrp_application_class_t *, mrp_resource_set_t *,
                              mrp_resource_t *);
 
+static bool arbitrate_set(mrp_zone_t *, mrp_application_class_t *,
+                          mrp_resource_set_t *, mrp_resource_set_t *,
+                          uint32_t, event_buf_t *);
+static void replay_ownership(uint32_t, mrp_application_class_t *,
+                             mrp_resource_set_t *);
+static bool can_arbitrate_incrementally(uint32_t, mrp_resource_set_t *);
+static bool arbitrate_full(mrp_zone_t *, mrp_resource_set_t *, uint32_t,
+                           event_buf_t *);
+static bool arbitrate_incremental(mrp_zone_t *, mrp_resource_set_t *,
+                                  uint32_t, event_buf_t *);
+
 static void manager_start_transaction(mrp_zone_t *);
 static void manager_end_transaction(mrp_zone_t *);
 
@@ -124,6 +153,11 @@ int mrp_resource_owner_create_database_table(mrp_resource_def_t *rdef)
     MRP_ASSERT(owner_tables[rdef->id] == MQI_HANDLE_INVALID,
                "owner table already exist");
 
+    if (grow_owners(rdef->id + 1) < 0) {
+        mrp_log_error("Can't allocate owners for resource '%s'", rdef->name);
+        return -1;
+    }
+
     snprintf(name, sizeof(name), "%s_owner", rdef->name);
     for (p = name; (c = *p);  p++) {
         if (!isascii(c) || (!isalnum(c) && c != '_'))
@@ -162,39 +196,31 @@ void mrp_resource_owner_recalc(uint32_t zoneid)
     mrp_resource_owner_update_zone(zoneid, NULL, 0);
 }
 
+void mrp_resource_owner_set_incremental(bool enable)
+{
+    incremental = enable;
+}
+
+void mrp_resource_owner_invalidate(uint32_t zoneid)
+{
+    if (zoneid < MRP_ZONE_MAX)
+        settled[zoneid] = false;
+}
+
 void mrp_resource_owner_update_zone(uint32_t zoneid,
                                     mrp_resource_set_t *reqset,
                                     uint32_t reqid)
 {
-    typedef struct {
-        uint32_t replyid;
-        mrp_resource_set_t *rset;
-        bool move;
-    } event_t;
-
-    mrp_resource_owner_t oldowners[MRP_RESOURCE_MAX];
-    mrp_resource_owner_t backup[MRP_RESOURCE_MAX];
+    mrp_resource_owner_t oldbuf[OWNER_BUF_SIZE], *oldowners;
     mrp_zone_t *zone;
-    mrp_application_class_t *class;
     mrp_resource_set_t *rset;
-    mrp_resource_t *res;
-    mrp_resource_def_t *rdef;
-    mrp_resource_mgr_ftbl_t *ftbl;
-    mrp_resource_owner_t *owner, *old, *owners;
-    mrp_resource_mask_t mask;
-    mrp_resource_mask_t mandatory;
-    mrp_resource_mask_t grant;
-    mrp_resource_mask_t advice;
-    void *clc, *rsc, *rc;
+    mrp_resource_owner_t *owner, *old;
     uint32_t rid;
     uint32_t rcnt;
-    bool force_release;
-    bool changed;
-    bool move;
-    mrp_resource_event_t notify;
-    uint32_t replyid;
-    uint32_t nevent, maxev;
-    event_t *events, *ev, *lastev;
+    bool moved;
+    bool batched;
+    event_buf_t evbuf;
+    event_t *ev, *lastev;
 
     MRP_ASSERT(zoneid < MRP_ZONE_MAX, "invalid argument");
 
@@ -202,161 +228,36 @@ void mrp_resource_owner_update_zone(uint32_t zoneid,
 
     MRP_ASSERT(zone, "zone is not defined");
 
-    if (!(maxev = mrp_get_resource_set_count()))
+    if (!mrp_get_resource_set_count())
         return;
 
-    nevent = 0;
-    events = mrp_alloc(sizeof(event_t) * maxev);
-
-    MRP_ASSERT(events, "Memory alloc failure. Can't update zone");
-
-    reset_owners(zoneid, oldowners);
-    manager_start_transaction(zone);
+    memset(&evbuf, 0, sizeof(evbuf));
 
     rcnt = mrp_resource_definition_count();
-    clc  = NULL;
 
-    while ((class = mrp_application_class_iterate_classes(&clc))) {
-        rsc = NULL;
-
-        while ((rset=mrp_application_class_iterate_rsets(class,zoneid,&rsc))) {
-            force_release = false;
-            mandatory = rset->resource.mask.mandatory;
-            grant = 0;
-            advice = 0;
-            rc = NULL;
-
-            switch (rset->state) {
-
-            case mrp_resource_acquire:
-                while ((res = mrp_resource_set_iterate_resources(rset, &rc))) {
-                    rdef  = res->def;
-                    rid   = rdef->id;
-                    owner = get_owner(zoneid, rid);
-
-                    backup[rid] = *owner;
-
-                    if (grant_ownership(owner, zone, class, rset, res))
-                        grant |= ((mrp_resource_mask_t)1 << rid);
-                    else {
-                        if (owner->rset != rset)
-                            force_release |= owner->modal;
-                    }
-                }
-                owners = get_owner(zoneid, 0);
-                if ((grant & mandatory) == mandatory &&
-                    mrp_resource_lua_veto(zone, rset, owners, grant, reqset))
-                {
-                    advice = grant;
-                }
-                else {
-                    /* rollback, ie. restore the backed up state */
-                    rc = NULL;
-                    while ((res=mrp_resource_set_iterate_resources(rset,&rc))){
-                        rdef = res->def;
-                        rid = rdef->id;
-                        mask = (mrp_resource_mask_t)1 << rid;
-                        owner = get_owner(zoneid, rid);
-                        *owner = backup[rid];
-
-                        if ((grant & mask)) {
-                            if ((ftbl = rdef->manager.ftbl) && ftbl->free)
-                                ftbl->free(zone, res, rdef->manager.userdata);
-                        }
-
-                        if (advice_ownership(owner, zone, class, rset, res))
-                            advice |= mask;
-                    }
-
-                    grant = 0;
-
-                    if ((advice & mandatory) != mandatory)
-                        advice = 0;
-
-                    mrp_resource_lua_set_owners(zone, owners);
-                }
-                break;
-
-            case mrp_resource_release:
-                while ((res = mrp_resource_set_iterate_resources(rset, &rc))) {
-                    rdef  = res->def;
-                    rid   = rdef->id;
-                    owner = get_owner(zoneid, rid);
-
-                    if (advice_ownership(owner, zone, class, rset, res))
-                        advice |= ((mrp_resource_mask_t)1 << rid);
-                }
-                if ((advice & mandatory) != mandatory)
-                    advice = 0;
-                break;
-
-            default:
-                break;
-            }
-
-            changed = false;
-            move    = false;
-            notify  = 0;
-            replyid = (reqset == rset && reqid == rset->request.id) ? reqid:0;
-
-
-            if (force_release) {
-                move = (rset->state != mrp_resource_release);
-                notify = move ? MRP_RESOURCE_EVENT_RELEASE : 0;
-                changed = move || rset->resource.mask.grant;
-                rset->state = mrp_resource_release;
-                rset->resource.mask.grant = 0;
-            }
-            else {
-                if (grant == rset->resource.mask.grant) {
-                    if (rset->state == mrp_resource_acquire &&
-                        !grant && rset->dont_wait.current)
-                    {
-                        rset->state = mrp_resource_release;
-                        rset->dont_wait.current = rset->dont_wait.client;
-
-                        notify = MRP_RESOURCE_EVENT_RELEASE;
-                        move = true;
-                    }
-                }
-                else {
-                    rset->resource.mask.grant = grant;
-                    changed = true;
-
-                    if (rset->state != mrp_resource_release &&
-                        !grant && rset->auto_release.current)
-                    {
-                        rset->state = mrp_resource_release;
-                        rset->auto_release.current = rset->auto_release.client;
-
-                        notify = MRP_RESOURCE_EVENT_RELEASE;
-                        move = true;
-                    }
-                }
-            }
-
-            if (notify) {
-                mrp_resource_set_notify(rset, notify);
-            }
+    if (rcnt <= OWNER_BUF_SIZE)
+        oldowners = oldbuf;
+    else {
+        if (!(oldowners = mrp_alloc_array(mrp_resource_owner_t, rcnt)))
+            MRP_ASSERT(false, "Memory alloc failure. Can't update zone");
+    }
 
-            if (advice != rset->resource.mask.advice) {
-                rset->resource.mask.advice = advice;
-                changed = true;
-            }
+    reset_owners(zoneid, oldowners, rcnt);
 
-            if (replyid || changed) {
-                ev = events + nevent++;
+    /*
+     * If requests for the zone are still waiting to be batched they get
+     * served by this round, which then needs to visit all the sets.
+     */
+    batched = mrp_resource_set_unqueue_requests(zoneid);
 
-                ev->replyid = replyid;
-                ev->rset    = rset;
-                ev->move    = move;
-            }
-        } /* while rset */
-    } /* while class */
+    if (!batched && can_arbitrate_incrementally(zoneid, reqset))
+        moved = arbitrate_incremental(zone, reqset, reqid, &evbuf);
+    else
+        moved = arbitrate_full(zone, reqset, reqid, &evbuf);
 
-    manager_end_transaction(zone);
+    settled[zoneid] = !moved;
 
-    for (lastev = (ev = events) + nevent;     ev < lastev;     ev++) {
+    for (lastev = (ev = evbuf.events) + evbuf.nevent;  ev < lastev;  ev++) {
         rset = ev->rset;
 
         if (ev->move)
@@ -367,18 +268,19 @@ void mrp_resource_owner_update_zone(uint32_t zoneid,
         /* first we send out the revoke/deny events
          * followed by the grants (in the next for loop)
          */
-        if (rset->event && !rset->resource.mask.grant)
+        if (rset->event && mrp_resource_mask_empty(&rset->resource.mask.grant))
             rset->event(ev->replyid, rset, rset->user_data);
     }
 
-    for (lastev = (ev = events) + nevent;     ev < lastev;     ev++) {
+    for (lastev = (ev = evbuf.events) + evbuf.nevent;  ev < lastev;  ev++) {
         rset = ev->rset;
 
-        if (rset->event && rset->resource.mask.grant)
+        if (rset->event &&
+            !mrp_resource_mask_empty(&rset->resource.mask.grant))
             rset->event(ev->replyid, rset, rset->user_data);
     }
 
-    mrp_free(events);
+    mrp_free(evbuf.events);
 
     for (rid = 0;  rid < rcnt;  rid++) {
         owner = get_owner(zoneid, rid);
@@ -396,6 +298,9 @@ void mrp_resource_owner_update_zone(uint32_t zoneid,
                update_resource_owner(zone,owner->class,owner->rset,owner->res);
         }
     }
+
+    if (oldowners != oldbuf)
+        mrp_free(oldowners);
 }
 
 int mrp_resource_owner_print(char *buf, int len)
@@ -468,26 +373,444 @@ int mrp_resource_owner_print(char *buf, int len)
 }
 
 
+static bool arbitrate_set(mrp_zone_t              *zone,
+                          mrp_application_class_t *class,
+                          mrp_resource_set_t      *rset,
+                          mrp_resource_set_t      *reqset,
+                          uint32_t                 reqid,
+                          event_buf_t             *evbuf)
+{
+    mrp_resource_owner_t backup_buf[OWNER_BUF_SIZE], *backup;
+    uint32_t zoneid = zone->id;
+    mrp_resource_t *res;
+    mrp_resource_def_t *rdef;
+    mrp_resource_mgr_ftbl_t *ftbl;
+    mrp_resource_owner_t *owner, *owners;
+    mrp_resource_mask_t *mandatory;
+    mrp_resource_mask_t grant;
+    mrp_resource_mask_t advice;
+    void *rc;
+    uint32_t rid, rcnt;
+    bool force_release;
+    bool changed;
+    bool move;
+    mrp_resource_event_t notify;
+    uint32_t replyid;
+    event_t *ev;
+
+    force_release = false;
+    mandatory = &rset->resource.mask.mandatory;
+    mrp_resource_mask_zero(&grant);
+    mrp_resource_mask_zero(&advice);
+    rc = NULL;
+
+    switch (rset->state) {
+
+    case mrp_resource_acquire:
+        rcnt = mrp_resource_definition_count();
+
+        if (rcnt <= OWNER_BUF_SIZE)
+            backup = backup_buf;
+        else {
+            if (!(backup = mrp_alloc_array(mrp_resource_owner_t, rcnt)))
+                MRP_ASSERT(false, "Memory alloc failure. Can't arbitrate");
+        }
+
+        while ((res = mrp_resource_set_iterate_resources(rset, &rc))) {
+            rdef  = res->def;
+            rid   = rdef->id;
+            owner = get_owner(zoneid, rid);
+
+            backup[rid] = *owner;
+
+            if (grant_ownership(owner, zone, class, rset, res))
+                mrp_resource_mask_set(&grant, rid);
+            else {
+                if (owner->rset != rset)
+                    force_release |= owner->modal;
+            }
+        }
+        owners = get_owners(zoneid);
+        if (mrp_resource_mask_contains(&grant, mandatory) &&
+            mrp_resource_lua_veto(zone, rset, owners, grant, reqset))
+        {
+            advice = grant;
+        }
+        else {
+            /* rollback, ie. restore the backed up state */
+            rc = NULL;
+            while ((res=mrp_resource_set_iterate_resources(rset,&rc))){
+                rdef = res->def;
+                rid = rdef->id;
+                owner = get_owner(zoneid, rid);
+                *owner = backup[rid];
+
+                if (mrp_resource_mask_test(&grant, rid)) {
+                    if ((ftbl = rdef->manager.ftbl) && ftbl->free)
+                        ftbl->free(zone, res, rdef->manager.userdata);
+                }
+
+                if (advice_ownership(owner, zone, class, rset, res))
+                    mrp_resource_mask_set(&advice, rid);
+            }
+
+            mrp_resource_mask_zero(&grant);
+
+            if (!mrp_resource_mask_contains(&advice, mandatory))
+                mrp_resource_mask_zero(&advice);
+
+            mrp_resource_lua_set_owners(zone, owners);
+        }
+
+        if (backup != backup_buf)
+            mrp_free(backup);
+        break;
+
+    case mrp_resource_release:
+        while ((res = mrp_resource_set_iterate_resources(rset, &rc))) {
+            rdef  = res->def;
+            rid   = rdef->id;
+            owner = get_owner(zoneid, rid);
+
+            if (advice_ownership(owner, zone, class, rset, res))
+                mrp_resource_mask_set(&advice, rid);
+        }
+        if (!mrp_resource_mask_contains(&advice, mandatory))
+            mrp_resource_mask_zero(&advice);
+        break;
+
+    default:
+        break;
+    }
+
+    /* remember what we took so that it can be replayed later */
+    rset->arbitration.owned = grant;
+
+    changed = false;
+    move    = false;
+    notify  = 0;
+    replyid = (reqset == rset && reqid == rset->request.id) ? reqid:0;
+
+    if (rset->request.pending) {
+        /* a batched request, see mrp_resource_set_batch_requests() */
+        replyid = rset->request.id;
+        rset->request.pending = false;
+    }
+
+
+    if (force_release) {
+        move = (rset->state != mrp_resource_release);
+        notify = move ? MRP_RESOURCE_EVENT_RELEASE : 0;
+        changed = move || !mrp_resource_mask_empty(&rset->resource.mask.grant);
+        rset->state = mrp_resource_release;
+        mrp_resource_mask_zero(&rset->resource.mask.grant);
+    }
+    else {
+        if (mrp_resource_mask_equal(&grant, &rset->resource.mask.grant)) {
+            if (rset->state == mrp_resource_acquire &&
+                mrp_resource_mask_empty(&grant) && rset->dont_wait.current)
+            {
+                rset->state = mrp_resource_release;
+                rset->dont_wait.current = rset->dont_wait.client;
+
+                notify = MRP_RESOURCE_EVENT_RELEASE;
+                move = true;
+            }
+        }
+        else {
+            rset->resource.mask.grant = grant;
+            changed = true;
+
+            if (rset->state != mrp_resource_release &&
+                mrp_resource_mask_empty(&grant) && rset->auto_release.current)
+            {
+                rset->state = mrp_resource_release;
+                rset->auto_release.current = rset->auto_release.client;
+
+                notify = MRP_RESOURCE_EVENT_RELEASE;
+                move = true;
+            }
+        }
+    }
+
+    if (notify) {
+        mrp_resource_set_notify(rset, notify);
+    }
+
+    if (!mrp_resource_mask_equal(&advice, &rset->resource.mask.advice)) {
+        rset->resource.mask.advice = advice;
+        changed = true;
+    }
+
+    if (replyid || changed) {
+        if (evbuf->nevent >= evbuf->size) {
+            if (!mrp_reallocz(evbuf->events, evbuf->size, evbuf->size + 32))
+                MRP_ASSERT(false, "Memory alloc failure. Can't update zone");
+            evbuf->size += 32;
+        }
+
+        ev = evbuf->events + evbuf->nevent++;
+
+        ev->replyid = replyid;
+        ev->rset    = rset;
+        ev->move    = move;
+    }
+
+    return move;
+}
+
+static void replay_ownership(uint32_t                 zoneid,
+                             mrp_application_class_t *class,
+                             mrp_resource_set_t      *rset)
+{
+    mrp_resource_owner_t *owner;
+    mrp_resource_t *res;
+    uint32_t rid;
+    void *rc;
+
+    /*
+     * Redo what grant_ownership() did to the owners when this set was
+     * last arbitrated. This is only valid if nothing that the outcome
+     * depends on has changed since then.
+     */
+
+    if (mrp_resource_mask_empty(&rset->arbitration.owned))
+        return;
+
+    rc = NULL;
+    while ((res = mrp_resource_set_iterate_resources(rset, &rc))) {
+        rid = res->def->id;
+
+        if (!mrp_resource_mask_test(&rset->arbitration.owned, rid))
+            continue;
+
+        owner = get_owner(zoneid, rid);
+
+        if (!owner->class && !owner->rset) {
+            owner->class = class;
+            owner->rset  = rset;
+            owner->res   = res;
+            owner->modal = class->modal;
+        }
+
+        owner->share = class->share && res->shared;
+    }
+}
+
+static bool can_arbitrate_incrementally(uint32_t            zoneid,
+                                        mrp_resource_set_t *reqset)
+{
+    void *cursor = NULL;
+
+    /*
+     * Resource managers and Lua vetoes can base their decisions on the
+     * state of the whole zone, so with those we always need to go
+     * through all the resource sets. Also, if the previous round moved
+     * any resource sets, a full round would not be guaranteed to give
+     * the same results for the resource sets we would skip.
+     */
+
+    if (!incremental || !reqset || !settled[zoneid])
+        return false;
+
+    if (mrp_resource_definition_iterate_manager(&cursor))
+        return false;
+
+    if (mrp_resource_lua_has_veto())
+        return false;
+
+    return true;
+}
+
+static bool arbitrate_full(mrp_zone_t         *zone,
+                           mrp_resource_set_t *reqset,
+                           uint32_t            reqid,
+                           event_buf_t        *evbuf)
+{
+    uint32_t zoneid = zone->id;
+    mrp_application_class_t *class;
+    mrp_resource_set_t *rset;
+    void *clc, *rsc;
+    uint32_t seq;
+    bool moved;
+
+    manager_start_transaction(zone);
+
+    seq   = 0;
+    moved = false;
+    clc   = NULL;
+
+    while ((class = mrp_application_class_iterate_classes(&clc))) {
+        rsc = NULL;
+
+        while ((rset=mrp_application_class_iterate_rsets(class,zoneid,&rsc))) {
+            rset->arbitration.seq = ++seq;
+            moved |= arbitrate_set(zone, class, rset, reqset, reqid, evbuf);
+        }
+    }
+
+    manager_end_transaction(zone);
+
+    return moved;
+}
+
+static bool arbitrate_incremental(mrp_zone_t         *zone,
+                                  mrp_resource_set_t *reqset,
+                                  uint32_t            reqid,
+                                  event_buf_t        *evbuf)
+{
+    uint32_t zoneid = zone->id;
+    mrp_application_class_t *class;
+    mrp_resource_set_t *rset;
+    mrp_resource_mask_t affected;
+    void *clc, *rsc;
+    uint32_t seq, reqseq;
+    bool started;
+    bool moved;
+
+    /*
+     * Resource sets are arbitrated in priority order and the outcome for
+     * a set only depends on the sets before it that share resources with
+     * it. So the sets preceding the requesting one (at its old or new
+     * position, whichever comes first) end up exactly as in the previous
+     * round, and so do the ones that do not share resources with it,
+     * directly or via other affected sets. For all these we only replay
+     * their previous effect on the owners and arbitrate the rest.
+     */
+
+    reqseq   = reqset->arbitration.seq ? reqset->arbitration.seq : UINT32_MAX;
+    affected = reqset->resource.mask.all;
+    seq      = 0;
+    started  = false;
+    moved    = false;
+    clc      = NULL;
+
+    while ((class = mrp_application_class_iterate_classes(&clc))) {
+        rsc = NULL;
+
+        while ((rset=mrp_application_class_iterate_rsets(class,zoneid,&rsc))) {
+            if (rset == reqset || rset->arbitration.seq > reqseq)
+                started = true;
+
+            rset->arbitration.seq = ++seq;
+
+            if (rset == reqset ||
+                (started &&
+                 mrp_resource_mask_overlap(&rset->resource.mask.all,
+                                           &affected)))
+            {
+                mrp_resource_mask_or(&affected, &affected,
+                                     &rset->resource.mask.all);
+                moved |= arbitrate_set(zone, class, rset, reqset, reqid,
+                                       evbuf);
+            }
+            else
+                replay_ownership(zoneid, class, rset);
+        }
+    }
+
+    return moved;
+}
+
+
+static int grow_owners(uint32_t count)
+{
+    mrp_resource_owner_t *owners;
+    mrp_zone_t *zone;
+    uint32_t size, zid, i;
+
+    /*
+     * The owner tables are sized by the number of defined resources
+     * instead of MRP_RESOURCE_MAX. Resources are normally all defined
+     * before the first arbitration, so this hardly ever reallocates.
+     */
+
+    if (count <= owner_count)
+        return 0;
+
+    if (count > MRP_RESOURCE_MAX)
+        return -1;
+
+    size = owner_count ? owner_count : OWNER_BUF_SIZE;
+
+    while (size < count)
+        size *= 2;
+
+    if (size > MRP_RESOURCE_MAX)
+        size = MRP_RESOURCE_MAX;
+
+    for (zid = 0;  zid < MRP_ZONE_MAX;  zid++) {
+        if (!(owners = resource_owners[zid]))
+            continue;
+
+        if (!mrp_reallocz(owners, owner_count, size))
+            return -1;
+
+        for (i = owner_count;  i < size;  i++)
+            owners[i].share = true;
+
+        resource_owners[zid] = owners;
+
+        if ((zone = mrp_zone_find_by_id(zid)))
+            mrp_resource_lua_set_owners(zone, owners);
+    }
+
+    owner_count = size;
+
+    return 0;
+}
+
+static mrp_resource_owner_t *get_owners(uint32_t zone)
+{
+    mrp_resource_owner_t *owners;
+    uint32_t i;
+
+    MRP_ASSERT(zone < MRP_ZONE_MAX, "invalid argument");
+
+    if (!(owners = resource_owners[zone]) && owner_count > 0) {
+        if (!(owners = mrp_alloc_array(mrp_resource_owner_t, owner_count)))
+            MRP_ASSERT(false, "Memory alloc failure. Can't create owners");
+
+        memset(owners, 0, sizeof(mrp_resource_owner_t) * owner_count);
+
+        for (i = 0;  i < owner_count;  i++)
+            owners[i].share = true;
+
+        resource_owners[zone] = owners;
+    }
+
+    return owners;
+}
+
 static mrp_resource_owner_t *get_owner(uint32_t zone, uint32_t resid)
 {
-    MRP_ASSERT(zone < MRP_ZONE_MAX && resid < MRP_RESOURCE_MAX,
+    MRP_ASSERT(zone < MRP_ZONE_MAX && resid < owner_count,
                "invalid argument");
 
-    return resource_owners + (zone * MRP_RESOURCE_MAX + resid);
+    return get_owners(zone) + resid;
 }
 
-static void reset_owners(uint32_t zone, mrp_resource_owner_t *oldowners)
+static void reset_owners(uint32_t zone, mrp_resource_owner_t *oldowners,
+                         uint32_t count)
 {
-    mrp_resource_owner_t *owners = get_owner(zone, 0);
-    size_t size = sizeof(mrp_resource_owner_t) * MRP_RESOURCE_MAX;
+    mrp_resource_owner_t *owners = get_owners(zone);
+    size_t size = sizeof(mrp_resource_owner_t) * count;
     size_t i;
 
+    /*
+     * Only the first count entries can have been touched, the rest of
+     * the table is still in its initial state.
+     */
+
+    if (!owners || !count)
+        return;
+
     if (oldowners)
         memcpy(oldowners, owners, size);
 
     memset(owners, 0, size);
 
-    for (i = 0;   i < MRP_RESOURCE_MAX;   i++)
+    for (i = 0;   i < count;   i++)
         owners[i].share = true;
 }
 
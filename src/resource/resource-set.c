@@ -51,11 +51,22 @@
 
 #define STAMP_MAX     ((uint32_t)1 << MRP_KEY_STAMP_BITS)
 #define PRIORITY_MAX  ((uint32_t)1 << MRP_KEY_PRIORITY_BITS)
+#define MASK_STRLEN   (MRP_RESOURCE_MASK_WORDS * 16 + 3)
 
 
+typedef struct {
+    mrp_mainloop_t     *ml;             /* mainloop, NULL if not batching */
+    uint32_t            window;         /* batching window in usecs */
+    mrp_deferred_t     *deferred;       /* flush at end of iteration */
+    mrp_timer_t        *timer;          /* flush at end of window */
+    uint32_t            nreq[MRP_ZONE_MAX];   /* queued requests per zone */
+    mrp_resource_set_t *reqset[MRP_ZONE_MAX]; /* first queued set per zone */
+} batch_t;
+
 static MRP_LIST_HOOK(resource_set_list);
 static uint32_t resource_set_count;
 static mrp_htbl_t *id_hash;
+static batch_t batch;
 
 static int add_to_id_hash(mrp_resource_set_t *);
 static void remove_from_id_hash(mrp_resource_set_t *);
@@ -65,6 +76,12 @@ static mrp_resource_t *find_resource_by_name(mrp_resource_set_t *,const char*);
 static mrp_resource_t *find_resource_by_id(mrp_resource_set_t *, uint32_t);
 #endif
 
+static void queue_request(mrp_resource_set_t *);
+static void flush_requests(void);
+static void deferred_flush_cb(mrp_deferred_t *, void *);
+static void timer_flush_cb(mrp_timer_t *, void *);
+static void update_zone(mrp_resource_set_t *, uint32_t);
+
 static uint32_t get_request_stamp(void);
 static const char *state_str(mrp_resource_state_t);
 static void send_rset_event(mrp_resource_set_t *rset,
@@ -147,6 +164,9 @@ void mrp_resource_set_destroy(mrp_resource_set_t *rset)
         if (state == mrp_resource_acquire)
             mrp_resource_set_release(rset, MRP_RESOURCE_REQNO_INVALID);
 
+        if (rset->request.pending || batch.reqset[rset->zone] == rset)
+            flush_requests();
+
         mrp_list_foreach(&rset->resource.list, entry, n) {
             res = mrp_list_entry(entry, mrp_resource_t, list);
             mrp_resource_notify(res, rset, MRP_RESOURCE_EVENT_DESTROYED);
@@ -155,7 +175,7 @@ void mrp_resource_set_destroy(mrp_resource_set_t *rset)
 
         mrp_list_delete(&rset->list);
         mrp_list_delete(&rset->client.list);
-        mrp_list_delete(&rset->class.list);
+        mrp_application_class_remove_resource_set(rset);
 
         mrp_free(rset);
 
@@ -246,7 +266,7 @@ int mrp_resource_set_add_resource(mrp_resource_set_t *rset,
                                   mrp_attr_t         *attrs,
                                   bool                mandatory)
 {
-    uint32_t mask;
+    mrp_resource_mask_t mask;
     mrp_resource_t *res;
     uint32_t rsetid;
     bool autorel;
@@ -264,10 +284,15 @@ int mrp_resource_set_add_resource(mrp_resource_set_t *rset,
 
     mask = mrp_resource_get_mask(res);
 
-    rset->resource.mask.all       |= mask;
-    rset->resource.mask.mandatory |= mandatory ? mask : 0;
+    mrp_resource_mask_or(&rset->resource.mask.all,
+                         &rset->resource.mask.all, &mask);
+    if (mandatory)
+        mrp_resource_mask_or(&rset->resource.mask.mandatory,
+                             &rset->resource.mask.mandatory, &mask);
     rset->resource.share          |= mrp_resource_is_shared(res);
 
+    if (rset->class.ptr)
+        mrp_resource_owner_invalidate(rset->zone);
 
     mrp_list_append(&rset->resource.list, &res->list);
 
@@ -326,12 +351,14 @@ int mrp_resource_set_write_attributes(mrp_resource_set_t *rset,
 void mrp_resource_set_acquire(mrp_resource_set_t *rset, uint32_t reqid)
 {
     mrp_resource_state_t old_state;
-    mqi_handle_t trh;
 
     MRP_ASSERT(rset, "invalid argument");
 
     mrp_debug("acquiring resource set #%d", rset->id);
 
+    if (rset->request.pending)
+        flush_requests();
+
     old_state = rset->state;
     rset->state = mrp_resource_acquire;
 
@@ -344,20 +371,19 @@ void mrp_resource_set_acquire(mrp_resource_set_t *rset, uint32_t reqid)
         if (old_state != mrp_resource_acquire)
             mrp_resource_set_notify(rset, MRP_RESOURCE_EVENT_ACQUIRE);
 
-        trh = mqi_begin_transaction();
-        mrp_resource_owner_update_zone(rset->zone, rset, reqid);
-        mqi_commit_transaction(trh);
+        update_zone(rset, reqid);
     }
 }
 
 void mrp_resource_set_release(mrp_resource_set_t *rset, uint32_t reqid)
 {
-    mqi_handle_t trh;
-
     MRP_ASSERT(rset, "invalid argument");
 
     mrp_debug("releasing resource set #%d", rset->id);
 
+    if (rset->request.pending)
+        flush_requests();
+
     if (!rset->class.ptr)
         rset->state = mrp_resource_release;
     else {
@@ -374,19 +400,48 @@ void mrp_resource_set_release(mrp_resource_set_t *rset, uint32_t reqid)
 
             mrp_resource_set_notify(rset, MRP_RESOURCE_EVENT_RELEASE);
 
-            trh = mqi_begin_transaction();
-            mrp_resource_owner_update_zone(rset->zone, rset, reqid);
-            mqi_commit_transaction(trh);
+            update_zone(rset, reqid);
         }
     }
 }
 
+int mrp_resource_set_batch_requests(mrp_mainloop_t *ml, uint32_t window)
+{
+    flush_requests();
+
+    if (batch.deferred != NULL) {
+        mrp_del_deferred(batch.deferred);
+        batch.deferred = NULL;
+    }
+
+    batch.ml     = NULL;
+    batch.window = 0;
+
+    if (ml == NULL) {
+        mrp_log_info("resource request batching disabled");
+        return 0;
+    }
+
+    if (!(batch.deferred = mrp_add_deferred(ml, deferred_flush_cb, NULL))) {
+        mrp_log_error("Failed to set up batching of resource requests.");
+        return -1;
+    }
+
+    mrp_disable_deferred(batch.deferred);
+
+    batch.ml     = ml;
+    batch.window = window;
+
+    mrp_log_info("resource requests are batched (window %u usecs)", window);
+
+    return 0;
+}
+
 void mrp_resource_set_updated(mrp_resource_set_t *rset)
 {
     mrp_resource_t *res;
     mrp_resource_def_t *def;
     mrp_list_hook_t *resen, *n;
-    mrp_resource_mask_t mask;
     bool grant;
 
     MRP_ASSERT(rset, "invalid argument");
@@ -397,8 +452,7 @@ void mrp_resource_set_updated(mrp_resource_set_t *rset)
         res = mrp_list_entry(resen, mrp_resource_t, list);
         def = res->def;
 
-        mask = ((mrp_resource_mask_t)1) << def->id;
-        grant =  (mask & rset->resource.mask.grant) ? true : false;
+        grant = mrp_resource_mask_test(&rset->resource.mask.grant, def->id);
 
         mrp_debug("    %s now %sgranted", def->name, grant ? "" : "not ");
 
@@ -467,6 +521,8 @@ void mrp_resource_set_request_auto_release(mrp_resource_set_t *rset,
     MRP_ASSERT(rset, "invalid argument");
 
     rset->auto_release.current = auto_release;
+
+    mrp_resource_owner_invalidate(rset->zone);
 }
 
 void mrp_resource_set_request_dont_wait(mrp_resource_set_t *rset,
@@ -475,6 +531,8 @@ void mrp_resource_set_request_dont_wait(mrp_resource_set_t *rset,
     MRP_ASSERT(rset, "invalid argument");
 
     rset->dont_wait.current = dont_wait;
+
+    mrp_resource_owner_invalidate(rset->zone);
 }
 
 int mrp_resource_set_print(mrp_resource_set_t *rset, size_t indent,
@@ -484,7 +542,9 @@ int mrp_resource_set_print(mrp_resource_set_t *rset, size_t indent,
 
     mrp_resource_t *res;
     mrp_list_hook_t *resen, *n;
-    uint32_t mandatory;
+    mrp_resource_mask_t *mandatory;
+    char all[MASK_STRLEN], mnd[MASK_STRLEN];
+    char grant[MASK_STRLEN], advice[MASK_STRLEN];
     char gap[] = "                         ";
     char *p, *e;
 
@@ -498,12 +558,15 @@ int mrp_resource_set_print(mrp_resource_set_t *rset, size_t indent,
 
     e = (p = buf) + len;
 
-    mandatory = rset->resource.mask.mandatory;
+    mandatory = &rset->resource.mask.mandatory;
 
-    PRINT("%s%3u - 0x%02x/0x%02x 0x%02x/0x%02x 0x%08x %d %s%s%s %s\n",
-          gap, rset->id,
-          rset->resource.mask.all, mandatory,
-          rset->resource.mask.grant, rset->resource.mask.advice,
+    mrp_resource_mask_print(&rset->resource.mask.all, all, sizeof(all));
+    mrp_resource_mask_print(mandatory, mnd, sizeof(mnd));
+    mrp_resource_mask_print(&rset->resource.mask.grant, grant,sizeof(grant));
+    mrp_resource_mask_print(&rset->resource.mask.advice,advice,sizeof(advice));
+
+    PRINT("%s%3u - %s/%s %s/%s 0x%08x %d %s%s%s %s\n",
+          gap, rset->id, all, mnd, grant, advice,
           mrp_application_class_get_sorting_key(rset), rset->class.priority,
           rset->resource.share ? "shared   ":"exclusive",
           rset->auto_release.client ? ",autorelease" : "",
@@ -634,6 +697,127 @@ static mrp_resource_t *find_resource_by_id(mrp_resource_set_t *rset,
 }
 #endif
 
+static void update_zone(mrp_resource_set_t *rset, uint32_t reqid)
+{
+    mqi_handle_t trh;
+
+    if (batch.ml != NULL) {
+        queue_request(rset);
+        return;
+    }
+
+    trh = mqi_begin_transaction();
+    mrp_resource_owner_update_zone(rset->zone, rset, reqid);
+    mqi_commit_transaction(trh);
+}
+
+static void queue_request(mrp_resource_set_t *rset)
+{
+    uint32_t zone = rset->zone;
+    uint32_t msecs;
+
+    /*
+     * The reply to the request is sent when the zone of the set gets
+     * arbitrated at the end of the current mainloop iteration or after
+     * the batching window has expired.
+     */
+
+    rset->request.pending = true;
+
+    if (!batch.nreq[zone]++)
+        batch.reqset[zone] = rset;
+
+    if (!batch.window)
+        mrp_enable_deferred(batch.deferred);
+    else if (batch.timer == NULL) {
+        msecs = (batch.window + 999) / 1000;
+        batch.timer = mrp_add_timer(batch.ml, msecs, timer_flush_cb, NULL);
+
+        if (batch.timer == NULL)
+            mrp_enable_deferred(batch.deferred);
+    }
+}
+
+static void flush_requests(void)
+{
+    mrp_resource_set_t *reqset;
+    mqi_handle_t trh;
+    uint32_t zone, reqid;
+
+    if (batch.deferred != NULL)
+        mrp_disable_deferred(batch.deferred);
+
+    if (batch.timer != NULL) {
+        mrp_del_timer(batch.timer);
+        batch.timer = NULL;
+    }
+
+    trh = MQI_HANDLE_INVALID;
+
+    for (zone = 0;  zone < MRP_ZONE_MAX;  zone++) {
+        if (!batch.nreq[zone])
+            continue;
+
+        /*
+         * With a single request we can let the arbitration know which
+         * set it was, otherwise the zone needs to be fully recalculated.
+         */
+        if (batch.nreq[zone] == 1) {
+            reqset = batch.reqset[zone];
+            reqid  = reqset->request.id;
+        }
+        else {
+            reqset = NULL;
+            reqid  = 0;
+        }
+
+        batch.nreq[zone]   = 0;
+        batch.reqset[zone] = NULL;
+
+        if (trh == MQI_HANDLE_INVALID)
+            trh = mqi_begin_transaction();
+
+        mrp_resource_owner_update_zone(zone, reqset, reqid);
+    }
+
+    if (trh != MQI_HANDLE_INVALID)
+        mqi_commit_transaction(trh);
+}
+
+bool mrp_resource_set_unqueue_requests(uint32_t zone)
+{
+    /*
+     * The zone is about to be arbitrated outside of flush_requests().
+     * That arbitration replies to the queued requests of the zone, so
+     * they must not be arbitrated again, and the reference to the first
+     * queued set would become stale once that set gets destroyed.
+     */
+
+    if (zone >= MRP_ZONE_MAX || !batch.nreq[zone])
+        return false;
+
+    batch.nreq[zone]   = 0;
+    batch.reqset[zone] = NULL;
+
+    return true;
+}
+
+static void deferred_flush_cb(mrp_deferred_t *d, void *user_data)
+{
+    MRP_UNUSED(d);
+    MRP_UNUSED(user_data);
+
+    flush_requests();
+}
+
+static void timer_flush_cb(mrp_timer_t *t, void *user_data)
+{
+    MRP_UNUSED(t);
+    MRP_UNUSED(user_data);
+
+    flush_requests();
+}
+
 static uint32_t get_request_stamp(void)
 {
     static uint32_t  stamp;
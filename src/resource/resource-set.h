@@ -33,6 +33,7 @@
 #include <murphy/common/list.h>
 
 #include "data-types.h"
+#include "application-class.h"
 
 /* event protocol */
 
@@ -74,12 +75,21 @@ struct mrp_resource_set_s {
         mrp_list_hook_t list;
         mrp_application_class_t *ptr;
         uint32_t priority;
+        uint32_t key;
+        uint32_t seq;
+        uint32_t nlevel;
+        mrp_resource_set_t *next[MRP_CLASS_INDEX_LEVELS];
     }                               class;
     uint32_t                        zone;
     struct {
         uint32_t id;
         uint32_t stamp;
+        bool pending;
     }                               request;
+    struct {
+        uint32_t seq;
+        mrp_resource_mask_t owned;
+    }                               arbitration;
     mrp_resource_event_cb_t         event;
     void                           *user_data;
 };
@@ -95,6 +105,7 @@ void                mrp_resource_set_request_auto_release(mrp_resource_set_t *,
                                                           bool);
 void                mrp_resource_set_request_dont_wait(mrp_resource_set_t *,
                                                        bool);
+bool                mrp_resource_set_unqueue_requests(uint32_t);
 int                 mrp_resource_set_print(mrp_resource_set_t *, size_t,
                                            char *, int);
 
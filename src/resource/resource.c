@@ -31,6 +31,7 @@
 #include <ctype.h>
 #include <string.h>
 #include <errno.h>
+#include <inttypes.h>
 
 #include <murphy/common/mm.h>
 #include <murphy/common/log.h>
@@ -47,7 +48,6 @@
 #include "zone.h"
 
 
-#define RESOURCE_MAX        (sizeof(mrp_resource_mask_t) * 8)
 #define ATTRIBUTE_MAX       (sizeof(mrp_attribute_mask_t) * 8)
 #define NAME_LENGTH          24
 
@@ -73,9 +73,10 @@ typedef struct {
 
 
 static uint32_t            resource_def_count;
-static mrp_resource_def_t *resource_def_table[RESOURCE_MAX];
+static uint32_t            resource_def_max = MRP_RESOURCE_MAX;
+static mrp_resource_def_t *resource_def_table[MRP_RESOURCE_MAX];
 static MRP_LIST_HOOK(manager_list);
-static mqi_handle_t        resource_user_table[RESOURCE_MAX];
+static mqi_handle_t        resource_user_table[MRP_RESOURCE_MAX];
 
 static uint32_t add_resource_definition(const char *, bool, uint32_t,
                                         mrp_resource_mgr_ftbl_t *, void *);
@@ -139,6 +140,20 @@ uint32_t mrp_resource_definition_count(void)
     return resource_def_count;
 }
 
+int mrp_resource_definition_limit(uint32_t max)
+{
+    if (resource_def_count > max) {
+        mrp_log_error("Can't limit resources to %u, %u are already defined.",
+                      max, resource_def_count);
+        return -1;
+    }
+
+    if (max < resource_def_max)
+        resource_def_max = max;
+
+    return 0;
+}
+
 mrp_resource_def_t *mrp_resource_definition_find_by_name(const char *name)
 {
     mrp_resource_def_t *def;
@@ -348,19 +363,48 @@ const char *mrp_resource_get_name(mrp_resource_t *res)
 mrp_resource_mask_t mrp_resource_get_mask(mrp_resource_t *res)
 {
     mrp_resource_def_t *def;
-    mrp_resource_mask_t mask = 0;
+    mrp_resource_mask_t mask;
+
+    mrp_resource_mask_zero(&mask);
 
     if (res) {
         def = res->def;
 
         MRP_ASSERT(def, "confused with internal data structures");
 
-        mask = (mrp_resource_mask_t)1 << def->id;
+        mrp_resource_mask_set(&mask, def->id);
     }
 
     return mask;
 }
 
+int mrp_resource_mask_print(const mrp_resource_mask_t *mask, char *buf,int len)
+{
+#define PRINT(fmt, args...)  if (p<e) { p += snprintf(p, e-p, fmt , ##args); }
+
+    char *p, *e;
+    int   i;
+
+    if (len <= 0)
+        return 0;
+
+    MRP_ASSERT(mask && buf, "invalid argument");
+
+    e = (p = buf) + len;
+
+    for (i = MRP_RESOURCE_MASK_WORDS - 1;  i > 0 && !mask->bits[i];  i--)
+        ;
+
+    PRINT("0x%02" PRIx64, mask->bits[i]);
+
+    while (--i >= 0)
+        PRINT("%016" PRIx64, mask->bits[i]);
+
+    return p - buf;
+
+#undef PRINT
+}
+
 bool mrp_resource_is_shared(mrp_resource_t *res)
 {
     if (res)
@@ -481,7 +525,8 @@ void mrp_resource_notify(mrp_resource_t *res,
     }
 }
 
-int mrp_resource_print(mrp_resource_t *res, uint32_t mandatory,
+int mrp_resource_print(mrp_resource_t *res,
+                       const mrp_resource_mask_t *mandatory,
                        size_t indent, char *buf, int len)
 {
 #define PRINT(fmt, args...)  if (p<e) { p += snprintf(p, e-p, fmt , ##args); }
@@ -489,12 +534,11 @@ int mrp_resource_print(mrp_resource_t *res, uint32_t mandatory,
     mrp_resource_def_t *rdef;
     char gap[] = "                         ";
     char *p, *e;
-    uint32_t m;
 
     if (len <= 0)
         return 0;
 
-    MRP_ASSERT(res && indent < sizeof(gap)-1 && buf,
+    MRP_ASSERT(res && mandatory && indent < sizeof(gap)-1 && buf,
                "invalid argument");
 
     rdef = res->def;
@@ -504,10 +548,9 @@ int mrp_resource_print(mrp_resource_t *res, uint32_t mandatory,
     gap[indent] = '\0';
 
     e = (p = buf) + len;
-    m = ((mrp_resource_mask_t)1 << rdef->id);
-
-    PRINT("%s%s: 0x%02x %s %s", gap, rdef->name, m,
-          (m & mandatory) ? "mandatory":"optional ",
+    PRINT("%s%s: #%02u %s %s", gap, rdef->name, rdef->id,
+          mrp_resource_mask_test(mandatory, rdef->id) ?
+          "mandatory":"optional ",
           res->shared ? "shared  ":"exlusive");
 
     p += mrp_resource_attribute_print(res, p, e-p);
@@ -550,8 +593,14 @@ static uint32_t add_resource_definition(const char *name,
 
     MRP_ASSERT(name && nattr < ATTRIBUTE_MAX, "invalid argument");
 
-    if (resource_def_count >= RESOURCE_MAX) {
-        mrp_log_error("Resource table overflow. Can't add resource '%s'",name);
+    if (resource_def_count >= resource_def_max) {
+        if (resource_def_max < MRP_RESOURCE_MAX)
+            mrp_log_error("Can't add resource '%s'. The resource protocols "
+                          "in use are limited to %u resources.", name,
+                          resource_def_max);
+        else
+            mrp_log_error("Resource table overflow. Can't add resource '%s'",
+                          name);
         return MRP_RESOURCE_ID_INVALID;
     }
 
@@ -669,14 +718,14 @@ static int resource_user_create_table(mrp_resource_def_t *rdef)
 
     if (!initialized) {
         mqi_open();
-        for (i = 0;  i < RESOURCE_MAX;  i++)
+        for (i = 0;  i < MRP_RESOURCE_MAX;  i++)
             resource_user_table[i] = MQI_HANDLE_INVALID;
         initialized = true;
     }
 
     MRP_ASSERT(sizeof(base_coldefs) < sizeof(coldefs),"too many base columns");
     MRP_ASSERT(rdef, "invalid argument");
-    MRP_ASSERT(rdef->id < RESOURCE_MAX, "confused with data structures");
+    MRP_ASSERT(rdef->id < MRP_RESOURCE_MAX, "confused with data structures");
     MRP_ASSERT(resource_user_table[rdef->id] == MQI_HANDLE_INVALID,
                "resource user table already exist");
 
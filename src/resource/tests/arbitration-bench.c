@@ -0,0 +1,276 @@
+/*
+ * Copyright (c) 2012, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Benchmark for resource arbitration.
+ *
+ * Creates the same set of synthetic resource sets in two zones and runs
+ * the same random sequence of acquire/release requests in both, once
+ * with full and once with incremental arbitration. After each request
+ * the grants and advices in the two zones are compared to make sure the
+ * incremental arbitration gives the same results as the full one.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <getopt.h>
+
+#include <murphy/common/macros.h>
+#include <murphy/common/mm.h>
+#include <murphy/common/log.h>
+
+#include <murphy/resource/config-api.h>
+#include <murphy/resource/manager-api.h>
+#include <murphy/resource/client-api.h>
+
+#define NRESOURCE  96                    /* number of resources */
+#define NCLASS     4                     /* number of application classes */
+#define MAX_RES    3                     /* max. resources per set */
+
+typedef struct {
+    int nset;                            /* resource sets per zone */
+    int nop;                             /* number of requests */
+    unsigned int seed;                   /* random seed */
+} bench_t;
+
+static const char *zones[2]   = { "full", "incremental" };
+static const char *classes[NCLASS] = { "player", "navigator", "phone",
+                                       "alert" };
+
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + ts.tv_nsec / 1000000000.0;
+}
+
+
+static void setup(void)
+{
+    char name[32];
+    int  i;
+
+    mrp_zone_definition_create(NULL);
+
+    for (i = 0; i < (int)MRP_ARRAY_SIZE(zones); i++)
+        mrp_zone_create(zones[i], NULL);
+
+    for (i = 0; i < NRESOURCE; i++) {
+        snprintf(name, sizeof(name), "resource%d", i);
+        mrp_resource_definition_create(name, i & 1, NULL, NULL, NULL);
+    }
+
+    for (i = 0; i < NCLASS; i++)
+        mrp_application_class_create(classes[i], i + 1, false, true,
+                                     MRP_RESOURCE_ORDER_FIFO);
+}
+
+
+static mrp_resource_set_t **create_sets(bench_t *b)
+{
+    mrp_resource_client_t *client;
+    mrp_resource_set_t **sets, *rset;
+    const char *class;
+    char name[32];
+    int i, j, k, z, nres, res[MAX_RES];
+    bool shared[MAX_RES], mandatory[MAX_RES];
+
+    client = mrp_resource_client_create("arbitration-bench", NULL);
+    sets   = mrp_allocz_array(mrp_resource_set_t *, 2 * b->nset);
+
+    if (client == NULL || sets == NULL) {
+        mrp_log_error("Failed to allocate resource sets.");
+        exit(1);
+    }
+
+    for (i = 0; i < b->nset; i++) {
+        class = classes[rand() % NCLASS];
+        nres  = 1 + rand() % MAX_RES;
+
+        for (j = 0; j < nres; j++) {
+            do {
+                res[j] = rand() % NRESOURCE;
+                for (k = 0; k < j && res[k] != res[j]; k++)
+                    ;
+            } while (k < j);
+
+            shared[j]    = rand() & 1;
+            mandatory[j] = (j == 0) || (rand() & 1);
+        }
+
+        for (z = 0; z < 2; z++) {
+            rset = mrp_resource_set_create(client, false, false, 0, NULL, NULL);
+
+            for (j = 0; j < nres; j++) {
+                snprintf(name, sizeof(name), "resource%d", res[j]);
+                mrp_resource_set_add_resource(rset, name, shared[j], NULL,
+                                              mandatory[j]);
+            }
+
+            mrp_resource_owner_set_incremental(z == 1);
+            mrp_application_class_add_resource_set(class, zones[z], rset, 0);
+
+            sets[2 * i + z] = rset;
+        }
+    }
+
+    return sets;
+}
+
+
+static bool check(bench_t *b, mrp_resource_set_t **sets, int op)
+{
+    mrp_resource_set_t *full, *incr;
+    mrp_resource_mask_t fgrant, fadvice, igrant, iadvice;
+    char fg[128], fa[128], ig[128], ia[128];
+    int i;
+
+    for (i = 0; i < b->nset; i++) {
+        full = sets[2 * i];
+        incr = sets[2 * i + 1];
+
+        fgrant  = mrp_get_resource_set_grant(full);
+        fadvice = mrp_get_resource_set_advice(full);
+        igrant  = mrp_get_resource_set_grant(incr);
+        iadvice = mrp_get_resource_set_advice(incr);
+
+        if (mrp_get_resource_set_state(full) !=
+            mrp_get_resource_set_state(incr) ||
+            !mrp_resource_mask_equal(&fgrant, &igrant) ||
+            !mrp_resource_mask_equal(&fadvice, &iadvice)) {
+            mrp_resource_mask_print(&fgrant, fg, sizeof(fg));
+            mrp_resource_mask_print(&fadvice, fa, sizeof(fa));
+            mrp_resource_mask_print(&igrant, ig, sizeof(ig));
+            mrp_resource_mask_print(&iadvice, ia, sizeof(ia));
+            printf("request #%d: resource set #%d differs "
+                   "(grant %s vs. %s, advice %s vs. %s)\n", op, i,
+                   fg, ig, fa, ia);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+static void request(mrp_resource_set_t *rset, uint32_t reqid)
+{
+    if (mrp_get_resource_set_state(rset) == mrp_resource_acquire)
+        mrp_resource_set_release(rset, reqid);
+    else
+        mrp_resource_set_acquire(rset, reqid);
+}
+
+
+static int run(bench_t *b, mrp_resource_set_t **sets)
+{
+    double t, tfull, tincr;
+    int op, i, nerr;
+
+    tfull = tincr = 0.0;
+    nerr  = 0;
+
+    for (op = 0; op < b->nop; op++) {
+        i = rand() % b->nset;
+
+        mrp_resource_owner_set_incremental(false);
+        t = now();
+        request(sets[2 * i], op + 1);
+        tfull += now() - t;
+
+        mrp_resource_owner_set_incremental(true);
+        t = now();
+        request(sets[2 * i + 1], op + 1);
+        tincr += now() - t;
+
+        if (!check(b, sets, op + 1))
+            nerr++;
+    }
+
+    printf("%6d sets, %6d requests: full %8.3f s, incremental %8.3f s "
+           "(%.1fx)\n", b->nset, b->nop, tfull, tincr,
+           tincr > 0 ? tfull / tincr : 0.0);
+
+    return nerr;
+}
+
+
+static void usage(const char *argv0)
+{
+    printf("usage: %s [-s sets] [-n requests] [-r seed]\n", argv0);
+    exit(0);
+}
+
+
+int main(int argc, char *argv[])
+{
+    bench_t b;
+    mrp_resource_set_t **sets;
+    int opt, nerr;
+
+    b.nset = 2000;
+    b.nop  = 5000;
+    b.seed = 1;
+
+    while ((opt = getopt(argc, argv, "s:n:r:h")) != -1) {
+        switch (opt) {
+        case 's': b.nset = atoi(optarg);           break;
+        case 'n': b.nop  = atoi(optarg);           break;
+        case 'r': b.seed = (unsigned int)atoi(optarg); break;
+        default:  usage(argv[0]);
+        }
+    }
+
+    if (b.nset <= 0 || b.nop <= 0)
+        usage(argv[0]);
+
+    srand(b.seed);
+
+    setup();
+    sets = create_sets(&b);
+    nerr = run(&b, sets);
+
+    if (nerr)
+        printf("%d requests gave different results.\n", nerr);
+
+    return nerr ? 1 : 0;
+}
+
+/*
+ * Local Variables:
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ *
+ */
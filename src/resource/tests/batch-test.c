@@ -0,0 +1,288 @@
+/*
+ * Copyright (c) 2012, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Test for batched resource requests.
+ *
+ * A resource manager counts the arbitration rounds of the zone. Several
+ * acquire requests queued in one mainloop iteration must be served by a
+ * single round, with every set getting a reply carrying its own request
+ * id. A zone arbitrated outside of the batch must serve (and drop) the
+ * requests queued for it, and destroying a set must never leave the batch
+ * pointing to it.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <murphy/common/macros.h>
+#include <murphy/common/mainloop.h>
+
+#include <murphy/resource/config-api.h>
+#include <murphy/resource/manager-api.h>
+#include <murphy/resource/client-api.h>
+
+#define NSET 8
+
+typedef struct {
+    mrp_resource_set_t *rset;
+    uint32_t            reqid;           /* id of the last request */
+    int                 nreply;          /* replies carrying reqid */
+    int                 nother;          /* other events */
+} set_t;
+
+static set_t    sets[NSET];
+static uint32_t zone;
+static int      nround;
+static int      nfail;
+
+#define CHECK(cond, ...) do {                                   \
+        if (!(cond)) {                                          \
+            printf("FAIL: " __VA_ARGS__);                       \
+            printf("\n");                                       \
+            nfail++;                                            \
+        }                                                       \
+    } while (0)
+
+
+static void manager_init(mrp_zone_t *z, void *user_data)
+{
+    MRP_UNUSED(z);
+    MRP_UNUSED(user_data);
+
+    nround++;
+}
+
+
+static void event_cb(uint32_t reqid, mrp_resource_set_t *rset, void *user_data)
+{
+    set_t *s = user_data;
+
+    MRP_UNUSED(rset);
+
+    if (reqid != 0 && reqid == s->reqid)
+        s->nreply++;
+    else
+        s->nother++;
+}
+
+
+static void wakeup_cb(mrp_timer_t *t, void *user_data)
+{
+    MRP_UNUSED(user_data);
+
+    mrp_del_timer(t);
+}
+
+
+static void iterate(mrp_mainloop_t *ml)
+{
+    /* make sure the iteration does not block if nothing is pending */
+    mrp_add_timer(ml, 0, wakeup_cb, NULL);
+    mrp_mainloop_iterate(ml);
+}
+
+
+static void setup(void)
+{
+    static mrp_resource_mgr_ftbl_t manager = {
+        .init = manager_init,
+    };
+
+    mrp_resource_client_t *client;
+    int i;
+
+    mrp_zone_definition_create(NULL);
+    zone = mrp_zone_create("driver", NULL);
+
+    mrp_resource_definition_create("audio", true, NULL, &manager, NULL);
+    mrp_application_class_create("player", 1, false, true,
+                                 MRP_RESOURCE_ORDER_FIFO);
+
+    client = mrp_resource_client_create("batch-test", NULL);
+
+    for (i = 0; i < NSET; i++) {
+        sets[i].rset = mrp_resource_set_create(client, false, false, 0,
+                                               event_cb, sets + i);
+        mrp_resource_set_add_resource(sets[i].rset, "audio", true, NULL,
+                                      true);
+        mrp_application_class_add_resource_set("player", "driver",
+                                               sets[i].rset, 0);
+    }
+}
+
+
+static void reset(void)
+{
+    int i;
+
+    for (i = 0; i < NSET; i++)
+        sets[i].nreply = sets[i].nother = 0;
+
+    nround = 0;
+}
+
+
+static void acquire(int i, uint32_t reqid)
+{
+    sets[i].reqid = reqid;
+    mrp_resource_set_acquire(sets[i].rset, reqid);
+}
+
+
+static void release(int i, uint32_t reqid)
+{
+    sets[i].reqid = reqid;
+    mrp_resource_set_release(sets[i].rset, reqid);
+}
+
+
+static void test_batched_acquire(mrp_mainloop_t *ml)
+{
+    int i;
+
+    reset();
+
+    for (i = 0; i < NSET; i++)
+        acquire(i, 100 + i);
+
+    CHECK(nround == 0, "%d arbitrations before the end of the iteration",
+          nround);
+
+    iterate(ml);
+
+    CHECK(nround == 1, "%d arbitrations for %d batched requests", nround,
+          NSET);
+
+    for (i = 0; i < NSET; i++)
+        CHECK(sets[i].nreply == 1, "set #%d got %d replies for request %u",
+              i, sets[i].nreply, sets[i].reqid);
+
+    iterate(ml);
+
+    CHECK(nround == 1, "%d arbitrations after the batch was flushed", nround);
+}
+
+
+static void test_out_of_band(mrp_mainloop_t *ml)
+{
+    int i;
+
+    reset();
+
+    for (i = 0; i < 4; i++)
+        release(i, 200 + i);
+
+    mrp_resource_owner_recalc(zone);
+
+    CHECK(nround == 1, "%d arbitrations for a recalculation", nround);
+
+    for (i = 0; i < 4; i++)
+        CHECK(sets[i].nreply == 1, "set #%d got %d replies for request %u "
+              "from a recalculation", i, sets[i].nreply, sets[i].reqid);
+
+    /* the first queued set must be gone from the batch by now */
+    mrp_resource_set_destroy(sets[0].rset);
+    sets[0].rset = NULL;
+
+    iterate(ml);
+
+    CHECK(nround == 1, "%d arbitrations for already served requests", nround);
+}
+
+
+static void test_destroy_pending(mrp_mainloop_t *ml)
+{
+    reset();
+
+    acquire(1, 300);
+    acquire(2, 301);
+
+    /*
+     * The queued requests are served first, then the release of the
+     * destroyed set gets arbitrated before the set is freed.
+     */
+    mrp_resource_set_destroy(sets[1].rset);
+    sets[1].rset = NULL;
+
+    CHECK(nround == 2, "%d arbitrations when destroying a queued set",
+          nround);
+    CHECK(sets[2].nreply == 1, "set #2 got %d replies for request %u",
+          sets[2].nreply, sets[2].reqid);
+
+    iterate(ml);
+
+    CHECK(nround == 2, "%d arbitrations after destroying a queued set",
+          nround);
+}
+
+
+int main(int argc, char *argv[])
+{
+    mrp_mainloop_t *ml;
+
+    MRP_UNUSED(argc);
+    MRP_UNUSED(argv);
+
+    if ((ml = mrp_mainloop_create()) == NULL) {
+        printf("failed to create mainloop\n");
+        return 1;
+    }
+
+    setup();
+
+    if (mrp_resource_set_batch_requests(ml, 0) < 0) {
+        printf("failed to enable request batching\n");
+        return 1;
+    }
+
+    test_batched_acquire(ml);
+    test_out_of_band(ml);
+    test_destroy_pending(ml);
+
+    mrp_resource_set_batch_requests(NULL, 0);
+    mrp_mainloop_destroy(ml);
+
+    if (nfail) {
+        printf("%d resource batching checks failed\n", nfail);
+        return 1;
+    }
+
+    printf("resource batching tests passed\n");
+
+    return 0;
+}
+
+/*
+ * Local Variables:
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ *
+ */
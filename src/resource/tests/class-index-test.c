@@ -0,0 +1,297 @@
+/*
+ * Copyright (c) 2012, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Test for the resource set index of application classes.
+ *
+ * The resource sets of a class are kept both in a per-zone list and in a
+ * skip list indexing it. Sets are created with a few priorities only, so
+ * many of them share a sorting key, in two classes and in two zones.
+ * After every change the level 0 of the skip list must have the same
+ * sets in the same order as the list, sorted by key and, within equal
+ * keys, in the order they were (re)inserted. The upper levels must be
+ * ordered subsequences of the level below them.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <murphy/common/macros.h>
+
+#include <murphy/resource/config-api.h>
+#include <murphy/resource/manager-api.h>
+#include <murphy/resource/client-api.h>
+#include <murphy/resource/resource-set.h>
+#include <murphy/resource/application-class.h>
+
+#define NSET   64                        /* resource sets to create */
+#define NPRIO  3                         /* distinct set priorities */
+#define NOP    2000                      /* random requests to make */
+
+static const char *classes[] = { "player", "game" };
+static const char *zones[]   = { "driver", "passenger" };
+
+static uint32_t               zoneids[2];
+static mrp_resource_client_t *client;
+static mrp_resource_set_t    *sets[NSET];
+static int                    nfail;
+
+#define CHECK(cond, ...) do {                                   \
+        if (!(cond)) {                                          \
+            printf("FAIL: " __VA_ARGS__);                       \
+            printf("\n");                                       \
+            nfail++;                                            \
+        }                                                       \
+    } while (0)
+
+
+static void event_cb(uint32_t reqid, mrp_resource_set_t *rset, void *user_data)
+{
+    MRP_UNUSED(reqid);
+    MRP_UNUSED(rset);
+    MRP_UNUSED(user_data);
+}
+
+
+static void setup(void)
+{
+    uint32_t i;
+
+    mrp_zone_definition_create(NULL);
+
+    for (i = 0; i < MRP_ARRAY_SIZE(zones); i++)
+        zoneids[i] = mrp_zone_create(zones[i], NULL);
+
+    mrp_resource_definition_create("audio", true, NULL, NULL, NULL);
+
+    for (i = 0; i < MRP_ARRAY_SIZE(classes); i++)
+        mrp_application_class_create(classes[i], i + 1, false, true,
+                                     MRP_RESOURCE_ORDER_FIFO);
+
+    client = mrp_resource_client_create("class-index-test", NULL);
+}
+
+
+static void create_set(int i)
+{
+    sets[i] = mrp_resource_set_create(client, false, false, i % NPRIO,
+                                      event_cb, NULL);
+    mrp_resource_set_add_resource(sets[i], "audio", true, NULL, true);
+    mrp_application_class_add_resource_set(classes[i % 2], zones[(i / 2) % 2],
+                                           sets[i], 0);
+}
+
+
+/* set #c is always in class #c */
+static mrp_application_class_t *class_of(int c)
+{
+    return sets[c]->class.ptr;
+}
+
+
+static int check_index(int c, int z)
+{
+    mrp_application_class_t *class = class_of(c);
+    const char *name = classes[c];
+    uint32_t zone = zoneids[z];
+    mrp_resource_set_t *rset, *prev, *lower, *upper;
+    mrp_list_hook_t *p, *n;
+    uint32_t level;
+    bool ordered;
+    int cnt;
+
+    cnt   = 0;
+    prev  = NULL;
+    lower = class->index[zone].next[0];
+
+    mrp_list_foreach(class->resource_sets + zone, p, n) {
+        rset = mrp_list_entry(p, mrp_resource_set_t, class.list);
+
+        CHECK(rset == lower, "%s/%s: set #%d of the list is not the one in "
+              "the index", name, zones[z], cnt);
+        CHECK(rset->class.nlevel > 0, "%s/%s: set #%d is not in the index",
+              name, zones[z], cnt);
+
+        ordered = (prev == NULL ||
+                   prev->class.key < rset->class.key ||
+                   (prev->class.key == rset->class.key &&
+                    prev->class.seq < rset->class.seq));
+
+        CHECK(ordered, "%s/%s: set #%d (key 0x%x, seq %u) is out of order "
+              "after key 0x%x, seq %u", name, zones[z], cnt,
+              rset->class.key, rset->class.seq,
+              prev->class.key, prev->class.seq);
+
+        if (rset != lower || !ordered)
+            return -1;
+
+        prev  = rset;
+        lower = rset->class.next[0];
+        cnt++;
+    }
+
+    CHECK(lower == NULL, "%s/%s: index has more sets than the list",
+          name, zones[z]);
+
+    /* every upper level must skip through the sets of the level below */
+    for (level = 1; level < MRP_CLASS_INDEX_LEVELS; level++) {
+        lower = class->index[zone].next[level - 1];
+        upper = class->index[zone].next[level];
+
+        for (; lower != NULL; lower = lower->class.next[level - 1]) {
+            if (lower->class.nlevel <= level)
+                continue;
+
+            CHECK(lower == upper, "%s/%s: level %u of the index is out of "
+                  "order", name, zones[z], level);
+
+            if (lower != upper)
+                return -1;
+
+            upper = upper->class.next[level];
+        }
+
+        CHECK(upper == NULL, "%s/%s: level %u of the index has extra sets",
+              name, zones[z], level);
+    }
+
+    return cnt;
+}
+
+
+static int check_all(void)
+{
+    uint32_t c, z;
+    int cnt, n;
+
+    for (c = 0, cnt = 0; c < MRP_ARRAY_SIZE(classes); c++) {
+        for (z = 0; z < MRP_ARRAY_SIZE(zones); z++) {
+            if ((n = check_index(c, z)) < 0)
+                return -1;
+            cnt += n;
+        }
+    }
+
+    return cnt;
+}
+
+
+static void test_equal_keys(void)
+{
+    mrp_application_class_t *class;
+    mrp_list_hook_t *p, *n;
+    mrp_resource_set_t *rset;
+    int i, last;
+
+    for (i = 0; i < NSET; i++)
+        create_set(i);
+
+    CHECK(check_all() == NSET, "index does not have all %d sets", NSET);
+
+    /*
+     * Sets without requests only differ in priority, so the ones with
+     * equal priority must stay in the order they were added.
+     */
+    class = class_of(0);
+    last  = -1;
+
+    mrp_list_foreach(class->resource_sets + zoneids[0], p, n) {
+        rset = mrp_list_entry(p, mrp_resource_set_t, class.list);
+
+        for (i = 0; sets[i] != rset; i++)
+            ;
+
+        if (last >= 0 && last % NPRIO == i % NPRIO)
+            CHECK(last < i, "set #%d with equal key is before set #%d",
+                  last, i);
+
+        last = i;
+    }
+}
+
+
+static void test_random_requests(void)
+{
+    int op, i;
+
+    srand(1);
+
+    for (op = 0; op < NOP; op++) {
+        i = rand() % NSET;
+
+        switch (rand() % 4) {
+        case 0:
+        case 1:
+            mrp_resource_set_acquire(sets[i], op);
+            break;
+        case 2:
+            mrp_resource_set_release(sets[i], op);
+            break;
+        case 3:
+            mrp_resource_set_destroy(sets[i]);
+            create_set(i);
+            break;
+        }
+
+        if (check_all() != NSET) {
+            printf("index broken after request #%d\n", op);
+            nfail++;
+            break;
+        }
+    }
+}
+
+
+int main(int argc, char *argv[])
+{
+    MRP_UNUSED(argc);
+    MRP_UNUSED(argv);
+
+    setup();
+
+    test_equal_keys();
+    test_random_requests();
+
+    if (nfail) {
+        printf("%d resource set index checks failed\n", nfail);
+        return 1;
+    }
+
+    printf("resource set index tests passed\n");
+
+    return 0;
+}
+
+/*
+ * Local Variables:
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ *
+ */
@@ -0,0 +1,240 @@
+/*
+ * Copyright (c) 2012, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Test for the resource mask helpers and the resource definition limit.
+ *
+ * The mask operations are checked on bits in every mask word, including
+ * the word boundaries. The 32-bit conversion helpers must only accept
+ * masks of the first 32 resources. Once a protocol with 32-bit masks
+ * limits the resource definitions, no resource beyond #31 can be defined.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <murphy/common/macros.h>
+
+#include <murphy/resource/config-api.h>
+#include <murphy/resource/manager-api.h>
+#include <murphy/resource/client-api.h>
+
+static int nfail;
+
+#define CHECK(cond, ...) do {                                   \
+        if (!(cond)) {                                          \
+            printf("FAIL: " __VA_ARGS__);                       \
+            printf("\n");                                       \
+            nfail++;                                            \
+        }                                                       \
+    } while (0)
+
+
+static const uint32_t ids[] = {
+    0, 1, 31, 32, 63, 64, 65, 127, 128, 200, MRP_RESOURCE_MAX - 1
+};
+
+
+static void test_single_bits(void)
+{
+    mrp_resource_mask_t m, b;
+    uint32_t i, j;
+
+    mrp_resource_mask_zero(&m);
+
+    CHECK(mrp_resource_mask_empty(&m), "zeroed mask is not empty");
+
+    for (i = 0; i < MRP_ARRAY_SIZE(ids); i++) {
+        b = mrp_resource_mask_bit(ids[i]);
+
+        CHECK(!mrp_resource_mask_empty(&b), "bit %u: mask empty", ids[i]);
+        CHECK(mrp_resource_mask_test(&b, ids[i]), "bit %u: not set", ids[i]);
+
+        for (j = 0; j < MRP_ARRAY_SIZE(ids); j++)
+            if (j != i)
+                CHECK(!mrp_resource_mask_test(&b, ids[j]),
+                      "bit %u: bit %u also set", ids[i], ids[j]);
+
+        mrp_resource_mask_set(&m, ids[i]);
+        CHECK(mrp_resource_mask_test(&m, ids[i]), "set %u: not set", ids[i]);
+    }
+
+    b = mrp_resource_mask_bit(MRP_RESOURCE_MAX);
+    CHECK(mrp_resource_mask_empty(&b), "out of range bit got set");
+    CHECK(!mrp_resource_mask_test(&m, MRP_RESOURCE_MAX),
+          "out of range bit tests as set");
+
+    for (i = 0; i < MRP_ARRAY_SIZE(ids); i++) {
+        mrp_resource_mask_clear(&m, ids[i]);
+        CHECK(!mrp_resource_mask_test(&m, ids[i]),
+              "clear %u: still set", ids[i]);
+    }
+
+    CHECK(mrp_resource_mask_empty(&m), "mask not empty after clearing");
+}
+
+
+static void test_set_operations(void)
+{
+    mrp_resource_mask_t a, b, r;
+    uint32_t i;
+
+    /* a: even entries of ids, b: ids from index 3 on */
+    mrp_resource_mask_zero(&a);
+    mrp_resource_mask_zero(&b);
+
+    for (i = 0; i < MRP_ARRAY_SIZE(ids); i++) {
+        if (!(i & 1))
+            mrp_resource_mask_set(&a, ids[i]);
+        if (i >= 3)
+            mrp_resource_mask_set(&b, ids[i]);
+    }
+
+    mrp_resource_mask_or(&r, &a, &b);
+
+    for (i = 0; i < MRP_ARRAY_SIZE(ids); i++)
+        CHECK(mrp_resource_mask_test(&r, ids[i]) == (!(i & 1) || i >= 3),
+              "or: wrong bit %u", ids[i]);
+
+    mrp_resource_mask_and(&r, &a, &b);
+
+    for (i = 0; i < MRP_ARRAY_SIZE(ids); i++)
+        CHECK(mrp_resource_mask_test(&r, ids[i]) == (!(i & 1) && i >= 3),
+              "and: wrong bit %u", ids[i]);
+
+    CHECK(mrp_resource_mask_overlap(&a, &b), "a and b do not overlap");
+    CHECK(!mrp_resource_mask_contains(&a, &b), "a contains b");
+    CHECK(mrp_resource_mask_contains(&b, &r), "b does not contain a & b");
+    CHECK(mrp_resource_mask_contains(&a, &r), "a does not contain a & b");
+    CHECK(!mrp_resource_mask_equal(&a, &b), "a equals b");
+
+    /* absorption, with the bit in the last word cleared first */
+    mrp_resource_mask_clear(&r, MRP_RESOURCE_MAX - 1);
+    mrp_resource_mask_or(&r, &r, &a);
+    CHECK(mrp_resource_mask_equal(&r, &a), "(a & b) | a differs from a");
+
+    mrp_resource_mask_zero(&r);
+    mrp_resource_mask_set(&r, 66);
+    CHECK(!mrp_resource_mask_overlap(&a, &r), "overlap in a missing bit");
+    CHECK(!mrp_resource_mask_contains(&a, &r), "a contains a missing bit");
+    CHECK(mrp_resource_mask_contains(&a, &a), "a does not contain itself");
+}
+
+
+static void test_mask32(void)
+{
+    mrp_resource_mask_t m;
+    char buf[128];
+
+    mrp_resource_mask_zero(&m);
+    CHECK(mrp_resource_mask_fits32(&m), "empty mask does not fit 32 bits");
+    CHECK(mrp_resource_mask_lo32(&m) == 0, "empty mask is not 0");
+
+    mrp_resource_mask_set(&m, 0);
+    mrp_resource_mask_set(&m, 31);
+    CHECK(mrp_resource_mask_fits32(&m), "#0 and #31 do not fit 32 bits");
+    CHECK(mrp_resource_mask_lo32(&m) == 0x80000001,
+          "wrong 32-bit mask 0x%x", mrp_resource_mask_lo32(&m));
+
+    mrp_resource_mask_print(&m, buf, sizeof(buf));
+    CHECK(!strcmp(buf, "0x80000001"), "mask printed as '%s'", buf);
+
+    mrp_resource_mask_set(&m, 32);
+    CHECK(!mrp_resource_mask_fits32(&m), "#32 fits 32 bits");
+    CHECK(mrp_resource_mask_lo32(&m) == 0x80000001,
+          "wrong 32-bit mask 0x%x", mrp_resource_mask_lo32(&m));
+
+    mrp_resource_mask_zero(&m);
+    mrp_resource_mask_set(&m, 200);
+    CHECK(!mrp_resource_mask_fits32(&m), "#200 fits 32 bits");
+    CHECK(mrp_resource_mask_lo32(&m) == 0, "#200 shows up in 32 bits");
+}
+
+
+static void test_definition_limit(void)
+{
+    char     name[32];
+    uint32_t i, id;
+
+    mrp_zone_definition_create(NULL);
+
+    for (i = 0; i < 20; i++) {
+        snprintf(name, sizeof(name), "resource%u", i);
+        id = mrp_resource_definition_create(name, true, NULL, NULL, NULL);
+        CHECK(id == i, "resource #%u got id %u", i, id);
+    }
+
+    CHECK(mrp_resource_definition_limit(16) < 0,
+          "limit below the defined resources accepted");
+    CHECK(mrp_resource_definition_limit(MRP_RESOURCE_MAX32) == 0,
+          "limit to %d resources refused", MRP_RESOURCE_MAX32);
+    CHECK(mrp_resource_definition_limit(MRP_RESOURCE_MAX) == 0,
+          "limit to %d resources refused", MRP_RESOURCE_MAX);
+
+    for (; i < MRP_RESOURCE_MAX32; i++) {
+        snprintf(name, sizeof(name), "resource%u", i);
+        id = mrp_resource_definition_create(name, true, NULL, NULL, NULL);
+        CHECK(id == i, "resource #%u got id %u", i, id);
+    }
+
+    /* raising the limit again must not have taken effect */
+    snprintf(name, sizeof(name), "resource%u", i);
+    id = mrp_resource_definition_create(name, true, NULL, NULL, NULL);
+    CHECK(id == MRP_RESOURCE_ID_INVALID,
+          "resource #%u defined beyond the limit", i);
+}
+
+
+int main(int argc, char *argv[])
+{
+    MRP_UNUSED(argc);
+    MRP_UNUSED(argv);
+
+    test_single_bits();
+    test_set_operations();
+    test_mask32();
+    test_definition_limit();
+
+    if (nfail) {
+        printf("%d resource mask checks failed\n", nfail);
+        return 1;
+    }
+
+    printf("resource mask tests passed\n");
+
+    return 0;
+}
+
+/*
+ * Local Variables:
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ *
+ */